@@ -50,6 +50,9 @@
 #include <linux/hardirq.h>
 #include <linux/kfifo.h>
 #include <linux/blkdev.h>
+#ifdef HAVE_BLK_MQ_UNIQUE_TAG
+#include <linux/blk-mq.h>
+#endif
 #include <linux/init.h>
 #include <linux/ioctl.h>
 #include <linux/cdev.h>
@@ -109,6 +112,11 @@ bool iser_pi_enable = false;
 module_param_named(pi_enable, iser_pi_enable, bool, S_IRUGO);
 MODULE_PARM_DESC(pi_enable, "Enable T10-PI offload support (default:disabled)");
 
+unsigned int iser_num_channels = 1;
+module_param_named(num_channels, iser_num_channels, uint, S_IRUGO);
+MODULE_PARM_DESC(num_channels,
+		 "Number of RDMA channels (QP/CQ pairs) per session, negotiated with the target (default:1)");
+
 int iser_pi_guard;
 module_param_named(pi_guard, iser_pi_guard, int, S_IRUGO);
 #ifdef HAVE_SCSI_CMND_PROT_FLAGS
@@ -249,6 +257,29 @@ set_last_ping_on_nopout_task(struct iscsi_task *task)
 #endif
 
 
+/**
+ * iser_task_chan() - select the RDMA channel of a scsi task
+ * @iser_conn: iser connection
+ * @sc:        scsi command
+ *
+ * Commands of a blk-mq hardware queue always go to the same channel
+ * so that submission and completion stay on one QP/CQ pair.
+ */
+static struct ib_conn *
+iser_task_chan(struct iser_conn *iser_conn, struct scsi_cmnd *sc)
+{
+#ifdef HAVE_BLK_MQ_UNIQUE_TAG
+	if (iser_conn->num_chans > 1) {
+		u32 tag = blk_mq_unique_tag(scsi_cmd_to_rq(sc));
+
+		return iser_conn_chan(iser_conn,
+				      blk_mq_unique_tag_to_hwq(tag) %
+				      iser_conn->num_chans);
+	}
+#endif
+	return &iser_conn->ib_conn;
+}
+
 /**
  * iscsi_iser_task_init() - Initialize iscsi-iser task
  * @task: iscsi task
@@ -282,9 +313,12 @@ iscsi_iser_task_init(struct iscsi_task *task)
 	}
 
 	/* mgmt task */
-	if (!task->sc)
+	if (!task->sc) {
+		iser_task->ib_conn = &iser_task->iser_conn->ib_conn;
 		return 0;
+	}
 
+	iser_task->ib_conn = iser_task_chan(iser_task->iser_conn, task->sc);
 	iser_task->command_sent = 0;
 	iser_task_rdma_init(iser_task);
 	iser_task->sc = task->sc;
@@ -532,6 +566,12 @@ iscsi_iser_conn_bind(struct iscsi_cls_session *cls_session,
 	}
 	iser_conn = ep->dd_data;
 
+	if (iser_conn->num_chans > 1 && iser_connect_chans(iser_conn)) {
+		iser_warn("iser_conn %p failed to connect %d channels, using one\n",
+			  iser_conn, iser_conn->num_chans);
+		iser_free_chans(iser_conn);
+	}
+
 	mutex_lock(&iser_conn->state_mutex);
 	if (iser_conn->state != ISER_CONN_UP) {
 		error = -EINVAL;
@@ -544,6 +584,8 @@ iscsi_iser_conn_bind(struct iscsi_cls_session *cls_session,
 	if (error)
 		goto out;
 
+	iser_fr_pool_sysfs_add(iser_conn);
+
 	/* binds the iSER connection retrieved from the previously
 	 * connected ep_handle to the iSCSI layer connection. exchanges
 	 * connection pointers */
@@ -709,6 +751,10 @@ iscsi_iser_session_create(struct iscsi_endpoint *ep,
 		iser_conn = ep->dd_data;
 		shost->sg_tablesize = iser_conn->scsi_sg_tablesize;
 		shost->can_queue = min_t(u16, cmds_max, iser_conn->max_cmds);
+#ifdef HAVE_SCSI_HOST_NR_HW_QUEUES
+		/* one blk-mq hardware queue per negotiated RDMA channel */
+		shost->nr_hw_queues = iser_conn->num_chans;
+#endif
 
 		mutex_lock(&iser_conn->state_mutex);
 		if (iser_conn->state != ISER_CONN_UP) {
@@ -833,6 +879,7 @@ static void
 iscsi_iser_conn_get_stats(struct iscsi_cls_conn *cls_conn, struct iscsi_stats *stats)
 {
 	struct iscsi_conn *conn = cls_conn->dd_data;
+	struct iser_conn *iser_conn = conn->dd_data;
 
 	stats->txdata_octets = conn->txdata_octets;
 	stats->rxdata_octets = conn->rxdata_octets;
@@ -843,13 +890,15 @@ iscsi_iser_conn_get_stats(struct iscsi_cls_conn *cls_conn, struct iscsi_stats *s
 	stats->r2t_pdus = conn->r2t_pdus_cnt; /* always 0 */
 	stats->tmfcmd_pdus = conn->tmfcmd_pdus_cnt;
 	stats->tmfrsp_pdus = conn->tmfrsp_pdus_cnt;
-#ifdef HAVE_BLK_QUEUE_VIRT_BOUNDARY
 	stats->custom_length = 0;
-#else
-	stats->custom_length = 1;
-	strcpy(stats->custom[0].desc, "fmr_unalign_cnt");
-	stats->custom[0].value = conn->fmr_unalign_cnt;
+#ifndef HAVE_BLK_QUEUE_VIRT_BOUNDARY
+	strcpy(stats->custom[stats->custom_length].desc, "fmr_unalign_cnt");
+	stats->custom[stats->custom_length++].value = conn->fmr_unalign_cnt;
 #endif
+	/* stays zero unless unaligned buffers had to be copied */
+	strcpy(stats->custom[stats->custom_length].desc, "bounced_bytes");
+	stats->custom[stats->custom_length++].value =
+		iser_conn ? iser_conn->bounced_bytes : 0;
 }
 
 #ifdef HAVE_ISCSI_GET_EP_PARAM
@@ -978,6 +1027,7 @@ iscsi_iser_ep_disconnect(struct iscsi_endpoint *ep)
 	iser_info("ep %p iser conn %p\n", ep, iser_conn);
 
 	mutex_lock(&iser_conn->state_mutex);
+	iser_fr_pool_sysfs_del(iser_conn);
 	iser_conn_terminate(iser_conn);
 
 	/*
@@ -58,6 +58,7 @@
 #include <linux/dma-mapping.h>
 #include <linux/mutex.h>
 #include <linux/mempool.h>
+#include <linux/percpu.h>
 #include <linux/uio.h>
 
 #include <linux/socket.h>
@@ -177,6 +178,26 @@ static inline unsigned scsi_transfer_length(struct scsi_cmnd *scmd)
 
 #define ISER_SIGNAL_CMD_COUNT 32
 
+/* Maximum number of RDMA channels (QP/CQ pairs) per session */
+#define ISER_MAX_CHANNELS		16
+
+/*
+ * Immediate-only writes are sent straight from the scsi buffers with
+ * up to this many local data SGEs, no registration and no bouncing
+ */
+#define ISER_MAX_IMM_SGE		4
+#define ISER_MAX_TX_SGE			(ISER_MAX_IMM_SGE + 1)
+
+/*
+ * Fastreg descriptors are cached per cpu and moved to/from the shared
+ * pool list in batches. The pool grows in steps of ISER_FR_POOL_GROW
+ * descriptors when it runs low, up to scsi_cmds_max plus what the per
+ * cpu caches may hold.
+ */
+#define ISER_FR_CACHE_SIZE		16
+#define ISER_FR_CACHE_BATCH		(ISER_FR_CACHE_SIZE / 2)
+#define ISER_FR_POOL_GROW		32
+
 /* Constant PDU lengths calculations */
 #define ISER_HEADERS_LEN	(sizeof(struct iser_ctrl) + sizeof(struct iscsi_hdr))
 
@@ -269,7 +290,8 @@ enum iser_desc_type {
  * @dam_addr:      header buffer dma_address
  * @tx_sg:         sg[0] points to iser/iscsi headers
  *                 sg[1] optionally points to either of immediate data
- *                 unsolicited data-out or control
+ *                 unsolicited data-out or control, sg[2..] are used
+ *                 only for gathered immediate data
  * @num_sge:       number sges used on this TX task
  * @mapped:        Is the task header mapped
  * reg_wr:         registration WR
@@ -281,7 +303,7 @@ struct iser_tx_desc {
 	struct iscsi_hdr             iscsi_header;
 	enum   iser_desc_type        type;
 	u64		             dma_addr;
-	struct ib_sge		     tx_sg[2];
+	struct ib_sge		     tx_sg[ISER_MAX_TX_SGE];
 	int                          num_sge;
 	struct ib_cqe		     cqe;
 	bool			     mapped;
@@ -389,6 +411,7 @@ struct iser_reg_ops {
  * @comps:         Dinamically allocated array of completion handlers
  * @reg_ops:       Registration ops
  * @remote_inv_sup: Remote invalidate is supported on this device
+ * @max_imm_sge:   Max data SGEs for gathered immediate data
  */
 struct iser_device {
 	struct ib_device             *ib_device;
@@ -400,6 +423,7 @@ struct iser_device {
 	struct iser_comp	     *comps;
 	const struct iser_reg_ops    *reg_ops;
 	bool                         remote_inv_sup;
+	int			     max_imm_sge;
 };
 
 /**
@@ -435,18 +459,50 @@ struct iser_fr_desc {
 	struct list_head                  all_list;
 };
 
+/**
+ * struct iser_fr_cache - per cpu cache of fastreg descriptors
+ *
+ * @descs:          cached descriptors (stack)
+ * @count:          number of cached descriptors
+ * @hits:           gets served from the cache
+ * @misses:         gets that had to refill from the pool list
+ */
+struct iser_fr_cache {
+	struct iser_fr_desc	       *descs[ISER_FR_CACHE_SIZE];
+	unsigned int			count;
+	unsigned long			hits;
+	unsigned long			misses;
+};
+
 /**
  * struct iser_fr_pool: connection fast registration pool
  *
  * @list:                list of fastreg descriptors
  * @lock:                protects fmr/fastreg pool
  * @size:                size of the pool
+ * @all_list:            all descriptors owned by the pool
+ * @cache:               per cpu descriptor caches (fastreg only)
+ * @free:                number of descriptors on @list
+ * @max_size:            limit for on-demand growth
+ * @mr_size:             pages per descriptor MR
+ * @grown:               number of descriptors added after setup
+ * @starved:             gets that found no free descriptor
+ * @grow_work:           allocates more descriptors when running low
+ * @sysfs:               usage attributes are registered
  */
 struct iser_fr_pool {
 	struct list_head        list;
 	spinlock_t              lock;
 	int                     size;
 	struct list_head        all_list;
+	struct iser_fr_cache __percpu *cache;
+	int                     free;
+	int                     max_size;
+	unsigned int            mr_size;
+	unsigned long           grown;
+	unsigned long           starved;
+	struct work_struct      grow_work;
+	bool                    sysfs;
 };
 
 /**
@@ -457,10 +513,13 @@ struct iser_fr_pool {
  * @post_recv_buf_count: post receive counter
  * @sig_count:           send work request signal count
  * @rx_wr:               receive work request for batch posts
+ * @rx_desc_head:        head of rx_descs cyclic buffer
+ * @rx_descs:            rx buffers array (cyclic buffer)
  * @device:              reference to iser device
  * @comp:                iser completion context
  * @fr_pool:             connection fast registration poool
  * @pi_support:          Indicate device T10-PI support
+ * @iser_conn:           owning iser connection
  */
 struct ib_conn {
 	struct rdma_cm_id           *cma_id;
@@ -468,11 +527,31 @@ struct ib_conn {
 	int                          post_recv_buf_count;
 	u8                           sig_count;
 	struct ib_recv_wr	     rx_wr[ISER_MIN_POSTED_RX];
+	unsigned int 		     rx_desc_head;
+	struct iser_rx_desc	     *rx_descs;
 	struct iser_device          *device;
 	struct iser_comp	    *comp;
 	struct iser_fr_pool          fr_pool;
 	bool			     pi_support;
 	struct ib_cqe		     reg_cqe;
+	struct iser_conn	    *iser_conn;
+};
+
+/**
+ * struct iser_chan - additional RDMA channel of an iser connection
+ *
+ * @ib_conn:       channel RDMA resources, shares the leading
+ *                 connection fast registration pool
+ * @index:         channel index in the session (the leading
+ *                 connection is channel 0)
+ * @state:         channel logical state
+ * @up_completion: channel establishment completed (or failed)
+ */
+struct iser_chan {
+	struct ib_conn		     ib_conn;
+	int			     index;
+	enum iser_conn_state	     state;
+	struct completion	     up_completion;
 };
 
 /**
@@ -496,11 +575,15 @@ struct ib_conn {
  *                    (state is ISER_CONN_UP)
  * @conn_list:        entry in ig conn list
  * @login_desc:       login descriptor
- * @rx_desc_head:     head of rx_descs cyclic buffer
- * @rx_descs:         rx buffers array (cyclic buffer)
- * @num_rx_descs:     number of rx descriptors
+ * @num_rx_descs:     number of rx descriptors (per channel)
  * @scsi_sg_tablesize: scsi host sg_tablesize
  * @pages_per_mr:     maximum pages available for registration
+ * @snd_w_inv:        connection uses remote invalidation
+ * @dst_addr:         target address, used to connect channels
+ * @num_chans:        number of RDMA channels, including ib_conn
+ * @chan_cookie:      target session cookie for joining channels
+ * @chans:            additional channels (num_chans - 1 entries)
+ * @bounced_bytes:    payload bytes copied through bounce buffers
  */
 struct iser_conn {
 	struct ib_conn		     ib_conn;
@@ -519,12 +602,15 @@ struct iser_conn {
 	struct completion	     up_completion;
 	struct list_head	     conn_list;
 	struct iser_login_desc       login_desc;
-	unsigned int 		     rx_desc_head;
-	struct iser_rx_desc	     *rx_descs;
 	u32                          num_rx_descs;
 	unsigned short               scsi_sg_tablesize;
 	unsigned short               pages_per_mr;
 	bool			     snd_w_inv;
+	struct sockaddr_storage      dst_addr;
+	int			     num_chans;
+	u16			     chan_cookie;
+	struct iser_chan	     *chans;
+	u64			     bounced_bytes;
 };
 
 /**
@@ -532,6 +618,7 @@ struct iser_conn {
  *
  * @desc:     TX descriptor
  * @iser_conn:        link to iser connection
+ * @ib_conn:          RDMA channel the task is sent on
  * @status:           current task status
  * @sc:               link to scsi command
  * @command_sent:     indicate if command was sent
@@ -543,6 +630,7 @@ struct iser_conn {
 struct iscsi_iser_task {
 	struct iser_tx_desc          desc;
 	struct iser_conn	     *iser_conn;
+	struct ib_conn		     *ib_conn;
 	enum iser_task_status 	     status;
 	struct scsi_cmnd	     *sc;
 	int                          command_sent;
@@ -581,6 +669,7 @@ extern bool iser_pi_enable;
 extern int iser_pi_guard;
 extern unsigned int iser_max_sectors;
 extern bool iser_always_reg;
+extern unsigned int iser_num_channels;
 
 int iser_assign_reg_ops(struct iser_device *device);
 
@@ -605,6 +694,10 @@ void iser_conn_release(struct iser_conn *iser_conn);
 
 int iser_conn_terminate(struct iser_conn *iser_conn);
 
+int iser_connect_chans(struct iser_conn *iser_conn);
+
+void iser_free_chans(struct iser_conn *iser_conn);
+
 void iser_release_work(struct work_struct *work);
 
 void iser_err_comp(struct ib_wc *wc, const char *type);
@@ -642,7 +735,7 @@ void iser_unreg_mem_fastreg(struct iscsi_iser_task *iser_task,
 			    enum iser_data_dir cmd_dir);
 
 int  iser_post_recvl(struct iser_conn *iser_conn);
-int  iser_post_recvm(struct iser_conn *iser_conn, int count);
+int  iser_post_recvm(struct ib_conn *ib_conn, int count);
 int  iser_post_send(struct ib_conn *ib_conn, struct iser_tx_desc *tx_desc,
 		    bool signal);
 
@@ -667,6 +760,8 @@ int iser_alloc_fastreg_pool(struct ib_conn *ib_conn,
 			    unsigned cmds_max,
 			    unsigned int size);
 void iser_free_fastreg_pool(struct ib_conn *ib_conn);
+void iser_fr_pool_sysfs_add(struct iser_conn *iser_conn);
+void iser_fr_pool_sysfs_del(struct iser_conn *iser_conn);
 u8 iser_check_task_pi_status(struct iscsi_iser_task *iser_task,
 			     enum iser_data_dir cmd_dir, sector_t *sector);
 struct iser_fr_desc *
@@ -683,7 +778,15 @@ iser_reg_desc_put_fmr(struct ib_conn *ib_conn,
 static inline struct iser_conn *
 to_iser_conn(struct ib_conn *ib_conn)
 {
-	return container_of(ib_conn, struct iser_conn, ib_conn);
+	return ib_conn->iser_conn;
+}
+
+/* channel 0 is the leading connection, the rest live in chans[] */
+static inline struct ib_conn *
+iser_conn_chan(struct iser_conn *iser_conn, int index)
+{
+	return index ? &iser_conn->chans[index - 1].ib_conn :
+		       &iser_conn->ib_conn;
 }
 
 static inline struct iser_rx_desc *
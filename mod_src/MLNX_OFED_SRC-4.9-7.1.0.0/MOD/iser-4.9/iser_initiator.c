@@ -92,6 +92,40 @@ static int iser_prepare_read_cmd(struct iscsi_task *task)
 	return 0;
 }
 
+/*
+ * A write that is sent entirely as immediate data is never accessed
+ * remotely, so its (possibly unaligned) scatterlist can be gathered
+ * directly by the send WR with the local dma lkey. This skips both
+ * the memory registration and the bounce buffer fallback.
+ */
+static bool
+iser_gather_imm_data(struct iscsi_iser_task *iser_task,
+		     struct iser_data_buf *buf_out,
+		     unsigned int imm_sz)
+{
+	struct iser_device *device = iser_task->iser_conn->ib_conn.device;
+	struct ib_sge *tx_dsg = &iser_task->desc.tx_sg[1];
+	struct scatterlist *sg;
+	int i;
+
+	if (imm_sz != buf_out->data_len ||
+	    buf_out->dma_nents > device->max_imm_sge ||
+	    scsi_get_prot_op(iser_task->sc) != SCSI_PROT_NORMAL)
+		return false;
+
+	for_each_sg(buf_out->sg, sg, buf_out->dma_nents, i) {
+		tx_dsg[i].addr = sg_dma_address(sg);
+		tx_dsg[i].length = sg_dma_len(sg);
+		tx_dsg[i].lkey = device->pd->local_dma_lkey;
+	}
+	iser_task->desc.num_sge = buf_out->dma_nents + 1;
+
+	iser_dbg("WRITE, gathered imm.data sz: %d nents: %d\n",
+		 imm_sz, buf_out->dma_nents);
+
+	return true;
+}
+
 /* Register user buffer memory and initialize passive rdma
  *  dto descriptor. Data size is stored in
  *  task->data[ISER_DIR_OUT].data_len, Protection size
@@ -128,6 +162,10 @@ iser_prepare_write_cmd(struct iscsi_task *task,
 			return err;
 	}
 
+	if (buf_out->dma_nents > 1 &&
+	    iser_gather_imm_data(iser_task, buf_out, imm_sz))
+		return 0;
+
 	err = iser_reg_rdma_mem(iser_task, ISER_DIR_OUT,
 				buf_out->data_len == imm_sz);
 	if (err != 0) {
@@ -238,35 +276,22 @@ free_req:
 	return -ENOMEM;
 }
 
-int iser_alloc_rx_descriptors(struct iser_conn *iser_conn,
-			      struct iscsi_session *session)
+static int iser_alloc_rx_ring(struct iser_conn *iser_conn,
+			      struct ib_conn *ib_conn)
 {
 	int i, j;
 	u64 dma_addr;
 	struct iser_rx_desc *rx_desc;
 	struct ib_sge       *rx_sg;
-	struct ib_conn *ib_conn = &iser_conn->ib_conn;
-	struct iser_device *device = ib_conn->device;
-
-	iser_conn->qp_max_recv_dtos = session->cmds_max;
-	iser_conn->qp_max_recv_dtos_mask = session->cmds_max - 1; /* cmds_max is 2^N */
-	iser_conn->min_posted_rx = iser_conn->qp_max_recv_dtos >> 2;
-
-	if (device->reg_ops->alloc_reg_res(ib_conn, session->scsi_cmds_max,
-					   iser_conn->pages_per_mr))
-		goto create_rdma_reg_res_failed;
-
-	if (iser_alloc_login_buf(iser_conn))
-		goto alloc_login_buf_fail;
+	struct iser_device *device = iser_conn->ib_conn.device;
 
-	iser_conn->num_rx_descs = session->cmds_max;
-	iser_conn->rx_descs = kmalloc_array(iser_conn->num_rx_descs,
-					    sizeof(struct iser_rx_desc),
-					    GFP_KERNEL);
-	if (!iser_conn->rx_descs)
-		goto rx_desc_alloc_fail;
+	ib_conn->rx_descs = kmalloc_array(iser_conn->num_rx_descs,
+					  sizeof(struct iser_rx_desc),
+					  GFP_KERNEL);
+	if (!ib_conn->rx_descs)
+		return -ENOMEM;
 
-	rx_desc = iser_conn->rx_descs;
+	rx_desc = ib_conn->rx_descs;
 
 	for (i = 0; i < iser_conn->qp_max_recv_dtos; i++, rx_desc++)  {
 		dma_addr = ib_dma_map_single(device->ib_device, (void *)rx_desc,
@@ -282,17 +307,67 @@ int iser_alloc_rx_descriptors(struct iser_conn *iser_conn,
 		rx_sg->lkey = device->pd->local_dma_lkey;
 	}
 
-	iser_conn->rx_desc_head = 0;
+	ib_conn->rx_desc_head = 0;
 	return 0;
 
 rx_desc_dma_map_failed:
-	rx_desc = iser_conn->rx_descs;
+	rx_desc = ib_conn->rx_descs;
 	for (j = 0; j < i; j++, rx_desc++)
 		ib_dma_unmap_single(device->ib_device, rx_desc->dma_addr,
 				    ISER_RX_PAYLOAD_SIZE, DMA_FROM_DEVICE);
-	kfree(iser_conn->rx_descs);
-	iser_conn->rx_descs = NULL;
+	kfree(ib_conn->rx_descs);
+	ib_conn->rx_descs = NULL;
+	return -ENOMEM;
+}
+
+static void iser_free_rx_ring(struct iser_conn *iser_conn,
+			      struct ib_conn *ib_conn)
+{
+	int i;
+	struct iser_rx_desc *rx_desc;
+	struct iser_device *device = iser_conn->ib_conn.device;
+
+	if (!ib_conn->rx_descs)
+		return;
+
+	rx_desc = ib_conn->rx_descs;
+	for (i = 0; i < iser_conn->qp_max_recv_dtos; i++, rx_desc++)
+		ib_dma_unmap_single(device->ib_device, rx_desc->dma_addr,
+				    ISER_RX_PAYLOAD_SIZE, DMA_FROM_DEVICE);
+	kfree(ib_conn->rx_descs);
+	/* make sure we never redo any unmapping */
+	ib_conn->rx_descs = NULL;
+}
+
+int iser_alloc_rx_descriptors(struct iser_conn *iser_conn,
+			      struct iscsi_session *session)
+{
+	int i;
+	struct ib_conn *ib_conn = &iser_conn->ib_conn;
+	struct iser_device *device = ib_conn->device;
+
+	iser_conn->qp_max_recv_dtos = session->cmds_max;
+	iser_conn->qp_max_recv_dtos_mask = session->cmds_max - 1; /* cmds_max is 2^N */
+	iser_conn->min_posted_rx = iser_conn->qp_max_recv_dtos >> 2;
+
+	if (device->reg_ops->alloc_reg_res(ib_conn, session->scsi_cmds_max,
+					   iser_conn->pages_per_mr))
+		goto create_rdma_reg_res_failed;
+
+	if (iser_alloc_login_buf(iser_conn))
+		goto alloc_login_buf_fail;
+
+	/* every channel receives the responses of the commands it sent */
+	iser_conn->num_rx_descs = session->cmds_max;
+	for (i = 0; i < iser_conn->num_chans; i++)
+		if (iser_alloc_rx_ring(iser_conn, iser_conn_chan(iser_conn, i)))
+			goto rx_desc_alloc_fail;
+
+	return 0;
+
 rx_desc_alloc_fail:
+	while (--i >= 0)
+		iser_free_rx_ring(iser_conn, iser_conn_chan(iser_conn, i));
 	iser_free_login_buf(iser_conn);
 alloc_login_buf_fail:
 	device->reg_ops->free_reg_res(ib_conn);
@@ -304,20 +379,15 @@ create_rdma_reg_res_failed:
 void iser_free_rx_descriptors(struct iser_conn *iser_conn)
 {
 	int i;
-	struct iser_rx_desc *rx_desc;
 	struct ib_conn *ib_conn = &iser_conn->ib_conn;
 	struct iser_device *device = ib_conn->device;
 
+	iser_fr_pool_sysfs_del(iser_conn);
 	if (device->reg_ops->free_reg_res)
 		device->reg_ops->free_reg_res(ib_conn);
 
-	rx_desc = iser_conn->rx_descs;
-	for (i = 0; i < iser_conn->qp_max_recv_dtos; i++, rx_desc++)
-		ib_dma_unmap_single(device->ib_device, rx_desc->dma_addr,
-				    ISER_RX_PAYLOAD_SIZE, DMA_FROM_DEVICE);
-	kfree(iser_conn->rx_descs);
-	/* make sure we never redo any unmapping */
-	iser_conn->rx_descs = NULL;
+	for (i = 0; i < iser_conn->num_chans; i++)
+		iser_free_rx_ring(iser_conn, iser_conn_chan(iser_conn, i));
 
 	iser_free_login_buf(iser_conn);
 }
@@ -329,6 +399,7 @@ static int iser_post_rx_bufs(struct iscsi_conn *conn, struct iscsi_hdr *req)
 #ifdef HAVE_ISCSI_DISCOVERY_SESSION
 	struct iscsi_session *session = conn->session;
 #endif
+	int i;
 
 	iser_dbg("req op %x flags %x\n", req->opcode, req->flags);
 	/* check if this is the last login - going to full feature phase */
@@ -350,8 +421,10 @@ static int iser_post_rx_bufs(struct iscsi_conn *conn, struct iscsi_hdr *req)
 			  iser_conn->min_posted_rx);
 #endif
 	/* Initial post receive buffers */
-	if (iser_post_recvm(iser_conn, iser_conn->min_posted_rx))
-		return -ENOMEM;
+	for (i = 0; i < iser_conn->num_chans; i++)
+		if (iser_post_recvm(iser_conn_chan(iser_conn, i),
+				    iser_conn->min_posted_rx))
+			return -ENOMEM;
 
 	return 0;
 }
@@ -379,7 +452,8 @@ int iser_send_command(struct iscsi_conn *conn,
 #endif
 	struct scsi_cmnd *sc  =  task->sc;
 	struct iser_tx_desc *tx_desc = &iser_task->desc;
-	u8 sig_count = ++iser_conn->ib_conn.sig_count;
+	struct ib_conn *ib_conn = iser_task->ib_conn;
+	u8 sig_count = ++ib_conn->sig_count;
 
 	edtl = ntohl(hdr->data_length);
 
@@ -426,7 +500,7 @@ int iser_send_command(struct iscsi_conn *conn,
 
 	iser_task->status = ISER_TASK_STATUS_STARTED;
 
-	err = iser_post_send(&iser_conn->ib_conn, tx_desc,
+	err = iser_post_send(ib_conn, tx_desc,
 			     iser_signal_comp(sig_count));
 	if (!err)
 		return 0;
@@ -443,7 +517,6 @@ int iser_send_data_out(struct iscsi_conn *conn,
 		       struct iscsi_task *task,
 		       struct iscsi_data *hdr)
 {
-	struct iser_conn *iser_conn = conn->dd_data;
 	struct iscsi_iser_task *iser_task = task->dd_data;
 	struct iser_tx_desc *tx_desc;
 	struct iser_mem_reg *mem_reg;
@@ -492,7 +565,8 @@ int iser_send_data_out(struct iscsi_conn *conn,
 		 itt, buf_offset, data_seg_len);
 
 
-	err = iser_post_send(&iser_conn->ib_conn, tx_desc, true);
+	/* data-outs must follow their command on the same channel */
+	err = iser_post_send(iser_task->ib_conn, tx_desc, true);
 	if (!err)
 		return 0;
 
@@ -747,7 +821,7 @@ void iser_task_rsp(struct ib_cq *cq, struct ib_wc *wc)
 	if (outstanding + iser_conn->min_posted_rx <= iser_conn->qp_max_recv_dtos) {
 		count = min(iser_conn->qp_max_recv_dtos - outstanding,
 			    iser_conn->min_posted_rx);
-		err = iser_post_recvm(iser_conn, count);
+		err = iser_post_recvm(ib_conn, count);
 		if (err)
 			iser_err("posting %d rx bufs err %d\n", count, err);
 	}
@@ -335,18 +335,48 @@ int iser_assign_reg_ops(struct iser_device *device)
 	return 0;
 }
 
+/*
+ * Descriptors are taken from and returned to a per cpu cache with only
+ * local interrupts disabled (puts come from completion context). The
+ * shared pool list and its lock are touched once per ISER_FR_CACHE_BATCH
+ * descriptors, and a drained list kicks the pool grow work.
+ */
 struct iser_fr_desc *
 iser_reg_desc_get_fr(struct ib_conn *ib_conn)
 {
 	struct iser_fr_pool *fr_pool = &ib_conn->fr_pool;
-	struct iser_fr_desc *desc;
+	struct iser_fr_cache *cache;
+	struct iser_fr_desc *desc = NULL;
 	unsigned long flags;
 
-	spin_lock_irqsave(&fr_pool->lock, flags);
-	desc = list_first_entry(&fr_pool->list,
-				struct iser_fr_desc, list);
-	list_del(&desc->list);
-	spin_unlock_irqrestore(&fr_pool->lock, flags);
+	local_irq_save(flags);
+	cache = this_cpu_ptr(fr_pool->cache);
+	if (likely(cache->count)) {
+		cache->hits++;
+		desc = cache->descs[--cache->count];
+		local_irq_restore(flags);
+		return desc;
+	}
+
+	cache->misses++;
+	spin_lock(&fr_pool->lock);
+	while (fr_pool->free && cache->count < ISER_FR_CACHE_BATCH) {
+		desc = list_first_entry(&fr_pool->list,
+					struct iser_fr_desc, list);
+		list_del(&desc->list);
+		fr_pool->free--;
+		cache->descs[cache->count++] = desc;
+	}
+	if (cache->count)
+		desc = cache->descs[--cache->count];
+	else
+		fr_pool->starved++;
+
+	if (fr_pool->free < ISER_FR_CACHE_BATCH &&
+	    fr_pool->size < fr_pool->max_size)
+		schedule_work(&fr_pool->grow_work);
+	spin_unlock(&fr_pool->lock);
+	local_irq_restore(flags);
 
 	return desc;
 }
@@ -356,11 +386,22 @@ iser_reg_desc_put_fr(struct ib_conn *ib_conn,
 		     struct iser_fr_desc *desc)
 {
 	struct iser_fr_pool *fr_pool = &ib_conn->fr_pool;
+	struct iser_fr_cache *cache;
 	unsigned long flags;
 
-	spin_lock_irqsave(&fr_pool->lock, flags);
-	list_add(&desc->list, &fr_pool->list);
-	spin_unlock_irqrestore(&fr_pool->lock, flags);
+	local_irq_save(flags);
+	cache = this_cpu_ptr(fr_pool->cache);
+	if (unlikely(cache->count == ISER_FR_CACHE_SIZE)) {
+		spin_lock(&fr_pool->lock);
+		while (cache->count > ISER_FR_CACHE_SIZE - ISER_FR_CACHE_BATCH) {
+			list_add(&cache->descs[--cache->count]->list,
+				 &fr_pool->list);
+			fr_pool->free++;
+		}
+		spin_unlock(&fr_pool->lock);
+	}
+	cache->descs[cache->count++] = desc;
+	local_irq_restore(flags);
 }
 
 struct iser_fr_desc *
@@ -410,6 +451,7 @@ static int fall_to_bounce_buf(struct iscsi_iser_task *iser_task,
 	struct iser_device *device = iser_task->iser_conn->ib_conn.device;
 
 	iscsi_conn->fmr_unalign_cnt++;
+	iser_task->iser_conn->bounced_bytes += mem->data_len;
 
 	if (iser_debug_level > 0)
 		iser_data_buf_dump(mem, device->ib_device);
@@ -887,6 +929,11 @@ int iser_reg_rdma_mem(struct iscsi_iser_task *task,
 
 	if (!use_dma_key) {
 		desc = device->reg_ops->reg_desc_get(ib_conn);
+		if (unlikely(!desc)) {
+			/* pool is growing, let the command be retried */
+			err = -ENOMEM;
+			goto err_reg;
+		}
 		reg->mem_h = desc;
 	}
 
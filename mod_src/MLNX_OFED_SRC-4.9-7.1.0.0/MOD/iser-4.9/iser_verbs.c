@@ -44,6 +44,8 @@
 #define ISER_MAX_CQ_LEN		(ISER_MAX_RX_LEN + ISER_MAX_TX_LEN + \
 				 ISCSI_ISER_MAX_CONN)
 
+static void iser_free_chan_res(struct iser_chan *chan);
+
 static void iser_qp_event_callback(struct ib_event *cause, void *context)
 {
 	iser_err("qp event %s (%d)\n",
@@ -76,6 +78,9 @@ static int iser_create_device_ib_res(struct iser_device *device)
 
 	device->comps_used = min_t(int, num_online_cpus(),
 				 ib_dev->num_comp_vectors);
+	/* sge 0 always carries the iser/iscsi headers */
+	device->max_imm_sge = clamp_t(int, ib_dev->attrs.max_send_sge - 1,
+				      1, ISER_MAX_IMM_SGE);
 
 	device->comps = kcalloc(device->comps_used, sizeof(*device->comps),
 				GFP_KERNEL);
@@ -292,6 +297,59 @@ static void iser_destroy_fastreg_desc(struct iser_fr_desc *desc)
 	kfree(desc);
 }
 
+static int iser_fr_pool_add_desc(struct ib_conn *ib_conn, bool grow)
+{
+	struct iser_device *device = ib_conn->device;
+	struct iser_fr_pool *fr_pool = &ib_conn->fr_pool;
+	struct iser_fr_desc *desc;
+	unsigned long flags;
+
+	desc = iser_create_fastreg_desc(device, device->pd,
+					ib_conn->pi_support,
+					fr_pool->mr_size);
+	if (IS_ERR(desc))
+		return PTR_ERR(desc);
+
+	spin_lock_irqsave(&fr_pool->lock, flags);
+	list_add_tail(&desc->list, &fr_pool->list);
+	list_add_tail(&desc->all_list, &fr_pool->all_list);
+	fr_pool->size++;
+	fr_pool->free++;
+	if (grow)
+		fr_pool->grown++;
+	spin_unlock_irqrestore(&fr_pool->lock, flags);
+
+	return 0;
+}
+
+/*
+ * Runs when a get found the pool list (nearly) drained: descriptors may
+ * be parked in other cpus caches or a burst of large I/Os may need more
+ * registrations than scsi_cmds_max accounted for.
+ */
+static void iser_fr_pool_grow_work(struct work_struct *work)
+{
+	struct iser_fr_pool *fr_pool = container_of(work, struct iser_fr_pool,
+						    grow_work);
+	struct ib_conn *ib_conn = container_of(fr_pool, struct ib_conn,
+					       fr_pool);
+	int i, ret;
+
+	for (i = 0; i < ISER_FR_POOL_GROW; i++) {
+		if (READ_ONCE(fr_pool->size) >= fr_pool->max_size)
+			break;
+
+		ret = iser_fr_pool_add_desc(ib_conn, true);
+		if (ret) {
+			iser_warn("conn %p failed to grow fr pool, err %d\n",
+				  ib_conn, ret);
+			break;
+		}
+	}
+
+	iser_dbg("conn %p fr pool size %d\n", ib_conn, fr_pool->size);
+}
+
 /**
  * iser_alloc_fastreg_pool - Creates pool of fast_reg descriptors
  * for fast registration work requests.
@@ -301,26 +359,29 @@ int iser_alloc_fastreg_pool(struct ib_conn *ib_conn,
 			    unsigned cmds_max,
 			    unsigned int size)
 {
-	struct iser_device *device = ib_conn->device;
 	struct iser_fr_pool *fr_pool = &ib_conn->fr_pool;
-	struct iser_fr_desc *desc;
 	int i, ret;
 
 	INIT_LIST_HEAD(&fr_pool->list);
 	INIT_LIST_HEAD(&fr_pool->all_list);
 	spin_lock_init(&fr_pool->lock);
+	INIT_WORK(&fr_pool->grow_work, iser_fr_pool_grow_work);
 	fr_pool->size = 0;
+	fr_pool->free = 0;
+	fr_pool->grown = 0;
+	fr_pool->starved = 0;
+	fr_pool->mr_size = size;
+	fr_pool->max_size = cmds_max +
+			    num_possible_cpus() * ISER_FR_CACHE_SIZE;
+
+	fr_pool->cache = alloc_percpu(struct iser_fr_cache);
+	if (!fr_pool->cache)
+		return -ENOMEM;
+
 	for (i = 0; i < cmds_max; i++) {
-		desc = iser_create_fastreg_desc(device, device->pd,
-						ib_conn->pi_support, size);
-		if (IS_ERR(desc)) {
-			ret = PTR_ERR(desc);
+		ret = iser_fr_pool_add_desc(ib_conn, false);
+		if (ret)
 			goto err;
-		}
-
-		list_add_tail(&desc->list, &fr_pool->list);
-		list_add_tail(&desc->all_list, &fr_pool->all_list);
-		fr_pool->size++;
 	}
 
 	return 0;
@@ -339,10 +400,18 @@ void iser_free_fastreg_pool(struct ib_conn *ib_conn)
 	struct iser_fr_desc *desc, *tmp;
 	int i = 0;
 
+	if (!fr_pool->cache)
+		return;
+
+	cancel_work_sync(&fr_pool->grow_work);
+	free_percpu(fr_pool->cache);
+	fr_pool->cache = NULL;
+
 	if (list_empty(&fr_pool->all_list))
 		return;
 
-	iser_info("freeing conn %p fr pool\n", ib_conn);
+	iser_info("freeing conn %p fr pool, %d descriptors (%lu grown)\n",
+		  ib_conn, fr_pool->size, fr_pool->grown);
 
 	list_for_each_entry_safe(desc, tmp, &fr_pool->all_list, all_list) {
 		list_del(&desc->all_list);
@@ -355,6 +424,111 @@ void iser_free_fastreg_pool(struct ib_conn *ib_conn)
 			  fr_pool->size - i);
 }
 
+struct iser_fr_pool_stats {
+	int		size;
+	int		free;
+	int		cached;
+	unsigned long	hits;
+	unsigned long	misses;
+	unsigned long	grown;
+	unsigned long	starved;
+};
+
+static void iser_fr_pool_get_stats(struct iser_fr_pool *fr_pool,
+				   struct iser_fr_pool_stats *stats)
+{
+	struct iser_fr_cache *cache;
+	unsigned long flags;
+	int cpu;
+
+	memset(stats, 0, sizeof(*stats));
+	for_each_possible_cpu(cpu) {
+		cache = per_cpu_ptr(fr_pool->cache, cpu);
+		stats->cached += READ_ONCE(cache->count);
+		stats->hits += READ_ONCE(cache->hits);
+		stats->misses += READ_ONCE(cache->misses);
+	}
+
+	spin_lock_irqsave(&fr_pool->lock, flags);
+	stats->size = fr_pool->size;
+	stats->free = fr_pool->free;
+	stats->grown = fr_pool->grown;
+	stats->starved = fr_pool->starved;
+	spin_unlock_irqrestore(&fr_pool->lock, flags);
+}
+
+#define ISER_FR_POOL_ATTR(_name, _val)					\
+static ssize_t iser_fr_pool_##_name##_show(struct device *dev,		\
+					   struct device_attribute *attr,\
+					   char *buf)			\
+{									\
+	struct iscsi_endpoint *ep = iscsi_dev_to_endpoint(dev);	\
+	struct iser_conn *iser_conn = ep->dd_data;			\
+	struct iser_fr_pool_stats stats;				\
+									\
+	iser_fr_pool_get_stats(&iser_conn->ib_conn.fr_pool, &stats);	\
+	return sprintf(buf, "%ld\n", (long)(_val));			\
+}									\
+static DEVICE_ATTR(_name, S_IRUGO, iser_fr_pool_##_name##_show, NULL)
+
+ISER_FR_POOL_ATTR(size, stats.size);
+ISER_FR_POOL_ATTR(in_use, stats.size - stats.free - stats.cached);
+ISER_FR_POOL_ATTR(cached, stats.cached);
+ISER_FR_POOL_ATTR(cache_hits, stats.hits);
+ISER_FR_POOL_ATTR(cache_misses, stats.misses);
+ISER_FR_POOL_ATTR(grown, stats.grown);
+ISER_FR_POOL_ATTR(starved, stats.starved);
+
+static struct attribute *iser_fr_pool_attrs[] = {
+	&dev_attr_size.attr,
+	&dev_attr_in_use.attr,
+	&dev_attr_cached.attr,
+	&dev_attr_cache_hits.attr,
+	&dev_attr_cache_misses.attr,
+	&dev_attr_grown.attr,
+	&dev_attr_starved.attr,
+	NULL,
+};
+
+static const struct attribute_group iser_fr_pool_attr_group = {
+	.name = "fr_pool",
+	.attrs = iser_fr_pool_attrs,
+};
+
+/**
+ * iser_fr_pool_sysfs_add - expose fastreg pool usage under the
+ * connection iscsi endpoint (/sys/class/iscsi_endpoint/endpoint-N/fr_pool)
+ */
+void iser_fr_pool_sysfs_add(struct iser_conn *iser_conn)
+{
+	struct iser_fr_pool *fr_pool = &iser_conn->ib_conn.fr_pool;
+
+	if (!fr_pool->cache || fr_pool->sysfs)
+		return;
+
+	if (sysfs_create_group(&iser_conn->ep->dev.kobj,
+			       &iser_fr_pool_attr_group))
+		iser_warn("iser_conn %p failed to create fr_pool attributes\n",
+			  iser_conn);
+	else
+		fr_pool->sysfs = true;
+}
+
+/**
+ * iser_fr_pool_sysfs_del - remove the fastreg pool attributes, must be
+ * called before the pool or the endpoint go away
+ */
+void iser_fr_pool_sysfs_del(struct iser_conn *iser_conn)
+{
+	struct iser_fr_pool *fr_pool = &iser_conn->ib_conn.fr_pool;
+
+	if (!fr_pool->sysfs)
+		return;
+
+	sysfs_remove_group(&iser_conn->ep->dev.kobj, &iser_fr_pool_attr_group);
+	fr_pool->sysfs = false;
+}
+
 /**
  * iser_create_ib_conn_res - Queue-Pair (QP)
  *
@@ -368,6 +542,7 @@ static int iser_create_ib_conn_res(struct ib_conn *ib_conn)
 	struct ib_qp_init_attr	init_attr;
 	int			ret = -ENOMEM;
 	int index, min_index = 0;
+	unsigned int max_cmds;
 
 	BUG_ON(ib_conn->device == NULL);
 
@@ -393,29 +568,29 @@ static int iser_create_ib_conn_res(struct ib_conn *ib_conn)
 	init_attr.send_cq	= ib_conn->comp->cq;
 	init_attr.recv_cq	= ib_conn->comp->cq;
 	init_attr.cap.max_recv_wr  = ISER_QP_MAX_RECV_DTOS;
-	init_attr.cap.max_send_sge = 2;
+	init_attr.cap.max_send_sge = device->max_imm_sge + 1;
 	init_attr.cap.max_recv_sge = 1;
 	init_attr.sq_sig_type	= IB_SIGNAL_REQ_WR;
 	init_attr.qp_type	= IB_QPT_RC;
 	if (ib_conn->pi_support) {
 		init_attr.cap.max_send_wr = ISER_QP_SIG_MAX_REQ_DTOS + 1;
 		init_attr.create_flags |= IB_QP_CREATE_INTEGRITY_EN;
-		iser_conn->max_cmds =
-			ISER_GET_MAX_XMIT_CMDS(ISER_QP_SIG_MAX_REQ_DTOS);
+		max_cmds = ISER_GET_MAX_XMIT_CMDS(ISER_QP_SIG_MAX_REQ_DTOS);
 	} else {
 		if (ib_dev->attrs.max_qp_wr > ISER_QP_MAX_REQ_DTOS) {
 			init_attr.cap.max_send_wr  = ISER_QP_MAX_REQ_DTOS + 1;
-			iser_conn->max_cmds =
-				ISER_GET_MAX_XMIT_CMDS(ISER_QP_MAX_REQ_DTOS);
+			max_cmds = ISER_GET_MAX_XMIT_CMDS(ISER_QP_MAX_REQ_DTOS);
 		} else {
 			init_attr.cap.max_send_wr = ib_dev->attrs.max_qp_wr;
-			iser_conn->max_cmds =
-				ISER_GET_MAX_XMIT_CMDS(ib_dev->attrs.max_qp_wr);
+			max_cmds = ISER_GET_MAX_XMIT_CMDS(ib_dev->attrs.max_qp_wr);
 			iser_dbg("device %s supports max_send_wr %d\n",
 				 dev_name(&device->ib_device->dev),
 				 ib_dev->attrs.max_qp_wr);
 		}
 	}
+	/* channels share the session queue depth set up by the lead QP */
+	if (ib_conn == &iser_conn->ib_conn)
+		iser_conn->max_cmds = max_cmds;
 
 	ret = rdma_create_qp(ib_conn->cma_id, device->pd, &init_attr);
 	if (ret)
@@ -553,7 +728,17 @@ static void iser_free_ib_conn_res(struct iser_conn *iser_conn,
 	}
 
 	if (destroy) {
-		if (iser_conn->rx_descs)
+		int i;
+
+		/*
+		 * The rx rings of all channels go away with the lead's
+		 * descriptors, so the channel QPs (and their receive
+		 * queues) must be gone first.
+		 */
+		for (i = 0; iser_conn->chans && i < iser_conn->num_chans - 1; i++)
+			iser_free_chan_res(&iser_conn->chans[i]);
+
+		if (ib_conn->rx_descs)
 			iser_free_rx_descriptors(iser_conn);
 
 		if (device != NULL) {
@@ -579,6 +764,7 @@ void iser_conn_release(struct iser_conn *iser_conn)
 	if (iser_conn->state != ISER_CONN_DOWN) {
 		iser_warn("iser conn %p state %d, expected state down.\n",
 			  iser_conn, iser_conn->state);
+		iser_fr_pool_sysfs_del(iser_conn);
 		iscsi_destroy_endpoint(iser_conn->ep);
 		iser_conn->state = ISER_CONN_DOWN;
 	}
@@ -589,6 +775,8 @@ void iser_conn_release(struct iser_conn *iser_conn)
 	iser_free_ib_conn_res(iser_conn, true);
 	mutex_unlock(&iser_conn->state_mutex);
 
+	iser_free_chans(iser_conn);
+
 	if (ib_conn->cma_id != NULL) {
 		rdma_destroy_id(ib_conn->cma_id);
 		ib_conn->cma_id = NULL;
@@ -604,7 +792,7 @@ void iser_conn_release(struct iser_conn *iser_conn)
 int iser_conn_terminate(struct iser_conn *iser_conn)
 {
 	struct ib_conn *ib_conn = &iser_conn->ib_conn;
-	int err = 0;
+	int i, err = 0;
 
 	/* terminate the iser conn only if the conn state is UP */
 	if (!iser_conn_state_comp_exch(iser_conn, ISER_CONN_UP,
@@ -632,6 +820,22 @@ int iser_conn_terminate(struct iser_conn *iser_conn)
 		ib_drain_sq(ib_conn->qp);
 	}
 
+	for (i = 0; i < iser_conn->num_chans - 1; i++) {
+		struct iser_chan *chan = &iser_conn->chans[i];
+
+		if (chan->state != ISER_CONN_UP)
+			continue;
+
+		chan->state = ISER_CONN_TERMINATING;
+		err = rdma_disconnect(chan->ib_conn.cma_id);
+		if (err)
+			iser_err("Failed to disconnect, conn: 0x%p chan %d err %d\n",
+				 iser_conn, chan->index, err);
+
+		/* flush posted receives too, their buffers are freed with the lead */
+		ib_drain_qp(chan->ib_conn.qp);
+	}
+
 	return 1;
 }
 
@@ -742,7 +946,7 @@ static void iser_route_handler(struct rdma_cm_id *cma_id)
 {
 	struct rdma_conn_param conn_param;
 	int    ret;
-	struct iser_cm_hdr req_hdr;
+	struct iser_cm_priv req_hdr;
 	struct iser_conn *iser_conn = (struct iser_conn *)cma_id->context;
 	struct ib_conn *ib_conn = &iser_conn->ib_conn;
 	struct iser_device *device = ib_conn->device;
@@ -762,12 +966,23 @@ static void iser_route_handler(struct rdma_cm_id *cma_id)
 	conn_param.rnr_retry_count     = 6;
 
 	memset(&req_hdr, 0, sizeof(req_hdr));
-	req_hdr.flags = ISER_ZBVA_NOT_SUP;
+	req_hdr.hdr.flags = ISER_ZBVA_NOT_SUP;
 	if (!device->remote_inv_sup)
-		req_hdr.flags |= ISER_SEND_W_INV_NOT_SUP;
+		req_hdr.hdr.flags |= ISER_SEND_W_INV_NOT_SUP;
 	conn_param.private_data	= (void *)&req_hdr;
 	conn_param.private_data_len = sizeof(struct iser_cm_hdr);
 
+	/* no point in more channels than completion vectors */
+	iser_conn->num_chans = clamp_t(unsigned int, iser_num_channels, 1,
+				       min_t(unsigned int, ISER_MAX_CHANNELS,
+					     device->comps_used));
+	if (iser_conn->num_chans > 1) {
+		req_hdr.mchan.magic = cpu_to_be16(ISER_MCHAN_MAGIC);
+		req_hdr.mchan.op = ISER_MCHAN_REQ;
+		req_hdr.mchan.nr_chans = iser_conn->num_chans;
+		conn_param.private_data_len = sizeof(req_hdr);
+	}
+
 	ret = rdma_connect_locked(cma_id, &conn_param);
 	if (ret) {
 		iser_err("failure connecting: %d\n", ret);
@@ -780,7 +995,8 @@ failure:
 }
 
 static void iser_connected_handler(struct rdma_cm_id *cma_id,
-				   const void *private_data)
+				   const void *private_data,
+				   u8 private_data_len)
 {
 	struct iser_conn *iser_conn;
 	struct ib_qp_attr attr;
@@ -795,13 +1011,36 @@ static void iser_connected_handler(struct rdma_cm_id *cma_id,
 	iser_info("remote qpn:%x my qpn:%x\n", attr.dest_qp_num, cma_id->qp->qp_num);
 
 	if (private_data) {
-		u8 flags = *(u8 *)private_data;
+		const struct iser_cm_hdr *rep_hdr = private_data;
+		const struct iser_mchan_hdr *ack;
+
+		iser_conn->snd_w_inv = !(rep_hdr->flags & ISER_SEND_W_INV_NOT_SUP);
+
+		/* a target that does not know about channels never acks */
+		ack = iser_cm_mchan(private_data, private_data_len,
+				    ISERT_MCHAN_ACK);
+		if (ack && ack->nr_chans > 1) {
+			iser_conn->num_chans = min_t(int, iser_conn->num_chans,
+						     ack->nr_chans);
+			iser_conn->chan_cookie = be16_to_cpu(ack->cookie);
+		} else {
+			iser_conn->num_chans = 1;
+		}
+	} else {
+		iser_conn->num_chans = 1;
+	}
 
-		iser_conn->snd_w_inv = !(flags & ISER_SEND_W_INV_NOT_SUP);
+	if (iser_conn->num_chans > 1) {
+		iser_conn->chans = kcalloc(iser_conn->num_chans - 1,
+					   sizeof(*iser_conn->chans),
+					   GFP_KERNEL);
+		if (!iser_conn->chans)
+			iser_conn->num_chans = 1;
 	}
 
-	iser_info("conn %p: negotiated %s invalidation\n",
-		  iser_conn, iser_conn->snd_w_inv ? "remote" : "local");
+	iser_info("conn %p: negotiated %s invalidation, %d channels\n",
+		  iser_conn, iser_conn->snd_w_inv ? "remote" : "local",
+		  iser_conn->num_chans);
 
 	iser_conn->state = ISER_CONN_UP;
 	complete(&iser_conn->up_completion);
@@ -854,7 +1093,8 @@ static int iser_cma_handler(struct rdma_cm_id *cma_id, struct rdma_cm_event *eve
 		iser_route_handler(cma_id);
 		break;
 	case RDMA_CM_EVENT_ESTABLISHED:
-		iser_connected_handler(cma_id, event->param.conn.private_data);
+		iser_connected_handler(cma_id, event->param.conn.private_data,
+				       event->param.conn.private_data_len);
 		break;
 	case RDMA_CM_EVENT_REJECTED:
 		iser_info("Connection rejected: %s\n",
@@ -894,6 +1134,248 @@ static int iser_cma_handler(struct rdma_cm_id *cma_id, struct rdma_cm_event *eve
 	return ret;
 }
 
+/**
+ * Called with the lead connection state mutex held
+ **/
+static void iser_chan_route_handler(struct iser_chan *chan)
+{
+	struct ib_conn *ib_conn = &chan->ib_conn;
+	struct iser_conn *iser_conn = ib_conn->iser_conn;
+	struct iser_device *device = ib_conn->device;
+	struct rdma_conn_param conn_param;
+	struct iser_cm_priv req_hdr;
+	int ret;
+
+	ib_conn->pi_support = iser_conn->ib_conn.pi_support;
+	ret = iser_create_ib_conn_res(ib_conn);
+	if (ret)
+		goto failure;
+
+	memset(&conn_param, 0, sizeof conn_param);
+	conn_param.responder_resources = device->ib_device->attrs.max_qp_rd_atom;
+	conn_param.initiator_depth     = 1;
+	conn_param.retry_count	       = 7;
+	conn_param.rnr_retry_count     = 6;
+
+	memset(&req_hdr, 0, sizeof(req_hdr));
+	req_hdr.hdr.flags = ISER_ZBVA_NOT_SUP;
+	if (!device->remote_inv_sup)
+		req_hdr.hdr.flags |= ISER_SEND_W_INV_NOT_SUP;
+	req_hdr.mchan.magic = cpu_to_be16(ISER_MCHAN_MAGIC);
+	req_hdr.mchan.op = ISER_MCHAN_JOIN;
+	req_hdr.mchan.index = chan->index;
+	req_hdr.mchan.cookie = cpu_to_be16(iser_conn->chan_cookie);
+	conn_param.private_data	= (void *)&req_hdr;
+	conn_param.private_data_len = sizeof(req_hdr);
+
+	ret = rdma_connect_locked(ib_conn->cma_id, &conn_param);
+	if (ret) {
+		iser_err("failure connecting chan %d: %d\n", chan->index, ret);
+		goto failure;
+	}
+
+	return;
+failure:
+	chan->state = ISER_CONN_TERMINATING;
+	complete(&chan->up_completion);
+}
+
+/**
+ * Called with the lead connection state mutex held
+ **/
+static void iser_free_chan_res(struct iser_chan *chan)
+{
+	struct ib_conn *ib_conn = &chan->ib_conn;
+
+	if (ib_conn->qp != NULL) {
+		/* no flush completion may still reference the rx ring */
+		ib_drain_qp(ib_conn->qp);
+		mutex_lock(&ig.connlist_mutex);
+		ib_conn->comp->active_qps--;
+		mutex_unlock(&ig.connlist_mutex);
+		rdma_destroy_qp(ib_conn->cma_id);
+		ib_conn->qp = NULL;
+	}
+
+	if (ib_conn->device != NULL) {
+		iser_device_try_release(ib_conn->device);
+		ib_conn->device = NULL;
+	}
+}
+
+static int iser_chan_cma_handler(struct rdma_cm_id *cma_id,
+				 struct rdma_cm_event *event)
+{
+	struct iser_chan *chan = cma_id->context;
+	struct ib_conn *ib_conn = &chan->ib_conn;
+	struct iser_conn *iser_conn = ib_conn->iser_conn;
+	struct iser_device *device;
+	int ret = 0;
+
+	iser_info("%s (%d): status %d conn %p chan %d id %p\n",
+		  rdma_event_msg(event->event), event->event,
+		  event->status, iser_conn, chan->index, cma_id);
+
+	mutex_lock(&iser_conn->state_mutex);
+	switch (event->event) {
+	case RDMA_CM_EVENT_ADDR_RESOLVED:
+		if (chan->state != ISER_CONN_PENDING)
+			break;
+		device = iser_device_find_by_ib_device(cma_id);
+		if (!device) {
+			iser_err("device lookup/creation failed\n");
+			goto chan_error;
+		}
+		ib_conn->device = device;
+		/* channels share the lead's PD and registration pool */
+		if (device != iser_conn->ib_conn.device) {
+			iser_err("chan %d resolved to a different device\n",
+				 chan->index);
+			goto chan_error;
+		}
+		if (rdma_resolve_route(cma_id, 1000))
+			goto chan_error;
+		break;
+	case RDMA_CM_EVENT_ROUTE_RESOLVED:
+		if (chan->state == ISER_CONN_PENDING)
+			iser_chan_route_handler(chan);
+		break;
+	case RDMA_CM_EVENT_ESTABLISHED:
+		if (chan->state == ISER_CONN_PENDING) {
+			chan->state = ISER_CONN_UP;
+			complete(&chan->up_completion);
+		}
+		break;
+	case RDMA_CM_EVENT_REJECTED:
+		iser_info("Channel rejected: %s\n",
+			 rdma_reject_msg(cma_id, event->status));
+		/* FALLTHROUGH */
+	case RDMA_CM_EVENT_ADDR_ERROR:
+	case RDMA_CM_EVENT_ROUTE_ERROR:
+	case RDMA_CM_EVENT_CONNECT_ERROR:
+	case RDMA_CM_EVENT_UNREACHABLE:
+		goto chan_error;
+	case RDMA_CM_EVENT_DISCONNECTED:
+	case RDMA_CM_EVENT_ADDR_CHANGE:
+	case RDMA_CM_EVENT_TIMEWAIT_EXIT:
+	case RDMA_CM_EVENT_DEVICE_REMOVAL:
+		/* a session cannot survive losing one of its channels */
+		if (chan->state == ISER_CONN_UP) {
+			chan->state = ISER_CONN_TERMINATING;
+			if (iser_conn->state == ISER_CONN_UP &&
+			    iser_conn->iscsi_conn)
+				iscsi_conn_failure(iser_conn->iscsi_conn,
+						   ISCSI_ERR_CONN_FAILED);
+		}
+		if (event->event == RDMA_CM_EVENT_DEVICE_REMOVAL) {
+			iser_free_chan_res(chan);
+			ib_conn->cma_id = NULL;
+			ret = 1;
+		}
+		break;
+	default:
+		iser_err("Unexpected RDMA CM event: %s (%d)\n",
+			 rdma_event_msg(event->event), event->event);
+		break;
+	}
+	mutex_unlock(&iser_conn->state_mutex);
+
+	return ret;
+
+chan_error:
+	chan->state = ISER_CONN_TERMINATING;
+	complete(&chan->up_completion);
+	mutex_unlock(&iser_conn->state_mutex);
+
+	return 0;
+}
+
+/**
+ * iser_connect_chans - connect the additional session channels
+ * @iser_conn: iser connection with a negotiated channel count
+ *
+ * Each channel is an RC QP of its own, bound to its own completion
+ * vector, that joins the lead connection using the cookie handed out
+ * by the target. Sleeps until all channels are established.
+ */
+int iser_connect_chans(struct iser_conn *iser_conn)
+{
+	struct iser_chan *chan;
+	struct ib_conn *ib_conn;
+	int i, err;
+
+	for (i = 0; i < iser_conn->num_chans - 1; i++) {
+		chan = &iser_conn->chans[i];
+		ib_conn = &chan->ib_conn;
+
+		ib_conn->iser_conn = iser_conn;
+		ib_conn->reg_cqe.done = iser_reg_comp;
+		chan->index = i + 1;
+		chan->state = ISER_CONN_PENDING;
+		init_completion(&chan->up_completion);
+
+		ib_conn->cma_id = rdma_create_id(&init_net,
+						 iser_chan_cma_handler,
+						 (void *)chan,
+						 RDMA_PS_TCP, IB_QPT_RC);
+		if (IS_ERR(ib_conn->cma_id)) {
+			err = PTR_ERR(ib_conn->cma_id);
+			ib_conn->cma_id = NULL;
+			iser_err("rdma_create_id failed: %d\n", err);
+			return err;
+		}
+
+		err = rdma_resolve_addr(ib_conn->cma_id, NULL,
+					(struct sockaddr *)&iser_conn->dst_addr,
+					1000);
+		if (err) {
+			iser_err("rdma_resolve_addr failed: %d\n", err);
+			return err;
+		}
+
+		wait_for_completion_interruptible(&chan->up_completion);
+		if (chan->state != ISER_CONN_UP)
+			return -EIO;
+	}
+
+	return 0;
+}
+
+/**
+ * iser_free_chans - release the additional session channels
+ * @iser_conn: iser connection
+ *
+ * Safe to call more than once; falls back to a single channel.
+ */
+void iser_free_chans(struct iser_conn *iser_conn)
+{
+	struct iser_chan *chan;
+	int i;
+
+	if (!iser_conn->chans)
+		return;
+
+	mutex_lock(&iser_conn->state_mutex);
+	for (i = 0; i < iser_conn->num_chans - 1; i++) {
+		chan = &iser_conn->chans[i];
+		chan->state = ISER_CONN_DOWN;
+		iser_free_chan_res(chan);
+	}
+	mutex_unlock(&iser_conn->state_mutex);
+
+	for (i = 0; i < iser_conn->num_chans - 1; i++) {
+		chan = &iser_conn->chans[i];
+		if (chan->ib_conn.cma_id) {
+			rdma_destroy_id(chan->ib_conn.cma_id);
+			chan->ib_conn.cma_id = NULL;
+		}
+	}
+
+	kfree(iser_conn->chans);
+	iser_conn->chans = NULL;
+	iser_conn->num_chans = 1;
+}
+
 void iser_conn_init(struct iser_conn *iser_conn)
 {
 	struct ib_conn *ib_conn = &iser_conn->ib_conn;
@@ -907,6 +1389,8 @@ void iser_conn_init(struct iser_conn *iser_conn)
 
 	ib_conn->post_recv_buf_count = 0;
 	ib_conn->reg_cqe.done = iser_reg_comp;
+	ib_conn->iser_conn = iser_conn;
+	iser_conn->num_chans = 1;
 }
 
  /**
@@ -924,6 +1408,8 @@ int iser_connect(struct iser_conn   *iser_conn,
 	mutex_lock(&iser_conn->state_mutex);
 
 	sprintf(iser_conn->name, "%pISp", dst_addr);
+	/* additional channels connect to the same portal */
+	memcpy(&iser_conn->dst_addr, dst_addr, rdma_addr_size(dst_addr));
 
 	iser_info("connecting to: %s\n", iser_conn->name);
 
@@ -999,16 +1485,16 @@ int iser_post_recvl(struct iser_conn *iser_conn)
 	return ib_ret;
 }
 
-int iser_post_recvm(struct iser_conn *iser_conn, int count)
+int iser_post_recvm(struct ib_conn *ib_conn, int count)
 {
-	struct ib_conn *ib_conn = &iser_conn->ib_conn;
-	unsigned int my_rx_head = iser_conn->rx_desc_head;
+	struct iser_conn *iser_conn = to_iser_conn(ib_conn);
+	unsigned int my_rx_head = ib_conn->rx_desc_head;
 	struct iser_rx_desc *rx_desc;
 	struct ib_recv_wr *wr;
 	int i, ib_ret;
 
 	for (wr = ib_conn->rx_wr, i = 0; i < count; i++, wr++) {
-		rx_desc = &iser_conn->rx_descs[my_rx_head];
+		rx_desc = &ib_conn->rx_descs[my_rx_head];
 		rx_desc->cqe.done = iser_task_rsp;
 		wr->wr_cqe = &rx_desc->cqe;
 		wr->sg_list = &rx_desc->rx_sg;
@@ -1026,7 +1512,7 @@ int iser_post_recvm(struct iser_conn *iser_conn, int count)
 		iser_err("ib_post_recv failed ret=%d\n", ib_ret);
 		ib_conn->post_recv_buf_count -= count;
 	} else
-		iser_conn->rx_desc_head = my_rx_head;
+		ib_conn->rx_desc_head = my_rx_head;
 
 	return ib_ret;
 }
@@ -20,6 +20,8 @@
 #include <target/target_core_fabric.h>
 #include <target/iscsi/iscsi_transport.h>
 #include <linux/semaphore.h>
+#include <linux/idr.h>
+#include <asm/unaligned.h>
 
 #include "ib_isert.h"
 
@@ -34,6 +36,18 @@ static int isert_debug_level;
 module_param_named(debug_level, isert_debug_level, int, 0644);
 MODULE_PARM_DESC(debug_level, "Enable debug tracing if > 0 (default:0)");
 
+static unsigned int isert_max_channels = 8;
+module_param_named(max_channels, isert_max_channels, uint, 0444);
+MODULE_PARM_DESC(max_channels, "Max RDMA channels granted per session (default:8)");
+
+static bool isert_rx_zcopy = true;
+module_param_named(rx_zcopy, isert_rx_zcopy, bool, 0644);
+MODULE_PARM_DESC(rx_zcopy, "Swap received data pages into commands instead of copying (default:true)");
+
+/* leading connections of multi-channel sessions, keyed by cookie */
+static DEFINE_IDR(isert_chan_idr);
+static DEFINE_MUTEX(isert_chan_mutex);
+
 static DEFINE_MUTEX(device_list_mutex);
 static LIST_HEAD(device_list);
 static struct workqueue_struct *isert_comp_wq;
@@ -48,6 +62,8 @@ static int
 isert_login_post_recv(struct isert_conn *isert_conn);
 static int
 isert_rdma_accept(struct isert_conn *isert_conn);
+static int
+isert_post_recvm(struct isert_conn *isert_conn, u32 count);
 struct rdma_cm_id *isert_setup_id(struct isert_np *isert_np);
 
 static void isert_release_work(struct work_struct *work);
@@ -136,7 +152,7 @@ isert_create_qp(struct isert_conn *isert_conn,
 	attr.cap.max_recv_wr = ISERT_QP_MAX_RECV_DTOS + 1;
 	attr.cap.max_rdma_ctxs = ISCSI_DEF_XMIT_CMDS_MAX;
 	attr.cap.max_send_sge = device->ib_device->attrs.max_send_sge;
-	attr.cap.max_recv_sge = 1;
+	attr.cap.max_recv_sge = ISERT_RX_SGE;
 	attr.sq_sig_type = IB_SIGNAL_REQ_WR;
 	attr.qp_type = IB_QPT_RC;
 	if (device->pi_capable)
@@ -173,6 +189,58 @@ err:
 	return ret;
 }
 
+static void
+isert_free_rx_pages(struct ib_device *ib_dev, struct iser_rx_desc *rx_desc)
+{
+	int i;
+
+	for (i = 0; i < ISERT_RX_PAGES; i++) {
+		if (!rx_desc->pages[i])
+			continue;
+		ib_dma_unmap_page(ib_dev, rx_desc->page_dma[i], PAGE_SIZE,
+				  DMA_FROM_DEVICE);
+		__free_page(rx_desc->pages[i]);
+		rx_desc->pages[i] = NULL;
+	}
+}
+
+static int
+isert_alloc_rx_pages(struct isert_device *device,
+		     struct iser_rx_desc *rx_desc)
+{
+	struct ib_device *ib_dev = device->ib_device;
+	u32 len = ISCSI_DEF_MAX_RECV_SEG_LEN;
+	struct ib_sge *rx_sg;
+	int i;
+
+	for (i = 0; i < ISERT_RX_PAGES; i++) {
+		rx_desc->pages[i] = alloc_page(GFP_KERNEL);
+		if (!rx_desc->pages[i])
+			goto err;
+
+		rx_desc->page_dma[i] = ib_dma_map_page(ib_dev,
+				rx_desc->pages[i], 0, PAGE_SIZE,
+				DMA_FROM_DEVICE);
+		if (ib_dma_mapping_error(ib_dev, rx_desc->page_dma[i])) {
+			__free_page(rx_desc->pages[i]);
+			rx_desc->pages[i] = NULL;
+			goto err;
+		}
+
+		rx_sg = &rx_desc->rx_sg[i + 1];
+		rx_sg->addr = rx_desc->page_dma[i];
+		rx_sg->length = min_t(u32, len, PAGE_SIZE);
+		rx_sg->lkey = device->pd->local_dma_lkey;
+		len -= rx_sg->length;
+	}
+
+	return 0;
+
+err:
+	isert_free_rx_pages(ib_dev, rx_desc);
+	return -ENOMEM;
+}
+
 static int
 isert_alloc_rx_descriptors(struct isert_conn *isert_conn)
 {
@@ -183,6 +251,9 @@ isert_alloc_rx_descriptors(struct isert_conn *isert_conn)
 	u64 dma_addr;
 	int i, j;
 
+	BUILD_BUG_ON(offsetof(struct iser_rx_desc, iscsi_header) !=
+		     sizeof(struct iser_ctrl));
+
 	isert_conn->rx_descs = kcalloc(ISERT_QP_MAX_RECV_DTOS,
 				       sizeof(struct iser_rx_desc),
 				       GFP_KERNEL);
@@ -193,15 +264,20 @@ isert_alloc_rx_descriptors(struct isert_conn *isert_conn)
 
 	for (i = 0; i < ISERT_QP_MAX_RECV_DTOS; i++, rx_desc++)  {
 		dma_addr = ib_dma_map_single(ib_dev, (void *)rx_desc,
-					ISER_RX_PAYLOAD_SIZE, DMA_FROM_DEVICE);
+					ISER_HEADERS_LEN, DMA_FROM_DEVICE);
 		if (ib_dma_mapping_error(ib_dev, dma_addr))
 			goto dma_map_fail;
 
 		rx_desc->dma_addr = dma_addr;
+		if (isert_alloc_rx_pages(device, rx_desc)) {
+			ib_dma_unmap_single(ib_dev, dma_addr,
+					    ISER_HEADERS_LEN, DMA_FROM_DEVICE);
+			goto dma_map_fail;
+		}
 
-		rx_sg = &rx_desc->rx_sg;
+		rx_sg = &rx_desc->rx_sg[0];
 		rx_sg->addr = rx_desc->dma_addr;
-		rx_sg->length = ISER_RX_PAYLOAD_SIZE;
+		rx_sg->length = ISER_HEADERS_LEN;
 		rx_sg->lkey = device->pd->local_dma_lkey;
 		rx_desc->rx_cqe.done = isert_recv_done;
 	}
@@ -212,7 +288,8 @@ dma_map_fail:
 	rx_desc = isert_conn->rx_descs;
 	for (j = 0; j < i; j++, rx_desc++) {
 		ib_dma_unmap_single(ib_dev, rx_desc->dma_addr,
-				    ISER_RX_PAYLOAD_SIZE, DMA_FROM_DEVICE);
+				    ISER_HEADERS_LEN, DMA_FROM_DEVICE);
+		isert_free_rx_pages(ib_dev, rx_desc);
 	}
 	kfree(isert_conn->rx_descs);
 	isert_conn->rx_descs = NULL;
@@ -233,13 +310,110 @@ isert_free_rx_descriptors(struct isert_conn *isert_conn)
 	rx_desc = isert_conn->rx_descs;
 	for (i = 0; i < ISERT_QP_MAX_RECV_DTOS; i++, rx_desc++)  {
 		ib_dma_unmap_single(ib_dev, rx_desc->dma_addr,
-				    ISER_RX_PAYLOAD_SIZE, DMA_FROM_DEVICE);
+				    ISER_HEADERS_LEN, DMA_FROM_DEVICE);
+		isert_free_rx_pages(ib_dev, rx_desc);
 	}
 
 	kfree(isert_conn->rx_descs);
 	isert_conn->rx_descs = NULL;
 }
 
+static void
+isert_rx_sync(struct ib_device *ib_dev, struct iser_rx_desc *rx_desc,
+	      bool for_cpu)
+{
+	struct ib_sge *rx_sg = rx_desc->rx_sg;
+	int i;
+
+	for (i = 0; i < ISERT_RX_SGE; i++, rx_sg++) {
+		if (for_cpu)
+			ib_dma_sync_single_for_cpu(ib_dev, rx_sg->addr,
+					rx_sg->length, DMA_FROM_DEVICE);
+		else
+			ib_dma_sync_single_for_device(ib_dev, rx_sg->addr,
+					rx_sg->length, DMA_FROM_DEVICE);
+	}
+}
+
+/*
+ * Copy the received payload out of the rx descriptor pages.
+ */
+static void
+isert_rx_copy(struct iser_rx_desc *rx_desc, void *buf, u32 len)
+{
+	u32 chunk;
+	int i;
+
+	for (i = 0; len; i++, len -= chunk, buf += chunk) {
+		chunk = min_t(u32, len, PAGE_SIZE);
+		memcpy(buf, page_address(rx_desc->pages[i]), chunk);
+	}
+}
+
+/*
+ * Hand rx descriptor page @i to target core in place of the page
+ * backing @sg, and take the command page over as the new receive
+ * buffer. Fails (caller copies) if the command page can't be mapped.
+ */
+static bool
+isert_rx_swap_page(struct ib_device *ib_dev, struct iser_rx_desc *rx_desc,
+		   int i, struct scatterlist *sg)
+{
+	struct page *page = sg_page(sg);
+	u64 dma_addr;
+
+	if (PageHighMem(page))
+		return false;
+
+	dma_addr = ib_dma_map_page(ib_dev, page, 0, PAGE_SIZE,
+				   DMA_FROM_DEVICE);
+	if (ib_dma_mapping_error(ib_dev, dma_addr))
+		return false;
+
+	ib_dma_unmap_page(ib_dev, rx_desc->page_dma[i], PAGE_SIZE,
+			  DMA_FROM_DEVICE);
+	sg_set_page(sg, rx_desc->pages[i], PAGE_SIZE, 0);
+
+	rx_desc->pages[i] = page;
+	rx_desc->page_dma[i] = dma_addr;
+	rx_desc->rx_sg[i + 1].addr = dma_addr;
+
+	return true;
+}
+
+/*
+ * Move @len bytes of received payload into the command buffer starting
+ * at page aligned @sg_start. Whole pages are swapped, the rest copied.
+ */
+static void
+isert_rx_to_sg(struct isert_conn *isert_conn, struct iser_rx_desc *rx_desc,
+	       struct scatterlist *sg_start, int sg_nents, u32 len)
+{
+	struct ib_device *ib_dev = isert_conn->device->ib_device;
+	struct scatterlist *sg = sg_start;
+	u32 chunk, off = 0;
+	int i;
+
+	for (i = 0; len; i++, len -= chunk, off += chunk) {
+		chunk = min_t(u32, len, PAGE_SIZE);
+		/* command buffer is not laid out in pages, copy the rest */
+		if (sg && (sg->offset || sg->length != PAGE_SIZE))
+			sg = NULL;
+
+		if (isert_rx_zcopy && sg && chunk == PAGE_SIZE &&
+		    isert_rx_swap_page(ib_dev, rx_desc, i, sg)) {
+			sg = sg_next(sg);
+			continue;
+		}
+
+		sg_pcopy_from_buffer(sg_start, sg_nents,
+				     page_address(rx_desc->pages[i]),
+				     chunk, off);
+		if (sg)
+			sg = sg_next(sg);
+	}
+}
+
 static void
 isert_free_comps(struct isert_device *device)
 {
@@ -404,6 +578,12 @@ isert_init_conn(struct isert_conn *isert_conn)
 {
 	isert_conn->state = ISER_CONN_INIT;
 	INIT_LIST_HEAD(&isert_conn->node);
+	INIT_LIST_HEAD(&isert_conn->chan_list);
+	INIT_LIST_HEAD(&isert_conn->chan_node);
+	isert_conn->nr_chans = 1;
+	spin_lock_init(&isert_conn->rsp_lock);
+	isert_conn->rsp_tail = &isert_conn->rsp_head;
+	isert_conn->rsp_rx_tail = &isert_conn->rsp_rx_head;
 	init_completion(&isert_conn->login_comp);
 	init_completion(&isert_conn->login_req_comp);
 	init_waitqueue_head(&isert_conn->rem_wait);
@@ -488,7 +668,9 @@ isert_set_nego_params(struct isert_conn *isert_conn,
 	isert_dbg("Using initiator_depth: %u\n", isert_conn->initiator_depth);
 
 	if (param->private_data) {
-		u8 flags = *(u8 *)param->private_data;
+		const struct iser_cm_hdr *req_hdr = param->private_data;
+		const struct iser_mchan_hdr *mchan;
+		u8 flags = req_hdr->flags;
 
 		/*
 		 * use remote invalidation if the both initiator
@@ -499,9 +681,160 @@ isert_set_nego_params(struct isert_conn *isert_conn,
 					   IB_DEVICE_MEM_MGT_EXTENSIONS);
 		if (isert_conn->snd_w_inv)
 			isert_info("Using remote invalidation\n");
+
+		mchan = iser_cm_mchan(param->private_data,
+				      param->private_data_len, ISER_MCHAN_JOIN);
+		if (mchan) {
+			isert_conn->chan_join = true;
+			isert_conn->chan_index = mchan->index;
+			isert_conn->chan_cookie = be16_to_cpu(mchan->cookie);
+		}
+
+		mchan = iser_cm_mchan(param->private_data,
+				      param->private_data_len, ISER_MCHAN_REQ);
+		if (mchan && mchan->nr_chans > 1) {
+			isert_conn->nr_chans = min3((unsigned int)mchan->nr_chans,
+						    isert_max_channels,
+						    (unsigned int)isert_conn->device->comps_used);
+			if (!isert_conn->nr_chans)
+				isert_conn->nr_chans = 1;
+			isert_info("Requested %u channels, granting %u\n",
+				   mchan->nr_chans, isert_conn->nr_chans);
+		}
 	}
 }
 
+/**
+ * isert_chan_register() - Hand out a cookie for channels to join
+ * @isert_conn: leading isert connection
+ *
+ * On failure the session silently falls back to a single channel.
+ */
+static void
+isert_chan_register(struct isert_conn *isert_conn)
+{
+	int cookie;
+
+	if (isert_conn->nr_chans <= 1)
+		return;
+
+	mutex_lock(&isert_chan_mutex);
+	cookie = idr_alloc(&isert_chan_idr, isert_conn, 1, 0x10000,
+			   GFP_KERNEL);
+	mutex_unlock(&isert_chan_mutex);
+	if (cookie < 0) {
+		isert_warn("conn %p failed to allocate channel cookie: %d\n",
+			   isert_conn, cookie);
+		isert_conn->nr_chans = 1;
+		return;
+	}
+	isert_conn->chan_cookie = cookie;
+}
+
+static void
+isert_chan_unregister(struct isert_conn *isert_conn)
+{
+	if (!isert_conn->chan_cookie || isert_conn->chan_join)
+		return;
+
+	mutex_lock(&isert_chan_mutex);
+	idr_remove(&isert_chan_idr, isert_conn->chan_cookie);
+	mutex_unlock(&isert_chan_mutex);
+	isert_conn->chan_cookie = 0;
+}
+
+/**
+ * isert_chan_join() - Attach a channel to its leading connection
+ * @isert_conn: joining isert connection (QP already created)
+ *
+ * Channels never go through login; they share the iscsi connection
+ * of the leader and only carry SCSI commands and their data/responses.
+ * Called with the channel QP set up, it either accepts the channel or
+ * releases everything allocated after the QP.
+ */
+static int
+isert_chan_join(struct isert_conn *isert_conn)
+{
+	struct isert_conn *leader;
+	int ret;
+
+	ret = isert_alloc_rx_descriptors(isert_conn);
+	if (ret)
+		goto out_qp;
+
+	ret = isert_post_recvm(isert_conn, ISERT_QP_MAX_RECV_DTOS);
+	if (ret)
+		goto out_rx;
+
+	mutex_lock(&isert_chan_mutex);
+	leader = idr_find(&isert_chan_idr, isert_conn->chan_cookie);
+	if (!leader || !isert_conn->chan_index ||
+	    isert_conn->chan_index >= leader->nr_chans ||
+	    leader->device != isert_conn->device) {
+		isert_err("conn %p invalid channel %u cookie %u\n",
+			  isert_conn, isert_conn->chan_index,
+			  isert_conn->chan_cookie);
+		ret = -EINVAL;
+		goto out_unlock;
+	}
+
+	mutex_lock(&leader->mutex);
+	if (leader->state >= ISER_CONN_TERMINATING) {
+		ret = -ENOTCONN;
+		goto out_unlock_leader;
+	}
+
+	isert_conn->leader = leader;
+	isert_conn->conn = leader->conn;
+	isert_conn->pi_support = leader->pi_support;
+	isert_conn->sig_pipeline = leader->sig_pipeline;
+
+	ret = isert_rdma_accept(isert_conn);
+	if (ret) {
+		isert_conn->leader = NULL;
+		goto out_unlock_leader;
+	}
+	list_add_tail(&isert_conn->chan_node, &leader->chan_list);
+	mutex_unlock(&leader->mutex);
+	mutex_unlock(&isert_chan_mutex);
+
+	isert_info("conn %p joined leader %p as channel %u\n",
+		   isert_conn, leader, isert_conn->chan_index);
+
+	return 0;
+
+out_unlock_leader:
+	mutex_unlock(&leader->mutex);
+out_unlock:
+	mutex_unlock(&isert_chan_mutex);
+	ib_drain_qp(isert_conn->qp);
+out_rx:
+	isert_free_rx_descriptors(isert_conn);
+out_qp:
+	isert_comp_put(isert_conn->qp->recv_cq->cq_context);
+	ib_destroy_qp(isert_conn->qp);
+	isert_conn->qp = NULL;
+	return ret;
+}
+
+/**
+ * isert_chans_sync() - Propagate login results to the channels
+ * @isert_conn: leading isert connection
+ */
+static void
+isert_chans_sync(struct isert_conn *isert_conn)
+{
+	struct isert_conn *chan;
+
+	mutex_lock(&isert_conn->mutex);
+	list_for_each_entry(chan, &isert_conn->chan_list, chan_node) {
+		chan->conn = isert_conn->conn;
+		chan->pi_support = isert_conn->pi_support;
+		chan->sig_pipeline = isert_conn->sig_pipeline;
+	}
+	mutex_unlock(&isert_conn->mutex);
+}
+
 static int
 isert_connect_request(struct rdma_cm_id *cma_id, struct rdma_cm_event *event)
 {
@@ -556,13 +889,23 @@ isert_connect_request(struct rdma_cm_id *cma_id, struct rdma_cm_event *event)
 	if (ret)
 		goto out_conn_dev;
 
+	if (isert_conn->chan_join) {
+		ret = isert_chan_join(isert_conn);
+		if (ret)
+			goto out_conn_dev;
+		return 0;
+	}
+
 	ret = isert_login_post_recv(isert_conn);
 	if (ret)
 		goto out_conn_dev;
 
+	isert_chan_register(isert_conn);
 	ret = isert_rdma_accept(isert_conn);
-	if (ret)
+	if (ret) {
+		isert_chan_unregister(isert_conn);
 		goto out_conn_dev;
+	}
 
 	mutex_lock(&isert_np->mutex);
 	list_add_tail(&isert_conn->node, &isert_np->accepted);
@@ -580,6 +923,59 @@ out:
 	return ret;
 }
 
+static void
+isert_conn_terminate(struct isert_conn *isert_conn);
+static void
+isert_put_conn(struct isert_conn *isert_conn);
+
+/**
+ * isert_release_chans() - Tear down the channels of a leading connection
+ * @isert_conn: leading isert connection
+ */
+static void
+isert_release_chans(struct isert_conn *isert_conn)
+{
+	struct isert_conn *chan, *n;
+	LIST_HEAD(chans);
+
+	isert_chan_unregister(isert_conn);
+
+	mutex_lock(&isert_conn->mutex);
+	list_splice_init(&isert_conn->chan_list, &chans);
+	mutex_unlock(&isert_conn->mutex);
+
+	list_for_each_entry_safe(chan, n, &chans, chan_node) {
+		list_del_init(&chan->chan_node);
+
+		mutex_lock(&chan->mutex);
+		isert_conn_terminate(chan);
+		mutex_unlock(&chan->mutex);
+
+		ib_drain_qp(chan->qp);
+		isert_put_conn(chan);
+	}
+}
+
+/**
+ * isert_chans_terminate() - Disconnect and flush the session channels
+ * @isert_conn: leading isert connection
+ */
+static void
+isert_chans_terminate(struct isert_conn *isert_conn)
+{
+	struct isert_conn *chan;
+
+	mutex_lock(&isert_conn->mutex);
+	list_for_each_entry(chan, &isert_conn->chan_list, chan_node) {
+		mutex_lock(&chan->mutex);
+		isert_conn_terminate(chan);
+		mutex_unlock(&chan->mutex);
+	}
+	list_for_each_entry(chan, &isert_conn->chan_list, chan_node)
+		ib_drain_qp(chan->qp);
+	mutex_unlock(&isert_conn->mutex);
+}
+
 static void
 isert_connect_release(struct isert_conn *isert_conn)
 {
@@ -589,6 +985,8 @@ isert_connect_release(struct isert_conn *isert_conn)
 
 	BUG_ON(!device);
 
+	isert_release_chans(isert_conn);
+
 	isert_free_rx_descriptors(isert_conn);
 	if (isert_conn->cm_id &&
 	    !isert_conn->dev_removed)
@@ -766,6 +1164,56 @@ isert_connect_error(struct rdma_cm_id *cma_id)
 	return -1;
 }
 
+/*
+ * Channels are owned by their leading connection which releases them,
+ * so here we only track their state and kick the leader into
+ * reinstatement when one of them goes away underneath it.
+ */
+static int
+isert_chan_cma_handler(struct rdma_cm_id *cma_id, struct rdma_cm_event *event)
+{
+	struct isert_conn *chan = cma_id->qp->qp_context;
+	struct isert_conn *leader = chan->leader;
+	bool terminated = false;
+
+	switch (event->event) {
+	case RDMA_CM_EVENT_ESTABLISHED:
+		mutex_lock(&chan->mutex);
+		if (chan->state == ISER_CONN_INIT)
+			chan->state = ISER_CONN_UP;
+		mutex_unlock(&chan->mutex);
+		break;
+	case RDMA_CM_EVENT_ADDR_CHANGE:
+	case RDMA_CM_EVENT_DISCONNECTED:
+	case RDMA_CM_EVENT_TIMEWAIT_EXIT:
+	case RDMA_CM_EVENT_DEVICE_REMOVAL:
+	case RDMA_CM_EVENT_REJECTED:
+	case RDMA_CM_EVENT_UNREACHABLE:
+	case RDMA_CM_EVENT_CONNECT_ERROR:
+		mutex_lock(&chan->mutex);
+		if (chan->state < ISER_CONN_TERMINATING) {
+			isert_conn_terminate(chan);
+			terminated = true;
+		}
+		mutex_unlock(&chan->mutex);
+		if (!terminated)
+			break;
+
+		ib_drain_qp(chan->qp);
+		mutex_lock(&leader->mutex);
+		if (leader->state == ISER_CONN_BOUND ||
+		    leader->state == ISER_CONN_FULL_FEATURE)
+			iscsit_cause_connection_reinstatement(leader->conn, 0);
+		mutex_unlock(&leader->mutex);
+		break;
+	default:
+		isert_err("Unhandled RDMA CMA event: %d\n", event->event);
+		break;
+	}
+
+	return 0;
+}
+
 static int
 isert_cma_handler(struct rdma_cm_id *cma_id, struct rdma_cm_event *event)
 {
@@ -780,6 +1228,10 @@ isert_cma_handler(struct rdma_cm_id *cma_id, struct rdma_cm_event *event)
 	if (isert_np->cm_id == cma_id)
 		return isert_np_cma_handler(cma_id->context, event->event);
 
+	if (event->event != RDMA_CM_EVENT_CONNECT_REQUEST && cma_id->qp &&
+	    ((struct isert_conn *)cma_id->qp->qp_context)->leader)
+		return isert_chan_cma_handler(cma_id, event);
+
 	switch (event->event) {
 	case RDMA_CM_EVENT_CONNECT_REQUEST:
 		ret = isert_connect_request(cma_id, event);
@@ -833,8 +1285,8 @@ isert_post_recvm(struct isert_conn *isert_conn, u32 count)
 		rx_desc = &isert_conn->rx_descs[i];
 
 		rx_wr->wr_cqe = &rx_desc->rx_cqe;
-		rx_wr->sg_list = &rx_desc->rx_sg;
-		rx_wr->num_sge = 1;
+		rx_wr->sg_list = rx_desc->rx_sg;
+		rx_wr->num_sge = ISERT_RX_SGE;
 		rx_wr->next = rx_wr + 1;
 		rx_desc->in_use = false;
 	}
@@ -864,8 +1316,8 @@ isert_post_recv(struct isert_conn *isert_conn, struct iser_rx_desc *rx_desc)
 
 	rx_desc->in_use = false;
 	rx_wr.wr_cqe = &rx_desc->rx_cqe;
-	rx_wr.sg_list = &rx_desc->rx_sg;
-	rx_wr.num_sge = 1;
+	rx_wr.sg_list = rx_desc->rx_sg;
+	rx_wr.num_sge = ISERT_RX_SGE;
 	rx_wr.next = NULL;
 
 	ret = ib_post_recv(isert_conn->qp, &rx_wr, NULL);
@@ -1084,7 +1536,7 @@ post_send:
 static void
 isert_rx_login_req(struct isert_conn *isert_conn)
 {
-	struct iser_rx_desc *rx_desc = isert_conn->login_req_buf;
+	struct iser_login_desc *rx_desc = isert_conn->login_req_buf;
 	int rx_buflen = isert_conn->login_req_len;
 	struct iscsi_conn *conn = isert_conn->conn;
 	struct iscsi_login *login = conn->conn_login;
@@ -1238,15 +1690,22 @@ isert_handle_scsi_cmd(struct isert_conn *isert_conn,
             (cmd->se_cmd.se_cmd_flags & SCF_COMPARE_AND_WRITE)) {
 #endif
 		sg_nents = max(1UL, DIV_ROUND_UP(imm_data_len, PAGE_SIZE));
-		sg_copy_from_buffer(cmd->se_cmd.t_data_sg, sg_nents,
-				    &rx_desc->data[0], imm_data_len);
+		isert_rx_to_sg(isert_conn, rx_desc, cmd->se_cmd.t_data_sg,
+			       sg_nents, imm_data_len);
 		isert_dbg("Copy Immediate sg_nents: %u imm_data_len: %d\n",
 			  sg_nents, imm_data_len);
 	} else {
-		sg_init_table(&isert_cmd->sg, 1);
-		cmd->se_cmd.t_data_sg = &isert_cmd->sg;
-		cmd->se_cmd.t_data_nents = 1;
-		sg_set_buf(&isert_cmd->sg, &rx_desc->data[0], imm_data_len);
+		u32 len = imm_data_len;
+		int i;
+
+		/* the rx pages stay with the command until the response */
+		sg_nents = max(1UL, DIV_ROUND_UP(imm_data_len, PAGE_SIZE));
+		sg_init_table(isert_cmd->sg, sg_nents);
+		for (i = 0; i < sg_nents; i++, len -= PAGE_SIZE)
+			sg_set_page(&isert_cmd->sg[i], rx_desc->pages[i],
+				    min_t(u32, len, PAGE_SIZE), 0);
+		cmd->se_cmd.t_data_sg = isert_cmd->sg;
+		cmd->se_cmd.t_data_nents = sg_nents;
 		isert_dbg("Transfer Immediate imm_data_len: %d\n",
 			  imm_data_len);
 	}
@@ -1323,10 +1782,10 @@ isert_handle_iscsi_dataout(struct isert_conn *isert_conn,
 	}
 	isert_dbg("Copying DataOut: sg_start: %p, sg_off: %u "
 		  "sg_nents: %u from %p %u\n", sg_start, sg_off,
-		  sg_nents, &rx_desc->data[0], unsol_data_len);
+		  sg_nents, rx_desc, unsol_data_len);
 
-	sg_copy_from_buffer(sg_start, sg_nents, &rx_desc->data[0],
-			    unsol_data_len);
+	isert_rx_to_sg(isert_conn, rx_desc, sg_start, sg_nents,
+		       unsol_data_len);
 
 	rc = iscsit_check_dataout_payload(cmd, hdr, false);
 	if (rc < 0)
@@ -1387,7 +1846,7 @@ isert_handle_text_cmd(struct isert_conn *isert_conn, struct isert_cmd *isert_cmd
 	}
 	cmd->text_in_ptr = text_in;
 
-	memcpy(cmd->text_in_ptr, &rx_desc->data[0], payload_length);
+	isert_rx_copy(rx_desc, cmd->text_in_ptr, payload_length);
 
 	return iscsit_process_text_cmd(conn, cmd, hdr);
 }
@@ -1415,7 +1874,7 @@ isert_handle_text_cmd(struct isert_conn *isert_conn, struct isert_cmd *isert_cmd
         }
         cmd->text_in_ptr = text_in;
 
-        memcpy(cmd->text_in_ptr, &rx_desc->data[0], payload_length);
+        isert_rx_copy(rx_desc, cmd->text_in_ptr, payload_length);
 
         return iscsit_process_text_cmd(conn, cmd, hdr);
 }
@@ -1455,6 +1914,8 @@ isert_rx_opcode(struct isert_conn *isert_conn, struct iser_rx_desc *rx_desc,
 		isert_cmd = container_of(cmd, struct isert_cmd, iscsi_cmd);
 		isert_cmd->rx_desc = rx_desc;
 #endif
+		/* respond on the channel the command arrived on */
+		isert_cmd->conn = isert_conn;
 		isert_cmd->read_stag = read_stag;
 		isert_cmd->read_va = read_va;
 		isert_cmd->write_stag = write_stag;
@@ -1585,8 +2046,7 @@ isert_recv_done(struct ib_cq *cq, struct ib_wc *wc)
 
 	rx_desc->in_use = true;
 
-	ib_dma_sync_single_for_cpu(ib_dev, rx_desc->dma_addr,
-			ISER_RX_PAYLOAD_SIZE, DMA_FROM_DEVICE);
+	isert_rx_sync(ib_dev, rx_desc, true);
 
 	isert_dbg("DMA: 0x%llx, iSCSI opcode: 0x%02x, ITT: 0x%08x, flags: 0x%02x dlen: %d\n",
 		 rx_desc->dma_addr, hdr->opcode, hdr->itt, hdr->flags,
@@ -1620,8 +2080,7 @@ isert_recv_done(struct ib_cq *cq, struct ib_wc *wc)
 	isert_rx_opcode(isert_conn, rx_desc,
 			read_stag, read_va, write_stag, write_va);
 
-	ib_dma_sync_single_for_device(ib_dev, rx_desc->dma_addr,
-			ISER_RX_PAYLOAD_SIZE, DMA_FROM_DEVICE);
+	isert_rx_sync(ib_dev, rx_desc, false);
 }
 
 static void
@@ -2117,22 +2576,108 @@ isert_send_done(struct ib_cq *cq, struct ib_wc *wc)
 	}
 }
 
+/*
+ * Complete send WRs the provider refused as flushed so their commands
+ * are released the same way as on a QP flush.
+ */
+static void
+isert_flush_send_wrs(struct isert_conn *isert_conn, struct ib_send_wr *wr)
+{
+	struct ib_send_wr *next;
+	struct ib_wc wc;
+
+	for (; wr; wr = next) {
+		next = wr->next;
+		memset(&wc, 0, sizeof(wc));
+		wc.wr_cqe = wr->wr_cqe;
+		wc.status = IB_WC_WR_FLUSH_ERR;
+		wc.qp = isert_conn->qp;
+		wr->wr_cqe->done(isert_conn->qp->send_cq, &wc);
+	}
+}
+
 static int
-isert_post_response(struct isert_conn *isert_conn, struct isert_cmd *isert_cmd)
+isert_post_rsp_chain(struct isert_conn *isert_conn,
+		     struct ib_recv_wr *rx_wr, struct ib_send_wr *send_wr)
 {
+	const struct ib_send_wr *bad_send_wr;
+	const struct ib_recv_wr *bad_rx_wr;
 	int ret;
 
-	ret = isert_post_recv(isert_conn, isert_cmd->rx_desc);
-	if (ret) {
-		isert_err("ib_post_recv failed with %d\n", ret);
-		return ret;
+	if (rx_wr) {
+		ret = ib_post_recv(isert_conn->qp, rx_wr, &bad_rx_wr);
+		if (ret) {
+			isert_err("ib_post_recv failed with %d\n", ret);
+			goto fail;
+		}
 	}
 
-	ret = ib_post_send(isert_conn->qp, &isert_cmd->tx_desc.send_wr, NULL);
+	ret = ib_post_send(isert_conn->qp, send_wr, &bad_send_wr);
 	if (ret) {
 		isert_err("ib_post_send failed with %d\n", ret);
-		return ret;
+		send_wr = (struct ib_send_wr *)bad_send_wr;
+		goto fail;
+	}
+
+	return 0;
+
+fail:
+	iscsit_cause_connection_reinstatement(isert_conn->conn, 0);
+	isert_flush_send_wrs(isert_conn, send_wr);
+	return ret;
+}
+
+/*
+ * Responses (and the receive buffers they release) are chained per
+ * channel: whoever finds no post in progress posts the chain, picking
+ * up responses queued meanwhile by other contexts before it leaves.
+ */
+static int
+isert_post_response(struct isert_conn *isert_conn, struct isert_cmd *isert_cmd)
+{
+	struct iser_rx_desc *rx_desc = isert_cmd->rx_desc;
+	struct ib_send_wr *send_wr = &isert_cmd->tx_desc.send_wr;
+	struct ib_recv_wr *rx_head;
+	struct ib_send_wr *send_head;
+	int ret = 0;
+
+	spin_lock_bh(&isert_conn->rsp_lock);
+	if (rx_desc && rx_desc->in_use) {
+		rx_desc->in_use = false;
+		rx_desc->rx_wr.wr_cqe = &rx_desc->rx_cqe;
+		rx_desc->rx_wr.sg_list = rx_desc->rx_sg;
+		rx_desc->rx_wr.num_sge = ISERT_RX_SGE;
+		rx_desc->rx_wr.next = NULL;
+		*isert_conn->rsp_rx_tail = &rx_desc->rx_wr;
+		isert_conn->rsp_rx_tail = &rx_desc->rx_wr.next;
+	}
+	send_wr->next = NULL;
+	*isert_conn->rsp_tail = send_wr;
+	isert_conn->rsp_tail = &send_wr->next;
+
+	if (isert_conn->rsp_posting) {
+		spin_unlock_bh(&isert_conn->rsp_lock);
+		return 0;
+	}
+	isert_conn->rsp_posting = true;
+
+	while (isert_conn->rsp_head) {
+		rx_head = isert_conn->rsp_rx_head;
+		send_head = isert_conn->rsp_head;
+		isert_conn->rsp_rx_head = NULL;
+		isert_conn->rsp_rx_tail = &isert_conn->rsp_rx_head;
+		isert_conn->rsp_head = NULL;
+		isert_conn->rsp_tail = &isert_conn->rsp_head;
+		spin_unlock_bh(&isert_conn->rsp_lock);
+
+		if (isert_post_rsp_chain(isert_conn, rx_head, send_head))
+			ret = -EIO;
+
+		spin_lock_bh(&isert_conn->rsp_lock);
 	}
+	isert_conn->rsp_posting = false;
+	spin_unlock_bh(&isert_conn->rsp_lock);
+
 	return ret;
 }
 
@@ -2145,7 +2690,7 @@ isert_put_response(struct iscsi_conn *conn, struct iscsi_cmd *cmd)
 	struct isert_cmd *isert_cmd = container_of(cmd,
 			struct isert_cmd, iscsi_cmd);
 #endif
-	struct isert_conn *isert_conn = conn->context;
+	struct isert_conn *isert_conn = isert_cmd->conn;
 	struct ib_send_wr *send_wr = &isert_cmd->tx_desc.send_wr;
 	struct iscsi_scsi_rsp *hdr = (struct iscsi_scsi_rsp *)
 				&isert_cmd->tx_desc.iscsi_header;
@@ -2201,7 +2746,7 @@ isert_aborted_task(struct iscsi_conn *conn, struct iscsi_cmd *cmd)
 	struct isert_cmd *isert_cmd = container_of(cmd,
 			struct isert_cmd, iscsi_cmd);
 #endif
-	struct isert_conn *isert_conn = conn->context;
+	struct isert_conn *isert_conn = isert_cmd->conn;
 
 	spin_lock_bh(&conn->cmd_lock);
 	if (!list_empty(&cmd->i_conn_node))
@@ -2226,6 +2771,7 @@ isert_get_sup_prot_ops(struct iscsi_conn *conn)
 			isert_info("conn %p PI offload enabled\n", isert_conn);
 			isert_conn->pi_support = true;
 			isert_conn->sig_pipeline = device->sig_pipeline;
+			isert_chans_sync(isert_conn);
 			return TARGET_PROT_ALL;
 		}
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,19,0))
@@ -2234,6 +2780,7 @@ isert_get_sup_prot_ops(struct iscsi_conn *conn)
 	isert_info("conn %p PI offload disabled\n", isert_conn);
 	isert_conn->pi_support = false;
 	isert_conn->sig_pipeline = false;
+	isert_chans_sync(isert_conn);
 
 	return TARGET_PROT_NORMAL;
 }
@@ -2539,7 +3086,7 @@ isert_put_datain(struct iscsi_conn *conn, struct iscsi_cmd *cmd)
 	struct isert_cmd *isert_cmd = container_of(cmd,
 			struct isert_cmd, iscsi_cmd);
 #endif
-	struct isert_conn *isert_conn = conn->context;
+	struct isert_conn *isert_conn = isert_cmd->conn;
 	struct ib_cqe *cqe = NULL;
 	struct ib_send_wr *chain_wr = NULL;
 	int rc;
@@ -2606,7 +3153,7 @@ isert_get_dataout(struct iscsi_conn *conn, struct iscsi_cmd *cmd, bool recovery)
 		 isert_cmd, cmd->se_cmd.data_length, cmd->write_data_done);
 
 	isert_cmd->tx_desc.tx_cqe.done = isert_rdma_read_done;
-	ret = isert_rdma_rw_ctx_post(isert_cmd, conn->context,
+	ret = isert_rdma_rw_ctx_post(isert_cmd, isert_cmd->conn,
 				     &isert_cmd->tx_desc.tx_cqe, NULL);
 
 	isert_dbg("Cmd: %p posted RDMA_READ memory for ISER Data WRITE rc: %d\n",
@@ -2773,7 +3320,7 @@ isert_rdma_accept(struct isert_conn *isert_conn)
 	struct rdma_cm_id *cm_id = isert_conn->cm_id;
 	struct rdma_conn_param cp;
 	int ret;
-	struct iser_cm_hdr rsp_hdr;
+	struct iser_cm_priv rsp_hdr;
 
 	memset(&cp, 0, sizeof(struct rdma_conn_param));
 	cp.initiator_depth = isert_conn->initiator_depth;
@@ -2781,11 +3328,18 @@ isert_rdma_accept(struct isert_conn *isert_conn)
 	cp.rnr_retry_count = 7;
 
 	memset(&rsp_hdr, 0, sizeof(rsp_hdr));
-	rsp_hdr.flags = ISERT_ZBVA_NOT_USED;
+	rsp_hdr.hdr.flags = ISERT_ZBVA_NOT_USED;
 	if (!isert_conn->snd_w_inv)
-		rsp_hdr.flags = rsp_hdr.flags | ISERT_SEND_W_INV_NOT_USED;
+		rsp_hdr.hdr.flags = rsp_hdr.hdr.flags | ISERT_SEND_W_INV_NOT_USED;
 	cp.private_data = (void *)&rsp_hdr;
-	cp.private_data_len = sizeof(rsp_hdr);
+	cp.private_data_len = sizeof(struct iser_cm_hdr);
+	if (isert_conn->nr_chans > 1) {
+		rsp_hdr.mchan.magic = cpu_to_be16(ISER_MCHAN_MAGIC);
+		rsp_hdr.mchan.op = ISERT_MCHAN_ACK;
+		rsp_hdr.mchan.nr_chans = isert_conn->nr_chans;
+		rsp_hdr.mchan.cookie = cpu_to_be16(isert_conn->chan_cookie);
+		cp.private_data_len = sizeof(rsp_hdr);
+	}
 
 	ret = rdma_accept(cm_id, &cp);
 	if (ret) {
@@ -2919,6 +3473,7 @@ accept_wait:
 	conn->context = isert_conn;
 	isert_conn->conn = conn;
 	isert_conn->state = ISER_CONN_BOUND;
+	isert_chans_sync(isert_conn);
 
 	isert_set_conn_info(np, conn, isert_conn);
 
@@ -3067,6 +3622,7 @@ static void isert_wait_conn(struct iscsi_conn *conn)
 	mutex_unlock(&isert_conn->mutex);
 
 	ib_drain_qp(isert_conn->qp);
+	isert_chans_terminate(isert_conn);
 	isert_put_unsol_pending_cmds(conn);
 	isert_wait4cmds(conn);
 	isert_wait4logout(isert_conn);
@@ -3094,6 +3650,7 @@ static void isert_free_conn(struct iscsi_conn *conn)
 	 */
 	if (isert_conn->state == ISER_CONN_FULL_FEATURE) {
 		ib_drain_qp(isert_conn->qp);
+		isert_chans_terminate(isert_conn);
 		isert_put_unsol_pending_cmds(conn);
 		isert_wait4cmds(conn);
 		isert_wait4logout(isert_conn);
@@ -3102,6 +3659,7 @@ static void isert_free_conn(struct iscsi_conn *conn)
 out:
 #else
 	ib_drain_qp(isert_conn->qp);
+	isert_chans_terminate(isert_conn);
 #endif
 	isert_put_conn(isert_conn);
 }
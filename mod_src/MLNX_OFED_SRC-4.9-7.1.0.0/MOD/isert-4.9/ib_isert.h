@@ -59,9 +59,13 @@
 				ISERT_MAX_TX_MISC_PDUS	+ \
 				ISERT_MAX_RX_MISC_PDUS)
 
-#define ISER_RX_PAD_SIZE	(ISCSI_DEF_MAX_RECV_SEG_LEN + 4096 - \
-		(ISER_RX_PAYLOAD_SIZE + sizeof(u64) + sizeof(struct ib_sge) + \
-		 sizeof(struct ib_cqe) + sizeof(bool)))
+/*
+ * Receive payloads land in their own pages (headers go to a separate
+ * SGE) so data can be handed to target core a page at a time.
+ */
+#define ISERT_RX_PAGES		DIV_ROUND_UP(ISCSI_DEF_MAX_RECV_SEG_LEN, \
+				     PAGE_SIZE)
+#define ISERT_RX_SGE		(1 + ISERT_RX_PAGES)
 
 #define ISCSI_ISER_SG_TABLESIZE		256
 
@@ -103,12 +107,21 @@ enum iser_conn_state {
 struct iser_rx_desc {
 	struct iser_ctrl iser_header;
 	struct iscsi_hdr iscsi_header;
-	char		data[ISCSI_DEF_MAX_RECV_SEG_LEN];
-	u64		dma_addr;
-	struct ib_sge	rx_sg;
+	/* cpu owned from here, keep it off the cacheline the HCA writes */
+	u64		dma_addr ____cacheline_aligned;
+	struct page	*pages[ISERT_RX_PAGES];
+	u64		page_dma[ISERT_RX_PAGES];
+	struct ib_sge	rx_sg[ISERT_RX_SGE];
+	struct ib_recv_wr rx_wr;
 	struct ib_cqe	rx_cqe;
 	bool		in_use;
-	char		pad[ISER_RX_PAD_SIZE];
+};
+
+struct iser_login_desc {
+	struct iser_ctrl iser_header;
+	struct iscsi_hdr iscsi_header;
+	char		data[ISCSI_DEF_MAX_RECV_SEG_LEN];
+	struct ib_cqe	rx_cqe;
 } __packed;
 
 static inline struct iser_rx_desc *cqe_to_rx_desc(struct ib_cqe *cqe)
@@ -150,7 +163,7 @@ struct isert_cmd {
 	struct iser_rx_desc	*rx_desc;
 	struct rdma_rw_ctx	rw;
 	struct work_struct	comp_work;
-	struct scatterlist	sg;
+	struct scatterlist	sg[ISERT_RX_PAGES];
 	bool			ctx_init_done;
 	bool			send_sig_pipelined;
 };
@@ -168,7 +181,7 @@ struct isert_conn {
 	u32			initiator_depth;
 	bool			pi_support;
 	bool			sig_pipeline;
-	struct iser_rx_desc	*login_req_buf;
+	struct iser_login_desc	*login_req_buf;
 	char			*login_rsp_buf;
 	u64			login_req_dma;
 	int			login_req_len;
@@ -190,6 +203,21 @@ struct isert_conn {
 	bool                    snd_w_inv;
 	wait_queue_head_t	rem_wait;
 	bool			dev_removed;
+	/* multi-channel session: channels hang off the leading connection */
+	struct isert_conn	*leader;
+	struct list_head	chan_list;
+	struct list_head	chan_node;
+	u16			chan_cookie;
+	u8			nr_chans;
+	u8			chan_index;
+	bool			chan_join;
+	/* responses queued while another context posts are chained */
+	spinlock_t		rsp_lock;
+	bool			rsp_posting;
+	struct ib_send_wr	*rsp_head;
+	struct ib_send_wr	**rsp_tail;
+	struct ib_recv_wr	*rsp_rx_head;
+	struct ib_recv_wr	**rsp_rx_tail;
 };
 
 #define ISERT_MAX_CQ 64
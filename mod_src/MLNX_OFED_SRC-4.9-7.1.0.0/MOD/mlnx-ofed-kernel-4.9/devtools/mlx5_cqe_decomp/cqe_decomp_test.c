@@ -0,0 +1,577 @@
+// SPDX-License-Identifier: GPL-2.0 OR Linux-OpenIB
+/* Copyright (c) 2020 Mellanox Technologies. */
+
+/*
+ * Userspace harness for the mlx5e RX compressed CQE decompression.
+ *
+ * It decompresses synthetic sessions with the original per-CQE code (the
+ * reference), with the RX path as built from
+ * drivers/net/ethernet/mellanox/mlx5/core/en/cqe_decomp.h, and with kernels
+ * that expand a whole mini CQE slot into 8 full CQEs at once (scalar, SSE2
+ * and AVX2). It checks that all of them produce bit-identical CQEs, then
+ * benchmarks them.
+ *
+ * Build and run from this directory:
+ *   gcc -O2 -Wall -I../../drivers/net/ethernet/mellanox/mlx5/core \
+ *       -o cqe_decomp_test cqe_decomp_test.c
+ *   ./cqe_decomp_test [sessions]
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef uint16_t __be16;
+typedef uint32_t __be32;
+
+#define cpu_to_be16(x)	__builtin_bswap16(x)
+#define be16_to_cpu(x)	__builtin_bswap16(x)
+#define be32_to_cpu(x)	__builtin_bswap32(x)
+
+/* Layouts from include/linux/mlx5/device.h */
+#define MLX5_MINI_CQE_ARRAY_SIZE 8
+
+struct mlx5_cqe64 {
+	u8		outer_l3_tunneled;
+	u8		rsvd0;
+	__be16		wqe_id;
+	u8		lro_tcppsh_abort_dupack;
+	u8		lro_min_ttl;
+	__be16		lro_tcp_win;
+	__be32		lro_ack_seq_num;
+	__be32		rss_hash_result;
+	u8		rss_hash_type;
+	u8		ml_path;
+	u8		rsvd20[2];
+	__be16		check_sum;
+	__be16		slid;
+	__be32		flags_rqpn;
+	u8		hds_ip_ext;
+	u8		l4_l3_hdr_type;
+	__be16		vlan_info;
+	__be32		srqn;
+	__be32		immediate;
+	u8		rsvd40[4];
+	__be32		byte_cnt;
+	__be32		timestamp_h;
+	__be32		timestamp_l;
+	__be32		sop_drop_qpn;
+	__be16		wqe_counter;
+	u8		signature;
+	u8		op_own;
+};
+
+struct mlx5_mini_cqe8 {
+	union {
+		__be32 rx_hash_result;
+		struct {
+			__be16 checksum;
+			__be16 rsvd;
+		};
+	};
+	__be32 byte_cnt;
+};
+
+struct mpwrq_cqe_bc {
+	__be16	filler_consumed_strides;
+	__be16	byte_cnt;
+};
+
+_Static_assert(sizeof(struct mlx5_cqe64) == 64, "cqe64 size");
+_Static_assert(offsetof(struct mlx5_cqe64, check_sum) == 20, "check_sum");
+_Static_assert(offsetof(struct mlx5_cqe64, byte_cnt) == 44, "byte_cnt");
+_Static_assert(offsetof(struct mlx5_cqe64, wqe_counter) == 60, "wqe_counter");
+_Static_assert(sizeof(struct mlx5_mini_cqe8) == 8, "mini_cqe8 size");
+
+#include "en/cqe_decomp.h"
+
+#define MAX_SESSION	(64 * MLX5_MINI_CQE_ARRAY_SIZE)
+#define NR_SLOTS	(MAX_SESSION / MLX5_MINI_CQE_ARRAY_SIZE)
+
+struct session {
+	struct mlx5_cqe64 title;
+	struct mlx5_mini_cqe8 mini[NR_SLOTS][MLX5_MINI_CQE_ARRAY_SIZE];
+	u32 len;
+	u32 cqcc;
+	u8 log_sz;
+	bool striding;
+	u16 sz_m1;
+};
+
+enum {
+	DEC_REF,
+	DEC_DRIVER,
+	DEC_SLOT_SCALAR,
+	DEC_SLOT_SSE2,
+	DEC_SLOT_AVX2,
+	NR_DECS,
+};
+
+static const char * const dec_name[NR_DECS] = {
+	"per-cqe ref", "driver", "scalar slot", "sse2 slot", "avx2 slot",
+};
+
+static bool have_avx2;
+
+/* Stand-in for handle_rx_cqe(), reads the fields the RX handlers read */
+static u64 __attribute__((noinline)) consume(const struct mlx5_cqe64 *cqe)
+{
+	return cqe->byte_cnt ^ cqe->check_sum ^ cqe->wqe_counter ^
+	       cqe->op_own ^ cqe->rss_hash_result;
+}
+
+/* Store the CQE when checking, hand it to consume() when benchmarking */
+static inline void emit(const struct mlx5_cqe64 *cqe, struct mlx5_cqe64 *out,
+			u32 i, u64 *acc)
+{
+	if (out)
+		out[i] = *cqe;
+	else
+		*acc += consume(cqe);
+}
+
+static const struct mlx5_mini_cqe8 *session_mini(const struct session *s,
+						 u32 i)
+{
+	return &s->mini[i / MLX5_MINI_CQE_ARRAY_SIZE]
+		       [i % MLX5_MINI_CQE_ARRAY_SIZE];
+}
+
+/* Consumed strides of a striding RQ mini CQE, the top half of byte_cnt */
+static u16 ref_strides(const struct mlx5_mini_cqe8 *mini)
+{
+	return 0x7fff & (be32_to_cpu(mini->byte_cnt) >> 16);
+}
+
+/* The per-CQE decompression of the original RX path */
+static u64 decompress_ref(const struct session *s, struct mlx5_cqe64 *out)
+{
+	struct mlx5_cqe64 title = s->title;
+	u16 wqe_counter = be16_to_cpu(title.wqe_counter);
+	u64 acc = 0;
+	u32 i;
+
+	for (i = 0; i < s->len; i++) {
+		const struct mlx5_mini_cqe8 *mini = session_mini(s, i);
+		u32 cqcc = s->cqcc + i;
+
+		title.byte_cnt     = mini->byte_cnt;
+		title.check_sum    = mini->checksum;
+		title.op_own      &= 0xf0;
+		title.op_own      |= 0x01 & (cqcc >> s->log_sz);
+		title.wqe_counter  = cpu_to_be16(wqe_counter);
+
+		if (s->striding)
+			wqe_counter += ref_strides(mini);
+		else
+			wqe_counter = (wqe_counter + 1) & s->sz_m1;
+
+		emit(&title, out, i, &acc);
+		title.rss_hash_type   = 0;
+		title.rss_hash_result = 0;
+	}
+
+	return acc;
+}
+
+/* Same flow as mlx5e_decompress_cqes_start()/_cont() */
+static u64 decompress_driver(const struct session *s, struct mlx5_cqe64 *out)
+{
+	struct mlx5_cqe64 title = s->title;
+	u16 ctr = be16_to_cpu(title.wqe_counter);
+	u64 acc = 0;
+	u32 i;
+
+	for (i = 0; i < s->len; i++) {
+		mlx5e_cqd_decompress_cqe(&title, session_mini(s, i), &ctr,
+					 s->striding, s->sz_m1,
+					 s->cqcc + i, s->log_sz);
+		emit(&title, out, i, &acc);
+		if (!i) {
+			title.rss_hash_type   = 0;
+			title.rss_hash_result = 0;
+		}
+	}
+
+	return acc;
+}
+
+static u16 expand_slot_scalar(struct mlx5_cqe64 *slot,
+			      const struct mlx5_cqe64 *title,
+			      const struct mlx5_mini_cqe8 *mini,
+			      bool striding, u16 sz_m1, u16 ctr,
+			      u32 cqcc, u8 log_sz)
+{
+	int i;
+
+	for (i = 0; i < MLX5_MINI_CQE_ARRAY_SIZE; i++) {
+		slot[i] = *title;
+		mlx5e_cqd_decompress_cqe(&slot[i], &mini[i], &ctr, striding,
+					 sz_m1, cqcc + i, log_sz);
+	}
+
+	return ctr;
+}
+
+#ifdef __x86_64__
+
+#define VEC_CLOBBERS	"memory", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4"
+
+static const u16 iota[MLX5_MINI_CQE_ARRAY_SIZE] = {
+	0, 1, 2, 3, 4, 5, 6, 7,
+};
+
+/* Big endian wqe counters of a striding RQ slot, returns the total number
+ * of strides the slot consumed.
+ */
+static inline u16 stride_ctrs_sse2(__be16 *ctrs,
+				   const struct mlx5_mini_cqe8 *mini, u16 ctr)
+{
+	u32 sum;
+
+	asm volatile(/* byte_cnt of every mini CQE, four per register */
+		     "movdqu      0(%[m]), %%xmm0\n\t"
+		     "movdqu     16(%[m]), %%xmm1\n\t"
+		     "movdqu     32(%[m]), %%xmm2\n\t"
+		     "movdqu     48(%[m]), %%xmm3\n\t"
+		     "psrlq      $32, %%xmm0\n\t"
+		     "psrlq      $32, %%xmm1\n\t"
+		     "psrlq      $32, %%xmm2\n\t"
+		     "psrlq      $32, %%xmm3\n\t"
+		     "pshufd     $0x88, %%xmm0, %%xmm0\n\t"
+		     "pshufd     $0x88, %%xmm1, %%xmm1\n\t"
+		     "pshufd     $0x88, %%xmm2, %%xmm2\n\t"
+		     "pshufd     $0x88, %%xmm3, %%xmm3\n\t"
+		     "punpcklqdq %%xmm1, %%xmm0\n\t"
+		     "punpcklqdq %%xmm3, %%xmm2\n\t"
+		     /* consumed strides: low 15 bits of the first be16 */
+		     "movdqa     %%xmm0, %%xmm1\n\t"
+		     "psllw      $8, %%xmm0\n\t"
+		     "psrlw      $8, %%xmm1\n\t"
+		     "por        %%xmm1, %%xmm0\n\t"
+		     "movdqa     %%xmm2, %%xmm3\n\t"
+		     "psllw      $8, %%xmm2\n\t"
+		     "psrlw      $8, %%xmm3\n\t"
+		     "por        %%xmm3, %%xmm2\n\t"
+		     "pcmpeqd    %%xmm4, %%xmm4\n\t"
+		     "psrld      $17, %%xmm4\n\t"
+		     "pand       %%xmm4, %%xmm0\n\t"
+		     "pand       %%xmm4, %%xmm2\n\t"
+		     "packssdw   %%xmm2, %%xmm0\n\t"
+		     /* inclusive prefix sum, the last lane is the total */
+		     "movdqa     %%xmm0, %%xmm1\n\t"
+		     "pslldq     $2, %%xmm1\n\t"
+		     "paddw      %%xmm1, %%xmm0\n\t"
+		     "movdqa     %%xmm0, %%xmm1\n\t"
+		     "pslldq     $4, %%xmm1\n\t"
+		     "paddw      %%xmm1, %%xmm0\n\t"
+		     "movdqa     %%xmm0, %%xmm1\n\t"
+		     "pslldq     $8, %%xmm1\n\t"
+		     "paddw      %%xmm1, %%xmm0\n\t"
+		     "pextrw     $7, %%xmm0, %[sum]\n\t"
+		     /* exclusive prefix sum plus the running counter */
+		     "pslldq     $2, %%xmm0\n\t"
+		     "movd       %[ctr], %%xmm1\n\t"
+		     "pshuflw    $0, %%xmm1, %%xmm1\n\t"
+		     "punpcklqdq %%xmm1, %%xmm1\n\t"
+		     "paddw      %%xmm1, %%xmm0\n\t"
+		     /* to big endian */
+		     "movdqa     %%xmm0, %%xmm1\n\t"
+		     "psllw      $8, %%xmm0\n\t"
+		     "psrlw      $8, %%xmm1\n\t"
+		     "por        %%xmm1, %%xmm0\n\t"
+		     "movdqu     %%xmm0, (%[out])\n\t"
+		     : [sum] "=&r" (sum)
+		     : [m] "r" (mini), [ctr] "r" ((u32)ctr), [out] "r" (ctrs)
+		     : VEC_CLOBBERS);
+
+	return sum;
+}
+
+/* Big endian wqe counters of a cyclic RQ slot, the first one is the
+ * counter as the title carries it.
+ */
+static inline void cyc_ctrs_sse2(__be16 *ctrs, u16 ctr, u16 sz_m1)
+{
+	asm volatile("movd       %[ctr], %%xmm0\n\t"
+		     "pshuflw    $0, %%xmm0, %%xmm0\n\t"
+		     "punpcklqdq %%xmm0, %%xmm0\n\t"
+		     "movdqu     (%[iota]), %%xmm1\n\t"
+		     "paddw      %%xmm1, %%xmm0\n\t"
+		     "movd       %[m1], %%xmm2\n\t"
+		     "pshuflw    $0, %%xmm2, %%xmm2\n\t"
+		     "punpcklqdq %%xmm2, %%xmm2\n\t"
+		     "pcmpeqd    %%xmm3, %%xmm3\n\t"
+		     "psrldq     $14, %%xmm3\n\t"
+		     "por        %%xmm3, %%xmm2\n\t"
+		     "pand       %%xmm2, %%xmm0\n\t"
+		     "movdqa     %%xmm0, %%xmm1\n\t"
+		     "psllw      $8, %%xmm0\n\t"
+		     "psrlw      $8, %%xmm1\n\t"
+		     "por        %%xmm1, %%xmm0\n\t"
+		     "movdqu     %%xmm0, (%[out])\n\t"
+		     :
+		     : [ctr] "r" ((u32)ctr), [m1] "r" ((u32)sz_m1),
+		       [iota] "r" (iota), [out] "r" (ctrs)
+		     : VEC_CLOBBERS);
+}
+
+static inline void fill_slot_sse2(struct mlx5_cqe64 *slot,
+				  const struct mlx5_cqe64 *title)
+{
+	asm volatile("movdqu  0(%[t]), %%xmm0\n\t"
+		     "movdqu 16(%[t]), %%xmm1\n\t"
+		     "movdqu 32(%[t]), %%xmm2\n\t"
+		     "movdqu 48(%[t]), %%xmm3\n\t"
+		     ".irp off, 0, 64, 128, 192, 256, 320, 384, 448\n\t"
+		     "movdqu %%xmm0, \\off(%[s])\n\t"
+		     "movdqu %%xmm1, \\off+16(%[s])\n\t"
+		     "movdqu %%xmm2, \\off+32(%[s])\n\t"
+		     "movdqu %%xmm3, \\off+48(%[s])\n\t"
+		     ".endr\n\t"
+		     :
+		     : [s] "r" (slot), [t] "r" (title)
+		     : VEC_CLOBBERS);
+}
+
+static inline void fill_slot_avx2(struct mlx5_cqe64 *slot,
+				  const struct mlx5_cqe64 *title)
+{
+	asm volatile("vmovdqu  0(%[t]), %%ymm0\n\t"
+		     "vmovdqu 32(%[t]), %%ymm1\n\t"
+		     ".irp off, 0, 64, 128, 192, 256, 320, 384, 448\n\t"
+		     "vmovdqu %%ymm0, \\off(%[s])\n\t"
+		     "vmovdqu %%ymm1, \\off+32(%[s])\n\t"
+		     ".endr\n\t"
+		     "vzeroupper\n\t"
+		     :
+		     : [s] "r" (slot), [t] "r" (title)
+		     : VEC_CLOBBERS);
+}
+
+static u16 expand_slot_vec(struct mlx5_cqe64 *slot,
+			   const struct mlx5_cqe64 *title,
+			   const struct mlx5_mini_cqe8 *mini,
+			   bool striding, u16 sz_m1, u16 ctr,
+			   u32 cqcc, u8 log_sz, bool avx2)
+{
+	__be16 ctrs[MLX5_MINI_CQE_ARRAY_SIZE];
+	u8 op_own = title->op_own & 0xf0;
+	u16 next;
+	int i;
+
+	if (striding) {
+		next = ctr + stride_ctrs_sse2(ctrs, mini, ctr);
+	} else {
+		cyc_ctrs_sse2(ctrs, ctr, sz_m1);
+		next = (ctr + MLX5_MINI_CQE_ARRAY_SIZE) & sz_m1;
+	}
+
+	if (avx2)
+		fill_slot_avx2(slot, title);
+	else
+		fill_slot_sse2(slot, title);
+
+	for (i = 0; i < MLX5_MINI_CQE_ARRAY_SIZE; i++) {
+		struct mlx5_cqe64 *cqe = &slot[i];
+
+		cqe->byte_cnt    = mini[i].byte_cnt;
+		cqe->check_sum   = mini[i].checksum;
+		cqe->wqe_counter = ctrs[i];
+		cqe->op_own      = op_own | (0x01 & ((cqcc + i) >> log_sz));
+	}
+
+	return next;
+}
+
+#endif /* __x86_64__ */
+
+static u16 expand_slot(int dec, const struct session *s,
+		       struct mlx5_cqe64 *slot, const struct mlx5_cqe64 *title,
+		       const struct mlx5_mini_cqe8 *mini, u16 ctr, u32 cqcc)
+{
+	switch (dec) {
+#ifdef __x86_64__
+	case DEC_SLOT_SSE2:
+	case DEC_SLOT_AVX2:
+		return expand_slot_vec(slot, title, mini, s->striding,
+				       s->sz_m1, ctr, cqcc, s->log_sz,
+				       dec == DEC_SLOT_AVX2);
+#endif
+	default:
+		return expand_slot_scalar(slot, title, mini, s->striding,
+					  s->sz_m1, ctr, cqcc, s->log_sz);
+	}
+}
+
+/* Whole slots expanded ahead, then handed out one CQE at a time */
+static u64 decompress_slots(int dec, const struct session *s,
+			    struct mlx5_cqe64 *out)
+{
+	struct mlx5_cqe64 slot[MLX5_MINI_CQE_ARRAY_SIZE]
+		__attribute__((aligned(64)));
+	struct mlx5_cqe64 title = s->title;
+	u16 ctr = be16_to_cpu(title.wqe_counter);
+	u64 acc = 0;
+	u32 i;
+
+	title.rss_hash_type   = 0;
+	title.rss_hash_result = 0;
+	for (i = 0; i < s->len; i++) {
+		int idx = i % MLX5_MINI_CQE_ARRAY_SIZE;
+
+		if (!idx) {
+			ctr = expand_slot(dec, s, slot, &title,
+					  session_mini(s, i), ctr,
+					  s->cqcc + i);
+			if (!i) {
+				slot[0].rss_hash_type   = s->title.rss_hash_type;
+				slot[0].rss_hash_result = s->title.rss_hash_result;
+			}
+		}
+		emit(&slot[idx], out, i, &acc);
+	}
+
+	return acc;
+}
+
+static u64 decompress(int dec, const struct session *s,
+		      struct mlx5_cqe64 *out)
+{
+	switch (dec) {
+	case DEC_REF:
+		return decompress_ref(s, out);
+	case DEC_DRIVER:
+		return decompress_driver(s, out);
+	default:
+		return decompress_slots(dec, s, out);
+	}
+}
+
+static bool dec_supported(int dec)
+{
+#ifdef __x86_64__
+	if (dec == DEC_SLOT_AVX2)
+		return have_avx2;
+	return true;
+#else
+	return dec != DEC_SLOT_SSE2 && dec != DEC_SLOT_AVX2;
+#endif
+}
+
+static u32 rnd(void)
+{
+	return ((u32)rand() << 16) ^ (u32)rand();
+}
+
+static void fill_rand(void *p, size_t len)
+{
+	u8 *b = p;
+
+	while (len--)
+		*b++ = rand();
+}
+
+static void gen_session(struct session *s)
+{
+	fill_rand(&s->title, sizeof(s->title));
+	fill_rand(s->mini, sizeof(s->mini));
+	s->len = 1 + rnd() % MAX_SESSION;
+	s->title.byte_cnt = __builtin_bswap32(s->len);
+	s->log_sz = 6 + rnd() % 8;
+	s->cqcc = rnd();
+	s->striding = rnd() & 1;
+	s->sz_m1 = (1 << (rnd() % 16)) - 1;
+}
+
+static int check(int sessions)
+{
+	static struct mlx5_cqe64 ref[MAX_SESSION], res[MAX_SESSION];
+	struct session s;
+	int n, dec, err = 0;
+	u32 i;
+
+	for (n = 0; n < sessions; n++) {
+		gen_session(&s);
+		decompress(DEC_REF, &s, ref);
+		for (dec = DEC_DRIVER; dec < NR_DECS; dec++) {
+			if (!dec_supported(dec))
+				continue;
+			memset(res, 0, sizeof(res));
+			decompress(dec, &s, res);
+			for (i = 0; i < s.len; i++) {
+				if (!memcmp(&ref[i], &res[i], sizeof(ref[i])))
+					continue;
+				fprintf(stderr,
+					"%s: session %d (len %u, %s) cqe %u differs\n",
+					dec_name[dec], n, s.len,
+					s.striding ? "striding" : "cyclic", i);
+				err = 1;
+				break;
+			}
+		}
+	}
+
+	return err;
+}
+
+static u64 now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void bench(void)
+{
+	static struct session s;
+	const int iters = 200000;
+	u64 start, ns, acc = 0;
+	int dec, n;
+
+	gen_session(&s);
+	s.len = MAX_SESSION;
+	s.title.byte_cnt = __builtin_bswap32(s.len);
+
+	for (dec = 0; dec < NR_DECS; dec++) {
+		if (!dec_supported(dec))
+			continue;
+		start = now_ns();
+		for (n = 0; n < iters; n++)
+			acc += decompress(dec, &s, NULL);
+		ns = now_ns() - start;
+		printf("%-12s %6.2f ns/cqe\n", dec_name[dec],
+		       (double)ns / ((u64)iters * s.len));
+	}
+
+	/* keep the work alive */
+	if (acc == 42)
+		printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+	int sessions = argc > 1 ? atoi(argv[1]) : 20000;
+
+#ifdef __x86_64__
+	have_avx2 = __builtin_cpu_supports("avx2");
+#endif
+	srand(time(NULL));
+
+	if (check(sessions))
+		return 1;
+	printf("%d sessions: all decompressions match the per-cqe reference\n",
+	       sessions);
+
+	bench();
+	return 0;
+}
@@ -46,6 +46,7 @@
 
 #include "mlx5_core.h"
 #include "lib/eq.h"
+#include "fw_emu.h"
 
 enum {
 	CMD_IF_REV = 5,
@@ -887,6 +888,12 @@ static void free_msg(struct mlx5_core_dev *dev, struct mlx5_cmd_msg *msg);
 static void mlx5_free_cmd_msg(struct mlx5_core_dev *dev,
 			      struct mlx5_cmd_msg *msg);
 
+/* Emulated devices are not backed by a PCI function */
+static bool mlx5_cmd_pci_offline(struct mlx5_core_dev *dev)
+{
+	return dev->pdev && pci_channel_offline(dev->pdev);
+}
+
 static bool opcode_allowed(struct mlx5_cmd *cmd, u16 opcode)
 {
 	if (!cmd->allowed_opcode)
@@ -898,13 +905,66 @@ static bool opcode_allowed(struct mlx5_cmd *cmd, u16 opcode)
 	return true;
 }
 
+static bool cmd_fw_unavailable(struct mlx5_core_dev *dev, u16 opcode)
+{
+	return mlx5_cmd_pci_offline(dev) ||
+	       dev->state == MLX5_DEVICE_STATE_INTERNAL_ERROR ||
+	       !opcode_allowed(&dev->cmd, opcode);
+}
+
+/* Build the descriptor of @ent in the slot it owns, ent->idx */
+static void cmd_prepare_lay(struct mlx5_core_dev *dev,
+			    struct mlx5_cmd_work_ent *ent)
+{
+	struct mlx5_cmd *cmd = ent->cmd;
+	struct mlx5_cmd_layout *lay;
+
+	cmd->ent_arr[ent->idx] = ent;
+	lay = get_inst(cmd, ent->idx);
+	ent->lay = lay;
+	memset(lay, 0, sizeof(*lay));
+	memcpy(lay->in, ent->in->first.data, sizeof(lay->in));
+	ent->op = be32_to_cpu(lay->in[0]) >> 16;
+	if (ent->in->next)
+		lay->in_ptr = cpu_to_be64(ent->in->next->dma);
+	lay->inlen = cpu_to_be32(ent->in->len);
+	if (ent->out->next)
+		lay->out_ptr = cpu_to_be64(ent->out->next->dma);
+	lay->outlen = cpu_to_be32(ent->out->len);
+	lay->type = MLX5_PCI_CMD_XPORT;
+	lay->token = ent->token;
+	lay->status_own = CMD_OWNER_HW;
+	set_signature(ent, !cmd->checksum_disabled);
+	dump_command(dev, ent, 1);
+#ifdef HAVE_KTIME_GET_NS
+	ent->ts1 = ktime_get_ns();
+#else
+	ktime_get_ts(&ent->ts1);
+#endif
+}
+
+/* Complete @ent with the driver generated status, without the firmware */
+static void cmd_complete_internal_err(struct mlx5_core_dev *dev,
+				      struct mlx5_cmd_work_ent *ent)
+{
+	u8 status = 0;
+	u32 drv_synd;
+
+	ent->ret = mlx5_internal_err_ret_value(dev, msg_to_opcode(ent->in), &drv_synd, &status);
+	MLX5_SET(mbox_out, ent->out, status, status);
+	MLX5_SET(mbox_out, ent->out, syndrome, drv_synd);
+
+	mlx5_cmd_comp_handler(dev, 1UL << ent->idx, MLX5_CMD_COMP_TYPE_FORCED);
+	/* no doorbell, no need to keep the entry */
+	free_ent(ent->cmd, ent->idx);
+}
+
 static void cmd_work_handler(struct work_struct *work)
 {
 	struct mlx5_cmd_work_ent *ent = container_of(work, struct mlx5_cmd_work_ent, work);
 	struct mlx5_cmd *cmd = ent->cmd;
 	struct mlx5_core_dev *dev = container_of(cmd, struct mlx5_core_dev, cmd);
 	unsigned long cb_timeout = msecs_to_jiffies(MLX5_CMD_TIMEOUT_MSEC);
-	struct mlx5_cmd_layout *lay;
 	struct semaphore *sem;
 	unsigned long flags;
 	bool poll_cmd = ent->polling;
@@ -940,28 +1000,7 @@ static void cmd_work_handler(struct work_struct *work)
 		spin_unlock_irqrestore(&cmd->alloc_lock, flags);
 	}
 
-	cmd->ent_arr[ent->idx] = ent;
-	lay = get_inst(cmd, ent->idx);
-	ent->lay = lay;
-	memset(lay, 0, sizeof(*lay));
-	memcpy(lay->in, ent->in->first.data, sizeof(lay->in));
-	ent->op = be32_to_cpu(lay->in[0]) >> 16;
-	if (ent->in->next)
-		lay->in_ptr = cpu_to_be64(ent->in->next->dma);
-	lay->inlen = cpu_to_be32(ent->in->len);
-	if (ent->out->next)
-		lay->out_ptr = cpu_to_be64(ent->out->next->dma);
-	lay->outlen = cpu_to_be32(ent->out->len);
-	lay->type = MLX5_PCI_CMD_XPORT;
-	lay->token = ent->token;
-	lay->status_own = CMD_OWNER_HW;
-	set_signature(ent, !cmd->checksum_disabled);
-	dump_command(dev, ent, 1);
-#ifdef HAVE_KTIME_GET_NS
-	ent->ts1 = ktime_get_ns();
-#else
-	ktime_get_ts(&ent->ts1);
-#endif
+	cmd_prepare_lay(dev, ent);
 	cmd_mode = cmd->mode;
 	set_bit(MLX5_CMD_ENT_STATE_PENDING_COMP, &ent->state);
 
@@ -969,19 +1008,8 @@ static void cmd_work_handler(struct work_struct *work)
 		schedule_delayed_work(&ent->cb_timeout_work, cb_timeout);
 
 	/* Skip sending command to fw if internal error */
-	if (pci_channel_offline(dev->pdev) ||
-	    dev->state == MLX5_DEVICE_STATE_INTERNAL_ERROR ||
-	    !opcode_allowed(&dev->cmd, ent->op)) {
-		u8 status = 0;
-		u32 drv_synd;
-
-		ent->ret = mlx5_internal_err_ret_value(dev, msg_to_opcode(ent->in), &drv_synd, &status);
-		MLX5_SET(mbox_out, ent->out, status, status);
-		MLX5_SET(mbox_out, ent->out, syndrome, drv_synd);
-
-		mlx5_cmd_comp_handler(dev, 1UL << ent->idx, MLX5_CMD_COMP_TYPE_FORCED);
-		/* no doorbell, no need to keep the entry */
-		free_ent(cmd, ent->idx);
+	if (cmd_fw_unavailable(dev, ent->op)) {
+		cmd_complete_internal_err(dev, ent);
 		if (ent->callback)
 			free_cmd(ent);
 		return;
@@ -990,7 +1018,10 @@ static void cmd_work_handler(struct work_struct *work)
 	/* ring doorbell after the descriptor is valid */
 	mlx5_core_dbg(dev, "writing 0x%x to command doorbell\n", 1 << ent->idx);
 	wmb();
-	iowrite32be(1 << ent->idx, &dev->iseg->cmd_dbell);
+	if (mlx5_fw_emu_attached(dev))
+		mlx5_fw_emu_doorbell(dev, ent->idx);
+	else
+		iowrite32be(1 << ent->idx, &dev->iseg->cmd_dbell);
 	/* if not in polling don't use ent after this point */
 	if (cmd_mode == CMD_MODE_POLLING || poll_cmd) {
 		poll_timeout(ent);
@@ -1090,6 +1121,38 @@ out_err:
 	return err;
 }
 
+static void cmd_account_exec(struct mlx5_core_dev *dev,
+			     struct mlx5_cmd_work_ent *ent)
+{
+	struct mlx5_cmd *cmd = &dev->cmd;
+	struct mlx5_cmd_stats *stats;
+#ifndef HAVE_KTIME_GET_NS
+	ktime_t t1, t2, delta;
+#endif
+	s64 ds;
+	u16 op;
+
+#ifdef HAVE_KTIME_GET_NS
+	ds = ent->ts2 - ent->ts1;
+#else
+	t1 = timespec_to_ktime(ent->ts1);
+	t2 = timespec_to_ktime(ent->ts2);
+	delta = ktime_sub(t2, t1);
+	ds = ktime_to_ns(delta);
+#endif
+	op = msg_to_opcode(ent->in);
+	if (op < ARRAY_SIZE(cmd->stats)) {
+		stats = &cmd->stats[op];
+		spin_lock_irq(&stats->lock);
+		stats->sum += ds;
+		++stats->n;
+		spin_unlock_irq(&stats->lock);
+	}
+	mlx5_core_dbg_mask(dev, 1 << MLX5_CMD_TIME,
+			   "fw exec time for %s is %lld nsec\n",
+			   mlx5_command_str(op), ds);
+}
+
 /*  Notes:
  *    1. Callback functions may not sleep
  *    2. page queue commands do not support asynchrous completion
@@ -1102,13 +1165,7 @@ static int mlx5_cmd_invoke(struct mlx5_core_dev *dev, struct mlx5_cmd_msg *in,
 {
 	struct mlx5_cmd *cmd = &dev->cmd;
 	struct mlx5_cmd_work_ent *ent;
-	struct mlx5_cmd_stats *stats;
-#ifndef HAVE_KTIME_GET_NS
-	ktime_t t1, t2, delta;
-#endif
 	int err = 0;
-	s64 ds;
-	u16 op;
 
 	if (callback && page_queue)
 		return -EINVAL;
@@ -1145,25 +1202,7 @@ static int mlx5_cmd_invoke(struct mlx5_core_dev *dev, struct mlx5_cmd_msg *in,
 	if (err == -ECANCELED)
 		goto out_free;
 
-#ifdef HAVE_KTIME_GET_NS
-	ds = ent->ts2 - ent->ts1;
-#else
-	t1 = timespec_to_ktime(ent->ts1);
-	t2 = timespec_to_ktime(ent->ts2);
-	delta = ktime_sub(t2, t1);
-	ds = ktime_to_ns(delta);
-#endif
-	op = MLX5_GET(mbox_in, in->first.data, opcode);
-	if (op < ARRAY_SIZE(cmd->stats)) {
-		stats = &cmd->stats[op];
-		spin_lock_irq(&stats->lock);
-		stats->sum += ds;
-		++stats->n;
-		spin_unlock_irq(&stats->lock);
-	}
-	mlx5_core_dbg_mask(dev, 1 << MLX5_CMD_TIME,
-			   "fw exec time for %s is %lld nsec\n",
-			   mlx5_command_str(op), ds);
+	cmd_account_exec(dev, ent);
 	*status = ent->status;
 
 out_free:
@@ -1589,6 +1628,64 @@ static int cmd_comp_notifier(struct notifier_block *nb,
 
 	return NOTIFY_OK;
 }
+#ifdef CONFIG_MLX5_FW_EMU
+/* Firmware emulator side of the doorbell: execute the command in slot @idx
+ * and hand the descriptor back to software the way the HCA does, either by
+ * clearing the ownership bit for a polling waiter or by raising the
+ * completion as a command EQE would.
+ */
+void mlx5_cmd_emu_exec(struct mlx5_core_dev *dev, int idx)
+{
+	struct mlx5_cmd *cmd = &dev->cmd;
+	struct mlx5_cmd_work_ent *ent = cmd->ent_arr[idx];
+	struct mlx5_cmd_layout *lay = ent->lay;
+	int inlen = be32_to_cpu(lay->inlen);
+	int outlen = be32_to_cpu(lay->outlen);
+	bool polled = cmd->mode == CMD_MODE_POLLING || ent->polling;
+	u8 status = MLX5_CMD_DELIVERY_STAT_OK;
+	void *in, *out;
+
+	/* the model reads and writes whole layouts regardless of how much of
+	 * them the caller asked for; pad both sides to the largest one
+	 */
+	in = kvzalloc(max_t(int, inlen, MLX5_ST_SZ_BYTES(set_hca_cap_in)),
+		      GFP_KERNEL);
+	out = kvzalloc(max_t(int, outlen,
+			     MLX5_ST_SZ_BYTES(query_hca_cap_out)),
+		       GFP_KERNEL);
+	if (!in || !out || mlx5_copy_from_msg(in, ent->in, inlen)) {
+		status = MLX5_CMD_DELIVERY_STAT_FW_ERR;
+		goto out;
+	}
+
+	mlx5_fw_emu_exec(dev->fw_emu, in, inlen, out, outlen);
+	mlx5_copy_to_msg(ent->out, out, outlen, ent->token);
+	memcpy(lay->out, ent->out->first.data, sizeof(lay->out));
+
+out:
+	kvfree(out);
+	kvfree(in);
+	/* a polling waiter may free ent as soon as it sees SW ownership */
+	wmb();
+	WRITE_ONCE(lay->status_own, status << 1);
+	if (!polled)
+		mlx5_cmd_comp_handler(dev, 1UL << idx, MLX5_CMD_COMP_TYPE_EVENT);
+}
+
+/* The emulator raises completions itself, there is no command EQ to hook */
+void mlx5_cmd_emu_use_events(struct mlx5_core_dev *dev)
+{
+	mlx5_cmd_change_mod(dev, CMD_MODE_EVENTS);
+}
+EXPORT_SYMBOL(mlx5_cmd_emu_use_events);
+
+void mlx5_cmd_emu_use_polling(struct mlx5_core_dev *dev)
+{
+	mlx5_cmd_change_mod(dev, CMD_MODE_POLLING);
+}
+EXPORT_SYMBOL(mlx5_cmd_emu_use_polling);
+#endif
+
 void mlx5_cmd_use_events(struct mlx5_core_dev *dev)
 {
 	MLX5_NB_INIT(&dev->cmd.nb, cmd_comp_notifier, CMD);
@@ -1676,7 +1773,7 @@ static void mlx5_cmd_comp_handler(struct mlx5_core_dev *dev, u64 vec, enum mlx5_
 #else
 			ktime_get_ts(&ent->ts2);
 #endif
-			if (!pci_channel_offline(dev->pdev) &&
+			if (!mlx5_cmd_pci_offline(dev) &&
 			    dev->state != MLX5_DEVICE_STATE_INTERNAL_ERROR) {
 				memcpy(ent->out->first.data, ent->lay->out, sizeof(ent->lay->out));
 				dump_command(dev, ent, 0);
@@ -1885,7 +1982,7 @@ static int cmd_exec(struct mlx5_core_dev *dev, void *in, int in_size, void *out,
 	u8 token;
 
 	opcode = MLX5_GET(mbox_in, in, opcode);
-	if (pci_channel_offline(dev->pdev) ||
+	if (mlx5_cmd_pci_offline(dev) ||
 	    dev->state == MLX5_DEVICE_STATE_INTERNAL_ERROR ||
 	    !opcode_allowed(&dev->cmd, opcode)) {
 		err = mlx5_internal_err_ret_value(dev, opcode, &drv_synd, &status);
@@ -2007,6 +2104,215 @@ int mlx5_cmd_exec_polling(struct mlx5_core_dev *dev, void *in, int in_size,
 }
 EXPORT_SYMBOL(mlx5_cmd_exec_polling);
 
+static struct mlx5_cmd_work_ent *
+cmd_batch_prepare(struct mlx5_core_dev *dev, struct mlx5_cmd_batch_ent *bent)
+{
+	struct mlx5_cmd_work_ent *ent;
+	struct mlx5_cmd_msg *inb;
+	struct mlx5_cmd_msg *outb;
+	u8 status = 0;
+	u32 drv_synd;
+	u16 opcode;
+	u8 token;
+	int err;
+
+	opcode = MLX5_GET(mbox_in, bent->in, opcode);
+	if (cmd_fw_unavailable(dev, opcode)) {
+		err = mlx5_internal_err_ret_value(dev, opcode, &drv_synd, &status);
+		MLX5_SET(mbox_out, bent->out, status, status);
+		MLX5_SET(mbox_out, bent->out, syndrome, drv_synd);
+		return ERR_PTR(err);
+	}
+
+	/* page commands have a dedicated slot and semaphore */
+	if (WARN_ON(is_manage_pages(bent->in)))
+		return ERR_PTR(-EINVAL);
+
+	inb = alloc_msg(dev, bent->in_size, GFP_KERNEL);
+	if (IS_ERR(inb))
+		return ERR_CAST(inb);
+
+	token = alloc_token(&dev->cmd);
+	err = mlx5_copy_to_msg(inb, bent->in, bent->in_size, token);
+	if (err)
+		goto err_in;
+
+	outb = mlx5_alloc_cmd_msg(dev, GFP_KERNEL, bent->out_size, token);
+	if (IS_ERR(outb)) {
+		err = PTR_ERR(outb);
+		goto err_in;
+	}
+
+	ent = alloc_cmd(&dev->cmd, inb, outb, bent->out, bent->out_size,
+			NULL, NULL, 0);
+	if (IS_ERR(ent)) {
+		err = PTR_ERR(ent);
+		goto err_out;
+	}
+
+	ent->token = token;
+	init_completion(&ent->handled);
+	init_completion(&ent->done);
+	/* posted from the caller's context, there is no queued work */
+	complete(&ent->handled);
+	INIT_DELAYED_WORK(&ent->cb_timeout_work, cb_timeout_handler);
+	INIT_WORK(&ent->work, cmd_work_handler);
+	return ent;
+
+err_out:
+	mlx5_free_cmd_msg(dev, outb);
+err_in:
+	free_msg(dev, inb);
+	return ERR_PTR(err);
+}
+
+/* Post entries from @ents[start] on into every free slot and ring a single
+ * doorbell for all of them. Only the first slot is waited for, so a batch
+ * larger than the queue is posted in waves as earlier commands complete.
+ * Returns the index of the first entry that was not posted.
+ */
+static int cmd_batch_post(struct mlx5_core_dev *dev,
+			  struct mlx5_cmd_work_ent **ents, int start, int num)
+{
+	struct mlx5_cmd *cmd = &dev->cmd;
+	bool polling = cmd->mode == CMD_MODE_POLLING;
+	struct mlx5_cmd_work_ent *ent;
+	unsigned long db = 0;
+	int idx;
+	int i;
+
+	for (i = start; i < num; i++) {
+		ent = ents[i];
+		if (!ent)
+			continue;
+
+		if (!db)
+			down(&cmd->sem);
+		else if (down_trylock(&cmd->sem))
+			break;
+
+		idx = alloc_ent(cmd);
+		if (idx < 0) {
+			up(&cmd->sem);
+			if (db)
+				break;
+			mlx5_core_err(dev, "failed to allocate command entry\n");
+			ent->ret = -EAGAIN;
+			mlx5_free_cmd_msg(dev, ent->out);
+			complete(&ent->done);
+			continue;
+		}
+
+		ent->idx = idx;
+		cmd_prepare_lay(dev, ent);
+		set_bit(MLX5_CMD_ENT_STATE_PENDING_COMP, &ent->state);
+		if (cmd_fw_unavailable(dev, ent->op)) {
+			cmd_complete_internal_err(dev, ent);
+			continue;
+		}
+		db |= 1UL << idx;
+	}
+
+	if (!db)
+		return i;
+
+	/* ring doorbell after the descriptors are valid */
+	mlx5_core_dbg(dev, "writing 0x%lx to command doorbell\n", db);
+	wmb();
+	if (mlx5_fw_emu_attached(dev)) {
+		for_each_set_bit(idx, &db, MLX5_MAX_COMMANDS)
+			mlx5_fw_emu_doorbell(dev, idx);
+	} else {
+		iowrite32be(db, &dev->iseg->cmd_dbell);
+	}
+
+	if (polling) {
+		for_each_set_bit(idx, &db, MLX5_MAX_COMMANDS) {
+			ent = cmd->ent_arr[idx];
+			poll_timeout(ent);
+			/* make sure we read the descriptor after ownership is SW */
+			rmb();
+			mlx5_cmd_comp_handler(dev, 1UL << idx,
+					      ent->ret == -ETIMEDOUT ?
+					      MLX5_CMD_COMP_TYPE_FORCED :
+					      MLX5_CMD_COMP_TYPE_POLLING);
+		}
+	}
+
+	return i;
+}
+
+static int cmd_batch_wait(struct mlx5_core_dev *dev,
+			  struct mlx5_cmd_batch_ent *bent,
+			  struct mlx5_cmd_work_ent *ent)
+{
+	struct mlx5_cmd_msg *inb = ent->in;
+	u8 status = 0;
+	int err;
+
+	err = wait_func(dev, ent);
+	if (!err) {
+		cmd_account_exec(dev, ent);
+		status = ent->status;
+	}
+	/* a timed out entry is leaked, same as in mlx5_cmd_invoke() */
+	if (err != -ETIMEDOUT)
+		free_cmd(ent);
+	free_msg(dev, inb);
+
+	if (!err && status)
+		err = status_to_err(status);
+	return err ? : mlx5_cmd_check(dev, bent->in, bent->out);
+}
+
+/**
+ * mlx5_cmd_exec_batch - Execute independent commands concurrently
+ * @dev: mlx5 core device
+ * @ents: commands to execute, the result of each is returned in ->err
+ * @num: number of commands in @ents
+ *
+ * The commands are spread over all free command queue slots and posted
+ * with one doorbell per wave, so firmware may execute them in any order.
+ * Commands that depend on each other's results must not share a batch,
+ * and MANAGE_PAGES is not supported.
+ *
+ * Returns 0 if every command succeeded, else the error of the first
+ * failed one.
+ */
+int mlx5_cmd_exec_batch(struct mlx5_core_dev *dev,
+			struct mlx5_cmd_batch_ent *ents, int num)
+{
+	struct mlx5_cmd_work_ent **wents;
+	int err = 0;
+	int i;
+
+	wents = kvcalloc(num, sizeof(*wents), GFP_KERNEL);
+	if (!wents)
+		return -ENOMEM;
+
+	for (i = 0; i < num; i++) {
+		wents[i] = cmd_batch_prepare(dev, &ents[i]);
+		if (IS_ERR(wents[i])) {
+			ents[i].err = PTR_ERR(wents[i]);
+			wents[i] = NULL;
+		}
+	}
+
+	for (i = 0; i < num;)
+		i = cmd_batch_post(dev, wents, i, num);
+
+	for (i = 0; i < num; i++) {
+		if (wents[i])
+			ents[i].err = cmd_batch_wait(dev, &ents[i], wents[i]);
+		if (!err)
+			err = ents[i].err;
+	}
+
+	kvfree(wents);
+	return err;
+}
+EXPORT_SYMBOL(mlx5_cmd_exec_batch);
+
 static void destroy_msg_cache(struct mlx5_core_dev *dev)
 {
 	struct cmd_msg_cache *ch;
@@ -33,6 +33,8 @@
 #define CREATE_TRACE_POINTS
 #include "fw_tracer_tracepoint.h"
 #endif
+#include <linux/debugfs.h>
+#include <linux/vmalloc.h>
 #include "fw_tracer.h"
 
 #include "lib/eq.h"
@@ -667,6 +669,213 @@ static int mlx5_tracer_handle_trace(struct mlx5_fw_tracer *tracer,
 	return 0;
 }
 
+/* Raw trace ring: in raw mode the trace blocks are copied as they are
+ * into a vmalloc'ed ring that userspace maps through the fw_tracer/ring
+ * debugfs file, and the strings DB is exported as one blob through
+ * fw_tracer/strings_db. No string is formatted in the kernel. The ring
+ * is allocated the first time raw mode is enabled and kept until the
+ * tracer is destroyed, so existing mappings stay valid.
+ */
+static int mlx5_fw_tracer_ring_alloc(struct mlx5_fw_tracer *tracer)
+{
+	struct mlx5_fw_tracer_ring_hdr *hdr;
+
+	lockdep_assert_held(&tracer->ring.lock);
+
+	if (tracer->ring.hdr)
+		return 0;
+
+	hdr = vmalloc_user(TRACER_RING_SIZE_BYTE);
+	if (!hdr)
+		return -ENOMEM;
+
+	hdr->magic = TRACER_RING_MAGIC;
+	hdr->version = TRACER_RING_VERSION;
+	hdr->block_size = TRACER_BLOCK_SIZE_BYTE;
+	hdr->num_blocks = TRACER_RING_BLOCKS;
+	hdr->data_offset = PAGE_SIZE;
+	hdr->trc_ver = tracer->trc_ver;
+	hdr->first_string_trace = tracer->str_db.first_string_trace;
+	hdr->num_string_trace = tracer->str_db.num_string_trace;
+
+	tracer->ring.data = (void *)hdr + PAGE_SIZE;
+	/* Pairs with the acquire in mlx5_fw_tracer_handle_traces() */
+	smp_store_release(&tracer->ring.hdr, hdr);
+	return 0;
+}
+
+static void mlx5_fw_tracer_ring_push(struct mlx5_fw_tracer *tracer,
+				     u64 *block)
+{
+	struct mlx5_fw_tracer_ring_hdr *hdr = tracer->ring.hdr;
+	u64 head = hdr->head;
+
+	memcpy(tracer->ring.data +
+	       (head & (TRACER_RING_BLOCKS - 1)) * TRACER_BLOCK_SIZE_BYTE,
+	       block, TRACER_BLOCK_SIZE_BYTE);
+	/* The block must be visible before the head that covers it */
+	smp_store_release(&hdr->head, head + 1);
+}
+
+static ssize_t mlx5_fw_tracer_raw_read(struct file *filp, char __user *buf,
+				       size_t count, loff_t *pos)
+{
+	struct mlx5_fw_tracer *tracer = filp->private_data;
+	char kbuf[4];
+	int len;
+
+	len = snprintf(kbuf, sizeof(kbuf), "%d\n", READ_ONCE(tracer->ring.enabled));
+	return simple_read_from_buffer(buf, count, pos, kbuf, len);
+}
+
+static ssize_t mlx5_fw_tracer_raw_write(struct file *filp,
+					const char __user *buf,
+					size_t count, loff_t *pos)
+{
+	struct mlx5_fw_tracer *tracer = filp->private_data;
+	bool enable;
+	int err;
+
+	err = kstrtobool_from_user(buf, count, &enable);
+	if (err)
+		return err;
+
+	mutex_lock(&tracer->ring.lock);
+	if (enable) {
+		err = mlx5_fw_tracer_ring_alloc(tracer);
+		if (err) {
+			mutex_unlock(&tracer->ring.lock);
+			return err;
+		}
+	}
+	/* The ring must be set up before the trace handler sees raw mode */
+	smp_store_release(&tracer->ring.enabled, enable);
+	mutex_unlock(&tracer->ring.lock);
+
+	return count;
+}
+
+static const struct file_operations mlx5_fw_tracer_raw_fops = {
+	.owner = THIS_MODULE,
+	.open = simple_open,
+	.read = mlx5_fw_tracer_raw_read,
+	.write = mlx5_fw_tracer_raw_write,
+};
+
+static int mlx5_fw_tracer_ring_mmap(struct file *filp,
+				    struct vm_area_struct *vma)
+{
+	struct mlx5_fw_tracer *tracer = filp->private_data;
+	int err;
+
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+	/* Don't let mprotect() make the mapping writable later */
+	vma->vm_flags &= ~VM_MAYWRITE;
+
+	mutex_lock(&tracer->ring.lock);
+	if (!tracer->ring.hdr)
+		err = -ENODEV;
+	else
+		err = remap_vmalloc_range(vma, tracer->ring.hdr, vma->vm_pgoff);
+	mutex_unlock(&tracer->ring.lock);
+
+	return err;
+}
+
+static const struct file_operations mlx5_fw_tracer_ring_fops = {
+	.owner = THIS_MODULE,
+	.open = simple_open,
+	.mmap = mlx5_fw_tracer_ring_mmap,
+};
+
+/* Snapshot of the strings DB taken at open: u32 num_string_db, then a
+ * {u32 base_address, u32 size} pair per section, then the sections back
+ * to back.
+ */
+struct mlx5_fw_tracer_strings_blob {
+	size_t size;
+	u32 data[];
+};
+
+static int mlx5_fw_tracer_strings_db_open(struct inode *inode,
+					  struct file *filp)
+{
+	struct mlx5_fw_tracer *tracer = inode->i_private;
+	u32 num_string_db = tracer->str_db.num_string_db;
+	struct mlx5_fw_tracer_strings_blob *blob;
+	size_t size, offset;
+	int i;
+
+	if (!tracer->str_db.loaded)
+		return -EAGAIN;
+
+	offset = sizeof(u32) * (1 + 2 * num_string_db);
+	size = offset;
+	for (i = 0; i < num_string_db; i++)
+		size += tracer->str_db.size_out[i];
+
+	blob = kvzalloc(sizeof(*blob) + size, GFP_KERNEL);
+	if (!blob)
+		return -ENOMEM;
+
+	blob->size = size;
+	blob->data[0] = num_string_db;
+	for (i = 0; i < num_string_db; i++) {
+		blob->data[1 + 2 * i] = tracer->str_db.base_address_out[i];
+		blob->data[2 + 2 * i] = tracer->str_db.size_out[i];
+		memcpy((void *)blob->data + offset, tracer->str_db.buffer[i],
+		       tracer->str_db.size_out[i]);
+		offset += tracer->str_db.size_out[i];
+	}
+
+	filp->private_data = blob;
+	return 0;
+}
+
+static ssize_t mlx5_fw_tracer_strings_db_read(struct file *filp,
+					      char __user *buf,
+					      size_t count, loff_t *pos)
+{
+	struct mlx5_fw_tracer_strings_blob *blob = filp->private_data;
+
+	return simple_read_from_buffer(buf, count, pos, blob->data,
+				       blob->size);
+}
+
+static int mlx5_fw_tracer_strings_db_release(struct inode *inode,
+					     struct file *filp)
+{
+	kvfree(filp->private_data);
+	return 0;
+}
+
+static const struct file_operations mlx5_fw_tracer_strings_db_fops = {
+	.owner = THIS_MODULE,
+	.open = mlx5_fw_tracer_strings_db_open,
+	.read = mlx5_fw_tracer_strings_db_read,
+	.release = mlx5_fw_tracer_strings_db_release,
+};
+
+static void mlx5_fw_tracer_debugfs_init(struct mlx5_fw_tracer *tracer)
+{
+	struct mlx5_core_dev *dev = tracer->dev;
+
+	if (IS_ERR_OR_NULL(dev->priv.dbg_root))
+		return;
+
+	tracer->ring.dbg = debugfs_create_dir("fw_tracer", dev->priv.dbg_root);
+	if (IS_ERR_OR_NULL(tracer->ring.dbg))
+		return;
+
+	debugfs_create_file("raw", 0600, tracer->ring.dbg, tracer,
+			    &mlx5_fw_tracer_raw_fops);
+	debugfs_create_file("ring", 0400, tracer->ring.dbg, tracer,
+			    &mlx5_fw_tracer_ring_fops);
+	debugfs_create_file("strings_db", 0400, tracer->ring.dbg, tracer,
+			    &mlx5_fw_tracer_strings_db_fops);
+}
+
 static void mlx5_fw_tracer_handle_traces(struct work_struct *work)
 {
 	struct mlx5_fw_tracer *tracer =
@@ -675,6 +884,7 @@ static void mlx5_fw_tracer_handle_traces(struct work_struct *work)
 	u32 block_count, start_offset, prev_start_offset, prev_consumer_index;
 	u32 trace_event_size = MLX5_ST_SZ_BYTES(tracer_event);
 	struct mlx5_core_dev *dev = tracer->dev;
+	struct mlx5_fw_tracer_ring_hdr *ring_hdr;
 	struct tracer_event tracer_event;
 	int i;
 
@@ -715,6 +925,9 @@ static void mlx5_fw_tracer_handle_traces(struct work_struct *work)
 			 */
 			if (tracer->last_timestamp != last_block_timestamp) {
 				mlx5_core_warn(dev, "FWTracer: Events were lost\n");
+				ring_hdr = smp_load_acquire(&tracer->ring.hdr);
+				if (ring_hdr)
+					WRITE_ONCE(ring_hdr->lost, ring_hdr->lost + 1);
 				tracer->last_timestamp = block_timestamp;
 				tracer->buff.consumer_index =
 					(tracer->buff.consumer_index + 1) & (block_count - 1);
@@ -722,10 +935,15 @@ static void mlx5_fw_tracer_handle_traces(struct work_struct *work)
 			}
 		}
 
-		/* Parse events */
-		for (i = 0; i < TRACES_PER_BLOCK ; i++) {
-			poll_trace(tracer, &tracer_event, &tmp_trace_block[i]);
-			mlx5_tracer_handle_trace(tracer, &tracer_event);
+		/* Parse events, or leave it to the ring reader in raw mode */
+		if (smp_load_acquire(&tracer->ring.enabled)) {
+			mlx5_fw_tracer_ring_push(tracer, tmp_trace_block);
+		} else {
+			for (i = 0; i < TRACES_PER_BLOCK ; i++) {
+				poll_trace(tracer, &tracer_event,
+					   &tmp_trace_block[i]);
+				mlx5_tracer_handle_trace(tracer, &tracer_event);
+			}
 		}
 
 		tracer->buff.consumer_index =
@@ -962,6 +1180,7 @@ struct mlx5_fw_tracer *mlx5_fw_tracer_create(struct mlx5_core_dev *dev)
 	INIT_WORK(&tracer->ownership_change_work, mlx5_fw_tracer_ownership_change);
 	INIT_WORK(&tracer->read_fw_strings_work, mlx5_tracer_read_strings_db);
 	INIT_WORK(&tracer->handle_traces_work, mlx5_fw_tracer_handle_traces);
+	mutex_init(&tracer->ring.lock);
 
 
 	err = mlx5_query_mtrc_caps(tracer);
@@ -983,6 +1202,7 @@ struct mlx5_fw_tracer *mlx5_fw_tracer_create(struct mlx5_core_dev *dev)
 	}
 
 	mlx5_fw_tracer_init_saved_traces_array(tracer);
+	mlx5_fw_tracer_debugfs_init(tracer);
 	mlx5_core_dbg(dev, "FWTracer: Tracer created\n");
 
 	return tracer;
@@ -991,6 +1211,7 @@ free_log_buf:
 	mlx5_fw_tracer_destroy_log_buf(tracer);
 destroy_workqueue:
 	tracer->dev = NULL;
+	mutex_destroy(&tracer->ring.lock);
 	destroy_workqueue(tracer->work_queue);
 free_tracer:
 	kfree(tracer);
@@ -1064,6 +1285,7 @@ void mlx5_fw_tracer_destroy(struct mlx5_fw_tracer *tracer)
 
 	mlx5_core_dbg(tracer->dev, "FWTracer: Destroy\n");
 
+	debugfs_remove_recursive(tracer->ring.dbg);
 	cancel_work_sync(&tracer->read_fw_strings_work);
 	mlx5_fw_tracer_clean_ready_list(tracer);
 	mlx5_fw_tracer_clean_print_hash(tracer);
@@ -1072,6 +1294,8 @@ void mlx5_fw_tracer_destroy(struct mlx5_fw_tracer *tracer)
 	mlx5_fw_tracer_destroy_log_buf(tracer);
 	flush_workqueue(tracer->work_queue);
 	destroy_workqueue(tracer->work_queue);
+	vfree(tracer->ring.hdr);
+	mutex_destroy(&tracer->ring.lock);
 	kfree(tracer);
 }
 
@@ -56,6 +56,34 @@
 #define MASK_52_7 (0x1FFFFFFFFFFF80)
 #define MASK_6_0  (0x7F)
 
+#define TRACER_RING_MAGIC 0x4d4c5854 /* "MLXT" */
+#define TRACER_RING_VERSION 1
+#define TRACER_RING_BLOCKS 4096
+#define TRACER_RING_SIZE_BYTE \
+	(PAGE_SIZE + TRACER_RING_BLOCKS * TRACER_BLOCK_SIZE_BYTE)
+
+/* First page of the raw trace ring, followed by num_blocks trace blocks
+ * of block_size bytes starting at data_offset. Block n of the stream is
+ * at index n % num_blocks. head counts the blocks written so far and is
+ * updated after the block it covers. A reader that copied block n is
+ * still valid if head < n + num_blocks when read again after the copy.
+ * lost counts the times the driver skipped blocks the firmware had
+ * already overwritten. All fields are in host byte order.
+ */
+struct mlx5_fw_tracer_ring_hdr {
+	u32 magic;
+	u32 version;
+	u32 block_size;
+	u32 num_blocks;
+	u32 data_offset;
+	u8  trc_ver;
+	u8  first_string_trace;
+	u8  num_string_trace;
+	u8  rsvd;
+	u64 head;
+	u64 lost;
+};
+
 struct mlx5_fw_trace_data {
 	u64 timestamp;
 	bool lost;
@@ -105,6 +133,15 @@ struct mlx5_fw_tracer {
 	struct hlist_head hash[MESSAGE_HASH_SIZE];
 	struct list_head ready_strings_list;
 	char ready_string[1024];
+
+	/* Raw trace ring */
+	struct {
+		bool enabled;
+		struct mlx5_fw_tracer_ring_hdr *hdr;
+		void *data;
+		struct dentry *dbg;
+		struct mutex lock; /* Protect ring allocation */
+	} ring;
 };
 
 struct tracer_string_format {
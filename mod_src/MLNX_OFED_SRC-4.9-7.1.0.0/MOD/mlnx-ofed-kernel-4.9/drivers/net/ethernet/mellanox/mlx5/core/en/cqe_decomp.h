@@ -0,0 +1,43 @@
+/* SPDX-License-Identifier: GPL-2.0 OR Linux-OpenIB */
+/* Copyright (c) 2020 Mellanox Technologies. */
+
+#ifndef __MLX5_EN_CQE_DECOMP_H__
+#define __MLX5_EN_CQE_DECOMP_H__
+
+/* RX compressed CQE decompression helpers. They only depend on the CQE
+ * layouts, so the userspace harness in devtools/mlx5_cqe_decomp builds them
+ * as is and checks them against the original per-CQE decompression.
+ */
+
+#ifdef __KERNEL__
+#include <linux/mlx5/device.h>
+#endif
+
+static inline u16 mlx5e_cqd_mini_strides(const struct mlx5_mini_cqe8 *mini)
+{
+	const struct mpwrq_cqe_bc *bc = (const struct mpwrq_cqe_bc *)&mini->byte_cnt;
+
+	return 0x7fff & be16_to_cpu(bc->filler_consumed_strides);
+}
+
+/* Turn the title into the CQE described by @mini, in place, and advance
+ * the session wqe counter past it.
+ */
+static inline void mlx5e_cqd_decompress_cqe(struct mlx5_cqe64 *title,
+					    const struct mlx5_mini_cqe8 *mini,
+					    u16 *wqe_counter, bool striding,
+					    u16 sz_m1, u32 cqcc, u8 log_sz)
+{
+	title->byte_cnt     = mini->byte_cnt;
+	title->check_sum    = mini->checksum;
+	title->op_own      &= 0xf0;
+	title->op_own      |= 0x01 & (cqcc >> log_sz);
+	title->wqe_counter  = cpu_to_be16(*wqe_counter);
+
+	if (striding)
+		*wqe_counter += mlx5e_cqd_mini_strides(mini);
+	else
+		*wqe_counter = (*wqe_counter + 1) & sz_m1;
+}
+
+#endif /* __MLX5_EN_CQE_DECOMP_H__ */
@@ -50,6 +50,7 @@
 #include "lib/clock.h"
 #include "en/xdp.h"
 #include "en/health.h"
+#include "en/cqe_decomp.h"
 
 static inline bool mlx5e_rx_hw_stamp(struct hwtstamp_config *config)
 {
@@ -113,32 +114,13 @@ static inline void mlx5e_decompress_cqe(struct mlx5e_rq *rq,
 					struct mlx5_cqwq *wq,
 					u32 cqcc)
 {
-	struct mlx5e_cq_decomp *cqd = &rq->cqd;
-	struct mlx5_mini_cqe8 *mini_cqe = &cqd->mini_arr[cqd->mini_arr_idx];
-	struct mlx5_cqe64 *title = &cqd->title;
-
-	title->byte_cnt     = mini_cqe->byte_cnt;
-	title->check_sum    = mini_cqe->checksum;
-	title->op_own      &= 0xf0;
-	title->op_own      |= 0x01 & (cqcc >> wq->fbc.log_sz);
-	title->wqe_counter  = cpu_to_be16(cqd->wqe_counter);
-
-	if (rq->wq_type == MLX5_WQ_TYPE_LINKED_LIST_STRIDING_RQ)
-		cqd->wqe_counter += mpwrq_get_cqe_consumed_strides(title);
-	else
-		cqd->wqe_counter =
-			mlx5_wq_cyc_ctr2ix(&rq->wqe.wq, cqd->wqe_counter + 1);
-}
-
-static inline void mlx5e_decompress_cqe_no_hash(struct mlx5e_rq *rq,
-						struct mlx5_cqwq *wq,
-						u32 cqcc)
-{
+	bool striding = rq->wq_type == MLX5_WQ_TYPE_LINKED_LIST_STRIDING_RQ;
 	struct mlx5e_cq_decomp *cqd = &rq->cqd;
 
-	mlx5e_decompress_cqe(rq, wq, cqcc);
-	cqd->title.rss_hash_type   = 0;
-	cqd->title.rss_hash_result = 0;
+	mlx5e_cqd_decompress_cqe(&cqd->title, &cqd->mini_arr[cqd->mini_arr_idx],
+				 &cqd->wqe_counter, striding,
+				 striding ? 0 : rq->wqe.wq.fbc.sz_m1,
+				 cqcc, wq->fbc.log_sz);
 }
 
 static inline u32 mlx5e_decompress_cqes_cont(struct mlx5e_rq *rq,
@@ -158,7 +140,7 @@ static inline u32 mlx5e_decompress_cqes_cont(struct mlx5e_rq *rq,
 		if (cqd->mini_arr_idx == MLX5_MINI_CQE_ARRAY_SIZE)
 			mlx5e_read_mini_arr_slot(wq, cqd, cqcc);
 
-		mlx5e_decompress_cqe_no_hash(rq, wq, cqcc);
+		mlx5e_decompress_cqe(rq, wq, cqcc);
 		rq->handle_rx_cqe(rq, &cqd->title);
 	}
 	mlx5e_cqes_update_owner(wq, cqcc - wq->cc);
@@ -182,6 +164,12 @@ static inline u32 mlx5e_decompress_cqes_start(struct mlx5e_rq *rq,
 	rq->handle_rx_cqe(rq, &cqd->title);
 	cqd->mini_arr_idx++;
 
+	/* Only the first CQE of the session carries the hash, clear it
+	 * once here instead of for every CQE that follows.
+	 */
+	cqd->title.rss_hash_type   = 0;
+	cqd->title.rss_hash_result = 0;
+
 	return mlx5e_decompress_cqes_cont(rq, wq, 1, budget_rem);
 }
 
@@ -213,12 +213,14 @@ void mlx5e_flow_put_lock(struct mlx5e_priv *priv,
 			 struct mlx5e_tc_flow *flow, bool lock)
 {
 	if (refcount_dec_and_test(&flow->refcnt)) {
-		if (flow->dep_lock && lock)
-			spin_lock(flow->dep_lock);
+		spinlock_t *dep_lock = lock ? READ_ONCE(flow->dep_lock) : NULL;
+
+		if (dep_lock)
+			spin_lock(dep_lock);
 		if (!list_empty(&flow->nft_node))
 			list_del_init(&flow->nft_node);
-		if (flow->dep_lock && lock)
-			spin_unlock(flow->dep_lock);
+		if (dep_lock)
+			spin_unlock(dep_lock);
 		mlx5e_tc_del_flow(priv, flow);
 		kfree_rcu(flow, rcu_head);
 	}
@@ -383,19 +383,27 @@ static int esw_create_legacy_vepa_table(struct mlx5_eswitch *esw)
 	return 0;
 }
 
+enum {
+	ESW_LEGACY_ADDR_GRP,
+	ESW_LEGACY_ALLMULTI_GRP,
+	ESW_LEGACY_PROMISC_GRP,
+	ESW_LEGACY_NUM_GRPS,
+};
+
 static int esw_create_legacy_fdb_table(struct mlx5_eswitch *esw)
 {
 	int inlen = MLX5_ST_SZ_BYTES(create_flow_group_in);
+	struct mlx5_flow_group *fgs[ESW_LEGACY_NUM_GRPS];
+	u32 *fg_in[ESW_LEGACY_NUM_GRPS], *flow_group_in;
 	struct mlx5_flow_table_attr ft_attr = {};
 	struct mlx5_core_dev *dev = esw->dev;
 	struct mlx5_flow_namespace *root_ns;
 	struct mlx5_flow_table *fdb;
-	struct mlx5_flow_group *g;
 	void *match_criteria;
 	int table_size;
-	u32 *flow_group_in;
 	u8 *dmac;
 	int err = 0;
+	int i;
 
 	esw_debug(dev, "Create FDB log_max_size(%d)\n",
 		  MLX5_CAP_ESW_FLOWTABLE_FDB(dev, log_max_ft_size));
@@ -406,9 +414,11 @@ static int esw_create_legacy_fdb_table(struct mlx5_eswitch *esw)
 		return -EOPNOTSUPP;
 	}
 
-	flow_group_in = kvzalloc(inlen, GFP_KERNEL);
+	flow_group_in = kvcalloc(ESW_LEGACY_NUM_GRPS, inlen, GFP_KERNEL);
 	if (!flow_group_in)
 		return -ENOMEM;
+	for (i = 0; i < ESW_LEGACY_NUM_GRPS; i++)
+		fg_in[i] = flow_group_in + i * MLX5_ST_SZ_DW(create_flow_group_in);
 
 	table_size = BIT(MLX5_CAP_ESW_FLOWTABLE_FDB(dev, log_max_ft_size));
 	ft_attr.max_fte = table_size;
@@ -422,6 +432,7 @@ static int esw_create_legacy_fdb_table(struct mlx5_eswitch *esw)
 	esw->fdb_table.legacy.fdb = fdb;
 
 	/* Addresses group : Full match unicast/multicast addresses */
+	flow_group_in = fg_in[ESW_LEGACY_ADDR_GRP];
 	MLX5_SET(create_flow_group_in, flow_group_in, match_criteria_enable,
 		 MLX5_MATCH_OUTER_HEADERS);
 	match_criteria = MLX5_ADDR_OF(create_flow_group_in, flow_group_in, match_criteria);
@@ -430,51 +441,43 @@ static int esw_create_legacy_fdb_table(struct mlx5_eswitch *esw)
 	/* Preserve 2 entries for allmulti and promisc rules*/
 	MLX5_SET(create_flow_group_in, flow_group_in, end_flow_index, table_size - 3);
 	eth_broadcast_addr(dmac);
-	g = mlx5_create_flow_group(fdb, flow_group_in);
-	if (IS_ERR(g)) {
-		err = PTR_ERR(g);
-		esw_warn(dev, "Failed to create flow group err(%d)\n", err);
-		goto out;
-	}
-	esw->fdb_table.legacy.addr_grp = g;
 
 	/* Allmulti group : One rule that forwards any mcast traffic */
+	flow_group_in = fg_in[ESW_LEGACY_ALLMULTI_GRP];
 	MLX5_SET(create_flow_group_in, flow_group_in, match_criteria_enable,
 		 MLX5_MATCH_OUTER_HEADERS);
+	match_criteria = MLX5_ADDR_OF(create_flow_group_in, flow_group_in, match_criteria);
+	dmac = MLX5_ADDR_OF(fte_match_param, match_criteria, outer_headers.dmac_47_16);
 	MLX5_SET(create_flow_group_in, flow_group_in, start_flow_index, table_size - 2);
 	MLX5_SET(create_flow_group_in, flow_group_in, end_flow_index, table_size - 2);
-	eth_zero_addr(dmac);
 	dmac[0] = 0x01;
-	g = mlx5_create_flow_group(fdb, flow_group_in);
-	if (IS_ERR(g)) {
-		err = PTR_ERR(g);
-		esw_warn(dev, "Failed to create allmulti flow group err(%d)\n", err);
-		goto out;
-	}
-	esw->fdb_table.legacy.allmulti_grp = g;
 
 	/* Promiscuous group :
 	 * One rule that forward all unmatched traffic from previous groups
 	 */
-	eth_zero_addr(dmac);
+	flow_group_in = fg_in[ESW_LEGACY_PROMISC_GRP];
 	MLX5_SET(create_flow_group_in, flow_group_in, match_criteria_enable,
 		 MLX5_MATCH_MISC_PARAMETERS);
+	match_criteria = MLX5_ADDR_OF(create_flow_group_in, flow_group_in, match_criteria);
 	MLX5_SET_TO_ONES(fte_match_param, match_criteria, misc_parameters.source_port);
 	MLX5_SET(create_flow_group_in, flow_group_in, start_flow_index, table_size - 1);
 	MLX5_SET(create_flow_group_in, flow_group_in, end_flow_index, table_size - 1);
-	g = mlx5_create_flow_group(fdb, flow_group_in);
-	if (IS_ERR(g)) {
-		err = PTR_ERR(g);
-		esw_warn(dev, "Failed to create promisc flow group err(%d)\n", err);
+
+	/* The groups are independent, create them in one batch */
+	err = mlx5_create_flow_groups(fdb, fg_in, ESW_LEGACY_NUM_GRPS, fgs);
+	if (err) {
+		esw_warn(dev, "Failed to create FDB flow groups err(%d)\n", err);
 		goto out;
 	}
-	esw->fdb_table.legacy.promisc_grp = g;
+	esw->fdb_table.legacy.addr_grp = fgs[ESW_LEGACY_ADDR_GRP];
+	esw->fdb_table.legacy.allmulti_grp = fgs[ESW_LEGACY_ALLMULTI_GRP];
+	esw->fdb_table.legacy.promisc_grp = fgs[ESW_LEGACY_PROMISC_GRP];
 
 out:
 	if (err)
 		esw_destroy_legacy_fdb_table(esw);
 
-	kvfree(flow_group_in);
+	kvfree(fg_in[0]);
 	return err;
 }
 
@@ -1107,13 +1110,19 @@ static void esw_vport_change_handler(struct work_struct *work)
 	mutex_unlock(&esw->state_lock);
 }
 
+enum {
+	ESW_EGRESS_UNTAGGED_GRP,
+	ESW_EGRESS_VLAN_GRP,
+	ESW_EGRESS_DROP_GRP,
+	ESW_EGRESS_NUM_GRPS,
+};
+
 int esw_vport_enable_egress_acl(struct mlx5_eswitch *esw,
 				struct mlx5_vport *vport)
 {
 	int inlen = MLX5_ST_SZ_BYTES(create_flow_group_in);
-	struct mlx5_flow_group *untagged_grp = NULL;
-	struct mlx5_flow_group *vlan_grp = NULL;
-	struct mlx5_flow_group *drop_grp = NULL;
+	struct mlx5_flow_group *fgs[ESW_EGRESS_NUM_GRPS];
+	u32 *fg_in[ESW_EGRESS_NUM_GRPS], *flow_group_in;
 	struct mlx5_core_dev *dev = esw->dev;
 	struct mlx5_flow_namespace *root_ns;
 	struct mlx5_flow_table *acl;
@@ -1124,8 +1133,8 @@ int esw_vport_enable_egress_acl(struct mlx5_eswitch *esw,
 	 */
 	int table_size = VLAN_N_VID + 2;
 	void *match_criteria;
-	u32 *flow_group_in;
 	int err = 0;
+	int i;
 
 	if (!MLX5_CAP_ESW_EGRESS_ACL(dev, ft_support))
 		return -EOPNOTSUPP;
@@ -1143,9 +1152,11 @@ int esw_vport_enable_egress_acl(struct mlx5_eswitch *esw,
 		return -EOPNOTSUPP;
 	}
 
-	flow_group_in = kvzalloc(inlen, GFP_KERNEL);
+	flow_group_in = kvcalloc(ESW_EGRESS_NUM_GRPS, inlen, GFP_KERNEL);
 	if (!flow_group_in)
 		return -ENOMEM;
+	for (i = 0; i < ESW_EGRESS_NUM_GRPS; i++)
+		fg_in[i] = flow_group_in + i * MLX5_ST_SZ_DW(create_flow_group_in);
 
 	acl = mlx5_create_vport_flow_table(root_ns, 0, table_size, 0, vport->vport);
 	if (IS_ERR(acl)) {
@@ -1155,27 +1166,19 @@ int esw_vport_enable_egress_acl(struct mlx5_eswitch *esw,
 		goto out;
 	}
 
+	/* Flow group for allowed untagged flow rule */
+	flow_group_in = fg_in[ESW_EGRESS_UNTAGGED_GRP];
 	MLX5_SET(create_flow_group_in, flow_group_in, match_criteria_enable, MLX5_MATCH_OUTER_HEADERS);
 	match_criteria = MLX5_ADDR_OF(create_flow_group_in, flow_group_in, match_criteria);
-
-	/* Create flow group for allowed untagged flow rule */
 	MLX5_SET_TO_ONES(fte_match_param, match_criteria, outer_headers.cvlan_tag);
 	MLX5_SET_TO_ONES(fte_match_param, match_criteria, outer_headers.svlan_tag);
 	MLX5_SET(create_flow_group_in, flow_group_in, start_flow_index, 0);
 	MLX5_SET(create_flow_group_in, flow_group_in, end_flow_index, 0);
 
-	untagged_grp = mlx5_create_flow_group(acl, flow_group_in);
-	if (IS_ERR(untagged_grp)) {
-		err = PTR_ERR(untagged_grp);
-		esw_warn(dev, "Failed to create E-Switch vport[%d] egress untagged flow group, err(%d)\n",
-			 vport->vport, err);
-		goto out;
-	}
-
-	memset(flow_group_in, 0, inlen);
+	/* Flow group for allowed tagged flow rules */
+	flow_group_in = fg_in[ESW_EGRESS_VLAN_GRP];
 	MLX5_SET(create_flow_group_in, flow_group_in, match_criteria_enable, MLX5_MATCH_OUTER_HEADERS);
-
-	/* Create flow group for allowed tagged flow rules */
+	match_criteria = MLX5_ADDR_OF(create_flow_group_in, flow_group_in, match_criteria);
 	MLX5_SET_TO_ONES(fte_match_param, match_criteria, outer_headers.cvlan_tag);
 
 	if (esw->mode != MLX5_ESWITCH_OFFLOADS)
@@ -1186,42 +1189,26 @@ int esw_vport_enable_egress_acl(struct mlx5_eswitch *esw,
 	MLX5_SET(create_flow_group_in, flow_group_in, start_flow_index, 1);
 	MLX5_SET(create_flow_group_in, flow_group_in, end_flow_index, VLAN_N_VID);
 
-	vlan_grp = mlx5_create_flow_group(acl, flow_group_in);
-	if (IS_ERR(vlan_grp)) {
-		err = PTR_ERR(vlan_grp);
-		esw_warn(dev, "Failed to create E-Switch vport[%d] egress allowed vlans flow group, err(%d)\n",
-			 vport->vport, err);
-		goto out;
-	}
-
-	/* Create flow group for drop rule */
-	memset(flow_group_in, 0, inlen);
+	/* Flow group for drop rule */
+	flow_group_in = fg_in[ESW_EGRESS_DROP_GRP];
 	MLX5_SET(create_flow_group_in, flow_group_in, start_flow_index, VLAN_N_VID + 1);
 	MLX5_SET(create_flow_group_in, flow_group_in, end_flow_index, VLAN_N_VID + 1);
-	drop_grp = mlx5_create_flow_group(acl, flow_group_in);
-	if (IS_ERR(drop_grp)) {
-		err = PTR_ERR(drop_grp);
-		esw_warn(dev, "Failed to create E-Switch vport[%d] egress drop flow group, err(%d)\n",
+
+	err = mlx5_create_flow_groups(acl, fg_in, ESW_EGRESS_NUM_GRPS, fgs);
+	if (err) {
+		esw_warn(dev, "Failed to create E-Switch vport[%d] egress flow groups, err(%d)\n",
 			 vport->vport, err);
+		mlx5_destroy_flow_table(acl);
 		goto out;
 	}
 
 	vport->egress.acl = acl;
-	vport->egress.drop_grp = drop_grp;
-	vport->egress.allowed_vlans_grp = vlan_grp;
-	vport->egress.allow_untagged_grp = untagged_grp;
+	vport->egress.drop_grp = fgs[ESW_EGRESS_DROP_GRP];
+	vport->egress.allowed_vlans_grp = fgs[ESW_EGRESS_VLAN_GRP];
+	vport->egress.allow_untagged_grp = fgs[ESW_EGRESS_UNTAGGED_GRP];
 
 out:
-	if (err) {
-		if (!IS_ERR_OR_NULL(vlan_grp))
-			mlx5_destroy_flow_group(vlan_grp);
-		if (!IS_ERR_OR_NULL(untagged_grp))
-			mlx5_destroy_flow_group(untagged_grp);
-		if (!IS_ERR_OR_NULL(acl))
-			mlx5_destroy_flow_table(acl);
-	}
-
-	kvfree(flow_group_in);
+	kvfree(fg_in[0]);
 	return err;
 }
 
@@ -1513,13 +1500,74 @@ void esw_vport_disable_ingress_acl(struct mlx5_eswitch *esw,
 	vport->ingress.allow_untagged_spoofchk_grp = NULL;
 }
 
+/* Specs per mlx5_add_flow_rules_bulk() call for the VGT+ allow rules */
+#define ESW_ACL_VLAN_BULK	256
+
+/* Add one allow rule per vlan set in the vport's VGT+ bitmap to @acl.
+ * @spec holds everything but first_vid. The rules go in bulks, so their
+ * FTEs are written with batched firmware commands. Rules are linked on
+ * @rules as they're added, the caller cleans them up on failure.
+ */
+static int esw_acl_add_trunk_vlan_rules(struct mlx5_vport *vport,
+					struct mlx5_flow_table *acl,
+					struct mlx5_flow_spec *spec,
+					struct mlx5_flow_act *flow_act,
+					struct list_head *rules)
+{
+	struct mlx5_acl_vlan *trunk_vlan_rule;
+	struct mlx5_flow_handle **handles;
+	struct mlx5_flow_spec *specs;
+	u16 vlan_id = 0;
+	int err = 0;
+	int i, n;
+
+	specs = kvcalloc(ESW_ACL_VLAN_BULK, sizeof(*specs), GFP_KERNEL);
+	handles = kvcalloc(ESW_ACL_VLAN_BULK, sizeof(*handles), GFP_KERNEL);
+	if (!specs || !handles) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	while (!err) {
+		for (n = 0; n < ESW_ACL_VLAN_BULK; n++, vlan_id++) {
+			vlan_id = find_next_bit(vport->acl_vlan_8021q_bitmap,
+						VLAN_N_VID, vlan_id);
+			if (vlan_id >= VLAN_N_VID)
+				break;
+			specs[n] = *spec;
+			MLX5_SET(fte_match_param, specs[n].match_value,
+				 outer_headers.first_vid, vlan_id);
+		}
+		if (!n)
+			break;
+
+		err = mlx5_add_flow_rules_bulk(acl, specs, n, flow_act, NULL, 0,
+					       handles);
+		for (i = 0; !err && i < n; i++) {
+			trunk_vlan_rule = kzalloc(sizeof(*trunk_vlan_rule),
+						  GFP_KERNEL);
+			if (!trunk_vlan_rule) {
+				err = -ENOMEM;
+				while (i < n)
+					mlx5_del_flow_rules(handles[i++]);
+				break;
+			}
+			trunk_vlan_rule->acl_vlan_rule = handles[i];
+			list_add(&trunk_vlan_rule->list, rules);
+		}
+	}
+out:
+	kvfree(handles);
+	kvfree(specs);
+	return err;
+}
+
 static int esw_vport_ingress_config(struct mlx5_eswitch *esw,
 				    struct mlx5_vport *vport)
 {
 	bool need_vlan_filter = !!bitmap_weight(vport->info.vlan_trunk_8021q_bitmap,
 						VLAN_N_VID);
 	enum esw_vst_mode vst_mode = esw_get_vst_mode(esw);
-	struct mlx5_acl_vlan *trunk_vlan_rule;
 	struct mlx5_fc *counter = vport->ingress.drop_counter;
 	struct mlx5_flow_destination drop_ctr_dst = {0};
 	struct mlx5_flow_destination *dst = NULL;
@@ -1527,7 +1575,6 @@ static int esw_vport_ingress_config(struct mlx5_eswitch *esw,
 	struct mlx5_flow_spec *spec;
 	bool need_acl_table = true;
 	bool push_on_any_pkt;
-	u16 vlan_id = 0;
 	int dest_num = 0;
 	int err = 0;
 	u8 *smac_v;
@@ -1620,26 +1667,14 @@ static int esw_vport_ingress_config(struct mlx5_eswitch *esw,
 	MLX5_SET_TO_ONES(fte_match_param, spec->match_criteria, outer_headers.first_vid);
 
 	/* VGT+ rules */
-	for_each_set_bit(vlan_id, vport->acl_vlan_8021q_bitmap, VLAN_N_VID) {
-		trunk_vlan_rule = kzalloc(sizeof(*trunk_vlan_rule), GFP_KERNEL);
-		if (!trunk_vlan_rule) {
-			err = -ENOMEM;
-			goto out;
-		}
-
-		MLX5_SET(fte_match_param, spec->match_value, outer_headers.first_vid,
-			 vlan_id);
-		trunk_vlan_rule->acl_vlan_rule =
-			mlx5_add_flow_rules(vport->ingress.acl, spec, &flow_act, NULL, 0);
-		if (IS_ERR(trunk_vlan_rule->acl_vlan_rule)) {
-			err = PTR_ERR(trunk_vlan_rule->acl_vlan_rule);
-			esw_warn(esw->dev,
-				 "vport[%d] configure ingress allowed vlan rule failed, err(%d)\n",
-				 vport->vport, err);
-			trunk_vlan_rule->acl_vlan_rule = NULL;
-			goto out;
-		}
-		list_add(&trunk_vlan_rule->list, &vport->ingress.allow_vlans_rules);
+	err = esw_acl_add_trunk_vlan_rules(vport, vport->ingress.acl, spec,
+					   &flow_act,
+					   &vport->ingress.allow_vlans_rules);
+	if (err) {
+		esw_warn(esw->dev,
+			 "vport[%d] configure ingress allowed vlan rule failed, err(%d)\n",
+			 vport->vport, err);
+		goto out;
 	}
 
 drop_rule:
@@ -1682,14 +1717,12 @@ static int esw_vport_egress_config(struct mlx5_eswitch *esw,
 	bool need_acl_table = vport->info.vlan || vport->info.qos ||
 			      need_vlan_filter;
 	enum esw_vst_mode vst_mode = esw_get_vst_mode(esw);
-	struct mlx5_acl_vlan *trunk_vlan_rule;
 	struct mlx5_fc *counter = vport->egress.drop_counter;
 	struct mlx5_flow_destination drop_ctr_dst = {0};
 	struct mlx5_flow_destination *dst = NULL;
 	struct mlx5_flow_act flow_act = {0};
 	struct mlx5_flow_spec *spec;
 	int dest_num = 0;
-	u16 vlan_id = 0;
 	int err = 0;
 
 	esw_vport_cleanup_egress_rules(esw, vport);
@@ -1763,26 +1796,14 @@ static int esw_vport_egress_config(struct mlx5_eswitch *esw,
 	}
 
 	/* VGT+ rules */
-	for_each_set_bit(vlan_id, vport->acl_vlan_8021q_bitmap, VLAN_N_VID) {
-		trunk_vlan_rule = kzalloc(sizeof(*trunk_vlan_rule), GFP_KERNEL);
-		if (!trunk_vlan_rule) {
-			err = -ENOMEM;
-			goto out;
-		}
-
-		MLX5_SET(fte_match_param, spec->match_value, outer_headers.first_vid,
-			 vlan_id);
-		trunk_vlan_rule->acl_vlan_rule =
-			mlx5_add_flow_rules(vport->egress.acl, spec, &flow_act, NULL, 0);
-		if (IS_ERR(trunk_vlan_rule->acl_vlan_rule)) {
-			err = PTR_ERR(trunk_vlan_rule->acl_vlan_rule);
-			esw_warn(esw->dev,
-				 "vport[%d] configure egress allowed vlan rule failed, err(%d)\n",
-				 vport->vport, err);
-			trunk_vlan_rule->acl_vlan_rule = NULL;
-			goto out;
-		}
-		list_add(&trunk_vlan_rule->list, &vport->egress.allow_vlans_rules);
+	err = esw_acl_add_trunk_vlan_rules(vport, vport->egress.acl, spec,
+					   &flow_act,
+					   &vport->egress.allow_vlans_rules);
+	if (err) {
+		esw_warn(esw->dev,
+			 "vport[%d] configure egress allowed vlan rule failed, err(%d)\n",
+			 vport->vport, err);
+		goto out;
 	}
 
 	/* Drop others rule (star rule) */
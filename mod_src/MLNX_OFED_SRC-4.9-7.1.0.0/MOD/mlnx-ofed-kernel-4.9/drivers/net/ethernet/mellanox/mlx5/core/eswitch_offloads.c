@@ -701,90 +701,77 @@ static int esw_add_fdb_peer_miss_rules(struct mlx5_eswitch *esw,
 {
 	struct mlx5_flow_destination dest = {};
 	struct mlx5_flow_act flow_act = {0};
+	struct mlx5_flow_handle **handles;
 	struct mlx5_flow_handle **flows;
-	struct mlx5_flow_handle *flow;
+	struct mlx5_flow_spec *specs;
 	struct mlx5_flow_spec *spec;
 	/* total vports is the same for both e-switches */
 	int nvports = esw->total_vports;
+	int err, i, n = 0;
+	int *slots;
 	void *misc;
-	int err, i;
 
 	spec = kvzalloc(sizeof(*spec), GFP_KERNEL);
-	if (!spec)
-		return -ENOMEM;
-
-	peer_miss_rules_setup(esw, peer_dev, spec, &dest);
-
 	flows = kvzalloc(nvports * sizeof(*flows), GFP_KERNEL);
-	if (!flows) {
+	specs = kvcalloc(nvports, sizeof(*specs), GFP_KERNEL);
+	handles = kvcalloc(nvports, sizeof(*handles), GFP_KERNEL);
+	slots = kvcalloc(nvports, sizeof(*slots), GFP_KERNEL);
+	if (!spec || !flows || !specs || !handles || !slots) {
 		err = -ENOMEM;
-		goto alloc_flows_err;
+		goto err_out;
 	}
 
+	peer_miss_rules_setup(esw, peer_dev, spec, &dest);
+
 	flow_act.action = MLX5_FLOW_CONTEXT_ACTION_FWD_DEST;
-	misc = MLX5_ADDR_OF(fte_match_param, spec->match_value,
-			    misc_parameters);
 
-	mutex_lock(&esw->fdb_table.offloads.fdb_lock);
+	/* One rule per vport, each starting from the previous rule's spec,
+	 * all added with a single batch of FTE commands.
+	 */
 	if (mlx5_core_is_ecpf_esw_manager(esw->dev)) {
+		specs[n] = *spec;
 		esw_set_peer_miss_rule_source_port(esw, peer_dev->priv.eswitch,
-						   spec, MLX5_VPORT_PF);
-
-		flow = mlx5_add_flow_rules(esw->fdb_table.offloads.slow_fdb,
-					   spec, &flow_act, &dest, 1);
-		if (IS_ERR(flow)) {
-			err = PTR_ERR(flow);
-			goto add_pf_flow_err;
-		}
-		flows[MLX5_VPORT_PF] = flow;
+						   &specs[n], MLX5_VPORT_PF);
+		slots[n++] = MLX5_VPORT_PF;
 	}
 
 	if (mlx5_ecpf_vport_exists(esw->dev)) {
+		specs[n] = n ? specs[n - 1] : *spec;
+		misc = MLX5_ADDR_OF(fte_match_param, specs[n].match_value,
+				    misc_parameters);
 		MLX5_SET(fte_match_set_misc, misc, source_port, MLX5_VPORT_ECPF);
-		flow = mlx5_add_flow_rules(esw->fdb_table.offloads.slow_fdb,
-					   spec, &flow_act, &dest, 1);
-		if (IS_ERR(flow)) {
-			err = PTR_ERR(flow);
-			goto add_ecpf_flow_err;
-		}
-		flows[mlx5_eswitch_ecpf_idx(esw)] = flow;
+		slots[n++] = mlx5_eswitch_ecpf_idx(esw);
 	}
 
 	mlx5_esw_for_each_vf_vport_num(esw, i, mlx5_core_max_vfs(esw->dev)) {
+		specs[n] = n ? specs[n - 1] : *spec;
 		esw_set_peer_miss_rule_source_port(esw,
 						   peer_dev->priv.eswitch,
-						   spec, i);
+						   &specs[n], i);
+		slots[n++] = i;
+	}
 
-		flow = mlx5_add_flow_rules(esw->fdb_table.offloads.slow_fdb,
-					   spec, &flow_act, &dest, 1);
-		if (IS_ERR(flow)) {
-			err = PTR_ERR(flow);
-			goto add_vf_flow_err;
-		}
-		flows[i] = flow;
+	mutex_lock(&esw->fdb_table.offloads.fdb_lock);
+	err = mlx5_add_flow_rules_bulk(esw->fdb_table.offloads.slow_fdb,
+				       specs, n, &flow_act, &dest, 1, handles);
+	if (err) {
+		mutex_unlock(&esw->fdb_table.offloads.fdb_lock);
+		goto err_out;
 	}
 
+	for (i = 0; i < n; i++)
+		flows[slots[i]] = handles[i];
 	esw->fdb_table.offloads.peer_miss_rules = flows;
 	mutex_unlock(&esw->fdb_table.offloads.fdb_lock);
+	goto out;
 
-	kvfree(spec);
-	return 0;
-
-add_vf_flow_err:
-	nvports = --i;
-	mlx5_esw_for_each_vf_vport_num_reverse(esw, i, nvports)
-		mlx5_del_flow_rules(flows[i]);
-
-	if (mlx5_ecpf_vport_exists(esw->dev))
-		mlx5_del_flow_rules(flows[mlx5_eswitch_ecpf_idx(esw)]);
-add_ecpf_flow_err:
-	if (mlx5_core_is_ecpf_esw_manager(esw->dev))
-		mlx5_del_flow_rules(flows[MLX5_VPORT_PF]);
-add_pf_flow_err:
-	mutex_unlock(&esw->fdb_table.offloads.fdb_lock);
+err_out:
 	esw_warn(esw->dev, "FDB: Failed to add peer miss flow rule err %d\n", err);
 	kvfree(flows);
-alloc_flows_err:
+out:
+	kvfree(slots);
+	kvfree(handles);
+	kvfree(specs);
 	kvfree(spec);
 	return err;
 }
@@ -848,7 +835,7 @@ static int esw_add_fdb_miss_rule(struct mlx5_eswitch *esw)
 {
 	struct mlx5_flow_act flow_act = {0};
 	struct mlx5_flow_destination dest = {};
-	struct mlx5_flow_handle *flow_rule = NULL;
+	struct mlx5_flow_handle *flow_rules[2];
 	struct mlx5_flow_spec *spec;
 	void *headers_c;
 	void *headers_v;
@@ -856,7 +843,8 @@ static int esw_add_fdb_miss_rule(struct mlx5_eswitch *esw)
 	u8 *dmac_c;
 	u8 *dmac_v;
 
-	spec = kvzalloc(sizeof(*spec), GFP_KERNEL);
+	/* spec[0] is the unicast miss rule, spec[1] the multicast one */
+	spec = kvcalloc(2, sizeof(*spec), GFP_KERNEL);
 	if (!spec) {
 		err = -ENOMEM;
 		goto out;
@@ -869,35 +857,26 @@ static int esw_add_fdb_miss_rule(struct mlx5_eswitch *esw)
 			      outer_headers.dmac_47_16);
 	dmac_c[0] = 0x01;
 
-	dest.type = MLX5_FLOW_DESTINATION_TYPE_VPORT;
-	dest.vport.num = esw->manager_vport;
-	flow_act.action = MLX5_FLOW_CONTEXT_ACTION_FWD_DEST;
-
-	flow_rule = mlx5_add_flow_rules(esw->fdb_table.offloads.slow_fdb, spec,
-					&flow_act, &dest, 1);
-	if (IS_ERR(flow_rule)) {
-		err = PTR_ERR(flow_rule);
-		esw_warn(esw->dev,  "FDB: Failed to add unicast miss flow rule err %d\n", err);
-		goto out;
-	}
-
-	esw->fdb_table.offloads.miss_rule_uni = flow_rule;
-
-	headers_v = MLX5_ADDR_OF(fte_match_param, spec->match_value,
+	spec[1] = spec[0];
+	headers_v = MLX5_ADDR_OF(fte_match_param, spec[1].match_value,
 				 outer_headers);
 	dmac_v = MLX5_ADDR_OF(fte_match_param, headers_v,
 			      outer_headers.dmac_47_16);
 	dmac_v[0] = 0x01;
-	flow_rule = mlx5_add_flow_rules(esw->fdb_table.offloads.slow_fdb, spec,
-					&flow_act, &dest, 1);
-	if (IS_ERR(flow_rule)) {
-		err = PTR_ERR(flow_rule);
-		esw_warn(esw->dev, "FDB: Failed to add multicast miss flow rule err %d\n", err);
-		mlx5_del_flow_rules(esw->fdb_table.offloads.miss_rule_uni);
+
+	dest.type = MLX5_FLOW_DESTINATION_TYPE_VPORT;
+	dest.vport.num = esw->manager_vport;
+	flow_act.action = MLX5_FLOW_CONTEXT_ACTION_FWD_DEST;
+
+	err = mlx5_add_flow_rules_bulk(esw->fdb_table.offloads.slow_fdb, spec,
+				       2, &flow_act, &dest, 1, flow_rules);
+	if (err) {
+		esw_warn(esw->dev, "FDB: Failed to add miss flow rules err %d\n", err);
 		goto out;
 	}
 
-	esw->fdb_table.offloads.miss_rule_multi = flow_rule;
+	esw->fdb_table.offloads.miss_rule_uni = flow_rules[0];
+	esw->fdb_table.offloads.miss_rule_multi = flow_rules[1];
 
 out:
 	kvfree(spec);
@@ -1130,24 +1109,34 @@ static void esw_set_flow_group_source_port_vhca_id(struct mlx5_eswitch *esw,
 	}
 }
 
+enum {
+	ESW_FDB_SEND_TO_VPORT_GRP,
+	ESW_FDB_PEER_MISS_GRP,
+	ESW_FDB_MISS_GRP,
+	ESW_FDB_NUM_GRPS,
+};
+
 static int esw_create_offloads_fdb_tables(struct mlx5_eswitch *esw, int nvports)
 {
 	int inlen = MLX5_ST_SZ_BYTES(create_flow_group_in);
+	struct mlx5_flow_group *fgs[ESW_FDB_NUM_GRPS];
 	struct mlx5_flow_table_attr ft_attr = {};
+	u32 *fg_in[ESW_FDB_NUM_GRPS], *flow_group_in;
 	struct mlx5_core_dev *dev = esw->dev;
-	u32 *flow_group_in, max_flow_counter;
 	struct mlx5_flow_namespace *root_ns;
 	struct mlx5_flow_table *fdb = NULL;
 	int table_size, ix, err = 0, i;
-	struct mlx5_flow_group *g;
 	u32 flags = 0, fdb_max;
+	u32 max_flow_counter;
 	void *match_criteria;
 	u8 *dmac;
 
 	esw_debug(esw->dev, "Create offloads FDB Tables\n");
-	flow_group_in = kvzalloc(inlen, GFP_KERNEL);
+	flow_group_in = kvcalloc(ESW_FDB_NUM_GRPS, inlen, GFP_KERNEL);
 	if (!flow_group_in)
 		return -ENOMEM;
+	for (i = 0; i < ESW_FDB_NUM_GRPS; i++)
+		fg_in[i] = flow_group_in + i * MLX5_ST_SZ_DW(create_flow_group_in);
 
 	root_ns = mlx5_get_flow_namespace(dev, MLX5_FLOW_NAMESPACE_FDB);
 	if (!root_ns) {
@@ -1211,8 +1200,8 @@ static int esw_create_offloads_fdb_tables(struct mlx5_eswitch *esw, int nvports)
 		esw->fdb_table.flags |= ESW_FDB_CHAINS_AND_PRIOS_SUPPORTED;
 	}
 
-	/* create send-to-vport group */
-	memset(flow_group_in, 0, inlen);
+	/* send-to-vport group */
+	flow_group_in = fg_in[ESW_FDB_SEND_TO_VPORT_GRP];
 	MLX5_SET(create_flow_group_in, flow_group_in, match_criteria_enable,
 		 MLX5_MATCH_MISC_PARAMETERS);
 
@@ -1226,17 +1215,8 @@ static int esw_create_offloads_fdb_tables(struct mlx5_eswitch *esw, int nvports)
 	MLX5_SET(create_flow_group_in, flow_group_in, start_flow_index, 0);
 	MLX5_SET(create_flow_group_in, flow_group_in, end_flow_index, ix - 1);
 
-	g = mlx5_create_flow_group(fdb, flow_group_in);
-	if (IS_ERR(g)) {
-		err = PTR_ERR(g);
-		esw_warn(dev, "Failed to create send-to-vport flow group err(%d)\n", err);
-		goto send_vport_err;
-	}
-	esw->fdb_table.offloads.send_to_vport_grp = g;
-
-	/* create peer esw miss group */
-	memset(flow_group_in, 0, inlen);
-
+	/* peer esw miss group */
+	flow_group_in = fg_in[ESW_FDB_PEER_MISS_GRP];
 	esw_set_flow_group_source_port_vhca_id(esw, flow_group_in);
 
 	MLX5_SET(create_flow_group_in, flow_group_in, start_flow_index, ix);
@@ -1244,16 +1224,8 @@ static int esw_create_offloads_fdb_tables(struct mlx5_eswitch *esw, int nvports)
 		 ix + esw->total_vports - 1);
 	ix += esw->total_vports;
 
-	g = mlx5_create_flow_group(fdb, flow_group_in);
-	if (IS_ERR(g)) {
-		err = PTR_ERR(g);
-		esw_warn(dev, "Failed to create peer miss flow group err(%d)\n", err);
-		goto peer_miss_err;
-	}
-	esw->fdb_table.offloads.peer_miss_grp = g;
-
-	/* create miss group */
-	memset(flow_group_in, 0, inlen);
+	/* miss group */
+	flow_group_in = fg_in[ESW_FDB_MISS_GRP];
 	MLX5_SET(create_flow_group_in, flow_group_in, match_criteria_enable,
 		 MLX5_MATCH_OUTER_HEADERS);
 	match_criteria = MLX5_ADDR_OF(create_flow_group_in, flow_group_in,
@@ -1266,36 +1238,36 @@ static int esw_create_offloads_fdb_tables(struct mlx5_eswitch *esw, int nvports)
 	MLX5_SET(create_flow_group_in, flow_group_in, end_flow_index,
 		 ix + MLX5_ESW_MISS_FLOWS);
 
-	g = mlx5_create_flow_group(fdb, flow_group_in);
-	if (IS_ERR(g)) {
-		err = PTR_ERR(g);
-		esw_warn(dev, "Failed to create miss flow group err(%d)\n", err);
-		goto miss_err;
+	/* The groups are independent, create them in one batch */
+	err = mlx5_create_flow_groups(fdb, fg_in, ESW_FDB_NUM_GRPS, fgs);
+	if (err) {
+		esw_warn(dev, "Failed to create FDB flow groups err(%d)\n", err);
+		goto groups_err;
 	}
-	esw->fdb_table.offloads.miss_grp = g;
+	esw->fdb_table.offloads.send_to_vport_grp = fgs[ESW_FDB_SEND_TO_VPORT_GRP];
+	esw->fdb_table.offloads.peer_miss_grp = fgs[ESW_FDB_PEER_MISS_GRP];
+	esw->fdb_table.offloads.miss_grp = fgs[ESW_FDB_MISS_GRP];
 
 	err = esw_add_fdb_miss_rule(esw);
 	if (err)
 		goto miss_rule_err;
 
 	esw->nvports = nvports;
-	kvfree(flow_group_in);
+	kvfree(fg_in[0]);
 	return 0;
 
 miss_rule_err:
 	mlx5_destroy_flow_group(esw->fdb_table.offloads.miss_grp);
-miss_err:
 	mlx5_destroy_flow_group(esw->fdb_table.offloads.peer_miss_grp);
-peer_miss_err:
 	mlx5_destroy_flow_group(esw->fdb_table.offloads.send_to_vport_grp);
-send_vport_err:
+groups_err:
 	esw_destroy_offloads_fast_fdb_tables(esw);
 	mlx5_destroy_flow_table(esw->fdb_table.offloads.slow_fdb);
 slow_fdb_err:
 	/* Holds true only as long as DMFS is the default */
 	mlx5_flow_namespace_set_mode(root_ns, MLX5_FLOW_STEERING_MODE_DMFS);
 ns_err:
-	kvfree(flow_group_in);
+	kvfree(fg_in[0]);
 	return err;
 }
 
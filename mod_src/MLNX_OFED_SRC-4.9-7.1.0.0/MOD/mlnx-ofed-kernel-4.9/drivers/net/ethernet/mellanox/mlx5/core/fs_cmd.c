@@ -377,16 +377,10 @@ static int mlx5_cmd_modify_flow_table(struct mlx5_flow_root_namespace *ns,
 	return mlx5_cmd_exec(dev, in, sizeof(in), out, sizeof(out));
 }
 
-static int mlx5_cmd_create_flow_group(struct mlx5_flow_root_namespace *ns,
-				      struct mlx5_flow_table *ft,
-				      u32 *in,
-				      struct mlx5_flow_group *fg)
+static void mlx5_cmd_set_flow_group_hdr(struct mlx5_core_dev *dev,
+					struct mlx5_flow_table *ft,
+					u32 *in)
 {
-	u32 out[MLX5_ST_SZ_DW(create_flow_group_out)] = {0};
-	int inlen = MLX5_ST_SZ_BYTES(create_flow_group_in);
-	struct mlx5_core_dev *dev = ns->dev;
-	int err;
-
 	MLX5_SET(create_flow_group_in, in, opcode,
 		 MLX5_CMD_OP_CREATE_FLOW_GROUP);
 	MLX5_SET(create_flow_group_in, in, table_type, ft->type);
@@ -397,7 +391,19 @@ static int mlx5_cmd_create_flow_group(struct mlx5_flow_root_namespace *ns,
 		MLX5_SET(create_flow_group_in, in, vport_number, ft->vport);
 		MLX5_SET(create_flow_group_in, in, other_vport, 1);
 	}
+}
 
+static int mlx5_cmd_create_flow_group(struct mlx5_flow_root_namespace *ns,
+				      struct mlx5_flow_table *ft,
+				      u32 *in,
+				      struct mlx5_flow_group *fg)
+{
+	u32 out[MLX5_ST_SZ_DW(create_flow_group_out)] = {0};
+	int inlen = MLX5_ST_SZ_BYTES(create_flow_group_in);
+	struct mlx5_core_dev *dev = ns->dev;
+	int err;
+
+	mlx5_cmd_set_flow_group_hdr(dev, ft, in);
 	err = mlx5_cmd_exec(dev, in, inlen, out, sizeof(out));
 	if (!err)
 		fg->id = MLX5_GET(create_flow_group_out, out,
@@ -405,6 +411,51 @@ static int mlx5_cmd_create_flow_group(struct mlx5_flow_root_namespace *ns,
 	return err;
 }
 
+struct fg_create_cmd_out {
+	u32 out[MLX5_ST_SZ_DW(create_flow_group_out)];
+};
+
+static int mlx5_cmd_create_flow_groups(struct mlx5_flow_root_namespace *ns,
+				       struct mlx5_flow_table *ft,
+				       u32 **in,
+				       struct mlx5_flow_group **fgs,
+				       int *errs, int num)
+{
+	struct mlx5_core_dev *dev = ns->dev;
+	struct mlx5_cmd_batch_ent *ents;
+	struct fg_create_cmd_out *outs;
+	int err;
+	int i;
+
+	ents = kvcalloc(num, sizeof(*ents), GFP_KERNEL);
+	outs = kvcalloc(num, sizeof(*outs), GFP_KERNEL);
+	if (!ents || !outs) {
+		err = -ENOMEM;
+		for (i = 0; i < num; i++)
+			errs[i] = err;
+		goto out;
+	}
+
+	for (i = 0; i < num; i++) {
+		mlx5_cmd_set_flow_group_hdr(dev, ft, in[i]);
+		ents[i].in = in[i];
+		ents[i].in_size = MLX5_ST_SZ_BYTES(create_flow_group_in);
+		ents[i].out = outs[i].out;
+		ents[i].out_size = sizeof(outs[i].out);
+	}
+	err = mlx5_cmd_exec_batch(dev, ents, num);
+	for (i = 0; i < num; i++) {
+		errs[i] = ents[i].err;
+		if (!errs[i])
+			fgs[i]->id = MLX5_GET(create_flow_group_out,
+					      outs[i].out, group_id);
+	}
+out:
+	kvfree(outs);
+	kvfree(ents);
+	return err;
+}
+
 static int mlx5_cmd_destroy_flow_group(struct mlx5_flow_root_namespace *ns,
 				       struct mlx5_flow_table *ft,
 				       struct mlx5_flow_group *fg)
@@ -464,35 +515,34 @@ static int mlx5_set_extended_dest(struct mlx5_core_dev *dev,
 
 	return 0;
 }
-static int mlx5_cmd_set_fte(struct mlx5_core_dev *dev,
-			    int opmod, int modify_mask,
-			    struct mlx5_flow_table *ft,
-			    unsigned group_id,
-			    struct fs_fte *fte)
+/* Build the SET_FLOW_TABLE_ENTRY mailbox for @fte, the caller kvfree()s it */
+static u32 *mlx5_cmd_build_set_fte(struct mlx5_core_dev *dev,
+				   int opmod, int modify_mask,
+				   struct mlx5_flow_table *ft,
+				   unsigned group_id,
+				   struct fs_fte *fte,
+				   unsigned int *inlen)
 {
-	u32 out[MLX5_ST_SZ_DW(set_fte_out)] = {0};
 	bool extended_dest = false;
 	struct mlx5_flow_rule *dst;
 	void *in_flow_context, *vlan;
 	void *in_match_value;
-	unsigned int inlen;
 	int dst_cnt_size;
 	void *in_dests;
 	u32 *in;
-	int err;
 
 	if (mlx5_set_extended_dest(dev, fte, &extended_dest))
-		return -EOPNOTSUPP;
+		return ERR_PTR(-EOPNOTSUPP);
 
 	if (!extended_dest)
 		dst_cnt_size = MLX5_ST_SZ_BYTES(dest_format_struct);
 	else
 		dst_cnt_size = MLX5_ST_SZ_BYTES(extended_dest_format);
 
-	inlen = MLX5_ST_SZ_BYTES(set_fte_in) + fte->dests_size * dst_cnt_size;
-	in = kvzalloc(inlen, GFP_KERNEL);
+	*inlen = MLX5_ST_SZ_BYTES(set_fte_in) + fte->dests_size * dst_cnt_size;
+	in = kvzalloc(*inlen, GFP_KERNEL);
 	if (!in)
-		return -ENOMEM;
+		return ERR_PTR(-ENOMEM);
 
 	MLX5_SET(set_fte_in, in, opcode, MLX5_CMD_OP_SET_FLOW_TABLE_ENTRY);
 	MLX5_SET(set_fte_in, in, op_mod, opmod);
@@ -626,17 +676,34 @@ static int mlx5_cmd_set_fte(struct mlx5_core_dev *dev,
 			list_size++;
 		}
 		if (list_size > max_list_size) {
-			err = -EINVAL;
-			goto err_out;
+			kvfree(in);
+			return ERR_PTR(-EINVAL);
 		}
 
 		MLX5_SET(flow_context, in_flow_context, flow_counter_list_size,
 			 list_size);
 	}
 
+	return in;
+}
+
+static int mlx5_cmd_set_fte(struct mlx5_core_dev *dev,
+			    int opmod, int modify_mask,
+			    struct mlx5_flow_table *ft,
+			    unsigned group_id,
+			    struct fs_fte *fte)
+{
+	u32 out[MLX5_ST_SZ_DW(set_fte_out)] = {0};
+	unsigned int inlen;
+	u32 *in;
+	int err;
+
+	in = mlx5_cmd_build_set_fte(dev, opmod, modify_mask, ft, group_id,
+				    fte, &inlen);
+	if (IS_ERR(in))
+		return PTR_ERR(in);
 
 	err = mlx5_cmd_exec(dev, in, inlen, out, sizeof(out));
-err_out:
 	kvfree(in);
 	return err;
 }
@@ -652,6 +719,69 @@ static int mlx5_cmd_create_fte(struct mlx5_flow_root_namespace *ns,
 	return mlx5_cmd_set_fte(dev, 0, 0, ft, group_id, fte);
 }
 
+struct fte_set_cmd_out {
+	u32 out[MLX5_ST_SZ_DW(set_fte_out)];
+};
+
+static int mlx5_cmd_create_ftes(struct mlx5_flow_root_namespace *ns,
+				struct mlx5_flow_table *ft,
+				struct mlx5_flow_group *group,
+				struct fs_fte **ftes,
+				int *errs, int num)
+{
+	struct mlx5_core_dev *dev = ns->dev;
+	struct mlx5_cmd_batch_ent *ents;
+	struct fte_set_cmd_out *outs;
+	unsigned int inlen;
+	int nents = 0;
+	int err = 0;
+	int *idx;
+	u32 *in;
+	int i;
+
+	ents = kvcalloc(num, sizeof(*ents), GFP_KERNEL);
+	outs = kvcalloc(num, sizeof(*outs), GFP_KERNEL);
+	idx = kvcalloc(num, sizeof(*idx), GFP_KERNEL);
+	if (!ents || !outs || !idx) {
+		err = -ENOMEM;
+		for (i = 0; i < num; i++)
+			errs[i] = err;
+		goto out;
+	}
+
+	/* FTEs whose mailbox can't be built fail alone, the rest go out */
+	for (i = 0; i < num; i++) {
+		in = mlx5_cmd_build_set_fte(dev, 0, 0, ft, group->id, ftes[i],
+					    &inlen);
+		errs[i] = PTR_ERR_OR_ZERO(in);
+		if (errs[i]) {
+			if (!err)
+				err = errs[i];
+			continue;
+		}
+		ents[nents].in = in;
+		ents[nents].in_size = inlen;
+		ents[nents].out = outs[nents].out;
+		ents[nents].out_size = sizeof(outs[nents].out);
+		idx[nents++] = i;
+	}
+	if (nents) {
+		int batch_err = mlx5_cmd_exec_batch(dev, ents, nents);
+
+		if (!err)
+			err = batch_err;
+	}
+	for (i = 0; i < nents; i++) {
+		errs[idx[i]] = ents[i].err;
+		kvfree(ents[i].in);
+	}
+out:
+	kvfree(idx);
+	kvfree(outs);
+	kvfree(ents);
+	return err;
+}
+
 static int mlx5_cmd_update_fte(struct mlx5_flow_root_namespace *ns,
 			       struct mlx5_flow_table *ft,
 			       struct mlx5_flow_group *fg,
@@ -726,6 +856,42 @@ int mlx5_cmd_fc_free(struct mlx5_core_dev *dev, u32 id)
 	return mlx5_cmd_exec(dev, in, sizeof(in), out, sizeof(out));
 }
 
+struct fc_free_cmd {
+	u32 in[MLX5_ST_SZ_DW(dealloc_flow_counter_in)];
+	u32 out[MLX5_ST_SZ_DW(dealloc_flow_counter_out)];
+};
+
+int mlx5_cmd_fc_free_batch(struct mlx5_core_dev *dev, const u32 *ids, int num)
+{
+	struct mlx5_cmd_batch_ent *ents;
+	struct fc_free_cmd *cmds;
+	int err;
+	int i;
+
+	ents = kvcalloc(num, sizeof(*ents), GFP_KERNEL);
+	cmds = kvcalloc(num, sizeof(*cmds), GFP_KERNEL);
+	if (!ents || !cmds) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < num; i++) {
+		MLX5_SET(dealloc_flow_counter_in, cmds[i].in, opcode,
+			 MLX5_CMD_OP_DEALLOC_FLOW_COUNTER);
+		MLX5_SET(dealloc_flow_counter_in, cmds[i].in, flow_counter_id,
+			 ids[i]);
+		ents[i].in = cmds[i].in;
+		ents[i].in_size = sizeof(cmds[i].in);
+		ents[i].out = cmds[i].out;
+		ents[i].out_size = sizeof(cmds[i].out);
+	}
+	err = mlx5_cmd_exec_batch(dev, ents, num);
+out:
+	kvfree(cmds);
+	kvfree(ents);
+	return err;
+}
+
 int mlx5_cmd_fc_query(struct mlx5_core_dev *dev, u32 id,
 		      u64 *packets, u64 *bytes)
 {
@@ -938,8 +1104,10 @@ static const struct mlx5_flow_cmds mlx5_flow_cmds = {
 	.destroy_flow_table = mlx5_cmd_destroy_flow_table,
 	.modify_flow_table = mlx5_cmd_modify_flow_table,
 	.create_flow_group = mlx5_cmd_create_flow_group,
+	.create_flow_groups = mlx5_cmd_create_flow_groups,
 	.destroy_flow_group = mlx5_cmd_destroy_flow_group,
 	.create_fte = mlx5_cmd_create_fte,
+	.create_ftes = mlx5_cmd_create_ftes,
 	.update_fte = mlx5_cmd_update_fte,
 	.delete_fte = mlx5_cmd_delete_fte,
 	.update_root_ft = mlx5_cmd_update_root_ft,
@@ -980,7 +1148,7 @@ const struct mlx5_flow_cmds *mlx5_fs_cmd_get_fw_cmds(void)
 	return &mlx5_flow_cmds;
 }
 
-static const struct mlx5_flow_cmds *mlx5_fs_cmd_get_stub_cmds(void)
+const struct mlx5_flow_cmds *mlx5_fs_cmd_get_stub_cmds(void)
 {
 	return &mlx5_flow_cmd_stubs;
 }
@@ -52,6 +52,16 @@ struct mlx5_flow_cmds {
 				 u32 *in,
 				 struct mlx5_flow_group *fg);
 
+	/* Optional, create @num groups of @ft in one go and return the
+	 * status of each in @errs. fs_core falls back to create_flow_group
+	 * when it is not set.
+	 */
+	int (*create_flow_groups)(struct mlx5_flow_root_namespace *ns,
+				  struct mlx5_flow_table *ft,
+				  u32 **in,
+				  struct mlx5_flow_group **fgs,
+				  int *errs, int num);
+
 	int (*destroy_flow_group)(struct mlx5_flow_root_namespace *ns,
 				  struct mlx5_flow_table *ft,
 				  struct mlx5_flow_group *fg);
@@ -61,6 +71,13 @@ struct mlx5_flow_cmds {
 			  struct mlx5_flow_group *fg,
 			  struct fs_fte *fte);
 
+	/* Optional, like create_flow_groups for new FTEs of one group */
+	int (*create_ftes)(struct mlx5_flow_root_namespace *ns,
+			   struct mlx5_flow_table *ft,
+			   struct mlx5_flow_group *fg,
+			   struct fs_fte **ftes,
+			   int *errs, int num);
+
 	int (*update_fte)(struct mlx5_flow_root_namespace *ns,
 			  struct mlx5_flow_table *ft,
 			  struct mlx5_flow_group *fg,
@@ -109,6 +126,7 @@ int mlx5_cmd_fc_bulk_alloc(struct mlx5_core_dev *dev,
 			   enum mlx5_fc_bulk_alloc_bitmask alloc_bitmask,
 			   u32 *id);
 int mlx5_cmd_fc_free(struct mlx5_core_dev *dev, u32 id);
+int mlx5_cmd_fc_free_batch(struct mlx5_core_dev *dev, const u32 *ids, int num);
 int mlx5_cmd_fc_query(struct mlx5_core_dev *dev, u32 id,
 		      u64 *packets, u64 *bytes);
 
@@ -118,5 +136,6 @@ int mlx5_cmd_fc_bulk_query(struct mlx5_core_dev *dev, u32 base_id, int bulk_len,
 
 const struct mlx5_flow_cmds *mlx5_fs_cmd_get_default(enum fs_flow_table_type type);
 const struct mlx5_flow_cmds *mlx5_fs_cmd_get_fw_cmds(void);
+const struct mlx5_flow_cmds *mlx5_fs_cmd_get_stub_cmds(void);
 
 #endif
@@ -31,6 +31,8 @@
  */
 
 #include <linux/mutex.h>
+#include <linux/kthread.h>
+#include <linux/debugfs.h>
 #include <linux/mlx5/driver.h>
 #include <linux/mlx5/vport.h>
 #include <linux/mlx5/eswitch.h>
@@ -619,6 +621,13 @@ static void del_hw_fte(struct fs_node *node)
 	}
 }
 
+static void free_fte_rcu(struct rcu_head *head)
+{
+	struct fs_fte *fte = container_of(head, struct fs_fte, rcu);
+
+	kmem_cache_free(fte->cache, fte);
+}
+
 static void del_sw_fte(struct fs_node *node)
 {
 	struct mlx5_flow_steering *steering = get_steering(node);
@@ -634,7 +643,9 @@ static void del_sw_fte(struct fs_node *node)
 				     rhash_fte);
 	WARN_ON(err);
 	ida_simple_remove(&fg->fte_allocator, fte->index - fg->start_index);
-	kmem_cache_free(steering->ftes_cache, fte);
+	/* lookup_fte_locked() may still be looking at it without the fg lock */
+	fte->cache = steering->ftes_cache;
+	call_rcu(&fte->rcu, free_fte_rcu);
 }
 
 static void del_hw_flow_group(struct fs_node *node)
@@ -657,6 +668,14 @@ static void del_hw_flow_group(struct fs_node *node)
 			       fg->id, ft->id);
 }
 
+static void free_fg_rcu(struct rcu_head *head)
+{
+	struct mlx5_flow_group *fg = container_of(head, struct mlx5_flow_group,
+						  rcu);
+
+	kmem_cache_free(fg->cache, fg);
+}
+
 static void del_sw_flow_group(struct fs_node *node)
 {
 	struct mlx5_flow_steering *steering = get_steering(node);
@@ -682,7 +701,9 @@ static void del_sw_flow_group(struct fs_node *node)
 			      &fg->hash,
 			      rhash_fg);
 	WARN_ON(err);
-	kmem_cache_free(steering->fgs_cache, fg);
+	/* build_match_list() may still be walking it without the ft lock */
+	fg->cache = steering->fgs_cache;
+	call_rcu(&fg->rcu, free_fg_rcu);
 }
 
 static int insert_fte(struct mlx5_flow_group *fg, struct fs_fte *fte)
@@ -705,6 +726,8 @@ static int insert_fte(struct mlx5_flow_group *fg, struct fs_fte *fte)
 	snprintf(fte_name, sizeof(fte_name), "fte_%u", fte->index);
 	tree_add_node(&fte->node, &fg->node, fte_name);
 	list_add_tail(&fte->node.list, &fg->node.children);
+	/* Lockless lookups that missed this fte detect it by the version */
+	atomic_inc(&fg->node.version);
 	return 0;
 
 err_ida_remove:
@@ -805,6 +828,8 @@ static struct mlx5_flow_group *alloc_insert_flow_group(struct mlx5_flow_table *f
 	tree_add_node(&fg->node, &ft->node, name);
 	/* Add node to group list */
 	list_add(&fg->node.list, prev);
+	/* A reader that sees the new version must find the fg in fgs_hash */
+	smp_wmb();
 	atomic_inc(&ft->node.version);
 
 	return fg;
@@ -1246,10 +1271,10 @@ mlx5_create_auto_grouped_flow_table(struct mlx5_flow_namespace *ns,
 }
 EXPORT_SYMBOL(mlx5_create_auto_grouped_flow_table);
 
-struct mlx5_flow_group *mlx5_create_flow_group(struct mlx5_flow_table *ft,
-					       u32 *fg_in)
+/* ft should be write locked */
+static struct mlx5_flow_group *alloc_insert_flow_group_in(struct mlx5_flow_table *ft,
+							  u32 *fg_in)
 {
-	struct mlx5_flow_root_namespace *root = find_root(&ft->node);
 	void *match_criteria = MLX5_ADDR_OF(create_flow_group_in,
 					    fg_in, match_criteria);
 	u8 match_criteria_enable = MLX5_GET(create_flow_group_in,
@@ -1259,6 +1284,16 @@ struct mlx5_flow_group *mlx5_create_flow_group(struct mlx5_flow_table *ft,
 				   start_flow_index);
 	int end_index = MLX5_GET(create_flow_group_in, fg_in,
 				 end_flow_index);
+
+	return alloc_insert_flow_group(ft, match_criteria_enable,
+				       match_criteria, start_index, end_index,
+				       ft->node.children.prev);
+}
+
+struct mlx5_flow_group *mlx5_create_flow_group(struct mlx5_flow_table *ft,
+					       u32 *fg_in)
+{
+	struct mlx5_flow_root_namespace *root = find_root(&ft->node);
 	struct mlx5_flow_group *fg;
 	int err;
 
@@ -1266,9 +1301,7 @@ struct mlx5_flow_group *mlx5_create_flow_group(struct mlx5_flow_table *ft,
 		return ERR_PTR(-EPERM);
 
 	down_write_ref_node(&ft->node, false);
-	fg = alloc_insert_flow_group(ft, match_criteria_enable, match_criteria,
-				     start_index, end_index,
-				     ft->node.children.prev);
+	fg = alloc_insert_flow_group_in(ft, fg_in);
 	up_write_ref_node(&ft->node, false);
 	if (IS_ERR(fg))
 		return fg;
@@ -1286,6 +1319,69 @@ struct mlx5_flow_group *mlx5_create_flow_group(struct mlx5_flow_table *ft,
 	return fg;
 }
 
+/* Create @num flow groups of @ft, the firmware commands of all of them are
+ * issued in one batch. Either all the groups are created and returned in
+ * @fgs or none is.
+ */
+int mlx5_create_flow_groups(struct mlx5_flow_table *ft, u32 **fg_in,
+			    int num, struct mlx5_flow_group **fgs)
+{
+	struct mlx5_flow_root_namespace *root = find_root(&ft->node);
+	int *errs;
+	int err = 0;
+	int i;
+
+	if (ft->autogroup.active)
+		return -EPERM;
+
+	errs = kvcalloc(num, sizeof(*errs), GFP_KERNEL);
+	if (!errs)
+		return -ENOMEM;
+
+	down_write_ref_node(&ft->node, false);
+	for (i = 0; i < num; i++) {
+		fgs[i] = alloc_insert_flow_group_in(ft, fg_in[i]);
+		if (IS_ERR(fgs[i])) {
+			err = PTR_ERR(fgs[i]);
+			break;
+		}
+	}
+	up_write_ref_node(&ft->node, false);
+	if (err) {
+		while (--i >= 0)
+			tree_put_node(&fgs[i]->node, false);
+		goto out;
+	}
+
+	if (root->cmds->create_flow_groups)
+		root->cmds->create_flow_groups(root, ft, fg_in, fgs, errs, num);
+	else
+		for (i = 0; i < num; i++)
+			errs[i] = root->cmds->create_flow_group(root, ft,
+								fg_in[i],
+								fgs[i]);
+
+	for (i = 0; i < num; i++) {
+		if (errs[i]) {
+			if (!err)
+				err = errs[i];
+			continue;
+		}
+#ifndef MLX_DISABLE_TRACEPOINTS
+		trace_mlx5_fs_add_fg(fgs[i]);
+#endif
+		fgs[i]->node.active = true;
+	}
+
+	/* Inactive groups aren't destroyed in firmware */
+	if (err)
+		for (i = num; i--;)
+			tree_put_node(&fgs[i]->node, false);
+out:
+	kvfree(errs);
+	return err;
+}
+
 static struct mlx5_flow_rule *alloc_rule(struct mlx5_flow_destination *dest)
 {
 	struct mlx5_flow_rule *rule;
@@ -1692,6 +1788,30 @@ static char *get_dest_name(struct mlx5_flow_destination *dest,
 	return NULL;
 }
 
+/* Link the new rules of @handle under @fte once it is set in firmware */
+static void add_handle_rules(struct fs_fte *fte,
+			     struct mlx5_flow_handle *handle)
+{
+	char name[DST_NAME_SIZE];
+	char *dest_name;
+	int i;
+
+#ifndef MLX_DISABLE_TRACEPOINTS
+	trace_mlx5_fs_set_fte(fte, false);
+#endif
+	for (i = 0; i < handle->num_rules; i++) {
+		if (refcount_read(&handle->rule[i]->node.refcount) == 1) {
+			dest_name = get_dest_name(&handle->rule[i]->dest_attr,
+						  name);
+			tree_add_node(&handle->rule[i]->node, &fte->node, dest_name);
+#ifndef MLX_DISABLE_TRACEPOINTS
+			trace_mlx5_fs_add_rule(handle->rule[i]);
+#endif
+			notify_add_rule(handle->rule[i]);
+		}
+	}
+}
+
 static struct mlx5_flow_handle *add_rule_fg(struct mlx5_flow_group *fg,
 					    struct mlx5_flow_spec *spec,
 					    struct mlx5_flow_act *flow_act,
@@ -1700,10 +1820,7 @@ static struct mlx5_flow_handle *add_rule_fg(struct mlx5_flow_group *fg,
 					    struct fs_fte *fte)
 {
 	struct mlx5_flow_handle *handle;
-	char name[DST_NAME_SIZE];
-	char *dest_name;
 	int old_action;
-	int i;
 	int ret;
 
 	ret = check_conflicting_ftes(fte, &spec->flow_context, flow_act);
@@ -1718,20 +1835,7 @@ static struct mlx5_flow_handle *add_rule_fg(struct mlx5_flow_group *fg,
 		fte->action.action = old_action;
 		return handle;
 	}
-#ifndef MLX_DISABLE_TRACEPOINTS
-	trace_mlx5_fs_set_fte(fte, false);
-#endif
-	for (i = 0; i < handle->num_rules; i++) {
-		if (refcount_read(&handle->rule[i]->node.refcount) == 1) {
-			dest_name = get_dest_name(&handle->rule[i]->dest_attr,
-						  name);
-			tree_add_node(&handle->rule[i]->node, &fte->node, dest_name);
-#ifndef MLX_DISABLE_TRACEPOINTS
-			trace_mlx5_fs_add_rule(handle->rule[i]);
-#endif
-			notify_add_rule(handle->rule[i]);
-		}
-	}
+	add_handle_rules(fte, handle);
 	return handle;
 }
 
@@ -1855,28 +1959,29 @@ lookup_fte_locked(struct mlx5_flow_group *g,
 {
 	struct fs_fte *fte_tmp;
 
+	/* The optimistic pass doesn't lock the fg at all: ftes are freed
+	 * only after a grace period, so under RCU it's enough to take a
+	 * reference. Concurrent inserts are caught by the fg version.
+	 */
 	if (take_write)
 		nested_down_write_ref_node(&g->node, FS_LOCK_PARENT);
-	else
-		nested_down_read_ref_node(&g->node, FS_LOCK_PARENT);
+	rcu_read_lock();
 	fte_tmp = rhashtable_lookup_fast(&g->ftes_hash, match_value,
 					 rhash_fte);
-	if (!fte_tmp || !tree_get_node(&fte_tmp->node)) {
+	if (fte_tmp && !tree_get_node(&fte_tmp->node))
 		fte_tmp = NULL;
-		goto out;
-	}
+	rcu_read_unlock();
+	if (take_write)
+		up_write_ref_node(&g->node, false);
+	if (!fte_tmp)
+		return NULL;
+
+	nested_down_write_ref_node(&fte_tmp->node, FS_LOCK_CHILD);
 	if (!fte_tmp->node.active) {
+		up_write_ref_node(&fte_tmp->node, false);
 		tree_put_node(&fte_tmp->node, false);
-		fte_tmp = NULL;
-		goto out;
+		return NULL;
 	}
-
-	nested_down_write_ref_node(&fte_tmp->node, FS_LOCK_CHILD);
-out:
-	if (take_write)
-		up_write_ref_node(&g->node, false);
-	else
-		up_read_ref_node(&g->node);
 	return fte_tmp;
 }
 
@@ -1984,6 +2089,18 @@ skip_search:
 
 		nested_down_write_ref_node(&g->node, FS_LOCK_PARENT);
 
+		/* The fg lock only serializes inserts. Revalidate what the
+		 * lockless search saw, an fte with the same value may have
+		 * been added since.
+		 */
+		if (!take_write &&
+		    rhashtable_lookup_fast(&g->ftes_hash, spec->match_value,
+					   rhash_fte)) {
+			up_write_ref_node(&g->node, false);
+			take_write = true;
+			goto search_again_locked;
+		}
+
 		err = insert_fte(g, fte);
 		if (err) {
 			up_write_ref_node(&g->node, false);
@@ -2036,15 +2153,17 @@ _mlx5_add_flow_rules(struct mlx5_flow_table *ft,
 		if (!dest_is_valid(&dest[i], flow_act->action, ft))
 			return ERR_PTR(-EINVAL);
 	}
-	nested_down_read_ref_node(&ft->node, FS_LOCK_GRANDPARENT);
+	/* The first pass runs without the ft lock, fgs are looked up
+	 * under RCU and the ft version tells if one was added meanwhile.
+	 */
 search_again_locked:
 	version = atomic_read(&ft->node.version);
+	/* Pairs with the barrier in alloc_insert_flow_group() */
+	smp_rmb();
 
 	/* Collect all fgs which has a matching match_criteria */
 	err = build_match_list(&match_head, ft, spec, take_write);
-	if (!take_write) {
-		up_read_ref_node(&ft->node);
-	} else {
+	if (take_write) {
 		up_write_ref_node(&ft->node, false);
 		take_write = false;
 	}
@@ -2177,6 +2296,211 @@ mlx5_add_flow_rules(struct mlx5_flow_table *ft,
 }
 EXPORT_SYMBOL(mlx5_add_flow_rules);
 
+/* Return the flow group of @ft for @spec's mask if there is exactly one,
+ * so the FTEs of its match values can only live there. ft should be write
+ * locked.
+ */
+static struct mlx5_flow_group *lookup_single_fg_locked(struct mlx5_flow_table *ft,
+						       struct mlx5_flow_spec *spec)
+{
+#if !defined(HAVE_RHLTABLE) && defined(HAVE_NETNS_FRAGS_RHASHTABLE)
+	struct bp_rhlist_head *tmp, *list;
+#else
+	struct rhlist_head *tmp, *list;
+#endif
+	struct mlx5_flow_group *g, *fg = NULL;
+	int matches = 0;
+
+	rcu_read_lock();
+#if !defined(HAVE_RHLTABLE) && defined(HAVE_NETNS_FRAGS_RHASHTABLE)
+	list = bp_rhltable_lookup(&ft->fgs_hash, spec, rhash_fg);
+	bp_rhl_for_each_entry_rcu(g, tmp, list, hash) {
+#else
+	list = rhltable_lookup(&ft->fgs_hash, spec, rhash_fg);
+	rhl_for_each_entry_rcu(g, tmp, list, hash) {
+#endif
+		fg = g;
+		matches++;
+	}
+	if (matches != 1 || !fg->node.active || !tree_get_node(&fg->node))
+		fg = NULL;
+	rcu_read_unlock();
+
+	return fg;
+}
+
+static bool spec_same_mask(const struct mlx5_flow_spec *a,
+			   const struct mlx5_flow_spec *b)
+{
+	return a->match_criteria_enable == b->match_criteria_enable &&
+	       !memcmp(a->match_criteria, b->match_criteria,
+		       sizeof(a->match_criteria));
+}
+
+/* Add @num rules to @ft, rule i matching @specs[i] with the shared
+ * @flow_act and @dest. Runs of rules with the same mask that land in new
+ * FTEs of a single non auto group have their FTEs written with one batch of
+ * firmware commands; rules that join an existing FTE, find no room or have
+ * no such group are added one at a time through mlx5_add_flow_rules().
+ * Either all the rules are added and returned in @handles or none is.
+ */
+int mlx5_add_flow_rules_bulk(struct mlx5_flow_table *ft,
+			     struct mlx5_flow_spec *specs, int num,
+			     struct mlx5_flow_act *flow_act,
+			     struct mlx5_flow_destination *dest,
+			     int num_dest,
+			     struct mlx5_flow_handle **handles)
+{
+	struct mlx5_flow_steering *steering = get_steering(&ft->node);
+	struct mlx5_flow_root_namespace *root = find_root(&ft->node);
+	struct mlx5_flow_handle *handle;
+	struct mlx5_flow_namespace *ns;
+	struct mlx5_flow_group *fg;
+	struct fs_fte **ftes = NULL;
+	struct fs_fte *fte;
+	int *errs = NULL;
+	int i, j, k, n;
+	int err = 0;
+
+	memset(handles, 0, num * sizeof(*handles));
+
+	/* Forward to next prio rules are chained under the chain lock */
+	if (!root->cmds->create_ftes || ft->autogroup.active ||
+	    flow_act->action == MLX5_FLOW_CONTEXT_ACTION_FWD_NEXT_PRIO)
+		goto add_one_by_one;
+
+	for (i = 0; i < num; i++) {
+		if (!check_valid_spec(&specs[i]))
+			return -EINVAL;
+	}
+	for (i = 0; i < num_dest; i++) {
+		if (!dest_is_valid(&dest[i], flow_act->action, ft))
+			return -EINVAL;
+	}
+
+	ftes = kvcalloc(num, sizeof(*ftes), GFP_KERNEL);
+	errs = kvcalloc(num, sizeof(*errs), GFP_KERNEL);
+	if (!ftes || !errs) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	ns = get_ns(&ft->node);
+	if (ns)
+		down_read(&ns->ns_rw_sem);
+	nested_down_write_ref_node(&ft->node, FS_LOCK_GRANDPARENT);
+	for (i = 0; !err && i < num; i = j) {
+		for (j = i + 1; j < num && spec_same_mask(&specs[i], &specs[j]);
+		     j++)
+			;
+
+		fg = lookup_single_fg_locked(ft, &specs[i]);
+		if (!fg)
+			continue;
+
+		nested_down_write_ref_node(&fg->node, FS_LOCK_PARENT);
+		for (k = i, n = 0; k < j; k++) {
+			bool new_rule = false;
+			int modify_mask = 0;
+
+			if (rhashtable_lookup_fast(&fg->ftes_hash,
+						   specs[k].match_value,
+						   rhash_fte))
+				continue;
+
+			fte = alloc_fte(ft, &specs[k], flow_act);
+			if (IS_ERR(fte)) {
+				err = PTR_ERR(fte);
+				break;
+			}
+			fte->handle = specs[k].handle;
+
+			err = insert_fte(fg, fte);
+			if (err) {
+				kmem_cache_free(steering->ftes_cache, fte);
+				if (err != -ENOSPC)
+					break;
+				err = 0;
+				continue;
+			}
+
+			handle = create_flow_handle(fte, dest, num_dest,
+						    &modify_mask, &new_rule);
+			if (IS_ERR(handle)) {
+				err = PTR_ERR(handle);
+				tree_put_node(&fte->node, true);
+				break;
+			}
+			handles[k] = handle;
+			ftes[n++] = fte;
+		}
+
+		if (err)
+			for (k = 0; k < n; k++)
+				errs[k] = err;
+		else if (n)
+			root->cmds->create_ftes(root, ft, fg, ftes, errs, n);
+
+		for (k = i, n = 0; k < j; k++) {
+			if (!handles[k])
+				continue;
+
+			fte = ftes[n];
+			if (errs[n++]) {
+				if (!err)
+					err = errs[n - 1];
+				destroy_flow_handle(fte, handles[k], dest,
+						    handles[k]->num_rules);
+				handles[k] = NULL;
+				tree_put_node(&fte->node, true);
+				continue;
+			}
+
+			/* Lookups that raced with us find it from now on */
+			nested_down_write_ref_node(&fte->node, FS_LOCK_CHILD);
+			fte->node.active = true;
+			fte->status |= FS_FTE_STATUS_EXISTING;
+			atomic_inc(&fte->node.version);
+			add_handle_rules(fte, handles[k]);
+			up_write_ref_node(&fte->node, false);
+		}
+		up_write_ref_node(&fg->node, false);
+		tree_put_node(&fg->node, true);
+	}
+	up_write_ref_node(&ft->node, false);
+	if (ns)
+		up_read(&ns->ns_rw_sem);
+
+add_one_by_one:
+	for (i = 0; !err && i < num; i++) {
+		/* mlx5_add_flow_rules() may rewrite the action */
+		struct mlx5_flow_act act = *flow_act;
+
+		if (handles[i])
+			continue;
+
+		handle = mlx5_add_flow_rules(ft, &specs[i], &act, dest,
+					     num_dest);
+		if (IS_ERR(handle))
+			err = PTR_ERR(handle);
+		else
+			handles[i] = handle;
+	}
+
+	if (err) {
+		for (i = num; i--;) {
+			if (handles[i])
+				mlx5_del_flow_rules(handles[i]);
+			handles[i] = NULL;
+		}
+	}
+out:
+	kvfree(errs);
+	kvfree(ftes);
+	return err;
+}
+EXPORT_SYMBOL(mlx5_add_flow_rules_bulk);
+
 static void notify_del_rule(struct mlx5_flow_rule *rule)
 {
 	struct mlx5_flow_namespace *ns;
@@ -2817,6 +3141,8 @@ void mlx5_cleanup_fs(struct mlx5_core_dev *dev)
 	cleanup_root_ns(steering->egress_root_ns);
 	mlx5_cleanup_fc_stats(dev);
 	fs_debugfs_cleanup(dev);
+	/* Wait for the ftes and fgs still in their grace period */
+	rcu_barrier();
 	kmem_cache_destroy(steering->ftes_cache);
 	kmem_cache_destroy(steering->fgs_cache);
 #if (LINUX_VERSION_CODE <= KERNEL_VERSION(3,6,11))
@@ -3072,6 +3398,214 @@ cleanup:
 }
 
 #define CACHE_SIZE_NAME 30
+/* Concurrent rule insertion benchmark, run by writing "<threads> <rules>"
+ * to the insert_bench file of the steering debugfs directory. The rules
+ * are spread over the threads and added to one auto-grouped table of a
+ * private root namespace that runs on the stub commands, so the reported
+ * rate is that of the software steering tree and its locking alone.
+ */
+#define FS_BENCH_MAX_THREADS 64
+#define FS_BENCH_MAX_RULES (1 << 22)
+#define FS_BENCH_NUM_GROUPS 4
+
+struct fs_bench_thread {
+	struct mlx5_flow_table *ft;
+	struct mlx5_flow_handle **rules;
+	struct completion *start;
+	struct completion *done;
+	atomic_t *running;
+	u32 first;
+	u32 num;
+	int err;
+};
+
+static int fs_bench_thread_fn(void *data)
+{
+	struct fs_bench_thread *t = data;
+	MLX5_DECLARE_FLOW_ACT(flow_act);
+	struct mlx5_flow_spec *spec;
+	void *headers_c, *headers_v;
+	u32 i;
+
+	spec = kvzalloc(sizeof(*spec), GFP_KERNEL);
+	if (!spec) {
+		t->err = -ENOMEM;
+		goto out;
+	}
+
+	flow_act.action = MLX5_FLOW_CONTEXT_ACTION_DROP;
+	spec->match_criteria_enable = MLX5_MATCH_OUTER_HEADERS;
+	headers_c = MLX5_ADDR_OF(fte_match_param, spec->match_criteria,
+				 outer_headers);
+	headers_v = MLX5_ADDR_OF(fte_match_param, spec->match_value,
+				 outer_headers);
+	MLX5_SET_TO_ONES(fte_match_set_lyr_2_4, headers_c, dmac_47_16);
+	MLX5_SET_TO_ONES(fte_match_set_lyr_2_4, headers_c, dmac_15_0);
+
+	wait_for_completion(t->start);
+	for (i = 0; i < t->num; i++) {
+		u32 id = t->first + i;
+
+		MLX5_SET(fte_match_set_lyr_2_4, headers_v, dmac_47_16,
+			 0x02000000 | (id >> 16));
+		MLX5_SET(fte_match_set_lyr_2_4, headers_v, dmac_15_0,
+			 id & 0xffff);
+		t->rules[i] = mlx5_add_flow_rules(t->ft, spec, &flow_act,
+						  NULL, 0);
+		if (IS_ERR(t->rules[i])) {
+			t->err = PTR_ERR(t->rules[i]);
+			break;
+		}
+	}
+	t->num = i;
+	kvfree(spec);
+out:
+	if (atomic_dec_and_test(t->running))
+		complete(t->done);
+	return 0;
+}
+
+static int fs_bench_run(struct mlx5_core_dev *dev, u32 num_threads,
+			u32 num_rules)
+{
+	struct mlx5_flow_steering *steering = dev->priv.steering;
+	struct mlx5_flow_root_namespace *root_ns;
+	struct mlx5_flow_handle **rules;
+	struct fs_bench_thread *threads;
+	DECLARE_COMPLETION_ONSTACK(start);
+	DECLARE_COMPLETION_ONSTACK(done);
+	struct mlx5_flow_table *ft;
+	u32 per_thread, added = 0;
+	struct fs_prio *prio;
+	atomic_t running;
+	u64 insert_ns;
+	ktime_t begin;
+	int err = 0;
+	u32 i, j;
+
+	rules = kvcalloc(num_rules, sizeof(*rules), GFP_KERNEL);
+	threads = kcalloc(num_threads, sizeof(*threads), GFP_KERNEL);
+	if (!rules || !threads) {
+		err = -ENOMEM;
+		goto free_bufs;
+	}
+
+	root_ns = create_root_ns(steering, FS_FT_NIC_RX, "insert_bench_root_ns");
+	if (!root_ns) {
+		err = -ENOMEM;
+		goto free_bufs;
+	}
+	root_ns->cmds = mlx5_fs_cmd_get_stub_cmds();
+
+	prio = fs_create_prio(&root_ns->ns, 0, 1, "prio0");
+	if (IS_ERR(prio)) {
+		err = PTR_ERR(prio);
+		goto cleanup_root;
+	}
+	set_prio_attrs(root_ns);
+
+	ft = mlx5_create_auto_grouped_flow_table(&root_ns->ns, 0, 2 * num_rules,
+						 FS_BENCH_NUM_GROUPS, 0, 0);
+	if (IS_ERR(ft)) {
+		err = PTR_ERR(ft);
+		goto cleanup_root;
+	}
+
+	per_thread = DIV_ROUND_UP(num_rules, num_threads);
+	atomic_set(&running, 1);
+	for (i = 0; i < num_threads; i++) {
+		struct fs_bench_thread *t = &threads[i];
+		struct task_struct *task;
+
+		t->ft = ft;
+		t->first = i * per_thread;
+		if (t->first >= num_rules)
+			break;
+		t->num = min(per_thread, num_rules - t->first);
+		t->rules = &rules[t->first];
+		t->start = &start;
+		t->done = &done;
+		t->running = &running;
+
+		atomic_inc(&running);
+		task = kthread_run(fs_bench_thread_fn, t, "mlx5_fs_bench/%u", i);
+		if (IS_ERR(task)) {
+			atomic_dec(&running);
+			t->num = 0;
+			err = PTR_ERR(task);
+			break;
+		}
+	}
+	num_threads = i;
+
+	begin = ktime_get();
+	complete_all(&start);
+	if (!atomic_dec_and_test(&running))
+		wait_for_completion(&done);
+	insert_ns = ktime_to_ns(ktime_sub(ktime_get(), begin)) ?: 1;
+
+	for (i = 0; i < num_threads; i++) {
+		struct fs_bench_thread *t = &threads[i];
+
+		added += t->num;
+		if (t->err && !err)
+			err = t->err;
+		for (j = 0; j < t->num; j++)
+			mlx5_del_flow_rules(t->rules[j]);
+	}
+
+	mlx5_core_info(dev, "fs insert bench: %u threads, %u/%u rules, %llu rules/sec\n",
+		       num_threads, added, num_rules,
+		       div64_u64((u64)added * NSEC_PER_SEC, insert_ns));
+
+	mlx5_destroy_flow_table(ft);
+cleanup_root:
+	cleanup_root_ns(root_ns);
+free_bufs:
+	kfree(threads);
+	kvfree(rules);
+	return err;
+}
+
+static ssize_t fs_bench_write(struct file *filp, const char __user *buf,
+			      size_t count, loff_t *pos)
+{
+	struct mlx5_core_dev *dev = filp->private_data;
+	u32 num_threads, num_rules;
+	char kbuf[32];
+	int err;
+
+	if (count >= sizeof(kbuf))
+		return -EINVAL;
+	if (copy_from_user(kbuf, buf, count))
+		return -EFAULT;
+	kbuf[count] = '\0';
+
+	if (sscanf(kbuf, "%u %u", &num_threads, &num_rules) != 2 ||
+	    !num_threads || num_threads > FS_BENCH_MAX_THREADS ||
+	    !num_rules || num_rules > FS_BENCH_MAX_RULES)
+		return -EINVAL;
+
+	err = fs_bench_run(dev, num_threads, num_rules);
+
+	return err ? err : count;
+}
+
+static const struct file_operations fs_bench_fops = {
+	.owner = THIS_MODULE,
+	.open = simple_open,
+	.write = fs_bench_write,
+};
+
+static void mlx5_fs_bench_init(struct mlx5_core_dev *dev)
+{
+	if (IS_ERR_OR_NULL(dev->priv.steering->debugfs))
+		return;
+
+	debugfs_create_file("insert_bench", 0200, dev->priv.steering->debugfs,
+			    dev, &fs_bench_fops);
+}
+
 int mlx5_init_fs(struct mlx5_core_dev *dev)
 {
 	struct mlx5_flow_steering *steering;
@@ -3116,6 +3650,8 @@ int mlx5_init_fs(struct mlx5_core_dev *dev)
 
 	if (fs_debugfs_init(dev))
 		pr_warn("debugfs is not supported\n");
+	else
+		mlx5_fs_bench_init(dev);
 
 	if ((((MLX5_CAP_GEN(dev, port_type) == MLX5_CAP_PORT_TYPE_ETH) &&
 	      (MLX5_CAP_GEN(dev, nic_flow_table))) ||
@@ -226,6 +226,9 @@ struct fs_fte {
 	struct fs_debugfs_fte		debugfs;
 	int				modify_mask;
 	u32				handle;
+	/* freed after a grace period, lookups don't hold the fg lock */
+	struct kmem_cache		*cache;
+	struct rcu_head			rcu;
 };
 
 /* Type of children is mlx5_flow_table/namespace */
@@ -273,6 +276,9 @@ struct mlx5_flow_group {
 	struct rhlist_head		hash;
 #endif
 	struct fs_debugfs_fg		debugfs;
+	/* freed after a grace period, lookups don't hold the ft lock */
+	struct kmem_cache		*cache;
+	struct rcu_head			rcu;
 };
 
 struct mlx5_flow_root_namespace {
@@ -33,6 +33,7 @@
 #include <linux/mlx5/driver.h>
 #include <linux/mlx5/fs.h>
 #include <linux/rbtree.h>
+#include <linux/list_sort.h>
 #include "mlx5_core.h"
 #include "fs_core.h"
 #include "fs_cmd.h"
@@ -45,6 +46,16 @@
 #define MLX5_FC_POOL_MAX_THRESHOLD BIT(18)
 #define MLX5_FC_POOL_USED_BUFF_RATIO 10
 
+/* Sampling tiers: a counter that changed in its last sample is hot and is
+ * queried every round. After MLX5_FC_WARM_AFTER unchanged samples it is
+ * warm, after MLX5_FC_IDLE_AFTER it is idle, and it is queried every
+ * MLX5_FC_WARM_PERIOD and MLX5_FC_IDLE_PERIOD rounds respectively.
+ */
+#define MLX5_FC_WARM_AFTER 2
+#define MLX5_FC_IDLE_AFTER 8
+#define MLX5_FC_WARM_PERIOD 2
+#define MLX5_FC_IDLE_PERIOD MLX5_FC_STATS_WHEEL_SLOTS
+
 struct mlx5_fc_cache {
 	u64 packets;
 	u64 bytes;
@@ -52,9 +63,15 @@ struct mlx5_fc_cache {
 };
 
 struct mlx5_fc {
+	/* Everything the stats work touches shares the first cache line */
 	struct list_head list;
-	struct llist_node addlist;
-	struct llist_node dellist;
+	u32 id;
+	u8 unchanged;
+	bool aging;
+	bool dummy;
+	bool deleted;
+
+	struct mlx5_fc_cache cache;
 
 	/* last{packets,bytes} members are used when calculating the delta since
 	 * last reading
@@ -62,16 +79,16 @@ struct mlx5_fc {
 	u64 lastpackets;
 	u64 lastbytes;
 
+	struct list_head changed;
+	struct llist_node addlist;
+	struct llist_node dellist;
 	struct mlx5_fc_bulk *bulk;
-	u32 id;
-	bool aging;
-	bool dummy;
 
 	atomic_t nr_dummies;
 	struct mlx5_fc *dummies[MINIFLOW_MAX_FLOWS];
-
-	struct mlx5_fc_cache cache ____cacheline_aligned_in_smp;
-};
+	/* the flow a dummy counter accounts for */
+	void *owner;
+} ____cacheline_aligned_in_smp;
 
 static void mlx5_fc_pool_init(struct mlx5_fc_pool *fc_pool, struct mlx5_core_dev *dev);
 static void mlx5_fc_pool_cleanup(struct mlx5_fc_pool *fc_pool);
@@ -108,96 +125,51 @@ static void mlx5_fc_pool_release_counter(struct mlx5_fc_pool *fc_pool, struct ml
  *   query/create - no conflict (see create)
  *   since every create/destroy spawn the work, only after necessary time has
  *   elapsed, the thread will actually query the hardware.
+ *
+ * - query changed (user context)
+ *   the changed list is protected by changed_lock. mlx5_fc_destroy() marks
+ *   the counter deleted and unlinks it under the lock, so a counter waiting
+ *   on the dellist is neither reported nor put back on the list by the
+ *   query.
  */
 
-#if defined(HAVE_IDR_RT)
-#define USE_IDR 1
-#elif defined(HAVE_IDR_GET_NEXT_EXPORTED) && defined(HAVE_IDR_ALLOC)
-/* for now, we want to use this if it's original kernel function and
- * we don't define idr_* funcs ourselves, so it will be fast. */
-void *idr_get_next_ul(struct idr *idr, unsigned long *nextid)
+static int mlx5_fc_cmp_id(void *priv, struct list_head *a,
+			  struct list_head *b)
 {
-	int next = (int) *nextid;
-	void *ret;
-
-	ret = idr_get_next(idr, &next);
-	*nextid = (unsigned long) next;
-
-	return ret;
-}
-int idr_alloc_u32(struct idr *idr, void *ptr, u32 *nextid,
-		  unsigned long max, gfp_t gfp)
-{
-	int err = idr_alloc(idr, ptr, *nextid, max + 1, gfp);
-
-	if (err < 0)
-		return err;
-
-	*nextid = err;
+	struct mlx5_fc *fca = container_of(a, struct mlx5_fc, list);
+	struct mlx5_fc *fcb = container_of(b, struct mlx5_fc, list);
 
-	return 0;
+	return fca->id < fcb->id ? -1 : fca->id > fcb->id;
 }
-#define USE_IDR 1
-#endif
 
-static struct list_head *mlx5_fc_counters_lookup_next(struct mlx5_core_dev *dev,
-						      u32 id)
+static u32 mlx5_fc_stats_period(struct mlx5_fc *counter)
 {
-	struct mlx5_fc_stats *fc_stats = &dev->priv.fc_stats;
-#ifdef USE_IDR
-	unsigned long next_id = (unsigned long)id + 1;
-#endif
-	struct mlx5_fc *counter;
-
-#ifdef USE_IDR
-	rcu_read_lock();
-	/* skip counters that are in idr, but not yet in counters list */
-	while ((counter = idr_get_next_ul(&fc_stats->counters_idr,
-					  &next_id)) != NULL &&
-	       list_empty(&counter->list))
-		next_id++;
-	rcu_read_unlock();
-#else
-	list_for_each_entry(counter, &fc_stats->counters, list)
-		if (counter->id > id)
-			return &counter->list;
-#endif
-#ifdef USE_IDR
-	return counter ? &counter->list : &fc_stats->counters;
-#else
-	return &fc_stats->counters;
-#endif
+	if (counter->unchanged >= MLX5_FC_IDLE_AFTER)
+		return MLX5_FC_IDLE_PERIOD;
+	if (counter->unchanged >= MLX5_FC_WARM_AFTER)
+		return MLX5_FC_WARM_PERIOD;
+	return 1;
 }
 
-static void mlx5_fc_stats_insert(struct mlx5_core_dev *dev,
-				 struct mlx5_fc *counter)
+/* Put the counter on the wheel slot of the round it is due next */
+static void mlx5_fc_stats_schedule(struct mlx5_fc_stats *fc_stats,
+				   struct mlx5_fc *counter, u32 period)
 {
-	struct list_head *next = mlx5_fc_counters_lookup_next(dev, counter->id);
+	u32 slot = (fc_stats->round + period) % MLX5_FC_STATS_WHEEL_SLOTS;
 
-	list_add_tail(&counter->list, next);
+	list_move_tail(&counter->list, &fc_stats->wheel[slot]);
 }
 
-static void mlx5_fc_stats_remove(struct mlx5_core_dev *dev,
+/* Called with changed_lock held */
+static void mlx5_fc_mark_changed(struct mlx5_fc_stats *fc_stats,
 				 struct mlx5_fc *counter)
 {
-#ifdef USE_IDR
-	struct mlx5_fc_stats *fc_stats = &dev->priv.fc_stats;
-#endif
-
-	list_del(&counter->list);
-
-#ifdef USE_IDR
-	spin_lock(&fc_stats->counters_idr_lock);
-#ifdef HAVE_IDR_REMOVE_RETURN_VALUE 
-	WARN_ON(!idr_remove(&fc_stats->counters_idr, counter->id));
-#else
-	idr_remove(&fc_stats->counters_idr, counter->id);
-#endif
-	spin_unlock(&fc_stats->counters_idr_lock);
-#endif/*USE_IDR*/
+	if (!counter->deleted && list_empty(&counter->changed))
+		list_add_tail(&counter->changed, &fc_stats->changed);
 }
 
-static void fc_dummies_update(struct mlx5_fc *counter,
+static void fc_dummies_update(struct mlx5_fc_stats *fc_stats,
+			      struct mlx5_fc *counter,
 			      u64 dfpackets, u64 dfbytes, u64 jiffies)
 {
 	int nr_dummies = atomic_read(&counter->nr_dummies);
@@ -213,6 +185,8 @@ static void fc_dummies_update(struct mlx5_fc *counter,
 		c->packets += dfpackets;
 		c->bytes += dfbytes;
 		c->lastuse = jiffies;
+
+		mlx5_fc_mark_changed(fc_stats, dummy);
 	}
 }
 
@@ -229,7 +203,8 @@ static int get_max_bulk_query_len(struct mlx5_core_dev *dev)
 }
 
 
-static void update_counter_cache(struct mlx5_fc *counter,
+static bool update_counter_cache(struct mlx5_fc_stats *fc_stats,
+				 struct mlx5_fc *counter,
 				 int index, u32 *bulk_raw_data,
 				 struct mlx5_fc_cache *cache)
 {
@@ -240,7 +215,7 @@ static void update_counter_cache(struct mlx5_fc *counter,
 	u64 dfpackets, dfbytes;
 
 	if (cache->packets == packets)
-		return;
+		return false;
 
 	dfpackets = packets - cache->packets;
 	dfbytes = bytes - cache->bytes;
@@ -249,49 +224,69 @@ static void update_counter_cache(struct mlx5_fc *counter,
 	cache->bytes = bytes;
 	cache->lastuse = jiffies;
 
-	fc_dummies_update(counter, dfpackets, dfbytes, jiffies);
+	fc_dummies_update(fc_stats, counter, dfpackets, dfbytes, jiffies);
+	return true;
 }
 
-static void mlx5_fc_stats_query_counter_range(struct mlx5_core_dev *dev,
-					      struct mlx5_fc *first,
-					      u32 last_id)
+/* Query the counters of one sampling round, @due is sorted by id. Bulk
+ * queries only cover the id ranges of due counters, counters that are
+ * not due this round are not touched at all. Every counter is moved back
+ * onto the wheel according to whether it changed.
+ */
+static void mlx5_fc_stats_query_due(struct mlx5_core_dev *dev,
+				    struct list_head *due)
 {
 	struct mlx5_fc_stats *fc_stats = &dev->priv.fc_stats;
-	bool query_more_counters = (first->id <= last_id);
+	struct mlx5_fc *last = list_last_entry(due, struct mlx5_fc, list);
 	int cur_bulk_len = fc_stats->bulk_query_len;
 	u32 *data = fc_stats->bulk_query_out;
-	struct mlx5_fc *counter = first;
+	struct mlx5_fc *counter, *tmp;
 	u32 bulk_base_id;
+	bool changed;
 	int bulk_len;
 	int err;
 
-	while (query_more_counters) {
+	while (!list_empty(due)) {
+		counter = list_first_entry(due, struct mlx5_fc, list);
+
 		/* first id must be aligned to 4 when using bulk query */
 		bulk_base_id = counter->id & ~0x3;
 
 		/* number of counters to query inc. the last counter */
 		bulk_len = min_t(int, cur_bulk_len,
-				 ALIGN(last_id - bulk_base_id + 1, 4));
+				 ALIGN(last->id - bulk_base_id + 1, 4));
 
 		err = mlx5_cmd_fc_bulk_query(dev, bulk_base_id, bulk_len,
 					     data);
 		if (err) {
 			mlx5_core_err(dev, "Error doing bulk query: %d\n", err);
+			/* Retry the rest next round */
+			list_for_each_entry_safe(counter, tmp, due, list)
+				mlx5_fc_stats_schedule(fc_stats, counter, 1);
 			return;
 		}
-		query_more_counters = false;
 
-		list_for_each_entry_from(counter, &fc_stats->counters, list) {
+		spin_lock(&fc_stats->changed_lock);
+		while (counter->id < bulk_base_id + bulk_len) {
 			int counter_index = counter->id - bulk_base_id;
-			struct mlx5_fc_cache *cache = &counter->cache;
 
-			if (counter->id >= bulk_base_id + bulk_len) {
-				query_more_counters = true;
-				break;
+			changed = update_counter_cache(fc_stats, counter,
+						       counter_index, data,
+						       &counter->cache);
+			if (changed) {
+				counter->unchanged = 0;
+				mlx5_fc_mark_changed(fc_stats, counter);
+			} else if (counter->unchanged < MLX5_FC_IDLE_AFTER) {
+				counter->unchanged++;
 			}
 
-			update_counter_cache(counter, counter_index, data, cache);
+			mlx5_fc_stats_schedule(fc_stats, counter,
+					       mlx5_fc_stats_period(counter));
+			if (list_empty(due))
+				break;
+			counter = list_first_entry(due, struct mlx5_fc, list);
 		}
+		spin_unlock(&fc_stats->changed_lock);
 	}
 }
 
@@ -301,6 +296,31 @@ static void mlx5_fc_free(struct mlx5_core_dev *dev, struct mlx5_fc *counter)
 	kfree(counter);
 }
 
+/* Deallocate a list of single counters with one command batch */
+static void mlx5_fc_free_list(struct mlx5_core_dev *dev,
+			      struct list_head *list, int num)
+{
+	struct mlx5_fc *counter, *tmp;
+	u32 *ids;
+	int i = 0;
+
+	ids = kvcalloc(num, sizeof(*ids), GFP_KERNEL);
+	if (ids) {
+		list_for_each_entry(counter, list, list)
+			ids[i++] = counter->id;
+		mlx5_cmd_fc_free_batch(dev, ids, num);
+	}
+
+	list_for_each_entry_safe(counter, tmp, list, list) {
+		list_del(&counter->list);
+		if (ids)
+			kfree(counter);
+		else
+			mlx5_fc_free(dev, counter);
+	}
+	kvfree(ids);
+}
+
 static void mlx5_fc_release(struct mlx5_core_dev *dev, struct mlx5_fc *counter)
 {
 	struct mlx5_fc_stats *fc_stats = &dev->priv.fc_stats;
@@ -356,15 +376,19 @@ static void mlx5_fc_stats_work(struct work_struct *work)
 	 */
 	struct llist_node *dellist = llist_del_all(&fc_stats->dellist);
 	struct llist_node *addlist = llist_del_all(&fc_stats->addlist);
-	struct mlx5_fc *counter = NULL, *last = NULL, *tmp;
+	struct mlx5_fc *counter = NULL, *tmp;
 	unsigned long now = jiffies;
+	LIST_HEAD(freelist);
+	int num_free = 0;
+	LIST_HEAD(due);
 
-	if (addlist || !list_empty(&fc_stats->counters))
+	if (addlist || fc_stats->num_counters)
 		queue_delayed_work(fc_stats->wq, &fc_stats->work,
 				   fc_stats->sampling_interval);
 
+	/* New counters are sampled in the coming round */
 	llist_for_each_entry(counter, addlist, addlist) {
-		mlx5_fc_stats_insert(dev, counter);
+		mlx5_fc_stats_schedule(fc_stats, counter, 0);
 		fc_stats->num_counters++;
 	}
 
@@ -374,24 +398,33 @@ static void mlx5_fc_stats_work(struct work_struct *work)
 			continue;
 		}
 
-		mlx5_fc_stats_remove(dev, counter);
-		mlx5_fc_release(dev, counter);
+		list_del(&counter->list);
+		if (counter->bulk) {
+			mlx5_fc_pool_release_counter(&fc_stats->fc_pool,
+						     counter);
+		} else {
+			list_add_tail(&counter->list, &freelist);
+			num_free++;
+		}
 		fc_stats->num_counters--;
 	}
+	if (num_free)
+		mlx5_fc_free_list(dev, &freelist, num_free);
 
 	if (fc_stats->bulk_query_len < get_max_bulk_query_len(dev) &&
 	    fc_stats->num_counters > get_init_bulk_query_len(dev))
 		mlx5_fc_stats_bulk_query_size_increase(dev);
 
-	if (time_before(now, fc_stats->next_query) ||
-	    list_empty(&fc_stats->counters))
+	if (time_before(now, fc_stats->next_query))
 		return;
-	last = list_last_entry(&fc_stats->counters, struct mlx5_fc, list);
 
-	counter = list_first_entry(&fc_stats->counters, struct mlx5_fc,
-				   list);
-	if (counter)
-		mlx5_fc_stats_query_counter_range(dev, counter, last->id);
+	list_splice_init(&fc_stats->wheel[fc_stats->round %
+					  MLX5_FC_STATS_WHEEL_SLOTS], &due);
+	if (!list_empty(&due)) {
+		list_sort(NULL, &due, mlx5_fc_cmp_id);
+		mlx5_fc_stats_query_due(dev, &due);
+	}
+	fc_stats->round++;
 
 	fc_stats->next_query = now + fc_stats->sampling_interval;
 }
@@ -432,51 +465,27 @@ struct mlx5_fc *mlx5_fc_create(struct mlx5_core_dev *dev, bool aging)
 {
 	struct mlx5_fc *counter = mlx5_fc_acquire(dev, aging);
 	struct mlx5_fc_stats *fc_stats = &dev->priv.fc_stats;
-#ifdef USE_IDR
-	int err;
-#endif
 
 	if (IS_ERR(counter))
 		return counter;
 
-#ifdef USE_IDR
 	INIT_LIST_HEAD(&counter->list);
-#endif
+	INIT_LIST_HEAD(&counter->changed);
 	counter->aging = aging;
+	counter->deleted = false;
 
 	if (aging) {
-#ifdef USE_IDR
-       	u32 id = counter->id;
-#endif
-
 		counter->cache.lastuse = jiffies;
 		counter->lastbytes = counter->cache.bytes;
 		counter->lastpackets = counter->cache.packets;
+		counter->unchanged = 0;
 
-#ifdef USE_IDR
-		idr_preload(GFP_KERNEL);
-		spin_lock(&fc_stats->counters_idr_lock);
-
-		err = idr_alloc_u32(&fc_stats->counters_idr, counter, &id, id,
-				    GFP_NOWAIT);
-
-		spin_unlock(&fc_stats->counters_idr_lock);
-		idr_preload_end();
-		if (err)
-			goto err_out_alloc;
-#endif
 		llist_add(&counter->addlist, &fc_stats->addlist);
 
 		mod_delayed_work(fc_stats->wq, &fc_stats->work, 0);
 	}
 
 	return counter;
-
-#ifdef USE_IDR
-err_out_alloc:
-	mlx5_fc_release(dev, counter);
-	return ERR_PTR(err);
-#endif
 }
 EXPORT_SYMBOL(mlx5_fc_create);
 
@@ -498,7 +507,7 @@ void mlx5_fc_unlink_dummies(struct mlx5_fc *counter)
 	atomic_set(&counter->nr_dummies, 0);
 }
 
-struct mlx5_fc *mlx5_fc_alloc_dummy_counter(void)
+struct mlx5_fc *mlx5_fc_alloc_dummy_counter(void *owner)
 {
 	struct mlx5_fc *counter;
 
@@ -506,13 +515,20 @@ struct mlx5_fc *mlx5_fc_alloc_dummy_counter(void)
 	if (!counter)
 		return NULL;
 
+	INIT_LIST_HEAD(&counter->changed);
 	counter->dummy = true;
 	counter->cache.lastuse = jiffies;
 	counter->aging = true;
+	counter->owner = owner;
 
 	return counter;
 }
 
+void *mlx5_fc_dummy_owner(struct mlx5_fc *counter)
+{
+	return counter->dummy ? counter->owner : NULL;
+}
+
 void mlx5_fc_free_dummy_counter(struct mlx5_fc *counter)
 {
 	kfree(counter);
@@ -526,6 +542,11 @@ void mlx5_fc_destroy(struct mlx5_core_dev *dev, struct mlx5_fc *counter)
 		return;
 
 	if (counter->aging) {
+		spin_lock(&fc_stats->changed_lock);
+		counter->deleted = true;
+		list_del_init(&counter->changed);
+		spin_unlock(&fc_stats->changed_lock);
+
 		llist_add(&counter->dellist, &fc_stats->dellist);
 		return;
 	}
@@ -539,12 +560,12 @@ int mlx5_init_fc_stats(struct mlx5_core_dev *dev)
 	struct mlx5_fc_stats *fc_stats = &dev->priv.fc_stats;
 	int init_bulk_len;
 	int init_out_len;
+	int i;
 
-#ifdef USE_IDR
-	spin_lock_init(&fc_stats->counters_idr_lock);
-	idr_init(&fc_stats->counters_idr);
-#endif
-	INIT_LIST_HEAD(&fc_stats->counters);
+	for (i = 0; i < MLX5_FC_STATS_WHEEL_SLOTS; i++)
+		INIT_LIST_HEAD(&fc_stats->wheel[i]);
+	spin_lock_init(&fc_stats->changed_lock);
+	INIT_LIST_HEAD(&fc_stats->changed);
 	init_llist_head(&fc_stats->addlist);
 	init_llist_head(&fc_stats->dellist);
 
@@ -569,6 +590,9 @@ err_wq_create:
 	kfree(fc_stats->bulk_query_out);
 	return -ENOMEM;
 }
+#if IS_ENABLED(CONFIG_MLX5_FW_EMU_BENCH)
+EXPORT_SYMBOL(mlx5_init_fc_stats);
+#endif
 
 void mlx5_cleanup_fc_stats(struct mlx5_core_dev *dev)
 {
@@ -576,6 +600,7 @@ void mlx5_cleanup_fc_stats(struct mlx5_core_dev *dev)
 	struct llist_node *tmplist;
 	struct mlx5_fc *counter;
 	struct mlx5_fc *tmp;
+	int i;
 
 	cancel_delayed_work_sync(&dev->priv.fc_stats.work);
 	destroy_workqueue(dev->priv.fc_stats.wq);
@@ -585,15 +610,16 @@ void mlx5_cleanup_fc_stats(struct mlx5_core_dev *dev)
 	llist_for_each_entry_safe(counter, tmp, tmplist, addlist)
 		mlx5_fc_release(dev, counter);
 
-	list_for_each_entry_safe(counter, tmp, &fc_stats->counters, list)
-		mlx5_fc_release(dev, counter);
+	for (i = 0; i < MLX5_FC_STATS_WHEEL_SLOTS; i++)
+		list_for_each_entry_safe(counter, tmp, &fc_stats->wheel[i], list)
+			mlx5_fc_release(dev, counter);
 
 	mlx5_fc_pool_cleanup(&fc_stats->fc_pool);
-#ifdef USE_IDR
-	idr_destroy(&fc_stats->counters_idr);
-#endif
 	kfree(fc_stats->bulk_query_out);
 }
+#if IS_ENABLED(CONFIG_MLX5_FW_EMU_BENCH)
+EXPORT_SYMBOL(mlx5_cleanup_fc_stats);
+#endif
 
 int mlx5_fc_query(struct mlx5_core_dev *dev, struct mlx5_fc *counter,
 		  u64 *packets, u64 *bytes)
@@ -616,6 +642,35 @@ void mlx5_fc_query_cached(struct mlx5_fc *counter,
 	counter->lastbytes = c.bytes;
 	counter->lastpackets = c.packets;
 }
+#if IS_ENABLED(CONFIG_MLX5_FW_EMU_BENCH)
+EXPORT_SYMBOL(mlx5_fc_query_cached);
+#endif
+
+u64 mlx5_fc_query_lastuse(struct mlx5_fc *counter)
+{
+	return counter->cache.lastuse;
+}
+
+/* Report the aging counters whose cache changed since they were last
+ * reported, so a consumer polling many flows only looks at the active
+ * ones. @cb runs under a spinlock and typically calls
+ * mlx5_fc_query_cached() to get the delta.
+ */
+void mlx5_fc_query_changed(struct mlx5_core_dev *dev,
+			   void (*cb)(struct mlx5_fc *counter, void *ctx),
+			   void *ctx)
+{
+	struct mlx5_fc_stats *fc_stats = &dev->priv.fc_stats;
+	struct mlx5_fc *counter, *tmp;
+
+	spin_lock(&fc_stats->changed_lock);
+	list_for_each_entry_safe(counter, tmp, &fc_stats->changed, changed) {
+		list_del_init(&counter->changed);
+		cb(counter, ctx);
+	}
+	spin_unlock(&fc_stats->changed_lock);
+}
+EXPORT_SYMBOL(mlx5_fc_query_changed);
 
 #ifdef HAVE_TCF_TUNNEL_INFO
 void mlx5_fc_queue_stats_work(struct mlx5_core_dev *dev,
@@ -46,7 +46,7 @@ void fs_debugfs_cleanup(struct mlx5_core_dev *dev)
 {
 	if (IS_ERR_OR_NULL(dev->priv.steering->debugfs))
 		return;
-	debugfs_remove(dev->priv.steering->debugfs);
+	debugfs_remove_recursive(dev->priv.steering->debugfs);
 }
 
 int fs_debugfs_init(struct mlx5_core_dev *dev)
@@ -0,0 +1,696 @@
+// SPDX-License-Identifier: GPL-2.0 OR Linux-OpenIB
+/* Copyright (c) 2020 Mellanox Technologies. */
+
+#include <linux/debugfs.h>
+#include <linux/delay.h>
+#include <linux/idr.h>
+#include <linux/random.h>
+#include <linux/workqueue.h>
+#include <linux/mlx5/driver.h>
+#include "mlx5_core.h"
+#include "fw_emu.h"
+
+enum {
+	MLX5_FW_EMU_CMDIF_REV		= 5,
+	MLX5_FW_EMU_FW_REV_MAJ		= 16,
+	MLX5_FW_EMU_FW_REV_MIN		= 99,
+	MLX5_FW_EMU_FW_REV_SUB		= 9999,
+	MLX5_FW_EMU_LOG_CMDQ_SIZE	= 5,
+	MLX5_FW_EMU_LOG_CMDQ_STRIDE	= 6,
+	MLX5_FW_EMU_MAX_LOG_FT_SIZE	= 20,
+	MLX5_FW_EMU_MAX_FT_ID		= 1 << 24,
+	MLX5_FW_EMU_BOOT_PAGES		= 64,
+	MLX5_FW_EMU_INIT_PAGES		= 1024,
+	MLX5_FW_EMU_FC_BULK_FACTOR	= 128,
+	/* one in this many flow counters sees traffic between two queries */
+	MLX5_FW_EMU_FC_ACTIVE_STRIDE	= 16,
+};
+
+enum {
+	MLX5_FW_EMU_PAGES_CANT_GIVE	= 0,
+	MLX5_FW_EMU_PAGES_GIVE		= 1,
+	MLX5_FW_EMU_PAGES_TAKE		= 2,
+};
+
+struct mlx5_fw_emu_slot {
+	struct work_struct	work;
+	struct mlx5_fw_emu     *emu;
+	int			idx;
+	u32			delay_us;
+};
+
+struct mlx5_fw_emu_ft {
+	u8			type;
+	u8			level;
+	u8			log_size;
+	u32			num_groups;
+	u32			num_ftes;
+	unsigned long	       *ftes;
+};
+
+struct mlx5_fw_emu_fg {
+	u32			table_id;
+	u32			start_index;
+	u32			end_index;
+};
+
+struct mlx5_fw_emu {
+	struct mlx5_core_dev	*dev;
+	struct mlx5_init_seg	*iseg;
+	struct workqueue_struct	*wq;
+	struct mlx5_fw_emu_slot	slots[MLX5_MAX_COMMANDS];
+	struct dentry		*dbg_root;
+
+	u32			latency_us;
+	u32			jitter_us;
+	u32			boot_pages;
+	u32			init_pages;
+
+	/* protects the device model below */
+	struct mutex		lock;
+	u16			issi;
+	u32			hca_cur[MLX5_CAP_NUM][MLX5_UN_SZ_DW(hca_cap_union)];
+	u32			hca_max[MLX5_CAP_NUM][MLX5_UN_SZ_DW(hca_cap_union)];
+	u64		       *pages;
+	u32			num_pages;
+	u32			max_pages;
+	struct idr		ft_idr;
+	struct idr		fg_idr;
+	u32			next_fc_id;
+	u32			num_fc_allocs;
+	u64			num_fc_queries;
+
+	u64			num_cmds;
+	u64			num_failed;
+};
+
+static u16 emu_opcode(void *in)
+{
+	return MLX5_GET(query_hca_cap_in, in, opcode);
+}
+
+static u16 emu_op_mod(void *in)
+{
+	return MLX5_GET(query_hca_cap_in, in, op_mod);
+}
+
+static void emu_init_caps(struct mlx5_fw_emu *emu)
+{
+	void *gen = emu->hca_max[MLX5_CAP_GENERAL];
+	void *ft = emu->hca_max[MLX5_CAP_FLOW_TABLE];
+
+	MLX5_SET(cmd_hca_cap, gen, log_max_qp, 18);
+	MLX5_SET(cmd_hca_cap, gen, log_max_cq, 24);
+	MLX5_SET(cmd_hca_cap, gen, log_max_eq, 8);
+	MLX5_SET(cmd_hca_cap, gen, log_max_pd, 23);
+	MLX5_SET(cmd_hca_cap, gen, port_type, MLX5_CAP_PORT_TYPE_ETH);
+	MLX5_SET(cmd_hca_cap, gen, num_ports, 1);
+	MLX5_SET(cmd_hca_cap, gen, vport_group_manager, 1);
+	MLX5_SET(cmd_hca_cap, gen, nic_flow_table, 1);
+	MLX5_SET(cmd_hca_cap, gen, max_flow_counter_15_0, 0xffff);
+	MLX5_SET(cmd_hca_cap, gen, log_max_flow_counter_bulk, 23);
+	MLX5_SET(cmd_hca_cap, gen, flow_counter_bulk_alloc, 0xff);
+
+	MLX5_SET(flow_table_nic_cap, ft,
+		 flow_table_properties_nic_receive.ft_support, 1);
+	MLX5_SET(flow_table_nic_cap, ft,
+		 flow_table_properties_nic_receive.flow_counter, 1);
+	MLX5_SET(flow_table_nic_cap, ft,
+		 flow_table_properties_nic_receive.log_max_ft_size,
+		 MLX5_FW_EMU_MAX_LOG_FT_SIZE);
+	MLX5_SET(flow_table_nic_cap, ft,
+		 flow_table_properties_nic_receive.max_ft_level, 64);
+	MLX5_SET(flow_table_nic_cap, ft,
+		 flow_table_properties_nic_receive.log_max_flow, 16);
+
+	memcpy(emu->hca_cur, emu->hca_max, sizeof(emu->hca_cur));
+}
+
+static u8 emu_query_hca_cap(struct mlx5_fw_emu *emu, void *in, void *out,
+			    int outlen)
+{
+	u16 op_mod = emu_op_mod(in);
+	int type = op_mod >> 1;
+	int len;
+
+	if (type >= MLX5_CAP_NUM)
+		return MLX5_CMD_STAT_BAD_PARAM_ERR;
+
+	len = min_t(int, outlen - MLX5_BYTE_OFF(query_hca_cap_out, capability),
+		    MLX5_UN_SZ_BYTES(hca_cap_union));
+	if (len > 0)
+		memcpy(MLX5_ADDR_OF(query_hca_cap_out, out, capability),
+		       (op_mod & 1) == HCA_CAP_OPMOD_GET_CUR ?
+		       emu->hca_cur[type] : emu->hca_max[type], len);
+	return MLX5_CMD_STAT_OK;
+}
+
+static u8 emu_set_hca_cap(struct mlx5_fw_emu *emu, void *in, int inlen)
+{
+	int type = emu_op_mod(in) >> 1;
+	int len;
+
+	if (type >= MLX5_CAP_NUM)
+		return MLX5_CMD_STAT_BAD_PARAM_ERR;
+
+	len = min_t(int, inlen - MLX5_BYTE_OFF(set_hca_cap_in, capability),
+		    MLX5_UN_SZ_BYTES(hca_cap_union));
+	if (len > 0)
+		memcpy(emu->hca_cur[type],
+		       MLX5_ADDR_OF(set_hca_cap_in, in, capability), len);
+	return MLX5_CMD_STAT_OK;
+}
+
+static u8 emu_query_pages(struct mlx5_fw_emu *emu, void *in, void *out)
+{
+	s32 npages = 0;
+
+	switch (emu_op_mod(in)) {
+	case MLX5_QUERY_PAGES_IN_OP_MOD_BOOT_PAGES:
+		npages = emu->boot_pages;
+		break;
+	case MLX5_QUERY_PAGES_IN_OP_MOD_INIT_PAGES:
+		npages = emu->init_pages;
+		break;
+	}
+	MLX5_SET(query_pages_out, out, num_pages, npages);
+	return MLX5_CMD_STAT_OK;
+}
+
+static u8 emu_manage_pages(struct mlx5_fw_emu *emu, void *in, int inlen,
+			   void *out, int outlen)
+{
+	u32 n = MLX5_GET(manage_pages_in, in, input_num_entries);
+	__be64 *pas;
+	u64 *pages;
+	u32 i;
+
+	switch (emu_op_mod(in)) {
+	case MLX5_FW_EMU_PAGES_GIVE:
+		if (MLX5_ST_SZ_BYTES(manage_pages_in) + n * sizeof(u64) > inlen)
+			return MLX5_CMD_STAT_BAD_INP_LEN_ERR;
+		if (emu->num_pages + n > emu->max_pages) {
+			u32 max = max(emu->num_pages + n, 2 * emu->max_pages);
+
+			pages = kvzalloc(max * sizeof(*pages), GFP_KERNEL);
+			if (!pages)
+				return MLX5_CMD_STAT_NO_RES_ERR;
+			if (emu->pages)
+				memcpy(pages, emu->pages,
+				       emu->num_pages * sizeof(*pages));
+			kvfree(emu->pages);
+			emu->pages = pages;
+			emu->max_pages = max;
+		}
+		pas = MLX5_ADDR_OF(manage_pages_in, in, pas);
+		for (i = 0; i < n; i++)
+			emu->pages[emu->num_pages++] = be64_to_cpu(pas[i]);
+		break;
+	case MLX5_FW_EMU_PAGES_TAKE:
+		n = min_t(u32, n, emu->num_pages);
+		n = min_t(u32, n, (outlen - MLX5_ST_SZ_BYTES(manage_pages_out)) /
+				  sizeof(u64));
+		pas = MLX5_ADDR_OF(manage_pages_out, out, pas);
+		for (i = 0; i < n; i++)
+			pas[i] = cpu_to_be64(emu->pages[--emu->num_pages]);
+		MLX5_SET(manage_pages_out, out, output_num_entries, n);
+		break;
+	case MLX5_FW_EMU_PAGES_CANT_GIVE:
+		break;
+	default:
+		return MLX5_CMD_STAT_BAD_PARAM_ERR;
+	}
+	return MLX5_CMD_STAT_OK;
+}
+
+static u8 emu_create_ft(struct mlx5_fw_emu *emu, void *in, void *out)
+{
+	struct mlx5_fw_emu_ft *ft;
+	int id;
+
+	ft = kzalloc(sizeof(*ft), GFP_KERNEL);
+	if (!ft)
+		return MLX5_CMD_STAT_NO_RES_ERR;
+
+	ft->type = MLX5_GET(create_flow_table_in, in, table_type);
+	ft->level = MLX5_GET(create_flow_table_in, in,
+			     flow_table_context.level);
+	ft->log_size = MLX5_GET(create_flow_table_in, in,
+				flow_table_context.log_size);
+	if (ft->log_size > MLX5_FW_EMU_MAX_LOG_FT_SIZE)
+		goto err_param;
+
+	ft->ftes = bitmap_zalloc(1 << ft->log_size, GFP_KERNEL);
+	if (!ft->ftes)
+		goto err_res;
+
+	id = idr_alloc(&emu->ft_idr, ft, 1, MLX5_FW_EMU_MAX_FT_ID, GFP_KERNEL);
+	if (id < 0) {
+		bitmap_free(ft->ftes);
+		goto err_res;
+	}
+
+	MLX5_SET(create_flow_table_out, out, table_id, id);
+	return MLX5_CMD_STAT_OK;
+
+err_param:
+	kfree(ft);
+	return MLX5_CMD_STAT_BAD_PARAM_ERR;
+err_res:
+	kfree(ft);
+	return MLX5_CMD_STAT_NO_RES_ERR;
+}
+
+static u8 emu_destroy_ft(struct mlx5_fw_emu *emu, void *in)
+{
+	u32 id = MLX5_GET(destroy_flow_table_in, in, table_id);
+	struct mlx5_fw_emu_ft *ft = idr_find(&emu->ft_idr, id);
+
+	if (!ft)
+		return MLX5_CMD_STAT_BAD_RES_ERR;
+	if (ft->num_groups || ft->num_ftes)
+		return MLX5_CMD_STAT_RES_BUSY;
+
+	idr_remove(&emu->ft_idr, id);
+	bitmap_free(ft->ftes);
+	kfree(ft);
+	return MLX5_CMD_STAT_OK;
+}
+
+static u8 emu_find_ft(struct mlx5_fw_emu *emu, u32 id)
+{
+	return idr_find(&emu->ft_idr, id) ?
+	       MLX5_CMD_STAT_OK : MLX5_CMD_STAT_BAD_RES_ERR;
+}
+
+static u8 emu_create_fg(struct mlx5_fw_emu *emu, void *in, void *out)
+{
+	u32 table_id = MLX5_GET(create_flow_group_in, in, table_id);
+	struct mlx5_fw_emu_ft *ft = idr_find(&emu->ft_idr, table_id);
+	struct mlx5_fw_emu_fg *fg;
+	int id;
+
+	if (!ft)
+		return MLX5_CMD_STAT_BAD_RES_ERR;
+
+	fg = kzalloc(sizeof(*fg), GFP_KERNEL);
+	if (!fg)
+		return MLX5_CMD_STAT_NO_RES_ERR;
+
+	fg->table_id = table_id;
+	fg->start_index = MLX5_GET(create_flow_group_in, in, start_flow_index);
+	fg->end_index = MLX5_GET(create_flow_group_in, in, end_flow_index);
+	if (fg->start_index > fg->end_index ||
+	    fg->end_index >= 1U << ft->log_size) {
+		kfree(fg);
+		return MLX5_CMD_STAT_BAD_PARAM_ERR;
+	}
+
+	id = idr_alloc(&emu->fg_idr, fg, 1, 0, GFP_KERNEL);
+	if (id < 0) {
+		kfree(fg);
+		return MLX5_CMD_STAT_NO_RES_ERR;
+	}
+
+	ft->num_groups++;
+	MLX5_SET(create_flow_group_out, out, group_id, id);
+	return MLX5_CMD_STAT_OK;
+}
+
+static u8 emu_destroy_fg(struct mlx5_fw_emu *emu, void *in)
+{
+	u32 id = MLX5_GET(destroy_flow_group_in, in, group_id);
+	struct mlx5_fw_emu_fg *fg = idr_find(&emu->fg_idr, id);
+	struct mlx5_fw_emu_ft *ft;
+
+	if (!fg || fg->table_id != MLX5_GET(destroy_flow_group_in, in, table_id))
+		return MLX5_CMD_STAT_BAD_RES_ERR;
+
+	ft = idr_find(&emu->ft_idr, fg->table_id);
+	if (ft)
+		ft->num_groups--;
+	idr_remove(&emu->fg_idr, id);
+	kfree(fg);
+	return MLX5_CMD_STAT_OK;
+}
+
+static u8 emu_set_fte(struct mlx5_fw_emu *emu, void *in)
+{
+	struct mlx5_fw_emu_ft *ft;
+	u32 index;
+
+	ft = idr_find(&emu->ft_idr, MLX5_GET(set_fte_in, in, table_id));
+	if (!ft)
+		return MLX5_CMD_STAT_BAD_RES_ERR;
+
+	index = MLX5_GET(set_fte_in, in, flow_index);
+	if (index >= 1U << ft->log_size)
+		return MLX5_CMD_STAT_BAD_PARAM_ERR;
+
+	/* op_mod 0 creates the entry, op_mod 1 modifies an existing one */
+	if (emu_op_mod(in)) {
+		if (!test_bit(index, ft->ftes))
+			return MLX5_CMD_STAT_BAD_RES_ERR;
+	} else {
+		if (__test_and_set_bit(index, ft->ftes))
+			return MLX5_CMD_STAT_BAD_RES_STATE_ERR;
+		ft->num_ftes++;
+	}
+	return MLX5_CMD_STAT_OK;
+}
+
+static u8 emu_delete_fte(struct mlx5_fw_emu *emu, void *in)
+{
+	struct mlx5_fw_emu_ft *ft;
+	u32 index;
+
+	ft = idr_find(&emu->ft_idr, MLX5_GET(delete_fte_in, in, table_id));
+	if (!ft)
+		return MLX5_CMD_STAT_BAD_RES_ERR;
+
+	index = MLX5_GET(delete_fte_in, in, flow_index);
+	if (index >= 1U << ft->log_size ||
+	    !__test_and_clear_bit(index, ft->ftes))
+		return MLX5_CMD_STAT_BAD_RES_ERR;
+
+	ft->num_ftes--;
+	return MLX5_CMD_STAT_OK;
+}
+
+static u8 emu_alloc_fc(struct mlx5_fw_emu *emu, void *in, void *out)
+{
+	u32 bulk = MLX5_GET(alloc_flow_counter_in, in, flow_counter_bulk);
+	u32 n = bulk ? bulk * MLX5_FW_EMU_FC_BULK_FACTOR : 1;
+
+	emu->next_fc_id = ALIGN(emu->next_fc_id, n);
+	MLX5_SET(alloc_flow_counter_out, out, flow_counter_id,
+		 emu->next_fc_id);
+	emu->next_fc_id += n;
+	emu->num_fc_allocs++;
+	return MLX5_CMD_STAT_OK;
+}
+
+static u8 emu_dealloc_fc(struct mlx5_fw_emu *emu)
+{
+	if (!emu->num_fc_allocs)
+		return MLX5_CMD_STAT_BAD_RES_ERR;
+
+	emu->num_fc_allocs--;
+	return MLX5_CMD_STAT_OK;
+}
+
+/* Counters whose id is a multiple of MLX5_FW_EMU_FC_ACTIVE_STRIDE count
+ * one packet per query, all others stay at zero.
+ */
+static u8 emu_query_fc(struct mlx5_fw_emu *emu, void *in, void *out,
+		       int outlen)
+{
+	u32 base_id = MLX5_GET(query_flow_counter_in, in, flow_counter_id);
+	int num = MLX5_GET(query_flow_counter_in, in, num_of_counters) ?: 1;
+	void *stats;
+	u64 packets;
+	int i;
+
+	if (MLX5_ST_SZ_BYTES(query_flow_counter_out) +
+	    num * MLX5_ST_SZ_BYTES(traffic_counter) > outlen)
+		return MLX5_CMD_STAT_BAD_PARAM_ERR;
+
+	emu->num_fc_queries++;
+	for (i = 0; i < num; i++) {
+		packets = (base_id + i) % MLX5_FW_EMU_FC_ACTIVE_STRIDE ?
+			  0 : emu->num_fc_queries;
+		stats = MLX5_ADDR_OF(query_flow_counter_out, out,
+				     flow_statistics[i]);
+		MLX5_SET64(traffic_counter, stats, packets, packets);
+		MLX5_SET64(traffic_counter, stats, octets, packets * 64);
+	}
+	return MLX5_CMD_STAT_OK;
+}
+
+/* Executes one command against the model. @in and @out are flat copies of
+ * the command mailboxes; @out is zeroed by the caller so opcodes that have
+ * nothing to report only need to return a status.
+ */
+int mlx5_fw_emu_exec(struct mlx5_fw_emu *emu, void *in, int inlen,
+		     void *out, int outlen)
+{
+	u16 opcode = emu_opcode(in);
+	u8 status;
+
+	mutex_lock(&emu->lock);
+	switch (opcode) {
+	case MLX5_CMD_OP_QUERY_HCA_CAP:
+		status = emu_query_hca_cap(emu, in, out, outlen);
+		break;
+	case MLX5_CMD_OP_SET_HCA_CAP:
+		status = emu_set_hca_cap(emu, in, inlen);
+		break;
+	case MLX5_CMD_OP_QUERY_ISSI:
+		MLX5_SET(query_issi_out, out, current_issi, emu->issi);
+		MLX5_SET(query_issi_out, out, supported_issi_dw0, 0x3);
+		status = MLX5_CMD_STAT_OK;
+		break;
+	case MLX5_CMD_OP_SET_ISSI:
+		emu->issi = MLX5_GET(set_issi_in, in, current_issi);
+		status = MLX5_CMD_STAT_OK;
+		break;
+	case MLX5_CMD_OP_QUERY_PAGES:
+		status = emu_query_pages(emu, in, out);
+		break;
+	case MLX5_CMD_OP_MANAGE_PAGES:
+		status = emu_manage_pages(emu, in, inlen, out, outlen);
+		break;
+	case MLX5_CMD_OP_CREATE_FLOW_TABLE:
+		status = emu_create_ft(emu, in, out);
+		break;
+	case MLX5_CMD_OP_DESTROY_FLOW_TABLE:
+		status = emu_destroy_ft(emu, in);
+		break;
+	case MLX5_CMD_OP_MODIFY_FLOW_TABLE:
+		status = emu_find_ft(emu, MLX5_GET(modify_flow_table_in, in,
+						   table_id));
+		break;
+	case MLX5_CMD_OP_SET_FLOW_TABLE_ROOT:
+		status = emu_find_ft(emu, MLX5_GET(set_flow_table_root_in, in,
+						   table_id));
+		break;
+	case MLX5_CMD_OP_CREATE_FLOW_GROUP:
+		status = emu_create_fg(emu, in, out);
+		break;
+	case MLX5_CMD_OP_DESTROY_FLOW_GROUP:
+		status = emu_destroy_fg(emu, in);
+		break;
+	case MLX5_CMD_OP_SET_FLOW_TABLE_ENTRY:
+		status = emu_set_fte(emu, in);
+		break;
+	case MLX5_CMD_OP_DELETE_FLOW_TABLE_ENTRY:
+		status = emu_delete_fte(emu, in);
+		break;
+	case MLX5_CMD_OP_ALLOC_FLOW_COUNTER:
+		status = emu_alloc_fc(emu, in, out);
+		break;
+	case MLX5_CMD_OP_DEALLOC_FLOW_COUNTER:
+		status = emu_dealloc_fc(emu);
+		break;
+	case MLX5_CMD_OP_QUERY_FLOW_COUNTER:
+		status = emu_query_fc(emu, in, out, outlen);
+		break;
+	case MLX5_CMD_OP_ENABLE_HCA:
+	case MLX5_CMD_OP_DISABLE_HCA:
+	case MLX5_CMD_OP_INIT_HCA:
+	case MLX5_CMD_OP_TEARDOWN_HCA:
+	case MLX5_CMD_OP_SET_DRIVER_VERSION:
+	case MLX5_CMD_OP_QUERY_ADAPTER:
+	case MLX5_CMD_OP_ACCESS_REG:
+	case MLX5_CMD_OP_NOP:
+		status = MLX5_CMD_STAT_OK;
+		break;
+	default:
+		status = MLX5_CMD_STAT_BAD_OP_ERR;
+		break;
+	}
+
+	emu->num_cmds++;
+	if (status)
+		emu->num_failed++;
+	mutex_unlock(&emu->lock);
+
+	/* every command output starts with the same status/syndrome header;
+	 * the syndrome carries the opcode so failures are easy to attribute.
+	 */
+	MLX5_SET(query_hca_cap_out, out, status, status);
+	if (status)
+		MLX5_SET(query_hca_cap_out, out, syndrome, opcode);
+	return status;
+}
+
+static void emu_slot_work(struct work_struct *work)
+{
+	struct mlx5_fw_emu_slot *slot =
+		container_of(work, struct mlx5_fw_emu_slot, work);
+
+	if (slot->delay_us)
+		usleep_range(slot->delay_us,
+			     slot->delay_us + slot->delay_us / 8 + 1);
+	mlx5_cmd_emu_exec(slot->emu->dev, slot->idx);
+}
+
+void mlx5_fw_emu_doorbell(struct mlx5_core_dev *dev, int idx)
+{
+	struct mlx5_fw_emu *emu = dev->fw_emu;
+	struct mlx5_fw_emu_slot *slot = &emu->slots[idx];
+	u32 jitter = READ_ONCE(emu->jitter_us);
+
+	slot->delay_us = READ_ONCE(emu->latency_us);
+	if (jitter)
+		slot->delay_us += prandom_u32_max(jitter + 1);
+	queue_work(emu->wq, &slot->work);
+}
+
+void mlx5_fw_emu_set_latency(struct mlx5_fw_emu *emu, u32 latency_us,
+			     u32 jitter_us)
+{
+	WRITE_ONCE(emu->latency_us, latency_us);
+	WRITE_ONCE(emu->jitter_us, jitter_us);
+}
+EXPORT_SYMBOL(mlx5_fw_emu_set_latency);
+
+void mlx5_fw_emu_set_pages(struct mlx5_fw_emu *emu, u32 boot_pages,
+			   u32 init_pages)
+{
+	mutex_lock(&emu->lock);
+	emu->boot_pages = boot_pages;
+	emu->init_pages = init_pages;
+	mutex_unlock(&emu->lock);
+}
+EXPORT_SYMBOL(mlx5_fw_emu_set_pages);
+
+u64 mlx5_fw_emu_num_cmds(struct mlx5_fw_emu *emu)
+{
+	u64 num_cmds;
+
+	mutex_lock(&emu->lock);
+	num_cmds = emu->num_cmds;
+	mutex_unlock(&emu->lock);
+	return num_cmds;
+}
+EXPORT_SYMBOL(mlx5_fw_emu_num_cmds);
+
+static void emu_init_iseg(struct mlx5_fw_emu *emu)
+{
+	struct mlx5_init_seg *iseg = emu->iseg;
+
+	iseg->fw_rev = cpu_to_be32(MLX5_FW_EMU_FW_REV_MIN << 16 |
+				   MLX5_FW_EMU_FW_REV_MAJ);
+	iseg->cmdif_rev_fw_sub = cpu_to_be32(MLX5_FW_EMU_CMDIF_REV << 16 |
+					     MLX5_FW_EMU_FW_REV_SUB);
+	iseg->cmdq_addr_l_sz = cpu_to_be32(MLX5_FW_EMU_LOG_CMDQ_SIZE << 4 |
+					   MLX5_FW_EMU_LOG_CMDQ_STRIDE);
+	/* initializing bit clear: firmware is ready */
+	iseg->initializing = 0;
+}
+
+static void emu_debugfs_init(struct mlx5_fw_emu *emu)
+{
+	struct mlx5_core_dev *dev = emu->dev;
+
+	if (!dev->priv.dbg_root)
+		return;
+
+	emu->dbg_root = debugfs_create_dir("fw_emu", dev->priv.dbg_root);
+	if (!emu->dbg_root)
+		return;
+
+	debugfs_create_u32("latency_us", 0600, emu->dbg_root, &emu->latency_us);
+	debugfs_create_u32("jitter_us", 0600, emu->dbg_root, &emu->jitter_us);
+	debugfs_create_u32("boot_pages", 0600, emu->dbg_root, &emu->boot_pages);
+	debugfs_create_u32("init_pages", 0600, emu->dbg_root, &emu->init_pages);
+	debugfs_create_u32("fw_pages", 0400, emu->dbg_root, &emu->num_pages);
+	debugfs_create_u64("commands", 0400, emu->dbg_root, &emu->num_cmds);
+	debugfs_create_u64("fc_queries", 0400, emu->dbg_root,
+			   &emu->num_fc_queries);
+	debugfs_create_u64("failed", 0400, emu->dbg_root, &emu->num_failed);
+}
+
+/* Attaches an emulated firmware to @dev, which must not be bound to a PCI
+ * function. Call before mlx5_cmd_init(); the initialization segment the
+ * command interface reads is provided by the emulator.
+ */
+struct mlx5_fw_emu *mlx5_fw_emu_create(struct mlx5_core_dev *dev)
+{
+	struct mlx5_fw_emu *emu;
+	int i;
+
+	emu = kvzalloc(sizeof(*emu), GFP_KERNEL);
+	if (!emu)
+		return ERR_PTR(-ENOMEM);
+
+	emu->iseg = kzalloc(sizeof(*emu->iseg), GFP_KERNEL);
+	if (!emu->iseg)
+		goto err_free;
+
+	emu->wq = alloc_workqueue("mlx5_fw_emu", WQ_UNBOUND, MLX5_MAX_COMMANDS);
+	if (!emu->wq)
+		goto err_iseg;
+
+	emu->dev = dev;
+	emu->boot_pages = MLX5_FW_EMU_BOOT_PAGES;
+	emu->init_pages = MLX5_FW_EMU_INIT_PAGES;
+	mutex_init(&emu->lock);
+	idr_init(&emu->ft_idr);
+	idr_init(&emu->fg_idr);
+	for (i = 0; i < MLX5_MAX_COMMANDS; i++) {
+		emu->slots[i].emu = emu;
+		emu->slots[i].idx = i;
+		INIT_WORK(&emu->slots[i].work, emu_slot_work);
+	}
+	emu_init_caps(emu);
+	emu_init_iseg(emu);
+	emu_debugfs_init(emu);
+
+	dev->iseg = (__force struct mlx5_init_seg __iomem *)emu->iseg;
+	dev->fw_emu = emu;
+	return emu;
+
+err_iseg:
+	kfree(emu->iseg);
+err_free:
+	kvfree(emu);
+	return ERR_PTR(-ENOMEM);
+}
+EXPORT_SYMBOL(mlx5_fw_emu_create);
+
+static int emu_free_ft(int id, void *p, void *data)
+{
+	struct mlx5_fw_emu_ft *ft = p;
+
+	bitmap_free(ft->ftes);
+	kfree(ft);
+	return 0;
+}
+
+static int emu_free_fg(int id, void *p, void *data)
+{
+	kfree(p);
+	return 0;
+}
+
+/* Call after mlx5_cmd_cleanup(), once no command can be in flight. */
+void mlx5_fw_emu_destroy(struct mlx5_fw_emu *emu)
+{
+	struct mlx5_core_dev *dev = emu->dev;
+
+	destroy_workqueue(emu->wq);
+	debugfs_remove_recursive(emu->dbg_root);
+	dev->fw_emu = NULL;
+	dev->iseg = NULL;
+
+	idr_for_each(&emu->fg_idr, emu_free_fg, NULL);
+	idr_destroy(&emu->fg_idr);
+	idr_for_each(&emu->ft_idr, emu_free_ft, NULL);
+	idr_destroy(&emu->ft_idr);
+	kvfree(emu->pages);
+	kfree(emu->iseg);
+	kvfree(emu);
+}
+EXPORT_SYMBOL(mlx5_fw_emu_destroy);
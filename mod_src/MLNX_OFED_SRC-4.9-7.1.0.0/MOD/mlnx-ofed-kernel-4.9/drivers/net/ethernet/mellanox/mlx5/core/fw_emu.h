@@ -0,0 +1,55 @@
+/* SPDX-License-Identifier: GPL-2.0 OR Linux-OpenIB */
+/* Copyright (c) 2020 Mellanox Technologies. */
+
+#ifndef __MLX5_FW_EMU_H__
+#define __MLX5_FW_EMU_H__
+
+#include <linux/mlx5/driver.h>
+
+/* Software model of the firmware command interface.
+ *
+ * An emulated device has no PCI function behind it: the initialization
+ * segment lives in host memory and ringing the command doorbell hands the
+ * descriptor to mlx5_fw_emu_doorbell() instead of the HCA. The command is
+ * executed against an in-memory model of the commonly used opcodes after
+ * the configured latency, and completed the same way a real completion EQE
+ * or a polled ownership flip would complete it.
+ */
+
+struct mlx5_fw_emu;
+
+#ifdef CONFIG_MLX5_FW_EMU
+
+struct mlx5_fw_emu *mlx5_fw_emu_create(struct mlx5_core_dev *dev);
+void mlx5_fw_emu_destroy(struct mlx5_fw_emu *emu);
+void mlx5_fw_emu_set_latency(struct mlx5_fw_emu *emu, u32 latency_us,
+			     u32 jitter_us);
+void mlx5_fw_emu_set_pages(struct mlx5_fw_emu *emu, u32 boot_pages,
+			   u32 init_pages);
+u64 mlx5_fw_emu_num_cmds(struct mlx5_fw_emu *emu);
+void mlx5_fw_emu_doorbell(struct mlx5_core_dev *dev, int idx);
+int mlx5_fw_emu_exec(struct mlx5_fw_emu *emu, void *in, int inlen,
+		     void *out, int outlen);
+
+/* Provided by cmd.c for the emulator */
+void mlx5_cmd_emu_exec(struct mlx5_core_dev *dev, int idx);
+void mlx5_cmd_emu_use_events(struct mlx5_core_dev *dev);
+void mlx5_cmd_emu_use_polling(struct mlx5_core_dev *dev);
+
+static inline bool mlx5_fw_emu_attached(struct mlx5_core_dev *dev)
+{
+	return !!dev->fw_emu;
+}
+
+#else
+
+static inline void mlx5_fw_emu_doorbell(struct mlx5_core_dev *dev, int idx) {}
+
+static inline bool mlx5_fw_emu_attached(struct mlx5_core_dev *dev)
+{
+	return false;
+}
+
+#endif /* CONFIG_MLX5_FW_EMU */
+
+#endif /* __MLX5_FW_EMU_H__ */
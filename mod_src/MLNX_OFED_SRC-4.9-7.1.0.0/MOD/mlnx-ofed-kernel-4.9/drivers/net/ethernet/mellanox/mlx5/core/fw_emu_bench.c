@@ -0,0 +1,610 @@
+// SPDX-License-Identifier: GPL-2.0 OR Linux-OpenIB
+/* Copyright (c) 2020 Mellanox Technologies. */
+
+/* Command interface benchmark on top of the firmware emulator.
+ *
+ * Loading the module brings up a PCI-less mlx5_core_dev backed by
+ * mlx5_fw_emu, replays the firmware command sequence of a driver load,
+ * including the boot/init page handover through pagealloc.c,
+ * then measures synchronous and asynchronous command throughput and the
+ * flow table rule insertion rate, one command at a time and through
+ * mlx5_cmd_exec_batch(), and the cost of flow counter sampling rounds.
+ * Results are reported in the kernel log.
+ */
+
+#include <linux/module.h>
+#include <linux/device.h>
+#include <linux/dma-mapping.h>
+#include <linux/ktime.h>
+#include <linux/log2.h>
+#include <linux/mlx5/driver.h>
+#include <linux/mlx5/cmd.h>
+#include <linux/mlx5/fs.h>
+#include "mlx5_core.h"
+#include "fs_core.h"
+#include "fw_emu.h"
+
+MODULE_DESCRIPTION("Mellanox 5th generation command interface benchmark over emulated firmware");
+MODULE_LICENSE("Dual BSD/GPL");
+
+static unsigned int iterations = 10000;
+module_param(iterations, uint, 0444);
+MODULE_PARM_DESC(iterations, "Number of commands per throughput run. Default=10000");
+
+static unsigned int rules = 65536;
+module_param(rules, uint, 0444);
+MODULE_PARM_DESC(rules, "Number of flow table entries to insert. Default=65536");
+
+static unsigned int async_depth = 16;
+module_param(async_depth, uint, 0444);
+MODULE_PARM_DESC(async_depth, "Outstanding commands in the async run. Default=16");
+
+static unsigned int latency_us;
+module_param(latency_us, uint, 0444);
+MODULE_PARM_DESC(latency_us, "Emulated firmware execution latency in usec. Default=0");
+
+static unsigned int jitter_us;
+module_param(jitter_us, uint, 0444);
+MODULE_PARM_DESC(jitter_us, "Random extra latency in usec, up to this value. Default=0");
+
+static unsigned int boot_pages = 64;
+module_param(boot_pages, uint, 0444);
+MODULE_PARM_DESC(boot_pages, "4K pages requested by the emulated firmware at boot. Default=64");
+
+static unsigned int init_pages = 262144;
+module_param(init_pages, uint, 0444);
+MODULE_PARM_DESC(init_pages, "4K pages requested by the emulated firmware at init. Default=262144 (1GB)");
+
+static unsigned int counters = 262144;
+module_param(counters, uint, 0444);
+MODULE_PARM_DESC(counters, "Number of aging flow counters to sample. Default=262144");
+
+static unsigned int fc_rounds = 16;
+module_param(fc_rounds, uint, 0444);
+MODULE_PARM_DESC(fc_rounds, "Number of flow counter sampling rounds. Default=16");
+
+struct bench_ctx {
+	struct device		*ddev;
+	struct mlx5_core_dev	*mdev;
+	struct mlx5_fw_emu	*emu;
+};
+
+struct bench_async_work {
+	struct mlx5_async_work	cb_work;
+	struct completion	*done;
+	atomic_t		*left;
+	u32			out[MLX5_ST_SZ_DW(query_issi_out)];
+};
+
+static u64 bench_rate(u64 n, u64 ns)
+{
+	return ns ? div64_u64(n * NSEC_PER_SEC, ns) : 0;
+}
+
+/* Firmware page handover through the driver's own page allocator */
+static int bench_startup_pages(struct bench_ctx *ctx, int boot)
+{
+	int before = ctx->mdev->priv.fw_pages;
+	u64 start, ns;
+	int err;
+
+	start = ktime_get_ns();
+	err = mlx5_satisfy_startup_pages(ctx->mdev, boot);
+	ns = ktime_get_ns() - start;
+	if (!err)
+		pr_info("mlx5_fw_emu_bench: %s pages: %d pages in %llu us, %llu pages/s\n",
+			boot ? "boot" : "init", ctx->mdev->priv.fw_pages - before,
+			div_u64(ns, NSEC_PER_USEC),
+			bench_rate(ctx->mdev->priv.fw_pages - before, ns));
+	return err;
+}
+
+static void bench_reclaim_pages(struct bench_ctx *ctx)
+{
+	int pages = ctx->mdev->priv.fw_pages;
+	u64 start, ns;
+
+	start = ktime_get_ns();
+	mlx5_reclaim_startup_pages(ctx->mdev);
+	ns = ktime_get_ns() - start;
+	pr_info("mlx5_fw_emu_bench: reclaim: %d pages in %llu us, %llu pages/s\n",
+		pages - ctx->mdev->priv.fw_pages, div_u64(ns, NSEC_PER_USEC),
+		bench_rate(pages - ctx->mdev->priv.fw_pages, ns));
+}
+
+static int bench_simple_cmd(struct bench_ctx *ctx, u16 opcode)
+{
+	u32 out[MLX5_ST_SZ_DW(enable_hca_out)] = {};
+	u32 in[MLX5_ST_SZ_DW(enable_hca_in)] = {};
+
+	MLX5_SET(enable_hca_in, in, opcode, opcode);
+	return mlx5_cmd_exec(ctx->mdev, in, sizeof(in), out, sizeof(out));
+}
+
+static int bench_query_cap(struct bench_ctx *ctx, enum mlx5_cap_type type,
+			   u16 mode)
+{
+	int outlen = MLX5_ST_SZ_BYTES(query_hca_cap_out);
+	u32 in[MLX5_ST_SZ_DW(query_hca_cap_in)] = {};
+	void *out;
+	int err;
+
+	out = kzalloc(outlen, GFP_KERNEL);
+	if (!out)
+		return -ENOMEM;
+
+	MLX5_SET(query_hca_cap_in, in, opcode, MLX5_CMD_OP_QUERY_HCA_CAP);
+	MLX5_SET(query_hca_cap_in, in, op_mod, type << 1 | mode);
+	err = mlx5_cmd_exec(ctx->mdev, in, sizeof(in), out, outlen);
+	if (!err)
+		memcpy(mode == HCA_CAP_OPMOD_GET_CUR ?
+		       ctx->mdev->caps.hca_cur[type] :
+		       ctx->mdev->caps.hca_max[type],
+		       MLX5_ADDR_OF(query_hca_cap_out, out, capability),
+		       MLX5_UN_SZ_BYTES(hca_cap_union));
+	kfree(out);
+	return err;
+}
+
+static int bench_set_general_cap(struct bench_ctx *ctx)
+{
+	int inlen = MLX5_ST_SZ_BYTES(set_hca_cap_in);
+	u32 out[MLX5_ST_SZ_DW(set_hca_cap_out)] = {};
+	void *in;
+	int err;
+
+	in = kzalloc(inlen, GFP_KERNEL);
+	if (!in)
+		return -ENOMEM;
+
+	memcpy(MLX5_ADDR_OF(set_hca_cap_in, in, capability),
+	       ctx->mdev->caps.hca_cur[MLX5_CAP_GENERAL],
+	       MLX5_UN_SZ_BYTES(hca_cap_union));
+	MLX5_SET(set_hca_cap_in, in, opcode, MLX5_CMD_OP_SET_HCA_CAP);
+	MLX5_SET(set_hca_cap_in, in, op_mod, MLX5_CAP_GENERAL << 1);
+	err = mlx5_cmd_exec(ctx->mdev, in, inlen, out, sizeof(out));
+	kfree(in);
+	return err;
+}
+
+/* The firmware command sequence of mlx5_function_setup() and
+ * mlx5_query_hca_caps(), without the PCI, EQ and health bring-up that has
+ * no meaning on an emulated device.
+ */
+static int bench_load(struct bench_ctx *ctx)
+{
+	static const enum mlx5_cap_type caps[] = {
+		MLX5_CAP_GENERAL,
+		MLX5_CAP_ETHERNET_OFFLOADS,
+		MLX5_CAP_ODP,
+		MLX5_CAP_ATOMIC,
+		MLX5_CAP_ROCE,
+		MLX5_CAP_FLOW_TABLE,
+		MLX5_CAP_ESWITCH_FLOW_TABLE,
+		MLX5_CAP_ESWITCH,
+		MLX5_CAP_QOS,
+	};
+	int err;
+	int i;
+
+	err = bench_simple_cmd(ctx, MLX5_CMD_OP_ENABLE_HCA) ?:
+	      bench_simple_cmd(ctx, MLX5_CMD_OP_QUERY_ISSI) ?:
+	      bench_simple_cmd(ctx, MLX5_CMD_OP_SET_ISSI) ?:
+	      bench_startup_pages(ctx, 1) ?:
+	      bench_query_cap(ctx, MLX5_CAP_GENERAL, HCA_CAP_OPMOD_GET_MAX) ?:
+	      bench_query_cap(ctx, MLX5_CAP_GENERAL, HCA_CAP_OPMOD_GET_CUR) ?:
+	      bench_set_general_cap(ctx) ?:
+	      bench_startup_pages(ctx, 0) ?:
+	      bench_simple_cmd(ctx, MLX5_CMD_OP_INIT_HCA) ?:
+	      bench_simple_cmd(ctx, MLX5_CMD_OP_SET_DRIVER_VERSION);
+	for (i = 0; !err && i < ARRAY_SIZE(caps); i++)
+		err = bench_query_cap(ctx, caps[i], HCA_CAP_OPMOD_GET_CUR) ?:
+		      bench_query_cap(ctx, caps[i], HCA_CAP_OPMOD_GET_MAX);
+	return err;
+}
+
+static void bench_unload(struct bench_ctx *ctx)
+{
+	bench_simple_cmd(ctx, MLX5_CMD_OP_TEARDOWN_HCA);
+	bench_reclaim_pages(ctx);
+	bench_simple_cmd(ctx, MLX5_CMD_OP_DISABLE_HCA);
+}
+
+static int bench_sync(struct bench_ctx *ctx, const char *mode)
+{
+	u64 start, ns;
+	int err = 0;
+	int i;
+
+	start = ktime_get_ns();
+	for (i = 0; !err && i < iterations; i++)
+		err = bench_simple_cmd(ctx, MLX5_CMD_OP_QUERY_ISSI);
+	ns = ktime_get_ns() - start;
+	if (!err)
+		pr_info("mlx5_fw_emu_bench: sync %s: %u commands in %llu us, %llu cmd/s\n",
+			mode, iterations, div_u64(ns, NSEC_PER_USEC),
+			bench_rate(iterations, ns));
+	return err;
+}
+
+static void bench_async_done(int status, struct mlx5_async_work *context)
+{
+	struct bench_async_work *work =
+		container_of(context, struct bench_async_work, cb_work);
+
+	if (atomic_dec_and_test(work->left))
+		complete(work->done);
+}
+
+static int bench_async(struct bench_ctx *ctx)
+{
+	u32 in[MLX5_ST_SZ_DW(query_issi_in)] = {};
+	DECLARE_COMPLETION_ONSTACK(done);
+	struct bench_async_work *works;
+	struct mlx5_async_ctx actx;
+	unsigned int depth = max(async_depth, 1U);
+	unsigned int sent, batch, i;
+	atomic_t left;
+	u64 start, ns;
+	int err = 0;
+
+	works = kvcalloc(depth, sizeof(*works), GFP_KERNEL);
+	if (!works)
+		return -ENOMEM;
+
+	MLX5_SET(query_issi_in, in, opcode, MLX5_CMD_OP_QUERY_ISSI);
+	mlx5_cmd_init_async_ctx(ctx->mdev, &actx);
+	start = ktime_get_ns();
+	for (sent = 0; !err && sent < iterations; sent += batch) {
+		batch = min(depth, iterations - sent);
+		reinit_completion(&done);
+		atomic_set(&left, batch);
+		for (i = 0; i < batch; i++) {
+			works[i].done = &done;
+			works[i].left = &left;
+			err = mlx5_cmd_exec_cb(&actx, in, sizeof(in),
+					       works[i].out,
+					       sizeof(works[i].out),
+					       bench_async_done,
+					       &works[i].cb_work);
+			if (err) {
+				/* account for the commands never issued */
+				if (atomic_sub_and_test(batch - i, &left))
+					complete(&done);
+				break;
+			}
+		}
+		wait_for_completion(&done);
+	}
+	ns = ktime_get_ns() - start;
+	mlx5_cmd_cleanup_async_ctx(&actx);
+	kvfree(works);
+
+	if (!err)
+		pr_info("mlx5_fw_emu_bench: async depth %u: %u commands in %llu us, %llu cmd/s\n",
+			depth, iterations, div_u64(ns, NSEC_PER_USEC),
+			bench_rate(iterations, ns));
+	return err;
+}
+
+enum {
+	BENCH_FTE_BATCH	= 256,
+};
+
+static void bench_fte_fill(void *fte_in, const void *tmpl, u32 idx)
+{
+	void *mv = MLX5_ADDR_OF(set_fte_in, fte_in, flow_context.match_value);
+
+	memcpy(fte_in, tmpl, MLX5_ST_SZ_BYTES(set_fte_in));
+	MLX5_SET(set_fte_in, fte_in, flow_index, idx);
+	MLX5_SET(fte_match_param, mv, outer_headers.dmac_47_16, idx);
+}
+
+/* Insert FTEs 0..n-1 either one command at a time or BENCH_FTE_BATCH
+ * commands per mlx5_cmd_exec_batch() call.
+ */
+static int bench_fte_insert(struct bench_ctx *ctx, const void *tmpl,
+			    unsigned int n, bool batched)
+{
+	int fte_inlen = MLX5_ST_SZ_BYTES(set_fte_in);
+	u32 out[MLX5_ST_SZ_DW(set_fte_out)] = {};
+	struct mlx5_cmd_batch_ent *ents;
+	unsigned int i, j, cnt;
+	u32 (*outs)[MLX5_ST_SZ_DW(set_fte_out)];
+	void *ins;
+	int err = 0;
+
+	if (!batched) {
+		ins = kvzalloc(fte_inlen, GFP_KERNEL);
+		if (!ins)
+			return -ENOMEM;
+		for (i = 0; !err && i < n; i++) {
+			bench_fte_fill(ins, tmpl, i);
+			err = mlx5_cmd_exec(ctx->mdev, ins, fte_inlen, out,
+					    sizeof(out));
+		}
+		kvfree(ins);
+		return err;
+	}
+
+	ents = kvcalloc(BENCH_FTE_BATCH, sizeof(*ents), GFP_KERNEL);
+	outs = kvcalloc(BENCH_FTE_BATCH, sizeof(*outs), GFP_KERNEL);
+	ins = kvcalloc(BENCH_FTE_BATCH, fte_inlen, GFP_KERNEL);
+	if (!ents || !outs || !ins) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	for (i = 0; !err && i < n; i += cnt) {
+		cnt = min_t(unsigned int, n - i, BENCH_FTE_BATCH);
+		for (j = 0; j < cnt; j++) {
+			ents[j].in = ins + j * fte_inlen;
+			ents[j].in_size = fte_inlen;
+			ents[j].out = outs[j];
+			ents[j].out_size = sizeof(outs[j]);
+			bench_fte_fill(ents[j].in, tmpl, i + j);
+		}
+		err = mlx5_cmd_exec_batch(ctx->mdev, ents, cnt);
+	}
+out:
+	kvfree(ins);
+	kvfree(outs);
+	kvfree(ents);
+	return err;
+}
+
+static int bench_rules(struct bench_ctx *ctx, const char *mode, bool batched)
+{
+	u32 ft_out[MLX5_ST_SZ_DW(create_flow_table_out)] = {};
+	u32 ft_in[MLX5_ST_SZ_DW(create_flow_table_in)] = {};
+	u32 fg_out[MLX5_ST_SZ_DW(create_flow_group_out)] = {};
+	u32 dfte_in[MLX5_ST_SZ_DW(delete_fte_in)] = {};
+	u32 dfg_in[MLX5_ST_SZ_DW(destroy_flow_group_in)] = {};
+	u32 dft_in[MLX5_ST_SZ_DW(destroy_flow_table_in)] = {};
+	u32 out[MLX5_ST_SZ_DW(set_fte_out)] = {};
+	int fg_inlen = MLX5_ST_SZ_BYTES(create_flow_group_in);
+	int fte_inlen = MLX5_ST_SZ_BYTES(set_fte_in);
+	unsigned int n = max(rules, 1U);
+	u32 table_id, group_id;
+	unsigned int i;
+	u64 start, ins_ns, del_ns;
+	void *fg_in, *fte_in;
+	u8 log_size;
+	int err;
+
+	log_size = order_base_2(n);
+	fg_in = kvzalloc(fg_inlen, GFP_KERNEL);
+	fte_in = kvzalloc(fte_inlen, GFP_KERNEL);
+	if (!fg_in || !fte_in) {
+		err = -ENOMEM;
+		goto out_free;
+	}
+
+	MLX5_SET(create_flow_table_in, ft_in, opcode,
+		 MLX5_CMD_OP_CREATE_FLOW_TABLE);
+	MLX5_SET(create_flow_table_in, ft_in, table_type, FS_FT_NIC_RX);
+	MLX5_SET(create_flow_table_in, ft_in, flow_table_context.log_size,
+		 log_size);
+	err = mlx5_cmd_exec(ctx->mdev, ft_in, sizeof(ft_in), ft_out,
+			    sizeof(ft_out));
+	if (err)
+		goto out_free;
+	table_id = MLX5_GET(create_flow_table_out, ft_out, table_id);
+
+	MLX5_SET(create_flow_group_in, fg_in, opcode,
+		 MLX5_CMD_OP_CREATE_FLOW_GROUP);
+	MLX5_SET(create_flow_group_in, fg_in, table_type, FS_FT_NIC_RX);
+	MLX5_SET(create_flow_group_in, fg_in, table_id, table_id);
+	MLX5_SET(create_flow_group_in, fg_in, start_flow_index, 0);
+	MLX5_SET(create_flow_group_in, fg_in, end_flow_index, n - 1);
+	MLX5_SET(create_flow_group_in, fg_in, match_criteria_enable,
+		 MLX5_MATCH_OUTER_HEADERS);
+	err = mlx5_cmd_exec(ctx->mdev, fg_in, fg_inlen, fg_out,
+			    sizeof(fg_out));
+	if (err)
+		goto out_ft;
+	group_id = MLX5_GET(create_flow_group_out, fg_out, group_id);
+
+	MLX5_SET(set_fte_in, fte_in, opcode, MLX5_CMD_OP_SET_FLOW_TABLE_ENTRY);
+	MLX5_SET(set_fte_in, fte_in, table_type, FS_FT_NIC_RX);
+	MLX5_SET(set_fte_in, fte_in, table_id, table_id);
+	MLX5_SET(set_fte_in, fte_in, flow_context.group_id, group_id);
+	MLX5_SET(set_fte_in, fte_in, flow_context.action,
+		 MLX5_FLOW_CONTEXT_ACTION_ALLOW);
+
+	start = ktime_get_ns();
+	err = bench_fte_insert(ctx, fte_in, n, batched);
+	ins_ns = ktime_get_ns() - start;
+
+	MLX5_SET(delete_fte_in, dfte_in, opcode,
+		 MLX5_CMD_OP_DELETE_FLOW_TABLE_ENTRY);
+	MLX5_SET(delete_fte_in, dfte_in, table_type, FS_FT_NIC_RX);
+	MLX5_SET(delete_fte_in, dfte_in, table_id, table_id);
+	start = ktime_get_ns();
+	for (i = n; i--;) {
+		MLX5_SET(delete_fte_in, dfte_in, flow_index, i);
+		mlx5_cmd_exec(ctx->mdev, dfte_in, sizeof(dfte_in), out,
+			      sizeof(out));
+	}
+	del_ns = ktime_get_ns() - start;
+
+	if (!err)
+		pr_info("mlx5_fw_emu_bench: %s%s: %u rules inserted in %llu us (%llu rules/s), deleted in %llu us (%llu rules/s)\n",
+			mode, batched ? " batched" : "",
+			n, div_u64(ins_ns, NSEC_PER_USEC), bench_rate(n, ins_ns),
+			div_u64(del_ns, NSEC_PER_USEC), bench_rate(n, del_ns));
+
+	MLX5_SET(destroy_flow_group_in, dfg_in, opcode,
+		 MLX5_CMD_OP_DESTROY_FLOW_GROUP);
+	MLX5_SET(destroy_flow_group_in, dfg_in, table_type, FS_FT_NIC_RX);
+	MLX5_SET(destroy_flow_group_in, dfg_in, table_id, table_id);
+	MLX5_SET(destroy_flow_group_in, dfg_in, group_id, group_id);
+	mlx5_cmd_exec(ctx->mdev, dfg_in, sizeof(dfg_in), out, sizeof(out));
+out_ft:
+	MLX5_SET(destroy_flow_table_in, dft_in, opcode,
+		 MLX5_CMD_OP_DESTROY_FLOW_TABLE);
+	MLX5_SET(destroy_flow_table_in, dft_in, table_type, FS_FT_NIC_RX);
+	MLX5_SET(destroy_flow_table_in, dft_in, table_id, table_id);
+	mlx5_cmd_exec(ctx->mdev, dft_in, sizeof(dft_in), out, sizeof(out));
+out_free:
+	kvfree(fte_in);
+	kvfree(fg_in);
+	return err;
+}
+
+static void bench_fc_changed(struct mlx5_fc *counter, void *ctx)
+{
+	u64 bytes, packets, lastuse;
+
+	mlx5_fc_query_cached(counter, &bytes, &packets, &lastuse);
+	(*(unsigned int *)ctx)++;
+}
+
+/* Run fc_rounds sampling rounds of the flow counter stats work over
+ * counters aging counters, of which the emulated firmware makes one in
+ * MLX5_FW_EMU_FC_ACTIVE_STRIDE count traffic, and drain the changed
+ * counters after each round like a TC stats consumer would.
+ */
+static int bench_fc(struct bench_ctx *ctx)
+{
+	struct mlx5_fc_stats *fc_stats = &ctx->mdev->priv.fc_stats;
+	unsigned int n = max(counters, 1U);
+	unsigned int changed = 0;
+	u64 start, ns = 0, cmds;
+	struct mlx5_fc **fcs;
+	unsigned int i;
+	int err;
+
+	fcs = kvcalloc(n, sizeof(*fcs), GFP_KERNEL);
+	if (!fcs)
+		return -ENOMEM;
+
+	err = mlx5_init_fc_stats(ctx->mdev);
+	if (err)
+		goto out_free;
+
+	for (i = 0; i < n; i++) {
+		fcs[i] = mlx5_fc_create(ctx->mdev, true);
+		if (IS_ERR(fcs[i])) {
+			err = PTR_ERR(fcs[i]);
+			break;
+		}
+	}
+	n = i;
+
+	cmds = mlx5_fw_emu_num_cmds(ctx->emu);
+	for (i = 0; !err && i < fc_rounds; i++) {
+		fc_stats->next_query = jiffies;
+		start = ktime_get_ns();
+		mod_delayed_work(fc_stats->wq, &fc_stats->work, 0);
+		flush_delayed_work(&fc_stats->work);
+		ns += ktime_get_ns() - start;
+		mlx5_fc_query_changed(ctx->mdev, bench_fc_changed, &changed);
+	}
+	cmds = mlx5_fw_emu_num_cmds(ctx->emu) - cmds;
+
+	if (!err && fc_rounds)
+		pr_info("mlx5_fw_emu_bench: %u counters, %u rounds: %llu us/round, %llu queries/round, %u changed reports\n",
+			n, fc_rounds, div_u64(ns, NSEC_PER_USEC * fc_rounds),
+			div_u64(cmds, fc_rounds), changed);
+
+	for (i = 0; i < n; i++)
+		mlx5_fc_destroy(ctx->mdev, fcs[i]);
+	mlx5_cleanup_fc_stats(ctx->mdev);
+out_free:
+	kvfree(fcs);
+	return err;
+}
+
+static int bench_run(struct bench_ctx *ctx)
+{
+	u64 start, ns;
+	int err;
+
+	start = ktime_get_ns();
+	err = mlx5_cmd_init(ctx->mdev);
+	if (err)
+		return err;
+	err = mlx5_pagealloc_init(ctx->mdev);
+	if (err) {
+		mlx5_cmd_cleanup(ctx->mdev);
+		return err;
+	}
+	err = bench_load(ctx);
+	ns = ktime_get_ns() - start;
+	if (err) {
+		pr_err("mlx5_fw_emu_bench: load sequence failed (%d)\n", err);
+		goto out;
+	}
+	pr_info("mlx5_fw_emu_bench: load sequence took %llu us, %d firmware pages\n",
+		div_u64(ns, NSEC_PER_USEC), ctx->mdev->priv.fw_pages);
+
+	err = bench_sync(ctx, "polling") ?:
+	      bench_rules(ctx, "polling", false);
+	if (!err) {
+		mlx5_cmd_emu_use_events(ctx->mdev);
+		err = bench_sync(ctx, "events") ?:
+		      bench_async(ctx) ?:
+		      bench_rules(ctx, "events", false) ?:
+		      bench_rules(ctx, "events", true) ?:
+		      bench_fc(ctx);
+		mlx5_cmd_emu_use_polling(ctx->mdev);
+	}
+	if (err)
+		pr_err("mlx5_fw_emu_bench: benchmark failed (%d)\n", err);
+
+out:
+	start = ktime_get_ns();
+	bench_unload(ctx);
+	ns = ktime_get_ns() - start;
+	pr_info("mlx5_fw_emu_bench: unload sequence took %llu us\n",
+		div_u64(ns, NSEC_PER_USEC));
+	mlx5_pagealloc_cleanup(ctx->mdev);
+	mlx5_cmd_cleanup(ctx->mdev);
+	return err;
+}
+
+static int __init mlx5_fw_emu_bench_init(void)
+{
+	struct bench_ctx ctx = {};
+	int err;
+
+	ctx.ddev = root_device_register("mlx5_fw_emu_bench");
+	if (IS_ERR(ctx.ddev))
+		return PTR_ERR(ctx.ddev);
+
+	err = dma_coerce_mask_and_coherent(ctx.ddev, DMA_BIT_MASK(64));
+	if (err)
+		goto err_dev;
+
+	err = -ENOMEM;
+	ctx.mdev = kvzalloc(sizeof(*ctx.mdev), GFP_KERNEL);
+	if (!ctx.mdev)
+		goto err_dev;
+	ctx.mdev->device = ctx.ddev;
+	ctx.mdev->state = MLX5_DEVICE_STATE_UP;
+
+	ctx.emu = mlx5_fw_emu_create(ctx.mdev);
+	if (IS_ERR(ctx.emu)) {
+		err = PTR_ERR(ctx.emu);
+		goto err_mdev;
+	}
+	mlx5_fw_emu_set_latency(ctx.emu, latency_us, jitter_us);
+	mlx5_fw_emu_set_pages(ctx.emu, boot_pages, init_pages);
+
+	err = bench_run(&ctx);
+
+	mlx5_fw_emu_destroy(ctx.emu);
+err_mdev:
+	kvfree(ctx.mdev);
+err_dev:
+	root_device_unregister(ctx.ddev);
+	return err;
+}
+
+static void __exit mlx5_fw_emu_bench_exit(void)
+{
+}
+
+module_init(mlx5_fw_emu_bench_init);
+module_exit(mlx5_fw_emu_bench_exit);
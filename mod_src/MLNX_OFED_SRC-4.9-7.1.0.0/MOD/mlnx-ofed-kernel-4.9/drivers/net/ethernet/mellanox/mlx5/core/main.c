@@ -891,6 +891,61 @@ int mlx5_core_disable_sf_hca(struct mlx5_core_dev *dev, u16 sf_func_id)
 	return disable_hca(dev, sf_func_id, 0);
 }
 
+struct hca_batch_cmd {
+	u32 in[MLX5_ST_SZ_DW(enable_hca_in)];
+	u32 out[MLX5_ST_SZ_DW(enable_hca_out)];
+};
+
+/* ENABLE_HCA and DISABLE_HCA share the same layout */
+static int set_hca_batch(struct mlx5_core_dev *dev, u16 opcode,
+			 const u16 *func_ids, int *errs, int num)
+{
+	struct mlx5_cmd_batch_ent *ents;
+	struct hca_batch_cmd *cmds;
+	int err;
+	int i;
+
+	ents = kvcalloc(num, sizeof(*ents), GFP_KERNEL);
+	cmds = kvcalloc(num, sizeof(*cmds), GFP_KERNEL);
+	if (!ents || !cmds) {
+		err = -ENOMEM;
+		for (i = 0; i < num; i++)
+			errs[i] = err;
+		goto out;
+	}
+
+	for (i = 0; i < num; i++) {
+		MLX5_SET(enable_hca_in, cmds[i].in, opcode, opcode);
+		MLX5_SET(enable_hca_in, cmds[i].in, function_id, func_ids[i]);
+		MLX5_SET(enable_hca_in, cmds[i].in, embedded_cpu_function,
+			 dev->caps.embedded_cpu);
+		ents[i].in = cmds[i].in;
+		ents[i].in_size = sizeof(cmds[i].in);
+		ents[i].out = cmds[i].out;
+		ents[i].out_size = sizeof(cmds[i].out);
+	}
+
+	err = mlx5_cmd_exec_batch(dev, ents, num);
+	for (i = 0; i < num; i++)
+		errs[i] = ents[i].err;
+out:
+	kvfree(cmds);
+	kvfree(ents);
+	return err;
+}
+
+int mlx5_core_enable_hca_batch(struct mlx5_core_dev *dev, const u16 *func_ids,
+			       int *errs, int num)
+{
+	return set_hca_batch(dev, MLX5_CMD_OP_ENABLE_HCA, func_ids, errs, num);
+}
+
+int mlx5_core_disable_hca_batch(struct mlx5_core_dev *dev, const u16 *func_ids,
+				int *errs, int num)
+{
+	return set_hca_batch(dev, MLX5_CMD_OP_DISABLE_HCA, func_ids, errs, num);
+}
+
 #ifdef HAVE_GETTIMEX64
 u64 mlx5_read_internal_timer(struct mlx5_core_dev *dev,
 			     struct ptp_system_timestamp *sts)
@@ -2026,6 +2081,8 @@ int mlx5_mdev_init(struct mlx5_core_dev *dev, int profile_idx)
 		return -ENOMEM;
 	}
 
+	mlx5dr_dbg_init_bench(dev);
+
 	err = mlx5_health_init(dev);
 	if (err)
 		goto err_health_init;
@@ -2039,7 +2096,7 @@ int mlx5_mdev_init(struct mlx5_core_dev *dev, int profile_idx)
 err_pagealloc_init:
 	mlx5_health_cleanup(dev);
 err_health_init:
-	debugfs_remove(dev->priv.dbg_root);
+	debugfs_remove_recursive(dev->priv.dbg_root);
 
 	return err;
 }
@@ -820,7 +820,7 @@ static int miniflow_attach_dummy_counter(struct mlx5e_tc_flow *flow)
 		return 0;
 
 	if (flow->esw_attr->action & MLX5_FLOW_CONTEXT_ACTION_COUNT) {
-		counter = mlx5_fc_alloc_dummy_counter();
+		counter = mlx5_fc_alloc_dummy_counter(flow);
 		if (!counter)
 			return -ENOMEM;
 
@@ -1245,6 +1245,12 @@ int miniflow_cache_init(struct mlx5e_priv *priv)
 	if (err)
 		goto err_cache;
 
+#ifndef CONFIG_COMPAT_NFT_GEN_FLOW_OFFLOAD
+	err = mlx5_ct_flow_offload_dev_register(priv->mdev);
+	if (err)
+		goto err_dev;
+#endif
+
 	err = rhashtable_init(mf_ht, &mf_ht_params);
 	if (err)
 		goto err_mf_ht;
@@ -1252,6 +1258,10 @@ int miniflow_cache_init(struct mlx5e_priv *priv)
 	return 0;
 
 err_mf_ht:
+#ifndef CONFIG_COMPAT_NFT_GEN_FLOW_OFFLOAD
+	mlx5_ct_flow_offload_dev_unregister(priv->mdev);
+err_dev:
+#endif
 	miniflow_cache_put();
 err_cache:
 	device_remove_file(&priv->mdev->pdev->dev, counters_tc_ct_attrs);
@@ -1267,6 +1277,9 @@ void miniflow_cache_destroy(struct mlx5e_priv *priv)
 	flush_workqueue(miniflow_wq);
 	rhashtable_destroy(mf_ht);
 	miniflow_free_current_miniflow();
+#ifndef CONFIG_COMPAT_NFT_GEN_FLOW_OFFLOAD
+	mlx5_ct_flow_offload_dev_unregister(priv->mdev);
+#endif
 	miniflow_cache_put();
 }
 
@@ -1538,23 +1551,6 @@ void ct_flow_offload_get_stats(struct nf_gen_flow_ct_stat *ct_stat,
 		}
 	}
 }
-#else
-void ct_flow_offload_get_stats(struct list_head *head, u64 *lastuse)
-{
-	struct mlx5e_tc_flow *flow, *tmp;
-
-	*lastuse = 0;
-	list_for_each_entry_safe(flow, tmp, head, nft_node) {
-		struct mlx5_fc *counter = flow->dummy_counter;
-		u64 bytes, packets, lastuse1;
-
-		if (counter) {
-			mlx5_fc_query_cached(counter, &bytes, &packets,
-					     &lastuse1);
-			*lastuse = max(*lastuse, lastuse1);
-		}
-	}
-}
 #endif /* CONFIG_COMPAT_NFT_GEN_FLOW_OFFLOAD */
 
 static void ct_flow_offload_del(struct mlx5e_tc_flow *flow)
@@ -1570,6 +1566,8 @@ int ct_flow_offload_destroy(struct list_head *head)
 
 	list_for_each_entry_safe(flow, n, head, nft_node) {
 		list_del_init(&flow->nft_node);
+		/* the entry owning the lock is freed after an RCU grace period */
+		WRITE_ONCE(flow->dep_lock, NULL);
 		ct_flow_offload_del(flow);
 	}
 
@@ -82,8 +82,10 @@ int mlx5_ct_flow_offload_remove(const struct net *net,
 
 int mlx5_ct_flow_offloaded_count(void);
 
+int mlx5_ct_flow_offload_dev_register(struct mlx5_core_dev *mdev);
+void mlx5_ct_flow_offload_dev_unregister(struct mlx5_core_dev *mdev);
+
 int ct_flow_offload_add(void *arg, struct list_head *head);
-void ct_flow_offload_get_stats(struct list_head *head, u64 *lastuse);
 int ct_flow_offload_destroy(struct list_head *head);
 #endif
 
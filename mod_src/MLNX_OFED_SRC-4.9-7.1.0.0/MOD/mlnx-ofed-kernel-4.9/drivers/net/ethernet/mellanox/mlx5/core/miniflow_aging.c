@@ -56,6 +56,16 @@ struct flow_offload_entry {
 
 static struct flow_offload_table __rcu *_flowtable;
 
+/* Devices whose changed flow counters age the offloaded connections */
+struct flow_offload_dev {
+	struct list_head        list;
+	struct mlx5_core_dev   *mdev;
+	int                     refcnt;
+};
+
+static LIST_HEAD(_flow_offload_devs);
+static DEFINE_MUTEX(_flow_offload_devs_lock);
+
 static void
 flow_offload_fill_dir(struct flow_offload *flow,
 		      struct nf_conn *ct,
@@ -345,21 +355,47 @@ flow_offload_teardown(struct flow_offload_table *flowtable,
 	flow->flags |= FLOW_OFFLOAD_TEARDOWN;
 }
 
-static void nf_flow_offload_gc_step(struct flow_offload *flow, void *data)
+/* Called with the device changed_lock held. The tc flow owning the dummy
+ * counter is alive until the counter is destroyed, the connection entry is
+ * protected by RCU once its lock was published in the flow.
+ */
+static void flow_offload_counter_changed(struct mlx5_fc *counter, void *ctx)
 {
-	struct flow_offload_table *flow_table = data;
-	struct flow_offload_entry *e;
 	unsigned int timeout = offloaded_ct_timeout * HZ;
+	struct mlx5e_tc_flow *tc_flow;
+	struct flow_offload_entry *e;
+	spinlock_t *dep_lock;
 	u64 lastuse;
 
-	e = container_of(flow, struct flow_offload_entry, flow);
+	tc_flow = mlx5_fc_dummy_owner(counter);
+	if (!tc_flow)
+		return;
 
-	spin_lock(&e->dep_lock);
-	ct_flow_offload_get_stats(&e->deps, &lastuse);
-	spin_unlock(&e->dep_lock);
+	rcu_read_lock();
+	dep_lock = READ_ONCE(tc_flow->dep_lock);
+	if (dep_lock) {
+		e = container_of(dep_lock, struct flow_offload_entry, dep_lock);
+		lastuse = mlx5_fc_query_lastuse(counter);
+		if (e->flow.timeout < (lastuse + timeout))
+			e->flow.timeout = lastuse + timeout;
+	}
+	rcu_read_unlock();
+}
+
+static void flow_offload_update_timeouts(void)
+{
+	struct flow_offload_dev *dev;
 
-	if (flow->timeout < (lastuse + timeout))
-		flow->timeout = lastuse + timeout;
+	mutex_lock(&_flow_offload_devs_lock);
+	list_for_each_entry(dev, &_flow_offload_devs, list)
+		mlx5_fc_query_changed(dev->mdev, flow_offload_counter_changed,
+				      NULL);
+	mutex_unlock(&_flow_offload_devs_lock);
+}
+
+static void nf_flow_offload_gc_step(struct flow_offload *flow, void *data)
+{
+	struct flow_offload_table *flow_table = data;
 
 	if (nf_flow_has_expired(flow) ||
 	    (flow->flags & (FLOW_OFFLOAD_DYING | FLOW_OFFLOAD_TEARDOWN)))
@@ -372,6 +408,7 @@ static void flow_offload_work_gc(struct work_struct *gc_work)
 
 	flow_table = container_of(gc_work, struct flow_offload_table,
 				  gc_work.work);
+	flow_offload_update_timeouts();
 	flow_offload_table_iterate(flow_table, nf_flow_offload_gc_step,
 				   flow_table);
 	queue_delayed_work(flow_table->flow_wq, &flow_table->gc_work, HZ);
@@ -536,7 +573,7 @@ int mlx5_ct_flow_offload_add(const struct net *net,
 		err = -EAGAIN;
 		goto err_flow;
 	}
-	tc_flow->dep_lock = &entry->dep_lock;
+	WRITE_ONCE(tc_flow->dep_lock, &entry->dep_lock);
 	ct_flow_offload_add(tc_flow, &entry->deps);
 	spin_unlock(&entry->dep_lock);
 
@@ -585,6 +622,49 @@ void mlx5_ct_flow_offload_table_destroy(void)
 	}
 }
 
+int mlx5_ct_flow_offload_dev_register(struct mlx5_core_dev *mdev)
+{
+	struct flow_offload_dev *dev;
+	int err = 0;
+
+	mutex_lock(&_flow_offload_devs_lock);
+	list_for_each_entry(dev, &_flow_offload_devs, list) {
+		if (dev->mdev == mdev) {
+			dev->refcnt++;
+			goto out;
+		}
+	}
+
+	dev = kzalloc(sizeof(*dev), GFP_KERNEL);
+	if (!dev) {
+		err = -ENOMEM;
+		goto out;
+	}
+	dev->mdev = mdev;
+	dev->refcnt = 1;
+	list_add(&dev->list, &_flow_offload_devs);
+out:
+	mutex_unlock(&_flow_offload_devs_lock);
+	return err;
+}
+
+void mlx5_ct_flow_offload_dev_unregister(struct mlx5_core_dev *mdev)
+{
+	struct flow_offload_dev *dev;
+
+	mutex_lock(&_flow_offload_devs_lock);
+	list_for_each_entry(dev, &_flow_offload_devs, list) {
+		if (dev->mdev != mdev)
+			continue;
+		if (!--dev->refcnt) {
+			list_del(&dev->list);
+			kfree(dev);
+		}
+		break;
+	}
+	mutex_unlock(&_flow_offload_devs_lock);
+}
+
 int mlx5_ct_flow_offloaded_count(void)
 {
 	return atomic_read(&offloaded_flow_cnt);
@@ -251,6 +251,10 @@ void mlx5_destroy_vf_group_sysfs(struct mlx5_core_dev *dev,
 int mlx5_core_disable_hca(struct mlx5_core_dev *dev, u16 func_id);
 int mlx5_core_enable_sf_hca(struct mlx5_core_dev *dev, u16 sf_func_id);
 int mlx5_core_disable_sf_hca(struct mlx5_core_dev *dev, u16 sf_func_id);
+int mlx5_core_enable_hca_batch(struct mlx5_core_dev *dev, const u16 *func_ids,
+			       int *errs, int num);
+int mlx5_core_disable_hca_batch(struct mlx5_core_dev *dev, const u16 *func_ids,
+				int *errs, int num);
 int mlx5_create_scheduling_element_cmd(struct mlx5_core_dev *dev, u8 hierarchy,
 				       void *context, u32 *element_id);
 int mlx5_modify_scheduling_element_cmd(struct mlx5_core_dev *dev, u8 hierarchy,
@@ -53,14 +53,36 @@ struct mlx5_pages_req {
 	struct work_struct work;
 };
 
+enum {
+	MLX5_FW_CHUNK_SHIFT		= 21,
+	MLX5_FW_CHUNK_SIZE		= 1 << MLX5_FW_CHUNK_SHIFT,
+	MLX5_FW_CHUNK_ORDER		= MLX5_FW_CHUNK_SHIFT - PAGE_SHIFT,
+	MLX5_NUM_4K_IN_CHUNK		= MLX5_FW_CHUNK_SIZE / MLX5_ADAPTER_PAGE_SIZE,
+};
+
+/* A system page (order 0, tracked in page_root) or a 2M chunk (order
+ * MLX5_FW_CHUNK_ORDER, indexed in page_chunks by its chunk number) that is
+ * carved into 4K firmware pages. The free 4K pages of a system page fit in
+ * page_mask; only chunks allocate a bitmap of their own.
+ */
 struct fw_page {
 	struct rb_node		rb_node;
 	u64			addr;
 	struct page	       *page;
 	u16			func_id;
-	unsigned long		bitmask;
+	unsigned long	       *bitmask;
+	unsigned long		page_mask;
 	struct list_head	list;
 	unsigned		free_count;
+	unsigned		order;
+};
+
+/* Pages of one function that still have free 4K pages, indexed in
+ * free_lists by func_id so that alloc_4k() never walks the pages of other
+ * functions.
+ */
+struct fw_free_list {
+	struct list_head	pages;
 };
 
 enum {
@@ -74,14 +96,87 @@ enum {
 	MLX5_NUM_4K_IN_PAGE		= PAGE_SIZE / MLX5_ADAPTER_PAGE_SIZE,
 };
 
+static unsigned int fw_page_num_4k(struct fw_page *fp)
+{
+	return MLX5_NUM_4K_IN_PAGE << fp->order;
+}
+
+static struct list_head *get_free_list(struct mlx5_core_dev *dev, u16 func_id)
+{
+	struct fw_free_list *fl;
+	int err;
+
+	fl = radix_tree_lookup(&dev->priv.free_lists, func_id);
+	if (fl)
+		return &fl->pages;
+
+	fl = kzalloc(sizeof(*fl), GFP_KERNEL);
+	if (!fl)
+		return NULL;
+
+	INIT_LIST_HEAD(&fl->pages);
+	err = radix_tree_insert(&dev->priv.free_lists, func_id, fl);
+	if (err) {
+		kfree(fl);
+		return NULL;
+	}
+
+	return &fl->pages;
+}
+
+static int insert_chunk(struct mlx5_core_dev *dev, u64 addr, struct page *page,
+			u16 func_id)
+{
+	struct list_head *free_list;
+	struct fw_page *nfp;
+	int err = -ENOMEM;
+
+	free_list = get_free_list(dev, func_id);
+	if (!free_list)
+		return -ENOMEM;
+
+	nfp = kzalloc(sizeof(*nfp), GFP_KERNEL);
+	if (!nfp)
+		return -ENOMEM;
+
+	nfp->bitmask = bitmap_alloc(MLX5_NUM_4K_IN_CHUNK, GFP_KERNEL);
+	if (!nfp->bitmask)
+		goto err_free;
+
+	nfp->addr = addr;
+	nfp->page = page;
+	nfp->func_id = func_id;
+	nfp->order = MLX5_FW_CHUNK_ORDER;
+	nfp->free_count = MLX5_NUM_4K_IN_CHUNK;
+	bitmap_fill(nfp->bitmask, MLX5_NUM_4K_IN_CHUNK);
+
+	err = radix_tree_insert(&dev->priv.page_chunks,
+				addr >> MLX5_FW_CHUNK_SHIFT, nfp);
+	if (err)
+		goto err_bitmap;
+	list_add(&nfp->list, free_list);
+
+	return 0;
+
+err_bitmap:
+	bitmap_free(nfp->bitmask);
+err_free:
+	kfree(nfp);
+	return err;
+}
+
 static int insert_page(struct mlx5_core_dev *dev, u64 addr, struct page *page, u16 func_id)
 {
 	struct rb_root *root = &dev->priv.page_root;
 	struct rb_node **new = &root->rb_node;
 	struct rb_node *parent = NULL;
+	struct list_head *free_list;
 	struct fw_page *nfp;
 	struct fw_page *tfp;
-	int i;
+
+	free_list = get_free_list(dev, func_id);
+	if (!free_list)
+		return -ENOMEM;
 
 	while (*new) {
 		parent = *new;
@@ -102,16 +197,18 @@ static int insert_page(struct mlx5_core_dev *dev, u64 addr, struct page *page, u
 	nfp->page = page;
 	nfp->func_id = func_id;
 	nfp->free_count = MLX5_NUM_4K_IN_PAGE;
-	for (i = 0; i < MLX5_NUM_4K_IN_PAGE; i++)
-		set_bit(i, &nfp->bitmask);
+	nfp->bitmask = &nfp->page_mask;
+	bitmap_fill(nfp->bitmask, MLX5_NUM_4K_IN_PAGE);
 
 	rb_link_node(&nfp->rb_node, parent, new);
 	rb_insert_color(&nfp->rb_node, root);
-	list_add(&nfp->list, &dev->priv.free_list);
+	list_add(&nfp->list, free_list);
 
 	return 0;
 }
 
+#define MLX5_U64_4K_PAGE_MASK ((~(u64)0U) << PAGE_SHIFT)
+
 static struct fw_page *find_fw_page(struct mlx5_core_dev *dev, u64 addr)
 {
 	struct rb_root *root = &dev->priv.page_root;
@@ -119,6 +216,13 @@ static struct fw_page *find_fw_page(struct mlx5_core_dev *dev, u64 addr)
 	struct fw_page *result = NULL;
 	struct fw_page *tfp;
 
+	/* chunks are chunk aligned, so the chunk number indexes them directly */
+	tfp = radix_tree_lookup(&dev->priv.page_chunks,
+				addr >> MLX5_FW_CHUNK_SHIFT);
+	if (tfp)
+		return tfp;
+
+	addr &= MLX5_U64_4K_PAGE_MASK;
 	while (tmp) {
 		tfp = rb_entry(tmp, struct fw_page, rb_node);
 		if (tfp->addr < addr) {
@@ -157,56 +261,144 @@ static int mlx5_cmd_query_pages(struct mlx5_core_dev *dev, u16 *func_id,
 	return err;
 }
 
-static int alloc_4k(struct mlx5_core_dev *dev, u64 *addr)
+/* Take up to @npages free 4K pages of the first free page owned by
+ * @func_id and write them to the pas array of @in from index @first on.
+ * Returns the number of pages taken. A page or chunk only ever serves the
+ * function it was allocated for, so reclaim and the forced reclaim on
+ * internal error can account it by its func_id.
+ */
+static int alloc_4k(struct mlx5_core_dev *dev, u32 *in, int first, int npages,
+		    u16 func_id)
 {
+	struct fw_free_list *fl;
 	struct fw_page *fp;
+	unsigned int num_4k;
 	unsigned n;
+	int i = 0;
 
-	if (list_empty(&dev->priv.free_list))
+	fl = radix_tree_lookup(&dev->priv.free_lists, func_id);
+	if (!fl || list_empty(&fl->pages))
 		return -ENOMEM;
 
-	fp = list_entry(dev->priv.free_list.next, struct fw_page, list);
-	n = find_first_bit(&fp->bitmask, 8 * sizeof(fp->bitmask));
-	if (n >= MLX5_NUM_4K_IN_PAGE) {
-		mlx5_core_warn(dev, "alloc 4k bug: fw page = 0x%llx, n = %u, bitmask: %lu, max num of 4K pages: %d\n",
-			       fp->addr, n, fp->bitmask,  MLX5_NUM_4K_IN_PAGE);
+	fp = list_first_entry(&fl->pages, struct fw_page, list);
+
+	num_4k = fw_page_num_4k(fp);
+	for_each_set_bit(n, fp->bitmask, num_4k) {
+		if (i == npages)
+			break;
+		clear_bit(n, fp->bitmask);
+		MLX5_ARRAY_SET64(manage_pages_in, in, pas, first + i,
+				 fp->addr + n * MLX5_ADAPTER_PAGE_SIZE);
+		i++;
+	}
+	if (!i) {
+		mlx5_core_warn(dev, "alloc 4k bug: fw page = 0x%llx, free count %u, max num of 4K pages: %u\n",
+			       fp->addr, fp->free_count, num_4k);
 		return -ENOENT;
 	}
-	clear_bit(n, &fp->bitmask);
-	fp->free_count--;
+	fp->free_count -= i;
 	if (!fp->free_count)
 		list_del(&fp->list);
 
-	*addr = fp->addr + n * MLX5_ADAPTER_PAGE_SIZE;
-
-	return 0;
+	return i;
 }
 
-#define MLX5_U64_4K_PAGE_MASK ((~(u64)0U) << PAGE_SHIFT)
-
 static int free_4k(struct mlx5_core_dev *dev, u64 addr)
 {
 	struct fw_page *fwp;
 	int n;
 
-	fwp = find_fw_page(dev, addr & MLX5_U64_4K_PAGE_MASK);
+	fwp = find_fw_page(dev, addr);
 	if (!fwp) {
 		mlx5_core_warn(dev, "page not found\n");
 		return -ENOMEM;
 	}
 
-	n = (addr & ~MLX5_U64_4K_PAGE_MASK) >> MLX5_ADAPTER_PAGE_SHIFT;
-	if (test_bit(n, &fwp->bitmask)) {
+	n = (addr - fwp->addr) >> MLX5_ADAPTER_PAGE_SHIFT;
+	if (test_bit(n, fwp->bitmask)) {
 		mlx5_core_warn(dev, "addr 0x%llx is already freed, n %d\n", addr, n);
 		return -EINVAL;
 	}
 
 	fwp->free_count++;
-	set_bit(n, &fwp->bitmask);
-	if (fwp->free_count == 1)
-		list_add(&fwp->list, &dev->priv.free_list);
+	set_bit(n, fwp->bitmask);
+	if (fwp->free_count == 1) {
+		struct fw_free_list *fl;
+
+		/* created when the page was inserted, never freed before cleanup */
+		fl = radix_tree_lookup(&dev->priv.free_lists, fwp->func_id);
+		list_add(&fwp->list, &fl->pages);
+	}
+
+	return 0;
+}
+
+static void free_fw_page(struct mlx5_core_dev *dev, struct fw_page *fwp)
+{
+	if (fwp->order)
+		radix_tree_delete(&dev->priv.page_chunks,
+				  fwp->addr >> MLX5_FW_CHUNK_SHIFT);
+	else
+		rb_erase(&fwp->rb_node, &dev->priv.page_root);
+	dma_unmap_page(dev->device, fwp->addr, PAGE_SIZE << fwp->order,
+		       DMA_BIDIRECTIONAL);
+	__free_pages(fwp->page, fwp->order);
+	if (fwp->bitmask != &fwp->page_mask)
+		bitmap_free(fwp->bitmask);
+	kfree(fwp);
+}
+
+/* Map a 2M chunk that serves MLX5_NUM_4K_IN_CHUNK firmware pages. Chunks
+ * are only used while the DMA mapping keeps them chunk aligned, which is
+ * what makes the chunk number a usable index on reclaim.
+ */
+static int alloc_system_chunk(struct mlx5_core_dev *dev, u16 func_id)
+{
+	struct device *device = dev->device;
+	int nid = dev_to_node(device);
+	struct page *page;
+	u64 addr;
+	int err;
+
+	if (dev->priv.page_chunks_disabled)
+		return -EOPNOTSUPP;
+
+	page = alloc_pages_node(nid, GFP_HIGHUSER | __GFP_NOWARN |
+				__GFP_NORETRY, MLX5_FW_CHUNK_ORDER);
+	if (!page)
+		return -ENOMEM;
+
+	addr = dma_map_page(device, page, 0, MLX5_FW_CHUNK_SIZE,
+			    DMA_BIDIRECTIONAL);
+	if (dma_mapping_error(device, addr)) {
+		err = -ENOMEM;
+		goto err_free;
+	}
+
+	/* Firmware doesn't support page with physical address 0 */
+	if (!addr || addr & (MLX5_FW_CHUNK_SIZE - 1)) {
+		if (addr) {
+			mlx5_core_info(dev, "unaligned DMA mapping, using %lu byte firmware pages\n",
+				       PAGE_SIZE);
+			dev->priv.page_chunks_disabled = true;
+		}
+		err = -EOPNOTSUPP;
+		goto err_unmap;
+	}
+
+	err = insert_chunk(dev, addr, page, func_id);
+	if (err) {
+		mlx5_core_err(dev, "failed to track allocated chunk\n");
+		goto err_unmap;
+	}
 
 	return 0;
+
+err_unmap:
+	dma_unmap_page(device, addr, MLX5_FW_CHUNK_SIZE, DMA_BIDIRECTIONAL);
+err_free:
+	__free_pages(page, MLX5_FW_CHUNK_ORDER);
+	return err;
 }
 
 static int alloc_system_page(struct mlx5_core_dev *dev, u16 func_id)
@@ -281,10 +473,10 @@ static int give_pages(struct mlx5_core_dev *dev, u16 func_id, int npages,
 	unsigned long max_duration = jiffies + msecs_to_jiffies(MLX5_CMD_TIMEOUT_MSEC / 2);
 	u32 out[MLX5_ST_SZ_DW(manage_pages_out)] = {0};
 	int inlen = MLX5_ST_SZ_BYTES(manage_pages_in);
-	u64 addr;
 	int err;
 	u32 *in;
 	int i;
+	int n;
 
 	inlen += npages * MLX5_FLD_SZ_BYTES(manage_pages_in, pas[0]);
 	in = kvzalloc(inlen, GFP_KERNEL);
@@ -294,7 +486,7 @@ static int give_pages(struct mlx5_core_dev *dev, u16 func_id, int npages,
 		goto out_free;
 	}
 
-	for (i = 0; i < npages; i++) {
+	for (i = 0; i < npages; i += n) {
 		if (time_after(jiffies, max_duration)) {
 			mlx5_core_warn(dev,
 				       "%d pages alloc time exceeded the max permitted duration\n",
@@ -302,17 +494,18 @@ static int give_pages(struct mlx5_core_dev *dev, u16 func_id, int npages,
 			err = -ENOMEM;
 			goto out_4k;
 		}
-retry:
-		err = alloc_4k(dev, &addr);
-		if (err) {
-			if (err == -ENOMEM)
+		n = alloc_4k(dev, in, i, npages - i, func_id);
+		if (n < 0) {
+			err = n;
+			n = 0;
+			/* small requests are not worth pinning a whole chunk */
+			if (err == -ENOMEM &&
+			    (npages - i < MLX5_NUM_4K_IN_CHUNK / 2 ||
+			     alloc_system_chunk(dev, func_id)))
 				err = alloc_system_page(dev, func_id);
 			if (err)
 				goto out_4k;
-
-			goto retry;
 		}
-		MLX5_ARRAY_SET64(manage_pages_in, in, pas, i, addr);
 	}
 
 	MLX5_SET(manage_pages_in, in, opcode, MLX5_CMD_OP_MANAGE_PAGES);
@@ -352,31 +545,65 @@ out_free:
 
 static void free_pages_list(struct mlx5_core_dev *dev)
 {
+	struct radix_tree_iter iter;
+	struct fw_free_list *fl;
 	struct fw_page *tmp;
 	struct fw_page *fp;
+	void **slot;
 
-	list_for_each_entry_safe(fp, tmp, &dev->priv.free_list, list) {
-		/* In case of shared page that is in use leave it in the list */
-		if (fp->free_count != MLX5_NUM_4K_IN_PAGE)
-			continue;
+	radix_tree_for_each_slot(slot, &dev->priv.free_lists, &iter, 0) {
+		fl = radix_tree_deref_slot(slot);
+		list_for_each_entry_safe(fp, tmp, &fl->pages, list) {
+			/* In case of shared page that is in use leave it in the list */
+			if (fp->free_count != fw_page_num_4k(fp))
+				continue;
 
-		list_del(&fp->list);
-		rb_erase(&fp->rb_node, &dev->priv.page_root);
-		dma_unmap_page(&dev->pdev->dev, fp->addr & MLX5_U64_4K_PAGE_MASK,
-			       PAGE_SIZE, DMA_BIDIRECTIONAL);
-		__free_page(fp->page);
-		kfree(fp);
+			list_del(&fp->list);
+			free_fw_page(dev, fp);
+		}
 	}
 }
 
+static struct fw_page *first_fw_page(struct mlx5_core_dev *dev)
+{
+	struct fw_page *fwp;
+	struct rb_node *p;
+
+	if (radix_tree_gang_lookup(&dev->priv.page_chunks, (void **)&fwp, 0, 1))
+		return fwp;
+
+	p = rb_first(&dev->priv.page_root);
+	return p ? rb_entry(p, struct fw_page, rb_node) : NULL;
+}
+
+/* Report the 4K pages of @fwp that firmware holds for @func_id */
+static u32 fake_reclaim_fw_page(struct fw_page *fwp, u32 func_id, u32 *out,
+				u32 i, u32 npages)
+{
+	unsigned int num_4k = fw_page_num_4k(fwp);
+	unsigned int j;
+
+	if (fwp->func_id != func_id)
+		return i;
+
+	for (j = find_first_zero_bit(fwp->bitmask, num_4k);
+	     j < num_4k && i < npages;
+	     j = find_next_zero_bit(fwp->bitmask, num_4k, j + 1))
+		MLX5_ARRAY_SET64(manage_pages_out, out, pas, i++,
+				 fwp->addr + (j << MLX5_ADAPTER_PAGE_SHIFT));
+	return i;
+}
+
 static int reclaim_pages_cmd(struct mlx5_core_dev *dev,
 			     u32 *in, int in_size, u32 *out, int out_size)
 {
+	struct radix_tree_iter iter;
 	struct fw_page *fwp;
 	struct rb_node *p;
+	void **slot;
 	u32 func_id;
 	u32 npages;
-	u32 i = 0, j;
+	u32 i = 0;
 
 	if (dev->state != MLX5_DEVICE_STATE_INTERNAL_ERROR)
 		return mlx5_cmd_exec(dev, in, in_size, out, out_size);
@@ -385,21 +612,18 @@ static int reclaim_pages_cmd(struct mlx5_core_dev *dev,
 	npages = MLX5_GET(manage_pages_in, in, input_num_entries);
 	func_id = MLX5_GET(manage_pages_in, in, function_id);
 
+	radix_tree_for_each_slot(slot, &dev->priv.page_chunks, &iter, 0) {
+		if (i >= npages)
+			break;
+		fwp = radix_tree_deref_slot(slot);
+		i = fake_reclaim_fw_page(fwp, func_id, out, i, npages);
+	}
+
 	p = rb_first(&dev->priv.page_root);
 	while (p && i < npages) {
-		j = 0;
 		fwp = rb_entry(p, struct fw_page, rb_node);
 		p = rb_next(p);
-		if (fwp->func_id != func_id)
-			continue;
-
-		j = find_next_zero_bit(&fwp->bitmask, MLX5_NUM_4K_IN_PAGE, j);
-		if (j >= MLX5_NUM_4K_IN_PAGE)
-			continue;
-
-		MLX5_ARRAY_SET64(manage_pages_out, out, pas, i,
-				 fwp->addr + (j << MLX5_ADAPTER_PAGE_SHIFT));
-		i++;
+		i = fake_reclaim_fw_page(fwp, func_id, out, i, npages);
 	}
 
 	MLX5_SET(manage_pages_out, out, output_num_entries, i);
@@ -567,6 +791,9 @@ int mlx5_satisfy_startup_pages(struct mlx5_core_dev *dev, int boot)
 
 	return give_pages(dev, func_id, npages, 0, mlx5_core_is_ecpf(dev));
 }
+#if IS_ENABLED(CONFIG_MLX5_FW_EMU_BENCH)
+EXPORT_SYMBOL(mlx5_satisfy_startup_pages);
+#endif
 
 enum {
 	MLX5_BLKS_FOR_RECLAIM_PAGES = 12
@@ -589,14 +816,12 @@ int mlx5_reclaim_startup_pages(struct mlx5_core_dev *dev)
 {
 	unsigned long end = jiffies + msecs_to_jiffies(MAX_RECLAIM_TIME_MSECS);
 	struct fw_page *fwp;
-	struct rb_node *p;
 	int nclaimed = 0;
 	int err = 0;
 
 	while (dev->priv.fw_pages) {
-		p = rb_first(&dev->priv.page_root);
-		if (p) {
-			fwp = rb_entry(p, struct fw_page, rb_node);
+		fwp = first_fw_page(dev);
+		if (fwp) {
 			err = reclaim_pages(dev, fwp->func_id,
 					    optimal_reclaimed_pages(),
 					    &nclaimed, mlx5_core_is_ecpf(dev));
@@ -634,13 +859,18 @@ int mlx5_reclaim_startup_pages(struct mlx5_core_dev *dev)
 
 	return 0;
 }
+#if IS_ENABLED(CONFIG_MLX5_FW_EMU_BENCH)
+EXPORT_SYMBOL(mlx5_reclaim_startup_pages);
+#endif
 
 int mlx5_pagealloc_init(struct mlx5_core_dev *dev)
 {
 	struct mlx5_priv *priv = &dev->priv;
 
 	priv->page_root = RB_ROOT;
-	INIT_LIST_HEAD(&priv->free_list);
+	INIT_RADIX_TREE(&priv->page_chunks, GFP_KERNEL);
+	priv->page_chunks_disabled = false;
+	INIT_RADIX_TREE(&priv->free_lists, GFP_KERNEL);
 	INIT_DELAYED_WORK(&priv->gc_dwork, gc_work_handler);
 	priv->gc_allowed = true;
 	dev->priv.pg_wq = create_singlethread_workqueue("mlx5_page_allocator");
@@ -649,38 +879,37 @@ int mlx5_pagealloc_init(struct mlx5_core_dev *dev)
 
 	return 0;
 }
+#if IS_ENABLED(CONFIG_MLX5_FW_EMU_BENCH)
+EXPORT_SYMBOL(mlx5_pagealloc_init);
+#endif
 
 void mlx5_pagealloc_cleanup(struct mlx5_core_dev *dev)
 {
-	struct mlx5_priv *priv = &dev->priv;
+	struct radix_tree_iter iter;
+	struct fw_free_list *fl;
 	struct fw_page *fwp;
 	struct fw_page *tmp;
-	struct rb_node *p;
+	void **slot;
 
 	/* Remove the free list pages */
-	list_for_each_entry_safe(fwp, tmp, &dev->priv.free_list, list) {
-		list_del(&fwp->list);
-		rb_erase(&fwp->rb_node, &priv->page_root);
-		dma_unmap_page(&dev->pdev->dev, fwp->addr & MLX5_U64_4K_PAGE_MASK,
-			       PAGE_SIZE, DMA_BIDIRECTIONAL);
-		__free_page(fwp->page);
-		kfree(fwp);
+	radix_tree_for_each_slot(slot, &dev->priv.free_lists, &iter, 0) {
+		fl = radix_tree_deref_slot(slot);
+		list_for_each_entry_safe(fwp, tmp, &fl->pages, list) {
+			list_del(&fwp->list);
+			free_fw_page(dev, fwp);
+		}
+		radix_tree_delete(&dev->priv.free_lists, iter.index);
+		kfree(fl);
 	}
 
 	/* In case the FW didn't return all the pages free it by force */
-	do {
-		p = rb_first(&priv->page_root);
-		if (p) {
-			fwp = rb_entry(p, struct fw_page, rb_node);
-			rb_erase(&fwp->rb_node, &priv->page_root);
-			dma_unmap_page(&dev->pdev->dev, fwp->addr & MLX5_U64_4K_PAGE_MASK,
-				       PAGE_SIZE, DMA_BIDIRECTIONAL);
-			__free_page(fwp->page);
-			kfree(fwp);
-		}
-	} while (p);
+	while ((fwp = first_fw_page(dev)))
+		free_fw_page(dev, fwp);
 	destroy_workqueue(dev->priv.pg_wq);
 }
+#if IS_ENABLED(CONFIG_MLX5_FW_EMU_BENCH)
+EXPORT_SYMBOL(mlx5_pagealloc_cleanup);
+#endif
 
 void mlx5_pagealloc_start(struct mlx5_core_dev *dev)
 {
@@ -73,6 +73,8 @@ static int mlx5_device_enable_sriov(struct mlx5_core_dev *dev, int num_vfs)
 {
 	struct mlx5_core_sriov *sriov = &dev->priv.sriov;
 	struct mlx5_lag *ldev;
+	u16 *func_ids;
+	int *errs;
 	int err;
 	int vf;
 
@@ -98,9 +100,26 @@ enable_vfs_hca:
 		return err;
 	}
 
+	func_ids = kvcalloc(num_vfs, sizeof(*func_ids), GFP_KERNEL);
+	errs = kvcalloc(num_vfs, sizeof(*errs), GFP_KERNEL);
+	if (!func_ids || !errs) {
+		kvfree(errs);
+		kvfree(func_ids);
+		mlx5_destroy_vfs_sysfs(dev, num_vfs);
+#ifdef CONFIG_MLX5_CORE_EN
+		if (MLX5_ESWITCH_MANAGER(dev))
+			mlx5_eswitch_disable(dev->priv.eswitch, true);
+#endif
+		return -ENOMEM;
+	}
+	for (vf = 0; vf < num_vfs; vf++)
+		func_ids[vf] = vf + 1;
+
 	ldev = mlx5_lag_disable(dev);
+	/* VFs are independent, enable all of them in one batch */
+	mlx5_core_enable_hca_batch(dev, func_ids, errs, num_vfs);
 	for (vf = 0; vf < num_vfs; vf++) {
-		err = mlx5_core_enable_hca(dev, vf + 1);
+		err = errs[vf];
 		if (err) {
 			mlx5_core_warn(dev, "failed to enable VF %d (%d)\n", vf, err);
 			continue;
@@ -118,6 +137,8 @@ enable_vfs_hca:
 		mlx5_core_dbg(dev, "successfully enabled VF* %d\n", vf);
 	}
 	mlx5_lag_enable(dev, ldev);
+	kvfree(errs);
+	kvfree(func_ids);
 
 	return 0;
 }
@@ -125,19 +146,41 @@ enable_vfs_hca:
 static void mlx5_device_disable_sriov(struct mlx5_core_dev *dev, int num_vfs, bool clear_vf)
 {
 	struct mlx5_core_sriov *sriov = &dev->priv.sriov;
+	u16 *func_ids;
+	int *errs;
+	int num = 0;
 	int err;
 	int vf;
 
-	for (vf = num_vfs - 1; vf >= 0; vf--) {
-		if (!sriov->vfs_ctx[vf].enabled)
-			continue;
-		err = mlx5_core_disable_hca(dev, vf + 1);
-		if (err) {
-			mlx5_core_warn(dev, "failed to disable VF %d\n", vf);
-			continue;
+	func_ids = kvcalloc(num_vfs, sizeof(*func_ids), GFP_KERNEL);
+	errs = kvcalloc(num_vfs, sizeof(*errs), GFP_KERNEL);
+	if (func_ids && errs) {
+		for (vf = num_vfs - 1; vf >= 0; vf--)
+			if (sriov->vfs_ctx[vf].enabled)
+				func_ids[num++] = vf + 1;
+		mlx5_core_disable_hca_batch(dev, func_ids, errs, num);
+		for (vf = 0; vf < num; vf++) {
+			if (errs[vf]) {
+				mlx5_core_warn(dev, "failed to disable VF %d\n",
+					       func_ids[vf] - 1);
+				continue;
+			}
+			sriov->vfs_ctx[func_ids[vf] - 1].enabled = 0;
+		}
+	} else {
+		for (vf = num_vfs - 1; vf >= 0; vf--) {
+			if (!sriov->vfs_ctx[vf].enabled)
+				continue;
+			err = mlx5_core_disable_hca(dev, vf + 1);
+			if (err) {
+				mlx5_core_warn(dev, "failed to disable VF %d\n", vf);
+				continue;
+			}
+			sriov->vfs_ctx[vf].enabled = 0;
 		}
-		sriov->vfs_ctx[vf].enabled = 0;
 	}
+	kvfree(errs);
+	kvfree(func_ids);
 
 	if (MLX5_ESWITCH_MANAGER(dev)) {
 		struct mlx5_lag *ldev;
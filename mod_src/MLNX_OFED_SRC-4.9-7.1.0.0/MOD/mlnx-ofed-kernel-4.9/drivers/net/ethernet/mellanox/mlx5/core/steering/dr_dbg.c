@@ -2,6 +2,8 @@
 /* Copyright (c) 2020 Mellanox Technologies. */
 
 #include <linux/proc_fs.h>
+#include <linux/debugfs.h>
+#include <linux/kthread.h>
 #include "dr_types.h"
 
 #define PACKAGE_VERSION "1.0.3"
@@ -76,6 +78,7 @@ enum dr_dump_rec_type {
 	DR_DUMP_REC_TYPE_DOMAIN_INFO_VPORT = 3003,
 	DR_DUMP_REC_TYPE_DOMAIN_INFO_CAPS = 3004,
 	DR_DUMP_REC_TYPE_DOMAIN_SEND_RING = 3005,
+	DR_DUMP_REC_TYPE_DOMAIN_LATENCY_HIST = 3006,
 
 	DR_DUMP_REC_TYPE_TABLE = 3100,
 	DR_DUMP_REC_TYPE_TABLE_RX = 3101,
@@ -678,6 +681,29 @@ dr_dump_send_ring(struct dr_dump_ctx *ctx, struct mlx5dr_send_ring *ring,
 	return 0;
 }
 
+static int
+dr_dump_latency_hist(struct dr_dump_ctx *ctx, const char *name,
+		     struct mlx5dr_latency_hist *hist, const u64 domain_id)
+{
+	char tmp_buf[BUF_SIZE] = {};
+	int len, i, ret;
+
+	len = snprintf(tmp_buf, BUF_SIZE, "%d,0x%llx,%s",
+		       DR_DUMP_REC_TYPE_DOMAIN_LATENCY_HIST,
+		       domain_id,
+		       name);
+	for (i = 0; i < DR_LATENCY_HIST_BUCKETS; i++)
+		len += snprintf(tmp_buf + len, BUF_SIZE - len, ",%lld",
+				(s64)atomic64_read(&hist->bucket[i]));
+	snprintf(tmp_buf + len, BUF_SIZE - len, "\n");
+
+	ret = dr_copy_to_dump_buffer(ctx, tmp_buf);
+	if (ret < 0)
+		return ret;
+
+	return 0;
+}
+
 static int
 dr_dump_domain_info_flex_parser(struct dr_dump_ctx *ctx,
 				const char *flex_parser_name,
@@ -806,6 +832,16 @@ static int dr_dump_domain(struct dr_dump_ctx *ctx)
 			return ret;
 	}
 
+	ret = dr_dump_latency_hist(ctx, "rule_insert", &dmn->insert_hist,
+				   domain_id);
+	if (ret < 0)
+		return ret;
+
+	ret = dr_dump_latency_hist(ctx, "rehash_step", &dmn->rehash_hist,
+				   domain_id);
+	if (ret < 0)
+		return ret;
+
 	return 0;
 }
 
@@ -969,3 +1005,466 @@ void mlx5dr_dbg_cleanup_dump(struct mlx5dr_domain *dmn)
 	if (mlx5_smfs_fdb_dump_dir)
 		remove_proc_entry(pci_name(dmn->mdev->pdev), mlx5_smfs_fdb_dump_dir);
 }
+
+/* Rule insertion benchmark, run by writing "<num_rules> [batch_size]" to
+ * the smfs_rule_bench debugfs file of the device. It builds a private
+ * NIC RX table matching on the outer dmac and reports the rules/second
+ * of mlx5dr_rule_create() and of the batched rule queue.
+ *
+ * The device must own its NIC RX steering in software (rx_sw_owner).
+ * The firmware emulator has no SW ICM, no send ring QP and no
+ * SYNC_STEERING, so the emulated device of mlx5_fw_emu_bench can't run
+ * this. Its rule bench measures the firmware steering path instead.
+ */
+#define DR_BENCH_DEF_BATCH 256
+
+struct dr_bench_ctx {
+	struct mlx5dr_matcher *matcher;
+	struct mlx5dr_action *action;
+	struct mlx5dr_rule **rules;
+	u32 num_rules;
+	u32 batch_size;
+	atomic_t failed;
+};
+
+static void dr_bench_rule_done(struct mlx5dr_rule *rule, int err, void *ctx)
+{
+	struct mlx5dr_rule **slot = ctx;
+
+	*slot = rule;
+}
+
+static void dr_bench_set_dmac(u64 *match_buf, u32 i)
+{
+	void *headers = MLX5_ADDR_OF(fte_match_param, match_buf, outer_headers);
+
+	MLX5_SET(fte_match_set_lyr_2_4, headers, dmac_47_16, 0x02000000);
+	MLX5_SET(fte_match_set_lyr_2_4, headers, dmac_15_0, i & 0xffff);
+	MLX5_SET(fte_match_set_lyr_2_4, headers, smac_47_16, i >> 16);
+}
+
+static u64 dr_bench_rate(u32 num, ktime_t start)
+{
+	u64 ns = ktime_to_ns(ktime_sub(ktime_get(), start)) ?: 1;
+
+	return div64_u64((u64)num * NSEC_PER_SEC, ns);
+}
+
+static void dr_bench_sync(struct dr_bench_ctx *ctx, u64 *match_buf)
+{
+	struct mlx5dr_match_parameters value = {
+		.match_sz = MLX5_ST_SZ_BYTES(fte_match_param),
+		.match_buf = match_buf,
+	};
+	struct mlx5_core_dev *mdev = ctx->matcher->tbl->dmn->mdev;
+	ktime_t start;
+	u32 i, num;
+
+	start = ktime_get();
+	for (i = 0; i < ctx->num_rules; i++) {
+		dr_bench_set_dmac(match_buf, i);
+		ctx->rules[i] = mlx5dr_rule_create(ctx->matcher, &value, 1,
+						   &ctx->action);
+		if (!ctx->rules[i])
+			break;
+	}
+	mlx5_core_info(mdev, "smfs bench: sync insert %u rules, %llu rules/s\n",
+		       i, dr_bench_rate(i, start));
+
+	num = i;
+	start = ktime_get();
+	while (i--)
+		mlx5dr_rule_destroy(ctx->rules[i]);
+	mlx5_core_info(mdev, "smfs bench: sync delete %llu rules/s\n",
+		       dr_bench_rate(num, start));
+}
+
+static int dr_bench_queued(struct dr_bench_ctx *ctx, u64 *match_buf)
+{
+	struct mlx5dr_match_parameters value = {
+		.match_sz = MLX5_ST_SZ_BYTES(fte_match_param),
+		.match_buf = match_buf,
+	};
+	struct mlx5dr_domain *dmn = ctx->matcher->tbl->dmn;
+	struct mlx5dr_rule_queue *queue;
+	u32 inserted = 0;
+	ktime_t start;
+	int err = 0;
+	u32 i;
+
+	queue = mlx5dr_rule_queue_create(dmn, ctx->batch_size);
+	if (!queue)
+		return -ENOMEM;
+
+	memset(ctx->rules, 0, ctx->num_rules * sizeof(*ctx->rules));
+	start = ktime_get();
+	for (i = 0; i < ctx->num_rules && !err; i++) {
+		dr_bench_set_dmac(match_buf, i);
+		err = mlx5dr_rule_queue_create_rule(queue, ctx->matcher, &value,
+						    1, &ctx->action,
+						    dr_bench_rule_done,
+						    &ctx->rules[i]);
+	}
+	mlx5dr_rule_queue_flush(queue);
+	for (i = 0; i < ctx->num_rules; i++)
+		inserted += !!ctx->rules[i];
+	mlx5_core_info(dmn->mdev,
+		       "smfs bench: queued insert %u rules, batch %u, %llu rules/s\n",
+		       inserted, ctx->batch_size, dr_bench_rate(inserted, start));
+
+	start = ktime_get();
+	for (i = 0; i < ctx->num_rules; i++) {
+		if (!ctx->rules[i])
+			continue;
+		if (mlx5dr_rule_queue_destroy_rule(queue, ctx->rules[i],
+						   dr_bench_rule_done,
+						   &ctx->rules[i]))
+			mlx5dr_rule_destroy(ctx->rules[i]);
+	}
+	mlx5dr_rule_queue_flush(queue);
+	mlx5_core_info(dmn->mdev, "smfs bench: queued delete %llu rules/s\n",
+		       dr_bench_rate(inserted, start));
+
+	mlx5dr_rule_queue_destroy(queue);
+	return err;
+}
+
+static int dr_bench_run(struct mlx5_core_dev *mdev, u32 num_rules,
+			u32 batch_size)
+{
+	struct mlx5dr_match_parameters mask = {};
+	struct dr_bench_ctx ctx = {};
+	struct mlx5dr_domain *dmn;
+	struct mlx5dr_table *tbl;
+	u64 *match_buf;
+	void *headers;
+	int err;
+
+	match_buf = kzalloc(MLX5_ST_SZ_BYTES(fte_match_param), GFP_KERNEL);
+	ctx.rules = kvcalloc(num_rules, sizeof(*ctx.rules), GFP_KERNEL);
+	if (!match_buf || !ctx.rules) {
+		err = -ENOMEM;
+		goto free_bufs;
+	}
+	ctx.num_rules = num_rules;
+	ctx.batch_size = batch_size;
+
+	dmn = mlx5dr_domain_create(mdev, MLX5DR_DOMAIN_TYPE_NIC_RX);
+	if (!dmn) {
+		mlx5_core_warn(mdev, "smfs bench: no SW steering NIC RX domain\n");
+		err = -EOPNOTSUPP;
+		goto free_bufs;
+	}
+
+	tbl = mlx5dr_table_create(dmn, 1, 0);
+	if (!tbl) {
+		err = -EINVAL;
+		goto destroy_domain;
+	}
+
+	headers = MLX5_ADDR_OF(fte_match_param, match_buf, outer_headers);
+	MLX5_SET(fte_match_set_lyr_2_4, headers, dmac_47_16, 0xffffffff);
+	MLX5_SET(fte_match_set_lyr_2_4, headers, dmac_15_0, 0xffff);
+	MLX5_SET(fte_match_set_lyr_2_4, headers, smac_47_16, 0xffffffff);
+	mask.match_sz = MLX5_ST_SZ_BYTES(fte_match_param);
+	mask.match_buf = match_buf;
+	ctx.matcher = mlx5dr_matcher_create(tbl, 0,
+					    1 << MLX5_CREATE_FLOW_GROUP_IN_MATCH_CRITERIA_ENABLE_OUTER_HEADERS,
+					    &mask);
+	if (!ctx.matcher) {
+		err = -EINVAL;
+		goto destroy_table;
+	}
+
+	ctx.action = mlx5dr_action_create_drop();
+	if (!ctx.action) {
+		err = -ENOMEM;
+		goto destroy_matcher;
+	}
+
+	memset(match_buf, 0, MLX5_ST_SZ_BYTES(fte_match_param));
+	dr_bench_sync(&ctx, match_buf);
+	err = dr_bench_queued(&ctx, match_buf);
+
+	mlx5dr_action_destroy(ctx.action);
+destroy_matcher:
+	mlx5dr_matcher_destroy(ctx.matcher);
+destroy_table:
+	mlx5dr_table_destroy(tbl);
+destroy_domain:
+	mlx5dr_domain_destroy(dmn);
+free_bufs:
+	kvfree(ctx.rules);
+	kfree(match_buf);
+	return err;
+}
+
+static ssize_t dr_bench_write(struct file *filp, const char __user *buf,
+			      size_t count, loff_t *pos)
+{
+	struct mlx5_core_dev *mdev = filp->private_data;
+	u32 batch_size = DR_BENCH_DEF_BATCH;
+	u32 num_rules;
+	char kbuf[32];
+	int err;
+
+	if (count >= sizeof(kbuf))
+		return -EINVAL;
+	if (copy_from_user(kbuf, buf, count))
+		return -EFAULT;
+	kbuf[count] = '\0';
+
+	if (sscanf(kbuf, "%u %u", &num_rules, &batch_size) < 1 ||
+	    !num_rules || !batch_size)
+		return -EINVAL;
+
+	err = dr_bench_run(mdev, num_rules, batch_size);
+
+	return err ? err : count;
+}
+
+static const struct file_operations dr_bench_fops = {
+	.owner = THIS_MODULE,
+	.open = simple_open,
+	.write = dr_bench_write,
+};
+
+/* ICM allocator stress, run by writing "<num_chunks> [num_threads]" to
+ * the smfs_icm_bench debugfs file of the device. For every STE chunk size
+ * up to DR_BENCH_ICM_MAX_ORDER it allocates and frees num_chunks chunks
+ * twice, with the hot memory reclaimed in between, and reports the
+ * alloc/free rates of the cold and the warm round. With more than one
+ * thread, every thread does so concurrently on its own CPU against the
+ * same pool and the aggregate rates are reported. Like smfs_rule_bench
+ * it needs a device with SW steering, there is no emulated ICM.
+ */
+#define DR_BENCH_ICM_MAX_ORDER DR_CHUNK_SIZE_4K
+#define DR_BENCH_ICM_MAX_THREADS 64
+
+struct dr_bench_icm_thread {
+	struct mlx5dr_icm_pool *pool;
+	enum mlx5dr_icm_chunk_size order;
+	struct mlx5dr_icm_chunk **chunks;
+	struct completion *start;
+	struct completion *done;
+	atomic_t *running;
+	u32 num_chunks;
+	u32 num;
+	u64 alloc_ns;
+	u64 free_ns;
+};
+
+static int dr_bench_icm_thread_fn(void *data)
+{
+	struct dr_bench_icm_thread *t = data;
+	ktime_t start;
+	u32 i;
+
+	wait_for_completion(t->start);
+
+	start = ktime_get();
+	for (i = 0; i < t->num_chunks; i++) {
+		t->chunks[i] = mlx5dr_icm_alloc_chunk(t->pool, t->order);
+		if (!t->chunks[i])
+			break;
+	}
+	t->alloc_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	t->num = i;
+
+	start = ktime_get();
+	while (i--)
+		mlx5dr_icm_free_chunk(t->chunks[i]);
+	t->free_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	if (atomic_dec_and_test(t->running))
+		complete(t->done);
+	return 0;
+}
+
+static int dr_bench_icm_round_mt(struct mlx5dr_domain *dmn,
+				 enum mlx5dr_icm_chunk_size order,
+				 struct mlx5dr_icm_chunk **chunks,
+				 struct dr_bench_icm_thread *threads,
+				 u32 num_threads, u32 num_chunks,
+				 const char *round)
+{
+	u64 alloc_ns = 1, free_ns = 1, num = 0;
+	DECLARE_COMPLETION_ONSTACK(start);
+	DECLARE_COMPLETION_ONSTACK(done);
+	atomic_t running;
+	int err = 0;
+	int cpu = -1;
+	u32 i;
+
+	atomic_set(&running, 1);
+	for (i = 0; i < num_threads; i++) {
+		struct dr_bench_icm_thread *t = &threads[i];
+		struct task_struct *task;
+
+		memset(t, 0, sizeof(*t));
+		t->pool = dmn->ste_icm_pool;
+		t->order = order;
+		t->chunks = &chunks[i * num_chunks];
+		t->num_chunks = num_chunks;
+		t->start = &start;
+		t->done = &done;
+		t->running = &running;
+
+		/* Spread the threads so the per-CPU caches are all in play */
+		cpu = cpumask_next(cpu, cpu_online_mask);
+		if (cpu >= nr_cpu_ids)
+			cpu = cpumask_first(cpu_online_mask);
+
+		task = kthread_create(dr_bench_icm_thread_fn, t,
+				      "mlx5_icm_bench/%u", i);
+		if (IS_ERR(task)) {
+			err = PTR_ERR(task);
+			break;
+		}
+		kthread_bind(task, cpu);
+		atomic_inc(&running);
+		wake_up_process(task);
+	}
+	num_threads = i;
+
+	complete_all(&start);
+	if (!atomic_dec_and_test(&running))
+		wait_for_completion(&done);
+
+	for (i = 0; i < num_threads; i++) {
+		num += threads[i].num;
+		alloc_ns = max(alloc_ns, threads[i].alloc_ns);
+		free_ns = max(free_ns, threads[i].free_ns);
+	}
+
+	mlx5_core_info(dmn->mdev,
+		       "smfs icm bench: order %d %s: %u threads, %llu chunks, alloc %llu/s, free %llu/s\n",
+		       order, round, num_threads, num,
+		       div64_u64(num * NSEC_PER_SEC, alloc_ns),
+		       div64_u64(num * NSEC_PER_SEC, free_ns));
+
+	mlx5dr_icm_pool_sync(dmn->ste_icm_pool);
+	return err;
+}
+
+static void dr_bench_icm_round(struct mlx5dr_domain *dmn,
+			       enum mlx5dr_icm_chunk_size order,
+			       struct mlx5dr_icm_chunk **chunks,
+			       u32 num_chunks, const char *round)
+{
+	struct mlx5dr_icm_pool *pool = dmn->ste_icm_pool;
+	ktime_t start;
+	u64 alloc_rate;
+	u32 i, num;
+
+	start = ktime_get();
+	for (i = 0; i < num_chunks; i++) {
+		chunks[i] = mlx5dr_icm_alloc_chunk(pool, order);
+		if (!chunks[i])
+			break;
+	}
+	alloc_rate = dr_bench_rate(i, start);
+
+	num = i;
+	start = ktime_get();
+	while (i--)
+		mlx5dr_icm_free_chunk(chunks[i]);
+
+	mlx5_core_info(dmn->mdev,
+		       "smfs icm bench: order %d %s: %u chunks, alloc %llu/s, free %llu/s\n",
+		       order, round, num, alloc_rate, dr_bench_rate(num, start));
+
+	mlx5dr_icm_pool_sync(pool);
+}
+
+static int dr_bench_icm_run(struct mlx5_core_dev *mdev, u32 num_chunks,
+			    u32 num_threads)
+{
+	enum mlx5dr_icm_chunk_size order, max_order;
+	struct dr_bench_icm_thread *threads = NULL;
+	struct mlx5dr_icm_chunk **chunks;
+	struct mlx5dr_domain *dmn;
+	int err = 0;
+
+	chunks = kvcalloc((size_t)num_chunks * num_threads, sizeof(*chunks),
+			  GFP_KERNEL);
+	if (!chunks)
+		return -ENOMEM;
+
+	if (num_threads > 1) {
+		threads = kcalloc(num_threads, sizeof(*threads), GFP_KERNEL);
+		if (!threads) {
+			err = -ENOMEM;
+			goto free_chunks;
+		}
+	}
+
+	dmn = mlx5dr_domain_create(mdev, MLX5DR_DOMAIN_TYPE_NIC_RX);
+	if (!dmn) {
+		mlx5_core_warn(mdev, "smfs icm bench: no SW steering NIC RX domain\n");
+		err = -EOPNOTSUPP;
+		goto free_threads;
+	}
+
+	max_order = min_t(enum mlx5dr_icm_chunk_size, DR_BENCH_ICM_MAX_ORDER,
+			  dmn->info.max_log_sw_icm_sz);
+	for (order = DR_CHUNK_SIZE_MIN; order <= max_order && !err; order++) {
+		if (!threads) {
+			dr_bench_icm_round(dmn, order, chunks, num_chunks, "cold");
+			dr_bench_icm_round(dmn, order, chunks, num_chunks, "warm");
+			continue;
+		}
+		err = dr_bench_icm_round_mt(dmn, order, chunks, threads,
+					    num_threads, num_chunks, "cold");
+		if (!err)
+			err = dr_bench_icm_round_mt(dmn, order, chunks, threads,
+						    num_threads, num_chunks,
+						    "warm");
+	}
+
+	mlx5dr_domain_destroy(dmn);
+free_threads:
+	kfree(threads);
+free_chunks:
+	kvfree(chunks);
+	return err;
+}
+
+static ssize_t dr_bench_icm_write(struct file *filp, const char __user *buf,
+				  size_t count, loff_t *pos)
+{
+	struct mlx5_core_dev *mdev = filp->private_data;
+	u32 num_threads = 1;
+	u32 num_chunks;
+	char kbuf[32];
+	int err;
+
+	if (count >= sizeof(kbuf))
+		return -EINVAL;
+	if (copy_from_user(kbuf, buf, count))
+		return -EFAULT;
+	kbuf[count] = '\0';
+
+	if (sscanf(kbuf, "%u %u", &num_chunks, &num_threads) < 1 ||
+	    !num_chunks || !num_threads ||
+	    num_threads > DR_BENCH_ICM_MAX_THREADS)
+		return -EINVAL;
+
+	err = dr_bench_icm_run(mdev, num_chunks, num_threads);
+
+	return err ? err : count;
+}
+
+static const struct file_operations dr_bench_icm_fops = {
+	.owner = THIS_MODULE,
+	.open = simple_open,
+	.write = dr_bench_icm_write,
+};
+
+void mlx5dr_dbg_init_bench(struct mlx5_core_dev *dev)
+{
+	debugfs_create_file("smfs_rule_bench", 0200, dev->priv.dbg_root, dev,
+			    &dr_bench_fops);
+	debugfs_create_file("smfs_icm_bench", 0200, dev->priv.dbg_root, dev,
+			    &dr_bench_icm_fops);
+}
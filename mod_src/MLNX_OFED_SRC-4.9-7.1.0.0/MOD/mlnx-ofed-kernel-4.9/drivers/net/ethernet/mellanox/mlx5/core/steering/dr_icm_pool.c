@@ -24,14 +24,35 @@
 
 #define DR_ICM_MODIFY_HDR_ALIGN_BASE 64
 #define DR_ICM_SYNC_THRESHOLD (64 * 1024 * 1024)
+/* Above this much hot memory the freeing context syncs by itself */
+#define DR_ICM_SYNC_HARD_THRESHOLD (4 * DR_ICM_SYNC_THRESHOLD)
+
+/* Synced chunks of the small sizes that hash tables and collision entries
+ * use the most are kept per CPU, with their STE arrays, instead of being
+ * returned to the buddy.
+ */
+#define DR_ICM_PCP_MAX_ORDER DR_CHUNK_SIZE_64
+#define DR_ICM_PCP_DEPTH 16
+
+struct dr_icm_pcp_cache {
+	u32 count[DR_ICM_PCP_MAX_ORDER + 1];
+	struct mlx5dr_icm_chunk *chunks[DR_ICM_PCP_MAX_ORDER + 1][DR_ICM_PCP_DEPTH];
+};
 
 struct mlx5dr_icm_pool {
 	enum mlx5dr_icm_type icm_type;
 	enum mlx5dr_icm_chunk_size max_log_chunk_sz;
 	struct mlx5dr_domain *dmn;
 	/* memory management */
-	struct mutex mutex; /* protect the ICM pool */
+	struct rw_semaphore buddy_rwsem; /* protect the buddy list */
 	struct list_head buddy_mem_list;
+	u32 buddy_gen; /* bumped when a buddy is added, under buddy_rwsem */
+	/* protect the used and hot lists of all buddies */
+	spinlock_t hot_lock;
+	u64 hot_memory_size;
+	struct mutex sync_mutex; /* serialize hot memory reclamation */
+	struct work_struct sync_work;
+	struct dr_icm_pcp_cache __percpu *pcp;
 };
 
 struct mlx5dr_icm_dm {
@@ -50,6 +71,8 @@ struct mlx5dr_icm_mr {
 };
 
 struct mlx5dr_icm_buddy_mem {
+	/* protect the bitmaps and used_memory of this buddy only */
+	spinlock_t		lock;
 	unsigned long		**bits;
 	unsigned int		*num_free;
 	unsigned long		**set_bit;
@@ -124,6 +147,7 @@ static int dr_buddy_init(struct mlx5dr_icm_buddy_mem *buddy, u32 max_order)
 
 	buddy->max_order = max_order;
 
+	spin_lock_init(&buddy->lock);
 	INIT_LIST_HEAD(&buddy->list_node);
 	INIT_LIST_HEAD(&buddy->used_list);
 	INIT_LIST_HEAD(&buddy->hot_list);
@@ -431,6 +455,7 @@ static int dr_icm_buddy_create(struct mlx5dr_icm_pool *pool)
 
 	/* add it to the -start- of the list in order to search in it first */
 	list_add(&buddy->list_node, &pool->buddy_mem_list);
+	pool->buddy_gen++;
 
 	return 0;
 
@@ -498,9 +523,9 @@ dr_icm_chunk_create(struct mlx5dr_icm_pool *pool,
 	INIT_LIST_HEAD(&chunk->chunk_list);
 
 	/* chunk now is part of the used_list */
+	spin_lock(&pool->hot_lock);
 	list_add_tail(&chunk->chunk_list, &buddy_mem_pool->used_list);
-
-	buddy_mem_pool->used_memory += chunk->byte_size;
+	spin_unlock(&pool->hot_lock);
 
 	return chunk;
 
@@ -509,96 +534,243 @@ out_free_chunk:
 	return NULL;
 }
 
-static bool dr_icm_pool_is_sync_required(struct mlx5dr_icm_pool *pool)
+static struct mlx5dr_icm_chunk *
+dr_icm_pcp_get(struct mlx5dr_icm_pool *pool,
+	       enum mlx5dr_icm_chunk_size chunk_size)
 {
-	u64 allow_hot_size, all_hot_mem = 0;
-	struct mlx5dr_icm_buddy_mem *buddy;
+	struct mlx5dr_icm_chunk *chunk = NULL;
+	struct dr_icm_pcp_cache *pcp;
 
-	list_for_each_entry(buddy, &pool->buddy_mem_list, list_node) {
-		allow_hot_size =
-			mlx5dr_icm_pool_chunk_size_to_byte((buddy->max_order - 2),
-							   pool->icm_type);
-		all_hot_mem += buddy->hot_memory_size;
+	if (chunk_size > DR_ICM_PCP_MAX_ORDER)
+		return NULL;
+
+	pcp = get_cpu_ptr(pool->pcp);
+	if (pcp->count[chunk_size])
+		chunk = pcp->chunks[chunk_size][--pcp->count[chunk_size]];
+	put_cpu_ptr(pool->pcp);
+
+	return chunk;
+}
+
+static bool dr_icm_pcp_put(struct mlx5dr_icm_pool *pool,
+			   struct mlx5dr_icm_chunk *chunk)
+{
+	u32 order = ilog2(chunk->num_of_entries);
+	struct dr_icm_pcp_cache *pcp;
+	bool cached = false;
+
+	if (order > DR_ICM_PCP_MAX_ORDER)
+		return false;
+
+	pcp = get_cpu_ptr(pool->pcp);
+	if (pcp->count[order] < DR_ICM_PCP_DEPTH) {
+		pcp->chunks[order][pcp->count[order]++] = chunk;
+		cached = true;
+	}
+	put_cpu_ptr(pool->pcp);
+
+	return cached;
+}
 
-		if ((buddy->hot_memory_size > allow_hot_size) ||
-		    (all_hot_mem > DR_ICM_SYNC_THRESHOLD))
-			return true;
+static void dr_icm_pcp_drain(struct mlx5dr_icm_pool *pool)
+{
+	struct dr_icm_pcp_cache *pcp;
+	int cpu, order;
+
+	for_each_possible_cpu(cpu) {
+		pcp = per_cpu_ptr(pool->pcp, cpu);
+		for (order = 0; order <= DR_ICM_PCP_MAX_ORDER; order++)
+			while (pcp->count[order])
+				dr_icm_chunk_destroy(pcp->chunks[order][--pcp->count[order]]);
 	}
+}
 
-	return false;
+/* A cached chunk keeps its segment and STE arrays, clear what
+ * dr_icm_chunk_create() would have handed out zeroed.
+ */
+static void dr_icm_chunk_reuse(struct mlx5dr_icm_pool *pool,
+			       struct mlx5dr_icm_chunk *chunk)
+{
+	if (pool->icm_type == DR_ICM_TYPE_STE) {
+		memset(chunk->ste_arr, 0,
+		       chunk->num_of_entries * sizeof(chunk->ste_arr[0]));
+		memset(chunk->hw_ste_arr, 0,
+		       chunk->num_of_entries * DR_STE_SIZE_REDUCED);
+	}
+
+	spin_lock(&pool->hot_lock);
+	list_add_tail(&chunk->chunk_list, &chunk->buddy_mem->used_list);
+	spin_unlock(&pool->hot_lock);
 }
 
+/* Called with hot_lock held, after a chunk of buddy turned hot */
+static bool dr_icm_pool_is_sync_required(struct mlx5dr_icm_pool *pool,
+					 struct mlx5dr_icm_buddy_mem *buddy)
+{
+	u64 allow_hot_size;
+
+	allow_hot_size =
+		mlx5dr_icm_pool_chunk_size_to_byte((buddy->max_order - 2),
+						   pool->icm_type);
+
+	return (buddy->hot_memory_size > allow_hot_size) ||
+	       (pool->hot_memory_size > DR_ICM_SYNC_THRESHOLD);
+}
+
+/* Reclaim the memory that was hot when called. The hot chunks are taken
+ * off the buddies first, so the steering sync runs without any allocator
+ * lock held and chunks freed meanwhile simply wait for the next round.
+ */
 static int dr_icm_pool_sync_all_buddy_pools(struct mlx5dr_icm_pool *pool)
 {
 	struct mlx5dr_icm_buddy_mem *buddy, *tmp_buddy;
-	int err;
+	struct mlx5dr_icm_chunk *chunk, *tmp_chunk;
+	LIST_HEAD(sync_list);
+	bool empty = false;
+	int err = 0;
+
+	mutex_lock(&pool->sync_mutex);
+
+	down_read(&pool->buddy_rwsem);
+	spin_lock(&pool->hot_lock);
+	list_for_each_entry(buddy, &pool->buddy_mem_list, list_node) {
+		list_splice_tail_init(&buddy->hot_list, &sync_list);
+		pool->hot_memory_size -= buddy->hot_memory_size;
+		buddy->hot_memory_size = 0;
+	}
+	spin_unlock(&pool->hot_lock);
+	up_read(&pool->buddy_rwsem);
+
+	if (list_empty(&sync_list))
+		goto out;
 
 	err = mlx5dr_cmd_sync_steering(pool->dmn->mdev);
 	if (err) {
 		mlx5dr_err(pool->dmn, "Failed to sync to HW (err: %d)\n", err);
-		return err;
+		/* Keep the chunks hot for the next attempt */
+		spin_lock(&pool->hot_lock);
+		list_for_each_entry_safe(chunk, tmp_chunk, &sync_list, chunk_list) {
+			buddy = chunk->buddy_mem;
+			list_move_tail(&chunk->chunk_list, &buddy->hot_list);
+			buddy->hot_memory_size += chunk->byte_size;
+			pool->hot_memory_size += chunk->byte_size;
+		}
+		spin_unlock(&pool->hot_lock);
+		goto out;
 	}
 
-	list_for_each_entry_safe(buddy, tmp_buddy, &pool->buddy_mem_list, list_node) {
-		struct mlx5dr_icm_chunk *chunk, *tmp_chunk;
+	/* Our chunks keep their buddies alive, no need for buddy_rwsem */
+	list_for_each_entry_safe(chunk, tmp_chunk, &sync_list, chunk_list) {
+		list_del_init(&chunk->chunk_list);
+		if (dr_icm_pcp_put(pool, chunk))
+			continue;
+
+		buddy = chunk->buddy_mem;
+		spin_lock(&buddy->lock);
+		dr_buddy_free_mem(buddy, chunk->seg,
+				  ilog2(chunk->num_of_entries));
+		buddy->used_memory -= chunk->byte_size;
+		empty |= !buddy->used_memory;
+		spin_unlock(&buddy->lock);
+		dr_icm_chunk_destroy(chunk);
+	}
 
-		list_for_each_entry_safe(chunk, tmp_chunk, &buddy->hot_list, chunk_list) {
-			dr_buddy_free_mem(buddy, chunk->seg,
-					  ilog2(chunk->num_of_entries));
-			buddy->hot_memory_size -= chunk->byte_size;
-			buddy->used_memory -= chunk->byte_size;
-			dr_icm_chunk_destroy(chunk);
-		}
-		if (!buddy->used_memory)
-			dr_icm_buddy_destroy(buddy);
+	if (empty) {
+		down_write(&pool->buddy_rwsem);
+		list_for_each_entry_safe(buddy, tmp_buddy, &pool->buddy_mem_list,
+					 list_node)
+			if (!buddy->used_memory)
+				dr_icm_buddy_destroy(buddy);
+		up_write(&pool->buddy_rwsem);
 	}
 
-	return 0;
+out:
+	mutex_unlock(&pool->sync_mutex);
+	return err;
 }
 
+static void dr_icm_pool_sync_work(struct work_struct *work)
+{
+	struct mlx5dr_icm_pool *pool =
+		container_of(work, struct mlx5dr_icm_pool, sync_work);
+
+	dr_icm_pool_sync_all_buddy_pools(pool);
+}
+
+int mlx5dr_icm_pool_sync(struct mlx5dr_icm_pool *pool)
+{
+	return dr_icm_pool_sync_all_buddy_pools(pool);
+}
+
+/* Take a segment of chunk_size from the first buddy that has one and
+ * account it as used, which keeps the buddy alive without buddy_rwsem.
+ * Every buddy has its own lock, so allocations only contend on the short
+ * bitmap update of the same buddy. A new buddy is created only if no
+ * other thread added one since the scan failed.
+ */
 static int dr_icm_handle_buddies_get_mem(struct mlx5dr_icm_pool *pool,
 					 enum mlx5dr_icm_chunk_size chunk_size,
 					 struct mlx5dr_icm_buddy_mem **buddy,
 					 int *seg)
 {
+	u32 byte_size = mlx5dr_icm_pool_chunk_size_to_byte(chunk_size,
+							   pool->icm_type);
 	struct mlx5dr_icm_buddy_mem *buddy_mem_pool;
 	bool new_mem = false;
 	int err = 0;
+	u32 gen;
 
-	*seg = -1;
-
-	/* find the next free place from the buddy list */
-	while (*seg == -1) {
+	for (;;) {
+		down_read(&pool->buddy_rwsem);
+		gen = pool->buddy_gen;
 		list_for_each_entry(buddy_mem_pool, &pool->buddy_mem_list, list_node) {
+			spin_lock(&buddy_mem_pool->lock);
 			*seg = dr_buddy_alloc_mem(buddy_mem_pool, chunk_size);
 			if (*seg != -1)
-				goto found;
-
-			if (new_mem) {
-				/* We have new memory pool, first in the list */
-				mlx5dr_err(pool->dmn,
-					   "No memory for order: %d\n",
-					   chunk_size);
-				err = -ENOMEM;
-				goto out;
+				buddy_mem_pool->used_memory += byte_size;
+			spin_unlock(&buddy_mem_pool->lock);
+			if (*seg != -1) {
+				up_read(&pool->buddy_rwsem);
+				*buddy = buddy_mem_pool;
+				return 0;
 			}
 		}
+		up_read(&pool->buddy_rwsem);
+
+		if (new_mem) {
+			/* We have new memory pool, first in the list */
+			mlx5dr_err(pool->dmn,
+				   "No memory for order: %d\n",
+				   chunk_size);
+			return -ENOMEM;
+		}
+
+		down_write(&pool->buddy_rwsem);
 		/* no more available allocators in that pool, create new */
-		err = dr_icm_buddy_create(pool);
+		if (gen == pool->buddy_gen) {
+			err = dr_icm_buddy_create(pool);
+			new_mem = !err;
+		}
+		up_write(&pool->buddy_rwsem);
 		if (err) {
 			mlx5dr_err(pool->dmn,
 				   "Failed creating buddy for order %d\n",
 				   chunk_size);
-			goto out;
+			return err;
 		}
-		/* mark we have new memory, first in list */
-		new_mem = true;
 	}
+}
 
-found:
-	*buddy = buddy_mem_pool;
-out:
-	return err;
+static void dr_icm_buddy_put_mem(struct mlx5dr_icm_pool *pool,
+				 struct mlx5dr_icm_buddy_mem *buddy,
+				 enum mlx5dr_icm_chunk_size chunk_size,
+				 int seg)
+{
+	spin_lock(&buddy->lock);
+	dr_buddy_free_mem(buddy, seg, chunk_size);
+	buddy->used_memory -=
+		mlx5dr_icm_pool_chunk_size_to_byte(chunk_size, pool->icm_type);
+	spin_unlock(&buddy->lock);
 }
 
 /* Allocate an ICM chunk, each chunk holds a piece of ICM memory and
@@ -616,39 +788,46 @@ mlx5dr_icm_alloc_chunk(struct mlx5dr_icm_pool *pool,
 	if (chunk_size > pool->max_log_chunk_sz)
 		return NULL;
 
-	mutex_lock(&pool->mutex);
+	chunk = dr_icm_pcp_get(pool, chunk_size);
+	if (chunk) {
+		dr_icm_chunk_reuse(pool, chunk);
+		return chunk;
+	}
+
 	/* find mem, get back the relevant buddy pool and seg in that mem */
 	ret = dr_icm_handle_buddies_get_mem(pool, chunk_size, &buddy, &seg);
 	if (ret)
-		goto out_unlock;
+		return NULL;
 
 	chunk = dr_icm_chunk_create(pool, chunk_size, buddy, seg);
 	if (!chunk)
-		goto out_err;
+		dr_icm_buddy_put_mem(pool, buddy, chunk_size, seg);
 
-	mutex_unlock(&pool->mutex);
 	return chunk;
-
-out_err:
-	dr_buddy_free_mem(buddy, seg, chunk_size);
-out_unlock:
-	mutex_unlock(&pool->mutex);
-	return NULL;
 }
 
 void mlx5dr_icm_free_chunk(struct mlx5dr_icm_chunk *chunk)
 {
 	struct mlx5dr_icm_buddy_mem *buddy = chunk->buddy_mem;
+	struct mlx5dr_icm_pool *pool = buddy->pool;
+	bool sync_required;
+	bool sync_now;
 
 	/* move the memory to the waiting list AKA "hot" */
-	mutex_lock(&buddy->pool->mutex);
-	list_del_init(&chunk->chunk_list);
-	list_add_tail(&chunk->chunk_list, &buddy->hot_list);
+	spin_lock(&pool->hot_lock);
+	list_move_tail(&chunk->chunk_list, &buddy->hot_list);
 	buddy->hot_memory_size += chunk->byte_size;
+	pool->hot_memory_size += chunk->byte_size;
 	/* Check if we have chunks that are waiting for sync-ste */
-	if (dr_icm_pool_is_sync_required(buddy->pool))
-		dr_icm_pool_sync_all_buddy_pools(buddy->pool);
-	mutex_unlock(&buddy->pool->mutex);
+	sync_required = dr_icm_pool_is_sync_required(pool, buddy);
+	sync_now = pool->hot_memory_size > DR_ICM_SYNC_HARD_THRESHOLD;
+	spin_unlock(&pool->hot_lock);
+
+	/* Reclamation runs in the background unless it fell far behind */
+	if (sync_now)
+		dr_icm_pool_sync_all_buddy_pools(pool);
+	else if (sync_required)
+		queue_work(system_unbound_wq, &pool->sync_work);
 }
 
 struct mlx5dr_icm_pool *mlx5dr_icm_pool_create(struct mlx5dr_domain *dmn,
@@ -666,12 +845,21 @@ struct mlx5dr_icm_pool *mlx5dr_icm_pool_create(struct mlx5dr_domain *dmn,
 	if (!pool)
 		return NULL;
 
+	pool->pcp = alloc_percpu(struct dr_icm_pcp_cache);
+	if (!pool->pcp) {
+		kvfree(pool);
+		return NULL;
+	}
+
 	pool->dmn = dmn;
 	pool->icm_type = icm_type;
 	pool->max_log_chunk_sz = max_log_chunk_sz;
 	INIT_LIST_HEAD(&pool->buddy_mem_list);
 
-	mutex_init(&pool->mutex);
+	init_rwsem(&pool->buddy_rwsem);
+	mutex_init(&pool->sync_mutex);
+	spin_lock_init(&pool->hot_lock);
+	INIT_WORK(&pool->sync_work, dr_icm_pool_sync_work);
 
 	return pool;
 }
@@ -680,9 +868,13 @@ void mlx5dr_icm_pool_destroy(struct mlx5dr_icm_pool *pool)
 {
 	struct mlx5dr_icm_buddy_mem *buddy, *tmp_buddy;
 
+	cancel_work_sync(&pool->sync_work);
+	dr_icm_pcp_drain(pool);
+
 	list_for_each_entry_safe(buddy, tmp_buddy, &pool->buddy_mem_list, list_node)
 		dr_icm_buddy_destroy(buddy);
 
-	mutex_destroy(&pool->mutex);
+	free_percpu(pool->pcp);
+	mutex_destroy(&pool->sync_mutex);
 	kvfree(pool);
 }
@@ -694,6 +694,9 @@ mlx5dr_matcher_create(struct mlx5dr_table *tbl,
 	refcount_set(&matcher->refcount, 1);
 	INIT_LIST_HEAD(&matcher->matcher_list);
 	INIT_LIST_HEAD(&matcher->rule_list);
+	INIT_LIST_HEAD(&matcher->rx.rehash_list);
+	INIT_LIST_HEAD(&matcher->tx.rehash_list);
+	INIT_WORK(&matcher->rehash_work, mlx5dr_rule_rehash_work);
 
 	mlx5dr_domain_lock(tbl->dmn);
 
@@ -796,7 +799,10 @@ int mlx5dr_matcher_destroy(struct mlx5dr_matcher *matcher)
 	if (refcount_read(&matcher->refcount) > 1)
 		return -EBUSY;
 
+	cancel_work_sync(&matcher->rehash_work);
+
 	mlx5dr_domain_lock(tbl->dmn);
+	mlx5dr_rule_rehash_drain(matcher);
 	mutex_lock(&tbl->dmn->dbg_mutex);
 	dr_matcher_remove_from_tbl(matcher);
 	mutex_unlock(&tbl->dmn->dbg_mutex);
@@ -5,6 +5,8 @@
 #include "dr_types.h"
 
 #define DR_RULE_MAX_STE_CHAIN (DR_RULE_MAX_STES + DR_ACTION_MAX_STES)
+/* Buckets migrated by the background rehash per nic lock hold */
+#define DR_RULE_REHASH_STEP_BUCKETS 64
 
 
 static int dr_rule_append_to_miss_list(struct mlx5dr_ste *new_last_ste,
@@ -36,7 +38,7 @@ static int dr_rule_append_to_miss_list(struct mlx5dr_ste *new_last_ste,
 static struct mlx5dr_ste *
 dr_rule_create_collision_htbl(struct mlx5dr_matcher *matcher,
 			      struct mlx5dr_matcher_rx_tx *nic_matcher,
-			      u8 *hw_ste)
+			      u8 *hw_ste, u64 miss_icm_addr)
 {
 	struct mlx5dr_domain *dmn = matcher->tbl->dmn;
 	struct mlx5dr_ste_htbl *new_htbl;
@@ -54,7 +56,7 @@ dr_rule_create_collision_htbl(struct mlx5dr_matcher *matcher,
 
 	/* One and only entry, never grows */
 	ste = new_htbl->ste_arr;
-	mlx5dr_ste_set_miss_addr(hw_ste, nic_matcher->e_anchor->chunk->icm_addr);
+	mlx5dr_ste_set_miss_addr(hw_ste, miss_icm_addr);
 	mlx5dr_htbl_get(new_htbl);
 
 	return ste;
@@ -68,7 +70,9 @@ dr_rule_create_collision_entry(struct mlx5dr_matcher *matcher,
 {
 	struct mlx5dr_ste *ste;
 
-	ste = dr_rule_create_collision_htbl(matcher, nic_matcher, hw_ste);
+	ste = dr_rule_create_collision_htbl(matcher, nic_matcher, hw_ste,
+					    mlx5dr_ste_htbl_miss_addr(nic_matcher,
+								      orig_ste->htbl));
 	if (!ste) {
 		mlx5dr_dbg(matcher->tbl->dmn, "Failed creating collision entry\n");
 		return NULL;
@@ -169,7 +173,9 @@ dr_rule_rehash_handle_collision(struct mlx5dr_matcher *matcher,
 	struct mlx5dr_ste *new_ste;
 	int ret;
 
-	new_ste = dr_rule_create_collision_htbl(matcher, nic_matcher, hw_ste);
+	new_ste = dr_rule_create_collision_htbl(matcher, nic_matcher, hw_ste,
+						mlx5dr_ste_htbl_miss_addr(nic_matcher,
+									  col_ste->htbl));
 	if (!new_ste)
 		return NULL;
 
@@ -200,7 +206,10 @@ static void dr_rule_rehash_copy_ste_ctrl(struct mlx5dr_matcher *matcher,
 	new_ste->next_htbl = cur_ste->next_htbl;
 	new_ste->ste_chain_location = cur_ste->ste_chain_location;
 
-	if (!mlx5dr_ste_is_last_in_rule(nic_matcher, new_ste->ste_chain_location))
+	/* The selected builders may belong to another rule by the time the
+	 * background rehash gets here, so rely on next_htbl only.
+	 */
+	if (new_ste->next_htbl)
 		new_ste->next_htbl->pointing_ste = new_ste;
 
 	/* We need to copy the refcount since this ste
@@ -216,25 +225,25 @@ static void dr_rule_rehash_copy_ste_ctrl(struct mlx5dr_matcher *matcher,
 
 static struct mlx5dr_ste *
 dr_rule_rehash_copy_ste(struct mlx5dr_matcher *matcher,
-			struct mlx5dr_matcher_rx_tx *nic_matcher,
+			struct mlx5dr_ste_htbl_rehash *rehash,
 			struct mlx5dr_ste *cur_ste,
-			struct mlx5dr_ste_htbl *new_htbl,
 			struct list_head *update_list)
 {
+	struct mlx5dr_matcher_rx_tx *nic_matcher = rehash->nic_matcher;
+	struct mlx5dr_ste_htbl *new_htbl = rehash->new_htbl;
+	struct mlx5dr_ste_send_info *link_info = NULL;
 	struct mlx5dr_ste_send_info *ste_info;
-	bool use_update_list = false;
 	u8 hw_ste[DR_STE_SIZE] = {};
 	struct mlx5dr_ste *new_ste;
 	int new_idx;
-	u8 sb_idx;
 
-	/* Copy STE mask from the matcher */
-	sb_idx = cur_ste->ste_chain_location - 1;
-	mlx5dr_ste_set_bit_mask(hw_ste, nic_matcher->ste_builder[sb_idx].bit_mask);
+	/* Copy STE mask saved when the rehash started */
+	mlx5dr_ste_set_bit_mask(hw_ste, rehash->bit_mask);
 
 	/* Copy STE control and tag */
 	memcpy(hw_ste, cur_ste->hw_ste, DR_STE_SIZE_REDUCED);
-	mlx5dr_ste_set_miss_addr(hw_ste, nic_matcher->e_anchor->chunk->icm_addr);
+	mlx5dr_ste_set_miss_addr(hw_ste,
+				 mlx5dr_ste_htbl_miss_addr(nic_matcher, new_htbl));
 
 	new_idx = mlx5dr_ste_calc_hash_index(hw_ste, new_htbl);
 	new_ste = &new_htbl->ste_arr[new_idx];
@@ -254,23 +263,28 @@ dr_rule_rehash_copy_ste(struct mlx5dr_matcher *matcher,
 				   new_idx);
 			return NULL;
 		}
+		/* Miss address update of the previous entry in the list */
+		link_info = list_last_entry(update_list,
+					    struct mlx5dr_ste_send_info,
+					    send_list);
 		new_htbl->ctrl.num_of_collisions++;
-		use_update_list = true;
 	}
 
 	memcpy(new_ste->hw_ste, hw_ste, DR_STE_SIZE_REDUCED);
 
 	new_htbl->ctrl.num_of_valid_entries++;
 
-	if (use_update_list) {
-		ste_info = kzalloc(sizeof(*ste_info), GFP_KERNEL);
-		if (!ste_info)
-			goto err_exit;
+	/* The new table is already live, every copy is written on its own */
+	ste_info = kzalloc(sizeof(*ste_info), GFP_KERNEL);
+	if (!ste_info)
+		goto err_exit;
 
-		mlx5dr_send_fill_and_append_ste_send_info(new_ste, DR_STE_SIZE, 0,
-							  hw_ste, ste_info,
-							  update_list, true);
-	}
+	mlx5dr_send_fill_and_append_ste_send_info(new_ste, DR_STE_SIZE, 0,
+						  hw_ste, ste_info,
+						  update_list, true);
+	/* Write the entry before the miss address pointing to it */
+	if (link_info)
+		list_move_tail(&ste_info->send_list, &link_info->send_list);
 
 	dr_rule_rehash_copy_ste_ctrl(matcher, nic_matcher, cur_ste, new_ste);
 
@@ -282,9 +296,8 @@ err_exit:
 }
 
 static int dr_rule_rehash_copy_miss_list(struct mlx5dr_matcher *matcher,
-					 struct mlx5dr_matcher_rx_tx *nic_matcher,
+					 struct mlx5dr_ste_htbl_rehash *rehash,
 					 struct list_head *cur_miss_list,
-					 struct mlx5dr_ste_htbl *new_htbl,
 					 struct list_head *update_list)
 {
 	struct mlx5dr_ste *tmp_ste, *cur_ste, *new_ste;
@@ -294,58 +307,188 @@ static int dr_rule_rehash_copy_miss_list(struct mlx5dr_matcher *matcher,
 
 	list_for_each_entry_safe(cur_ste, tmp_ste, cur_miss_list, miss_list_node) {
 		new_ste = dr_rule_rehash_copy_ste(matcher,
-						  nic_matcher,
+						  rehash,
 						  cur_ste,
-						  new_htbl,
 						  update_list);
 		if (!new_ste)
 			goto err_insert;
 
 		list_del(&cur_ste->miss_list_node);
+		/* The old entry now only lingers in the HW until retired */
+		cur_ste->refcount = 0;
+		cur_ste->next_htbl = NULL;
 		mlx5dr_htbl_put(cur_ste->htbl);
 	}
 	return 0;
 
 err_insert:
+	/* The entries copied so far left the list, the rest stay on it and
+	 * are picked up when the bucket is migrated again.
+	 */
 	mlx5dr_err(matcher->tbl->dmn, "Fatal error during resize\n");
 	WARN_ON(true);
 	return -EINVAL;
 }
 
-static int dr_rule_rehash_copy_htbl(struct mlx5dr_matcher *matcher,
-				    struct mlx5dr_matcher_rx_tx *nic_matcher,
-				    struct mlx5dr_ste_htbl *cur_htbl,
-				    struct mlx5dr_ste_htbl *new_htbl,
-				    struct list_head *update_list)
+/* Move the miss list of one bucket of the old table into the new table.
+ * The copies are queued before the old head is turned into an always
+ * miss entry, so a lookup finds the entries in one of the tables at any
+ * time. A bucket is done once its miss list is empty; the head itself
+ * may already be copied (and look unused) after a partial failure.
+ */
+static int dr_rule_rehash_migrate_bucket(struct mlx5dr_matcher *matcher,
+					 struct mlx5dr_ste_htbl_rehash *rehash,
+					 u32 idx,
+					 struct list_head *update_list)
 {
-	struct mlx5dr_ste *cur_ste;
-	int cur_entries;
-	int err = 0;
-	int i;
+	struct mlx5dr_ste_htbl *old_htbl = rehash->old_htbl;
+	struct mlx5dr_ste *head = &old_htbl->ste_arr[idx];
+	struct mlx5dr_ste_send_info *ste_info;
+	u8 tmp_data_ste[DR_STE_SIZE] = {};
+	struct mlx5dr_ste tmp_ste = {};
+	u64 miss_addr;
+	int ret;
 
-	cur_entries = mlx5dr_icm_pool_chunk_size_to_entries(cur_htbl->chunk_size);
+	if (list_empty(mlx5dr_ste_get_miss_list(head)))
+		return 0;
 
-	if (cur_entries < 1) {
-		mlx5dr_dbg(matcher->tbl->dmn, "Invalid number of entries\n");
-		return -EINVAL;
+	ste_info = kzalloc(sizeof(*ste_info), GFP_KERNEL);
+	if (!ste_info)
+		return -ENOMEM;
+
+	miss_addr = mlx5dr_ste_htbl_miss_addr(rehash->nic_matcher, old_htbl);
+
+	ret = dr_rule_rehash_copy_miss_list(matcher, rehash,
+					    mlx5dr_ste_get_miss_list(head),
+					    update_list);
+	if (ret) {
+		kfree(ste_info);
+		return ret;
 	}
 
-	for (i = 0; i < cur_entries; i++) {
-		cur_ste = &cur_htbl->ste_arr[i];
-		if (mlx5dr_ste_not_used_ste(cur_ste)) /* Empty, nothing to copy */
-			continue;
-
-		err = dr_rule_rehash_copy_miss_list(matcher,
-						    nic_matcher,
-						    mlx5dr_ste_get_miss_list(cur_ste),
-						    new_htbl,
-						    update_list);
-		if (err)
-			goto clean_copy;
+	/* Use temp ste because dr_ste_always_miss_addr
+	 * touches bit_mask area which doesn't exist at ste->hw_ste.
+	 */
+	tmp_ste.hw_ste = tmp_data_ste;
+	memcpy(tmp_data_ste, head->hw_ste, DR_STE_SIZE_REDUCED);
+	mlx5dr_ste_always_miss_addr(&tmp_ste, miss_addr);
+	memcpy(head->hw_ste, tmp_data_ste, DR_STE_SIZE_REDUCED);
+
+	mlx5dr_send_fill_and_append_ste_send_info(head, DR_STE_SIZE, 0,
+						  tmp_data_ste, ste_info,
+						  update_list, true);
+	return 0;
+}
+
+static void dr_rule_rehash_complete(struct mlx5dr_matcher *matcher,
+				    struct mlx5dr_ste_htbl_rehash *rehash)
+{
+	struct mlx5dr_matcher_rx_tx *nic_matcher = rehash->nic_matcher;
+	struct mlx5dr_ste_htbl *new_htbl = rehash->new_htbl;
+	struct mlx5dr_domain *dmn = matcher->tbl->dmn;
+	struct mlx5dr_htbl_connect_info info;
+
+	/* Nothing is left behind the miss anchor, point it to the end
+	 * anchor before the old table is released.
+	 */
+	info.type = CONNECT_MISS;
+	info.miss_icm_addr = nic_matcher->e_anchor->chunk->icm_addr;
+	if (mlx5dr_ste_htbl_init_and_postsend(dmn,
+					      nic_matcher->nic_tbl->nic_dmn,
+					      new_htbl->miss_anchor,
+					      &info, true))
+		mlx5dr_err(dmn, "Failed disconnecting rehashed table\n");
+
+	new_htbl->rehash = NULL;
+	list_del(&rehash->list);
+	mlx5dr_htbl_put(rehash->old_htbl);
+	mlx5dr_htbl_put(new_htbl);
+	kfree(rehash);
+}
+
+/* Migrate up to budget buckets of the oldest rehash of nic_matcher.
+ * Called with the nic domain locked, returns true while work is left.
+ */
+static bool dr_rule_rehash_advance(struct mlx5dr_matcher *matcher,
+				   struct mlx5dr_matcher_rx_tx *nic_matcher,
+				   u32 budget)
+{
+	struct mlx5dr_domain *dmn = matcher->tbl->dmn;
+	struct mlx5dr_ste_htbl_rehash *rehash;
+	LIST_HEAD(update_list);
+	ktime_t start;
+	u32 entries;
+	int ret = 0;
+
+	rehash = list_first_entry_or_null(&nic_matcher->rehash_list,
+					  struct mlx5dr_ste_htbl_rehash, list);
+	if (!rehash)
+		return false;
+
+	start = ktime_get();
+	entries = mlx5dr_icm_pool_chunk_size_to_entries(rehash->old_htbl->chunk_size);
+
+	while (budget-- && rehash->next_idx < entries) {
+		ret = dr_rule_rehash_migrate_bucket(matcher, rehash,
+						    rehash->next_idx,
+						    &update_list);
+		if (ret)
+			break;
+		rehash->next_idx++;
 	}
 
-clean_copy:
-	return err;
+	/* In order, the copies of a bucket go out before its retirement */
+	if (dr_rule_send_update_list(&update_list, dmn, false))
+		mlx5dr_err(dmn, "Failed updating rehashed table to HW\n");
+
+	if (!ret && rehash->next_idx == entries)
+		dr_rule_rehash_complete(matcher, rehash);
+
+	mlx5dr_latency_hist_add(&dmn->rehash_hist, start);
+
+	return !list_empty(&nic_matcher->rehash_list);
+}
+
+static bool dr_rule_rehash_step(struct mlx5dr_matcher *matcher,
+				struct mlx5dr_matcher_rx_tx *nic_matcher)
+{
+	struct mlx5dr_domain_rx_tx *nic_dmn;
+	bool more;
+
+	if (!nic_matcher->nic_tbl)
+		return false;
+
+	nic_dmn = nic_matcher->nic_tbl->nic_dmn;
+
+	mlx5dr_domain_nic_lock(nic_dmn);
+	more = dr_rule_rehash_advance(matcher, nic_matcher,
+				      DR_RULE_REHASH_STEP_BUCKETS);
+	mlx5dr_domain_nic_unlock(nic_dmn);
+
+	return more;
+}
+
+void mlx5dr_rule_rehash_work(struct work_struct *work)
+{
+	struct mlx5dr_matcher *matcher =
+		container_of(work, struct mlx5dr_matcher, rehash_work);
+	bool more;
+
+	more = dr_rule_rehash_step(matcher, &matcher->rx);
+	more |= dr_rule_rehash_step(matcher, &matcher->tx);
+
+	/* Requeue rather than loop so inserts get the lock in between */
+	if (more)
+		queue_work(system_unbound_wq, &matcher->rehash_work);
+}
+
+/* Finish all pending rehashes of the matcher, the domain must be locked */
+void mlx5dr_rule_rehash_drain(struct mlx5dr_matcher *matcher)
+{
+	while (dr_rule_rehash_advance(matcher, &matcher->rx, U32_MAX))
+		;
+	while (dr_rule_rehash_advance(matcher, &matcher->tx, U32_MAX))
+		;
 }
 
 static struct mlx5dr_ste_htbl *
@@ -353,115 +496,134 @@ dr_rule_rehash_htbl(struct mlx5dr_rule *rule,
 		    struct mlx5dr_rule_rx_tx *nic_rule,
 		    struct mlx5dr_ste_htbl *cur_htbl,
 		    u8 ste_location,
-		    struct list_head *update_list,
 		    enum mlx5dr_icm_chunk_size new_size)
 {
-	struct mlx5dr_ste_send_info *del_ste_info, *tmp_ste_info;
 	struct mlx5dr_matcher *matcher = rule->matcher;
 	struct mlx5dr_domain *dmn = matcher->tbl->dmn;
 	struct mlx5dr_matcher_rx_tx *nic_matcher;
-	struct mlx5dr_ste_send_info *ste_info;
+	struct mlx5dr_ste_htbl_rehash *rehash;
 	struct mlx5dr_htbl_connect_info info;
 	struct mlx5dr_domain_rx_tx *nic_dmn;
 	u8 formatted_ste[DR_STE_SIZE] = {};
-	LIST_HEAD(rehash_table_send_list);
+	u8 pointing_data[DR_STE_SIZE] = {};
+	struct mlx5dr_ste_htbl *miss_anchor;
 	struct mlx5dr_ste *ste_to_update;
 	struct mlx5dr_ste_htbl *new_htbl;
-	int err;
 
 	nic_matcher = nic_rule->nic_matcher;
 	nic_dmn = nic_matcher->nic_tbl->nic_dmn;
 
-	ste_info = kzalloc(sizeof(*ste_info), GFP_KERNEL);
-	if (!ste_info)
+	rehash = kzalloc(sizeof(*rehash), GFP_KERNEL);
+	if (!rehash)
 		return NULL;
 
+	/* Misses of the new table continue in the current one through this
+	 * anchor until all of its buckets were migrated.
+	 */
+	miss_anchor = mlx5dr_ste_htbl_alloc(dmn->ste_icm_pool,
+					    DR_CHUNK_SIZE_1,
+					    MLX5DR_STE_LU_TYPE_DONT_CARE,
+					    0);
+	if (!miss_anchor) {
+		mlx5dr_err(dmn, "Failed to allocate rehash miss anchor\n");
+		goto free_rehash;
+	}
+
+	info.type = CONNECT_HIT;
+	info.hit_next_htbl = cur_htbl;
+	if (mlx5dr_ste_htbl_init_and_postsend(dmn, nic_dmn, miss_anchor,
+					      &info, true)) {
+		mlx5dr_err(dmn, "Failed writing rehash miss anchor to HW\n");
+		goto free_miss_anchor;
+	}
+
 	new_htbl = mlx5dr_ste_htbl_alloc(dmn->ste_icm_pool,
 					 new_size,
 					 cur_htbl->lu_type,
 					 cur_htbl->byte_mask);
 	if (!new_htbl) {
 		mlx5dr_err(dmn, "Failed to allocate new hash table\n");
-		goto free_ste_info;
+		goto free_miss_anchor;
 	}
 
 	/* Write new table to HW */
 	info.type = CONNECT_MISS;
-	info.miss_icm_addr = nic_matcher->e_anchor->chunk->icm_addr;
+	info.miss_icm_addr = miss_anchor->chunk->icm_addr;
 	mlx5dr_ste_set_formatted_ste(dmn->info.caps.gvmi,
 				     nic_dmn,
 				     new_htbl,
 				     formatted_ste,
 				     &info);
 
-	new_htbl->pointing_ste = cur_htbl->pointing_ste;
-	new_htbl->pointing_ste->next_htbl = new_htbl;
-	err = dr_rule_rehash_copy_htbl(matcher,
-				       nic_matcher,
-				       cur_htbl,
-				       new_htbl,
-				       &rehash_table_send_list);
-	if (err)
-		goto free_new_htbl;
-
 	if (mlx5dr_send_postsend_htbl(dmn, new_htbl, formatted_ste,
 				      nic_matcher->ste_builder[ste_location - 1].bit_mask)) {
 		mlx5dr_err(dmn, "Failed writing table to HW\n");
 		goto free_new_htbl;
 	}
 
-	/* Writing to the hw is done in regular order of rehash_table_send_list,
-	 * in order to have the origin data written before the miss address of
-	 * collision entries, if exists.
+	/* Connect previous hash table to current. This is written right
+	 * away rather than with the rule: buckets of the current table may
+	 * be migrated and retired before the rule is sent, and HW must reach
+	 * the new table by then.
 	 */
-	if (dr_rule_send_update_list(&rehash_table_send_list, dmn, false)) {
-		mlx5dr_err(dmn, "Failed updating table to HW\n");
-		goto free_ste_list;
-	}
-
-	/* Connect previous hash table to current */
 	if (ste_location == 1) {
 		/* The previous table is an anchor, anchors size is always one STE */
 		struct mlx5dr_ste_htbl *prev_htbl = cur_htbl->pointing_ste->htbl;
 
-		/* On matcher s_anchor we keep an extra refcount */
-		mlx5dr_htbl_get(new_htbl);
-		mlx5dr_htbl_put(cur_htbl);
-
-		nic_matcher->s_htbl = new_htbl;
-
-		/* It is safe to operate dr_ste_set_hit_addr on the hw_ste here
-		 * (48B len) which works only on first 32B
-		 */
-		mlx5dr_ste_set_hit_addr(prev_htbl->ste_arr[0].hw_ste,
+		ste_to_update = &prev_htbl->ste_arr[0];
+		memcpy(pointing_data, ste_to_update->hw_ste, DR_STE_SIZE_REDUCED);
+		mlx5dr_ste_set_hit_addr(pointing_data,
 					new_htbl->chunk->icm_addr,
 					new_htbl->chunk->num_of_entries);
-
-		ste_to_update = &prev_htbl->ste_arr[0];
 	} else {
-		mlx5dr_ste_set_hit_addr_by_next_htbl(cur_htbl->pointing_ste->hw_ste,
-						     new_htbl);
 		ste_to_update = cur_htbl->pointing_ste;
+		memcpy(pointing_data, ste_to_update->hw_ste, DR_STE_SIZE_REDUCED);
+		mlx5dr_ste_set_hit_addr_by_next_htbl(pointing_data, new_htbl);
 	}
 
-	mlx5dr_send_fill_and_append_ste_send_info(ste_to_update, DR_STE_SIZE_REDUCED,
-						  0, ste_to_update->hw_ste, ste_info,
-						  update_list, false);
+	if (mlx5dr_send_postsend_ste(dmn, ste_to_update, pointing_data,
+				     DR_STE_SIZE_REDUCED, 0)) {
+		mlx5dr_err(dmn, "Failed connecting rehashed table to HW\n");
+		goto free_new_htbl;
+	}
+	memcpy(ste_to_update->hw_ste, pointing_data, DR_STE_SIZE_REDUCED);
 
-	return new_htbl;
+	if (ste_location == 1) {
+		/* On matcher s_anchor we keep an extra refcount */
+		mlx5dr_htbl_get(new_htbl);
+		mlx5dr_htbl_put(cur_htbl);
 
-free_ste_list:
-	/* Clean all ste_info's from the new table */
-	list_for_each_entry_safe(del_ste_info, tmp_ste_info,
-				 &rehash_table_send_list, send_list) {
-		list_del(&del_ste_info->send_list);
-		kfree(del_ste_info);
+		nic_matcher->s_htbl = new_htbl;
 	}
 
+	mlx5dr_htbl_get(miss_anchor);
+	new_htbl->miss_anchor = miss_anchor;
+	new_htbl->pointing_ste = cur_htbl->pointing_ste;
+	new_htbl->pointing_ste->next_htbl = new_htbl;
+
+	/* Both tables are held until the migration completes */
+	mlx5dr_htbl_get(cur_htbl);
+	mlx5dr_htbl_get(new_htbl);
+	cur_htbl->ctrl.may_grow = false;
+
+	rehash->nic_matcher = nic_matcher;
+	rehash->old_htbl = cur_htbl;
+	rehash->new_htbl = new_htbl;
+	memcpy(rehash->bit_mask,
+	       nic_matcher->ste_builder[ste_location - 1].bit_mask,
+	       DR_STE_SIZE_MASK);
+	new_htbl->rehash = rehash;
+	list_add_tail(&rehash->list, &nic_matcher->rehash_list);
+	queue_work(system_unbound_wq, &matcher->rehash_work);
+
+	return new_htbl;
+
 free_new_htbl:
 	mlx5dr_ste_htbl_free(new_htbl);
-free_ste_info:
-	kfree(ste_info);
+free_miss_anchor:
+	mlx5dr_ste_htbl_free(miss_anchor);
+free_rehash:
+	kfree(rehash);
 	mlx5dr_info(dmn, "Failed creating rehash table\n");
 	return NULL;
 }
@@ -469,8 +631,7 @@ free_ste_info:
 static struct mlx5dr_ste_htbl *dr_rule_rehash(struct mlx5dr_rule *rule,
 					      struct mlx5dr_rule_rx_tx *nic_rule,
 					      struct mlx5dr_ste_htbl *cur_htbl,
-					      u8 ste_location,
-					      struct list_head *update_list)
+					      u8 ste_location)
 {
 	struct mlx5dr_domain *dmn = rule->matcher->tbl->dmn;
 	enum mlx5dr_icm_chunk_size new_size;
@@ -482,7 +643,7 @@ static struct mlx5dr_ste_htbl *dr_rule_rehash(struct mlx5dr_rule *rule,
 		return NULL; /* Skip rehash, we already at the max size */
 
 	return dr_rule_rehash_htbl(rule, nic_rule, cur_htbl, ste_location,
-				   update_list, new_size);
+				   new_size);
 }
 
 static struct mlx5dr_ste *
@@ -616,6 +777,10 @@ static bool dr_rule_need_enlarge_hash(struct mlx5dr_ste_htbl *htbl,
 	if (!ctrl->may_grow)
 		return false;
 
+	/* Grow again only once the previous rehash has drained */
+	if (htbl->rehash)
+		return false;
+
 	if (dr_get_bits_per_mask(htbl->byte_mask) * BITS_PER_BYTE <= htbl->chunk_size)
 		return false;
 
@@ -674,7 +839,8 @@ static int dr_rule_handle_action_stes(struct mlx5dr_rule *rule,
 		prev_hw_ste = (i == 0) ? curr_hw_ste : hw_ste_arr + ((i - 1) * DR_STE_SIZE);
 		action_ste = dr_rule_create_collision_htbl(matcher,
 							   nic_matcher,
-							   curr_hw_ste);
+							   curr_hw_ste,
+							   nic_matcher->e_anchor->chunk->icm_addr);
 		if (!action_ste)
 			return -ENOMEM;
 
@@ -728,7 +894,8 @@ static int dr_rule_handle_empty_entry(struct mlx5dr_matcher *matcher,
 	/* new entry -> new branch */
 	list_add_tail(&ste->miss_list_node, miss_list);
 
-	mlx5dr_ste_set_miss_addr(hw_ste, nic_matcher->e_anchor->chunk->icm_addr);
+	mlx5dr_ste_set_miss_addr(hw_ste,
+				 mlx5dr_ste_htbl_miss_addr(nic_matcher, cur_htbl));
 
 	ste->ste_chain_location = ste_location;
 
@@ -785,6 +952,26 @@ dr_rule_handle_ste_branch(struct mlx5dr_rule *rule,
 	nic_dmn = nic_matcher->nic_tbl->nic_dmn;
 
 again:
+	if (cur_htbl->rehash) {
+		struct mlx5dr_ste_htbl_rehash *rehash = cur_htbl->rehash;
+		LIST_HEAD(migrate_list);
+
+		/* Entries with this tag may still live in the table being
+		 * drained, pull their bucket over before looking them up.
+		 */
+		int ret;
+
+		index = mlx5dr_ste_calc_hash_index(hw_ste, rehash->old_htbl);
+		ret = dr_rule_rehash_migrate_bucket(matcher, rehash, index,
+						    &migrate_list);
+		/* Copies made before a failure are live in SW, write them too */
+		if (dr_rule_send_update_list(&migrate_list, dmn, false) || ret) {
+			mlx5dr_err(dmn, "Failed migrating rehash bucket %d\n",
+				   index);
+			return NULL;
+		}
+	}
+
 	index = mlx5dr_ste_calc_hash_index(hw_ste, cur_htbl);
 	miss_list = &cur_htbl->chunk->miss_list[index];
 	ste = &cur_htbl->ste_arr[index];
@@ -820,7 +1007,7 @@ again:
 			mlx5dr_htbl_get(cur_htbl);
 
 			new_htbl = dr_rule_rehash(rule, nic_rule, cur_htbl,
-						  ste_location, send_ste_list);
+						  ste_location);
 			if (!new_htbl) {
 				mlx5dr_htbl_put(cur_htbl);
 				mlx5dr_err(dmn, "Failed creating rehash table, htbl-log_size: %d\n",
@@ -933,23 +1120,30 @@ static bool dr_rule_verify(struct mlx5dr_matcher *matcher,
 }
 
 static int dr_rule_destroy_rule_nic(struct mlx5dr_rule *rule,
-				    struct mlx5dr_rule_rx_tx *nic_rule)
+				    struct mlx5dr_rule_rx_tx *nic_rule,
+				    bool nic_locked)
 {
-	mlx5dr_domain_nic_lock(nic_rule->nic_matcher->nic_tbl->nic_dmn);
+	struct mlx5dr_domain_rx_tx *nic_dmn =
+		nic_rule->nic_matcher->nic_tbl->nic_dmn;
+
+	if (!nic_locked)
+		mlx5dr_domain_nic_lock(nic_dmn);
 	dr_rule_clean_rule_members(rule, nic_rule);
-	mlx5dr_domain_nic_unlock(nic_rule->nic_matcher->nic_tbl->nic_dmn);
+	if (!nic_locked)
+		mlx5dr_domain_nic_unlock(nic_dmn);
 
 	return 0;
 }
 
-static int dr_rule_destroy_rule_fdb(struct mlx5dr_rule *rule)
+static int dr_rule_destroy_rule_fdb(struct mlx5dr_rule *rule,
+				    bool nic_locked)
 {
-	dr_rule_destroy_rule_nic(rule, &rule->rx);
-	dr_rule_destroy_rule_nic(rule, &rule->tx);
+	dr_rule_destroy_rule_nic(rule, &rule->rx, nic_locked);
+	dr_rule_destroy_rule_nic(rule, &rule->tx, nic_locked);
 	return 0;
 }
 
-static int dr_rule_destroy_rule(struct mlx5dr_rule *rule)
+static int dr_rule_destroy_rule(struct mlx5dr_rule *rule, bool nic_locked)
 {
 	struct mlx5dr_domain *dmn = rule->matcher->tbl->dmn;
 
@@ -959,13 +1153,13 @@ static int dr_rule_destroy_rule(struct mlx5dr_rule *rule)
 
 	switch (dmn->type) {
 	case MLX5DR_DOMAIN_TYPE_NIC_RX:
-		dr_rule_destroy_rule_nic(rule, &rule->rx);
+		dr_rule_destroy_rule_nic(rule, &rule->rx, nic_locked);
 		break;
 	case MLX5DR_DOMAIN_TYPE_NIC_TX:
-		dr_rule_destroy_rule_nic(rule, &rule->tx);
+		dr_rule_destroy_rule_nic(rule, &rule->tx, nic_locked);
 		break;
 	case MLX5DR_DOMAIN_TYPE_FDB:
-		dr_rule_destroy_rule_fdb(rule);
+		dr_rule_destroy_rule_fdb(rule, nic_locked);
 		break;
 	default:
 		return -EINVAL;
@@ -1026,7 +1220,8 @@ dr_rule_create_rule_nic(struct mlx5dr_rule *rule,
 			struct mlx5dr_rule_rx_tx *nic_rule,
 			struct mlx5dr_match_param *param,
 			size_t num_actions,
-			struct mlx5dr_action *actions[])
+			struct mlx5dr_action *actions[],
+			bool nic_locked)
 {
 	struct mlx5dr_ste_send_info *ste_info, *tmp_ste_info;
 	struct mlx5dr_matcher *matcher = rule->matcher;
@@ -1049,7 +1244,8 @@ dr_rule_create_rule_nic(struct mlx5dr_rule *rule,
 	if (dr_rule_skip(dmn, nic_dmn->ste_type, &matcher->mask, param))
 		return 0;
 
-	mlx5dr_domain_nic_lock(nic_dmn);
+	if (!nic_locked)
+		mlx5dr_domain_nic_lock(nic_dmn);
 
 	ret = mlx5dr_matcher_select_builders(matcher,
 					     nic_matcher,
@@ -1128,7 +1324,8 @@ dr_rule_create_rule_nic(struct mlx5dr_rule *rule,
 	if (htbl)
 		mlx5dr_htbl_put(htbl);
 
-	mlx5dr_domain_nic_unlock(nic_dmn);
+	if (!nic_locked)
+		mlx5dr_domain_nic_unlock(nic_dmn);
 
 	kfree(hw_ste_arr);
 
@@ -1146,7 +1343,8 @@ free_rule:
 free_hw_ste:
 	kfree(hw_ste_arr);
 out_err:
-	mlx5dr_domain_nic_unlock(nic_dmn);
+	if (!nic_locked)
+		mlx5dr_domain_nic_unlock(nic_dmn);
 	return ret;
 }
 
@@ -1154,7 +1352,8 @@ static int
 dr_rule_create_rule_fdb(struct mlx5dr_rule *rule,
 			struct mlx5dr_match_param *param,
 			size_t num_actions,
-			struct mlx5dr_action *actions[])
+			struct mlx5dr_action *actions[],
+			bool nic_locked)
 {
 	struct mlx5dr_match_param copy_param = {};
 	int ret;
@@ -1165,19 +1364,19 @@ dr_rule_create_rule_fdb(struct mlx5dr_rule *rule,
 	memcpy(&copy_param, param, sizeof(struct mlx5dr_match_param));
 
 	ret = dr_rule_create_rule_nic(rule, &rule->rx, param,
-				      num_actions, actions);
+				      num_actions, actions, nic_locked);
 	if (ret)
 		return ret;
 
 	ret = dr_rule_create_rule_nic(rule, &rule->tx, &copy_param,
-				      num_actions, actions);
+				      num_actions, actions, nic_locked);
 	if (ret)
 		goto destroy_rule_nic_rx;
 
 	return 0;
 
 destroy_rule_nic_rx:
-	dr_rule_destroy_rule_nic(rule, &rule->rx);
+	dr_rule_destroy_rule_nic(rule, &rule->rx, nic_locked);
 	return ret;
 }
 
@@ -1185,19 +1384,21 @@ static struct mlx5dr_rule *
 dr_rule_create_rule(struct mlx5dr_matcher *matcher,
 		    struct mlx5dr_match_parameters *value,
 		    size_t num_actions,
-		    struct mlx5dr_action *actions[])
+		    struct mlx5dr_action *actions[],
+		    bool nic_locked)
 {
 	struct mlx5dr_domain *dmn = matcher->tbl->dmn;
 	struct mlx5dr_match_param param = {};
+	ktime_t start = ktime_get();
 	struct mlx5dr_rule *rule;
 	int ret;
 
 	if (!dr_rule_verify(matcher, value, &param))
-		return NULL;
+		return ERR_PTR(-EINVAL);
 
 	rule = kzalloc(sizeof(*rule), GFP_KERNEL);
 	if (!rule)
-		return NULL;
+		return ERR_PTR(-ENOMEM);
 
 	rule->matcher = matcher;
 	INIT_LIST_HEAD(&rule->rule_actions_list);
@@ -1211,18 +1412,18 @@ dr_rule_create_rule(struct mlx5dr_matcher *matcher,
 	case MLX5DR_DOMAIN_TYPE_NIC_RX:
 		rule->rx.nic_matcher = &matcher->rx;
 		ret = dr_rule_create_rule_nic(rule, &rule->rx, &param,
-					      num_actions, actions);
+					      num_actions, actions, nic_locked);
 		break;
 	case MLX5DR_DOMAIN_TYPE_NIC_TX:
 		rule->tx.nic_matcher = &matcher->tx;
 		ret = dr_rule_create_rule_nic(rule, &rule->tx, &param,
-					      num_actions, actions);
+					      num_actions, actions, nic_locked);
 		break;
 	case MLX5DR_DOMAIN_TYPE_FDB:
 		rule->rx.nic_matcher = &matcher->rx;
 		rule->tx.nic_matcher = &matcher->tx;
 		ret = dr_rule_create_rule_fdb(rule, &param,
-					      num_actions, actions);
+					      num_actions, actions, nic_locked);
 		break;
 	default:
 		ret = -EINVAL;
@@ -1236,6 +1437,8 @@ dr_rule_create_rule(struct mlx5dr_matcher *matcher,
 	list_add_tail(&rule->rule_list, &matcher->rule_list);
 	mutex_unlock(&rule->matcher->tbl->dmn->dbg_mutex);
 
+	mlx5dr_latency_hist_add(&dmn->insert_hist, start);
+
 	return rule;
 
 remove_action_members:
@@ -1243,7 +1446,7 @@ remove_action_members:
 free_rule:
 	kfree(rule);
 	mlx5dr_err(dmn, "Failed creating rule\n");
-	return NULL;
+	return ERR_PTR(ret);
 }
 
 struct mlx5dr_rule *mlx5dr_rule_create(struct mlx5dr_matcher *matcher,
@@ -1255,9 +1458,11 @@ struct mlx5dr_rule *mlx5dr_rule_create(struct mlx5dr_matcher *matcher,
 
 	refcount_inc(&matcher->refcount);
 
-	rule = dr_rule_create_rule(matcher, value, num_actions, actions);
-	if (!rule)
+	rule = dr_rule_create_rule(matcher, value, num_actions, actions, false);
+	if (IS_ERR(rule)) {
 		refcount_dec(&matcher->refcount);
+		return NULL;
+	}
 
 	return rule;
 }
@@ -1267,9 +1472,220 @@ int mlx5dr_rule_destroy(struct mlx5dr_rule *rule)
 	struct mlx5dr_matcher *matcher = rule->matcher;
 	int ret;
 
-	ret = dr_rule_destroy_rule(rule);
+	ret = dr_rule_destroy_rule(rule, false);
 	if (!ret)
 		refcount_dec(&matcher->refcount);
 
 	return ret;
 }
+
+struct dr_rule_queue_req {
+	struct list_head list;
+	/* Set for an insert, the rule is set for a delete */
+	struct mlx5dr_matcher *matcher;
+	struct mlx5dr_rule *rule;
+	mlx5dr_rule_queue_cb cb;
+	void *cb_ctx;
+	int err;
+	struct mlx5dr_match_parameters value;
+	size_t num_actions;
+	struct mlx5dr_action **actions;
+	u64 data[];
+};
+
+static void dr_rule_queue_run_batch(struct mlx5dr_rule_queue *queue,
+				    struct list_head *batch)
+{
+	struct mlx5dr_domain *dmn = queue->dmn;
+	struct dr_rule_queue_req *req, *tmp;
+	struct mlx5dr_matcher *matcher;
+
+	/* The whole batch is built under one domain lock and its STE writes
+	 * share the send ring doorbells, callers are completed only after
+	 * the last doorbell of the batch was rung.
+	 */
+	mlx5dr_domain_lock(dmn);
+	mlx5dr_send_ring_batch_begin(dmn);
+
+	list_for_each_entry(req, batch, list) {
+		if (req->matcher) {
+			req->rule = dr_rule_create_rule(req->matcher,
+							&req->value,
+							req->num_actions,
+							req->actions, true);
+			if (IS_ERR(req->rule)) {
+				refcount_dec(&req->matcher->refcount);
+				req->err = PTR_ERR(req->rule);
+				req->rule = NULL;
+			}
+		} else {
+			matcher = req->rule->matcher;
+			req->err = dr_rule_destroy_rule(req->rule, true);
+			if (!req->err) {
+				refcount_dec(&matcher->refcount);
+				req->rule = NULL;
+			}
+		}
+	}
+
+	mlx5dr_send_ring_batch_end(dmn);
+	mlx5dr_domain_unlock(dmn);
+
+	list_for_each_entry_safe(req, tmp, batch, list) {
+		list_del(&req->list);
+		if (req->cb)
+			req->cb(req->rule, req->err, req->cb_ctx);
+		kfree(req);
+	}
+}
+
+static void dr_rule_queue_work(struct work_struct *work)
+{
+	struct mlx5dr_rule_queue *queue =
+		container_of(work, struct mlx5dr_rule_queue, work);
+	LIST_HEAD(batch);
+	u32 num;
+
+	do {
+		spin_lock(&queue->lock);
+		for (num = 0; num < queue->batch_size &&
+		     !list_empty(&queue->pending); num++)
+			list_move_tail(queue->pending.next, &batch);
+		spin_unlock(&queue->lock);
+
+		if (num)
+			dr_rule_queue_run_batch(queue, &batch);
+	} while (num);
+}
+
+static void dr_rule_queue_post(struct mlx5dr_rule_queue *queue,
+			       struct dr_rule_queue_req *req)
+{
+	spin_lock(&queue->lock);
+	list_add_tail(&req->list, &queue->pending);
+	spin_unlock(&queue->lock);
+
+	queue_work(queue->wq, &queue->work);
+}
+
+/**
+ * mlx5dr_rule_queue_create: create a queue for batched rule updates.
+ *
+ *     @dmn:        Domain the queued rules belong to
+ *     @batch_size: Max number of rules built under one lock and
+ *                  doorbell batch
+ *
+ * Return: the queue or NULL on failure.
+ */
+struct mlx5dr_rule_queue *
+mlx5dr_rule_queue_create(struct mlx5dr_domain *dmn, u32 batch_size)
+{
+	struct mlx5dr_rule_queue *queue;
+
+	if (!batch_size)
+		return NULL;
+
+	queue = kzalloc(sizeof(*queue), GFP_KERNEL);
+	if (!queue)
+		return NULL;
+
+	queue->wq = alloc_ordered_workqueue("mlx5dr_rule_queue", 0);
+	if (!queue->wq) {
+		kfree(queue);
+		return NULL;
+	}
+
+	queue->dmn = dmn;
+	queue->batch_size = batch_size;
+	spin_lock_init(&queue->lock);
+	INIT_LIST_HEAD(&queue->pending);
+	INIT_WORK(&queue->work, dr_rule_queue_work);
+	refcount_inc(&dmn->refcount);
+
+	return queue;
+}
+
+/* Completes all queued requests before releasing the queue */
+void mlx5dr_rule_queue_destroy(struct mlx5dr_rule_queue *queue)
+{
+	destroy_workqueue(queue->wq);
+	refcount_dec(&queue->dmn->refcount);
+	kfree(queue);
+}
+
+void mlx5dr_rule_queue_flush(struct mlx5dr_rule_queue *queue)
+{
+	flush_workqueue(queue->wq);
+}
+
+/**
+ * mlx5dr_rule_queue_create_rule: queue a rule insertion.
+ *
+ *     @queue:       Rule queue
+ *     @matcher:     Matcher of the queue domain
+ *     @value:       Match value, copied
+ *     @num_actions: Number of actions
+ *     @actions:     Actions, the array is copied but the actions must stay
+ *                   alive until the callback is called
+ *     @cb:          Called with the new rule or with an error
+ *     @cb_ctx:      Callback context
+ *
+ * Return: 0 if the request was queued.
+ */
+int mlx5dr_rule_queue_create_rule(struct mlx5dr_rule_queue *queue,
+				  struct mlx5dr_matcher *matcher,
+				  struct mlx5dr_match_parameters *value,
+				  size_t num_actions,
+				  struct mlx5dr_action *actions[],
+				  mlx5dr_rule_queue_cb cb, void *cb_ctx)
+{
+	struct dr_rule_queue_req *req;
+	size_t match_sz;
+
+	if (matcher->tbl->dmn != queue->dmn)
+		return -EINVAL;
+
+	match_sz = ALIGN(value->match_sz, sizeof(u64));
+	req = kzalloc(sizeof(*req) + match_sz +
+		      num_actions * sizeof(*actions), GFP_KERNEL);
+	if (!req)
+		return -ENOMEM;
+
+	req->value.match_sz = value->match_sz;
+	req->value.match_buf = req->data;
+	memcpy(req->data, value->match_buf, value->match_sz);
+	req->num_actions = num_actions;
+	req->actions = (void *)req->data + match_sz;
+	memcpy(req->actions, actions, num_actions * sizeof(*actions));
+	req->matcher = matcher;
+	req->cb = cb;
+	req->cb_ctx = cb_ctx;
+
+	/* Held by the rule once created, like mlx5dr_rule_create() */
+	refcount_inc(&matcher->refcount);
+	dr_rule_queue_post(queue, req);
+
+	return 0;
+}
+
+/* The callback gets NULL once the rule is gone, or the rule on error */
+int mlx5dr_rule_queue_destroy_rule(struct mlx5dr_rule_queue *queue,
+				   struct mlx5dr_rule *rule,
+				   mlx5dr_rule_queue_cb cb, void *cb_ctx)
+{
+	struct dr_rule_queue_req *req;
+
+	if (rule->matcher->tbl->dmn != queue->dmn)
+		return -EINVAL;
+
+	req = kzalloc(sizeof(*req), GFP_KERNEL);
+	if (!req)
+		return -ENOMEM;
+
+	req->rule = rule;
+	req->cb = cb;
+	req->cb_ctx = cb_ctx;
+	dr_rule_queue_post(queue, req);
+
+	return 0;
+}
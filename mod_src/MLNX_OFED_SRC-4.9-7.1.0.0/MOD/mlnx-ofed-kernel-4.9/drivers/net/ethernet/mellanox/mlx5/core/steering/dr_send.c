@@ -232,9 +232,10 @@ static void dr_cmd_notify_hw(struct mlx5dr_qp *dr_qp, void *ctrl)
 	mlx5_write64(ctrl, dr_qp->uar->map + MLX5_BF_OFFSET);
 }
 
-static void dr_rdma_segments(struct mlx5dr_qp *dr_qp, u64 remote_addr,
-			     u32 rkey, struct dr_data_seg *data_seg,
-			     u32 opcode, int nreq)
+static struct mlx5_wqe_ctrl_seg *
+dr_rdma_segments(struct mlx5dr_qp *dr_qp, u64 remote_addr,
+		 u32 rkey, struct dr_data_seg *data_seg,
+		 u32 opcode, int nreq)
 {
 	struct mlx5_wqe_raddr_seg *wq_raddr;
 	struct mlx5_wqe_ctrl_seg *wq_ctrl;
@@ -268,14 +269,32 @@ static void dr_rdma_segments(struct mlx5dr_qp *dr_qp, u64 remote_addr,
 
 	if (nreq)
 		dr_cmd_notify_hw(dr_qp, wq_ctrl);
+
+	return wq_ctrl;
 }
 
-static void dr_post_send(struct mlx5dr_qp *dr_qp, struct postsend_info *send_info)
+static void dr_post_send(struct mlx5dr_send_ring *send_ring,
+			 struct postsend_info *send_info)
 {
+	struct mlx5dr_qp *dr_qp = send_ring->qp;
+	struct mlx5_wqe_ctrl_seg *wq_ctrl;
+	int nreq = 1;
+
+	/* Inside a batch the doorbell is rung only together with a signaled
+	 * WQE, so the hw never lags more than signal_th WQEs behind the ring
+	 * buffer slots it reads from. Closing the batch rings the rest.
+	 */
+	if (send_ring->batch_depth &&
+	    !(send_info->write.send_flags | send_info->read.send_flags))
+		nreq = 0;
+
 	dr_rdma_segments(dr_qp, send_info->remote_addr, send_info->rkey,
 			 &send_info->write, MLX5_OPCODE_RDMA_WRITE, 0);
-	dr_rdma_segments(dr_qp, send_info->remote_addr, send_info->rkey,
-			 &send_info->read, MLX5_OPCODE_RDMA_READ, 1);
+	wq_ctrl = dr_rdma_segments(dr_qp, send_info->remote_addr,
+				   send_info->rkey, &send_info->read,
+				   MLX5_OPCODE_RDMA_READ, nreq);
+
+	send_ring->db_ctrl = nreq ? NULL : wq_ctrl;
 }
 
 /**
@@ -387,7 +406,11 @@ static int dr_postsend_icm_data(struct mlx5dr_domain *dmn,
 	if (ret)
 		goto out_unlock;
 
-	if (send_info->write.length > dmn->info.max_inline_size) {
+	/* A batched WQE may be fetched long after the caller released its
+	 * buffer, so batched data is always staged in the ring mr.
+	 */
+	if (send_ring->batch_depth ||
+	    send_info->write.length > dmn->info.max_inline_size) {
 		buff_offset = (send_ring->tx_head &
 			       (dmn->send_ring->signal_th - 1)) *
 			send_ring->max_post_send_size;
@@ -401,7 +424,7 @@ static int dr_postsend_icm_data(struct mlx5dr_domain *dmn,
 
 	send_ring->tx_head++;
 	dr_fill_data_segs(send_ring, send_info);
-	dr_post_send(send_ring->qp, send_info);
+	dr_post_send(send_ring, send_info);
 
 out_unlock:
 	spin_unlock(&send_ring->lock);
@@ -436,6 +459,36 @@ static int dr_get_tbl_copy_details(struct mlx5dr_domain *dmn,
 	return 0;
 }
 
+/**
+ * mlx5dr_send_ring_batch_begin: defer the send ring doorbell.
+ *
+ *     @dmn: Domain
+ *
+ * STE writes posted until the matching mlx5dr_send_ring_batch_end() are
+ * chained in the send queue and handed to the hw with one doorbell per
+ * signal_th WQEs instead of one per write. Batches may nest.
+ */
+void mlx5dr_send_ring_batch_begin(struct mlx5dr_domain *dmn)
+{
+	struct mlx5dr_send_ring *send_ring = dmn->send_ring;
+
+	spin_lock(&send_ring->lock);
+	send_ring->batch_depth++;
+	spin_unlock(&send_ring->lock);
+}
+
+void mlx5dr_send_ring_batch_end(struct mlx5dr_domain *dmn)
+{
+	struct mlx5dr_send_ring *send_ring = dmn->send_ring;
+
+	spin_lock(&send_ring->lock);
+	if (!--send_ring->batch_depth && send_ring->db_ctrl) {
+		dr_cmd_notify_hw(send_ring->qp, send_ring->db_ctrl);
+		send_ring->db_ctrl = NULL;
+	}
+	spin_unlock(&send_ring->lock);
+}
+
 /**
  * mlx5dr_send_postsend_ste: write size bytes into offset from the hw cm.
  *
@@ -372,7 +372,7 @@ dr_ste_remove_head_ste(struct mlx5dr_ste *ste,
 	 * touches bit_mask area which doesn't exist at ste->hw_ste.
 	 */
 	memcpy(tmp_ste.hw_ste, ste->hw_ste, DR_STE_SIZE_REDUCED);
-	miss_addr = nic_matcher->e_anchor->chunk->icm_addr;
+	miss_addr = mlx5dr_ste_htbl_miss_addr(nic_matcher, stats_tbl);
 	mlx5dr_ste_always_miss_addr(&tmp_ste, miss_addr);
 	memcpy(ste->hw_ste, tmp_ste.hw_ste, DR_STE_SIZE_REDUCED);
 
@@ -716,6 +716,9 @@ int mlx5dr_ste_htbl_free(struct mlx5dr_ste_htbl *htbl)
 	if (htbl->refcount)
 		return -EBUSY;
 
+	if (htbl->miss_anchor)
+		mlx5dr_htbl_put(htbl->miss_anchor);
+
 	mlx5dr_icm_free_chunk(htbl->chunk);
 	kfree(htbl);
 	return 0;
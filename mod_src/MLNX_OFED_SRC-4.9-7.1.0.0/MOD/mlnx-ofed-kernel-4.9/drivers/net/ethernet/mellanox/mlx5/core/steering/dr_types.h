@@ -167,6 +167,25 @@ struct mlx5dr_ste_htbl {
 	struct mlx5dr_ste *pointing_ste;
 
 	struct mlx5dr_ste_htbl_ctrl ctrl;
+
+	/* Set on a table created by rehash, misses continue through it */
+	struct mlx5dr_ste_htbl *miss_anchor;
+	/* Set while entries are migrated into this table */
+	struct mlx5dr_ste_htbl_rehash *rehash;
+};
+
+/* Incremental rehash of old_htbl into new_htbl. While it runs the miss
+ * anchor of new_htbl hits old_htbl, so lookups go through both tables.
+ * Buckets of old_htbl are migrated in the background in index order, or
+ * on demand when an insert hashes into a bucket not migrated yet.
+ */
+struct mlx5dr_ste_htbl_rehash {
+	struct list_head list;
+	struct mlx5dr_matcher_rx_tx *nic_matcher;
+	struct mlx5dr_ste_htbl *old_htbl;
+	struct mlx5dr_ste_htbl *new_htbl;
+	u8 bit_mask[DR_STE_SIZE_MASK];
+	u32 next_idx;
 };
 
 struct mlx5dr_ste_send_info {
@@ -664,6 +683,24 @@ struct mlx5dr_domain_info {
 	struct mlx5dr_cmd_caps caps;
 };
 
+#define DR_LATENCY_HIST_BUCKETS 16
+
+/* Bucket 0 counts calls under 1us, bucket i calls of [2^(i-1), 2^i) us
+ * and the last bucket everything longer.
+ */
+struct mlx5dr_latency_hist {
+	atomic64_t bucket[DR_LATENCY_HIST_BUCKETS];
+};
+
+static inline void mlx5dr_latency_hist_add(struct mlx5dr_latency_hist *hist,
+					   ktime_t start)
+{
+	u64 us = ktime_us_delta(ktime_get(), start);
+
+	atomic64_inc(&hist->bucket[min_t(u32, fls64(us),
+					 DR_LATENCY_HIST_BUCKETS - 1)]);
+}
+
 struct mlx5dr_domain_cache {
 	struct mlx5dr_fw_recalc_cs_ft **recalc_cs_ft;
 };
@@ -682,6 +719,8 @@ struct mlx5dr_domain {
 	struct mlx5dr_domain_cache cache;
 	struct list_head tbl_list;
 	struct mutex dbg_mutex; /* protects dump resources */
+	struct mlx5dr_latency_hist insert_hist;
+	struct mlx5dr_latency_hist rehash_hist;
 
 };
 
@@ -716,6 +755,8 @@ struct mlx5dr_matcher_rx_tx {
 	u8 num_of_builders_arr[DR_RULE_IPV_MAX][DR_RULE_IPV_MAX];
 	u64 default_icm_addr;
 	struct mlx5dr_table_rx_tx *nic_tbl;
+	/* Pending mlx5dr_ste_htbl_rehash, oldest first */
+	struct list_head rehash_list;
 };
 
 struct mlx5dr_matcher {
@@ -729,6 +770,7 @@ struct mlx5dr_matcher {
 	refcount_t refcount;
 	struct mlx5dv_flow_matcher *dv_matcher;
 	struct list_head rule_list;
+	struct work_struct rehash_work;
 };
 
 struct mlx5dr_rule_member {
@@ -823,6 +865,17 @@ struct mlx5dr_rule {
 
 void mlx5dr_rule_update_rule_member(struct mlx5dr_ste *new_ste,
 				    struct mlx5dr_ste *ste);
+void mlx5dr_rule_rehash_work(struct work_struct *work);
+void mlx5dr_rule_rehash_drain(struct mlx5dr_matcher *matcher);
+
+struct mlx5dr_rule_queue {
+	struct mlx5dr_domain *dmn;
+	struct workqueue_struct *wq;
+	struct work_struct work;
+	spinlock_t lock; /* Protects the pending list */
+	struct list_head pending;
+	u32 batch_size;
+};
 
 struct mlx5dr_icm_chunk {
 	struct mlx5dr_icm_buddy_mem *buddy_mem;
@@ -841,6 +894,19 @@ struct mlx5dr_icm_chunk {
 	struct list_head *miss_list;
 };
 
+/* Where a miss in htbl continues: the end anchor of the matcher, or the
+ * miss anchor of a table created by rehash.
+ */
+static inline u64
+mlx5dr_ste_htbl_miss_addr(struct mlx5dr_matcher_rx_tx *nic_matcher,
+			  struct mlx5dr_ste_htbl *htbl)
+{
+	if (htbl->miss_anchor)
+		return htbl->miss_anchor->chunk->icm_addr;
+
+	return nic_matcher->e_anchor->chunk->icm_addr;
+}
+
 static inline void mlx5dr_domain_nic_lock(struct mlx5dr_domain_rx_tx *nic_dmn)
 {
         mutex_lock(&nic_dmn->mutex);
@@ -1046,6 +1112,7 @@ int mlx5dr_cmd_query_gid(struct mlx5_core_dev *mdev, u8 vhca_port_num,
 struct mlx5dr_icm_pool *mlx5dr_icm_pool_create(struct mlx5dr_domain *dmn,
 					       enum mlx5dr_icm_type icm_type);
 void mlx5dr_icm_pool_destroy(struct mlx5dr_icm_pool *pool);
+int mlx5dr_icm_pool_sync(struct mlx5dr_icm_pool *pool);
 
 struct mlx5dr_icm_chunk *
 mlx5dr_icm_alloc_chunk(struct mlx5dr_icm_pool *pool,
@@ -1127,12 +1194,18 @@ struct mlx5dr_send_ring {
 	spinlock_t lock; /* Protect the send ring */
 	/* send_ring is not usable in err state */
 	bool err_state;
+	/* Open batches, the doorbell is deferred while non zero */
+	u32 batch_depth;
+	/* Last posted WQE whose doorbell was deferred */
+	void *db_ctrl;
 };
 
 int mlx5dr_send_ring_alloc(struct mlx5dr_domain *dmn);
 void mlx5dr_send_ring_free(struct mlx5dr_domain *dmn,
 			   struct mlx5dr_send_ring *send_ring);
 int mlx5dr_send_ring_force_drain(struct mlx5dr_domain *dmn);
+void mlx5dr_send_ring_batch_begin(struct mlx5dr_domain *dmn);
+void mlx5dr_send_ring_batch_end(struct mlx5dr_domain *dmn);
 int mlx5dr_send_postsend_ste(struct mlx5dr_domain *dmn,
 			     struct mlx5dr_ste *ste,
 			     u8 *data,
@@ -38,6 +38,11 @@ struct mlx5dr_action_dest {
 	struct mlx5dr_action *reformat;
 };
 
+struct mlx5dr_rule_queue;
+
+typedef void (*mlx5dr_rule_queue_cb)(struct mlx5dr_rule *rule, int err,
+				     void *ctx);
+
 #ifdef CONFIG_MLX5_SW_STEERING
 
 struct mlx5dr_domain *
@@ -77,6 +82,24 @@ mlx5dr_rule_create(struct mlx5dr_matcher *matcher,
 
 int mlx5dr_rule_destroy(struct mlx5dr_rule *rule);
 
+struct mlx5dr_rule_queue *
+mlx5dr_rule_queue_create(struct mlx5dr_domain *dmn, u32 batch_size);
+
+void mlx5dr_rule_queue_destroy(struct mlx5dr_rule_queue *queue);
+
+void mlx5dr_rule_queue_flush(struct mlx5dr_rule_queue *queue);
+
+int mlx5dr_rule_queue_create_rule(struct mlx5dr_rule_queue *queue,
+				  struct mlx5dr_matcher *matcher,
+				  struct mlx5dr_match_parameters *value,
+				  size_t num_actions,
+				  struct mlx5dr_action *actions[],
+				  mlx5dr_rule_queue_cb cb, void *cb_ctx);
+
+int mlx5dr_rule_queue_destroy_rule(struct mlx5dr_rule_queue *queue,
+				   struct mlx5dr_rule *rule,
+				   mlx5dr_rule_queue_cb cb, void *cb_ctx);
+
 int mlx5dr_table_set_miss_action(struct mlx5dr_table *tbl,
 				 struct mlx5dr_action *action);
 
@@ -134,6 +157,7 @@ mlx5dr_is_supported(struct mlx5_core_dev *dev)
 
 int mlx5dr_dbg_init_dump(struct mlx5dr_domain *dmn);
 void mlx5dr_dbg_cleanup_dump(struct mlx5dr_domain *dmn);
+void mlx5dr_dbg_init_bench(struct mlx5_core_dev *dev);
 
 #else /* CONFIG_MLX5_SW_STEERING */
 
@@ -183,6 +207,28 @@ mlx5dr_rule_create(struct mlx5dr_matcher *matcher,
 static inline int
 mlx5dr_rule_destroy(struct mlx5dr_rule *rule) { return 0; }
 
+static inline struct mlx5dr_rule_queue *
+mlx5dr_rule_queue_create(struct mlx5dr_domain *dmn, u32 batch_size) { return NULL; }
+
+static inline void
+mlx5dr_rule_queue_destroy(struct mlx5dr_rule_queue *queue) {}
+
+static inline void
+mlx5dr_rule_queue_flush(struct mlx5dr_rule_queue *queue) {}
+
+static inline int
+mlx5dr_rule_queue_create_rule(struct mlx5dr_rule_queue *queue,
+			      struct mlx5dr_matcher *matcher,
+			      struct mlx5dr_match_parameters *value,
+			      size_t num_actions,
+			      struct mlx5dr_action *actions[],
+			      mlx5dr_rule_queue_cb cb, void *cb_ctx) { return -EOPNOTSUPP; }
+
+static inline int
+mlx5dr_rule_queue_destroy_rule(struct mlx5dr_rule_queue *queue,
+			       struct mlx5dr_rule *rule,
+			       mlx5dr_rule_queue_cb cb, void *cb_ctx) { return -EOPNOTSUPP; }
+
 static inline int
 mlx5dr_table_set_miss_action(struct mlx5dr_table *tbl,
 			     struct mlx5dr_action *action) { return 0; }
@@ -242,6 +288,9 @@ mlx5dr_action_destroy(struct mlx5dr_action *action) { return 0; }
 static inline bool
 mlx5dr_is_supported(struct mlx5_core_dev *dev) { return false; }
 
+static inline void
+mlx5dr_dbg_init_bench(struct mlx5_core_dev *dev) {}
+
 #endif /* CONFIG_MLX5_SW_STEERING */
 
 #endif /* _MLX5DR_H_ */
@@ -564,12 +564,14 @@ struct mlx5_fc_pool {
 	int threshold;
 };
 
+/* Aging counters are sampled on a wheel of this many rounds */
+#define MLX5_FC_STATS_WHEEL_SLOTS 4
+
 struct mlx5_fc_stats {
-#if defined(HAVE_IDR_RT) || defined(HAVE_IDR_GET_NEXT_EXPORTED)
-	spinlock_t counters_idr_lock; /* protects counters_idr */
-	struct idr counters_idr;
-#endif
-	struct list_head counters;
+	struct list_head wheel[MLX5_FC_STATS_WHEEL_SLOTS];
+	u32 round;
+	spinlock_t changed_lock; /* protects changed */
+	struct list_head changed;
 	struct llist_head addlist;
 	struct llist_head dellist;
 
@@ -637,9 +639,11 @@ struct mlx5_priv {
 	struct delayed_work	gc_dwork;
 	bool			gc_allowed;
 	struct rb_root		page_root;
+	struct radix_tree_root	page_chunks;
+	bool			page_chunks_disabled;
 	int			fw_pages;
 	atomic_t		reg_pages;
-	struct list_head	free_list;
+	struct radix_tree_root	free_lists;
 	int			vfs_pages;
 	int			peer_pf_pages;
 
@@ -896,6 +900,9 @@ struct mlx5_core_dev {
 	struct mlx5_local_lb local_lb;
 	enum mlx5_coredev_type coredev_type;
 	u32                      vsc_addr;
+#ifdef CONFIG_MLX5_FW_EMU
+	struct mlx5_fw_emu	*fw_emu;
+#endif
 };
 
 struct mlx5_db {
@@ -1116,6 +1123,17 @@ int mlx5_cmd_exec(struct mlx5_core_dev *dev, void *in, int in_size, void *out,
 		  int out_size);
 int mlx5_cmd_exec_polling(struct mlx5_core_dev *dev, void *in, int in_size,
 			  void *out, int out_size);
+
+struct mlx5_cmd_batch_ent {
+	void	*in;
+	int	in_size;
+	void	*out;
+	int	out_size;
+	int	err;
+};
+
+int mlx5_cmd_exec_batch(struct mlx5_core_dev *dev,
+			struct mlx5_cmd_batch_ent *ents, int num);
 void mlx5_cmd_mbox_status(void *out, u8 *status, u32 *syndrome);
 
 int mlx5_core_query_special_contexts(struct mlx5_core_dev *dev);
@@ -188,6 +188,8 @@ int mlx5_destroy_flow_table(struct mlx5_flow_table *ft);
  */
 struct mlx5_flow_group *
 mlx5_create_flow_group(struct mlx5_flow_table *ft, u32 *in);
+int mlx5_create_flow_groups(struct mlx5_flow_table *ft, u32 **in,
+			    int num, struct mlx5_flow_group **fgs);
 void mlx5_destroy_flow_group(struct mlx5_flow_group *fg);
 
 struct mlx5_fs_vlan {
@@ -226,6 +228,12 @@ mlx5_add_flow_rules(struct mlx5_flow_table *ft,
 		    struct mlx5_flow_act *flow_act,
 		    struct mlx5_flow_destination *dest,
 		    int num_dest);
+int mlx5_add_flow_rules_bulk(struct mlx5_flow_table *ft,
+			     struct mlx5_flow_spec *specs, int num,
+			     struct mlx5_flow_act *flow_act,
+			     struct mlx5_flow_destination *dest,
+			     int num_dest,
+			     struct mlx5_flow_handle **handles);
 void mlx5_del_flow_rules(struct mlx5_flow_handle *fr);
 
 int mlx5_modify_rule_destination(struct mlx5_flow_handle *handler,
@@ -235,14 +243,19 @@ int mlx5_modify_rule_destination(struct mlx5_flow_handle *handler,
 struct mlx5_fc *mlx5_fc_create(struct mlx5_core_dev *dev, bool aging);
 void mlx5_fc_link_dummies(struct mlx5_fc *counter, struct mlx5_fc **dummies, int nr_dummies);
 void mlx5_fc_unlink_dummies(struct mlx5_fc *counter);
-struct mlx5_fc *mlx5_fc_alloc_dummy_counter(void);
+struct mlx5_fc *mlx5_fc_alloc_dummy_counter(void *owner);
 void mlx5_fc_free_dummy_counter(struct mlx5_fc *counter);
+void *mlx5_fc_dummy_owner(struct mlx5_fc *counter);
 void mlx5_fc_destroy(struct mlx5_core_dev *dev, struct mlx5_fc *counter);
 void mlx5_fc_query_cached(struct mlx5_fc *counter,
 			  u64 *bytes, u64 *packets, u64 *lastuse);
+u64 mlx5_fc_query_lastuse(struct mlx5_fc *counter);
 int mlx5_fc_query(struct mlx5_core_dev *dev, struct mlx5_fc *counter,
 		  u64 *packets, u64 *bytes);
 u32 mlx5_fc_id(struct mlx5_fc *counter);
+void mlx5_fc_query_changed(struct mlx5_core_dev *dev,
+			   void (*cb)(struct mlx5_fc *counter, void *ctx),
+			   void *ctx);
 
 int mlx5_fs_add_rx_underlay_qpn(struct mlx5_core_dev *dev, u32 underlay_qpn);
 int mlx5_fs_remove_rx_underlay_qpn(struct mlx5_core_dev *dev, u32 underlay_qpn);
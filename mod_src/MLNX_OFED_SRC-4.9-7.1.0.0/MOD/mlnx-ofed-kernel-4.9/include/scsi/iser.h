@@ -37,6 +37,12 @@
 #define ISERT_ZBVA_NOT_USED		0x80
 #define ISERT_SEND_W_INV_NOT_USED	0x40
 
+/* multi-channel session negotiation (iser_mchan_hdr) */
+#define ISER_MCHAN_MAGIC		0x4d43
+#define ISER_MCHAN_REQ			1
+#define ISER_MCHAN_JOIN			2
+#define ISERT_MCHAN_ACK			3
+
 #define ISCSI_CTRL	0x10
 #define ISER_HELLO	0x20
 #define ISER_HELLORPLY	0x30
@@ -56,6 +62,53 @@ struct iser_cm_hdr {
 	u8      rsvd[3];
 } __packed;
 
+/**
+ * struct iser_mchan_hdr - multi-channel extension of the CM private data
+ *
+ * Follows struct iser_cm_hdr, which stays as Annex A12 defines it. Peers
+ * that do not know about channels ignore the trailing bytes, and CM pads
+ * private data with zeroes, so a wrong magic means a single channel.
+ *
+ * @magic:        ISER_MCHAN_MAGIC, big endian
+ * @op:           ISER_MCHAN_REQ, ISER_MCHAN_JOIN or ISERT_MCHAN_ACK
+ * @nr_chans:     channel count (REQ/ACK)
+ * @index:        channel index (JOIN)
+ * @rsvd:         reserved
+ * @cookie:       big endian session cookie of the target (ACK/JOIN)
+ */
+struct iser_mchan_hdr {
+	__be16	magic;
+	u8	op;
+	u8	nr_chans;
+	u8	index;
+	u8	rsvd;
+	__be16	cookie;
+} __packed;
+
+/**
+ * struct iser_cm_priv - CM private data of a multi-channel capable peer
+ *
+ * @hdr:          standard iSER CM header
+ * @mchan:        multi-channel extension
+ */
+struct iser_cm_priv {
+	struct iser_cm_hdr	hdr;
+	struct iser_mchan_hdr	mchan;
+} __packed;
+
+static inline const struct iser_mchan_hdr *
+iser_cm_mchan(const void *private_data, u8 private_data_len, u8 op)
+{
+	const struct iser_cm_priv *priv = private_data;
+
+	if (!priv || private_data_len < sizeof(*priv) ||
+	    be16_to_cpu(priv->mchan.magic) != ISER_MCHAN_MAGIC ||
+	    priv->mchan.op != op)
+		return NULL;
+
+	return &priv->mchan;
+}
+
 /**
  * struct iser_ctrl - iSER header of iSCSI control PDU
  *
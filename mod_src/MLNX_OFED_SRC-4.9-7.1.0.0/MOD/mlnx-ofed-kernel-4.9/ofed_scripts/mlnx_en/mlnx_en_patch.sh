@@ -46,6 +46,7 @@ cat << EOF
 
 Usage: `basename $0` [--help]: Prints this message
 		[--with-memtrack]: Compile with memtrack kernel module to debug memory leaks
+		[--with-mlx5-fw-emu]: Compile the mlx5 firmware command emulator and the mlx5_fw_emu_bench module
 		[-k|--kernel <kernel version>]: Build package for this kernel version. Default: $KER_UNAME_R
 		[-s|--kernel-sources  <path to the kernel sources>]: Use these kernel sources for the build. Default: $KER_PATH
 		--with-linux=DIR  kernel sources directory [/lib/modules/$(uname -r)/source]
@@ -106,6 +107,12 @@ parseparams() {
 			--with-memtrack)
 				CONFIG_MEMTRACK="m"
 			;;
+			--with-mlx5-fw-emu)
+				CONFIG_MLX5_FW_EMU="y"
+				DEFINE_MLX5_FW_EMU='#undef CONFIG_MLX5_FW_EMU\n#define CONFIG_MLX5_FW_EMU 1'
+				CONFIG_MLX5_FW_EMU_BENCH="m"
+				DEFINE_MLX5_FW_EMU_BENCH='#undef CONFIG_MLX5_FW_EMU_BENCH_MODULE\n#define CONFIG_MLX5_FW_EMU_BENCH_MODULE 1'
+			;;
 			-k | --kernel | --kernel-version)
 				shift
 				KVERSION=$1
@@ -167,6 +174,10 @@ parseparams() {
 				DEFINE_MLX5_EN_TLS='#undef CONFIG_MLX5_EN_TLS'
 				CONFIG_MLX5_TLS=""
 				DEFINE_MLX5_TLS='#undef CONFIG_MLX5_TLS'
+				CONFIG_MLX5_FW_EMU=""
+				DEFINE_MLX5_FW_EMU='#undef CONFIG_MLX5_FW_EMU'
+				CONFIG_MLX5_FW_EMU_BENCH=""
+				DEFINE_MLX5_FW_EMU_BENCH='#undef CONFIG_MLX5_FW_EMU_BENCH_MODULE'
 			;;
 			--without-mlxfw)
 				CONFIG_MLXFW=""
@@ -216,6 +227,8 @@ CONFIG_MLX5_ACCEL="y"
 CONFIG_MLX5_EN_ACCEL_FS="y"
 CONFIG_MLX5_EN_TLS="y"
 CONFIG_MLX5_TLS="y"
+CONFIG_MLX5_FW_EMU=""
+CONFIG_MLX5_FW_EMU_BENCH=""
 CONFIG_MLXFW="m"
 CONFIG_MLNX_BLOCK_REQUEST_MODULE=''
 DEFINE_MLX4_EN_DCB='#undef CONFIG_MLX4_EN_DCB'
@@ -234,6 +247,8 @@ DEFINE_MLX5_ACCEL='#undef CONFIG_MLX5_ACCEL\n#define CONFIG_MLX5_ACCEL 1'
 DEFINE_MLX5_EN_ACCEL_FS='#undef CONFIG_MLX5_EN_ACCEL_FS\n#define CONFIG_MLX5_EN_ACCEL_FS 1'
 DEFINE_MLX5_EN_TLS='#undef CONFIG_MLX5_EN_TLS\n#define CONFIG_MLX5_EN_TLS 1'
 DEFINE_MLX5_TLS='#undef CONFIG_MLX5_TLS\n#define CONFIG_MLX5_TLS 1'
+DEFINE_MLX5_FW_EMU='#undef CONFIG_MLX5_FW_EMU'
+DEFINE_MLX5_FW_EMU_BENCH='#undef CONFIG_MLX5_FW_EMU_BENCH_MODULE'
 DEFINE_MLXFW='#undef CONFIG_MLXFW\n#define CONFIG_MLXFW 1'
 DEFINE_CONFIG_MLNX_BLOCK_REQUEST_MODULE='#undef CONFIG_MLNX_BLOCK_REQUEST_MODULE'
 
@@ -397,6 +412,8 @@ CONFIG_MLX5_EN_ACCEL_FS:=${CONFIG_MLX5_EN_ACCEL_FS}
 CONFIG_MLX5_MPFS:=${CONFIG_MLX5_MPFS}
 CONFIG_MLX5_EN_TLS:=${CONFIG_MLX5_EN_TLS}
 CONFIG_MLX5_TLS:=${CONFIG_MLX5_TLS}
+CONFIG_MLX5_FW_EMU:=${CONFIG_MLX5_FW_EMU}
+CONFIG_MLX5_FW_EMU_BENCH:=${CONFIG_MLX5_FW_EMU_BENCH}
 CONFIG_MLXFW:=${CONFIG_MLXFW}
 CONFIG_MLNX_BLOCK_REQUEST_MODULE:=${CONFIG_MLNX_BLOCK_REQUEST_MODULE}
 EOFCONFIG
@@ -459,6 +476,8 @@ $(echo -e "${DEFINE_MLX5_ACCEL}")
 $(echo -e "${DEFINE_MLX5_EN_ACCEL_FS}")
 $(echo -e "${DEFINE_MLX5_EN_TLS}")
 $(echo -e "${DEFINE_MLX5_TLS}")
+$(echo -e "${DEFINE_MLX5_FW_EMU}")
+$(echo -e "${DEFINE_MLX5_FW_EMU_BENCH}")
 $(echo -e "${DEFINE_MLXFW}")
 $(echo -e "${DEFINE_COMPAT_OLD_VERSION}")
 $(echo -e "${DEFINE_COMPAT_KOBJECT_BACKPORT}")
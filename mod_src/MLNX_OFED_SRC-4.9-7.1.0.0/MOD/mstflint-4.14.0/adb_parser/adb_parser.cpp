@@ -58,6 +58,9 @@ using namespace boost;
 #include <process.h>
 #define OS_PATH_SEP "\\"
 #else
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 #define OS_PATH_SEP "/"
 #endif
 
@@ -69,6 +72,13 @@ using namespace boost;
 
 #define PROGRESS_NODE_CNT   100 // each 100 parsed node call progress callback
 
+// AdbInstance::_lazyFlags, the createLayout parameters of a lazy layout
+#define ADB_LAZY_LAYOUT             0x1
+#define ADB_LAZY_EXPR_EVAL          0x2
+#define ADB_LAZY_IGNORE_MISSING     0x4
+#define ADB_LAZY_ALL_EXCEPTIONS     0x8
+#define ADB_LAZY_MAIN_ROOT          0x10
+
 #ifndef MIN
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 #endif
@@ -333,6 +343,307 @@ const string AdbParser::TAG_ATTR_BIG_ENDIAN = "big_endian_arr";
 const string AdbParser::TAG_ATTR_SINGLE_ENTRY_ARR = "single_entry_arr";
 const string AdbParser::TAG_ATTR_INCLUDE_PATH = "include_path";
 
+/*************************** AdbCache ***************************/
+/*
+ * Compiled form of a loaded Adb, kept at ADB_CACHE_DIR and keyed by the hash of the
+ * adb file and the load parameters. It holds a table of interned strings followed by
+ * flat global, node, field and attribute tables of u_int32_t words, strings are
+ * referred to by their index in the strings table.
+ * The cache is only used when its directories are owned by the current user and are
+ * not writable by anyone else, so it is effectively root only.
+ */
+#define ADB_CACHE_BASE_DIR  "/var/cache/mstflint"
+#define ADB_CACHE_DIR       ADB_CACHE_BASE_DIR "/adb_cache"
+#define ADB_CACHE_MAGIC     0x43424441 // "ADBC"
+#define ADB_CACHE_VERSION   1
+#define ADB_CACHE_ROOT_FILE "ROOT"
+
+enum {
+    ADB_CACHE_GLOBALS = 0,
+    ADB_CACHE_NODES,
+    ADB_CACHE_FIELDS,
+    ADB_CACHE_ATTRS,
+    ADB_CACHE_SECTIONS
+};
+
+typedef struct {
+    u_int32_t magic;
+    u_int32_t version;
+    u_int64_t key;
+    u_int32_t stringsNum;
+    u_int32_t stringsSize; // in bytes
+    u_int32_t sectionSize[ADB_CACHE_SECTIONS]; // in words
+} AdbCacheHeader;
+
+// FNV-1a
+static u_int64_t adbCacheHash(const char *data, size_t len,
+        u_int64_t hash = 0xcbf29ce484222325ULL) {
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ (u_int8_t)data[i]) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static bool adbCacheReadStream(FILE *file, vector<char> &data) {
+    bool ok = !fseek(file, 0, SEEK_END);
+    long size = ok ? ftell(file) : -1;
+    ok = size >= 0 && !fseek(file, 0, SEEK_SET);
+    if (ok) {
+        data.resize(size);
+        ok = !size || fread(&data[0], 1, size, file) == (size_t)size;
+    }
+    return ok;
+}
+
+static bool adbCacheReadFile(const string &fileName, vector<char> &data) {
+    FILE *file = fopen(fileName.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    bool ok = adbCacheReadStream(file, data);
+    fclose(file);
+    return ok;
+}
+
+#ifndef __WIN__
+// Only trust files owned by us that nobody else can write to
+static bool adbCacheIsPrivate(const struct stat &st) {
+    return st.st_uid == geteuid() && !(st.st_mode & (S_IWGRP | S_IWOTH));
+}
+
+// The cache directories must be real directories, not links, that only we can write to
+static bool adbCacheDirTrusted() {
+    struct stat st;
+    return !lstat(ADB_CACHE_BASE_DIR, &st) && S_ISDIR(st.st_mode) && adbCacheIsPrivate(st) &&
+           !lstat(ADB_CACHE_DIR, &st) && S_ISDIR(st.st_mode) && adbCacheIsPrivate(st);
+}
+#endif
+
+static bool adbCacheFileHash(const string &fileName, u_int64_t &hash) {
+    vector<char> data;
+    if (!adbCacheReadFile(fileName, data)) {
+        return false;
+    }
+    hash = adbCacheHash(data.empty() ? "" : &data[0], data.size());
+    return true;
+}
+
+class AdbCacheWriter {
+public:
+    void put(int section, u_int32_t val) {
+        _sections[section].push_back(val);
+    }
+    void putStr(int section, const string &str) {
+        pair<map<string, u_int32_t>::iterator, bool> res = _strIds.insert(
+                pair<string, u_int32_t>(str, _strs.size()));
+        if (res.second) {
+            _strs.push_back(str);
+        }
+        put(section, res.first->second);
+    }
+    void put64(int section, u_int64_t val) {
+        put(section, (u_int32_t)val);
+        put(section, (u_int32_t)(val >> 32));
+    }
+    // Add the attributes to the attributes table and refer to them from section
+    void putAttrs(int section, const AttrsMap &attrs) {
+        put(section, _sections[ADB_CACHE_ATTRS].size());
+        put(ADB_CACHE_ATTRS, attrs.size());
+        for (AttrsMap::const_iterator it = attrs.begin(); it != attrs.end(); it++) {
+            putStr(ADB_CACHE_ATTRS, it->first);
+            putStr(ADB_CACHE_ATTRS, it->second);
+        }
+    }
+    bool write(FILE *file, u_int64_t key) {
+        AdbCacheHeader hdr;
+        vector<u_int32_t> lens;
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.magic = ADB_CACHE_MAGIC;
+        hdr.version = ADB_CACHE_VERSION;
+        hdr.key = key;
+        hdr.stringsNum = _strs.size();
+        for (size_t i = 0; i < _strs.size(); i++) {
+            lens.push_back(_strs[i].size());
+            hdr.stringsSize += _strs[i].size();
+        }
+        for (int i = 0; i < ADB_CACHE_SECTIONS; i++) {
+            hdr.sectionSize[i] = _sections[i].size();
+        }
+        if (fwrite(&hdr, sizeof(hdr), 1, file) != 1 || !writeWords(file, lens)) {
+            return false;
+        }
+        for (size_t i = 0; i < _strs.size(); i++) {
+            if (fwrite(_strs[i].data(), 1, _strs[i].size(), file) != _strs[i].size()) {
+                return false;
+            }
+        }
+        for (int i = 0; i < ADB_CACHE_SECTIONS; i++) {
+            if (!writeWords(file, _sections[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    static bool writeWords(FILE *file, const vector<u_int32_t> &words) {
+        return words.empty() || fwrite(&words[0], sizeof(u_int32_t), words.size(), file) == words.size();
+    }
+
+    map<string, u_int32_t> _strIds;
+    vector<string> _strs;
+    vector<u_int32_t> _sections[ADB_CACHE_SECTIONS];
+};
+
+class AdbCacheReader {
+public:
+    bool open(const string &fileName, u_int64_t key) {
+#ifdef __WIN__
+        (void)fileName;
+        (void)key;
+        return false;
+#else
+        struct stat st;
+        AdbCacheHeader hdr;
+        if (!adbCacheDirTrusted()) {
+            return false;
+        }
+        int fd = ::open(fileName.c_str(), O_RDONLY | O_NOFOLLOW);
+        if (fd < 0) {
+            return false;
+        }
+        FILE *file = fdopen(fd, "rb");
+        if (!file) {
+            close(fd);
+            return false;
+        }
+        // Only trust caches written by us, checked on the file that is actually read
+        bool ok = !fstat(fd, &st) && S_ISREG(st.st_mode) && adbCacheIsPrivate(st) &&
+                  adbCacheReadStream(file, _data);
+        fclose(file);
+        if (!ok || _data.size() < sizeof(hdr)) {
+            return false;
+        }
+        memcpy(&hdr, &_data[0], sizeof(hdr));
+        if (hdr.magic != ADB_CACHE_MAGIC || hdr.version != ADB_CACHE_VERSION || hdr.key != key) {
+            return false;
+        }
+        u_int64_t size = sizeof(hdr) + (u_int64_t)hdr.stringsNum * sizeof(u_int32_t) + hdr.stringsSize;
+        for (int i = 0; i < ADB_CACHE_SECTIONS; i++) {
+            size += (u_int64_t)hdr.sectionSize[i] * sizeof(u_int32_t);
+        }
+        if (size != _data.size()) {
+            return false;
+        }
+        const char *p = &_data[0] + sizeof(hdr);
+        const char *strData = p + hdr.stringsNum * sizeof(u_int32_t);
+        u_int64_t strOff = 0;
+        _strs.resize(hdr.stringsNum);
+        for (u_int32_t i = 0; i < hdr.stringsNum; i++) {
+            u_int32_t len;
+            memcpy(&len, p + i * sizeof(u_int32_t), sizeof(len));
+            if (strOff + len > hdr.stringsSize) {
+                return false;
+            }
+            _strs[i].assign(strData + strOff, len);
+            strOff += len;
+        }
+        p = strData + hdr.stringsSize;
+        for (int i = 0; i < ADB_CACHE_SECTIONS; i++) {
+            _sections[i].resize(hdr.sectionSize[i]);
+            if (hdr.sectionSize[i]) {
+                memcpy(&_sections[i][0], p, hdr.sectionSize[i] * sizeof(u_int32_t));
+            }
+            p += hdr.sectionSize[i] * sizeof(u_int32_t);
+            _pos[i] = 0;
+        }
+        vector<char>().swap(_data);
+        return true;
+#endif
+    }
+    u_int32_t get(int section) {
+        return at(section, _pos[section]++);
+    }
+    const string& getStr(int section) {
+        return str(get(section));
+    }
+    u_int64_t get64(int section) {
+        u_int64_t low = get(section);
+        return low | ((u_int64_t)get(section) << 32);
+    }
+    void getAttrs(int section, AttrsMap &attrs) {
+        u_int32_t idx = get(section);
+        u_int32_t num = at(ADB_CACHE_ATTRS, idx++);
+        for (u_int32_t i = 0; i < num; i++, idx += 2) {
+            attrs[str(at(ADB_CACHE_ATTRS, idx))] = str(at(ADB_CACHE_ATTRS, idx + 1));
+        }
+    }
+    bool done() {
+        for (int i = 0; i < ADB_CACHE_SECTIONS; i++) {
+            if (i != ADB_CACHE_ATTRS && _pos[i] != _sections[i].size()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    u_int32_t at(int section, size_t idx) {
+        if (idx >= _sections[section].size()) {
+            throw AdbException("Truncated ADB cache");
+        }
+        return _sections[section][idx];
+    }
+    const string& str(u_int32_t id) {
+        if (id >= _strs.size()) {
+            throw AdbException("Bad string in ADB cache");
+        }
+        return _strs[id];
+    }
+
+    vector<char> _data;
+    vector<string> _strs;
+    vector<u_int32_t> _sections[ADB_CACHE_SECTIONS];
+    size_t _pos[ADB_CACHE_SECTIONS];
+};
+
+static void adbCachePutField(AdbCacheWriter &w, AdbField *field) {
+    w.putStr(ADB_CACHE_FIELDS, field->name);
+    w.put(ADB_CACHE_FIELDS, field->size);
+    w.put(ADB_CACHE_FIELDS, field->offset);
+    w.putStr(ADB_CACHE_FIELDS, field->desc);
+    w.put(ADB_CACHE_FIELDS, field->definedAsArr);
+    w.put(ADB_CACHE_FIELDS, field->lowBound);
+    w.put(ADB_CACHE_FIELDS, field->highBound);
+    w.put(ADB_CACHE_FIELDS, field->unlimitedArr);
+    w.putStr(ADB_CACHE_FIELDS, field->subNode);
+    w.putAttrs(ADB_CACHE_FIELDS, field->attrs);
+    w.put(ADB_CACHE_FIELDS, field->isReserved);
+    w.putStr(ADB_CACHE_FIELDS, field->condition);
+}
+
+static AdbField* adbCacheGetField(AdbCacheReader &r) {
+    AdbField *field = new AdbField;
+    try {
+        field->name = r.getStr(ADB_CACHE_FIELDS);
+        field->size = r.get(ADB_CACHE_FIELDS);
+        field->offset = r.get(ADB_CACHE_FIELDS);
+        field->desc = r.getStr(ADB_CACHE_FIELDS);
+        field->definedAsArr = r.get(ADB_CACHE_FIELDS);
+        field->lowBound = r.get(ADB_CACHE_FIELDS);
+        field->highBound = r.get(ADB_CACHE_FIELDS);
+        field->unlimitedArr = r.get(ADB_CACHE_FIELDS);
+        field->subNode = r.getStr(ADB_CACHE_FIELDS);
+        r.getAttrs(ADB_CACHE_FIELDS, field->attrs);
+        field->isReserved = r.get(ADB_CACHE_FIELDS);
+        field->condition = r.getStr(ADB_CACHE_FIELDS);
+    } catch (AdbException&) {
+        delete field;
+        throw;
+    }
+    return field;
+}
+
 /*************************** AdbNode ***************************/
 
 /**
@@ -561,7 +872,8 @@ string AdbConfig::toXml() {
  **/
 AdbInstance::AdbInstance() :
     fieldDesc(NULL), nodeDesc(NULL), parent(NULL), offset(0xffffffff), size(0),
-            arrIdx(0), unionSelector(NULL), isDiff(false), userData(NULL)
+            arrIdx(0), unionSelector(NULL), isDiff(false), userData(NULL),
+            _lazyAdb(NULL), _lazyFlags(0)
 
 {
 
@@ -683,6 +995,7 @@ AdbInstance* AdbInstance::getChildByPath(const string &path,
     }
 
     // Search for childName
+    expand();
     AdbInstance *child = NULL;
     for (size_t i = 0; i < subItems.size(); i++) {
         string subName = isCaseSensitive ? subItems[i]->name
@@ -722,6 +1035,7 @@ vector<AdbInstance*> AdbInstance::findChild(const string& childName,
     }
 
     // do that recursively for all child items
+    expand();
     for (size_t i = 0; i < subItems.size(); i++) {
         vector<AdbInstance*> l = subItems[i]->findChild(effName, true);
         childList.insert(childList.end(), l.begin(), l.end());
@@ -980,6 +1294,7 @@ AdbInstance* AdbInstance::getUnionSelectedNodeName(const u_int64_t& selectorVal)
         throw AdbException("Can't find selector for union: " + name);
     }
 
+    expand();
     map < string, u_int64_t > selectorValMap = unionSelector->getEnumMap();
     for (map<string, u_int64_t>::iterator it = selectorValMap.begin(); 
          it != selectorValMap.end(); it++) {
@@ -1018,6 +1333,7 @@ AdbInstance* AdbInstance::getUnionSelectedNodeName(const string& selectorEnum) {
         throw AdbException("Can't find selector for union: " + name);
     }
 
+    expand();
     for (size_t i = 0; i < subItems.size(); i++) {
         if (subItems[i]->getInstanceAttr("selected_by") == selectorEnum) {
             return subItems[i];
@@ -1086,6 +1402,7 @@ bool AdbInstance::isConditionValid(map<string, string> *valuesMap) {
 vector<AdbInstance*> AdbInstance::getLeafFields() {
     vector<AdbInstance*> fields;
 
+    expand();
     for (size_t i = 0; i < subItems.size(); i++) {
         if (subItems[i]->isNode()) {
             vector<AdbInstance*> subFields = subItems[i]->getLeafFields();
@@ -1098,6 +1415,15 @@ vector<AdbInstance*> AdbInstance::getLeafFields() {
     return fields;
 }
 
+/**
+ * Function: AdbInstance::expand
+ **/
+void AdbInstance::expand() {
+    if (_lazyAdb) {
+        _lazyAdb->expandInstance(this);
+    }
+}
+
 /**
  * Function: AdbInstance::pushBuf
  **/
@@ -1123,6 +1449,7 @@ void AdbInstance::print(int indent) {
             offset % 32, (size >> 5) << 2, size % 32, isNode(), isUnion());
 
     if (isNode()) {
+        expand();
         for (size_t i = 0; i < subItems.size(); i++)
             subItems[i]->print(indent + 1);
     }
@@ -1133,7 +1460,7 @@ void AdbInstance::print(int indent) {
  * Function: Adb::Adb
  **/
 Adb::Adb() :
-    bigEndianArr(false), singleEntryArrSupp(false){
+    bigEndianArr(false), singleEntryArrSupp(false), _deferUnionSelectorEval(false), _creatingLayout(false){
 }
 
 /**
@@ -1227,6 +1554,27 @@ bool Adb::load(string fname, bool addReserved, AdbProgress *progressObj,
         }
         _logFile.init(logFileStr, allowMultipleExceptions);
 
+        // The compiled cache serves plain loads into an empty Adb
+        string cacheFile;
+        u_int64_t cacheKey = 0;
+#ifndef __WIN__
+        if (!allowMultipleExceptions && logFileStr.empty() && !progressObj &&
+            includeDir.empty() && nodesMap.empty() && configs.empty() &&
+            includePaths.empty() && includedFiles.empty() &&
+            adbCacheFileHash(fname, cacheKey)) {
+            char params[16];
+            sprintf(params, ";%d%d%d;", addReserved, strict, enforceExtraChecks);
+            string keyStr = fname + params + includePath;
+            char keyHex[32];
+            cacheKey = adbCacheHash(keyStr.c_str(), keyStr.size(), cacheKey);
+            sprintf(keyHex, "%016llx", (unsigned long long)cacheKey);
+            cacheFile = string(ADB_CACHE_DIR OS_PATH_SEP) + keyHex + ".adbc";
+            if (loadCache(cacheFile, cacheKey)) {
+                return true;
+            }
+        }
+#endif
+
         AdbParser p(fname, this, addReserved, progressObj, strict, includePath,
                 enforceExtraChecks);
         if (!p.load()) {
@@ -1253,6 +1601,9 @@ bool Adb::load(string fname, bool addReserved, AdbProgress *progressObj,
             fetchAdbExceptionsMap(ExceptionHolder::getAdbExceptionsMap());
             status = false;
         }
+        if (status && !cacheFile.empty()) {
+            saveCache(cacheFile, cacheKey);
+        }
         return status;
     } catch (AdbException &e) {
         _lastError = e.what_s();
@@ -1263,6 +1614,204 @@ bool Adb::load(string fname, bool addReserved, AdbProgress *progressObj,
     }
 }
 
+/**
+ * Function: Adb::saveCache
+ **/
+void Adb::saveCache(const string &cacheFile, u_int64_t cacheKey) {
+#ifdef __WIN__
+    (void)cacheFile;
+    (void)cacheKey;
+#else
+    AdbCacheWriter w;
+
+    w.putStr(ADB_CACHE_GLOBALS, version);
+    w.putStr(ADB_CACHE_GLOBALS, rootNode);
+    w.putStr(ADB_CACHE_GLOBALS, srcDocName);
+    w.putStr(ADB_CACHE_GLOBALS, srcDocVer);
+    w.putStr(ADB_CACHE_GLOBALS, mainFileName);
+    w.put(ADB_CACHE_GLOBALS, bigEndianArr);
+    w.put(ADB_CACHE_GLOBALS, singleEntryArrSupp);
+    w.put(ADB_CACHE_GLOBALS, includePaths.size());
+    for (size_t i = 0; i < includePaths.size(); i++) {
+        w.putStr(ADB_CACHE_GLOBALS, includePaths[i]);
+    }
+    // Included files are checked against their hash when the cache is loaded
+    w.put(ADB_CACHE_GLOBALS, includedFiles.size());
+    for (IncludeFileMap::iterator it = includedFiles.begin(); it != includedFiles.end(); it++) {
+        u_int64_t hash = 0;
+        if (it->second.includedFromFile != ADB_CACHE_ROOT_FILE &&
+            !adbCacheFileHash(it->second.fullPath, hash)) {
+            return;
+        }
+        w.putStr(ADB_CACHE_GLOBALS, it->first);
+        w.putStr(ADB_CACHE_GLOBALS, it->second.fullPath);
+        w.putStr(ADB_CACHE_GLOBALS, it->second.includedFromFile);
+        w.put(ADB_CACHE_GLOBALS, it->second.includedFromLine);
+        w.put64(ADB_CACHE_GLOBALS, hash);
+    }
+    w.put(ADB_CACHE_GLOBALS, instAttrs.size());
+    for (InstanceAttrs::iterator it = instAttrs.begin(); it != instAttrs.end(); it++) {
+        w.putStr(ADB_CACHE_GLOBALS, it->first);
+        w.putAttrs(ADB_CACHE_GLOBALS, it->second);
+    }
+    w.put(ADB_CACHE_GLOBALS, configs.size());
+    for (size_t i = 0; i < configs.size(); i++) {
+        w.putAttrs(ADB_CACHE_GLOBALS, configs[i]->attrs);
+        w.putAttrs(ADB_CACHE_GLOBALS, configs[i]->enums);
+    }
+    w.put(ADB_CACHE_GLOBALS, nodesMap.size());
+
+    for (NodesMap::iterator it = nodesMap.begin(); it != nodesMap.end(); it++) {
+        AdbNode *node = it->second;
+        w.putStr(ADB_CACHE_NODES, it->first);
+        w.putStr(ADB_CACHE_NODES, node->name);
+        w.put(ADB_CACHE_NODES, node->size);
+        w.put(ADB_CACHE_NODES, node->isUnion);
+        w.putStr(ADB_CACHE_NODES, node->desc);
+        w.putStr(ADB_CACHE_NODES, node->fileName);
+        w.put(ADB_CACHE_NODES, node->lineNumber);
+        w.putAttrs(ADB_CACHE_NODES, node->attrs);
+        w.put(ADB_CACHE_NODES, node->fields.size());
+        w.put(ADB_CACHE_NODES, node->condFields.size());
+        for (size_t i = 0; i < node->fields.size(); i++) {
+            adbCachePutField(w, node->fields[i]);
+        }
+        for (size_t i = 0; i < node->condFields.size(); i++) {
+            adbCachePutField(w, node->condFields[i]);
+        }
+    }
+
+    // Write aside and rename, so a concurrent load never sees a partial cache
+    if ((mkdir(ADB_CACHE_BASE_DIR, 0755) && errno != EEXIST) || (mkdir(ADB_CACHE_DIR, 0700) && errno != EEXIST) ||
+        !adbCacheDirTrusted()) {
+        return;
+    }
+    vector<char> tmpName(cacheFile.begin(), cacheFile.end());
+    const char suffix[] = ".XXXXXX";
+    tmpName.insert(tmpName.end(), suffix, suffix + sizeof(suffix));
+    int fd = mkstemp(&tmpName[0]);
+    if (fd < 0) {
+        return;
+    }
+    string tmpFile(&tmpName[0]);
+    FILE *file = fdopen(fd, "wb");
+    if (!file) {
+        close(fd);
+        unlink(tmpFile.c_str());
+        return;
+    }
+    bool ok = w.write(file, cacheKey);
+    if (fclose(file) || !ok || rename(tmpFile.c_str(), cacheFile.c_str())) {
+        unlink(tmpFile.c_str());
+    }
+#endif
+}
+
+/**
+ * Function: Adb::loadCache
+ **/
+bool Adb::loadCache(const string &cacheFile, u_int64_t cacheKey) {
+    AdbCacheReader r;
+    NodesMap nodes;
+    ConfigList configList;
+    AdbNode *node = NULL;
+
+    if (!r.open(cacheFile, cacheKey)) {
+        return false;
+    }
+    try {
+        string ver = r.getStr(ADB_CACHE_GLOBALS);
+        string root = r.getStr(ADB_CACHE_GLOBALS);
+        string docName = r.getStr(ADB_CACHE_GLOBALS);
+        string docVer = r.getStr(ADB_CACHE_GLOBALS);
+        string mainFile = r.getStr(ADB_CACHE_GLOBALS);
+        bool bigEndian = r.get(ADB_CACHE_GLOBALS);
+        bool singleEntry = r.get(ADB_CACHE_GLOBALS);
+        StringVector paths(r.get(ADB_CACHE_GLOBALS));
+        for (size_t i = 0; i < paths.size(); i++) {
+            paths[i] = r.getStr(ADB_CACHE_GLOBALS);
+        }
+        IncludeFileMap files;
+        u_int32_t num = r.get(ADB_CACHE_GLOBALS);
+        for (u_int32_t i = 0; i < num; i++) {
+            u_int64_t hash = 0;
+            string name = r.getStr(ADB_CACHE_GLOBALS);
+            IncludeFileInfo &info = files[name];
+            info.fullPath = r.getStr(ADB_CACHE_GLOBALS);
+            info.includedFromFile = r.getStr(ADB_CACHE_GLOBALS);
+            info.includedFromLine = r.get(ADB_CACHE_GLOBALS);
+            u_int64_t savedHash = r.get64(ADB_CACHE_GLOBALS);
+            if (info.includedFromFile != ADB_CACHE_ROOT_FILE &&
+                (!adbCacheFileHash(info.fullPath, hash) || hash != savedHash)) {
+                return false;
+            }
+        }
+        InstanceAttrs attrs;
+        num = r.get(ADB_CACHE_GLOBALS);
+        for (u_int32_t i = 0; i < num; i++) {
+            string path = r.getStr(ADB_CACHE_GLOBALS);
+            r.getAttrs(ADB_CACHE_GLOBALS, attrs[path]);
+        }
+        num = r.get(ADB_CACHE_GLOBALS);
+        for (u_int32_t i = 0; i < num; i++) {
+            configList.push_back(new AdbConfig);
+            r.getAttrs(ADB_CACHE_GLOBALS, configList.back()->attrs);
+            r.getAttrs(ADB_CACHE_GLOBALS, configList.back()->enums);
+        }
+
+        num = r.get(ADB_CACHE_GLOBALS);
+        for (u_int32_t i = 0; i < num; i++) {
+            string key = r.getStr(ADB_CACHE_NODES);
+            node = new AdbNode;
+            node->name = r.getStr(ADB_CACHE_NODES);
+            node->size = r.get(ADB_CACHE_NODES);
+            node->isUnion = r.get(ADB_CACHE_NODES);
+            node->desc = r.getStr(ADB_CACHE_NODES);
+            node->fileName = r.getStr(ADB_CACHE_NODES);
+            node->lineNumber = r.get(ADB_CACHE_NODES);
+            r.getAttrs(ADB_CACHE_NODES, node->attrs);
+            u_int32_t fieldsNum = r.get(ADB_CACHE_NODES);
+            u_int32_t condFieldsNum = r.get(ADB_CACHE_NODES);
+            for (u_int32_t j = 0; j < fieldsNum; j++) {
+                node->fields.push_back(adbCacheGetField(r));
+            }
+            for (u_int32_t j = 0; j < condFieldsNum; j++) {
+                node->condFields.push_back(adbCacheGetField(r));
+            }
+            if (!nodes.insert(pair<string, AdbNode*>(key, node)).second) {
+                throw AdbException("Duplicated node in ADB cache");
+            }
+            node = NULL;
+        }
+        if (!r.done() || nodes.empty()) {
+            throw AdbException("Bad ADB cache");
+        }
+
+        version = ver;
+        rootNode = root;
+        srcDocName = docName;
+        srcDocVer = docVer;
+        mainFileName = mainFile;
+        bigEndianArr = bigEndian;
+        singleEntryArrSupp = singleEntry;
+        includePaths.swap(paths);
+        includedFiles.swap(files);
+        instAttrs.swap(attrs);
+        configs.swap(configList);
+        nodesMap.swap(nodes);
+        return true;
+    } catch (AdbException&) {
+        delete node;
+        for (size_t i = 0; i < configList.size(); i++) {
+            delete configList[i];
+        }
+        for (NodesMap::iterator it = nodes.begin(); it != nodes.end(); it++) {
+            delete it->second;
+        }
+        return false;
+    }
+}
+
 /**
  * Function: Adb::loadFromString
  **/
@@ -1444,7 +1993,8 @@ void Adb::cleanInstAttrs()
  **/
 AdbInstance* Adb::createLayout(string rootNodeName, bool isExprEval,
         AdbProgress *progressObj, int depth, bool ignoreMissingNodes,
-        bool allowMultipleExceptions) {
+        bool allowMultipleExceptions, bool lazy) {
+    _creatingLayout = true;
     try {
         //find root in nodes map
         NodesMap::iterator it;
@@ -1471,12 +2021,23 @@ AdbInstance* Adb::createLayout(string rootNodeName, bool isExprEval,
             addMissingNodes(depth, allowMultipleExceptions);
         }
 
+        u_int8_t lazyFlags = 0;
+        if (lazy && depth == -1) {
+            lazyFlags = ADB_LAZY_LAYOUT;
+            lazyFlags |= isExprEval ? ADB_LAZY_EXPR_EVAL : 0;
+            lazyFlags |= ignoreMissingNodes ? ADB_LAZY_IGNORE_MISSING : 0;
+            lazyFlags |= allowMultipleExceptions ? ADB_LAZY_ALL_EXCEPTIONS : 0;
+            lazyFlags |= rootNodeName == rootNode ? ADB_LAZY_MAIN_ROOT : 0;
+        }
+        // Instance attributes must be overridden before any union selector is evaluated
+        _deferUnionSelectorEval = true;
+
         for (size_t i = 0; (depth == -1 || depth > 0) && i
                 < nodeDesc->fields.size(); i++) {
             vector<AdbInstance*> subItems = createInstance(nodeDesc->fields[i],
                     rootItem, emptyVars, isExprEval, progressObj,
                     depth == -1 ? -1 : depth - 1, ignoreMissingNodes,
-                    allowMultipleExceptions);
+                    allowMultipleExceptions, lazyFlags);
             rootItem->subItems.insert(rootItem->subItems.end(),
                     subItems.begin(), subItems.end());
         }
@@ -1505,92 +2066,146 @@ AdbInstance* Adb::createLayout(string rootNodeName, bool isExprEval,
         }
 
         /* Evaluate unions selector fields*/
-        for (list<AdbInstance*>::iterator it = _unionSelectorEvalDeffered.begin(); 
-             it != _unionSelectorEvalDeffered.end(); it++) {
-            vector < string > path;
-            AdbInstance *inst = *it;
-            AdbInstance *curInst = inst;
-            const string splitVal = inst->getInstanceAttr("union_selector");
-            boost::algorithm::split(path, splitVal, boost::is_any_of(string(".")));
-            for (size_t i = 0; i < path.size(); i++) {
-                if (path[i] == "#(parent)" || path[i] == "$(parent)") {
-                    curInst = curInst->parent;
-                } else {
-                    size_t j;
-                    bool inPath = false;
-                    for (j = 0; j < curInst->subItems.size(); j++) {
-                        if (curInst->subItems[j]->name == path[i]) {
-                            curInst = curInst->subItems[j];
-                            inPath = true;
-                            break;
-                        }
+        _deferUnionSelectorEval = false;
+        evalUnionSelectors(rootNodeName == rootNode, allowMultipleExceptions);
+
+        _creatingLayout = false;
+        return rootItem;
+    } catch (AdbException &exp) {
+        _creatingLayout = false;
+        _deferUnionSelectorEval = false;
+        _unionSelectorEvalDeffered.clear();
+        _lastError = exp.what_s();
+        if (allowMultipleExceptions) {
+            insertNewException(ExceptionHolder::FATAL_EXCEPTION, _lastError);
+        }
+        return NULL;
+    } catch (...) {
+        _creatingLayout = false;
+        _deferUnionSelectorEval = false;
+        _unionSelectorEvalDeffered.clear();
+        _lastError = "Unknown error occurred";
+        return NULL;
+    }
+}
+
+/**
+ * Function: Adb::evalUnionSelectors
+ * Resolve the selector field of the unions instantiated so far
+ **/
+void Adb::evalUnionSelectors(bool isMainRoot, bool allowMultipleExceptions) {
+    // Resolving a selector may expand lazy instances which queue more unions
+    while (!_unionSelectorEvalDeffered.empty()) {
+        vector < string > path;
+        AdbInstance *inst = _unionSelectorEvalDeffered.front();
+        AdbInstance *curInst = inst;
+        _unionSelectorEvalDeffered.pop_front();
+        const string splitVal = inst->getInstanceAttr("union_selector");
+        boost::algorithm::split(path, splitVal, boost::is_any_of(string(".")));
+        for (size_t i = 0; i < path.size(); i++) {
+            if (path[i] == "#(parent)" || path[i] == "$(parent)") {
+                curInst = curInst->parent;
+            } else {
+                size_t j;
+                bool inPath = false;
+                curInst->expand();
+                for (j = 0; j < curInst->subItems.size(); j++) {
+                    if (curInst->subItems[j]->name == path[i]) {
+                        curInst = curInst->subItems[j];
+                        inPath = true;
+                        break;
                     }
+                }
 
-                    if (j == curInst->subItems.size() && !inPath) {
-                        if (rootNodeName == rootNode) { // give this warning only if this root instantiation
-                            raiseException(allowMultipleExceptions, 
-                                          "Failed to find union selector for union (" + inst->fullName() + ") Can't find field (" + path[i] + ") under (" + curInst->fullName() + ")",
-                                          ExceptionHolder::ERROR_EXCEPTION);
-                        }
+                if (j == curInst->subItems.size() && !inPath) {
+                    if (isMainRoot) { // give this warning only if this root instantiation
+                        raiseException(allowMultipleExceptions, 
+                                      "Failed to find union selector for union (" + inst->fullName() + ") Can't find field (" + path[i] + ") under (" + curInst->fullName() + ")",
+                                      ExceptionHolder::ERROR_EXCEPTION);
                     }
                 }
             }
+        }
 
-            inst->unionSelector = curInst;
-            for (size_t i = 0; i < inst->subItems.size(); i++) {
-                //printf("Field %s, isResered=%d\n", inst->subItems[i]->fullName().c_str(), inst->subItems[i]->isReserved());
-                if (inst->subItems[i]->isReserved()) {
-                    continue;
-                }
+        inst->unionSelector = curInst;
+        inst->expand();
+        bool selectorValMapSet = false;
+        map < string, u_int64_t > selectorValMap;
+        for (size_t i = 0; i < inst->subItems.size(); i++) {
+            //printf("Field %s, isResered=%d\n", inst->subItems[i]->fullName().c_str(), inst->subItems[i]->isReserved());
+            if (inst->subItems[i]->isReserved()) {
+                continue;
+            }
 
-                // make sure all union subnodes define "selected_by" attribute
-                bool found = false;
-                AttrsMap::iterator selectorValIt = inst->subItems[i]->getInstanceAttrIterator("selected_by", found);
-                if (!found) {
-                    raiseException(allowMultipleExceptions, 
-                                  "In union (" + inst->fullName() + ") the union subnode (" + inst->subItems[i]->name + ") doesn't define selection value",
-                                  ExceptionHolder::ERROR_EXCEPTION);
-                }
+            // make sure all union subnodes define "selected_by" attribute
+            bool found = false;
+            AttrsMap::iterator selectorValIt = inst->subItems[i]->getInstanceAttrIterator("selected_by", found);
+            if (!found) {
+                raiseException(allowMultipleExceptions, 
+                              "In union (" + inst->fullName() + ") the union subnode (" + inst->subItems[i]->name + ") doesn't define selection value",
+                              ExceptionHolder::ERROR_EXCEPTION);
+            }
 
-                // make sure that all union subnodes selector values are defined in the selector field enum
-                if (selectorValIt->second == "") {
-                    continue;
-                }
+            // make sure that all union subnodes selector values are defined in the selector field enum
+            if (selectorValIt->second == "") {
+                continue;
+            }
 
-                map<string, u_int64_t>::iterator it;
-                map < string, u_int64_t > selectorValMap
-                        = inst->unionSelector->getEnumMap();
-                for (it = selectorValMap.begin(); it != selectorValMap.end(); it++) {
-                    if (it->first == selectorValIt->second) {
-                        break;
-                    }
-                }
+            if (!selectorValMapSet) {
+                selectorValMap = inst->unionSelector->getEnumMap();
+                selectorValMapSet = true;
+            }
 
-                //if not found in map throw exeption
-                if (it == selectorValMap.end()) {
-                    string exceptionTxt = "In union (" + inst->fullName()
-                            + ") the union subnode (" + inst->subItems[i]->name
-                            + ") uses a selector value ("
-                            + selectorValIt->second
-                            + ") which isn't defined in the selector field ("
-                            + inst->unionSelector->fullName() + ")";
-                    raiseException(allowMultipleExceptions, 
-                                  exceptionTxt,
-                                  ExceptionHolder::ERROR_EXCEPTION);
-                }
+            //if not found in map throw exeption
+            if (selectorValMap.find(selectorValIt->second) == selectorValMap.end()) {
+                string exceptionTxt = "In union (" + inst->fullName()
+                        + ") the union subnode (" + inst->subItems[i]->name
+                        + ") uses a selector value ("
+                        + selectorValIt->second
+                        + ") which isn't defined in the selector field ("
+                        + inst->unionSelector->fullName() + ")";
+                raiseException(allowMultipleExceptions, 
+                              exceptionTxt,
+                              ExceptionHolder::ERROR_EXCEPTION);
             }
         }
+    }
+}
 
-        return rootItem;
+/**
+ * Function: Adb::expandInstance
+ * Instantiate the sub items of an instance created by a lazy layout
+ **/
+void Adb::expandInstance(AdbInstance *inst) {
+    u_int8_t lazyFlags = inst->_lazyFlags;
+    bool isExprEval = lazyFlags & ADB_LAZY_EXPR_EVAL;
+    bool allowMultipleExceptions = lazyFlags & ADB_LAZY_ALL_EXCEPTIONS;
+    map < string, string > vars;
+
+    inst->_lazyAdb = NULL;
+    if (isExprEval) {
+        vars = inst->varsMap;
+    }
+    try {
+        createSubItems(inst, vars, isExprEval, NULL, -1,
+                lazyFlags & ADB_LAZY_IGNORE_MISSING, allowMultipleExceptions, lazyFlags);
+        if (!_deferUnionSelectorEval) {
+            evalUnionSelectors(lazyFlags & ADB_LAZY_MAIN_ROOT, allowMultipleExceptions);
+        }
     } catch (AdbException &exp) {
+        if (_creatingLayout) {
+            throw;
+        }
+        // The instance accessors that expand don't throw, leave the instance empty instead
+        for (size_t i = 0; i < inst->subItems.size(); i++) {
+            delete inst->subItems[i];
+        }
+        inst->subItems.clear();
+        _unionSelectorEvalDeffered.clear();
         _lastError = exp.what_s();
         if (allowMultipleExceptions) {
             insertNewException(ExceptionHolder::FATAL_EXCEPTION, _lastError);
         }
-        return NULL;
-    } catch (...) {
-        _lastError = "Unknown error occurred";
-        return NULL;
     }
 }
 
@@ -1625,7 +2240,7 @@ vector<string> Adb::getNodeDeps(string nodeName) {
 vector<AdbInstance*> Adb::createInstance(AdbField *field,
         AdbInstance *parent, map<string, string> vars, bool isExprEval,
         AdbProgress *progressObj, int depth, bool ignoreMissingNodes,
-        bool allowMultipleExceptions) {
+        bool allowMultipleExceptions, u_int8_t lazyFlags) {
     static const regex EXP_PATTERN(
             "\\s*([a-zA-Z0-9_]+)=((\\$\\(.*?\\)|\\S+|$)*)\\s*");
     if (progressObj) {
@@ -1765,38 +2380,12 @@ vector<AdbInstance*> Adb::createInstance(AdbField *field,
                  ") (" +  boost::lexical_cast<string>(inst->nodeDesc->size) + ")";*/
             }
 
-            vector<AdbField*>::iterator it;
-            for (it = inst->nodeDesc->fields.begin(); it
-                    != inst->nodeDesc->fields.end(); it++) {
-                map < string, string > varsCopy = vars;
-                vector<AdbInstance*> subItems = createInstance(*it, inst, vars,
-                        isExprEval, progressObj, depth == -1 ? -1 : depth - 1,
-                        ignoreMissingNodes, allowMultipleExceptions);
-                inst->subItems.insert(inst->subItems.end(), subItems.begin(),
-                        subItems.end());
-            }
-
-            if (!inst->isUnion()) {
-                stable_sort(inst->subItems.begin(), inst->subItems.end(),
-                            compareFieldsPtr<AdbInstance> );
-
-                for (size_t j = 0; j < inst->subItems.size() - 1; j++) {
-                    //printf("field: %s, offset: %s\n", inst->subItems[j+1]->name.c_str(),formatAddr(inst->subItems[j+1]->offset, inst->subItems[j+1]->size).c_str());
-                    //printf("field: %s, offset: %s\n", inst->subItems[j]->name.c_str(),formatAddr(inst->subItems[j]->offset, inst->subItems[j]->size).c_str());
-                    if (inst->subItems[j + 1]->offset
-                        < inst->subItems[j]->offset + inst->subItems[j]->size) {
-                        string exceptionTxt = "Field ("
-                                + inst->subItems[j + 1]->name + ") ("
-                                + formatAddr(inst->subItems[j + 1]->offset,
-                                        inst->subItems[j + 1]->size).c_str()
-                                + ") overlaps with (" + inst->subItems[j]->name
-                                + ") (" + formatAddr(inst->subItems[j]->offset,
-                                inst->subItems[j]->size).c_str() + ")";
-                        raiseException(allowMultipleExceptions, 
-                              exceptionTxt,
-                              ExceptionHolder::ERROR_EXCEPTION);  
-                    }
-                }
+            if (lazyFlags) {
+                inst->_lazyAdb = this;
+                inst->_lazyFlags = lazyFlags;
+            } else {
+                createSubItems(inst, vars, isExprEval, progressObj, depth,
+                        ignoreMissingNodes, allowMultipleExceptions, 0);
             }
         }
 
@@ -1807,6 +2396,47 @@ vector<AdbInstance*> Adb::createInstance(AdbField *field,
     return instList;
 }
 
+/**
+ * Function: Adb::createSubItems
+ **/
+void Adb::createSubItems(AdbInstance *inst, map<string, string> &vars,
+        bool isExprEval, AdbProgress *progressObj, int depth,
+        bool ignoreMissingNodes, bool allowMultipleExceptions,
+        u_int8_t lazyFlags) {
+    vector<AdbField*>::iterator it;
+    for (it = inst->nodeDesc->fields.begin(); it
+            != inst->nodeDesc->fields.end(); it++) {
+        vector<AdbInstance*> subItems = createInstance(*it, inst, vars,
+                isExprEval, progressObj, depth == -1 ? -1 : depth - 1,
+                ignoreMissingNodes, allowMultipleExceptions, lazyFlags);
+        inst->subItems.insert(inst->subItems.end(), subItems.begin(),
+                subItems.end());
+    }
+
+    if (!inst->isUnion()) {
+        stable_sort(inst->subItems.begin(), inst->subItems.end(),
+                    compareFieldsPtr<AdbInstance> );
+
+        for (size_t j = 0; j < inst->subItems.size() - 1; j++) {
+            //printf("field: %s, offset: %s\n", inst->subItems[j+1]->name.c_str(),formatAddr(inst->subItems[j+1]->offset, inst->subItems[j+1]->size).c_str());
+            //printf("field: %s, offset: %s\n", inst->subItems[j]->name.c_str(),formatAddr(inst->subItems[j]->offset, inst->subItems[j]->size).c_str());
+            if (inst->subItems[j + 1]->offset
+                < inst->subItems[j]->offset + inst->subItems[j]->size) {
+                string exceptionTxt = "Field ("
+                        + inst->subItems[j + 1]->name + ") ("
+                        + formatAddr(inst->subItems[j + 1]->offset,
+                                inst->subItems[j + 1]->size).c_str()
+                        + ") overlaps with (" + inst->subItems[j]->name
+                        + ") (" + formatAddr(inst->subItems[j]->offset,
+                        inst->subItems[j]->size).c_str() + ")";
+                raiseException(allowMultipleExceptions, 
+                      exceptionTxt,
+                      ExceptionHolder::ERROR_EXCEPTION);  
+            }
+        }
+    }
+}
+
 /**
  * Function: Adb::checkInstanceOffsetValidity
  **/
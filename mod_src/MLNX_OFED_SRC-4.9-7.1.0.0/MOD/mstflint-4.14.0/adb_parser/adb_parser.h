@@ -177,7 +177,9 @@ public:
 };
 
 /*************************** AdbInstance ***************************/
+class Adb;
 class AdbInstance {
+    friend class Adb;
 public:
     // Methods
     AdbInstance();
@@ -216,6 +218,8 @@ public:
     void setVarsMap(const AttrsMap &AttrsMap);
     AttrsMap getVarsMap();
     vector<AdbInstance*> getLeafFields(); // Get all leaf fields
+    // Instantiate the sub items of a lazily created instance, the methods above do it on their own
+    void expand();
     void pushBuf(u_int8_t *buf, u_int64_t value);
     u_int64_t popBuf(u_int8_t *buf);
     int instAttrsMapLen() {return instAttrsMap.size();}
@@ -240,6 +244,8 @@ public:
 private:
     AttrsMap instAttrsMap; // Attributes after evaluations and array expanding
     AttrsMap varsMap; // all variables relevant to this item after evaluation
+    Adb *_lazyAdb; // Set while the sub items of a lazy layout weren't instantiated yet
+    u_int8_t _lazyFlags;
 };
 
 /*************************** Adb ***************************/
@@ -277,9 +283,12 @@ public:
             string addPrefix = "");
 
     AdbInstance* addMissingNodes(int depth, bool allowMultipleExceptions);
+    // lazy means sub nodes are instantiated on their first access, the Adb must outlive the layout then.
+    // A lazy instance that fails to expand is left without sub items and the error is kept for getLastError()
     AdbInstance* createLayout(string rootNodeName, bool isExprEval = false,
             AdbProgress *progressObj = NULL, int depth = -1, /* -1 means instantiate full tree */
-            bool ignoreMissingNodes = false, bool getAllExceptions = false);
+            bool ignoreMissingNodes = false, bool getAllExceptions = false,
+            bool lazy = false);
     vector<string> getNodeDeps(string nodeName);
     string getLastError();
 
@@ -312,10 +321,19 @@ public:
     StringVector warnings;
     ExceptionsMap adbExceptionMap;
 private:
+    friend class AdbInstance;
     vector<AdbInstance*> createInstance(AdbField *fieldDesc,
             AdbInstance *parent, map<string, string> vars, bool isExprEval,
             AdbProgress *progressObj, int depth,
-            bool ignoreMissingNodes = false, bool getAllExceptions = false);
+            bool ignoreMissingNodes = false, bool getAllExceptions = false,
+            u_int8_t lazyFlags = 0);
+    void createSubItems(AdbInstance *inst, map<string, string> &vars, bool isExprEval,
+            AdbProgress *progressObj, int depth, bool ignoreMissingNodes,
+            bool allowMultipleExceptions, u_int8_t lazyFlags);
+    void expandInstance(AdbInstance *inst);
+    void evalUnionSelectors(bool isMainRoot, bool allowMultipleExceptions);
+    bool loadCache(const string &cacheFile, u_int64_t cacheKey);
+    void saveCache(const string &cacheFile, u_int64_t cacheKey);
     u_int32_t calcArrOffset(AdbField *fieldDesc, AdbInstance *parent,
             u_int32_t arrIdx);
     string evalExpr(string expr, AttrsMap *vars);
@@ -326,6 +344,8 @@ private:
     string _lastError;
     AdbExpr _adbExpr;
     std::list<AdbInstance*> _unionSelectorEvalDeffered;
+    bool _deferUnionSelectorEval;
+    bool _creatingLayout; // createLayout reports expansion errors on its own
     void checkInstanceOffsetValidity(AdbInstance *inst, AdbInstance *parent, bool allowMultipleExceptions);
     void throwExeption(bool allowMultipleExceptions, string exceptionTxt, string addedMsgMultiExp);
 };
@@ -179,6 +179,7 @@ FlagMetaData::FlagMetaData()
     _flags.push_back(new Flag("", "override_cache_replacement", 0));
     _flags.push_back(new Flag("", "ocr", 0));
     _flags.push_back(new Flag("", "no_flash_verify", 0));
+    _flags.push_back(new Flag("", "diff_burn", 0));
     _flags.push_back(new Flag("s", "silent", 0));
     _flags.push_back(new Flag("y", "yes", 0));
     _flags.push_back(new Flag("", "no", 0));
@@ -567,6 +568,13 @@ void Flint::initCmdParser()
                "",
                "Do not verify each write on the flash.");
 
+    AddOptions("diff_burn",
+               ' ',
+               "",
+               "Read back the flash or image file and write only the sectors that differ from the image.\n"
+               "On flash the image signature is still erased first and written last, and the programmed sectors are read back.\n"
+               "Commands affected: burn (FS3/FS4 images)");
+
     AddOptions("use_fw",
                ' ',
                "",
@@ -868,6 +876,8 @@ ParseStatus Flint::HandleOption(string name, string value)
         _flintParams.use_fw = true;
     } else if (name == "no_flash_verify") {
         _flintParams.no_flash_verify = true;
+    } else if (name == "diff_burn") {
+        _flintParams.diff_burn = true;
     } else if (name == "silent" || name == "s") {
         _flintParams.silent = true;
     } else if (name == "yes" || name == "y") {
@@ -0,0 +1,130 @@
+/*
+ *
+ * crc16_image_test.cpp - Crc16 FW image regression
+ *
+ * Copyright (c) 2020 Mellanox Technologies Ltd.  All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Image level regression for the table driven Crc16: FS3 images whose
+ * boot2, ITOC and section CRCs are computed with the original bit-serial
+ * code must verify, CalcImageCRC() and recalcSectionCrc() must agree with
+ * it on every section, and a flipped byte must still be caught.
+ *
+ * Runs with `make check` on a synthetic image. Real FW images given on
+ * the command line (crc16_image_test fw1.bin ...) are verified as well.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "mlxfwops/lib/fs3_ops.h"
+#include "fs3_test_image.h"
+
+// Exposes the protected CRC helpers, no I/O object behind it
+class CrcOps : public Fs3Operations {
+public:
+    CrcOps() : Fs3Operations((FBase*)NULL) {}
+    using FwOperations::CalcImageCRC;
+    using FwOperations::recalcSectionCrc;
+};
+
+static bool verifyImage(const char *name, void *hndl, u_int32_t *size, fw_hndl_type_t type)
+{
+    char errBuff[1024] = {0};
+    FwOperations *ops = FwOperations::FwOperationsCreate(hndl, size, (char*)NULL, type, errBuff, sizeof(errBuff));
+    bool rc;
+
+    if (!ops) {
+        printf("-E- %s: %s\n", name, errBuff);
+        return false;
+    }
+    rc = ops->FwVerify((VerifyCallBack)NULL);
+    if (!rc) {
+        printf("-I- %s: %s\n", name, ops->err());
+    }
+    ops->FwCleanUp();
+    delete ops;
+    return rc;
+}
+
+static int checkSections(std::vector<u_int8_t>& img, const std::vector<Section>& sects)
+{
+    CrcOps ops;
+    int failed = 0;
+
+    for (size_t i = 0; i < sects.size(); i++) {
+        const Section& s = sects[i];
+        u_int16_t expected = bitwiseCrc(&img[s.addr], s.size);
+        u_int32_t crc = ops.CalcImageCRC((u_int32_t*)&img[s.addr], s.size / 4);
+        std::vector<u_int8_t> sect(img.begin() + s.addr, img.begin() + s.addr + s.size + 4);
+        u_int32_t trailer;
+
+        ops.recalcSectionCrc(&sect[0], s.size);
+        trailer = (u_int32_t)sect[s.size] << 24 | sect[s.size + 1] << 16 | sect[s.size + 2] << 8 | sect[s.size + 3];
+        if (crc != expected || trailer != expected) {
+            printf("-E- section 0x%x at 0x%x, %u bytes: expected %04x, CalcImageCRC %04x, recalcSectionCrc %04x\n",
+                   s.type, s.addr, s.size, expected, crc, trailer);
+            failed = 1;
+        }
+    }
+    return failed;
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<u_int8_t> img;
+    std::vector<Section> sects;
+    u_int32_t size = TEST_IMAGE_SIZE;
+    int failed = 0;
+
+    buildTestImage(img, sects);
+    failed |= checkSections(img, sects);
+    if (!verifyImage("synthetic image", &img[0], &size, FHT_FW_BUFF)) {
+        printf("-E- synthetic image failed to verify\n");
+        failed = 1;
+    }
+
+    // A single bit in the main code must still fail its section CRC
+    img[sects[3].addr + sects[3].size / 2] ^= 0x10;
+    if (verifyImage("corrupted image", &img[0], &size, FHT_FW_BUFF)) {
+        printf("-E- corrupted image passed verify\n");
+        failed = 1;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        if (!verifyImage(argv[i], argv[i], NULL, FHT_FW_FILE)) {
+            printf("-E- %s failed to verify\n", argv[i]);
+            failed = 1;
+        }
+    }
+
+    printf("%s\n", failed ? "FAILED" : "PASSED");
+    return failed;
+}
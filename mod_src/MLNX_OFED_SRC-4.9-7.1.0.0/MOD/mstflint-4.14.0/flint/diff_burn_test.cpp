@@ -0,0 +1,169 @@
+/*
+ *
+ * diff_burn_test.cpp - differential burn to an image file
+ *
+ * Copyright (c) 2020 Mellanox Technologies Ltd.  All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * End to end check of the differential burn on an image target: an FS3
+ * image burned over an image file that differs in one code sector must
+ * leave the file identical to a full burn, write only the sectors that
+ * differ, and write nothing when burned again.
+ *
+ * Runs with `make check`.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "mlxfwops/lib/fs3_ops.h"
+#include "fs3_test_image.h"
+
+static bool writeFile(const char *fname, const std::vector<u_int8_t>& data)
+{
+    FILE *fh = fopen(fname, "wb");
+    bool rc;
+
+    if (!fh) {
+        return false;
+    }
+    rc = fwrite(&data[0], 1, data.size(), fh) == data.size();
+    return fclose(fh) == 0 && rc;
+}
+
+static bool readFile(const char *fname, std::vector<u_int8_t>& data)
+{
+    FILE *fh = fopen(fname, "rb");
+    size_t n;
+
+    if (!fh) {
+        return false;
+    }
+    data.resize(TEST_IMAGE_SIZE + 1);
+    n = fread(&data[0], 1, data.size(), fh);
+    data.resize(n);
+    fclose(fh);
+    return true;
+}
+
+// Burns img over the image file, returns false with a message on failure
+static bool burn(const char *target, std::vector<u_int8_t>& img, bool diff, FwOperations::ExtBurnParams& burnParams)
+{
+    char errBuff[1024] = {0};
+    u_int32_t size = img.size();
+    FwOperations *imgOps = FwOperations::FwOperationsCreate(&img[0], &size, (char*)NULL, FHT_FW_BUFF, errBuff,
+                                                            sizeof(errBuff));
+    FwOperations *fileOps;
+    bool rc = false;
+
+    if (!imgOps) {
+        printf("-E- image: %s\n", errBuff);
+        return false;
+    }
+    fileOps = FwOperations::FwOperationsCreate((void*)target, NULL, (char*)NULL, FHT_FW_FILE, errBuff,
+                                               sizeof(errBuff));
+    if (!fileOps) {
+        printf("-E- %s: %s\n", target, errBuff);
+        goto out;
+    }
+    burnParams.differentialBurn = diff;
+    if (!imgOps->FwVerify((VerifyCallBack)NULL) || !fileOps->FwVerify((VerifyCallBack)NULL)) {
+        printf("-E- verify before burn: %s%s\n", imgOps->err(), fileOps->err());
+    } else if (!fileOps->FwBurnAdvanced(imgOps, burnParams)) {
+        printf("-E- burn: %s\n", fileOps->err());
+    } else {
+        rc = true;
+    }
+    fileOps->FwCleanUp();
+    delete fileOps;
+out:
+    imgOps->FwCleanUp();
+    delete imgOps;
+    return rc;
+}
+
+static int check(const char *name, const char *target, std::vector<u_int8_t>& img, const std::vector<u_int8_t>& expected,
+                 bool diff, u_int32_t maxWritten)
+{
+    FwOperations::ExtBurnParams burnParams;
+    std::vector<u_int8_t> result;
+
+    burnParams.burnFailsafe = false;
+    if (!burn(target, img, diff, burnParams)) {
+        printf("-E- %s: burn failed\n", name);
+        return 1;
+    }
+    if (!readFile(target, result) || result != expected) {
+        printf("-E- %s: image file differs from the burned image\n", name);
+        return 1;
+    }
+    printf("-I- %s: %u bytes written, %u skipped\n", name, burnParams.burnStatus.bytesWritten,
+           burnParams.burnStatus.bytesSkipped);
+    if (burnParams.burnStatus.bytesWritten > maxWritten) {
+        printf("-E- %s: more than %u bytes written\n", name, maxWritten);
+        return 1;
+    }
+    return 0;
+}
+
+int main()
+{
+    char target[] = "/tmp/diff_burn_test.XXXXXX";
+    std::vector<u_int8_t> oldImg, newImg;
+    std::vector<Section> sects;
+    int failed = 0;
+    int fd;
+
+    buildTestImage(oldImg, sects);
+    buildTestImage(newImg, sects, 0x5a);
+    fd = mkstemp(target);
+    if (fd < 0) {
+        perror("mkstemp");
+        return 1;
+    }
+    close(fd);
+
+    // The MAIN_CODE sector and the ITOC sector with its CRC differ
+    if (!writeFile(target, oldImg)) {
+        printf("-E- cannot write %s\n", target);
+        failed = 1;
+    } else {
+        failed |= check("full burn", target, newImg, newImg, false, TEST_IMAGE_SIZE);
+    }
+    if (!failed && writeFile(target, oldImg)) {
+        failed |= check("differential burn", target, newImg, newImg, true, 2 * FS3_DEFAULT_SECTOR_SIZE);
+        failed |= check("differential reburn", target, newImg, newImg, true, 0);
+    }
+
+    unlink(target);
+    printf("%s\n", failed ? "FAILED" : "PASSED");
+    return failed;
+}
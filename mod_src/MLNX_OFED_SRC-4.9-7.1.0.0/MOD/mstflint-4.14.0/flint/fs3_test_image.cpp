@@ -0,0 +1,152 @@
+/*
+ *
+ * fs3_test_image.cpp - synthetic FS3 images for the flint tests
+ *
+ * Copyright (c) 2020 Mellanox Technologies Ltd.  All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+#include "fs3_test_image.h"
+#include "tools_layouts/cibfw_layouts.h"
+
+static u_int16_t bitwiseAdd(u_int16_t crc, u_int32_t o, int bits)
+{
+    o <<= 32 - bits;
+    for (int i = 0; i < bits; i++) {
+        if (crc & 0x8000) {
+            crc = (u_int16_t) ((((crc << 1) | (o >> 31)) ^  0x100b) & 0xffff);
+        } else {
+            crc = (u_int16_t) (((crc << 1) | (o >> 31)) & 0xffff);
+        }
+        o = (o << 1) & 0xffffffff;
+    }
+    return crc;
+}
+
+u_int16_t bitwiseCrc(const u_int8_t *p, u_int32_t len)
+{
+    u_int16_t crc = 0xffff;
+
+    for (u_int32_t i = 0; i < len; i++) {
+        crc = bitwiseAdd(crc, p[i], 8);
+    }
+    crc = bitwiseAdd(crc, 0, 16);
+    return crc ^ 0xffff;
+}
+
+static void putBe32(std::vector<u_int8_t>& img, u_int32_t off, u_int32_t val)
+{
+    img[off] = val >> 24;
+    img[off + 1] = val >> 16;
+    img[off + 2] = val >> 8;
+    img[off + 3] = val;
+}
+
+// Boot2, ITOC, MFG_INFO, IMAGE_INFO and code sections whose lengths leave
+// every tail length of the folding and slicing loops
+void buildTestImage(std::vector<u_int8_t>& img, std::vector<Section>& sects, u_int8_t mainCodeXor)
+{
+    const u_int32_t boot2 = 0x38, boot2Size = 0x40, itoc = 0x1000;
+    const Section layout[] = {
+        {FS3_MFG_INFO, 0x2000, 0x100},
+        {FS3_IMAGE_INFO, 0x3000, 0x400},
+        {FS3_PCI_CODE, 0x10000, 0x1fffc},
+        {FS3_MAIN_CODE, 0x40000, 0x200000 + 0x34},
+        {FS3_HW_BOOT_CFG, 0x280000, 0x4c},
+        {FS3_HW_MAIN_CFG, 0x290000, 0x100000 - 0x14},
+    };
+    struct cibfw_mfg_info mfg;
+    struct cibfw_image_info info;
+    struct cibfw_itoc_header header;
+    u_int64_t x = 0x9e3779b97f4a7c15ULL;
+    u_int32_t i;
+
+    img.assign(TEST_IMAGE_SIZE, 0xff);
+    sects.assign(layout, layout + sizeof(layout) / sizeof(layout[0]));
+
+    putBe32(img, 0, 0x4D544657);
+    putBe32(img, 4, 0x8CDFD000);
+    putBe32(img, 8, 0xDEAD9270);
+    putBe32(img, 12, 0x4154BEEF);
+    putBe32(img, 0x24, (3 << 24) | (0x1a << 16));
+    for (i = 0; i < boot2Size + 3; i++) {
+        putBe32(img, boot2 + i * 4, i == 1 ? boot2Size : i * 0x01010101);
+    }
+    putBe32(img, boot2 + (boot2Size + 3) * 4, bitwiseCrc(&img[boot2], (boot2Size + 3) * 4));
+
+    memset(&img[sects[0].addr], 0, sects[0].size);
+    memset(&mfg, 0, sizeof(mfg));
+    strcpy(mfg.psid, "MT_0000000001");
+    mfg.major_version = 1;
+    cibfw_mfg_info_pack(&mfg, &img[sects[0].addr]);
+
+    memset(&img[sects[1].addr], 0, sects[1].size);
+    memset(&info, 0, sizeof(info));
+    strcpy(info.psid, "MT_0000000001");
+    info.FW_VERSION.MAJOR = 12;
+    info.FW_VERSION.MINOR = 28;
+    info.FW_VERSION.SUBMINOR = 1000;
+    info.supported_hw_id[0] = 521;
+    cibfw_image_info_pack(&info, &img[sects[1].addr]);
+
+    for (i = 2; i < sects.size(); i++) {
+        for (u_int32_t j = 0; j < sects[i].size; j++) {
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            img[sects[i].addr + j] = (u_int8_t)x;
+        }
+    }
+    img[sects[3].addr + sects[3].size / 2] ^= mainCodeXor;
+
+    memset(&header, 0, sizeof(header));
+    header.signature0 = 0x49544f43;
+    header.signature1 = 0x04081516;
+    header.signature2 = 0x2342cafa;
+    header.signature3 = 0xbacafe00;
+    cibfw_itoc_header_pack(&header, &img[itoc]);
+    header.itoc_entry_crc = bitwiseCrc(&img[itoc], 7 * 4);
+    cibfw_itoc_header_pack(&header, &img[itoc]);
+
+    for (i = 0; i < sects.size(); i++) {
+        u_int32_t entry = itoc + CIBFW_ITOC_HEADER_SIZE + i * CIBFW_ITOC_ENTRY_SIZE;
+        struct cibfw_itoc_entry e;
+        memset(&e, 0, sizeof(e));
+        e.type = sects[i].type;
+        e.size = sects[i].size / 4;
+        e.flash_addr = sects[i].addr / 4;
+        e.relative_addr = 1;
+        e.section_crc = bitwiseCrc(&img[sects[i].addr], sects[i].size);
+        cibfw_itoc_entry_pack(&e, &img[entry]);
+        e.itoc_entry_crc = bitwiseCrc(&img[entry], 7 * 4);
+        cibfw_itoc_entry_pack(&e, &img[entry]);
+    }
+}
@@ -0,0 +1,58 @@
+/*
+ *
+ * fs3_test_image.h - synthetic FS3 images for the flint tests
+ *
+ * Copyright (c) 2020 Mellanox Technologies Ltd.  All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef FS3_TEST_IMAGE_H
+#define FS3_TEST_IMAGE_H
+
+#include <vector>
+#include "mlxfwops/lib/flint_base.h"
+
+#define TEST_IMAGE_SIZE 0x400000
+
+struct Section {
+    u_int8_t type;
+    u_int32_t addr;
+    u_int32_t size;
+};
+
+// Crc16 as the original bit-serial code computed it, over big endian data
+u_int16_t bitwiseCrc(const u_int8_t *p, u_int32_t len);
+
+// Builds a TEST_IMAGE_SIZE FS3 image whose CRCs all come from bitwiseCrc().
+// mainCodeXor is applied to one MAIN_CODE byte, before the CRCs, to get a
+// second image that differs from the first in a single code sector.
+void buildTestImage(std::vector<u_int8_t>& img, std::vector<Section>& sects, u_int8_t mainCodeXor = 0);
+
+#endif
@@ -1806,6 +1806,7 @@ void BurnSubCommand::updateBurnParams()
     _burnParams.noDevidCheck = _flintParams.no_devid_check;
     _burnParams.skipCiReq = _flintParams.skip_ci_req;
     _burnParams.useImgDevData = _flintParams.ignore_dev_data;
+    _burnParams.differentialBurn = _flintParams.diff_burn;
     if (_burnParams.userGuidsSpecified) {
         _burnParams.userUids = _flintParams.user_guids;
     }
@@ -1976,6 +1977,10 @@ FlintStatus BurnSubCommand::burnFs3()
     }
     PRINT_PROGRESS(_burnParams.progressFunc, 101);
     write_result_to_log(FLINT_SUCCESS, "", _flintParams.log_specified);
+    if (_burnParams.differentialBurn) {
+        printf("-I- Differential burn: %u bytes written, %u bytes already up to date.\n",
+               _burnParams.burnStatus.bytesWritten, _burnParams.burnStatus.bytesSkipped);
+    }
     const char *resetRec = _fwOps->FwGetResetRecommandationStr();
     if (resetRec) {
         printf("-I- %s\n", resetRec);
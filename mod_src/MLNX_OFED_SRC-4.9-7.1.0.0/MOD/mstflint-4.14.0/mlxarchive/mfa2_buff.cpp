@@ -19,18 +19,38 @@
 #include <stdio.h>
 #include <string.h>
 #include <string>
+#if !defined(__WIN__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 #include "mfa2_buff.h"
 
 
-Mfa2Buffer::Mfa2Buffer(): m_buff(NULL), m_pos(0), m_size(0) {
+Mfa2Buffer::Mfa2Buffer(): m_buff(NULL), m_pos(0), m_size(0), m_mapped(false) {
 }
 
 Mfa2Buffer::~Mfa2Buffer() {
-    if (m_buff) {
+    release();
+}
+
+void Mfa2Buffer::release()
+{
+    if (!m_buff) {
+        return;
+    }
+#if !defined(__WIN__)
+    if (m_mapped) {
+        munmap(m_buff, m_size);
+    } else
+#endif
+    {
         delete [] m_buff;
-        m_buff = NULL;
     }
+    m_buff = NULL;
+    m_mapped = false;
 }
 
 bool Mfa2Buffer::loadFile(const std::string& fname)
@@ -38,6 +58,30 @@ bool Mfa2Buffer::loadFile(const std::string& fname)
     // open the file:
     FILE * fp;
 
+    release();
+    m_pos = 0;
+
+#if !defined(__WIN__)
+    // Map the archive rather than reading it, components are extracted
+    // straight from the page cache
+    int fd = open(fname.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (!fstat(fd, &st) && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void * addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED) {
+            close(fd);
+            m_buff = (u_int8_t *)addr;
+            m_size = st.st_size;
+            m_mapped = true;
+            return true;
+        }
+    }
+    close(fd);
+#endif
+
     fp = fopen(fname.c_str(), "rb");
     if (!fp) {
         return false;
@@ -48,12 +92,6 @@ bool Mfa2Buffer::loadFile(const std::string& fname)
     m_size=ftell(fp);
     fseek(fp, 0, SEEK_SET);
 
-    //Allocate memory
-    if (m_buff) {
-        delete [] m_buff;
-        m_buff = NULL;
-    }
-
     m_buff= new u_int8_t[m_size+1];
     if (!m_buff)
     {
@@ -44,9 +44,12 @@ public:
         return m_size;
     }
 private:
+    void release();
+
     u_int8_t * m_buff;
     long m_pos;
     long m_size;
+    bool m_mapped;
 };
 
 #endif /* _MFA2_BUFF_H_ */
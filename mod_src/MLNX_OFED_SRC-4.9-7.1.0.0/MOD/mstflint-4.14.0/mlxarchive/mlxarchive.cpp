@@ -41,6 +41,8 @@
 #include <string>
 #include <vector>
 #include <iostream>
+#include <stdlib.h>
+#include <sys/time.h>
 #include <boost/regex.hpp>
 #include <compatibility.h>
 #include "mlxarchive_mfa2_package_gen.h"
@@ -72,6 +74,14 @@
 #define VERSION_FLAG_SHORT          'v'
 #define MFA2_FILE_FLAG              "mfa2-file"
 #define MFA2_FILE_FLAG_SHORT        'm'
+#define THREADS_FLAG                "threads"
+#define THREADS_FLAG_SHORT          't'
+#define BENCH_FLAG                  "bench"
+#define BENCH_FLAG_SHORT            ' '
+
+/* Random data the bench packs as a single component, it spans many xz blocks
+ * and does not compress, so the components block is the largest it can get */
+#define BENCH_INCOMPRESSIBLE_SIZE   (32 * 1024 * 1024)
 
 using namespace mlxarchive;
 bool writeToFile(const string&, const vector<u_int8_t>&);
@@ -89,6 +99,8 @@ Mlxarchive::Mlxarchive() :
     _version  = "";
     _mfa2file = "";
     _printMiniDump = false;
+    _threads  = 0;
+    _bench    = false;
 }
 
 /************************************
@@ -103,6 +115,8 @@ void Mlxarchive::initCmdParser()
     AddOptions(OUT_FILE_FLAG,     OUT_FILE_FLAG_SHORT, "out_file", "Output file");
     AddOptions(BINS_DIR_FLAG,     BINS_DIR_FLAG_SHORT, "bins_dir", "Directory with the binaries files");
     AddOptions(MFA2_FILE_FLAG,    MFA2_FILE_FLAG_SHORT, "mfa2_file", "Mfa2 file to parse");
+    AddOptions(THREADS_FLAG,      THREADS_FLAG_SHORT,  "num_of_threads", "Number of threads compressing the MFA2 file, default is one per CPU");
+    AddOptions(BENCH_FLAG,        BENCH_FLAG_SHORT,    "", "Build an MFA2 file from incompressible data, then from bins_dir, in memory with 1, 2, 4 ... up to num_of_threads threads and report the build time of each", true);
     _cmdParser.AddRequester(this);
 }
 
@@ -114,6 +128,13 @@ void Mlxarchive::paramValidate()
     boost::smatch match;
     bool status_match;
     bool success = true;
+    if (_bench) {
+        if (_binsDir.empty() || _version.empty() || !_mfa2file.empty()) {
+            fprintf(stderr, "bench requires the bins_dir and version parameters only\n");
+            exit(1);
+        }
+        return;
+    }
     if(!_mfa2file.empty()) {
         if(!(_binsDir.empty() && _outFile.empty() && _version.empty())) {
             fprintf(stderr, "Cannot use any parameter when using mfa2_file parameter!\n");
@@ -204,6 +225,18 @@ ParseStatus Mlxarchive::HandleOption(string name, string value)
         }
         _mfa2file = value;
         return PARSE_OK;
+    } else if (name == THREADS_FLAG) {
+        char* end;
+        unsigned long threads = strtoul(value.c_str(), &end, 0);
+        if (value.empty() || *end || !threads || threads > 1024) {
+            cout << "Number of threads should be between 1 and 1024" << endl;
+            return PARSE_ERROR;
+        }
+        _threads = threads;
+        return PARSE_OK;
+    } else if (name == BENCH_FLAG) {
+        _bench = true;
+        return PARSE_OK;
     }
     else{
         cout << "Unknown flag specified" << endl;
@@ -225,16 +258,22 @@ int Mlxarchive::run(int argc, char **argv)
         return 1;
     }
     paramValidate();
+    if (_bench) {
+        return runBench();
+    }
     if(_mfa2file.empty()) {
     string outputFile = _outFile;
     string content = "";
     vector<u_int8_t> buff;
-    MFA2PackageGen mfa2PackageGen;
+    MFA2PackageGen mfa2PackageGen(_threads);
     string dir = _binsDir;
     string version = _version;
 
     buff.clear();
-    mfa2PackageGen.generateBinFromFWDirectory(dir, version, buff);
+    if (!mfa2PackageGen.generateBinFromFWDirectory(dir, version, buff)) {
+        fprintf(stderr, "-E- Failed to generate the MFA2 file from %s\n", dir.c_str());
+        return 1;
+    }
     //Save output to a file
     if (!writeToFile(outputFile, buff)) {
         fprintf(stderr, "-E- Cannot write to the file %s\n",   outputFile.c_str());
@@ -258,6 +297,65 @@ int Mlxarchive::run(int argc, char **argv)
     return 0;
 }
 
+/************************************
+ * * Function: runBench
+ * ************************************/
+int Mlxarchive::runBench()
+{
+    u_int32_t maxThreads = _threads;
+    if (!maxThreads) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        maxThreads = cpus > 0 ? cpus : 1;
+    }
+
+    vector<u_int8_t> randomData(BENCH_INCOMPRESSIBLE_SIZE);
+    srand(0);
+    for (size_t i = 0; i < randomData.size(); i++) {
+        randomData[i] = (u_int8_t)(rand() >> 7);
+    }
+
+    for (int incompressible = 1; incompressible >= 0; incompressible--) {
+        if (incompressible) {
+            printf("Incompressible component, %u bytes:\n", BENCH_INCOMPRESSIBLE_SIZE);
+        } else {
+            printf("\nComponents from %s:\n", _binsDir.c_str());
+        }
+        printf("%-8s %-12s %-12s %s\n", "Threads", "Time [sec]", "Speedup", "Size");
+        double baseTime = 0;
+        for (u_int32_t threads = 1; ; threads *= 2) {
+            if (threads > maxThreads) {
+                threads = maxThreads;
+            }
+            vector<u_int8_t> buff;
+            MFA2PackageGen mfa2PackageGen(threads);
+            struct timeval start, end;
+            bool rc;
+
+            gettimeofday(&start, NULL);
+            if (incompressible) {
+                rc = mfa2PackageGen.generateBinFromData(_version, randomData, buff);
+            } else {
+                rc = mfa2PackageGen.generateBinFromFWDirectory(_binsDir, _version, buff);
+            }
+            gettimeofday(&end, NULL);
+            if (!rc) {
+                fprintf(stderr, "-E- Failed to generate the MFA2 file with %u threads\n", threads);
+                return 1;
+            }
+
+            double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
+            if (threads == 1) {
+                baseTime = elapsed;
+            }
+            printf("%-8u %-12.3f %-12.2f %lu\n", threads, elapsed, baseTime / elapsed, (unsigned long)buff.size());
+            if (threads == maxThreads) {
+                break;
+            }
+        }
+    }
+    return 0;
+}
+
 Mlxarchive::~Mlxarchive() {};
 
 bool writeToFile(const string& fname, const vector<u_int8_t>& data)
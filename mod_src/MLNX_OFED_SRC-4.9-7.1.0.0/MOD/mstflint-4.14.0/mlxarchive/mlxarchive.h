@@ -50,6 +50,7 @@ private:
     void initCmdParser();
     void printHelp();
     void paramValidate();
+    int runBench();
     CommandLineParser _cmdParser;
     std::string _binsDir;
     std::string _outFile;
@@ -57,5 +58,7 @@ private:
     std::string _version;
     std::string _mfa2file;
         bool _printMiniDump;
+    u_int32_t _threads;
+    bool _bench;
 };
 }
@@ -77,7 +77,7 @@ void MFA2::packDescriptors(vector<u_int8_t>& buff) const
     }
 }
 
-void MFA2::pack(vector<u_int8_t>& buff)
+bool MFA2::pack(vector<u_int8_t>& buff)
 {
     //find size of components block:
     u_int64_t componentsBlockSize = 0;
@@ -100,25 +100,27 @@ void MFA2::pack(vector<u_int8_t>& buff)
 
     _packageDescriptor.setComponentsBlockOffset(buff.size());
 
-    //compress components block
+    //compress components block, only the first pass compresses since the
+    //components don't change between the passes of generateBinary()
     vector<u_int8_t> componentsBlockBuff;
     VECTOR_ITERATOR(Component, _components, it) {
         (*it).setComponentBinaryOffset(componentsBlockBuff.size());
         (*it).packData(componentsBlockBuff);
     }
-    u_int32_t zippedSize = componentsBlockBuff.size();
-    zippedSize = xz_compress_crc32(8, componentsBlockBuff.data(),
-            componentsBlockBuff.size(), NULL, 0);
-    if (zippedSize <= 0)
-    {
-        //TODO throw exception
-        printf("-E- Error while compressing\n");
-        exit(1);
+    vector<u_int8_t>& zippedComponentBlockBuff = _zippedComponentsBlock;
+    if (zippedComponentBlockBuff.empty()) {
+        zippedComponentBlockBuff.resize(xz_compress_bound(componentsBlockBuff.size(), MFA2_COMPONENTS_XZ_BLOCK_SIZE));
+        int32_t zippedSize = xz_compress_blocks_crc32(9, MFA2_COMPONENTS_XZ_BLOCK_SIZE,
+                _compressionThreads, componentsBlockBuff.data(), componentsBlockBuff.size(),
+                zippedComponentBlockBuff.data(), zippedComponentBlockBuff.size());
+        if (zippedSize <= 0) {
+            fprintf(stderr, "-E- Error while compressing: %s\n", xz_get_error(zippedSize));
+            zippedComponentBlockBuff.clear();
+            return false;
+        }
+        zippedComponentBlockBuff.resize(zippedSize);
     }
-    _packageDescriptor.setComponentsBlockArchiveSize(zippedSize);
-    vector<u_int8_t> zippedComponentBlockBuff(zippedSize);
-    xz_compress_crc32(9, componentsBlockBuff.data(), componentsBlockBuff.size(),
-            zippedComponentBlockBuff.data(), zippedSize);
+    _packageDescriptor.setComponentsBlockArchiveSize(zippedComponentBlockBuff.size());
 
     //compute descriptors SHA256
     vector<u_int8_t> descriptorsBuff;
@@ -137,6 +139,7 @@ void MFA2::pack(vector<u_int8_t>& buff)
     mlxSignSHA256.getDigest(digest);
     _packageDescriptor.setSHA256(digest);
 
+    return true;
 }
 
 /*void MFA2::update(vector<u_int8_t>& buff)
@@ -147,24 +150,24 @@ void MFA2::pack(vector<u_int8_t>& buff)
     VECTOR_ITERATOR(_components, );
 }*/
 
-void MFA2::generateBinary(vector<u_int8_t>& buff)
+bool MFA2::generateBinary(vector<u_int8_t>& buff)
 {
     vector<u_int8_t> tmpBuff;
 
     //do first pass
-    pack(tmpBuff);
+    if (!pack(tmpBuff)) {
+        return false;
+    }
 
     //do second pass
-    pack(buff);
-
-    //compute SHA256
-
+    return pack(buff);
 }
 
 MFA2 * MFA2::LoadMFA2Package(const string & file_name) {
-    Mfa2Buffer mfa2buff;
-    if(!mfa2buff.loadFile(file_name)) {
+    Mfa2Buffer* mfa2buff = new Mfa2Buffer();
+    if(!mfa2buff->loadFile(file_name)) {
         fprintf(stderr, "Failed to load mfa2 package: %s\n", file_name.c_str());
+        delete mfa2buff;
         return NULL;
     }
     FingerPrint finger_print("");
@@ -173,12 +176,13 @@ MFA2 * MFA2::LoadMFA2Package(const string & file_name) {
     vector<DeviceDescriptor> deviceDescriptors;
     vector<Component>        components;
     MFA2 * mfa2pkg = new MFA2(packageDescriptor, deviceDescriptors, components);
-    if(!mfa2pkg->unpack(mfa2buff)) {
+    if(!mfa2pkg->unpack(*mfa2buff)) {
+        delete mfa2buff;
         delete mfa2pkg;
         mfa2pkg =  NULL;
         return NULL;
     }
-    mfa2pkg->setBufferAndZipOffset(mfa2buff.getBuffer(), mfa2buff.getSize(), mfa2buff.tell());
+    mfa2pkg->setBufferAndZipOffset(mfa2buff, mfa2buff->tell());
     return mfa2pkg;
 }
 
@@ -241,26 +245,55 @@ void MFA2::dump() {
     }
 }
 
-bool MFA2::extractComponent(Component* requiredComponent, vector<u_int8_t>& fwBinaryData)
+bool MFA2::extractComponentFromStream(u_int8_t* zippedData, u_int32_t zippedSize,
+                                      u_int64_t offset, vector<u_int8_t>& fwBinaryData)
 {
-    PackageDescriptor packageDescriptor = getPackageDescriptor();
-    u_int64_t totalSize = packageDescriptor.getComponentsBlockSize();
-    u_int32_t zipOffset = packageDescriptor.getComponentsBlockOffset();
-
-    vector<u_int8_t> unzippedBlockBuff;
-    unzippedBlockBuff.resize(totalSize);
-    vector<u_int8_t> zippedBuff = getBuffer();
-    u_int8_t* zippedData = (u_int8_t*)zippedBuff.data() + zipOffset;
-    int32_t retVal = xz_decompress_crc32(zippedData, zippedBuff.size() - zipOffset, unzippedBlockBuff.data(), totalSize);
+    u_int64_t totalSize = _packageDescriptor.getComponentsBlockSize();
+
+    if (offset + fwBinaryData.size() > totalSize) {
+        printf("Component is out of the components block\n");
+        return false;
+    }
+    vector<u_int8_t> unzippedBlockBuff(totalSize);
+    int32_t retVal = xz_decompress_crc32(zippedData, zippedSize, unzippedBlockBuff.data(), totalSize);
     if (retVal != (int32_t)totalSize) {
         printf("Decompress error occurred %s\n", xz_get_error(retVal));
         return false;
     }
-    u_int32_t requiredOffset = requiredComponent->getBinaryComponentOffset();
+    memcpy(fwBinaryData.data(), unzippedBlockBuff.data() + offset, fwBinaryData.size());
+    return true;
+}
+
+bool MFA2::extractComponent(Component* requiredComponent, vector<u_int8_t>& fwBinaryData)
+{
+    u_int32_t zipOffset = _packageDescriptor.getComponentsBlockOffset();
+    u_int32_t zippedSize = _packageDescriptor.getComponentsBlockArchiveSize();
+    u_int8_t* buffer = getBuffer();
+    long bufferSize = getBufferSize();
+
+    if (!buffer || (long)zipOffset >= bufferSize) {
+        printf("Components block is missing\n");
+        return false;
+    }
+    if (!zippedSize || (long)zipOffset + zippedSize > bufferSize) {
+        zippedSize = bufferSize - zipOffset;
+    }
+    u_int8_t* zippedData = buffer + zipOffset;
+
+    //skip the 16 bytes component fingerprint
+    u_int64_t requiredOffset = requiredComponent->getBinaryComponentOffset() + strlen(FINGERPRINT_MFA2);
     u_int32_t componentBinarySize = requiredComponent->getComponentBinarySize() - strlen(FINGERPRINT_MFA2);
     fwBinaryData.resize(componentBinarySize);
-    for (unsigned int index = 0; index < componentBinarySize; index++) {
-        fwBinaryData[index] = unzippedBlockBuff[requiredOffset + index + strlen(FINGERPRINT_MFA2)];//skip 16 bytes from decompressed file !
+
+    int32_t retVal = xz_decompress_range(zippedData, zippedSize, requiredOffset,
+                                         fwBinaryData.data(), componentBinarySize);
+    if (retVal == XZ_ERR_NO_INDEX) {
+        //not a single indexed xz stream, decompress the whole block
+        return extractComponentFromStream(zippedData, zippedSize, requiredOffset, fwBinaryData);
+    }
+    if (retVal != (int32_t)componentBinarySize) {
+        printf("Decompress error occurred %s\n", xz_get_error(retVal));
+        return false;
     }
     return true;
 }
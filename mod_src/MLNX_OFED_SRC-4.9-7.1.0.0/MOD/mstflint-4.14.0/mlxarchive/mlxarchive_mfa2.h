@@ -53,6 +53,9 @@
 
 using namespace std;
 
+/* The components block is one xz stream cut into independently decodable
+ * blocks of this size, extraction decodes only the blocks a component spans */
+#define MFA2_COMPONENTS_XZ_BLOCK_SIZE (2 * 1024 * 1024)
 
 namespace mfa2 {
     typedef map <string, Component> map_string_to_component;
@@ -66,11 +69,17 @@ private:
         string                   _latestComponentKey;
         long _zipOffset;
     //void updateSHA256();
-        vector<u_int8_t> mfa2Buffer;
-    void pack(vector<u_int8_t>& buff);
+        Mfa2Buffer* _mfa2Buffer;
+        u_int32_t _compressionThreads;
+        vector<u_int8_t> _zippedComponentsBlock;
+    bool pack(vector<u_int8_t>& buff);
     void packDescriptors(vector<u_int8_t>& buff) const;
     bool unpack(Mfa2Buffer & buff);
         bool extractComponent(Component* requiredComponent, vector<u_int8_t>& fwBinaryData);
+        bool extractComponentFromStream(u_int8_t* zippedData, u_int32_t zippedSize,
+                                        u_int64_t offset, vector<u_int8_t>& fwBinaryData);
+        MFA2(const MFA2&);
+        MFA2& operator=(const MFA2&);
 public:
     MFA2(PackageDescriptor packageDescriptor,
          vector<DeviceDescriptor> deviceDescriptors,
@@ -78,11 +87,16 @@ public:
              _fingerPrint(MFA2_FINGER_PRINT),
              _packageDescriptor(packageDescriptor),
              _deviceDescriptors(deviceDescriptors),
-            _components(components), _zipOffset(0){};
+            _components(components), _zipOffset(0), _mfa2Buffer(NULL),
+            _compressionThreads(0){};
 
-    virtual ~MFA2() {}
+    virtual ~MFA2() { delete _mfa2Buffer; }
     static MFA2 * LoadMFA2Package(const string & file_name);
-    void generateBinary(vector<u_int8_t>& buff);
+    bool generateBinary(vector<u_int8_t>& buff);
+        // Worker threads for compressing the components block, 0 for one per CPU
+        void setCompressionThreads(u_int32_t threads) {
+            _compressionThreads = threads;
+        }
     void dump();
         void minidump();
         PackageDescriptor getPackageDescriptor() const {
@@ -104,17 +118,20 @@ public:
             return _components[compIndex];
         }
 
-        void setBufferAndZipOffset(u_int8_t* buffer, long length, long zipOffset)
+        // Takes ownership of the loaded (mapped) archive
+        void setBufferAndZipOffset(Mfa2Buffer* buffer, long zipOffset)
         {
-            mfa2Buffer.resize(length);
-            for (int i = 0; i < length; i++) {
-                mfa2Buffer[i] = buffer[i];
-            }
+            delete _mfa2Buffer;
+            _mfa2Buffer = buffer;
             _zipOffset = zipOffset;
         }
 
-        vector<u_int8_t> getBuffer() {
-            return mfa2Buffer;
+        u_int8_t* getBuffer() const {
+            return _mfa2Buffer ? _mfa2Buffer->getBuffer() : NULL;
+        }
+
+        long getBufferSize() const {
+            return _mfa2Buffer ? _mfa2Buffer->getSize() : 0;
         }
         map_string_to_component getMatchingComponents(char* psid, int majorVer);
         bool unzipComponent(map_string_to_component& matchingComponentsMap, u_int32_t choice, vector<u_int8_t>& fwBinaryData);
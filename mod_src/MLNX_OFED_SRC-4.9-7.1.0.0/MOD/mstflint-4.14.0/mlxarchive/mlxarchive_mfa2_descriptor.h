@@ -132,6 +132,7 @@ public:
     const VersionExtension & getVersionExtension() const {return _version;}
     u_int64_t getComponentsBlockSize  ();
     u_int32_t getComponentsBlockOffset  ();
+    u_int32_t getComponentsBlockArchiveSize() const { return _componentsBlockArchiveSize; }
 };
 
 inline void PackageDescriptor::setComponentsBlockOffset(u_int64_t offset)
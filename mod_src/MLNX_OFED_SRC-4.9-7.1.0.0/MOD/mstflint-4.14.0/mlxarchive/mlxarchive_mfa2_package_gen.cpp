@@ -43,7 +43,7 @@
 #include "mlxarchive_mfa2_builder.h"
 
 
-void MFA2PackageGen::generateBinFromJSON(const string& jsonFile,
+bool MFA2PackageGen::generateBinFromJSON(const string& jsonFile,
         vector<u_int8_t>& buff) const
 {
     /*Director director;
@@ -56,17 +56,32 @@ void MFA2PackageGen::generateBinFromJSON(const string& jsonFile,
     MFA2 mfa2(builder.getPackageDescriptor(),
             builder.getDeviceDescriptors(),
             builder.getComponents());
-    mfa2.generateBinary(buff);
+    mfa2.setCompressionThreads(_compressionThreads);
+    return mfa2.generateBinary(buff);
 
     //mfa2.patch(buff);
 }
 
-void MFA2PackageGen::generateBinFromFWDirectory(const string& directory, const string& version,
+bool MFA2PackageGen::generateBinFromFWDirectory(const string& directory, const string& version,
         vector<u_int8_t>& buff) const
 {
     FWDirectoryBuilder builder(version, directory);
     MFA2 mfa2(builder.getPackageDescriptor(),
             builder.getDeviceDescriptors(),
             builder.getComponents());
-    mfa2.generateBinary(buff);
+    mfa2.setCompressionThreads(_compressionThreads);
+    return mfa2.generateBinary(buff);
+}
+
+bool MFA2PackageGen::generateBinFromData(const string& version, const vector<u_int8_t>& data,
+        vector<u_int8_t>& buff) const
+{
+    VersionExtension versionExtension(version);
+    vector<Component> components;
+    components.push_back(Component(ComponentDescriptor(versionExtension, data)));
+    MFA2 mfa2(PackageDescriptor(0, 1, versionExtension),
+            vector<DeviceDescriptor>(),
+            components);
+    mfa2.setCompressionThreads(_compressionThreads);
+    return mfa2.generateBinary(buff);
 }
@@ -54,12 +54,15 @@ using namespace mfa2;
 class MFA2PackageGen {
 
 private:
+    u_int32_t _compressionThreads;
 
 public:
-    MFA2PackageGen() {};
+    explicit MFA2PackageGen(u_int32_t compressionThreads = 0) :
+        _compressionThreads(compressionThreads) {};
 
-    void generateBinFromJSON(const string& jsonFile, vector<u_int8_t>& buff) const;
-    void generateBinFromFWDirectory(const string& directory, const string& version, vector<u_int8_t>& buff) const;
+    bool generateBinFromJSON(const string& jsonFile, vector<u_int8_t>& buff) const;
+    bool generateBinFromFWDirectory(const string& directory, const string& version, vector<u_int8_t>& buff) const;
+    bool generateBinFromData(const string& version, const vector<u_int8_t>& data, vector<u_int8_t>& buff) const;
     //void generateBinFromDir     (vector<u_int8_t>& buff);
     //void generateJSONFromDir    (const string& output);
     //void generateJSONFromBin    (const string& output);
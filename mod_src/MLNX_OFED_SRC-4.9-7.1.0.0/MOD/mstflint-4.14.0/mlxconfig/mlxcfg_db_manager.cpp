@@ -36,7 +36,6 @@
  *      Author: ahmads
  */
 
-#include <stdarg.h>
 #include <stdio.h>
 
 //#define NDEBUG //uncomment in order to enable asserts
@@ -55,20 +54,19 @@ using namespace std;
     "SELECT * FROM params"
 
 #define SQL_SELECT_TLV_BY_NAME_AND_PORT \
-    "SELECT * FROM tlvs WHERE name='%s' and port='%d'"
+    "SELECT * FROM tlvs WHERE name=?1 and port=?2"
 
 #define SQL_SELECT_TLV_BY_INDEX_AND_CLASS \
-    "SELECT * FROM tlvs WHERE id=%d and class=%d"
+    "SELECT * FROM tlvs WHERE id=?1 and class=?2"
 
 #define SQL_SELECT_PARAMS_BY_TLV_NAME_AND_PORT \
-    "SELECT * FROM params WHERE tlv_name='%s' and port='%d'"
+    "SELECT * FROM params WHERE tlv_name=?1 and port=?2"
 
-#define SQL_SELECT_PARAM_BY_MLXCONFIG_NAME \
-    "SELECT * FROM params WHERE mlxconfig_name='%s'"
+#define SQL_SELECT_TLV_KEY_BY_PARAM_MLXCONFIG_NAME \
+    "SELECT tlv_name, port FROM params WHERE mlxconfig_name=?1"
 
 MlxcfgDBManager::MlxcfgDBManager(string dbName) : _dbName(dbName),
-    _db(NULL), _supportedVersion(0x0), _callBackErr(""), _isAllFetched(false),
-    _paramSqlResult(NULL)
+    _db(NULL), _supportedVersion(0x0), _callBackErr(""), _isAllFetched(false)
 {
     openDB();
 }
@@ -81,6 +79,9 @@ MlxcfgDBManager::~MlxcfgDBManager()
     VECTOR_ITERATOR(Param*, fetchedParams, it) {
         delete *it;
     }
+    MAP_ITERATOR(string, sqlite3_stmt*, _stmts, it) {
+        sqlite3_finalize(it->second);
+    }
     if (!_db) {
         return;
     }
@@ -101,6 +102,7 @@ void MlxcfgDBManager::checkDBVersion()
             break;
         }
     }
+    sqlite3_finalize(stmt);
 
     if (dbVersion != _supportedVersion) {
         throw MlxcfgException("Unsupported database version");
@@ -126,26 +128,53 @@ void MlxcfgDBManager::openDB()
     return;
 }
 
-void MlxcfgDBManager::execSQL(sqlite3_callback f, void *obj,
-                              const char *stat, ...)
+sqlite3_stmt* MlxcfgDBManager::prepareSQL(const char *sql)
 {
-    va_list vl;
-    char sql[1024];
-    char *zErrMsg = 0;
+    sqlite3_stmt *&stmt = _stmts[sql];
 
-    va_start(vl, stat);
-    vsnprintf(sql, sizeof(sql), stat, vl);
-    va_end(vl);
+    if (stmt) {
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+        return stmt;
+    }
+    if (sqlite3_prepare_v2(_db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+        string e = sqlite3_errmsg(_db);
+        _stmts.erase(sql);
+        throw MlxcfgException("Cannot prepare %s, %s", sql, e.c_str());
+    }
+    return stmt;
+}
 
-    if (sqlite3_exec(_db, sql, f, obj, &zErrMsg) != SQLITE_OK) {
-        string e = zErrMsg;
-        sqlite3_free(zErrMsg);
+void MlxcfgDBManager::execSQL(sqlite3_callback f, void *obj, sqlite3_stmt *stmt)
+{
+    int rc;
+    int argc = sqlite3_column_count(stmt);
+    vector<char*> argv(argc);
+    vector<char*> azColName(argc);
+
+    for (int i = 0; i < argc; i++) {
+        azColName[i] = (char*)sqlite3_column_name(stmt, i);
+    }
+    //same as sqlite3_exec, pass every row to the callback as text
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        for (int i = 0; i < argc; i++) {
+            argv[i] = (char*)sqlite3_column_text(stmt, i);
+        }
+        if (f(obj, argc, argc ? &argv[0] : NULL, argc ? &azColName[0] : NULL)) {
+            rc = SQLITE_ABORT;
+            break;
+        }
+    }
+    if (rc != SQLITE_DONE) {
+        string e = rc == SQLITE_ABORT ? "query aborted" : sqlite3_errmsg(_db);
+        sqlite3_reset(stmt);
         if (_callBackErr.empty()) {
-            throw MlxcfgException("Cannot execute %s, %s", sql, e.c_str());
+            throw MlxcfgException("Cannot execute %s, %s", sqlite3_sql(stmt), e.c_str());
         } else {
             throw MlxcfgException(_callBackErr.c_str());
         }
     }
+    sqlite3_reset(stmt);
 }
 
 int MlxcfgDBManager::selectTLVCallBack(void *object, int argc, char **argv, char **azColName)
@@ -210,49 +239,74 @@ int MlxcfgDBManager::selectParamCallBack(void *object, int argc, char **argv,
     return 0;
 }
 
-int MlxcfgDBManager::selectParamByMlxconfigNameCallBack(void *object, int argc,
-                                                        char **argv, char **azColName)
+/*
+   Index the TLVs and params fetched from fetchedTLVs[firstTLV] and
+   fetchedParams[firstParam] on. Rows of TLVs that were already fetched are dropped.
+ */
+void MlxcfgDBManager::indexFetched(size_t firstTLV, size_t firstParam)
 {
-    MlxcfgDBManager *dbManager = reinterpret_cast<MlxcfgDBManager*>(object);
-    try {
-        dbManager->_paramSqlResult = new Param(argc, argv, azColName);
-    } catch (MlxcfgException& e) {
-        dbManager->_callBackErr = e._err;
-        return SQLITE_ABORT;
+    std::set<TLVConf*> newTLVs;
+    size_t j = firstTLV;
+
+    for (size_t i = firstTLV; i < fetchedTLVs.size(); i++) {
+        TLVConf *t = fetchedTLVs[i];
+        if (!_tlvsByName.insert(make_pair(make_pair(t->_name, t->_port), t)).second) {
+            delete t;
+            continue;
+        }
+        _tlvsByIndexAndClass.insert(make_pair(make_pair(t->_id, (u_int32_t)t->_tlvClass), t));
+        newTLVs.insert(t);
+        fetchedTLVs[j++] = t;
     }
-    return 0;
+    fetchedTLVs.resize(j);
+
+    j = firstParam;
+    for (size_t i = firstParam; i < fetchedParams.size(); i++) {
+        Param *p = fetchedParams[i];
+        map<pair<string, u_int8_t>, TLVConf*>::iterator it =
+            _tlvsByName.find(make_pair(p->_tlvName, (u_int8_t)p->_port));
+        if (it == _tlvsByName.end()) {
+            //keep the params that weren't handled yet for the cleanup
+            fetchedParams.erase(fetchedParams.begin() + j, fetchedParams.begin() + i);
+            throw MlxcfgException("A parameter without a TLV configuration: %s", p->_name.c_str());
+        }
+        if (!newTLVs.count(it->second)) {
+            delete p;
+            continue;
+        }
+        it->second->_params.push_back(p);
+        if (!p->_mlxconfigName.empty()) {
+            _tlvsByParamMlxconfigName.insert(make_pair(p->_mlxconfigName, it->second));
+        }
+        fetchedParams[j++] = p;
+    }
+    fetchedParams.resize(j);
 }
 
 void MlxcfgDBManager::getAllTLVs()
 {
-    size_t i = 0, j = 0;
+    size_t firstTLV = fetchedTLVs.size(), firstParam = fetchedParams.size();
+    vector<pair<string, u_int8_t> > order;
 
     if (_isAllFetched) {
         return;
     }
 
     //fetch from db all tlvs
-    execSQL(selectTLVCallBack, this, SQL_SELECT_ALL_TLVS);
+    execSQL(selectTLVCallBack, this, prepareSQL(SQL_SELECT_ALL_TLVS));
 
     //fetch from db all params
-    execSQL(selectParamCallBack, this, SQL_SELECT_ALL_PARAMS);
+    execSQL(selectParamCallBack, this, prepareSQL(SQL_SELECT_ALL_PARAMS));
 
-    /*
-       Fill in TLV.params vector
-       we assume that params table is grouped by tlv name
-     */
-    while (j < fetchedTLVs.size() && i < fetchedParams.size()) {
-        Param *p = fetchedParams[i];
-        if (p->_tlvName == fetchedTLVs[j]->_name &&
-            p->_port == fetchedTLVs[j]->_port) {
-            fetchedTLVs[j]->_params.push_back(p);
-            i++;//move to next parameter
-        } else {
-            j++;//move to next tlv
-        }
+    for (size_t i = firstTLV; i < fetchedTLVs.size(); i++) {
+        order.push_back(make_pair(fetchedTLVs[i]->_name, fetchedTLVs[i]->_port));
     }
-    if (j >= fetchedTLVs.size() && i < fetchedParams.size()) {
-        throw MlxcfgException("A parameter without a TLV configuration: %s", fetchedParams[i]->_name.c_str());
+    indexFetched(firstTLV, firstParam);
+
+    //keep the DB order, also for TLVs that were fetched on their own before
+    fetchedTLVs.clear();
+    for (size_t i = 0; i < order.size(); i++) {
+        fetchedTLVs.push_back(_tlvsByName[order[i]]);
     }
     //TODO check if there is a tlv that does not have params
 
@@ -261,36 +315,36 @@ void MlxcfgDBManager::getAllTLVs()
 
 TLVConf* MlxcfgDBManager::getTLVByNameAux(string n, u_int8_t port)
 {
-    VECTOR_ITERATOR(TLVConf*, fetchedTLVs, it) {
-        TLVConf *t = *it;
-        if (t->_name == n && t->_port == port) {
-            return t;
-        }
-    }
-    return NULL;
+    map<pair<string, u_int8_t>, TLVConf*>::iterator it = _tlvsByName.find(make_pair(n, port));
+    return it == _tlvsByName.end() ? NULL : it->second;
 }
 
 TLVConf* MlxcfgDBManager::fetchTLVByName(string n, u_int8_t port)
 {
     TLVConf *t;
     const char *nc = n.c_str();
-
-    execSQL(selectTLVCallBack, this, SQL_SELECT_TLV_BY_NAME_AND_PORT,
-            nc, port);
-    t = getTLVByNameAux(n, port);
-    if (!t) {
+    size_t firstTLV = fetchedTLVs.size(), firstParam = fetchedParams.size();
+    sqlite3_stmt *stmt;
+
+    stmt = prepareSQL(SQL_SELECT_TLV_BY_NAME_AND_PORT);
+    sqlite3_bind_text(stmt, 1, nc, -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int(stmt, 2, port);
+    execSQL(selectTLVCallBack, this, stmt);
+    if (fetchedTLVs.size() == firstTLV) {
         throw MlxcfgException("The TLV configuration %s was not found", nc);
     }
 
     //fetch the parameters
-    execSQL(selectParamCallBack, this,
-            SQL_SELECT_PARAMS_BY_TLV_NAME_AND_PORT, nc, port);
+    stmt = prepareSQL(SQL_SELECT_PARAMS_BY_TLV_NAME_AND_PORT);
+    sqlite3_bind_text(stmt, 1, nc, -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int(stmt, 2, port);
+    execSQL(selectParamCallBack, this, stmt);
 
     //fill in params vector of the tlv
-    VECTOR_ITERATOR(Param*, fetchedParams, p) {
-        if ((*p)->_tlvName == t->_name && (*p)->_port == port) {
-            t->_params.push_back(*p);
-        }
+    indexFetched(firstTLV, firstParam);
+    t = getTLVByNameAux(n, port);
+    if (!t) {
+        throw MlxcfgException("The TLV configuration %s was not found", nc);
     }
 
     return t;
@@ -299,25 +353,32 @@ TLVConf* MlxcfgDBManager::fetchTLVByName(string n, u_int8_t port)
 TLVConf* MlxcfgDBManager::fetchTLVByIndexAndClass(u_int32_t id, TLVClass c)
 {
     TLVConf *t;
+    size_t firstTLV = fetchedTLVs.size(), firstParam = fetchedParams.size();
+    sqlite3_stmt *stmt;
+
+    stmt = prepareSQL(SQL_SELECT_TLV_BY_INDEX_AND_CLASS);
+    sqlite3_bind_int64(stmt, 1, id);
+    sqlite3_bind_int(stmt, 2, c);
+    execSQL(selectTLVCallBack, this, stmt);
+
+    //fetch the parameters of the tlvs that weren't fetched before
+    for (size_t i = firstTLV; i < fetchedTLVs.size(); i++) {
+        if (getTLVByNameAux(fetchedTLVs[i]->_name, fetchedTLVs[i]->_port)) {
+            continue;
+        }
+        stmt = prepareSQL(SQL_SELECT_PARAMS_BY_TLV_NAME_AND_PORT);
+        sqlite3_bind_text(stmt, 1, fetchedTLVs[i]->_name.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int(stmt, 2, fetchedTLVs[i]->_port);
+        execSQL(selectParamCallBack, this, stmt);
+    }
 
-    execSQL(selectTLVCallBack, this, SQL_SELECT_TLV_BY_INDEX_AND_CLASS,
-            id, c);
+    //fill in params vector of the tlvs
+    indexFetched(firstTLV, firstParam);
     t = getTLVByIndexAndClassAux(id, c);
     if (!t) {
         throw MlxcfgException("The TLV configuration with index 0x%x and class 0x%x was not found", id, c);
     }
 
-    //fetch the parameters
-    execSQL(selectParamCallBack, this,
-            SQL_SELECT_PARAMS_BY_TLV_NAME_AND_PORT, t->_name.c_str(), t->_port);
-
-    //fill in params vector of the tlv
-    VECTOR_ITERATOR(Param*, fetchedParams, p) {
-        if ((*p)->_tlvName == t->_name && (*p)->_port == t->_port) {
-            t->_params.push_back(*p);
-        }
-    }
-
     return t;
 }
 
@@ -325,16 +386,21 @@ TLVConf* MlxcfgDBManager::getAndCreateTLVByName(string n, u_int8_t port)
 {
     TLVConf *tlv = NULL;
     const char *nc = n.c_str();
+    sqlite3_stmt *stmt;
 
-    execSQL(selectAndCreateNewTLVCallBack, &tlv, SQL_SELECT_TLV_BY_NAME_AND_PORT,
-            nc, port);
+    stmt = prepareSQL(SQL_SELECT_TLV_BY_NAME_AND_PORT);
+    sqlite3_bind_text(stmt, 1, nc, -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int(stmt, 2, port);
+    execSQL(selectAndCreateNewTLVCallBack, &tlv, stmt);
     if (!tlv) {
         throw MlxcfgException("The TLV configuration %s was not found", nc);
     }
 
     //fetch the parameters
-    execSQL(selectAndCreateParamCallBack, tlv,
-            SQL_SELECT_PARAMS_BY_TLV_NAME_AND_PORT, nc, port);
+    stmt = prepareSQL(SQL_SELECT_PARAMS_BY_TLV_NAME_AND_PORT);
+    sqlite3_bind_text(stmt, 1, nc, -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int(stmt, 2, port);
+    execSQL(selectAndCreateParamCallBack, tlv, stmt);
 
     return tlv;
 }
@@ -353,47 +419,56 @@ TLVConf* MlxcfgDBManager::getTLVByName(string n, u_int8_t port)
 
 TLVConf* MlxcfgDBManager::getTLVByIndexAndClassAux(u_int32_t id, TLVClass c)
 {
-    VECTOR_ITERATOR(TLVConf*, fetchedTLVs, it) {
-        TLVConf *t = *it;
-        if (t->_id == id && t->_tlvClass == c) {
-            return t;
-        }
+    map<pair<u_int32_t, u_int32_t>, TLVConf*>::iterator it =
+        _tlvsByIndexAndClass.find(make_pair(id, (u_int32_t)c));
+    return it == _tlvsByIndexAndClass.end() ? NULL : it->second;
+}
+
+bool MlxcfgDBManager::fetchParamTLVKey(const string& n, string& tlvName, u_int32_t& port)
+{
+    bool found = false;
+    sqlite3_stmt *stmt = prepareSQL(SQL_SELECT_TLV_KEY_BY_PARAM_MLXCONFIG_NAME);
+
+    sqlite3_bind_text(stmt, 1, n.c_str(), -1, SQLITE_TRANSIENT);
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        const char *name = (const char*)sqlite3_column_text(stmt, 0);
+        tlvName = name ? name : "";
+        port = (u_int32_t)sqlite3_column_int(stmt, 1);
+        found = true;
     }
-    return NULL;
+    sqlite3_reset(stmt);
+    return found;
 }
 
 bool MlxcfgDBManager::isParamMlxconfigNameExist(std::string n)
 {
-    execSQL(selectParamByMlxconfigNameCallBack, this,
-        SQL_SELECT_PARAM_BY_MLXCONFIG_NAME, n.c_str());
+    string tlvName;
+    u_int32_t port;
 
-    return (n == _paramSqlResult->_mlxconfigName);
+    if (_tlvsByParamMlxconfigName.count(n)) {
+        return true;
+    }
+    return !_isAllFetched && fetchParamTLVKey(n, tlvName, port);
 }
 
 TLVConf* MlxcfgDBManager::getTLVByParamMlxconfigName(std::string n, u_int32_t index)
 {
-    u_int32_t port;
+    u_int32_t port = 0;
     string tlvName;
+    string newName = n + getArraySuffixByInterval(index);
+    map<string, TLVConf*>::iterator it;
 
-    VECTOR_ITERATOR(TLVConf*, fetchedTLVs, it) {
-        if ((*it)->findParamByMlxconfigName(n) || (*it)->findParamByMlxconfigName(n + getArraySuffixByInterval(index))) {
-            return (*it);
-        }
+    it = _tlvsByParamMlxconfigName.find(n);
+    if (it == _tlvsByParamMlxconfigName.end()) {
+        it = _tlvsByParamMlxconfigName.find(newName);
     }
-
-    //Try to find it in DB:dd
-    execSQL(selectParamByMlxconfigNameCallBack, this,
-            SQL_SELECT_PARAM_BY_MLXCONFIG_NAME, n.c_str());
-
-    // if not found try to find it with continuance array suffix
-    if (!_paramSqlResult) {
-        string newName = n + getArraySuffixByInterval(index);
-
-        execSQL(selectParamByMlxconfigNameCallBack, this,
-            SQL_SELECT_PARAM_BY_MLXCONFIG_NAME, newName.c_str());
+    if (it != _tlvsByParamMlxconfigName.end()) {
+        return it->second;
     }
 
-    if (!_paramSqlResult) {
+    //Try to find it in DB, if not found try to find it with continuance array suffix
+    if (_isAllFetched ||
+        (!fetchParamTLVKey(n, tlvName, port) && !fetchParamTLVKey(newName, tlvName, port))) {
         string suffix = "";
         if (index > 0) {
             if (isIndexedStartFromOneSupported(n)) {
@@ -407,12 +482,7 @@ TLVConf* MlxcfgDBManager::getTLVByParamMlxconfigName(std::string n, u_int32_t in
             (n + suffix).c_str());
     }
 
-    port = _paramSqlResult->_port;
-    tlvName = _paramSqlResult->_tlvName;
-    delete _paramSqlResult;
-    _paramSqlResult = NULL;
-
-    return fetchTLVByName(tlvName, port);
+    return getTLVByName(tlvName, port);
 }
 
 TLVConf* MlxcfgDBManager::getTLVByIndexAndClass(u_int32_t id, TLVClass c)
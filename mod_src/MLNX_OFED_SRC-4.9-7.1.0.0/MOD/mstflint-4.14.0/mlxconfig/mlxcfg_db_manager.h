@@ -40,6 +40,7 @@
 #define MLXCFG_FACTORY_H_
 
 #include <vector>
+#include <map>
 #include <exception>
 
 #include "mlxcfg_tlv.h"
@@ -52,15 +53,23 @@ private:
     std::string _dbName;
     sqlite3 *_db;
     const unsigned int _supportedVersion;
+    // Statements are prepared once and reused for the lifetime of the manager
+    std::map<std::string, sqlite3_stmt*> _stmts;
+    // Indexes of the fetched TLVs, a TLV is indexed with its params
+    std::map<std::pair<std::string, u_int8_t>, TLVConf*> _tlvsByName;
+    std::map<std::pair<u_int32_t, u_int32_t>, TLVConf*> _tlvsByIndexAndClass;
+    std::map<std::string, TLVConf*> _tlvsByParamMlxconfigName;
 
     static int selectAndCreateNewTLVCallBack(void *object, int argc, char **argv, char **azColName);
     static int selectTLVCallBack(void*, int, char**, char**);
     static int selectAndCreateParamCallBack(void *object, int argc, char **argv, char **azColName);
     static int selectParamCallBack(void*, int, char**, char**);
-    static int selectParamByMlxconfigNameCallBack(void*, int, char**, char**);
     void openDB();
     void checkDBVersion();
     inline bool isDBFileExists(const std::string& name);
+    sqlite3_stmt* prepareSQL(const char *sql);
+    void indexFetched(size_t firstTLV, size_t firstParam);
+    bool fetchParamTLVKey(const std::string& n, std::string& tlvName, u_int32_t& port);
     TLVConf* fetchTLVByName(std::string n, u_int8_t port);
     TLVConf* fetchTLVByIndexAndClass(u_int32_t id, TLVClass c);
 public:
@@ -69,7 +78,6 @@ public:
     std::string _callBackErr;
     bool _isAllFetched;
     bool isParamMlxconfigNameExist(std::string n);
-    Param *_paramSqlResult;
     std::vector<TLVConf*> fetchedTLVs;
     std::vector<Param*> fetchedParams;
     void getAllTLVs();
@@ -79,7 +87,7 @@ public:
     TLVConf* getAndCreateTLVByName(std::string n, u_int8_t port);
     TLVConf* getTLVByParamMlxconfigName(std::string n, u_int32_t index);
     TLVConf* getTLVByIndexAndClass(u_int32_t id, TLVClass c);
-    void execSQL(sqlite3_callback f, void *obj, const char *stat, ...);
+    void execSQL(sqlite3_callback f, void *obj, sqlite3_stmt *stmt);
 
 };
 
@@ -0,0 +1,262 @@
+/*
+ * Copyright (C) Jan 2013 Mellanox Technologies Ltd. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Replays the TLV catalog side of `mlxconfig query` and `mlxconfig set`
+ * against a mlxconfig DB, without a device:
+ *  - query:       getAllTLVs() and a walk of every TLV and param (queryAll)
+ *  - query names: the lookups queryParamViews() does for each parameter
+ *  - set:         the lookups setCfg() does for each parameter and its
+ *                 rule TLVs
+ * Every parameter must resolve the same way on a fresh manager, which
+ * fetches TLVs one by one, as on a manager holding the whole catalog.
+ *
+ * Runs with `make check` on mlxconfig_dbs/mlxconfig_host.db.
+ * mlxcfg_db_test --bench [db] times each command instead.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <set>
+#include "mlxcfg_db_manager.h"
+#include "mlxcfg_utils.h"
+
+using namespace std;
+
+#define BENCH_ROUNDS 5
+
+static double now()
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static size_t queryAll(MlxcfgDBManager& db)
+{
+    size_t params = 0;
+
+    db.getAllTLVs();
+    VECTOR_ITERATOR(TLVConf*, db.fetchedTLVs, it) {
+        if ((*it)->isMlxconfigSupported()) {
+            params += (*it)->_params.size();
+        }
+    }
+    return params;
+}
+
+// The TLV each name resolves to, as queryParamViews() looks them up
+static void queryParams(MlxcfgDBManager& db, const vector<string>& names, vector<TLVConf*>& tlvs)
+{
+    tlvs.clear();
+    for (size_t i = 0; i < names.size(); i++) {
+        unsigned int index = 0;
+        TLVConf *tlv = db.getTLVByParamMlxconfigName(names[i], index);
+        if (getArraySuffix(tlv->_name).size() > 0 && getArraySuffix(names[i]).size() == 0) {
+            while (db.isParamMlxconfigNameExist(names[i] + getArraySuffixByInterval((++index) * MAX_ARRAY_SIZE))) {
+            }
+        }
+        tlvs.push_back(tlv);
+    }
+}
+
+// The TLV each name resolves to, and the rule TLVs, as setCfg() looks them up
+static bool setParams(MlxcfgDBManager& db, const vector<string>& names, vector<TLVConf*>& tlvs)
+{
+    set<TLVConf*> uniqueTLVs;
+
+    tlvs.clear();
+    for (size_t i = 0; i < names.size(); i++) {
+        TLVConf *tlv = db.getTLVByParamMlxconfigName(names[i], 0);
+        tlvs.push_back(tlv);
+        uniqueTLVs.insert(tlv);
+    }
+    SET_ITERATOR(TLVConf*, uniqueTLVs, it) {
+        set<string> ruleTLVs;
+        (*it)->getRuleTLVs(ruleTLVs);
+        SET_ITERATOR(string, ruleTLVs, r) {
+            if (!db.getTLVByName(*r, (*it)->_port)) {
+                printf("-E- rule TLV %s of %s not found\n", r->c_str(), (*it)->_name.c_str());
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static bool sameTLVs(const char *cmd, const vector<string>& names, const vector<TLVConf*>& got,
+                     const vector<TLVConf*>& expected)
+{
+    for (size_t i = 0; i < names.size(); i++) {
+        if (!got[i] || got[i]->_name != expected[i]->_name || got[i]->_port != expected[i]->_port ||
+            !got[i]->findParamByMlxconfigName(names[i])) {
+            printf("-E- %s %s: got TLV %s, expected %s\n", cmd, names[i].c_str(),
+                   got[i] ? got[i]->_name.c_str() : "none", expected[i]->_name.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+static int check(const string& dbName)
+{
+    MlxcfgDBManager all(dbName);
+    vector<string> names;
+    vector<TLVConf*> expected, got;
+    size_t params = queryAll(all);
+
+    VECTOR_ITERATOR(TLVConf*, all.fetchedTLVs, it) {
+        if (all.getTLVByName((*it)->_name, (*it)->_port) != *it) {
+            printf("-E- TLV %s port %u is not indexed by name\n", (*it)->_name.c_str(), (*it)->_port);
+            return 1;
+        }
+        TLVConf *byId = all.getTLVByIndexAndClass((*it)->_id, (*it)->_tlvClass);
+        if (!byId || byId->_id != (*it)->_id || byId->_tlvClass != (*it)->_tlvClass) {
+            printf("-E- TLV %s is not indexed by id and class\n", (*it)->_name.c_str());
+            return 1;
+        }
+        VECTOR_ITERATOR(Param*, (*it)->_params, p) {
+            if (!(*p)->_mlxconfigName.empty()) {
+                names.push_back((*p)->_mlxconfigName);
+            }
+        }
+    }
+    if (names.empty()) {
+        printf("-E- no mlxconfig parameters in %s\n", dbName.c_str());
+        return 1;
+    }
+    queryParams(all, names, expected);
+    if (!sameTLVs("query", names, expected, expected)) {
+        return 1;
+    }
+
+    MlxcfgDBManager fresh(dbName);
+    queryParams(fresh, names, got);
+    if (!sameTLVs("query", names, got, expected)) {
+        return 1;
+    }
+    MlxcfgDBManager freshSet(dbName);
+    if (!setParams(freshSet, names, got) || !sameTLVs("set", names, got, expected)) {
+        return 1;
+    }
+    // Fetching the whole catalog after single TLVs must not duplicate them
+    queryAll(freshSet);
+    if (freshSet.fetchedTLVs.size() != all.fetchedTLVs.size()) {
+        printf("-E- %u TLVs after single fetches, expected %u\n", (unsigned)freshSet.fetchedTLVs.size(),
+               (unsigned)all.fetchedTLVs.size());
+        return 1;
+    }
+    printf("-I- %u TLVs, %u params, %u mlxconfig names resolved\n", (unsigned)all.fetchedTLVs.size(),
+           (unsigned)params, (unsigned)names.size());
+    return 0;
+}
+
+// Best of BENCH_ROUNDS, each command on a fresh manager as one mlxconfig run
+// does, and again on the manager the previous command left behind
+static void benchCmd(const char *cmd, const string& dbName, const vector<string>& names, int kind)
+{
+    double best = 0, bestReused = 0;
+    vector<TLVConf*> tlvs;
+
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        MlxcfgDBManager db(dbName);
+        for (int reused = 0; reused < 2; reused++) {
+            double start = now();
+            if (kind == 0) {
+                queryAll(db);
+            } else if (kind == 1) {
+                queryParams(db, names, tlvs);
+            } else {
+                setParams(db, names, tlvs);
+            }
+            double t = now() - start;
+            double& b = reused ? bestReused : best;
+            if (r == 0 || t < b) {
+                b = t;
+            }
+        }
+    }
+    printf("%-28s %8.2f ms  (reused manager %6.2f ms)\n", cmd, best * 1e3, bestReused * 1e3);
+}
+
+static int bench(const string& dbName)
+{
+    MlxcfgDBManager all(dbName);
+    vector<string> names, one;
+    char cmd[64];
+
+    queryAll(all);
+    VECTOR_ITERATOR(TLVConf*, all.fetchedTLVs, it) {
+        VECTOR_ITERATOR(Param*, (*it)->_params, p) {
+            if (!(*p)->_mlxconfigName.empty()) {
+                names.push_back((*p)->_mlxconfigName);
+            }
+        }
+    }
+    if (names.empty()) {
+        return 1;
+    }
+    one.push_back(names[names.size() / 2]);
+
+    printf("%s\n", dbName.c_str());
+    benchCmd("query", dbName, names, 0);
+    snprintf(cmd, sizeof(cmd), "query %u params", (unsigned)names.size());
+    benchCmd(cmd, dbName, names, 1);
+    benchCmd("query 1 param", dbName, one, 1);
+    snprintf(cmd, sizeof(cmd), "set %u params", (unsigned)names.size());
+    benchCmd(cmd, dbName, names, 2);
+    benchCmd("set 1 param", dbName, one, 2);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    bool doBench = argc > 1 && !strcmp(argv[1], "--bench");
+    const char *srcdir = getenv("srcdir");
+    string dbName = string(srcdir ? srcdir : ".") + "/mlxconfig_dbs/mlxconfig_host.db";
+
+    if (argc > (doBench ? 2 : 1)) {
+        dbName = argv[argc - 1];
+    }
+    try {
+        if (doBench) {
+            return bench(dbName);
+        }
+        int failed = check(dbName);
+        printf("%s\n", failed ? "FAILED" : "PASSED");
+        return failed;
+    } catch (MlxcfgException& e) {
+        printf("-E- %s\n", e._err.c_str());
+        return 1;
+    }
+}
@@ -0,0 +1,197 @@
+/*
+ *
+ * crc16_test.cpp - Crc16 self test
+ *
+ * Copyright (c) 2020 Mellanox Technologies Ltd.  All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * Checks every Crc16 code path against the original bit-serial code on
+ * all lengths up to 300 bytes, a few large odd lengths, and every
+ * alignment in a 16 byte window:
+ *  - addBuffer() on the whole buffer (PCLMUL folding when the CPU has it)
+ *  - addBuffer() in random chunks below 64 bytes (slicing by 8 + bytes)
+ *  - addBuffer() one byte at a time (bytewise only)
+ *  - add() per dword, for lengths that are a multiple of 4
+ *
+ * Runs with `make check`. crc16_test --bench [MB] reports the throughput of
+ * the bit-serial code, of add() per dword and of addBuffer() instead.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "flint_base.h"
+
+static u_int16_t bitwiseAdd(u_int16_t crc, u_int32_t o, int bits)
+{
+    o <<= 32 - bits;
+    for (int i = 0; i < bits; i++) {
+        if (crc & 0x8000) {
+            crc = (u_int16_t) ((((crc << 1) | (o >> 31)) ^  0x100b) & 0xffff);
+        } else {
+            crc = (u_int16_t) (((crc << 1) | (o >> 31)) & 0xffff);
+        }
+        o = (o << 1) & 0xffffffff;
+    }
+    return crc;
+}
+
+static u_int16_t bitwiseCrc(const u_int8_t *p, u_int32_t len)
+{
+    u_int16_t crc = 0xffff;
+
+    for (u_int32_t i = 0; i < len; i++) {
+        crc = bitwiseAdd(crc, p[i], 8);
+    }
+    crc = bitwiseAdd(crc, 0, 16);
+    return crc ^ 0xffff;
+}
+
+static int check(const u_int8_t *p, u_int32_t len, u_int32_t align)
+{
+    u_int16_t expected = bitwiseCrc(p, len);
+    Crc16 whole, chunks, bytes, dwords;
+    u_int32_t i, n;
+
+    whole.addBuffer(p, len);
+    whole.finish();
+
+    for (i = 0; i < len; i += n) {
+        n = 1 + rand() % 63;
+        if (n > len - i) {
+            n = len - i;
+        }
+        chunks.addBuffer(p + i, n);
+    }
+    chunks.finish();
+
+    for (i = 0; i < len; i++) {
+        bytes.addBuffer(p + i, 1);
+    }
+    bytes.finish();
+
+    if (whole.get() != expected || chunks.get() != expected || bytes.get() != expected) {
+        printf("-E- len %u align %u: expected %04x, whole %04x, chunks %04x, bytes %04x\n",
+               len, align, expected, whole.get(), chunks.get(), bytes.get());
+        return 1;
+    }
+
+    if (len % 4 == 0) {
+        for (i = 0; i < len; i += 4) {
+            dwords.add((u_int32_t)(p[i] << 24 | p[i + 1] << 16 | p[i + 2] << 8 | p[i + 3]));
+        }
+        dwords.finish();
+        if (dwords.get() != expected) {
+            printf("-E- len %u align %u: expected %04x, dwords %04x\n",
+                   len, align, expected, dwords.get());
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static double now()
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void report(const char *name, u_int32_t len, double sec, u_int16_t crc)
+{
+    printf("%-24s %10.1f MB/s  (crc %04x)\n", name, len / sec / (1024 * 1024), crc);
+}
+
+static int bench(u_int32_t mb)
+{
+    u_int32_t len = mb * 1024 * 1024;
+    u_int8_t *buf = new u_int8_t[len];
+    u_int16_t expected;
+    double start;
+
+    srand(1);
+    for (u_int32_t i = 0; i < len; i++) {
+        buf[i] = (u_int8_t)rand();
+    }
+
+    start = now();
+    expected = bitwiseCrc(buf, len);
+    report("bit-serial", len, now() - start, expected);
+
+    Crc16 dwords;
+    start = now();
+    for (u_int32_t i = 0; i < len; i += 4) {
+        dwords.add((u_int32_t)(buf[i] << 24 | buf[i + 1] << 16 | buf[i + 2] << 8 | buf[i + 3]));
+    }
+    dwords.finish();
+    report("add() per dword", len, now() - start, dwords.get());
+
+    Crc16 whole;
+    start = now();
+    whole.addBuffer(buf, len);
+    whole.finish();
+    report("addBuffer()", len, now() - start, whole.get());
+
+    delete[] buf;
+    return dwords.get() != expected || whole.get() != expected;
+}
+
+int main(int argc, char **argv)
+{
+    const u_int32_t bigLens[] = {1021, 4093, 4096, 65537};
+    const u_int32_t maxLen = 65537;
+    u_int8_t *buf;
+    int errors = 0;
+
+    if (argc > 1 && !strcmp(argv[1], "--bench")) {
+        return bench(argc > 2 ? atoi(argv[2]) : 64);
+    }
+
+    buf = new u_int8_t[maxLen + 16];
+    srand(1);
+    for (u_int32_t i = 0; i < maxLen + 16; i++) {
+        buf[i] = (u_int8_t)rand();
+    }
+
+    for (u_int32_t align = 0; align < 16; align++) {
+        for (u_int32_t len = 0; len <= 300; len++) {
+            errors += check(buf + align, len, align);
+        }
+        for (u_int32_t i = 0; i < sizeof(bigLens) / sizeof(bigLens[0]); i++) {
+            errors += check(buf + align, bigLens[i], align);
+        }
+    }
+
+    delete[] buf;
+    printf("%s: %d errors\n", errors ? "FAILED" : "PASSED", errors);
+    return errors ? 1 : 0;
+}
@@ -39,6 +39,12 @@
 #include <stdarg.h>
 #include "flint_base.h"
 
+#if defined(__x86_64__) && defined(__GNUC__) && __GNUC__ >= 5 && !defined(UEFI_BUILD) && !defined(__WIN__)
+#define CRC16_PCLMUL
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
 
 
 void FlintErrMsg::err_clear()
@@ -230,33 +236,394 @@ int FlintErrMsg::errmsgWCode(int errorCode, const char *format, ...)
     return errorCode;
 }
 
+////////////////////////////////////////////////////////////////////////
+//
+// Crc16 shifts the data bits into the low end of the register:
+// crc = (crc * x + bit) mod P, P = x^16 + 0x100b, and finish() shifts in
+// 16 more zero bits. Adding n bits is therefore crc * x^n + data (mod P),
+// which splits into per-byte lookups of b * x^k mod P:
+// _crc16Tables[i][b] = b * x^(16 + 8 * i) mod P.
+//
+// The tables are constant so that Crc16 objects may be used from several
+// threads without any initialization step.
+//
+////////////////////////////////////////////////////////////////////////
+static const u_int16_t _crc16Tables[8][256] = {
+    {
+        0x0000, 0x100b, 0x2016, 0x301d, 0x402c, 0x5027, 0x603a, 0x7031,
+        0x8058, 0x9053, 0xa04e, 0xb045, 0xc074, 0xd07f, 0xe062, 0xf069,
+        0x10bb, 0x00b0, 0x30ad, 0x20a6, 0x5097, 0x409c, 0x7081, 0x608a,
+        0x90e3, 0x80e8, 0xb0f5, 0xa0fe, 0xd0cf, 0xc0c4, 0xf0d9, 0xe0d2,
+        0x2176, 0x317d, 0x0160, 0x116b, 0x615a, 0x7151, 0x414c, 0x5147,
+        0xa12e, 0xb125, 0x8138, 0x9133, 0xe102, 0xf109, 0xc114, 0xd11f,
+        0x31cd, 0x21c6, 0x11db, 0x01d0, 0x71e1, 0x61ea, 0x51f7, 0x41fc,
+        0xb195, 0xa19e, 0x9183, 0x8188, 0xf1b9, 0xe1b2, 0xd1af, 0xc1a4,
+        0x42ec, 0x52e7, 0x62fa, 0x72f1, 0x02c0, 0x12cb, 0x22d6, 0x32dd,
+        0xc2b4, 0xd2bf, 0xe2a2, 0xf2a9, 0x8298, 0x9293, 0xa28e, 0xb285,
+        0x5257, 0x425c, 0x7241, 0x624a, 0x127b, 0x0270, 0x326d, 0x2266,
+        0xd20f, 0xc204, 0xf219, 0xe212, 0x9223, 0x8228, 0xb235, 0xa23e,
+        0x639a, 0x7391, 0x438c, 0x5387, 0x23b6, 0x33bd, 0x03a0, 0x13ab,
+        0xe3c2, 0xf3c9, 0xc3d4, 0xd3df, 0xa3ee, 0xb3e5, 0x83f8, 0x93f3,
+        0x7321, 0x632a, 0x5337, 0x433c, 0x330d, 0x2306, 0x131b, 0x0310,
+        0xf379, 0xe372, 0xd36f, 0xc364, 0xb355, 0xa35e, 0x9343, 0x8348,
+        0x85d8, 0x95d3, 0xa5ce, 0xb5c5, 0xc5f4, 0xd5ff, 0xe5e2, 0xf5e9,
+        0x0580, 0x158b, 0x2596, 0x359d, 0x45ac, 0x55a7, 0x65ba, 0x75b1,
+        0x9563, 0x8568, 0xb575, 0xa57e, 0xd54f, 0xc544, 0xf559, 0xe552,
+        0x153b, 0x0530, 0x352d, 0x2526, 0x5517, 0x451c, 0x7501, 0x650a,
+        0xa4ae, 0xb4a5, 0x84b8, 0x94b3, 0xe482, 0xf489, 0xc494, 0xd49f,
+        0x24f6, 0x34fd, 0x04e0, 0x14eb, 0x64da, 0x74d1, 0x44cc, 0x54c7,
+        0xb415, 0xa41e, 0x9403, 0x8408, 0xf439, 0xe432, 0xd42f, 0xc424,
+        0x344d, 0x2446, 0x145b, 0x0450, 0x7461, 0x646a, 0x5477, 0x447c,
+        0xc734, 0xd73f, 0xe722, 0xf729, 0x8718, 0x9713, 0xa70e, 0xb705,
+        0x476c, 0x5767, 0x677a, 0x7771, 0x0740, 0x174b, 0x2756, 0x375d,
+        0xd78f, 0xc784, 0xf799, 0xe792, 0x97a3, 0x87a8, 0xb7b5, 0xa7be,
+        0x57d7, 0x47dc, 0x77c1, 0x67ca, 0x17fb, 0x07f0, 0x37ed, 0x27e6,
+        0xe642, 0xf649, 0xc654, 0xd65f, 0xa66e, 0xb665, 0x8678, 0x9673,
+        0x661a, 0x7611, 0x460c, 0x5607, 0x2636, 0x363d, 0x0620, 0x162b,
+        0xf6f9, 0xe6f2, 0xd6ef, 0xc6e4, 0xb6d5, 0xa6de, 0x96c3, 0x86c8,
+        0x76a1, 0x66aa, 0x56b7, 0x46bc, 0x368d, 0x2686, 0x169b, 0x0690
+    },
+    {
+        0x0000, 0x1bbb, 0x3776, 0x2ccd, 0x6eec, 0x7557, 0x599a, 0x4221,
+        0xddd8, 0xc663, 0xeaae, 0xf115, 0xb334, 0xa88f, 0x8442, 0x9ff9,
+        0xabbb, 0xb000, 0x9ccd, 0x8776, 0xc557, 0xdeec, 0xf221, 0xe99a,
+        0x7663, 0x6dd8, 0x4115, 0x5aae, 0x188f, 0x0334, 0x2ff9, 0x3442,
+        0x477d, 0x5cc6, 0x700b, 0x6bb0, 0x2991, 0x322a, 0x1ee7, 0x055c,
+        0x9aa5, 0x811e, 0xadd3, 0xb668, 0xf449, 0xeff2, 0xc33f, 0xd884,
+        0xecc6, 0xf77d, 0xdbb0, 0xc00b, 0x822a, 0x9991, 0xb55c, 0xaee7,
+        0x311e, 0x2aa5, 0x0668, 0x1dd3, 0x5ff2, 0x4449, 0x6884, 0x733f,
+        0x8efa, 0x9541, 0xb98c, 0xa237, 0xe016, 0xfbad, 0xd760, 0xccdb,
+        0x5322, 0x4899, 0x6454, 0x7fef, 0x3dce, 0x2675, 0x0ab8, 0x1103,
+        0x2541, 0x3efa, 0x1237, 0x098c, 0x4bad, 0x5016, 0x7cdb, 0x6760,
+        0xf899, 0xe322, 0xcfef, 0xd454, 0x9675, 0x8dce, 0xa103, 0xbab8,
+        0xc987, 0xd23c, 0xfef1, 0xe54a, 0xa76b, 0xbcd0, 0x901d, 0x8ba6,
+        0x145f, 0x0fe4, 0x2329, 0x3892, 0x7ab3, 0x6108, 0x4dc5, 0x567e,
+        0x623c, 0x7987, 0x554a, 0x4ef1, 0x0cd0, 0x176b, 0x3ba6, 0x201d,
+        0xbfe4, 0xa45f, 0x8892, 0x9329, 0xd108, 0xcab3, 0xe67e, 0xfdc5,
+        0x0dff, 0x1644, 0x3a89, 0x2132, 0x6313, 0x78a8, 0x5465, 0x4fde,
+        0xd027, 0xcb9c, 0xe751, 0xfcea, 0xbecb, 0xa570, 0x89bd, 0x9206,
+        0xa644, 0xbdff, 0x9132, 0x8a89, 0xc8a8, 0xd313, 0xffde, 0xe465,
+        0x7b9c, 0x6027, 0x4cea, 0x5751, 0x1570, 0x0ecb, 0x2206, 0x39bd,
+        0x4a82, 0x5139, 0x7df4, 0x664f, 0x246e, 0x3fd5, 0x1318, 0x08a3,
+        0x975a, 0x8ce1, 0xa02c, 0xbb97, 0xf9b6, 0xe20d, 0xcec0, 0xd57b,
+        0xe139, 0xfa82, 0xd64f, 0xcdf4, 0x8fd5, 0x946e, 0xb8a3, 0xa318,
+        0x3ce1, 0x275a, 0x0b97, 0x102c, 0x520d, 0x49b6, 0x657b, 0x7ec0,
+        0x8305, 0x98be, 0xb473, 0xafc8, 0xede9, 0xf652, 0xda9f, 0xc124,
+        0x5edd, 0x4566, 0x69ab, 0x7210, 0x3031, 0x2b8a, 0x0747, 0x1cfc,
+        0x28be, 0x3305, 0x1fc8, 0x0473, 0x4652, 0x5de9, 0x7124, 0x6a9f,
+        0xf566, 0xeedd, 0xc210, 0xd9ab, 0x9b8a, 0x8031, 0xacfc, 0xb747,
+        0xc478, 0xdfc3, 0xf30e, 0xe8b5, 0xaa94, 0xb12f, 0x9de2, 0x8659,
+        0x19a0, 0x021b, 0x2ed6, 0x356d, 0x774c, 0x6cf7, 0x403a, 0x5b81,
+        0x6fc3, 0x7478, 0x58b5, 0x430e, 0x012f, 0x1a94, 0x3659, 0x2de2,
+        0xb21b, 0xa9a0, 0x856d, 0x9ed6, 0xdcf7, 0xc74c, 0xeb81, 0xf03a
+    },
+    {
+        0x0000, 0x1bfe, 0x37fc, 0x2c02, 0x6ff8, 0x7406, 0x5804, 0x43fa,
+        0xdff0, 0xc40e, 0xe80c, 0xf3f2, 0xb008, 0xabf6, 0x87f4, 0x9c0a,
+        0xafeb, 0xb415, 0x9817, 0x83e9, 0xc013, 0xdbed, 0xf7ef, 0xec11,
+        0x701b, 0x6be5, 0x47e7, 0x5c19, 0x1fe3, 0x041d, 0x281f, 0x33e1,
+        0x4fdd, 0x5423, 0x7821, 0x63df, 0x2025, 0x3bdb, 0x17d9, 0x0c27,
+        0x902d, 0x8bd3, 0xa7d1, 0xbc2f, 0xffd5, 0xe42b, 0xc829, 0xd3d7,
+        0xe036, 0xfbc8, 0xd7ca, 0xcc34, 0x8fce, 0x9430, 0xb832, 0xa3cc,
+        0x3fc6, 0x2438, 0x083a, 0x13c4, 0x503e, 0x4bc0, 0x67c2, 0x7c3c,
+        0x9fba, 0x8444, 0xa846, 0xb3b8, 0xf042, 0xebbc, 0xc7be, 0xdc40,
+        0x404a, 0x5bb4, 0x77b6, 0x6c48, 0x2fb2, 0x344c, 0x184e, 0x03b0,
+        0x3051, 0x2baf, 0x07ad, 0x1c53, 0x5fa9, 0x4457, 0x6855, 0x73ab,
+        0xefa1, 0xf45f, 0xd85d, 0xc3a3, 0x8059, 0x9ba7, 0xb7a5, 0xac5b,
+        0xd067, 0xcb99, 0xe79b, 0xfc65, 0xbf9f, 0xa461, 0x8863, 0x939d,
+        0x0f97, 0x1469, 0x386b, 0x2395, 0x606f, 0x7b91, 0x5793, 0x4c6d,
+        0x7f8c, 0x6472, 0x4870, 0x538e, 0x1074, 0x0b8a, 0x2788, 0x3c76,
+        0xa07c, 0xbb82, 0x9780, 0x8c7e, 0xcf84, 0xd47a, 0xf878, 0xe386,
+        0x2f7f, 0x3481, 0x1883, 0x037d, 0x4087, 0x5b79, 0x777b, 0x6c85,
+        0xf08f, 0xeb71, 0xc773, 0xdc8d, 0x9f77, 0x8489, 0xa88b, 0xb375,
+        0x8094, 0x9b6a, 0xb768, 0xac96, 0xef6c, 0xf492, 0xd890, 0xc36e,
+        0x5f64, 0x449a, 0x6898, 0x7366, 0x309c, 0x2b62, 0x0760, 0x1c9e,
+        0x60a2, 0x7b5c, 0x575e, 0x4ca0, 0x0f5a, 0x14a4, 0x38a6, 0x2358,
+        0xbf52, 0xa4ac, 0x88ae, 0x9350, 0xd0aa, 0xcb54, 0xe756, 0xfca8,
+        0xcf49, 0xd4b7, 0xf8b5, 0xe34b, 0xa0b1, 0xbb4f, 0x974d, 0x8cb3,
+        0x10b9, 0x0b47, 0x2745, 0x3cbb, 0x7f41, 0x64bf, 0x48bd, 0x5343,
+        0xb0c5, 0xab3b, 0x8739, 0x9cc7, 0xdf3d, 0xc4c3, 0xe8c1, 0xf33f,
+        0x6f35, 0x74cb, 0x58c9, 0x4337, 0x00cd, 0x1b33, 0x3731, 0x2ccf,
+        0x1f2e, 0x04d0, 0x28d2, 0x332c, 0x70d6, 0x6b28, 0x472a, 0x5cd4,
+        0xc0de, 0xdb20, 0xf722, 0xecdc, 0xaf26, 0xb4d8, 0x98da, 0x8324,
+        0xff18, 0xe4e6, 0xc8e4, 0xd31a, 0x90e0, 0x8b1e, 0xa71c, 0xbce2,
+        0x20e8, 0x3b16, 0x1714, 0x0cea, 0x4f10, 0x54ee, 0x78ec, 0x6312,
+        0x50f3, 0x4b0d, 0x670f, 0x7cf1, 0x3f0b, 0x24f5, 0x08f7, 0x1309,
+        0x8f03, 0x94fd, 0xb8ff, 0xa301, 0xe0fb, 0xfb05, 0xd707, 0xccf9
+    },
+    {
+        0x0000, 0x5efe, 0xbdfc, 0xe302, 0x6bf3, 0x350d, 0xd60f, 0x88f1,
+        0xd7e6, 0x8918, 0x6a1a, 0x34e4, 0xbc15, 0xe2eb, 0x01e9, 0x5f17,
+        0xbfc7, 0xe139, 0x023b, 0x5cc5, 0xd434, 0x8aca, 0x69c8, 0x3736,
+        0x6821, 0x36df, 0xd5dd, 0x8b23, 0x03d2, 0x5d2c, 0xbe2e, 0xe0d0,
+        0x6f85, 0x317b, 0xd279, 0x8c87, 0x0476, 0x5a88, 0xb98a, 0xe774,
+        0xb863, 0xe69d, 0x059f, 0x5b61, 0xd390, 0x8d6e, 0x6e6c, 0x3092,
+        0xd042, 0x8ebc, 0x6dbe, 0x3340, 0xbbb1, 0xe54f, 0x064d, 0x58b3,
+        0x07a4, 0x595a, 0xba58, 0xe4a6, 0x6c57, 0x32a9, 0xd1ab, 0x8f55,
+        0xdf0a, 0x81f4, 0x62f6, 0x3c08, 0xb4f9, 0xea07, 0x0905, 0x57fb,
+        0x08ec, 0x5612, 0xb510, 0xebee, 0x631f, 0x3de1, 0xdee3, 0x801d,
+        0x60cd, 0x3e33, 0xdd31, 0x83cf, 0x0b3e, 0x55c0, 0xb6c2, 0xe83c,
+        0xb72b, 0xe9d5, 0x0ad7, 0x5429, 0xdcd8, 0x8226, 0x6124, 0x3fda,
+        0xb08f, 0xee71, 0x0d73, 0x538d, 0xdb7c, 0x8582, 0x6680, 0x387e,
+        0x6769, 0x3997, 0xda95, 0x846b, 0x0c9a, 0x5264, 0xb166, 0xef98,
+        0x0f48, 0x51b6, 0xb2b4, 0xec4a, 0x64bb, 0x3a45, 0xd947, 0x87b9,
+        0xd8ae, 0x8650, 0x6552, 0x3bac, 0xb35d, 0xeda3, 0x0ea1, 0x505f,
+        0xae1f, 0xf0e1, 0x13e3, 0x4d1d, 0xc5ec, 0x9b12, 0x7810, 0x26ee,
+        0x79f9, 0x2707, 0xc405, 0x9afb, 0x120a, 0x4cf4, 0xaff6, 0xf108,
+        0x11d8, 0x4f26, 0xac24, 0xf2da, 0x7a2b, 0x24d5, 0xc7d7, 0x9929,
+        0xc63e, 0x98c0, 0x7bc2, 0x253c, 0xadcd, 0xf333, 0x1031, 0x4ecf,
+        0xc19a, 0x9f64, 0x7c66, 0x2298, 0xaa69, 0xf497, 0x1795, 0x496b,
+        0x167c, 0x4882, 0xab80, 0xf57e, 0x7d8f, 0x2371, 0xc073, 0x9e8d,
+        0x7e5d, 0x20a3, 0xc3a1, 0x9d5f, 0x15ae, 0x4b50, 0xa852, 0xf6ac,
+        0xa9bb, 0xf745, 0x1447, 0x4ab9, 0xc248, 0x9cb6, 0x7fb4, 0x214a,
+        0x7115, 0x2feb, 0xcce9, 0x9217, 0x1ae6, 0x4418, 0xa71a, 0xf9e4,
+        0xa6f3, 0xf80d, 0x1b0f, 0x45f1, 0xcd00, 0x93fe, 0x70fc, 0x2e02,
+        0xced2, 0x902c, 0x732e, 0x2dd0, 0xa521, 0xfbdf, 0x18dd, 0x4623,
+        0x1934, 0x47ca, 0xa4c8, 0xfa36, 0x72c7, 0x2c39, 0xcf3b, 0x91c5,
+        0x1e90, 0x406e, 0xa36c, 0xfd92, 0x7563, 0x2b9d, 0xc89f, 0x9661,
+        0xc976, 0x9788, 0x748a, 0x2a74, 0xa285, 0xfc7b, 0x1f79, 0x4187,
+        0xa157, 0xffa9, 0x1cab, 0x4255, 0xcaa4, 0x945a, 0x7758, 0x29a6,
+        0x76b1, 0x284f, 0xcb4d, 0x95b3, 0x1d42, 0x43bc, 0xa0be, 0xfe40
+    },
+    {
+        0x0000, 0x4c35, 0x986a, 0xd45f, 0x20df, 0x6cea, 0xb8b5, 0xf480,
+        0x41be, 0x0d8b, 0xd9d4, 0x95e1, 0x6161, 0x2d54, 0xf90b, 0xb53e,
+        0x837c, 0xcf49, 0x1b16, 0x5723, 0xa3a3, 0xef96, 0x3bc9, 0x77fc,
+        0xc2c2, 0x8ef7, 0x5aa8, 0x169d, 0xe21d, 0xae28, 0x7a77, 0x3642,
+        0x16f3, 0x5ac6, 0x8e99, 0xc2ac, 0x362c, 0x7a19, 0xae46, 0xe273,
+        0x574d, 0x1b78, 0xcf27, 0x8312, 0x7792, 0x3ba7, 0xeff8, 0xa3cd,
+        0x958f, 0xd9ba, 0x0de5, 0x41d0, 0xb550, 0xf965, 0x2d3a, 0x610f,
+        0xd431, 0x9804, 0x4c5b, 0x006e, 0xf4ee, 0xb8db, 0x6c84, 0x20b1,
+        0x2de6, 0x61d3, 0xb58c, 0xf9b9, 0x0d39, 0x410c, 0x9553, 0xd966,
+        0x6c58, 0x206d, 0xf432, 0xb807, 0x4c87, 0x00b2, 0xd4ed, 0x98d8,
+        0xae9a, 0xe2af, 0x36f0, 0x7ac5, 0x8e45, 0xc270, 0x162f, 0x5a1a,
+        0xef24, 0xa311, 0x774e, 0x3b7b, 0xcffb, 0x83ce, 0x5791, 0x1ba4,
+        0x3b15, 0x7720, 0xa37f, 0xef4a, 0x1bca, 0x57ff, 0x83a0, 0xcf95,
+        0x7aab, 0x369e, 0xe2c1, 0xaef4, 0x5a74, 0x1641, 0xc21e, 0x8e2b,
+        0xb869, 0xf45c, 0x2003, 0x6c36, 0x98b6, 0xd483, 0x00dc, 0x4ce9,
+        0xf9d7, 0xb5e2, 0x61bd, 0x2d88, 0xd908, 0x953d, 0x4162, 0x0d57,
+        0x5bcc, 0x17f9, 0xc3a6, 0x8f93, 0x7b13, 0x3726, 0xe379, 0xaf4c,
+        0x1a72, 0x5647, 0x8218, 0xce2d, 0x3aad, 0x7698, 0xa2c7, 0xeef2,
+        0xd8b0, 0x9485, 0x40da, 0x0cef, 0xf86f, 0xb45a, 0x6005, 0x2c30,
+        0x990e, 0xd53b, 0x0164, 0x4d51, 0xb9d1, 0xf5e4, 0x21bb, 0x6d8e,
+        0x4d3f, 0x010a, 0xd555, 0x9960, 0x6de0, 0x21d5, 0xf58a, 0xb9bf,
+        0x0c81, 0x40b4, 0x94eb, 0xd8de, 0x2c5e, 0x606b, 0xb434, 0xf801,
+        0xce43, 0x8276, 0x5629, 0x1a1c, 0xee9c, 0xa2a9, 0x76f6, 0x3ac3,
+        0x8ffd, 0xc3c8, 0x1797, 0x5ba2, 0xaf22, 0xe317, 0x3748, 0x7b7d,
+        0x762a, 0x3a1f, 0xee40, 0xa275, 0x56f5, 0x1ac0, 0xce9f, 0x82aa,
+        0x3794, 0x7ba1, 0xaffe, 0xe3cb, 0x174b, 0x5b7e, 0x8f21, 0xc314,
+        0xf556, 0xb963, 0x6d3c, 0x2109, 0xd589, 0x99bc, 0x4de3, 0x01d6,
+        0xb4e8, 0xf8dd, 0x2c82, 0x60b7, 0x9437, 0xd802, 0x0c5d, 0x4068,
+        0x60d9, 0x2cec, 0xf8b3, 0xb486, 0x4006, 0x0c33, 0xd86c, 0x9459,
+        0x2167, 0x6d52, 0xb90d, 0xf538, 0x01b8, 0x4d8d, 0x99d2, 0xd5e7,
+        0xe3a5, 0xaf90, 0x7bcf, 0x37fa, 0xc37a, 0x8f4f, 0x5b10, 0x1725,
+        0xa21b, 0xee2e, 0x3a71, 0x7644, 0x82c4, 0xcef1, 0x1aae, 0x569b
+    },
+    {
+        0x0000, 0xb798, 0x7f3b, 0xc8a3, 0xfe76, 0x49ee, 0x814d, 0x36d5,
+        0xece7, 0x5b7f, 0x93dc, 0x2444, 0x1291, 0xa509, 0x6daa, 0xda32,
+        0xc9c5, 0x7e5d, 0xb6fe, 0x0166, 0x37b3, 0x802b, 0x4888, 0xff10,
+        0x2522, 0x92ba, 0x5a19, 0xed81, 0xdb54, 0x6ccc, 0xa46f, 0x13f7,
+        0x8381, 0x3419, 0xfcba, 0x4b22, 0x7df7, 0xca6f, 0x02cc, 0xb554,
+        0x6f66, 0xd8fe, 0x105d, 0xa7c5, 0x9110, 0x2688, 0xee2b, 0x59b3,
+        0x4a44, 0xfddc, 0x357f, 0x82e7, 0xb432, 0x03aa, 0xcb09, 0x7c91,
+        0xa6a3, 0x113b, 0xd998, 0x6e00, 0x58d5, 0xef4d, 0x27ee, 0x9076,
+        0x1709, 0xa091, 0x6832, 0xdfaa, 0xe97f, 0x5ee7, 0x9644, 0x21dc,
+        0xfbee, 0x4c76, 0x84d5, 0x334d, 0x0598, 0xb200, 0x7aa3, 0xcd3b,
+        0xdecc, 0x6954, 0xa1f7, 0x166f, 0x20ba, 0x9722, 0x5f81, 0xe819,
+        0x322b, 0x85b3, 0x4d10, 0xfa88, 0xcc5d, 0x7bc5, 0xb366, 0x04fe,
+        0x9488, 0x2310, 0xebb3, 0x5c2b, 0x6afe, 0xdd66, 0x15c5, 0xa25d,
+        0x786f, 0xcff7, 0x0754, 0xb0cc, 0x8619, 0x3181, 0xf922, 0x4eba,
+        0x5d4d, 0xead5, 0x2276, 0x95ee, 0xa33b, 0x14a3, 0xdc00, 0x6b98,
+        0xb1aa, 0x0632, 0xce91, 0x7909, 0x4fdc, 0xf844, 0x30e7, 0x877f,
+        0x2e12, 0x998a, 0x5129, 0xe6b1, 0xd064, 0x67fc, 0xaf5f, 0x18c7,
+        0xc2f5, 0x756d, 0xbdce, 0x0a56, 0x3c83, 0x8b1b, 0x43b8, 0xf420,
+        0xe7d7, 0x504f, 0x98ec, 0x2f74, 0x19a1, 0xae39, 0x669a, 0xd102,
+        0x0b30, 0xbca8, 0x740b, 0xc393, 0xf546, 0x42de, 0x8a7d, 0x3de5,
+        0xad93, 0x1a0b, 0xd2a8, 0x6530, 0x53e5, 0xe47d, 0x2cde, 0x9b46,
+        0x4174, 0xf6ec, 0x3e4f, 0x89d7, 0xbf02, 0x089a, 0xc039, 0x77a1,
+        0x6456, 0xd3ce, 0x1b6d, 0xacf5, 0x9a20, 0x2db8, 0xe51b, 0x5283,
+        0x88b1, 0x3f29, 0xf78a, 0x4012, 0x76c7, 0xc15f, 0x09fc, 0xbe64,
+        0x391b, 0x8e83, 0x4620, 0xf1b8, 0xc76d, 0x70f5, 0xb856, 0x0fce,
+        0xd5fc, 0x6264, 0xaac7, 0x1d5f, 0x2b8a, 0x9c12, 0x54b1, 0xe329,
+        0xf0de, 0x4746, 0x8fe5, 0x387d, 0x0ea8, 0xb930, 0x7193, 0xc60b,
+        0x1c39, 0xaba1, 0x6302, 0xd49a, 0xe24f, 0x55d7, 0x9d74, 0x2aec,
+        0xba9a, 0x0d02, 0xc5a1, 0x7239, 0x44ec, 0xf374, 0x3bd7, 0x8c4f,
+        0x567d, 0xe1e5, 0x2946, 0x9ede, 0xa80b, 0x1f93, 0xd730, 0x60a8,
+        0x735f, 0xc4c7, 0x0c64, 0xbbfc, 0x8d29, 0x3ab1, 0xf212, 0x458a,
+        0x9fb8, 0x2820, 0xe083, 0x571b, 0x61ce, 0xd656, 0x1ef5, 0xa96d
+    },
+    {
+        0x0000, 0x5c24, 0xb848, 0xe46c, 0x609b, 0x3cbf, 0xd8d3, 0x84f7,
+        0xc136, 0x9d12, 0x797e, 0x255a, 0xa1ad, 0xfd89, 0x19e5, 0x45c1,
+        0x9267, 0xce43, 0x2a2f, 0x760b, 0xf2fc, 0xaed8, 0x4ab4, 0x1690,
+        0x5351, 0x0f75, 0xeb19, 0xb73d, 0x33ca, 0x6fee, 0x8b82, 0xd7a6,
+        0x34c5, 0x68e1, 0x8c8d, 0xd0a9, 0x545e, 0x087a, 0xec16, 0xb032,
+        0xf5f3, 0xa9d7, 0x4dbb, 0x119f, 0x9568, 0xc94c, 0x2d20, 0x7104,
+        0xa6a2, 0xfa86, 0x1eea, 0x42ce, 0xc639, 0x9a1d, 0x7e71, 0x2255,
+        0x6794, 0x3bb0, 0xdfdc, 0x83f8, 0x070f, 0x5b2b, 0xbf47, 0xe363,
+        0x698a, 0x35ae, 0xd1c2, 0x8de6, 0x0911, 0x5535, 0xb159, 0xed7d,
+        0xa8bc, 0xf498, 0x10f4, 0x4cd0, 0xc827, 0x9403, 0x706f, 0x2c4b,
+        0xfbed, 0xa7c9, 0x43a5, 0x1f81, 0x9b76, 0xc752, 0x233e, 0x7f1a,
+        0x3adb, 0x66ff, 0x8293, 0xdeb7, 0x5a40, 0x0664, 0xe208, 0xbe2c,
+        0x5d4f, 0x016b, 0xe507, 0xb923, 0x3dd4, 0x61f0, 0x859c, 0xd9b8,
+        0x9c79, 0xc05d, 0x2431, 0x7815, 0xfce2, 0xa0c6, 0x44aa, 0x188e,
+        0xcf28, 0x930c, 0x7760, 0x2b44, 0xafb3, 0xf397, 0x17fb, 0x4bdf,
+        0x0e1e, 0x523a, 0xb656, 0xea72, 0x6e85, 0x32a1, 0xd6cd, 0x8ae9,
+        0xd314, 0x8f30, 0x6b5c, 0x3778, 0xb38f, 0xefab, 0x0bc7, 0x57e3,
+        0x1222, 0x4e06, 0xaa6a, 0xf64e, 0x72b9, 0x2e9d, 0xcaf1, 0x96d5,
+        0x4173, 0x1d57, 0xf93b, 0xa51f, 0x21e8, 0x7dcc, 0x99a0, 0xc584,
+        0x8045, 0xdc61, 0x380d, 0x6429, 0xe0de, 0xbcfa, 0x5896, 0x04b2,
+        0xe7d1, 0xbbf5, 0x5f99, 0x03bd, 0x874a, 0xdb6e, 0x3f02, 0x6326,
+        0x26e7, 0x7ac3, 0x9eaf, 0xc28b, 0x467c, 0x1a58, 0xfe34, 0xa210,
+        0x75b6, 0x2992, 0xcdfe, 0x91da, 0x152d, 0x4909, 0xad65, 0xf141,
+        0xb480, 0xe8a4, 0x0cc8, 0x50ec, 0xd41b, 0x883f, 0x6c53, 0x3077,
+        0xba9e, 0xe6ba, 0x02d6, 0x5ef2, 0xda05, 0x8621, 0x624d, 0x3e69,
+        0x7ba8, 0x278c, 0xc3e0, 0x9fc4, 0x1b33, 0x4717, 0xa37b, 0xff5f,
+        0x28f9, 0x74dd, 0x90b1, 0xcc95, 0x4862, 0x1446, 0xf02a, 0xac0e,
+        0xe9cf, 0xb5eb, 0x5187, 0x0da3, 0x8954, 0xd570, 0x311c, 0x6d38,
+        0x8e5b, 0xd27f, 0x3613, 0x6a37, 0xeec0, 0xb2e4, 0x5688, 0x0aac,
+        0x4f6d, 0x1349, 0xf725, 0xab01, 0x2ff6, 0x73d2, 0x97be, 0xcb9a,
+        0x1c3c, 0x4018, 0xa474, 0xf850, 0x7ca7, 0x2083, 0xc4ef, 0x98cb,
+        0xdd0a, 0x812e, 0x6542, 0x3966, 0xbd91, 0xe1b5, 0x05d9, 0x59fd
+    },
+    {
+        0x0000, 0xb623, 0x7c4d, 0xca6e, 0xf89a, 0x4eb9, 0x84d7, 0x32f4,
+        0xe13f, 0x571c, 0x9d72, 0x2b51, 0x19a5, 0xaf86, 0x65e8, 0xd3cb,
+        0xd275, 0x6456, 0xae38, 0x181b, 0x2aef, 0x9ccc, 0x56a2, 0xe081,
+        0x334a, 0x8569, 0x4f07, 0xf924, 0xcbd0, 0x7df3, 0xb79d, 0x01be,
+        0xb4e1, 0x02c2, 0xc8ac, 0x7e8f, 0x4c7b, 0xfa58, 0x3036, 0x8615,
+        0x55de, 0xe3fd, 0x2993, 0x9fb0, 0xad44, 0x1b67, 0xd109, 0x672a,
+        0x6694, 0xd0b7, 0x1ad9, 0xacfa, 0x9e0e, 0x282d, 0xe243, 0x5460,
+        0x87ab, 0x3188, 0xfbe6, 0x4dc5, 0x7f31, 0xc912, 0x037c, 0xb55f,
+        0x79c9, 0xcfea, 0x0584, 0xb3a7, 0x8153, 0x3770, 0xfd1e, 0x4b3d,
+        0x98f6, 0x2ed5, 0xe4bb, 0x5298, 0x606c, 0xd64f, 0x1c21, 0xaa02,
+        0xabbc, 0x1d9f, 0xd7f1, 0x61d2, 0x5326, 0xe505, 0x2f6b, 0x9948,
+        0x4a83, 0xfca0, 0x36ce, 0x80ed, 0xb219, 0x043a, 0xce54, 0x7877,
+        0xcd28, 0x7b0b, 0xb165, 0x0746, 0x35b2, 0x8391, 0x49ff, 0xffdc,
+        0x2c17, 0x9a34, 0x505a, 0xe679, 0xd48d, 0x62ae, 0xa8c0, 0x1ee3,
+        0x1f5d, 0xa97e, 0x6310, 0xd533, 0xe7c7, 0x51e4, 0x9b8a, 0x2da9,
+        0xfe62, 0x4841, 0x822f, 0x340c, 0x06f8, 0xb0db, 0x7ab5, 0xcc96,
+        0xf392, 0x45b1, 0x8fdf, 0x39fc, 0x0b08, 0xbd2b, 0x7745, 0xc166,
+        0x12ad, 0xa48e, 0x6ee0, 0xd8c3, 0xea37, 0x5c14, 0x967a, 0x2059,
+        0x21e7, 0x97c4, 0x5daa, 0xeb89, 0xd97d, 0x6f5e, 0xa530, 0x1313,
+        0xc0d8, 0x76fb, 0xbc95, 0x0ab6, 0x3842, 0x8e61, 0x440f, 0xf22c,
+        0x4773, 0xf150, 0x3b3e, 0x8d1d, 0xbfe9, 0x09ca, 0xc3a4, 0x7587,
+        0xa64c, 0x106f, 0xda01, 0x6c22, 0x5ed6, 0xe8f5, 0x229b, 0x94b8,
+        0x9506, 0x2325, 0xe94b, 0x5f68, 0x6d9c, 0xdbbf, 0x11d1, 0xa7f2,
+        0x7439, 0xc21a, 0x0874, 0xbe57, 0x8ca3, 0x3a80, 0xf0ee, 0x46cd,
+        0x8a5b, 0x3c78, 0xf616, 0x4035, 0x72c1, 0xc4e2, 0x0e8c, 0xb8af,
+        0x6b64, 0xdd47, 0x1729, 0xa10a, 0x93fe, 0x25dd, 0xefb3, 0x5990,
+        0x582e, 0xee0d, 0x2463, 0x9240, 0xa0b4, 0x1697, 0xdcf9, 0x6ada,
+        0xb911, 0x0f32, 0xc55c, 0x737f, 0x418b, 0xf7a8, 0x3dc6, 0x8be5,
+        0x3eba, 0x8899, 0x42f7, 0xf4d4, 0xc620, 0x7003, 0xba6d, 0x0c4e,
+        0xdf85, 0x69a6, 0xa3c8, 0x15eb, 0x271f, 0x913c, 0x5b52, 0xed71,
+        0xeccf, 0x5aec, 0x9082, 0x26a1, 0x1455, 0xa276, 0x6818, 0xde3b,
+        0x0df0, 0xbbd3, 0x71bd, 0xc79e, 0xf56a, 0x4349, 0x8927, 0x3f04
+    }
+};
+
+#define CRC16_FOLD_K128 0xe647  // x^128 mod P
+#define CRC16_FOLD_K192 0x5710  // x^192 mod P
+
+static u_int16_t crc16Bytes(u_int16_t crc, const u_int8_t *p, u_int32_t len)
+{
+    const u_int16_t (*t)[256] = _crc16Tables;
+
+    // crc * x^64 + 8 bytes, slicing by 8
+    for (; len >= 8; len -= 8, p += 8) {
+        crc = t[7][crc >> 8] ^ t[6][crc & 0xff] ^
+              t[5][p[0]] ^ t[4][p[1]] ^ t[3][p[2]] ^ t[2][p[3]] ^
+              t[1][p[4]] ^ t[0][p[5]] ^ (u_int16_t)((p[6] << 8) | p[7]);
+    }
+    // crc * x^8 + byte
+    for (; len; len--, p++) {
+        crc = t[0][crc >> 8] ^ (u_int16_t)(((crc & 0xff) << 8) | *p);
+    }
+    return crc;
+}
+
+#ifdef CRC16_PCLMUL
+static bool crc16DetectPclmul()
+{
+    unsigned int eax, ebx, ecx, edx;
+
+    return __get_cpuid(1, &eax, &ebx, &ecx, &edx) &&
+           (ecx & bit_PCLMUL) && (ecx & bit_SSSE3);
+}
+
+static bool crc16HavePclmul()
+{
+    // Initialized once, the compiler guards it against concurrent callers
+    static const bool supported = crc16DetectPclmul();
+
+    return supported;
+}
+
+// Folds 16 byte blocks: acc * x^128 + block = acc_hi * (x^192 mod P) +
+// acc_lo * (x^128 mod P) + block (mod P). The 128 bit accumulator left is
+// reduced by the table code.
+__attribute__((target("pclmul,ssse3")))
+static u_int16_t crc16FoldPclmul(u_int16_t crc, const u_int8_t *p, u_int32_t nblocks)
+{
+    const __m128i bswap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    const __m128i k = _mm_set_epi64x(CRC16_FOLD_K192, CRC16_FOLD_K128);
+    u_int8_t out[16];
+    __m128i acc;
+
+    acc = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)p), bswap);
+    acc = _mm_xor_si128(acc, _mm_clmulepi64_si128(_mm_cvtsi32_si128(crc), k, 0x00));
+    for (u_int32_t i = 1; i < nblocks; i++) {
+        __m128i block = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(p + 16 * i)), bswap);
+        acc = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(acc, k, 0x11),
+                                          _mm_clmulepi64_si128(acc, k, 0x00)), block);
+    }
+    _mm_storeu_si128((__m128i*)out, _mm_shuffle_epi8(acc, bswap));
+    return crc16Bytes(0, out, sizeof(out));
+}
+#endif
+
 ////////////////////////////////////////////////////////////////////////
 void Crc16::add(u_int32_t o)
 {
+    const u_int16_t (*t)[256] = _crc16Tables;
+
     if (_debug) {
         printf("Crc16::add(%08x)\n", o);
     }
-    for (int i = 0; i < 32; i++) {
-        if (_crc & 0x8000) {
-            _crc = (u_int16_t) ((((_crc << 1) | (o >> 31)) ^  0x100b) & 0xffff);
-        } else {
-            _crc = (u_int16_t) (((_crc << 1) | (o >> 31)) & 0xffff);
+    // crc * x^32 + o
+    _crc = t[3][_crc >> 8] ^ t[2][_crc & 0xff] ^ t[1][o >> 24] ^ t[0][(o >> 16) & 0xff] ^ (u_int16_t)o;
+} // Crc16::add
+
+////////////////////////////////////////////////////////////////////////
+void Crc16::addBuffer(const void *buf, u_int32_t len)
+{
+    const u_int8_t *p = (const u_int8_t*)buf;
+
+    if (_debug) {
+        for (u_int32_t i = 0; i + 4 <= len; i += 4) {
+            add(__be32_to_cpu(*(const u_int32_t*)(p + i)));
         }
-        o = (o << 1) & 0xffffffff;
+        return;
     }
-} // Crc16::add
+#ifdef CRC16_PCLMUL
+    if (len >= 64 && crc16HavePclmul()) {
+        _crc = crc16FoldPclmul(_crc, p, len / 16);
+        p += len & ~15;
+        len &= 15;
+    }
+#endif
+    _crc = crc16Bytes(_crc, p, len);
+} // Crc16::addBuffer
 
 
 ////////////////////////////////////////////////////////////////////////
 void Crc16::finish()
 {
-    for (int i = 0; i < 16; i++) {
-        if (_crc & 0x8000) {
-            _crc = ((_crc << 1)  ^  0x100b) & 0xffff;
-        } else {
-            _crc = (_crc << 1) & 0xffff;
-        }
-    }
+    const u_int16_t (*t)[256] = _crc16Tables;
+
+    // crc * x^16
+    _crc = t[1][_crc >> 8] ^ t[0][_crc & 0xff];
 
     // Revert 16 low bits
     _crc = _crc ^ 0xffff;
@@ -495,6 +495,8 @@ public:
     void           clear()            { _crc = 0xffff;}
     void operator<<(u_int32_t val) { add(val);}
     void           add(u_int32_t val);
+    // Same as adding the len / 4 big endian dwords of buf one by one
+    void           addBuffer(const void *buf, u_int32_t len);
     void           finish();
 private:
     u_int16_t _crc;
@@ -37,6 +37,11 @@
  */
 
 #include <errno.h>
+#if !defined(UEFI_BUILD) && !defined(__WIN__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
 #include "flint_io.h"
 
 
@@ -99,14 +104,55 @@ bool FImage::open(const char *fname, bool read_only, bool advErr)
     _len = fsize;
     _isFile = true;
     fclose(fh);
+    // Falls back to reading the file on each access
+    mapFile();
     return true;
 #else
     return false;
 #endif
 } // FImage::open
 
+bool FImage::mapFile()
+{
+#if !defined(UEFI_BUILD) && !defined(__WIN__)
+    int fd;
+    void *addr;
+
+    unmapFile();
+    if (!_len) {
+        return false;
+    }
+    fd = ::open(_fname, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    addr = mmap(NULL, _len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        return false;
+    }
+    _map = (u_int8_t*)addr;
+    _mapLen = _len;
+    return true;
+#else
+    return false;
+#endif
+}
+
+void FImage::unmapFile()
+{
+#if !defined(UEFI_BUILD) && !defined(__WIN__)
+    if (_map) {
+        munmap(_map, _mapLen);
+    }
+#endif
+    _map = (u_int8_t*)NULL;
+    _mapLen = 0;
+}
+
 bool FImage::open(u_int32_t *buf, u_int32_t len, bool advErr)
 {
+    unmapFile();
     _buf.resize(len);
     memcpy(_buf.data(), buf, len);
     _len = len;
@@ -116,6 +162,7 @@ bool FImage::open(u_int32_t *buf, u_int32_t len, bool advErr)
 ////////////////////////////////////////////////////////////////////////
 void FImage::close()
 {
+    unmapFile();
     _fname = (const char*)NULL;
     _buf.resize(0);
     _len = 0;
@@ -125,6 +172,11 @@ void FImage::close()
 /////////////////////////////////////////////////////////////////////////
 u_int32_t* FImage::getBuf()
 {
+    if (_map) {
+        // From now on the image is modified in memory only
+        _isFile = false;
+        return (u_int32_t*)_map;
+    }
     if (_isFile) {
         // Read the entire file on demand
         FILE *fh = fopen(_fname, "rb");
@@ -173,7 +225,7 @@ bool FImage::read(u_int32_t addr, void *data, int len, bool verbose, const char
         return false;
     }
 
-    if (!_isFile && _buf.size() == 0) {
+    if (!_isFile && !_map && _buf.size() == 0) {
         return errmsg("read() when not opened");
     }
 
@@ -191,7 +243,7 @@ bool FImage::read(u_int32_t addr, void *data, int len, bool verbose, const char
     align.Init(addr, len);
     while (align.GetNextChunk(chunk_addr, chunk_size)) {
         u_int32_t phys_addr = cont2phys(chunk_addr);
-        if (_isFile) {
+        if (_isFile && !_map) {
             FILE *fh = fopen(_fname, "rb");
             if (!fh) {
                 return errmsg("Can not open file \"%s\" - %s", _fname, strerror(errno));
@@ -207,7 +259,7 @@ bool FImage::read(u_int32_t addr, void *data, int len, bool verbose, const char
             fclose(fh);
         } else {
             memcpy((u_int8_t*)data + (chunk_addr - addr),
-                   _buf.data() +  phys_addr,
+                   imageData() +  phys_addr,
                    chunk_size);
         }
     }
@@ -215,6 +267,21 @@ bool FImage::read(u_int32_t addr, void *data, int len, bool verbose, const char
     return true;
 } // FImage::read
 
+////////////////////////////////////////////////////////////////////////
+const u_int8_t* FImage::getSpan(u_int32_t addr, u_int32_t len)
+{
+    if (!len || (_isFile && !_map) || (!_map && _buf.size() == 0)) {
+        return (const u_int8_t*)NULL;
+    }
+
+    u_int32_t phys_addr = cont2phys(addr);
+    // The range must not cross into the other half of an odd/even chunk
+    if (cont2phys(addr + len - 1) != phys_addr + len - 1 || phys_addr + len > _len) {
+        return (const u_int8_t*)NULL;
+    }
+    return imageData() + phys_addr;
+} // FImage::getSpan
+
 ////////////////////////////////////////////////////////////////////////
 u_int32_t FImage::get_sector_size()
 {
@@ -299,6 +366,15 @@ bool FImage::getFileSize(int& fileSize)
 bool FImage::write(u_int32_t addr, void *data, int cnt)
 {
     if (!_isFile) {
+        if (_map) {
+            if (addr + cnt <= _mapLen) {
+                memcpy(_map + addr, data, cnt);
+                return true;
+            }
+            // Growing the image, continue on a copy
+            _buf.assign(_map, _map + _mapLen);
+            unmapFile();
+        }
         if (_buf.size() < addr + cnt) {
             _buf.resize(addr + cnt);
         }
@@ -325,6 +401,10 @@ bool FImage::write(u_int32_t addr, void *data, int cnt)
         return false;
     }
     _len = dataVec.size();
+    if (_map) {
+        // Pages not touched yet may or may not see the rewrite, map again
+        mapFile();
+    }
     return true;
 }
 
@@ -550,9 +630,7 @@ bool Flash::write_phy(u_int32_t phy_addr, u_int32_t data)
 
 bool Flash::write_phy(u_int32_t phy_addr, void *data, int cnt, bool noerase)
 {
-    // Avoid warning
-    (void)noerase;
-    NATIVE_PHY_ADDR_FUNC(write, (phy_addr, data, cnt));
+    NATIVE_PHY_ADDR_FUNC(write, (phy_addr, data, cnt, noerase));
 }
 
 bool Flash::read_modify_write_phy(u_int32_t phy_addr, void *data, int cnt, bool noerase)
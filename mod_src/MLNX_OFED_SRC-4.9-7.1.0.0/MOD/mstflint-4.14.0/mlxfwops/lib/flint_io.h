@@ -146,6 +146,9 @@ public:
     virtual mflash* getMflashObj() = 0;
     virtual bool erase_sector(u_int32_t addr) = 0;
     virtual BinIdT    get_bin_id() { return UNKNOWN_BIN;};
+    // Zero-copy access to len bytes at the (contiguous) address addr, NULL
+    // when the data is not in memory or is not contiguous. Read only.
+    virtual const u_int8_t* getSpan(u_int32_t, u_int32_t) { return (const u_int8_t*)NULL;}
     Crc16&            get_image_crc() {return _image_crc;};
     bool              is_flash() {return _is_flash;};
 
@@ -255,7 +258,9 @@ public:
         _fname(0),
         _buf(),
         _isFile(false),
-        _len(0) {}
+        _len(0),
+        _map((u_int8_t*)NULL),
+        _mapLen(0) {}
     virtual ~FImage() { close();}
 
     u_int32_t* getBuf();
@@ -267,6 +272,7 @@ public:
     virtual bool read(u_int32_t addr, u_int32_t *data);
     virtual bool read(u_int32_t addr, void *data, int len, bool verbose = false, const char *message = "");
     virtual bool write(u_int32_t addr, void *data, int cnt);
+    virtual const u_int8_t* getSpan(u_int32_t addr, u_int32_t len);
     virtual bool write(u_int32_t, void *, int, bool)
     {
         check_uefi_build();
@@ -345,11 +351,19 @@ private:
     bool readFileGetBuffer(std::vector<u_int8_t>& dataBuf);
     bool writeEntireFile(std::vector<u_int8_t>& fileContent);
     bool getFileSize(int& fileSize);
+    bool mapFile();
+    void unmapFile();
+    u_int8_t* imageData() { return _map ? _map : _buf.data();}
 
     const char *_fname;
     std::vector<u_int8_t> _buf;
     bool _isFile;
     u_int32_t _len;
+    // Private writable mapping of the file: reads come straight from the
+    // page cache and getBuf() users modify their own copy-on-write pages,
+    // as they did with the copy in _buf
+    u_int8_t *_map;
+    u_int32_t _mapLen;
 };
 
 
@@ -452,6 +452,13 @@ bool Fs3Operations::GetImageInfoFromSection(u_int8_t *buff, u_int8_t sect_type,
     return errmsg("Getting info from section type (%s:%d) is not supported\n", GetSectionNameByType(sect_type), sect_type);
 }
 
+// Sections whose buffer is byte swapped while getting their info, they
+// can't be parsed in place
+bool Fs3Operations::IsSectionSwappedInPlace(u_int8_t sect_type)
+{
+    return sect_type == FS3_ROM_CODE || sect_type == FS3_DBG_FW_INI;
+}
+
 bool Fs3Operations::IsGetInfoSupported(u_int8_t sect_type)
 {
     return GetImageInfoFromSection((u_int8_t *)NULL, sect_type, 0, 1);
@@ -556,15 +563,25 @@ bool Fs3Operations::VerifyTOC(u_int32_t dtoc_addr, bool &bad_signature, VerifyCa
                         break;
                     }
                     // Only when we have full verify or the info of this section should be collected for query
-                    std::vector<u_int8_t> buffv(entry_size_in_bytes);
-                    u_int8_t *buff = (u_int8_t *)(buffv.size() ? (&(buffv[0])) : NULL);
+                    std::vector<u_int8_t> buffv;
+                    u_int8_t *buff = (u_int8_t *)NULL;
+                    if (!show_itoc && !verbose && !IsSectionSwappedInPlace(toc_entry.type)) {
+                        // Verify and query the section in place when the image is in memory
+                        buff = (u_int8_t *)_ioAccess->getSpan(flash_addr, entry_size_in_bytes);
+                    }
+                    if (!buff) {
+                        buffv.resize(entry_size_in_bytes);
+                        buff = (u_int8_t *)(buffv.size() ? (&(buffv[0])) : NULL);
+                    }
                     if (show_itoc) {
                         cibfw_itoc_entry_dump(&toc_entry, stdout);
                         if (!DumpFs3CRCCheck(toc_entry.type, phys_addr, entry_size_in_bytes, 0, 0, true, verifyCallBackFunc)) {
                             ret_val = false;
                         }
                     } else {
-                        if (!verbose) {
+                        if (buffv.empty()) {
+                            // buff points into the image
+                        } else if (!verbose) {
                         READBUF((*_ioAccess), flash_addr, buff, entry_size_in_bytes, "Section");
                         }
                         else {
@@ -1107,21 +1124,31 @@ bool Fs3Operations::BurnFs3Image(Fs3Operations &imageOps,
         return errmsg("Failed to burn FW. Internal error.");
     }
 
+    DiffBurnGuard diffBurnGuard(*this, burnParams.differentialBurn);
+
     // write the image
     int alreadyWrittenSz = 0;
 
     /* Write begining of image: up to and including ITOCs  W/O signature */
     u_int32_t beginingWithoutSignatureSize =  imageOps._fs3ImgInfo.itocAddr + sector_size - FS3_FW_SIGNATURE_SIZE;
-    data8 = new u_int8_t[beginingWithoutSignatureSize];
-    imageOps._imageCache.get(data8, FS3_FW_SIGNATURE_SIZE, beginingWithoutSignatureSize);
+    // A differential burn may skip the first sector, so it writes the signature area as blank
+    // too: a valid signature left on flash makes that sector differ and be erased first. An
+    // image target keeps its signature, nothing writes it after the sections.
+    u_int32_t beginingAddr = _diffBurn && f->is_flash() ? 0 : FS3_FW_SIGNATURE_SIZE;
+    u_int32_t beginingSize = beginingWithoutSignatureSize + FS3_FW_SIGNATURE_SIZE - beginingAddr;
+    total_img_size += FS3_FW_SIGNATURE_SIZE - beginingAddr;
+    data8 = new u_int8_t[beginingSize];
+    memset(data8, 0xff, beginingSize - beginingWithoutSignatureSize);
+    imageOps._imageCache.get(data8 + beginingSize - beginingWithoutSignatureSize, FS3_FW_SIGNATURE_SIZE,
+                             beginingWithoutSignatureSize);
     // write boot section, itoc array (wo signature)
     if (!writeImageEx(
             burnParams.progressFuncEx,
             burnParams.progressUserData,
             burnParams.progressFunc,
-            FS3_FW_SIGNATURE_SIZE,
+            beginingAddr,
             data8,
-            beginingWithoutSignatureSize,
+            beginingSize,
             false,
             false,
             total_img_size,
@@ -1130,7 +1157,7 @@ bool Fs3Operations::BurnFs3Image(Fs3Operations &imageOps,
         return false;
     }
     delete[] data8;
-    alreadyWrittenSz += beginingWithoutSignatureSize;
+    alreadyWrittenSz += beginingSize;
     // write itoc entries data
     for (int i = 0; i < imageOps._fs3ImgInfo.numOfItocs; i++) {
         struct toc_info *itoc_info_p = &imageOps._fs3ImgInfo.tocArr[i];
@@ -1157,6 +1184,7 @@ bool Fs3Operations::BurnFs3Image(Fs3Operations &imageOps,
     }
 
     if (!f->is_flash()) {
+        updateBurnStatus(burnParams);
         return true;
     }
 
@@ -1167,6 +1195,7 @@ bool Fs3Operations::BurnFs3Image(Fs3Operations &imageOps,
     if (!f->write(0, imageSignature, 16, true)) {
         return errmsg("Failed to write image signature: %s", f->err());
     }
+    _burnBytesWritten += 16;
     return DoAfterBurnJobs(_cntx_magic_pattern, imageOps, burnParams, f,
                            new_image_start, is_curr_image_in_odd_chunks);
 }
@@ -3664,6 +3693,8 @@ bool Fs3Operations::DoAfterBurnJobs(const u_int32_t magic_patter[],
     u_int32_t zeroes = 0;
     bool boot_address_was_updated = true;
 
+    updateBurnStatus(burnParams);
+
     // if we access without cache replacement or the burn was non failsafe, update YU bootloaders.
     // if we access with cache replacement notify currently running fw of new image start address to crspace (for SW reset)
     //TODO: add SwitchIB, Spectrum when we have support for ISFU
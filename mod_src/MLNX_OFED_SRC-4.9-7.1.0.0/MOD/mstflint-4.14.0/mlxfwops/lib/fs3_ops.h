@@ -155,6 +155,7 @@ protected:
     const char* GetSectionNameByType(u_int8_t section_type);
     bool GetImageInfoFromSection(u_int8_t *buff, u_int8_t sect_type, u_int32_t sect_size, u_int8_t check_support_only = 0);
     bool IsGetInfoSupported(u_int8_t sect_type);
+    bool IsSectionSwappedInPlace(u_int8_t sect_type);
     bool IsFs3SectionReadable(u_int8_t type, QueryOptions queryOptions);
     bool GetMfgInfo(u_int8_t *buff);
     bool GetDevInfo(u_int8_t *buff);
@@ -414,8 +414,16 @@ bool Fs4Operations::verifyTocEntries(u_int32_t tocAddr, bool show_itoc, bool isD
             if (IsFs3SectionReadable(tocEntry.type, queryOptions)) {
 
                 // Only when we have full verify or the info of this section should be collected for query
-                std::vector<u_int8_t> buffv(entrySizeInBytes);
-                u_int8_t *buff = (u_int8_t *)(buffv.size() ? (&(buffv[0])) : NULL);
+                std::vector<u_int8_t> buffv;
+                u_int8_t *buff = (u_int8_t *)NULL;
+                if (!show_itoc && !verbose && !IsSectionSwappedInPlace(tocEntry.type)) {
+                    // Verify and query the section in place when the image is in memory
+                    buff = (u_int8_t *)_ioAccess->getSpan(flash_addr, entrySizeInBytes);
+                }
+                if (!buff) {
+                    buffv.resize(entrySizeInBytes);
+                    buff = (u_int8_t *)(buffv.size() ? (&(buffv[0])) : NULL);
+                }
 
                 if (show_itoc) {
                     cx5fw_itoc_entry_dump(&tocEntry, stdout);
@@ -424,7 +432,9 @@ bool Fs4Operations::verifyTocEntries(u_int32_t tocAddr, bool show_itoc, bool isD
                         retVal = false;
                     }
                 } else {
-                    if (!verbose) {
+                    if (buffv.empty()) {
+                        // buff points into the image
+                    } else if (!verbose) {
                     READBUF((*_ioAccess), flash_addr, buff, entrySizeInBytes, "Section");
                     }
                     else {
@@ -1427,23 +1437,33 @@ bool Fs4Operations::BurnFs4Image(Fs4Operations &imageOps,
         return errmsg("Failed to burn FW. Internal error.");
     }
 
+    DiffBurnGuard diffBurnGuard(*this, burnParams.differentialBurn);
+
     //Write the image:
     alreadyWrittenSz = 0;
 
     //bring the boot section and itoc array from the cache
     u_int32_t beginingWithoutSignatureSize =
         imageOps._fs4ImgInfo.itocArr.tocArrayAddr + sector_size - FS3_FW_SIGNATURE_SIZE;
-    data8 = new u_int8_t[beginingWithoutSignatureSize];
-    imageOps._imageCache.get(data8, FS3_FW_SIGNATURE_SIZE, beginingWithoutSignatureSize);
+    //A differential burn may skip the first sector, so it writes the signature area as blank
+    //too: a valid signature left on flash makes that sector differ and be erased first. An
+    //image target keeps its signature, nothing writes it after the sections.
+    u_int32_t beginingAddr = _diffBurn && f->is_flash() ? 0 : FS3_FW_SIGNATURE_SIZE;
+    u_int32_t beginingSize = beginingWithoutSignatureSize + FS3_FW_SIGNATURE_SIZE - beginingAddr;
+    total_img_size += FS3_FW_SIGNATURE_SIZE - beginingAddr;
+    data8 = new u_int8_t[beginingSize];
+    memset(data8, 0xff, beginingSize - beginingWithoutSignatureSize);
+    imageOps._imageCache.get(data8 + beginingSize - beginingWithoutSignatureSize, FS3_FW_SIGNATURE_SIZE,
+                             beginingWithoutSignatureSize);
 
     //Write boot section and IToc array (without signature)
     if (!writeImageEx(
             burnParams.progressFuncEx,
             burnParams.progressUserData,
             burnParams.progressFunc,
-            FS3_FW_SIGNATURE_SIZE,
+            beginingAddr,
             data8,
-            imageOps._fs4ImgInfo.itocArr.tocArrayAddr + sector_size - FS3_FW_SIGNATURE_SIZE,
+            beginingSize,
             false,
             false,
             total_img_size,
@@ -1452,7 +1472,7 @@ bool Fs4Operations::BurnFs4Image(Fs4Operations &imageOps,
         return false;
     }
     delete[] data8;
-    alreadyWrittenSz += imageOps._fs4ImgInfo.itocArr.tocArrayAddr + sector_size - FS3_FW_SIGNATURE_SIZE;
+    alreadyWrittenSz += beginingSize;
 
     // write itoc entries data
     for (int i = 0; i < imageOps._fs4ImgInfo.itocArr.numOfTocs; i++) {
@@ -1526,6 +1546,7 @@ bool Fs4Operations::BurnFs4Image(Fs4Operations &imageOps,
 
 
     if (!f->is_flash()) {
+        updateBurnStatus(burnParams);
         return true;
     }
     bool IsUpdateSignatures = true;
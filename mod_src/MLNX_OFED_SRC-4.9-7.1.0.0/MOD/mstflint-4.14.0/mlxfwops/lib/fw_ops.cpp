@@ -34,6 +34,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <algorithm>
 
 #include "flint_base.h"
 #include "flint_io.h"
@@ -852,9 +853,8 @@ init_fwops:
 u_int32_t FwOperations::CalcImageCRC(u_int32_t *buff, u_int32_t size)
 {
     Crc16 crc;
-    TOCPUn(buff, size);
-    CRCn(crc, buff, size);
-    CPUTOn(buff, size);
+    // buff holds big endian dwords and may point into a read-only image mapping
+    crc.addBuffer(buff, size * 4);
     crc.finish();
     u_int32_t new_crc = crc.get();
     return new_crc;
@@ -868,11 +868,32 @@ bool FwOperations::writeImageEx(ProgressCallBackEx progressFuncEx, void *progres
     u_int32_t last_percent = 0xff;
     totalSz = totalSz == -1 ? cnt : totalSz;
     int origFlashWorkingMode = Flash::Fwm_Default;
+    std::vector<std::pair<u_int32_t, u_int32_t> > diffWritten; // (offset, size) of the pieces programmed
+    bool written;
     bool rc;
     while (towrite) {
         // Write
         int trans;
-        if (_ioAccess->is_flash()) {
+        if (_diffBurn && _ioAccess->is_flash()) {
+            // differential burn: work sector by sector and only erase/program the sectors that differ
+            if (readModifyWrite) {
+                origFlashWorkingMode = _ioAccess->get_flash_working_mode();
+                _ioAccess->set_flash_working_mode(Flash::Fwm_Default);
+            }
+            u_int32_t sectSize = ((Flash*)_ioAccess)->get_current_sector_size();
+            u_int32_t offInSect = curr_addr & (sectSize - 1);
+            trans = (towrite > sectSize - offInSect) ? sectSize - offInSect : towrite;
+            rc = writeFlashDiff(curr_addr, p, trans, isPhysAddr, readModifyWrite, written);
+            if (readModifyWrite) {
+                _ioAccess->set_flash_working_mode(origFlashWorkingMode);
+            }
+            if (!rc) {
+                return false;
+            }
+            if (written) {
+                diffWritten.push_back(std::make_pair(cnt - towrite, (u_int32_t)trans));
+            }
+        } else if (_ioAccess->is_flash()) {
             if (readModifyWrite) {
                 // perform write with the smallest supported sector size
                 origFlashWorkingMode = _ioAccess->get_flash_working_mode();
@@ -899,11 +920,19 @@ bool FwOperations::writeImageEx(ProgressCallBackEx progressFuncEx, void *progres
             if (!rc) {
                 return errmsg(MLXFW_FLASH_WRITE_ERR, "Flash write failed: %s", _ioAccess->err());
             }
+            _burnBytesWritten += trans;
+        } else if (_diffBurn) {
+            // differential burn to an image: compared in emulated sectors, written in one piece per run
+            trans = towrite;
+            if (!writeImageDiff(curr_addr, p, trans)) {
+                return false;
+            }
         } else {
             trans = towrite;
             if (!((FImage*)_ioAccess)->write(curr_addr, p, trans)) {
                 return errmsg("%s", _ioAccess->err());
             }
+            _burnBytesWritten += trans;
         }
         p += trans;
         curr_addr += trans;
@@ -923,9 +952,132 @@ bool FwOperations::writeImageEx(ProgressCallBackEx progressFuncEx, void *progres
         }
     }
     }
+    // read back the sectors the differential burn programmed
+    for (size_t i = 0; i < diffWritten.size(); i++) {
+        u_int32_t off = diffWritten[i].first;
+        if (!verifyFlashData(addr + off, (u_int8_t*)data + off, diffWritten[i].second, isPhysAddr)) {
+            return false;
+        }
+    }
     return true;
 } //  Flash::WriteImage
 
+bool FwOperations::readFlashData(u_int32_t addr, std::vector<u_int8_t>& buff, u_int32_t size, bool isPhysAddr)
+{
+    buff.resize(size);
+    if (!(isPhysAddr ? _ioAccess->read_phy(addr, &buff[0], size) : _ioAccess->read(addr, &buff[0], size))) {
+        return errmsg(MLXFW_FLASH_READ_ERR, "Flash read failed: %s", _ioAccess->err());
+    }
+    return true;
+}
+
+// Writes data that lies within one flash sector. Data already on flash is skipped, data that
+// only needs bits cleared is programmed without an erase, a whole sector is erased and
+// programmed, and a partial sector goes through a read-modify-write so the neighbouring data
+// that was skipped (or written by a previous call) is kept.
+bool FwOperations::writeFlashDiff(u_int32_t addr, u_int8_t *data, u_int32_t size, bool isPhysAddr, bool readModifyWrite,
+                                  bool& written)
+{
+    Flash *f = (Flash*)_ioAccess;
+    std::vector<u_int8_t> curr;
+    bool programOnly = true;
+    bool rc;
+
+    written = false;
+    if (!readFlashData(addr, curr, size, isPhysAddr)) {
+        return false;
+    }
+    if (memcmp(&curr[0], data, size) == 0) {
+        _burnBytesSkipped += size;
+        return true;
+    }
+    for (u_int32_t i = 0; i < size && programOnly; i++) {
+        programOnly = (curr[i] & data[i]) == data[i];
+    }
+
+    u_int32_t sectSize = f->get_current_sector_size();
+    if (programOnly) {
+        rc = isPhysAddr ? f->write_phy(addr, data, size, true) : f->write(addr, data, size, true);
+    } else if (readModifyWrite || (addr & (sectSize - 1)) || size != sectSize) {
+        rc = isPhysAddr ? f->read_modify_write_phy(addr, data, size) : f->read_modify_write(addr, data, size);
+    } else {
+        rc = isPhysAddr ? f->erase_sector_phy(addr) && f->write_phy(addr, data, size, true) :
+             f->erase_sector(addr) && f->write(addr, data, size, true);
+    }
+    if (!rc) {
+        return errmsg(MLXFW_FLASH_WRITE_ERR, "Flash write failed: %s", f->err());
+    }
+    _burnBytesWritten += size;
+    written = true;
+    return true;
+}
+
+// Image counterpart of writeFlashDiff(): the data is compared with the image in
+// FS3_DEFAULT_SECTOR_SIZE sectors, and each run of sectors that differ (or lie past the
+// end of the image) is written with a single write, as a file backed image is rewritten
+// as a whole on every write. Like FImage::write(), addr is not converted.
+bool FwOperations::writeImageDiff(u_int32_t addr, u_int8_t *data, u_int32_t size)
+{
+    FImage *fim = (FImage*)_ioAccess;
+    u_int32_t imgSize = fim->get_size();
+    u_int32_t cmpSize = addr < imgSize ? std::min(size, imgSize - addr) : 0;
+    std::vector<std::pair<u_int32_t, u_int32_t> > runs; // (offset, size) of the pieces to write
+    std::vector<u_int8_t> curr;
+
+    curr.resize(cmpSize);
+    if (cmpSize && !fim->read_phy(addr, &curr[0], cmpSize)) {
+        return errmsg("%s", fim->err());
+    }
+    for (u_int32_t off = 0; off < size;) {
+        u_int32_t n = FS3_DEFAULT_SECTOR_SIZE - ((addr + off) & (FS3_DEFAULT_SECTOR_SIZE - 1));
+        n = std::min(n, size - off);
+        if (off + n <= cmpSize && memcmp(&curr[off], data + off, n) == 0) {
+            _burnBytesSkipped += n;
+        } else if (!runs.empty() && runs.back().first + runs.back().second == off) {
+            runs.back().second += n;
+        } else {
+            runs.push_back(std::make_pair(off, n));
+        }
+        off += n;
+    }
+    for (size_t i = 0; i < runs.size(); i++) {
+        if (!fim->write(addr + runs[i].first, data + runs[i].first, runs[i].second)) {
+            return errmsg("%s", fim->err());
+        }
+        _burnBytesWritten += runs[i].second;
+    }
+    return true;
+}
+
+bool FwOperations::verifyFlashData(u_int32_t addr, const u_int8_t *data, u_int32_t size, bool isPhysAddr)
+{
+    std::vector<u_int8_t> curr;
+
+    if (!readFlashData(addr, curr, size, isPhysAddr)) {
+        return false;
+    }
+    for (u_int32_t i = 0; i < size; i++) {
+        if (curr[i] != data[i]) {
+            return errmsg(MLXFW_FLASH_WRITE_ERR, "Flash verify failed at address 0x%x: read 0x%02x, expected 0x%02x",
+                          addr + i, curr[i], data[i]);
+        }
+    }
+    return true;
+}
+
+void FwOperations::startBurnStats(bool diffBurn)
+{
+    _diffBurn = diffBurn;
+    _burnBytesWritten = 0;
+    _burnBytesSkipped = 0;
+}
+
+void FwOperations::updateBurnStatus(ExtBurnParams& burnParams)
+{
+    burnParams.burnStatus.bytesWritten = _burnBytesWritten;
+    burnParams.burnStatus.bytesSkipped = _burnBytesSkipped;
+}
+
 
 bool FwOperations::writeImage(ProgressCallBack progressFunc, u_int32_t addr, void *data, int cnt, bool isPhysAddr, bool readModifyWrite, int totalSz, int alreadyWrittenSz)
 {
@@ -956,9 +1108,7 @@ void FwOperations::recalcSectionCrc(u_int8_t *buf, u_int32_t data_size)
 
     Crc16 crc;
     u_int32_t crcRes;
-    for (u_int32_t i = 0; i < data_size; i += 4) {
-        crc << __be32_to_cpu(*(u_int32_t*)(buf + i));
-    }
+    crc.addBuffer(buf, data_size & ~3);
     crc.finish();
     crcRes = crc.get();
     *((u_int32_t*)(buf + data_size)) = __cpu_to_be32(crcRes);
@@ -74,7 +74,8 @@ public:
         _ioAccess(ioAccess), _isCached(false), _wasVerified(false),
         _quickQuery(false), _printFunc((PrintCallBack)NULL), _fname((const char*)NULL), \
         _devName((const char*)NULL), _advErrors(true), _minBinMinorVer(0), _minBinMajorVer(0),
-        _maxBinMajorVer(0), _signatureMngr((ISignatureManager*)NULL), _internalQueryPerformed(false)
+        _maxBinMajorVer(0), _signatureMngr((ISignatureManager*)NULL), _internalQueryPerformed(false),
+        _diffBurn(false), _burnBytesWritten(0), _burnBytesSkipped(0)
     {
         memset(_sectionsToRead, 0, sizeof(_sectionsToRead));
         memset(&_fwImgInfo, 0, sizeof(_fwImgInfo));
@@ -242,7 +243,9 @@ private:
     class ExtBurnStatus {
 public:
         bool imageCachedSuccessfully;
-        ExtBurnStatus() : imageCachedSuccessfully(false) {}
+        u_int32_t bytesWritten; // bytes actually erased and programmed by the burn
+        u_int32_t bytesSkipped; // bytes found identical on flash (differential burn only)
+        ExtBurnStatus() : imageCachedSuccessfully(false), bytesWritten(0), bytesSkipped(0) {}
     };
     class ExtBurnParams {
 
@@ -270,6 +273,7 @@ public:
         bool useDevImgInfo; // FS3 image only - preserve select fields of image_info section on the device when burning.
         BurnRomOption burnRomOptions;
         bool shift8MBIfNeeded;
+        bool differentialBurn; // FS3/FS4 only - program only the flash sectors that differ from the image
 
         //callback fun
         ProgressCallBack progressFunc;
@@ -285,7 +289,7 @@ public:
             vsdSpecified(false), blankGuids(false), burnFailsafe(true), allowPsidChange(false),
             useImagePs(false), useImageGuids(false), singleImageBurn(true), noDevidCheck(false),
             skipCiReq(false), ignoreVersionCheck(false), useImgDevData(false), useDevImgInfo(false),
-            burnRomOptions(BRO_DEFAULT), shift8MBIfNeeded(false), progressFunc((ProgressCallBack)NULL),
+            burnRomOptions(BRO_DEFAULT), shift8MBIfNeeded(false), differentialBurn(false), progressFunc((ProgressCallBack)NULL),
             progressFuncEx((ProgressCallBackEx)NULL), progressUserData(NULL), userVsd((char*)NULL)
         { ProgressFuncAdv.func = (f_prog_func_adv)NULL; ProgressFuncAdv.opaque = NULL;}
 
@@ -450,6 +454,15 @@ public:
         burnDataParamsT() : data((u_int32_t*)NULL), dataSize(0), progressFunc((ProgressCallBack)NULL), calcSha(false) {};
     };
 
+    // Starts the burn statistics and keeps the differential burn on until the end of the scope
+    class DiffBurnGuard {
+public:
+        DiffBurnGuard(FwOperations& ops, bool diffBurn) : _ops(ops) { _ops.startBurnStats(diffBurn);}
+        ~DiffBurnGuard() { _ops._diffBurn = false;}
+private:
+        FwOperations& _ops;
+    };
+
     typedef int (*print2log_func) (const char *format, ...);
 
     // Protected Methods
@@ -462,6 +475,12 @@ public:
     u_int32_t CalcImageCRC(u_int32_t *buff, u_int32_t size);
     bool writeImage(ProgressCallBack progressFunc, u_int32_t addr, void *data, int cnt, bool isPhysAddr = false, bool readModifyWrite = false, int totalSz = -1, int alreadyWrittenSz = 0);
     bool writeImageEx(ProgressCallBackEx progressFuncEx, void *progressUserData, ProgressCallBack progressFunc, u_int32_t addr, void *data, int cnt, bool isPhysAddr = false, bool readModifyWrite = false, int totalSz = -1, int alreadyWrittenSz = 0);
+    bool readFlashData(u_int32_t addr, std::vector<u_int8_t>& buff, u_int32_t size, bool isPhysAddr);
+    bool writeFlashDiff(u_int32_t addr, u_int8_t *data, u_int32_t size, bool isPhysAddr, bool readModifyWrite, bool& written);
+    bool writeImageDiff(u_int32_t addr, u_int8_t *data, u_int32_t size);
+    bool verifyFlashData(u_int32_t addr, const u_int8_t *data, u_int32_t size, bool isPhysAddr);
+    void startBurnStats(bool diffBurn);
+    void updateBurnStatus(ExtBurnParams& burnParams);
     //////////////////////////////////////////////////////////////////
     bool GetSectData(std::vector<u_int8_t>& file_sect, const u_int32_t *buff, const u_int32_t size);
     ////////////////////////////////////////////////////////////////////
@@ -521,6 +540,10 @@ public:
     u_int8_t _maxBinMajorVer;
     ISignatureManager* _signatureMngr;
     bool _internalQueryPerformed;
+    // differential burn: writeImageEx skips flash sectors whose content already matches
+    bool _diffBurn;
+    u_int32_t _burnBytesWritten;
+    u_int32_t _burnBytesSkipped;
 
 private:
 
@@ -35,6 +35,8 @@
 #include <string.h>
 #include <errno.h>
 #include <stdio.h>
+#include <sys/time.h>
+#include <sys/resource.h>
 #include <stdlib.h>
 #include <string.h>
 #include <cstdio>
@@ -113,6 +115,8 @@
 #define IGNORE_REG_CHECK_FLAG_SHORT ' '
 #define FORCE_FLAG                  "yes"
 #define FORCE_FLAG_SHORT            ' '
+#define BENCH_ADB_FLAG              "bench_adb"
+#define BENCH_ADB_FLAG_SHORT        ' '
 
 using namespace mlxreg;
 
@@ -136,6 +140,7 @@ MlxRegUi::MlxRegUi() :
     _op             = CMD_UNKNOWN;
     _mlxRegLib      = NULL;
     _force          = false;
+    _benchRounds    = 0;
 #if defined(EXTERNAL) || defined(MST_UL)
     _isExternal     = true;
 #else
@@ -177,6 +182,7 @@ void MlxRegUi::initCmdParser()
     AddOptions(OP_SHOW_REGS_FLAG, OP_SHOW_REGS_FLAG_SHORT, "", "Print available registers names and exit");
     AddOptions(OP_SHOW_ALL_REGS_FLAG, OP_SHOW_ALL_REGS_FLAG_SHORT, "", "");
     AddOptions(FORCE_FLAG, FORCE_FLAG_SHORT, "", "");
+    AddOptions(BENCH_ADB_FLAG, BENCH_ADB_FLAG_SHORT, "Rounds", "Time loading <adb_file> and looking up a register, no device is accessed");
     _cmdParser.AddRequester(this);
 }
 
@@ -231,6 +237,7 @@ void MlxRegUi::printHelp()
     printFlagLine(OP_SHOW_REG_FLAG_SHORT,   OP_SHOW_REG_FLAG,  "reg_name", "Print the fields of a given reg access (must have reg_name)");
     printFlagLine(OP_SHOW_REGS_FLAG_SHORT,  OP_SHOW_REGS_FLAG, "", "Print all available reg access'");
     printFlagLine(FORCE_FLAG_SHORT,         FORCE_FLAG,        "", "Non-interactive mode, answer yes to all questions");
+    printFlagLine(BENCH_ADB_FLAG_SHORT,     BENCH_ADB_FLAG,    "rounds", "Time <rounds> loads of --adb_file and register lookups, no device is accessed");
 
     // print usage examples
     printf("\n");
@@ -244,6 +251,45 @@ void MlxRegUi::printHelp()
     printf("\n");
 }
 
+/************************************
+* Function: benchAdb
+************************************/
+static double getTimeMs()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+void MlxRegUi::benchAdb()
+{
+    // Measures the ADB load and the first register lookup, no device is accessed
+    double loadMs = 0, lookupMs = 0, firstLoadMs = 0;
+    std::vector<string> regs;
+    std::vector<AdbInstance*> regFields;
+    for (u_int32_t i = 0; i < _benchRounds; i++) {
+        regs.clear();
+        double start = getTimeMs();
+        MlxRegLib *mlxRegLib = new MlxRegLib(NULL, _extAdbFile, _isExternal);
+        double loaded = getTimeMs();
+        mlxRegLib->showRegisters(regs);
+        if (!regs.empty()) {
+            mlxRegLib->showRegister(_regName != "" ? _regName : regs[0], regFields);
+        }
+        double end = getTimeMs();
+        delete mlxRegLib;
+        if (i == 0) {
+            firstLoadMs = loaded - start;
+        }
+        loadMs += loaded - start;
+        lookupMs += end - loaded;
+    }
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    printf("%lu registers, load: first %.2f ms, avg %.2f ms, register lookup: avg %.3f ms, max RSS: %ld KB\n",
+           (unsigned long)regs.size(), firstLoadMs, loadMs / _benchRounds, lookupMs / _benchRounds, usage.ru_maxrss);
+}
+
 /************************************
 * Function: getLongestNodeLen
 ************************************/
@@ -395,6 +441,9 @@ ParseStatus MlxRegUi::HandleOption(string name, string value)
     } else if (name == FORCE_FLAG) {
         _force = true;
         return PARSE_OK;
+    } else if (name == BENCH_ADB_FLAG) {
+        RegAccessParser::strToUint32((char*)value.c_str(), _benchRounds);
+        return PARSE_OK;
     } else if (name == OP_SET_FLAG) {
         CHECK_UNIQUE_OP(_op);
         _op = CMD_SET;
@@ -427,6 +476,12 @@ ParseStatus MlxRegUi::HandleOption(string name, string value)
 ************************************/
 void MlxRegUi::paramValidate()
 {
+    if (_benchRounds) {
+        if (_extAdbFile == "") {
+            throw MlxRegException("you must provide adb_file in order to use %s", BENCH_ADB_FLAG);
+        }
+        return;
+    }
     if (_device == "") {
         throw MlxRegException("you must provide a device name");
     }
@@ -468,6 +523,10 @@ void MlxRegUi::run(int argc, char **argv)
         throw MlxRegException("failed to parse arguments. %s", _cmdParser.GetErrDesc());
     }
     paramValidate();
+    if (_benchRounds) {
+        benchAdb();
+        return;
+    }
     // Init device
     _mf = mopen(_device.c_str());
     if (!_mf) {
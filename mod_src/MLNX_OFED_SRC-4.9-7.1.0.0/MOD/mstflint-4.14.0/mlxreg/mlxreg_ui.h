@@ -69,6 +69,7 @@ private:
     void printHelp();
     void paramValidate();
     bool askUser(const char *question);
+    void benchAdb();
 
     //Print
     void printRegFields(vector<AdbInstance*> nodeFields);
@@ -90,6 +91,7 @@ private:
     bool _force;
     MlxRegLib *_mlxRegLib;
     bool _isExternal;
+    u_int32_t _benchRounds;
 };
 
 #endif /* MLXREG_UI_H */
@@ -41,6 +41,11 @@
 #include <ctype.h>
 #include <compatibility.h>
 #include <stdio.h>
+#if !defined(__WIN__)
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 #define CRD_SELECT_CSV_PATH(dev_name) \
     do {                              \
@@ -75,17 +80,41 @@
 
 #define CRD_MAXLINESIZE 1024
 #define CRD_MAXFLDS 3 /* maximum possible number of fields */
-#define CRD_MAXFLDSIZE 32 /* longest possible field + 1 = 31 byte field */
 #define CRD_CSV_PATH_SIZE 1024
 
+/*
+   Dump plans: the csv of a device is parsed once into a list of merged contiguous
+   ranges which is cached at CRD_PLAN_DIR and reused as long as the csv is unchanged.
+   The cache is only used when its directories are owned by the current user and not
+   writable by anyone else, so it is effectively root only.
+ */
+#define CRD_PLAN_BASE_DIR "/var/cache/mstflint"
+#define CRD_PLAN_DIR CRD_PLAN_BASE_DIR "/dump_plans"
+#define CRD_PLAN_MAGIC 0x50445243 /* "CRDP" */
+#define CRD_PLAN_VERSION 1
+#define CRD_PLAN_MAX_BLOCKS 0x100000
+#define CRD_DUMP_CHUNK_DWORDS 0x1000 /* dwords read by one mread4_block call */
+
+#define CRD_BLOCK_NO_ENABLE_ADDR 0x1 /* block is dumped also without -full */
+
 typedef struct crd_parsed_csv {
 
     u_int32_t addr;
     u_int32_t len;
-    char enable_addr[100];
+    u_int32_t flags;
 
 } crd_parsed_csv_t;
 
+typedef struct crd_plan_hdr {
+    u_int32_t magic;
+    u_int32_t version;
+    u_int64_t csv_size;
+    int64_t   csv_mtime;
+    u_int32_t block_count;
+    u_int32_t reserved;
+    char      csv_path[CRD_CSV_PATH_SIZE];
+} crd_plan_hdr_t;
+
 
 struct crd_ctxt {
     mfile     *mf;
@@ -107,32 +136,22 @@ static char crd_error[256];
 static int crd_get_csv_path(IN dm_dev_id_t dev_type, OUT char *csv_file_path, IN const char *db_path);
 
 /*
-   count number of dwords, and store all needed data from csv file at parsed_csv
+   Get the dump plan of the csv file, from the plans cache if it is up to date, otherwise by parsing the csv.
  */
-static int crd_count_double_word(IN char *csv_file_path, OUT u_int32_t *number_of_dwords,
-                                 OUT crd_parsed_csv_t blocks[], IN int is_full,
-                                 IN u_int8_t read_single_dword);
+static int crd_load_plan(IN char *csv_file_path, OUT crd_parsed_csv_t **blocks, OUT u_int32_t *block_count);
 
 /*
-   Fill addresses at dword_arr
+   Parse the csv file in a single pass, merging contiguous lines into one block
  */
-static int crd_fill_address(IN crd_ctxt_t *context, OUT crd_dword_t *dword_arr);
+static int crd_parse_csv(IN char *csv_file_path, OUT crd_parsed_csv_t **blocks, OUT u_int32_t *block_count);
 
 /*
-   Read a line from csv file
- */
-static int crd_read_line(IN FILE *fd, OUT char *tmp);
-
-/*
-   Tokenize line for address, len, and enable_adder
+   Fill addresses at dword_arr
  */
-
-static void crd_parse(IN char *record, IN char *delim, OUT char arr[][CRD_MAXFLDSIZE], OUT int *field_count);
+static int crd_fill_address(IN crd_ctxt_t *context, OUT crd_dword_t *dword_arr);
 
 static int crd_update_csv_path(IN OUT char *csv_file_path, IN const char *db_path);
 
-static int crd_count_blocks(IN char *csv_file_path, OUT u_int32_t *block_count, u_int8_t read_single_dword);
-
 #if !defined(__WIN__) && !defined(MST_UL)
 static char* crd_trim(char *s);
 
@@ -156,7 +175,8 @@ int crd_init(OUT crd_ctxt_t **context, IN mfile *mf, IN int is_full, IN int caus
     u_int32_t chip_rev = 0;
     u_int32_t number_of_dwords = 0;
     u_int32_t block_count = 0;
-    u_int8_t read_single_dword = 0;
+    u_int32_t i = 0;
+    crd_parsed_csv_t *blocks = NULL;
     char csv_file_path [CRD_CSV_PATH_SIZE] = {0x0};
 
 
@@ -170,9 +190,6 @@ int crd_init(OUT crd_ctxt_t **context, IN mfile *mf, IN int is_full, IN int caus
         return CRD_INVALID_PARM;
     }
 
-    if (cause_addr >= 0 && cause_off >= 0) {
-        read_single_dword = 1;
-    }
     CRD_DEBUG("getting device id\n");
     if (dm_get_device_id(mf, &dev_type, &dev_id, &chip_rev)) {
         CRD_DEBUG("Failed to identify device.");
@@ -185,31 +202,24 @@ int crd_init(OUT crd_ctxt_t **context, IN mfile *mf, IN int is_full, IN int caus
     }
 
 
-    CRD_DEBUG("allocating struct\n");
-    *context = (crd_ctxt_t*)malloc(sizeof(crd_ctxt_t));
-    if (*context == NULL) {
-        CRD_DEBUG("Failed to allocate memmory for context \n");
-        return CRD_MEM_ALLOCATION_ERR;
-    }
-
-    rc = crd_count_blocks(csv_file_path, &block_count, read_single_dword);
+    rc = crd_load_plan(csv_file_path, &blocks, &block_count);
     if (rc) {
-        free(*context);
         return rc;
     }
-
     CRD_DEBUG("Block count : %d\n", block_count);
-    (*context)->blocks = (crd_parsed_csv_t*) malloc(sizeof(crd_parsed_csv_t) * block_count);
-    if ((*context)->blocks == NULL) {
-        CRD_DEBUG("Failed to allocate memmory for csv blocks\n");
-        free(*context);
-        return CRD_MEM_ALLOCATION_ERR;
-    }
 
+    for (i = 0; i < block_count; i++) {
+        if (is_full || (blocks[i].flags & CRD_BLOCK_NO_ENABLE_ADDR)) {
+            number_of_dwords += blocks[i].len;
+        }
+    }
 
-    rc = crd_count_double_word(csv_file_path, &number_of_dwords, (*context)->blocks, is_full, read_single_dword);
-    if (rc) {
-        goto Cleanup;
+    CRD_DEBUG("allocating struct\n");
+    *context = (crd_ctxt_t*)malloc(sizeof(crd_ctxt_t));
+    if (*context == NULL) {
+        CRD_DEBUG("Failed to allocate memmory for context \n");
+        free(blocks);
+        return CRD_MEM_ALLOCATION_ERR;
     }
 
     mset_addr_space(mf, AS_ND_CRSPACE);
@@ -220,14 +230,11 @@ int crd_init(OUT crd_ctxt_t **context, IN mfile *mf, IN int is_full, IN int caus
     (*context)->number_of_dwords = number_of_dwords;
     (*context)->is_full          = is_full;
     (*context)->block_count      = block_count;
+    (*context)->blocks           = blocks;
     (*context)->cause_addr       = cause_addr;
     (*context)->cause_off        = cause_off;
     strcpy((*context)->csv_path, csv_file_path);
     return rc;
-
-Cleanup:
-    crd_free(*context);
-    return rc;
 }
 
 
@@ -251,13 +258,15 @@ int crd_dump_data(IN crd_ctxt_t *context, OUT crd_dword_t *dword_arr, IN crd_cal
 {
     u_int32_t i = 0;
     u_int32_t j = 0;
-    u_int32_t rc;
+    u_int32_t off = 0;
+    u_int32_t chunk = 0;
+    u_int32_t max_chunk = CRD_DUMP_CHUNK_DWORDS;
     u_int32_t addr;
     u_int32_t cause_reg = 0;
-
-    int total = 0;
-    char *data;
+    u_int32_t total = 0;
+    u_int32_t *data;
     crd_dword_t tmp_dword;
+    int rc = CRD_OK;
 
     CRD_CHECK_NULL(context);
 
@@ -266,62 +275,72 @@ int crd_dump_data(IN crd_ctxt_t *context, OUT crd_dword_t *dword_arr, IN crd_cal
         return CRD_INVALID_PARM;
     }
 
+    /* When checking the cause bit every dword is read on its own, so the read that raised it is known */
+    if (context->cause_addr >= 0) {
+        max_chunk = 1;
+    }
+    data = (u_int32_t*)malloc(max_chunk * sizeof(u_int32_t));
+    if (data == NULL) {
+        return CRD_MEM_ALLOCATION_ERR;
+    }
+
     for (i = 0; i < context->block_count; i++) {
-        if (!context->is_full && strcmp(context->blocks[i].enable_addr, CRD_EMPTY)) {
+        if (!context->is_full && !(context->blocks[i].flags & CRD_BLOCK_NO_ENABLE_ADDR)) {
             continue;
         }
-
-        data = (char*) malloc(context->blocks[i].len * sizeof(u_int32_t));
-        if (data == NULL) {
-            return CRD_MEM_ALLOCATION_ERR;
-        }
-        memset(data, 0, context->blocks[i].len * sizeof(u_int32_t));
-
-        rc = mread4_block(context->mf, context->blocks[i].addr, (u_int32_t*)data, context->blocks[i].len * sizeof(u_int32_t));
-        if (context->blocks[i].len * sizeof(u_int32_t) != rc) {
-            sprintf(crd_error, "Cr read (0x%08x) failed: %s(%d)", context->blocks[i].addr, strerror(errno), (u_int32_t)errno);
-            free(data);
-            return CRD_CR_READ_ERR;
+        if (total + context->blocks[i].len > context->number_of_dwords) { // dummy check tadah!
+            CRD_DEBUG("value exceeded, something wrong in calculation!");
+            rc = CRD_EXCEED_VALUE;
+            goto cleanup;
         }
 
-        for (j = 0; j < context->blocks[i].len; j++) {
-            if ((u_int32_t)total >= context->number_of_dwords) { // dummy check tadah!
-                CRD_DEBUG("value exceeded, something wrong in calculation!");
-                free(data);
-                return CRD_EXCEED_VALUE;
+        for (off = 0; off < context->blocks[i].len; off += chunk) {
+            chunk = context->blocks[i].len - off;
+            if (chunk > max_chunk) {
+                chunk = max_chunk;
+            }
+            addr = context->blocks[i].addr + (off * sizeof(u_int32_t));
+            if ((u_int32_t)mread4_block(context->mf, addr, data, chunk * sizeof(u_int32_t)) != chunk * sizeof(u_int32_t)) {
+                sprintf(crd_error, "Cr read (0x%08x) failed: %s(%d)", addr, strerror(errno), (u_int32_t)errno);
+                rc = CRD_CR_READ_ERR;
+                goto cleanup;
             }
-            addr =  context->blocks[i].addr + (j * sizeof(u_int32_t));
 
             if (context->cause_addr >= 0) {  /* if we want to check cause bit - read it and verify it hasn't been raised */
                 if (mread4(context->mf, context->cause_addr, &cause_reg) != sizeof(u_int32_t)) {
                     CRD_DEBUG("Cr read (0x%08x) failed: %s(%d)\n", context->cause_addr, strerror(errno), (u_int32_t)errno);
                     sprintf(crd_error, "Cr read (0x%08x) failed: %s(%d)", context->cause_addr, strerror(errno), (u_int32_t)errno);
-                    free(data);
-                    return CRD_CR_READ_ERR;
+                    rc = CRD_CR_READ_ERR;
+                    goto cleanup;
                 }
                 cause_reg = EXTRACT(cause_reg, context->cause_off, 1);
                 if (cause_reg) {
                     CRD_DEBUG("Cause bit set by read from address 0x%x\n", addr);
                     sprintf(crd_error, "Cause bit set by read from address 0x%x", addr);
-                    free(data);
-                    return CRD_CAUSE_BIT;
+                    rc = CRD_CAUSE_BIT;
+                    goto cleanup;
                 }
             }
 
-            if (dword_arr != NULL) {
-                dword_arr[total].addr = addr;
-                dword_arr[total].data = ((u_int32_t*)data)[j];
-            }
-            if (func != NULL) {
-                tmp_dword.addr = addr;
-                tmp_dword.data = ((u_int32_t*)data)[j];
-                func(&tmp_dword);
+            for (j = 0; j < chunk; j++) {
+                if (dword_arr != NULL) {
+                    dword_arr[total].addr = addr;
+                    dword_arr[total].data = data[j];
+                }
+                if (func != NULL) {
+                    tmp_dword.addr = addr;
+                    tmp_dword.data = data[j];
+                    func(&tmp_dword);
+                }
+                addr += sizeof(u_int32_t);
+                total += 1;
             }
-            total += 1;
         }
-        free(data);
     }
-    return CRD_OK;
+
+cleanup:
+    free(data);
+    return rc;
 }
 
 int crd_get_dword_num(IN crd_ctxt_t *context, OUT u_int32_t *arr_size)
@@ -354,129 +373,285 @@ static int crd_get_csv_path(IN dm_dev_id_t dev_type, OUT char *csv_file_path, IN
     return CRD_OK;
 }
 
-static void crd_parse(IN char *record, IN char *delim, OUT char arr[][CRD_MAXFLDSIZE],
-                      OUT int *field_count)
+static int crd_add_block(INOUT crd_parsed_csv_t **blocks, INOUT u_int32_t *block_count, INOUT u_int32_t *blocks_size,
+                         IN u_int32_t addr, IN u_int32_t len, IN u_int32_t flags)
 {
+    crd_parsed_csv_t *last;
+    crd_parsed_csv_t *tmp_blocks;
 
-    char *p = strtok(record, delim);
-    int field = 0;
-    strcpy(arr[0], "\0");
-    strcpy(arr[1], "\0");
-    strcpy(arr[2], "\0");
-    while (p) {
-        strcpy(arr[field], p);
-        field++;
-        p = strtok(NULL, delim);
-    }
-    *field_count = field;
+    if (len == 0) {
+        return CRD_OK;
+    }
+    if (*block_count) {
+        last = &(*blocks)[*block_count - 1];
+        if (last->flags == flags && (u_int64_t)last->addr + (u_int64_t)last->len * 4 == addr) {
+            last->len += len;
+            return CRD_OK;
+        }
+    }
+    if (*block_count == *blocks_size) {
+        *blocks_size = *blocks_size ? *blocks_size * 2 : 256;
+        tmp_blocks = (crd_parsed_csv_t*)realloc(*blocks, sizeof(crd_parsed_csv_t) * (*blocks_size));
+        if (tmp_blocks == NULL) {
+            CRD_DEBUG("Failed to allocate memmory for csv blocks\n");
+            return CRD_MEM_ALLOCATION_ERR;
+        }
+        *blocks = tmp_blocks;
+    }
+    (*blocks)[*block_count].addr  = addr;
+    (*blocks)[*block_count].len   = len;
+    (*blocks)[*block_count].flags = flags;
+    *block_count += 1;
+    return CRD_OK;
 }
 
-static int crd_count_blocks(IN char *csv_file_path,
-                            OUT u_int32_t *block_count, u_int8_t read_single_dword)
+static int crd_parse_csv(IN char *csv_file_path, OUT crd_parsed_csv_t **blocks, OUT u_int32_t *block_count)
 {
-
-    char tmp[1024] = {0x0};
-    char arr[CRD_MAXFLDS][CRD_MAXFLDSIZE];
+    char tmp[CRD_MAXLINESIZE] = {0x0};
+    char *fields[CRD_MAXFLDS];
+    char *buf = NULL;
+    char *line;
+    char *eol;
+    char *p;
+    long size;
     int field_count = 0;
+    int n;
+    u_int32_t line_num = 0;
+    u_int32_t blocks_size = 0;
+    u_int32_t flags;
+    int rc = CRD_OK;
+
+    *blocks = NULL;
     *block_count = 0;
 
     CRD_DEBUG("CSV file path : %s\n", csv_file_path);
-    FILE *fd = fopen(csv_file_path, "r");
+    FILE *fd = fopen(csv_file_path, "rb");
     if (fd == NULL) {
         CRD_DEBUG("Failed to open csv file : '%s'\n", csv_file_path);
         sprintf(crd_error, "Failed to open csv file : '%s'", csv_file_path);
         return CRD_OPEN_FILE_ERROR;
     }
-    while (!feof(fd)) {
-        if (crd_read_line(fd, tmp) == CRD_SKIP) {
+    if (fseek(fd, 0, SEEK_END) || (size = ftell(fd)) < 0 || fseek(fd, 0, SEEK_SET)) {
+        sprintf(crd_error, "Failed to read csv file : '%s'", csv_file_path);
+        fclose(fd);
+        return CRD_OPEN_FILE_ERROR;
+    }
+    buf = (char*)malloc(size + 1);
+    if (buf == NULL) {
+        fclose(fd);
+        return CRD_MEM_ALLOCATION_ERR;
+    }
+    if (fread(buf, 1, size, fd) != (size_t)size) {
+        sprintf(crd_error, "Failed to read csv file : '%s'", csv_file_path);
+        fclose(fd);
+        free(buf);
+        return CRD_OPEN_FILE_ERROR;
+    }
+    fclose(fd);
+    buf[size] = '\0';
+
+    for (line = buf; *line; line = eol + strspn(eol, "\r\n")) {
+        eol = line + strcspn(line, "\r\n");
+        line_num++;
+        /* Drop the spaces and the comment */
+        n = 0;
+        for (p = line; p < eol && *p != '#' && n < CRD_MAXLINESIZE - 1; p++) {
+            if (*p != ' ' && *p != '\t') {
+                tmp[n++] = *p;
+            }
+        }
+        tmp[n] = '\0';
+        if (!n) {
             continue;
         }
-        crd_parse(tmp, ",", arr, &field_count); /* whack record into fields */
+        /* whack record into fields, empty fields are skipped */
+        field_count = 0;
+        for (p = tmp; *p && field_count < CRD_MAXFLDS;) {
+            if (*p == ',') {
+                p++;
+                continue;
+            }
+            fields[field_count++] = p;
+            p += strcspn(p, ",");
+            if (*p) {
+                *p++ = '\0';
+            }
+        }
         if (field_count < 2) {
-            CRD_DEBUG("CSV File has bad format, line : %s\n", tmp);
-            sprintf(crd_error, "CSV File has bad format, line : %s", tmp);
-            fclose(fd);
-            return CRD_CSV_BAD_FORMAT;
+            CRD_DEBUG("CSV File has bad format, line %u : %s\n", line_num, tmp);
+            sprintf(crd_error, "CSV File has bad format, line %u : %.200s", line_num, tmp);
+            rc = CRD_CSV_BAD_FORMAT;
+            goto cleanup;
         }
-        if (read_single_dword) {
-            *block_count += atoi(arr[1]);
-        } else {
-            *block_count += 1;
+        flags = (field_count < 3 || !strcmp(fields[2], CRD_EMPTY)) ? CRD_BLOCK_NO_ENABLE_ADDR : 0;
+        rc = crd_add_block(blocks, block_count, &blocks_size, (u_int32_t)strtoul(fields[0], NULL, 0),
+                           (u_int32_t)strtoul(fields[1], NULL, 10), flags);
+        if (rc) {
+            goto cleanup;
         }
     }
-    fclose(fd);
-    return CRD_OK;
+
+cleanup:
+    free(buf);
+    if (rc) {
+        free(*blocks);
+        *blocks = NULL;
+        *block_count = 0;
+    }
+    return rc;
 }
 
-static int crd_count_double_word(IN char *csv_file_path, OUT u_int32_t *number_of_dwords,
-                                 OUT crd_parsed_csv_t blocks[], IN int is_full,
-                                 IN u_int8_t read_single_dword)
+#if !defined(__WIN__)
+static void crd_get_plan_path(IN char *csv_file_path, OUT char *plan_path)
 {
+    char *name = strrchr(csv_file_path, '/');
 
-    int field_count       = 0;
-    int block_count       = 0;
-    u_int32_t addr        = 0;
-    u_int32_t len         = 0;
-    u_int32_t i           = 0;
-    char enable_addr[100] = {0};
-    char tmp[1024]  = {0x0};
-    char arr[CRD_MAXFLDS][CRD_MAXFLDSIZE];
+    name = name ? name + 1 : csv_file_path;
+    snprintf(plan_path, CRD_CSV_PATH_SIZE, CRD_PLAN_DIR "/%s.plan", name);
+}
 
-    *number_of_dwords = 0;
+/*
+   Only trust files owned by us that nobody else can write to.
+ */
+static int crd_is_private(IN struct stat *st)
+{
+    return st->st_uid == geteuid() && !(st->st_mode & (S_IWGRP | S_IWOTH));
+}
 
-    CRD_DEBUG("CSV file path : %s\n", csv_file_path);
-    FILE *fd = fopen(csv_file_path, "r");
+/*
+   Check that the plan directories are real directories, not links, that only we can write to.
+ */
+static int crd_plan_dir_trusted(void)
+{
+    struct stat st;
+
+    return !lstat(CRD_PLAN_BASE_DIR, &st) && S_ISDIR(st.st_mode) && crd_is_private(&st) &&
+           !lstat(CRD_PLAN_DIR, &st) && S_ISDIR(st.st_mode) && crd_is_private(&st);
+}
+
+static int crd_read_plan(IN char *plan_path, IN char *csv_file_path, IN struct stat *csv_st,
+                         OUT crd_parsed_csv_t **blocks, OUT u_int32_t *block_count)
+{
+    crd_plan_hdr_t hdr;
+    struct stat plan_st;
+    u_int32_t i;
+    FILE *fd;
+    int fdn;
+
+    if (!crd_plan_dir_trusted()) {
+        return CRD_SKIP;
+    }
+    fdn = open(plan_path, O_RDONLY | O_NOFOLLOW);
+    if (fdn < 0) {
+        return CRD_SKIP;
+    }
+    fd = fdopen(fdn, "rb");
     if (fd == NULL) {
+        close(fdn);
+        return CRD_SKIP;
+    }
+    /* Only trust plans written by us */
+    if (fstat(fileno(fd), &plan_st) || !S_ISREG(plan_st.st_mode) || !crd_is_private(&plan_st) ||
+        fread(&hdr, sizeof(hdr), 1, fd) != 1) {
+        goto skip;
+    }
+    hdr.csv_path[CRD_CSV_PATH_SIZE - 1] = '\0';
+    if (hdr.magic != CRD_PLAN_MAGIC || hdr.version != CRD_PLAN_VERSION ||
+        hdr.csv_size != (u_int64_t)csv_st->st_size || hdr.csv_mtime != (int64_t)csv_st->st_mtime ||
+        strcmp(hdr.csv_path, csv_file_path) || hdr.block_count > CRD_PLAN_MAX_BLOCKS ||
+        (u_int64_t)plan_st.st_size != sizeof(hdr) + (u_int64_t)hdr.block_count * sizeof(crd_parsed_csv_t)) {
+        goto skip;
+    }
+    *blocks = (crd_parsed_csv_t*)malloc(sizeof(crd_parsed_csv_t) * (hdr.block_count ? hdr.block_count : 1));
+    if (*blocks == NULL) {
+        goto skip;
+    }
+    if (fread(*blocks, sizeof(crd_parsed_csv_t), hdr.block_count, fd) != hdr.block_count) {
+        goto free_blocks;
+    }
+    for (i = 0; i < hdr.block_count; i++) {
+        if ((*blocks)[i].len == 0 || ((*blocks)[i].flags & ~CRD_BLOCK_NO_ENABLE_ADDR)) {
+            goto free_blocks;
+        }
+    }
+    fclose(fd);
+    *block_count = hdr.block_count;
+    CRD_DEBUG("Using dump plan : %s\n", plan_path);
+    return CRD_OK;
+
+free_blocks:
+    free(*blocks);
+    *blocks = NULL;
+skip:
+    fclose(fd);
+    return CRD_SKIP;
+}
+
+static void crd_write_plan(IN char *plan_path, IN char *csv_file_path, IN struct stat *csv_st,
+                           IN crd_parsed_csv_t *blocks, IN u_int32_t block_count)
+{
+    crd_plan_hdr_t hdr;
+    char tmp_path[CRD_CSV_PATH_SIZE + 8];
+    FILE *fd;
+    int fdn;
+    int ok;
+
+    if ((mkdir(CRD_PLAN_BASE_DIR, 0755) && errno != EEXIST) || (mkdir(CRD_PLAN_DIR, 0700) && errno != EEXIST) ||
+        !crd_plan_dir_trusted()) {
+        return;
+    }
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic       = CRD_PLAN_MAGIC;
+    hdr.version     = CRD_PLAN_VERSION;
+    hdr.csv_size    = csv_st->st_size;
+    hdr.csv_mtime   = csv_st->st_mtime;
+    hdr.block_count = block_count;
+    memcpy(hdr.csv_path, csv_file_path, strnlen(csv_file_path, CRD_CSV_PATH_SIZE - 1));
+
+    /* Write aside and rename, so a concurrent dump never sees a partial plan */
+    snprintf(tmp_path, sizeof(tmp_path), "%s.XXXXXX", plan_path);
+    fdn = mkstemp(tmp_path);
+    if (fdn < 0) {
+        return;
+    }
+    fd = fdopen(fdn, "wb");
+    if (fd == NULL) {
+        close(fdn);
+        unlink(tmp_path);
+        return;
+    }
+    ok = fwrite(&hdr, sizeof(hdr), 1, fd) == 1 &&
+         fwrite(blocks, sizeof(crd_parsed_csv_t), block_count, fd) == block_count;
+    if (fclose(fd) || !ok || rename(tmp_path, plan_path)) {
+        unlink(tmp_path);
+    }
+}
+#endif
+
+static int crd_load_plan(IN char *csv_file_path, OUT crd_parsed_csv_t **blocks, OUT u_int32_t *block_count)
+{
+    int rc;
+#if !defined(__WIN__)
+    char plan_path[CRD_CSV_PATH_SIZE];
+    struct stat csv_st;
+
+    if (stat(csv_file_path, &csv_st)) {
         CRD_DEBUG("Failed to open csv file : '%s'\n", csv_file_path);
         sprintf(crd_error, "Failed to open csv file : '%s'", csv_file_path);
         return CRD_OPEN_FILE_ERROR;
     }
-
-    while (!feof(fd)) {
-        if (crd_read_line(fd, tmp) == CRD_SKIP) {
-            continue;
-        }
-        crd_parse(tmp, ",", arr, &field_count); /* whack record into fields */
-        if (field_count < 2) {
-            CRD_DEBUG("CSV File has bad format, line : %s\n", tmp);
-            sprintf(crd_error, "CSV File has bad format, line : %s", tmp);
-            fclose(fd);
-            return CRD_CSV_BAD_FORMAT;
-        }
-        addr = (u_int32_t)strtol(arr[0], NULL, 0);
-        len  = atoi(arr[1]);
-        if (!read_single_dword) {
-            blocks[block_count].addr = addr;
-            blocks[block_count].len  = len;
-            if (field_count > 2) {
-                strcpy(blocks[block_count].enable_addr, arr[2]);
-                if (is_full || (!is_full && !strcmp(blocks[block_count].enable_addr, CRD_EMPTY))) {
-                    *number_of_dwords += len;
-                }
-            } else   {
-                strcpy(blocks[block_count].enable_addr, CRD_EMPTY);
-                *number_of_dwords += len;
-            }
-            block_count += 1;
-        } else {
-            if (field_count > 2) {
-                strcpy(enable_addr, arr[2]);
-            } else {
-                strcpy(enable_addr, CRD_EMPTY);
-            }
-            if (is_full || (!is_full && !strcmp(enable_addr, CRD_EMPTY))) {
-                *number_of_dwords += len;
-            }
-            for (i = 0; i < len; i++) {
-                blocks[block_count].addr = addr;
-                blocks[block_count].len  = 1;
-                strcpy(blocks[block_count].enable_addr, enable_addr);
-                block_count += 1;
-                addr += 4;
-            }
-        }
+    crd_get_plan_path(csv_file_path, plan_path);
+    if (crd_read_plan(plan_path, csv_file_path, &csv_st, blocks, block_count) == CRD_OK) {
+        return CRD_OK;
     }
-    fclose(fd);
+#endif
+    rc = crd_parse_csv(csv_file_path, blocks, block_count);
+    if (rc) {
+        return rc;
+    }
+#if !defined(__WIN__)
+    crd_write_plan(plan_path, csv_file_path, &csv_st, *blocks, *block_count);
+#endif
     return CRD_OK;
 }
 
@@ -484,19 +659,18 @@ static int crd_fill_address(IN crd_ctxt_t *context, OUT crd_dword_t *dword_arr)
 {
     u_int32_t i = 0;
     u_int32_t j = 0;
-    int total = 0;
+    u_int32_t total = 0;
 
     for (i = 0; i < context->block_count; i++) {
+        //blocks with an enable address are dumped only with -full
+        if (!context->is_full && !(context->blocks[i].flags & CRD_BLOCK_NO_ENABLE_ADDR)) {
+            continue;
+        }
+        if (total + context->blocks[i].len > context->number_of_dwords) {
+            CRD_DEBUG("value exceeded, something wrong in calculation!");
+            return CRD_EXCEED_VALUE;
+        }
         for (j = 0; j < context->blocks[i].len; j++) {
-
-            //CRD_UNKOWN, CRD_EMPTY
-            if (!context->is_full && strcmp(context->blocks[i].enable_addr, CRD_EMPTY)) {
-                break;
-            }
-            if ((u_int32_t)total >= context->number_of_dwords) {
-                CRD_DEBUG("value exceeded, something wrong in calculation!");
-                return CRD_EXCEED_VALUE;
-            }
             dword_arr[total].addr = context->blocks[i].addr + (j * 4);
             total += 1;
         }
@@ -504,41 +678,6 @@ static int crd_fill_address(IN crd_ctxt_t *context, OUT crd_dword_t *dword_arr)
     return CRD_OK;
 }
 
-static int crd_read_line(IN FILE *fd, OUT char *tmp)
-{
-
-    int i = 0;
-    int j = 0;
-    for (i = 0; i < CRD_MAXLINESIZE;) { // This loop to read line by line no matter the length of the line.
-        if (!feof(fd)) {
-            int c = fgetc(fd);
-            if (c == '#') {
-                if (!fgets(tmp, 300, fd)) {  // Avoid warning
-                }
-                tmp[0] = 0;
-                continue;
-            } else if (c == '\r')   {
-                break;
-            } else if (c == '\n')   {
-                break;
-            } else if (c == ' ')   {
-                continue;
-            } else   {
-                j++;
-                tmp[i] = c;
-                i++;
-            }
-        } else   {
-            return CRD_SKIP;
-        }
-    }
-    if (!j) {
-        return CRD_SKIP;
-    }
-    tmp[i] = 0;
-    return CRD_OK;
-}
-
 #if defined(__WIN__)
 
 static int crd_replace(INOUT char *st, IN char *orig, IN char *repl)
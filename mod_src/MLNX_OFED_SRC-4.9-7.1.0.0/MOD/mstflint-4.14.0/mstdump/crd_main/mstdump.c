@@ -35,9 +35,11 @@
 #include <dev_mgt/tools_dev_types.h>
 #include <common/tools_version.h>
 #include <common/bit_slice.h>
+#include <sys/time.h>
 
 
 #define CAUSE_FLAG "--cause"
+#define BENCH_FLAG "--bench"
 #define MAX_DEV_LEN 512
 
 #ifndef MSTDUMP_NAME
@@ -54,6 +56,7 @@ char correct_cmdline[] = "   Mellanox "MSTDUMP_NAME " utility, dumps device inte
    Usage: "MSTDUMP_NAME " [-full] <device> [i2c-slave] [-v[ersion] [-h[elp]]]\n\n\
    -full              :  Dump more expanded list of addresses\n\
                          Note : be careful when using this flag, None safe addresses might be read.\n\
+   --bench=<rounds>   :  Measure the dump time over the given number of rounds instead of printing the dump\n\
    -v | --version     :  Display version info\n\
    -h | --help        :  Print this help message\n\
    Example :\n\
@@ -65,6 +68,55 @@ void print_dword(crd_dword_t *dword)
     printf("0x%8.8x 0x%8.8x\n", dword->addr, dword->data);
 }
 
+static void skip_dword(crd_dword_t *dword)
+{
+    (void)dword;
+}
+
+static double get_time_sec()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static int bench_dump(mfile *mf, int full, int cause_addr, int cause_off, int rounds)
+{
+    int i;
+    int rc;
+    double start;
+    double init_time = 0;
+    double dump_time = 0;
+    u_int32_t arr_size = 0;
+    crd_ctxt_t *context;
+
+    for (i = 0; i < rounds; i++) {
+        /* crd_init identifies the device through the default space and leaves the ND space selected */
+        mset_addr_space(mf, AS_CR_SPACE);
+        start = get_time_sec();
+        rc = crd_init(&context, mf, full, cause_addr, cause_off, NULL);
+        if (rc) {
+            return rc;
+        }
+        init_time += get_time_sec() - start;
+        crd_get_dword_num(context, &arr_size);
+
+        start = get_time_sec();
+        rc = crd_dump_data(context, NULL, skip_dword);
+        dump_time += get_time_sec() - start;
+        crd_free(context);
+        if (rc) {
+            return rc;
+        }
+    }
+    if (dump_time <= 0) {
+        dump_time = 1e-6;
+    }
+    printf("%d rounds, %u dwords: init %.3f ms, dump %.3f ms per round, %.0f dwords/sec\n", rounds, arr_size,
+           init_time * 1000 / rounds, dump_time * 1000 / rounds, (double)rounds * arr_size / dump_time);
+    return CRD_OK;
+}
+
 int main(int argc, char *argv[])
 {
     int i;
@@ -72,6 +124,7 @@ int main(int argc, char *argv[])
     int rc;
     int full = 0;
     int cause_addr = -1, cause_off = -1;
+    int bench_rounds = 0;
     crd_ctxt_t *context;
     u_int32_t arr_size = 0;
     char *endptr;
@@ -84,7 +137,7 @@ int main(int argc, char *argv[])
     }
 #endif
 
-    if (argc < 2 || argc > 4) {
+    if (argc < 2 || argc > 5) {
         fprintf(stderr, "%s", correct_cmdline);
         return 2;
     }
@@ -107,6 +160,12 @@ int main(int argc, char *argv[])
                 fprintf(stderr, "Parameters to " CAUSE_FLAG " flag must be non-negative values\n");
                 exit(1);
             }
+        } else if (!strncmp(argv[i], BENCH_FLAG, strlen(BENCH_FLAG)))   {
+            if (sscanf(argv[i], BENCH_FLAG "=%d", &bench_rounds) != 1 || bench_rounds <= 0) {
+                fprintf(stderr, "Invalid parameters to " BENCH_FLAG " flag\n");
+                fprintf(stdout, "%s", correct_cmdline);
+                exit(1);
+            }
         }
     }
 
@@ -128,7 +187,7 @@ int main(int argc, char *argv[])
     }
     ++i;    // move past the device parameter
 
-    if (i < argc && !strncmp(argv[i], CAUSE_FLAG, strlen(CAUSE_FLAG))) {
+    while (i < argc && (!strncmp(argv[i], CAUSE_FLAG, strlen(CAUSE_FLAG)) || !strncmp(argv[i], BENCH_FLAG, strlen(BENCH_FLAG)))) {
         i++;
     }
     if (i < argc) {
@@ -150,6 +209,14 @@ int main(int argc, char *argv[])
         }
     }
     rc = CRD_OK;
+    if (bench_rounds) {
+        rc = bench_dump(mf, full, cause_addr, cause_off, bench_rounds);
+        mclose(mf);
+        if (rc) {
+            goto error;
+        }
+        return 0;
+    }
     rc = crd_init(&context, mf, full, cause_addr, cause_off, NULL);
     if (rc) {
         mclose(mf);
@@ -165,6 +232,8 @@ int main(int argc, char *argv[])
         goto error;
     }
 
+    /* The dump is streamed through a large stdout buffer rather than flushed line by line */
+    setvbuf(stdout, NULL, _IOFBF, 0x10000);
     rc = crd_dump_data(context, NULL, print_dword);
     if (rc) {
         crd_free(context);
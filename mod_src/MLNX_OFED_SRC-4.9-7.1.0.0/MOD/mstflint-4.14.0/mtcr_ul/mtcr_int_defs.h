@@ -65,6 +65,7 @@ typedef struct ul_ctx {
     f_mwrite4_block res_mwrite4_block;
     /*************************************************************/
     int via_driver;
+    int pciconf_emu;              /* config space is an emulated file (emu-pciconf:<file>) */
 } ul_ctx_t;
 #endif
 
@@ -105,6 +105,7 @@ typedef enum {
 #define DBDF             "%4.4x:%2.2x:%2.2x.%1.1x"
 #define DRIVER_CR_NAME   "/dev/"DBDF "_mstcr"
 #define DRIVER_CONF_NAME "/dev/"DBDF "_mstconf"
+#define PCICONF_EMU_PREFIX "emu-pciconf:" // emulated config space file, see pciconf_emu_pwrite()
 
 /* Forward decl*/
 static int get_inband_dev_from_pci(char *inband_dev, char *pci_dev);
@@ -137,6 +138,7 @@ int init_dev_info_ul(mfile *mf, const char *dev_name, unsigned domain, unsigned
 static int _flock_int(int fdlock, int operation)
 {
     int cnt = 0;
+    int err;
     if (fdlock == 0) { // in case we failed to create the lock file we ignore the locking mechanism
         return 0;
     }
@@ -151,7 +153,10 @@ static int _flock_int(int fdlock, int operation)
         }
         cnt++;
     } while (cnt < MAX_RETRY_CNT);
+    // keep the flock() errno for the caller, EWOULDBLOCK when it timed out
+    err = errno;
     perror("failed to perform lock operation.");
+    errno = err;
     return -1;
 
 }
@@ -625,6 +630,120 @@ enum {
     READ_OP = 0, WRITE_OP = 1,
 };
 
+/*
+ * Emulated config space ("emu-pciconf:<file>"): a regular (sparse) file
+ * holding the config header, with the Mellanox VSEC at PCICONF_EMU_VSEC_ADDR,
+ * followed by an image of each address space at PCICONF_EMU_SPACE_OFF +
+ * (space << 30). Writes to the VSEC address register run the gateway
+ * transaction against the image of the selected space, so the pciconf access
+ * code can be exercised and benchmarked without a device.
+ */
+#define PCICONF_EMU_VSEC_ADDR 0x40
+#define PCICONF_EMU_SPACE_OFF 0x1000
+
+static int pciconf_emu_get4(mfile *mf, off_t offs, u_int32_t *val)
+{
+    u_int32_t val_le = 0;
+    int rc = pread(mf->fd, &val_le, 4, offs);
+    if (rc < 0) {
+        return rc;
+    }
+    // reads past the end of the image return zeroes
+    *val = __le32_to_cpu(val_le);
+    return 4;
+}
+
+static int pciconf_emu_set4(mfile *mf, off_t offs, u_int32_t val)
+{
+    u_int32_t val_le = __cpu_to_le32(val);
+    return pwrite(mf->fd, &val_le, 4, offs) == 4 ? 4 : -1;
+}
+
+static int pciconf_emu_covers(off_t offs, size_t len, off_t reg)
+{
+    return reg >= offs && reg + 4 <= offs + (off_t)len;
+}
+
+static ssize_t pciconf_emu_pread(mfile *mf, void *buf, size_t len, off_t offs)
+{
+    u_int32_t ticket;
+    off_t counter = mf->vsec_addr + PCI_COUNTER_OFFSET;
+
+    // every read of the counter hands out a new semaphore ticket
+    if (mf->vsec_addr && pciconf_emu_covers(offs, len, counter)) {
+        if (pciconf_emu_get4(mf, counter, &ticket) < 0 || pciconf_emu_set4(mf, counter, ticket + 1) < 0) {
+            return -1;
+        }
+    }
+    return pread(mf->fd, buf, len, offs);
+}
+
+static ssize_t pciconf_emu_pwrite(mfile *mf, const void *buf, size_t len, off_t offs)
+{
+    // the gateway registers, from the control dword to the data dword
+    u_int32_t gw[(PCI_DATA_OFFSET - PCI_CTRL_OFFSET) / 4 + 1];
+    u_int32_t *ctrl = &gw[0];
+    u_int32_t *addr = &gw[(PCI_ADDR_OFFSET - PCI_CTRL_OFFSET) / 4];
+    u_int32_t *data = &gw[(PCI_DATA_OFFSET - PCI_CTRL_OFFSET) / 4];
+    off_t gw_offs = mf->vsec_addr + PCI_CTRL_OFFSET;
+    off_t space_offs;
+    ssize_t rc = pwrite(mf->fd, buf, len, offs);
+
+    if (rc != (ssize_t)len || !mf->vsec_addr) {
+        return rc;
+    }
+    if (!pciconf_emu_covers(offs, len, gw_offs) && !pciconf_emu_covers(offs, len, mf->vsec_addr + PCI_ADDR_OFFSET)) {
+        return rc;
+    }
+    if (pread(mf->fd, gw, sizeof(gw), gw_offs) != sizeof(gw)) {
+        return -1;
+    }
+    if (pciconf_emu_covers(offs, len, gw_offs)) {
+        // every space is supported
+        *ctrl = __cpu_to_le32(MERGE(__le32_to_cpu(*ctrl), 1, PCI_STATUS_BIT_OFFS, PCI_STATUS_BIT_LEN));
+        if (pwrite(mf->fd, ctrl, 4, gw_offs) != 4) {
+            return -1;
+        }
+    }
+    if (pciconf_emu_covers(offs, len, mf->vsec_addr + PCI_ADDR_OFFSET)) {
+        u_int32_t a = __le32_to_cpu(*addr);
+        space_offs = PCICONF_EMU_SPACE_OFF + EXTRACT(a, 0, 30) +
+                     ((off_t)EXTRACT(__le32_to_cpu(*ctrl), PCI_SPACE_BIT_OFFS, PCI_SPACE_BIT_LEN) << 30);
+        // the transaction completes immediately: toggle the flag
+        *addr = __cpu_to_le32(MERGE(a, !EXTRACT(a, PCI_FLAG_BIT_OFFS, 1), PCI_FLAG_BIT_OFFS, 1));
+        if (EXTRACT(a, PCI_FLAG_BIT_OFFS, 1) == WRITE_OP) {
+            if (pwrite(mf->fd, data, 4, space_offs) != 4 || pwrite(mf->fd, addr, 4, mf->vsec_addr + PCI_ADDR_OFFSET) != 4) {
+                return -1;
+            }
+        } else {
+            // reads past the end of the image return zeroes
+            *data = 0;
+            if (pread(mf->fd, data, 4, space_offs) < 0 || pwrite(mf->fd, addr, 8, mf->vsec_addr + PCI_ADDR_OFFSET) != 8) {
+                return -1;
+            }
+        }
+    }
+    return rc;
+}
+
+static ssize_t pciconf_pread(mfile *mf, void *buf, size_t len, off_t offs)
+{
+    ul_ctx_t *ctx = mf->ul_ctx;
+    if (ctx->pciconf_emu) {
+        return pciconf_emu_pread(mf, buf, len, offs);
+    }
+    return pread(mf->fd, buf, len, offs);
+}
+
+static ssize_t pciconf_pwrite(mfile *mf, const void *buf, size_t len, off_t offs)
+{
+    ul_ctx_t *ctx = mf->ul_ctx;
+    if (ctx->pciconf_emu) {
+        return pciconf_emu_pwrite(mf, buf, len, offs);
+    }
+    return pwrite(mf->fd, buf, len, offs);
+}
+
 #define READ4_PCI(mf, val_ptr, pci_offs, err_prefix, action_on_fail)    \
     do {                                                                \
         int rc;                                                         \
@@ -635,7 +754,7 @@ enum {
             perror(err_prefix);                                         \
             action_on_fail;                                             \
         }                                                               \
-        rc = pread(mf->fd, val_ptr, 4, pci_offs);                       \
+        rc = pciconf_pread(mf, val_ptr, 4, pci_offs);                   \
         lock_rc = _flock_int(pci_ctx->fdlock, LOCK_UN);                 \
         if (lock_rc) {                                                  \
             perror(err_prefix);                                         \
@@ -661,7 +780,7 @@ enum {
             perror(err_prefix);                                         \
             action_on_fail;                                             \
         }                                                               \
-        rc = pwrite(mf->fd, &val_le, 4, pci_offs);                      \
+        rc = pciconf_pwrite(mf, &val_le, 4, pci_offs);                  \
         lock_rc = _flock_int(pci_ctx->fdlock, LOCK_UN);                 \
         if (lock_rc) {                                                  \
             perror(err_prefix);                                         \
@@ -1078,6 +1197,11 @@ int mtcr_pciconf_set_addr_space(mfile *mf, u_int16_t space)
     // read modify write
     u_int32_t val;
     READ4_PCI(mf, &val, mf->vsec_addr + PCI_CTRL_OFFSET, "read domain", return ME_PCI_READ_ERROR);
+    if (EXTRACT(val, PCI_SPACE_BIT_OFFS, PCI_SPACE_BIT_LEN) == space &&
+        EXTRACT(val, PCI_STATUS_BIT_OFFS, PCI_STATUS_BIT_LEN) != 0) {
+        // already selected (and supported) - skip the write and the status read back
+        return ME_OK;
+    }
     val = MERGE(val, space, PCI_SPACE_BIT_OFFS, PCI_SPACE_BIT_LEN);
     WRITE4_PCI(mf, val, mf->vsec_addr + PCI_CTRL_OFFSET, "write domain", return ME_PCI_WRITE_ERROR);
     // read status and make sure space is supported
@@ -1161,9 +1285,74 @@ int mtcr_pciconf_mwrite4(mfile *mf, unsigned int offset, u_int32_t value)
     return 4;
 }
 
-static int block_op_pciconf(mfile *mf, unsigned int offset, u_int32_t *data, int length, int rw)
+/*
+ * Gateway transactions of a block access. The caller holds the VSEC semaphore,
+ * so the file lock is taken once for the whole block rather than around each
+ * config access, and the flag and data dwords, which are adjacent, are polled
+ * with a single 8 byte read: a dword read normally costs one pwrite of the
+ * address and one pread, a dword write two pwrites and one pread.
+ * Returns the number of bytes transferred, or -1 with errno set when the file
+ * lock can't be taken.
+ */
+static int pciconf_rw_dwords(mfile *mf, unsigned int offset, u_int32_t *data, int length, int rw)
 {
+    ul_ctx_t *ctx = mf->ul_ctx;
+    off_t addr_offs = mf->vsec_addr + PCI_ADDR_OFFSET;
+    off_t data_offs = mf->vsec_addr + PCI_DATA_OFFSET;
+    u_int32_t gw[2];
+    u_int32_t val_le;
+    int retries;
     int i;
+
+    if (_flock_int(ctx->fdlock, LOCK_EX)) {
+        return -1;
+    }
+    for (i = 0; i < length; i += 4) {
+        //last 2 bits must be zero as we only allow 30 bits addresses
+        if (EXTRACT(offset + i, 30, 2)) {
+            break;
+        }
+        if (rw == WRITE_OP) {
+            val_le = __cpu_to_le32(data[i >> 2]);
+            if (pciconf_pwrite(mf, &val_le, 4, data_offs) != 4) {
+                break;
+            }
+        }
+        val_le = __cpu_to_le32(MERGE(offset + i, (rw ? 1 : 0), PCI_FLAG_BIT_OFFS, 1));
+        if (pciconf_pwrite(mf, &val_le, 4, addr_offs) != 4) {
+            break;
+        }
+        // wait for the flag to flip (set on read completion, cleared on write completion)
+        for (retries = 0; retries <= IFC_MAX_RETRIES; retries++) {
+            if (rw == WRITE_OP) {
+                if (pciconf_pread(mf, gw, 4, addr_offs) != 4) {
+                    retries = IFC_MAX_RETRIES + 1;
+                    break;
+                }
+            } else if (pciconf_pread(mf, gw, 8, addr_offs) != 8) {
+                retries = IFC_MAX_RETRIES + 1;
+                break;
+            }
+            if (EXTRACT(__le32_to_cpu(gw[0]), PCI_FLAG_BIT_OFFS, 1) != (u_int32_t)rw) {
+                break;
+            }
+            if (((retries + 1) & 0xf) == 0) { // dont sleep always
+                msleep(1);
+            }
+        }
+        if (retries > IFC_MAX_RETRIES) {
+            break;
+        }
+        if (rw == READ_OP) {
+            data[i >> 2] = __le32_to_cpu(gw[1]);
+        }
+    }
+    _flock_int(ctx->fdlock, LOCK_UN);
+    return i;
+}
+
+static int block_op_pciconf(mfile *mf, unsigned int offset, u_int32_t *data, int length, int rw)
+{
     int rc = ME_OK;
     int wrote_or_read = length;
     if (length % 4) {
@@ -1181,12 +1370,7 @@ static int block_op_pciconf(mfile *mf, unsigned int offset, u_int32_t *data, int
         goto cleanup;
     }
 
-    for (i = 0; i < length; i += 4) {
-        if (mtcr_pciconf_rw(mf, offset + i, &(data[(i >> 2)]), rw)) {
-            wrote_or_read = i;
-            goto cleanup;
-        }
-    }
+    wrote_or_read = pciconf_rw_dwords(mf, offset, data, length, rw);
 cleanup: mtcr_pciconf_cap9_sem(mf, 0);
     return wrote_or_read;
 }
@@ -1331,6 +1515,30 @@ int space_to_cap_offset(int space)
     }
 }
 
+// Lays out a fresh emulated config space: a capability list holding only the
+// VSEC, with the CR space selected. Existing files are used as they are.
+static int pciconf_emu_init(mfile *mf)
+{
+    struct stat st;
+    u_int8_t cap[2] = {CAP_ID, 0};
+    u_int8_t cap_ptr = PCICONF_EMU_VSEC_ADDR;
+
+    if (fstat(mf->fd, &st)) {
+        return -1;
+    }
+    if (st.st_size >= PCICONF_EMU_SPACE_OFF) {
+        return 0;
+    }
+    if (ftruncate(mf->fd, PCICONF_EMU_SPACE_OFF) ||
+        pwrite(mf->fd, &cap_ptr, 1, PCI_CAP_PTR) != 1 ||
+        pwrite(mf->fd, cap, sizeof(cap), PCICONF_EMU_VSEC_ADDR) != sizeof(cap) ||
+        pciconf_emu_set4(mf, PCICONF_EMU_VSEC_ADDR + PCI_CTRL_OFFSET,
+                         MERGE(AS_CR_SPACE, 1, PCI_STATUS_BIT_OFFS, PCI_STATUS_BIT_LEN)) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
 // Turning on the space capability bit in vsec_cap_mask iff
 // space capability supported
 static
@@ -1346,12 +1554,17 @@ int mtcr_pciconf_open(mfile *mf, const char *name, u_int32_t adv_opt)
 {
     ul_ctx_t *ctx = mf->ul_ctx;
     mf->fd = -1;
-    mf->fd = open(name, O_RDWR | O_SYNC);
+    // an emulated config space is a plain file, no need to sync every access to the disk
+    mf->fd = open(name, ctx->pciconf_emu ? O_RDWR : O_RDWR | O_SYNC);
     if (mf->fd < 0) {
         return -1;
     }
 
     mf->tp = MST_PCICONF;
+    if (ctx->pciconf_emu && pciconf_emu_init(mf)) {
+        close(mf->fd);
+        return -1;
+    }
 
     if ((mf->vsec_addr = pci_find_capability(mf, CAP_ID))) {
         mf->vsec_supp = 1;
@@ -1396,12 +1609,33 @@ int mtcr_pciconf_open(mfile *mf, const char *name, u_int32_t adv_opt)
     ctx->mclose = mtcr_pciconf_mclose;
     return 0;
 }
+
+static
+int mtcr_pciconf_emu_open(mfile *mf, const char *name, u_int32_t adv_opt)
+{
+    ul_ctx_t *ctx = mf->ul_ctx;
+    // the file itself serves as the lock file of the emulated device
+    int fd = open(name, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+    ctx->fdlock = fd;
+    mf->flags = MDEVS_TAVOR_CR;
+    ctx->pciconf_emu = 1;
+    return mtcr_pciconf_open(mf, name, adv_opt);
+}
 #else
 static
 int mtcr_pciconf_open(mfile *mf, const char *name, u_int32_t adv_opt)
 {
     return -1;
 }
+
+static
+int mtcr_pciconf_emu_open(mfile *mf, const char *name, u_int32_t adv_opt)
+{
+    return -1;
+}
 #endif
 
 //
@@ -2272,6 +2506,12 @@ mfile* mopen_ul_int(const char *name, u_int32_t adv_opt)
     mf->fd = -1;
     mf->res_fd = -1;
     mf->mpci_change = mpci_change_ul;
+    if (!strncmp(name, PCICONF_EMU_PREFIX, strlen(PCICONF_EMU_PREFIX))) {
+        if (mtcr_pciconf_emu_open(mf, name + strlen(PCICONF_EMU_PREFIX), adv_opt)) {
+            goto open_failed;
+        }
+        return mf;
+    }
     dev_type = mtcr_parse_name(name, &force, &domain, &bus, &dev, &func);
     if (dev_type == MST_DRIVER_CR || dev_type == MST_DRIVER_CONF) {
         rc = mtcr_driver_open(mf, dev_type, domain, bus, dev, func);
@@ -43,6 +43,7 @@
 #include <errno.h>
 #include <getopt.h>
 #include <limits.h>
+#include <sys/time.h>
 #include "mtcr.h"
 #include "tools_version.h"
 
@@ -61,7 +62,7 @@
 void usage(int with_exit)
 {
     printf("  Mellanox Configuration Registers Access tool\n");
-    printf("  Usage: mstmcra [-s <i2c-slave>] [-a <adb dump>] [-v] [-h] [-c] <device>\n");
+    printf("  Usage: mstmcra [-s <i2c-slave>] [-a <adb dump>] [-b <rounds>] [-v] [-h] [-c] <device>\n");
     printf("         <addr[.<bit offset>:<bit size>]|[,<bytes number>]> [data]\n");
     printf("         If data is given, operation is write. Otherwise it is read.\n");
     printf("         If a bit range is given in the address (E.G.: 0xf0014.16:8):\n");
@@ -75,6 +76,8 @@ void usage(int with_exit)
     printf("  -s <i2c-slave> : I2C slave address.\n");
     printf("  -a <dump file> : adb dump file, used for access by path.\n");
     printf("  -c             : clear the device's PCI semaphore.\n");
+    printf("  -b <rounds>    : Benchmark: access the given block (addr,<bytes number>) <rounds> times\n"
+           "                   and print the dwords per second. With data, the block is filled with it.\n");
     printf("  -h             : Print this help message.\n");
     printf("  -v             : Display version info\n");
     printf("\n");
@@ -87,6 +90,45 @@ void usage(int with_exit)
 #define MCRA_TOOL_NAME "mcra"
 #define MCRA_TOOL_VERSON "1.0.0"
 
+static double get_time_sec()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static int bench_block(mfile *mf, unsigned int addr, int dword_size, int rounds, int read_op, u_int32_t val)
+{
+    int i;
+    double start;
+    double elapsed;
+    u_int32_t *data = malloc(sizeof(u_int32_t) * dword_size);
+
+    if (!data) {
+        fprintf(stderr, "-E- Failed to allocate memory for the benchmark buffer\n");
+        return 1;
+    }
+    for (i = 0; i < dword_size; i++) {
+        data[i] = val;
+    }
+    start = get_time_sec();
+    for (i = 0; i < rounds; i++) {
+        int rc = read_op ? mread4_block(mf, addr, data, dword_size * 4) : mwrite4_block(mf, addr, data, dword_size * 4);
+        if (rc != dword_size * 4) {
+            free(data);
+            return -1;
+        }
+    }
+    elapsed = get_time_sec() - start;
+    if (elapsed <= 0) {
+        elapsed = 1e-6;
+    }
+    printf("%s %d x %d dwords: %.3f sec, %.0f dwords/sec\n", read_op ? "read" : "write", rounds, dword_size, elapsed,
+           (double)rounds * dword_size / elapsed);
+    free(data);
+    return 0;
+}
+
 int main(int argc, char *argv[])
 {
     char *endp;
@@ -107,6 +149,7 @@ int main(int argc, char *argv[])
     int byte_size = 0;
     int read_block = 0;                 /* if 0 then read field according to "addr.bit:size", else read block of size "byte_size" */
     int clear_semaphore = 0;
+    int bench_rounds = 0;
     const char *op_name = "cr write";
 
 #if 0
@@ -125,7 +168,7 @@ int main(int argc, char *argv[])
         usage(1);
     }
 
-    while ((c = getopt(argc, argv, "s:a:hvc")) != -1) {
+    while ((c = getopt(argc, argv, "s:a:b:hvc")) != -1) {
         switch (c)  {
         case 's':
             i2c_slave  = strtoul(optarg, &endp, 0);
@@ -151,6 +194,14 @@ int main(int argc, char *argv[])
             clear_semaphore = 1;
             break;
 
+        case 'b':
+            bench_rounds = strtoul(optarg, &endp, 0);
+            if (*endp || bench_rounds <= 0) {
+                fprintf(stderr, "-E- Bad benchmark rounds given (%s)\n", optarg);
+                exit(1);
+            }
+            break;
+
         case '?':
             usage(0);
             exit(1);
@@ -358,6 +409,21 @@ int main(int argc, char *argv[])
         }
     }
 
+    if (bench_rounds) {
+        if (!read_block || path) {
+            fprintf(stderr, "-E- Benchmark requires a block address (addr,<bytes number>)\n");
+            goto error;
+        }
+        addr = (addr >> 2) << 2;
+        rc = bench_block(mf, addr, ((byte_size - 1) / 4) + 1, bench_rounds, read_op, val);
+        if (rc < 0) {
+            goto access_error;
+        } else if (rc) {
+            goto error;
+        }
+        goto success;
+    }
+
     if (read_op) {
         if (read_block) {
             int i;
@@ -365,7 +431,7 @@ int main(int argc, char *argv[])
             u_int32_t *data = malloc(sizeof(u_int32_t) * dowrd_size);
 
             if (!data) {
-                fprintf(stderr, "-E- Failed to allocate memmory for read block buffer\n");
+                fprintf(stderr, "-E- Failed to allocate memory for read block buffer\n");
                 goto error;
             }
 
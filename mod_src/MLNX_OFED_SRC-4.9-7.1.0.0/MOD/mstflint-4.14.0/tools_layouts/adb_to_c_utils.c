@@ -38,6 +38,63 @@
 #include <assert.h>
 #include "adb_to_c_utils.h"
 
+#define ADB2C_MASK64(S)       ( ((u_int64_t) ~0ULL) >> (64-(S)) )
+
+/* A field of up to 32 bits covers at most 5 bytes, these load/store them as one
+ * right justified big endian word without touching the bytes around the field */
+static inline u_int64_t adb2c_load_be_bytes(const u_int8_t *buff, u_int32_t byte_size)
+{
+    u_int16_t val16;
+    u_int32_t val32;
+
+    switch (byte_size) {
+    case 1:
+        return buff[0];
+    case 2:
+        memcpy(&val16, buff, 2);
+        return ADB2C_BE16_TO_CPU(val16);
+    case 3:
+        memcpy(&val16, buff, 2);
+        return ((u_int32_t)ADB2C_BE16_TO_CPU(val16) << 8) | buff[2];
+    case 4:
+        memcpy(&val32, buff, 4);
+        return ADB2C_BE32_TO_CPU(val32);
+    default:
+        memcpy(&val32, buff, 4);
+        return ((u_int64_t)ADB2C_BE32_TO_CPU(val32) << 8) | buff[4];
+    }
+}
+
+static inline void adb2c_store_be_bytes(u_int8_t *buff, u_int32_t byte_size, u_int64_t val)
+{
+    u_int16_t val16;
+    u_int32_t val32;
+
+    switch (byte_size) {
+    case 1:
+        buff[0] = (u_int8_t)val;
+        break;
+    case 2:
+        val16 = ADB2C_CPU_TO_BE16((u_int16_t)val);
+        memcpy(buff, &val16, 2);
+        break;
+    case 3:
+        val16 = ADB2C_CPU_TO_BE16((u_int16_t)(val >> 8));
+        memcpy(buff, &val16, 2);
+        buff[2] = (u_int8_t)val;
+        break;
+    case 4:
+        val32 = ADB2C_CPU_TO_BE32((u_int32_t)val);
+        memcpy(buff, &val32, 4);
+        break;
+    default:
+        val32 = ADB2C_CPU_TO_BE32((u_int32_t)(val >> 8));
+        memcpy(buff, &val32, 4);
+        buff[4] = (u_int8_t)val;
+        break;
+    }
+}
+
 /************************************
  * Function: adb2c_calc_array_field_address
  ************************************/
@@ -96,24 +153,30 @@ void adb2c_push_integer_to_buff_le(u_int8_t *buff, u_int32_t bit_offset,  u_int3
 /************************************
  * Function: adb2c_push_bits_to_buff
  ************************************/
-//the next function will push the field into the buffer by inserting it's MSB bits first
-//and therefore by doing it we save the CPU_TO_BE operation
+//the next function will push the field into the buffer with a single masked insert
+//into the big endian word made of the bytes the field covers
 void adb2c_push_bits_to_buff(u_int8_t *buff, u_int32_t bit_offset, u_int32_t field_size, u_int32_t field_value)
 {
-    u_int32_t i 		= 0;
-    u_int32_t byte_n	= bit_offset / 8;
-    u_int32_t byte_n_offset	= bit_offset % 8;
-    u_int32_t to_push;
-
-    //going over all bits in field
-    while (i < field_size)
-    {
-        to_push = ADB2C_MIN(8 - byte_n_offset, field_size - i);
-        i += to_push;
-        ADB2C_INSERTF_8(ADB2C_BYTE_N(buff, byte_n), 8U - to_push - byte_n_offset, field_value, field_size - i, to_push);
-        byte_n_offset  = 0;	//(byte_n_offset + to_push) % 8U;
-        byte_n++;
+    u_int8_t *ptr = buff + bit_offset / 8;
+    u_int32_t byte_n_offset = bit_offset % 8;
+    u_int32_t byte_size;
+    u_int32_t shift;
+    u_int64_t mask;
+    u_int64_t word;
+
+    if (field_size == 0 || field_size > 32) {
+        return;
+    }
+    byte_size = (byte_n_offset + field_size + 7) / 8;
+    shift = byte_size * 8 - byte_n_offset - field_size;
+    mask = ADB2C_MASK64(field_size) << shift;
+    if (byte_size == 1) {
+        ptr[0] = (u_int8_t)((ptr[0] & ~mask) | (((u_int64_t)field_value << shift) & mask));
+        return;
     }
+    word = adb2c_load_be_bytes(ptr, byte_size);
+    word = (word & ~mask) | (((u_int64_t)field_value << shift) & mask);
+    adb2c_store_be_bytes(ptr, byte_size, word);
 }
 
 /************************************
@@ -189,26 +252,24 @@ u_int64_t adb2c_pop_integer_from_buff_le(const u_int8_t *buff, u_int32_t bit_off
 /************************************
  * Function: adb2c_pop_bits_from_buff
  ************************************/
-//the next function will pop the field into the buffer by removing it's MSB bits first
-//and therefore by doing it we save the BE_TO_CPU operation
+//the next function will pop the field from the big endian word made of the bytes
+//the field covers with a single shift and mask
 u_int32_t adb2c_pop_bits_from_buff(const u_int8_t *buff, u_int32_t bit_offset, u_int32_t field_size)
 {
-    u_int32_t i 		= 0;
-    u_int32_t byte_n	= bit_offset / 8;
-    u_int32_t byte_n_offset	= bit_offset % 8;
-    u_int32_t field_32	= 0;
-    u_int32_t to_pop;
+    const u_int8_t *ptr = buff + bit_offset / 8;
+    u_int32_t byte_n_offset = bit_offset % 8;
+    u_int32_t byte_size;
+    u_int32_t shift;
 
-    //going over all bits in field
-    while (i < field_size)
-    {
-        to_pop =  ADB2C_MIN(8 - byte_n_offset, field_size - i);
-        i += to_pop;
-        ADB2C_INSERTF_8(field_32, field_size - i, ADB2C_BYTE_N(buff, byte_n), 8 - to_pop - byte_n_offset, to_pop);
-        byte_n_offset  = 0;	//(byte_n_offset + to_pop) % 8;
-        byte_n++;
+    if (field_size == 0 || field_size > 32) {
+        return 0;
     }
-    return field_32;
+    byte_size = (byte_n_offset + field_size + 7) / 8;
+    shift = byte_size * 8 - byte_n_offset - field_size;
+    if (byte_size == 1) {
+        return (ptr[0] >> shift) & ADB2C_MASK8(field_size);
+    }
+    return (u_int32_t)((adb2c_load_be_bytes(ptr, byte_size) >> shift) & ADB2C_MASK64(field_size));
 }
 
 /************************************
@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) Jan 2013 Mellanox Technologies Ltd. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * adb2c_push_bits_to_buff()/adb2c_pop_bits_from_buff() against the byte
+ * walk they replaced: every bit offset 0..63 and size 1..32 with random
+ * buffers and values, checking the popped value, the pushed buffer and
+ * that no byte around the field changes. Generated layouts are then
+ * unpacked and packed back over random buffers, which must come out the
+ * same.
+ *
+ * Runs with `make check`. adb_to_c_utils_test --bench [rounds] times the
+ * old and the new helpers instead.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "adb_to_c_utils.h"
+#include "cibfw_layouts.h"
+
+#define TEST_BUFF_SIZE 16
+#define TEST_ROUNDS 200
+
+// The byte walk adb2c_push_bits_to_buff() used to be
+static void old_push_bits_to_buff(u_int8_t *buff, u_int32_t bit_offset, u_int32_t field_size, u_int32_t field_value)
+{
+    u_int32_t i = 0;
+    u_int32_t byte_n = bit_offset / 8;
+    u_int32_t byte_n_offset = bit_offset % 8;
+    u_int32_t to_push;
+
+    while (i < field_size) {
+        to_push = ADB2C_MIN(8 - byte_n_offset, field_size - i);
+        i += to_push;
+        ADB2C_INSERTF_8(ADB2C_BYTE_N(buff, byte_n), 8U - to_push - byte_n_offset, field_value, field_size - i, to_push);
+        byte_n_offset = 0;
+        byte_n++;
+    }
+}
+
+// The byte walk adb2c_pop_bits_from_buff() used to be
+static u_int32_t old_pop_bits_from_buff(const u_int8_t *buff, u_int32_t bit_offset, u_int32_t field_size)
+{
+    u_int32_t i = 0;
+    u_int32_t byte_n = bit_offset / 8;
+    u_int32_t byte_n_offset = bit_offset % 8;
+    u_int32_t field_32 = 0;
+    u_int32_t to_pop;
+
+    while (i < field_size) {
+        to_pop = ADB2C_MIN(8 - byte_n_offset, field_size - i);
+        i += to_pop;
+        ADB2C_INSERTF_8(field_32, field_size - i, ADB2C_BYTE_N(buff, byte_n), 8 - to_pop - byte_n_offset, to_pop);
+        byte_n_offset = 0;
+        byte_n++;
+    }
+    return field_32;
+}
+
+static u_int32_t rand32(void)
+{
+    return ((u_int32_t)rand() << 16) ^ (u_int32_t)rand();
+}
+
+static void fill_random(u_int8_t *buff, u_int32_t size)
+{
+    u_int32_t i;
+
+    for (i = 0; i < size; i++) {
+        buff[i] = (u_int8_t)rand();
+    }
+}
+
+static int check_bits(void)
+{
+    u_int8_t orig[TEST_BUFF_SIZE], old_buff[TEST_BUFF_SIZE], new_buff[TEST_BUFF_SIZE];
+    u_int32_t offset, size, round, value;
+    u_int32_t cases = 0;
+
+    for (offset = 0; offset < 64; offset++) {
+        for (size = 1; size <= 32; size++) {
+            for (round = 0; round < TEST_ROUNDS; round++) {
+                fill_random(orig, sizeof(orig));
+                value = rand32();
+                if (old_pop_bits_from_buff(orig, offset, size) != adb2c_pop_bits_from_buff(orig, offset, size)) {
+                    printf("-E- pop offset %u size %u: old 0x%x new 0x%x\n", offset, size,
+                           old_pop_bits_from_buff(orig, offset, size), adb2c_pop_bits_from_buff(orig, offset, size));
+                    return 1;
+                }
+                memcpy(old_buff, orig, sizeof(orig));
+                memcpy(new_buff, orig, sizeof(orig));
+                old_push_bits_to_buff(old_buff, offset, size, value);
+                adb2c_push_bits_to_buff(new_buff, offset, size, value);
+                if (memcmp(old_buff, new_buff, sizeof(orig))) {
+                    printf("-E- push offset %u size %u value 0x%x: buffers differ\n", offset, size, value);
+                    return 1;
+                }
+                cases++;
+            }
+        }
+    }
+    printf("-I- %u push/pop cases match the byte walk\n", cases);
+    return 0;
+}
+
+static int check_layouts(void)
+{
+    u_int8_t orig[CIBFW_IMAGE_INFO_SIZE], repacked[CIBFW_IMAGE_INFO_SIZE];
+    struct cibfw_image_info image_info;
+    struct cibfw_itoc_entry itoc_entry;
+    struct cibfw_mfg_info mfg_info;
+    u_int32_t round;
+
+    for (round = 0; round < TEST_ROUNDS; round++) {
+        fill_random(orig, sizeof(orig));
+        memcpy(repacked, orig, sizeof(orig));
+        cibfw_image_info_unpack(&image_info, orig);
+        cibfw_image_info_pack(&image_info, repacked);
+        cibfw_itoc_entry_unpack(&itoc_entry, orig);
+        cibfw_itoc_entry_pack(&itoc_entry, repacked);
+        cibfw_mfg_info_unpack(&mfg_info, orig);
+        cibfw_mfg_info_pack(&mfg_info, repacked);
+        if (memcmp(orig, repacked, sizeof(orig))) {
+            printf("-E- layout round %u: repacked buffer differs\n", round);
+            return 1;
+        }
+    }
+    printf("-I- %u layout unpack/pack rounds match\n", round);
+    return 0;
+}
+
+static double now(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+// Every offset in a dword and the field sizes the layouts use most
+static int bench(u_int32_t rounds)
+{
+    static const u_int32_t sizes[] = {1, 2, 4, 8, 16, 24, 32};
+    u_int32_t nsizes = sizeof(sizes) / sizeof(sizes[0]);
+    u_int8_t buff[TEST_BUFF_SIZE];
+    u_int32_t fields = rounds * 32 * nsizes;
+    u_int32_t r, offset, s, sum = 0;
+    double start, t_old_push, t_new_push, t_old_pop, t_new_pop;
+
+    fill_random(buff, sizeof(buff));
+
+    start = now();
+    for (r = 0; r < rounds; r++) {
+        for (offset = 0; offset < 32; offset++) {
+            for (s = 0; s < nsizes; s++) {
+                old_push_bits_to_buff(buff, offset, sizes[s], r + offset);
+            }
+        }
+    }
+    t_old_push = now() - start;
+
+    start = now();
+    for (r = 0; r < rounds; r++) {
+        for (offset = 0; offset < 32; offset++) {
+            for (s = 0; s < nsizes; s++) {
+                adb2c_push_bits_to_buff(buff, offset, sizes[s], r + offset);
+            }
+        }
+    }
+    t_new_push = now() - start;
+
+    start = now();
+    for (r = 0; r < rounds; r++) {
+        for (offset = 0; offset < 32; offset++) {
+            for (s = 0; s < nsizes; s++) {
+                sum += old_pop_bits_from_buff(buff, offset + (r & 7), sizes[s]);
+            }
+        }
+    }
+    t_old_pop = now() - start;
+
+    start = now();
+    for (r = 0; r < rounds; r++) {
+        for (offset = 0; offset < 32; offset++) {
+            for (s = 0; s < nsizes; s++) {
+                sum -= adb2c_pop_bits_from_buff(buff, offset + (r & 7), sizes[s]);
+            }
+        }
+    }
+    t_new_pop = now() - start;
+
+    printf("%u fields per run\n", fields);
+    printf("push  byte walk %6.2f ns/field  single word %6.2f ns/field\n",
+           t_old_push * 1e9 / fields, t_new_push * 1e9 / fields);
+    printf("pop   byte walk %6.2f ns/field  single word %6.2f ns/field\n",
+           t_old_pop * 1e9 / fields, t_new_pop * 1e9 / fields);
+    // The old and new pops saw the same buffer, so their sums cancel
+    return sum != 0;
+}
+
+int main(int argc, char **argv)
+{
+    int failed = 0;
+
+    if (argc > 1 && !strcmp(argv[1], "--bench")) {
+        return bench(argc > 2 ? (u_int32_t)atoi(argv[2]) : 200000);
+    }
+
+    srand(1);
+    failed |= check_bits();
+    failed |= check_layouts();
+    printf("%s\n", failed ? "FAILED" : "PASSED");
+    return failed;
+}
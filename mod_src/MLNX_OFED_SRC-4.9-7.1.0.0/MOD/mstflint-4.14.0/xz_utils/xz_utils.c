@@ -273,6 +273,245 @@ int32_t xz_decompress_crc32(u_int8_t *inbuf, u_int32_t insz, u_int8_t *outbuf, u
 {
     return xpress(1, 0, inbuf, insz, outbuf, outsz, LZMA_CHECK_CRC32);
 }
+u_int32_t xz_compress_bound(u_int32_t insz, u_int32_t block_size)
+{
+    u_int64_t blocks;
+    u_int64_t bound;
+
+    if (!block_size || block_size >= insz) {
+        bound = lzma_stream_buffer_bound(insz);
+        return bound && bound <= UINT32_MAX ? (u_int32_t)bound : 0;
+    }
+
+    // Every block but the last one is full, each carries its own header,
+    // padding and check on top of the LZMA2 chunk headers
+    blocks = ((u_int64_t)insz + block_size - 1) / block_size;
+    bound = (blocks - 1) * lzma_block_buffer_bound(block_size) +
+            lzma_block_buffer_bound(insz - (blocks - 1) * block_size);
+    // Stream header and footer, and an index of an indicator, the record
+    // count and two VLIs per block, padded to four bytes and CRC32 checked
+    bound += 2 * LZMA_STREAM_HEADER_SIZE + 1 + LZMA_VLI_BYTES_MAX + blocks * 2 * LZMA_VLI_BYTES_MAX + 3 + 4;
+    return bound <= UINT32_MAX ? (u_int32_t)bound : 0;
+}
+
+static int32_t xflush(lzma_stream *strm, lzma_action action, u_int8_t *outbuf, u_int32_t outsz, u_int32_t *wpos)
+{
+    u_int8_t obuf[BUFSIZ];
+
+    while (1) {
+        strm->next_out = obuf;
+        strm->avail_out = sizeof(obuf);
+        lzma_ret ret = lzma_code(strm, action);
+        u_int32_t write_size = sizeof(obuf) - strm->avail_out;
+
+        if (outbuf) {
+            if (*wpos + write_size > outsz) {
+                return XZ_ERR_MEM_EXCEEDED;
+            }
+            memcpy(&(outbuf[*wpos]), obuf, write_size);
+        }
+        *wpos += write_size;
+
+        // Both LZMA_FULL_FLUSH and LZMA_FINISH end with LZMA_STREAM_END
+        if (ret == LZMA_STREAM_END) {
+            return 0;
+        }
+        if (ret != LZMA_OK) {
+            return ret == LZMA_MEM_ERROR ? XZ_ERR_INTERNAL_MEM : XZ_ERR_ENCODE_FAULT;
+        }
+    }
+}
+
+static lzma_ret init_blocks_encoder(lzma_stream *strm, lzma_filter *filters, u_int32_t block_size, u_int32_t threads,
+                                    u_int32_t *feed_size)
+{
+    *feed_size = block_size;
+#if LZMA_VERSION >= 50020002
+    lzma_mt mt;
+
+    if (!threads) {
+        threads = lzma_cputhreads();
+    }
+    if (threads > 1) {
+        // The multi-threaded encoder cuts blocks of block_size by itself
+        // and gets the whole input at once, a flush would stall the workers
+        *feed_size = UINT32_MAX;
+        memset(&mt, 0, sizeof(mt));
+        mt.threads = threads;
+        mt.block_size = block_size;
+        mt.filters = filters;
+        mt.check = LZMA_CHECK_CRC32;
+        return lzma_stream_encoder_mt(strm, &mt);
+    }
+#else
+    (void)block_size;
+    (void)threads;
+#endif
+    return lzma_stream_encoder(strm, filters, LZMA_CHECK_CRC32);
+}
+
+int32_t xz_compress_blocks_crc32(u_int32_t preset, u_int32_t block_size, u_int32_t threads,
+                                 u_int8_t *inbuf, u_int32_t insz, u_int8_t *outbuf, u_int32_t outsz)
+{
+    lzma_stream strm = LZMA_STREAM_INIT;
+    lzma_options_lzma opt_lzma;
+    lzma_filter filters[2];
+    u_int32_t feed_size;
+    u_int32_t rpos = 0;
+    u_int32_t wpos = 0;
+    int32_t rc;
+
+    if (!block_size) {
+        return XZ_ERR_PRESET_NO_SUPP;
+    }
+    if (lzma_lzma_preset(&opt_lzma, preset)) {
+        return XZ_ERR_PRESET_NO_SUPP;
+    }
+    // A block never refers to data outside of it, so a dictionary larger
+    // than the block only costs memory on both sides
+    if (opt_lzma.dict_size > block_size) {
+        opt_lzma.dict_size = block_size < LZMA_DICT_SIZE_MIN ? LZMA_DICT_SIZE_MIN : block_size;
+    }
+    filters[0].id = LZMA_FILTER_LZMA2;
+    filters[0].options = &opt_lzma;
+    filters[1].id = LZMA_VLI_UNKNOWN;
+    filters[1].options = NULL;
+
+    switch (init_blocks_encoder(&strm, filters, block_size, threads, &feed_size)) {
+    case LZMA_OK:
+        break;
+    case LZMA_MEM_ERROR:
+        return XZ_ERR_INTERNAL_MEM;
+    case LZMA_OPTIONS_ERROR:
+        return XZ_ERR_PRESET_NO_SUPP;
+    default:
+        return XZ_ERR_UNKNOWN;
+    }
+
+    // LZMA_FULL_FLUSH closes the current block, the next input starts a
+    // new one that is listed in the stream index
+    do {
+        u_int32_t chunk_sz = insz - rpos < feed_size ? insz - rpos : feed_size;
+        strm.next_in = &inbuf[rpos];
+        strm.avail_in = chunk_sz;
+        rpos += chunk_sz;
+        rc = xflush(&strm, rpos < insz ? LZMA_FULL_FLUSH : LZMA_FINISH, outbuf, outsz, &wpos);
+    } while (!rc && rpos < insz);
+
+    lzma_end(&strm);
+    return rc ? rc : (int32_t)wpos;
+}
+
+static int32_t decode_block(u_int8_t *inbuf, u_int64_t insz, lzma_check check, u_int64_t skip,
+                            u_int8_t *outbuf, u_int32_t outsz)
+{
+    lzma_stream strm = LZMA_STREAM_INIT;
+    lzma_filter filters[LZMA_FILTERS_MAX + 1];
+    u_int8_t scratch[BUFSIZ];
+    lzma_block block;
+    lzma_ret ret = LZMA_OK;
+    int32_t rc = XZ_ERR_DATA;
+    int i;
+
+    memset(&block, 0, sizeof(block));
+    block.version = 0;
+    block.check = check;
+    block.filters = filters;
+    block.header_size = lzma_block_header_size_decode(inbuf[0]);
+    if (insz < block.header_size || lzma_block_header_decode(&block, NULL, inbuf) != LZMA_OK) {
+        return XZ_ERR_DATA;
+    }
+    if (lzma_block_decoder(&strm, &block) != LZMA_OK) {
+        rc = XZ_ERR_INTERNAL_MEM;
+        goto free_filters;
+    }
+    strm.next_in = inbuf + block.header_size;
+    strm.avail_in = insz - block.header_size;
+
+    // Decode and drop the part of the block before the range
+    while (skip && ret == LZMA_OK) {
+        strm.next_out = scratch;
+        strm.avail_out = skip < sizeof(scratch) ? skip : sizeof(scratch);
+        ret = lzma_code(&strm, LZMA_RUN);
+        skip -= strm.next_out - scratch;
+    }
+    if (skip) {
+        goto end;
+    }
+
+    strm.next_out = outbuf;
+    strm.avail_out = outsz;
+    while (strm.avail_out && ret == LZMA_OK) {
+        ret = lzma_code(&strm, LZMA_RUN);
+    }
+    if (ret == LZMA_OK || ret == LZMA_STREAM_END) {
+        rc = outsz - strm.avail_out;
+    }
+
+end:
+    lzma_end(&strm);
+free_filters:
+    for (i = 0; filters[i].id != LZMA_VLI_UNKNOWN; i++) {
+        free(filters[i].options);
+    }
+    return rc;
+}
+
+int32_t xz_decompress_range(u_int8_t *inbuf, u_int32_t insz, u_int64_t offset, u_int8_t *outbuf, u_int32_t outsz)
+{
+    lzma_stream_flags header_flags;
+    lzma_stream_flags footer_flags;
+    lzma_index *idx = NULL;
+    lzma_index_iter iter;
+    u_int64_t memlimit = UINT64_MAX;
+    size_t in_pos = 0;
+    u_int8_t *index_buf;
+    u_int32_t wpos = 0;
+    int32_t rc;
+
+    // Stream padding is a multiple of four null bytes
+    while (insz >= 4 && !inbuf[insz - 1] && !inbuf[insz - 2] && !inbuf[insz - 3] && !inbuf[insz - 4]) {
+        insz -= 4;
+    }
+    if (insz < 2 * LZMA_STREAM_HEADER_SIZE ||
+        lzma_stream_header_decode(&header_flags, inbuf) != LZMA_OK ||
+        lzma_stream_footer_decode(&footer_flags, inbuf + insz - LZMA_STREAM_HEADER_SIZE) != LZMA_OK ||
+        lzma_stream_flags_compare(&header_flags, &footer_flags) != LZMA_OK ||
+        footer_flags.backward_size > insz - 2 * LZMA_STREAM_HEADER_SIZE) {
+        return XZ_ERR_NO_INDEX;
+    }
+
+    index_buf = inbuf + insz - LZMA_STREAM_HEADER_SIZE - footer_flags.backward_size;
+    if (lzma_index_buffer_decode(&idx, &memlimit, NULL, index_buf, &in_pos, footer_flags.backward_size) != LZMA_OK) {
+        return XZ_ERR_NO_INDEX;
+    }
+    // Concatenated streams have more than one index
+    if (lzma_index_stream_flags(idx, &footer_flags) != LZMA_OK || lzma_index_file_size(idx) != insz) {
+        lzma_index_end(idx, NULL);
+        return XZ_ERR_NO_INDEX;
+    }
+
+    lzma_index_iter_init(&iter, idx);
+    if (lzma_index_iter_locate(&iter, offset)) {
+        lzma_index_end(idx, NULL);
+        return XZ_ERR_DATA;
+    }
+    do {
+        rc = decode_block(inbuf + iter.block.compressed_file_offset, iter.block.total_size, footer_flags.check,
+                          offset + wpos - iter.block.uncompressed_file_offset, outbuf + wpos, outsz - wpos);
+        if (rc < 0) {
+            break;
+        }
+        wpos += rc;
+    } while (wpos < outsz && !lzma_index_iter_next(&iter, LZMA_INDEX_ITER_NONEMPTY_BLOCK));
+
+    lzma_index_end(idx, NULL);
+    if (rc < 0) {
+        return rc;
+    }
+    return wpos == outsz ? (int32_t)wpos : XZ_ERR_DATA;
+}
+
 const char* xz_get_error(int32_t error)
 {
     if (error == XZ_ERR_MEM_EXCEEDED) {
@@ -290,6 +529,12 @@ const char* xz_get_error(int32_t error)
     else if (error == XZ_ERR_ENCODE_FAULT) {
         return "XZ_ERR_ENCODE_FAULT";
     }
+    else if (error == XZ_ERR_DATA) {
+        return "XZ_ERR_DATA";
+    }
+    else if (error == XZ_ERR_NO_INDEX) {
+        return "XZ_ERR_NO_INDEX";
+    }
     else {
         return "UNKNOWN ERROR";
     }
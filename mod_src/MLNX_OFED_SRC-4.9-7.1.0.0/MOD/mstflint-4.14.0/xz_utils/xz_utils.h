@@ -47,13 +47,31 @@ enum
     XZ_ERR_INTERNAL_MEM         = -3,
     XZ_ERR_PRESET_NO_SUPP       = -4,
     XZ_ERR_INTEGRITY_NOT_SUPP   = -5,
-    XZ_ERR_ENCODE_FAULT         = -6
+    XZ_ERR_ENCODE_FAULT         = -6,
+    XZ_ERR_DATA                 = -7,
+    XZ_ERR_NO_INDEX             = -8
 };
 
 int32_t   xz_compress(u_int32_t preset, u_int8_t *inbuf, u_int32_t insz, u_int8_t *outbuf, u_int32_t outsz);
 int32_t   xz_decompress(u_int8_t *inbuf, u_int32_t insz, u_int8_t *outbuf, u_int32_t outsz);
 int32_t   xz_compress_crc32(u_int32_t preset, u_int8_t* inbuf, u_int32_t insz, u_int8_t* outbuf, u_int32_t outsz);
 int32_t   xz_decompress_crc32(u_int8_t *inbuf, u_int32_t insz, u_int8_t *outbuf, u_int32_t outsz);
+/*
+ * Block-indexed streams: the input is compressed in independent xz blocks of
+ * block_size bytes, and xz_decompress_range() uses the stream index to decode
+ * only the blocks covering [offset, offset + outsz). Any single xz stream can
+ * be read this way, a stream made of one block is decoded up to the range.
+ * XZ_ERR_NO_INDEX is returned when inbuf is not exactly one xz stream.
+ * The blocks are compressed by up to threads workers, 0 means one per CPU.
+ * xz_compress_bound() is the largest stream xz_compress_blocks_crc32() can
+ * produce for insz bytes cut in blocks of block_size, whatever the data and
+ * the thread count. A block_size of 0 bounds a single block stream as
+ * xz_compress() makes. 0 is returned when the bound exceeds 4GB.
+ */
+u_int32_t xz_compress_bound(u_int32_t insz, u_int32_t block_size);
+int32_t   xz_compress_blocks_crc32(u_int32_t preset, u_int32_t block_size, u_int32_t threads,
+                                   u_int8_t *inbuf, u_int32_t insz, u_int8_t *outbuf, u_int32_t outsz);
+int32_t   xz_decompress_range(u_int8_t *inbuf, u_int32_t insz, u_int64_t offset, u_int8_t *outbuf, u_int32_t outsz);
 const char* xz_get_error(int32_t error);
 #ifdef __cplusplus
 }
@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) Jan 2006 Mellanox Technologies Ltd. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * OpenIB.org BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/*
+ * Block-indexed stream round trips: every stream must fit in
+ * xz_compress_bound() in one pass, for incompressible input spanning many
+ * blocks as well as for compressible input, with one and several threads.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "xz_utils.h"
+
+#define MB (1024 * 1024)
+#define TEST_BLOCK_SIZE (2 * MB)
+
+static void fill_random(u_int8_t *buf, u_int32_t size)
+{
+    u_int64_t x = 0x9e3779b97f4a7c15ULL;
+    u_int32_t i;
+
+    // xorshift64, output LZMA2 can't do anything with
+    for (i = 0; i < size; i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        buf[i] = (u_int8_t)x;
+    }
+}
+
+static void fill_text(u_int8_t *buf, u_int32_t size)
+{
+    u_int32_t i;
+
+    for (i = 0; i < size; i++) {
+        buf[i] = "mstflint xz block test "[i % 23];
+    }
+}
+
+static int check_roundtrip(const char *name, u_int8_t *in, u_int32_t insz, u_int32_t preset, u_int32_t threads)
+{
+    u_int32_t bound = xz_compress_bound(insz, TEST_BLOCK_SIZE);
+    u_int32_t range_off = TEST_BLOCK_SIZE - 4096;
+    u_int32_t range_sz = insz - range_off < 8192 ? insz - range_off : 8192;
+    u_int8_t *out = NULL;
+    u_int8_t *dec = NULL;
+    int32_t zsz;
+    int32_t rc;
+    int err = 1;
+
+    out = (u_int8_t*)malloc(bound);
+    dec = (u_int8_t*)malloc(insz);
+    if (!bound || !out || !dec) {
+        printf("-E- %s: cannot allocate %u bytes\n", name, bound);
+        goto out;
+    }
+
+    zsz = xz_compress_blocks_crc32(preset, TEST_BLOCK_SIZE, threads, in, insz, out, bound);
+    if (zsz <= 0) {
+        printf("-E- %s, %u threads: compression failed: %s (bound %u)\n", name, threads, xz_get_error(zsz),
+               bound);
+        goto out;
+    }
+
+    rc = xz_decompress_range(out, zsz, 0, dec, insz);
+    if (rc != (int32_t)insz || memcmp(dec, in, insz)) {
+        printf("-E- %s, %u threads: full decode mismatch (rc %d)\n", name, threads, rc);
+        goto out;
+    }
+
+    // A range across the first block boundary decodes two blocks
+    rc = xz_decompress_range(out, zsz, range_off, dec, range_sz);
+    if (rc != (int32_t)range_sz || memcmp(dec, in + range_off, range_sz)) {
+        printf("-E- %s, %u threads: range decode mismatch (rc %d)\n", name, threads, rc);
+        goto out;
+    }
+
+    printf("-I- %s, %u threads: %u -> %d bytes, bound %u\n", name, threads, insz, zsz, bound);
+    err = 0;
+out:
+    free(dec);
+    free(out);
+    return err;
+}
+
+int main(void)
+{
+    static const u_int32_t sizes[] = {8 * MB, 32 * MB, 8 * MB + 12345};
+    static const u_int32_t threads[] = {1, 4};
+    char name[64];
+    u_int8_t *buf;
+    unsigned int i, j;
+    int failed = 0;
+
+    buf = (u_int8_t*)malloc(32 * MB + 12345);
+    if (!buf) {
+        return 1;
+    }
+
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        fill_random(buf, sizes[i]);
+        snprintf(name, sizeof(name), "random %u bytes", sizes[i]);
+        for (j = 0; j < sizeof(threads) / sizeof(threads[0]); j++) {
+            // The bound does not depend on the preset, the fastest one keeps the test short
+            failed |= check_roundtrip(name, buf, sizes[i], 0, threads[j]);
+        }
+    }
+
+    fill_text(buf, 8 * MB);
+    for (j = 0; j < sizeof(threads) / sizeof(threads[0]); j++) {
+        failed |= check_roundtrip("text 8MB", buf, 8 * MB, 9, threads[j]);
+    }
+
+    // A single block stream is bounded the way xz_compress() output is
+    if (xz_compress_bound(4096, 0) < 4096 || xz_compress_bound(4096, 0) != xz_compress_bound(4096, TEST_BLOCK_SIZE)) {
+        printf("-E- single block bound mismatch\n");
+        failed = 1;
+    }
+
+    free(buf);
+    return failed;
+}
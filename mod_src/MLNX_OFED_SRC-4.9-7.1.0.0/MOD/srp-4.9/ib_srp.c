@@ -45,6 +45,10 @@
 #include <linux/jiffies.h>
 #include <linux/lockdep.h>
 #include <linux/inet.h>
+#include <linux/ktime.h>
+#ifdef HAVE_SRP_POLL_QUEUES
+#include <linux/blk-mq.h>
+#endif
 #include <rdma/ib_cache.h>
 
 #include <linux/atomic.h>
@@ -618,7 +622,8 @@ static int srp_create_ch_ib(struct srp_rdma_ch *ch)
 
 	/* queue_size + 1 for ib_drain_rq() */
 	recv_cq = ib_alloc_cq(dev->dev, ch, target->queue_size + 1,
-				ch->comp_vector, IB_POLL_SOFTIRQ);
+				ch->comp_vector,
+				ch->polled ? IB_POLL_DIRECT : IB_POLL_SOFTIRQ);
 	if (IS_ERR(recv_cq)) {
 		ret = PTR_ERR(recv_cq);
 		goto err;
@@ -2180,6 +2185,15 @@ static int srp_post_recv(struct srp_rdma_ch *ch, struct srp_iu *iu)
 	return ib_post_recv(ch->qp, &wr, NULL);
 }
 
+static void srp_account_latency(struct srp_rdma_ch *ch,
+				struct srp_request *req)
+{
+	u64 us = div_u64(ktime_get_ns() - req->start_ns, NSEC_PER_USEC);
+
+	atomic_long_inc(&ch->lat_hist[min_t(int, fls64(us),
+					    SRP_LAT_BUCKETS - 1)]);
+}
+
 static void srp_process_rsp(struct srp_rdma_ch *ch, struct srp_rsp *rsp)
 {
 	struct srp_target_port *target = ch->target;
@@ -2254,6 +2268,7 @@ static void srp_process_rsp(struct srp_rdma_ch *ch, struct srp_rsp *rsp)
 		else if (unlikely(rsp->flags & SRP_RSP_FLAG_DOOVER))
 			scsi_set_resid(scmnd, -be32_to_cpu(rsp->data_out_res_cnt));
 
+		srp_account_latency(ch, req);
 		srp_free_req(ch, req, scmnd,
 			     be32_to_cpu(rsp->req_lim_delta));
 
@@ -2573,6 +2588,7 @@ static int SRP_QUEUECOMMAND(struct Scsi_Host *shost, struct scsi_cmnd *scmnd)
 	ib_dma_sync_single_for_device(dev, iu->dma, ch->max_it_iu_len,
 				      DMA_TO_DEVICE);
 
+	req->start_ns = ktime_get_ns();
 	if (srp_post_send(ch, iu, len)) {
 		shost_printk(KERN_ERR, target->scsi_host, PFX "Send failed\n");
 		scmnd->result = DID_ERROR << 16;
@@ -3133,6 +3149,27 @@ srp_change_queue_depth(struct scsi_device *sdev, int qdepth, int reason)
 }
 #endif //HAVE_SCSI_HOST_TEMPLATE_TRACK_QUEUE_DEPTH
 
+/*
+ * Nobody reaps the receive CQ of a polled channel while the SCSI error
+ * handler sleeps, so poll it here until the task management response arrives.
+ */
+static unsigned long srp_wait_tsk_mgmt(struct srp_rdma_ch *ch)
+{
+	const unsigned long timeout = msecs_to_jiffies(SRP_ABORT_TIMEOUT_MS);
+	const unsigned long deadline = jiffies + timeout;
+	unsigned long res;
+
+	if (!ch->polled)
+		return wait_for_completion_timeout(&ch->tsk_mgmt_done, timeout);
+
+	do {
+		ib_process_cq_direct(ch->recv_cq, -1);
+		res = wait_for_completion_timeout(&ch->tsk_mgmt_done, 1);
+	} while (!res && time_before(jiffies, deadline));
+
+	return res;
+}
+
 static int srp_send_tsk_mgmt(struct srp_rdma_ch *ch, u64 req_tag, u64 lun,
 			     u8 func, u8 *status)
 {
@@ -3188,8 +3225,7 @@ static int srp_send_tsk_mgmt(struct srp_rdma_ch *ch, u64 req_tag, u64 lun,
 
 		return -1;
 	}
-	res = wait_for_completion_timeout(&ch->tsk_mgmt_done,
-					msecs_to_jiffies(SRP_ABORT_TIMEOUT_MS));
+	res = srp_wait_tsk_mgmt(ch);
 	if (res > 0 && status)
 		*status = ch->tsk_mgmt_status;
 	mutex_unlock(&rport->mutex);
@@ -3421,6 +3457,51 @@ static ssize_t show_ch_count(struct device *dev, struct device_attribute *attr,
 	return sprintf(buf, "%d\n", target->ch_count);
 }
 
+static ssize_t show_poll_ch_count(struct device *dev,
+				  struct device_attribute *attr, char *buf)
+{
+	struct srp_target_port *target = host_to_target(class_to_shost(dev));
+
+	return sprintf(buf, "%u\n", target->poll_ch_count);
+}
+
+/*
+ * One line per channel: the channel index, whether its completions are
+ * polled or interrupt driven, and the SRP_LAT_BUCKETS latency counters.
+ */
+static ssize_t show_lat_hist(struct device *dev,
+			     struct device_attribute *attr, char *buf)
+{
+	struct srp_target_port *target = host_to_target(class_to_shost(dev));
+	struct srp_rdma_ch *ch;
+	ssize_t len = 0;
+	int i, j;
+
+	for (i = 0; i < target->ch_count; i++) {
+		ch = &target->ch[i];
+		len += scnprintf(buf + len, PAGE_SIZE - len, "%d %s", i,
+				 ch->polled ? "poll" : "irq");
+		for (j = 0; j < SRP_LAT_BUCKETS; j++)
+			len += scnprintf(buf + len, PAGE_SIZE - len, " %ld",
+					 atomic_long_read(&ch->lat_hist[j]));
+		len += scnprintf(buf + len, PAGE_SIZE - len, "\n");
+	}
+	return len;
+}
+
+static ssize_t store_lat_hist(struct device *dev,
+			      struct device_attribute *attr,
+			      const char *buf, size_t count)
+{
+	struct srp_target_port *target = host_to_target(class_to_shost(dev));
+	int i, j;
+
+	for (i = 0; i < target->ch_count; i++)
+		for (j = 0; j < SRP_LAT_BUCKETS; j++)
+			atomic_long_set(&target->ch[i].lat_hist[j], 0);
+	return count;
+}
+
 static ssize_t show_comp_vector(struct device *dev,
 				struct device_attribute *attr, char *buf)
 {
@@ -3465,6 +3546,9 @@ static DEVICE_ATTR(zero_req_lim,    S_IRUGO, show_zero_req_lim,	   NULL);
 static DEVICE_ATTR(local_ib_port,   S_IRUGO, show_local_ib_port,   NULL);
 static DEVICE_ATTR(local_ib_device, S_IRUGO, show_local_ib_device, NULL);
 static DEVICE_ATTR(ch_count,        S_IRUGO, show_ch_count,        NULL);
+static DEVICE_ATTR(poll_ch_count,   S_IRUGO, show_poll_ch_count,   NULL);
+static DEVICE_ATTR(lat_hist,        S_IRUGO | S_IWUSR, show_lat_hist,
+		   store_lat_hist);
 static DEVICE_ATTR(comp_vector,     S_IRUGO, show_comp_vector,     NULL);
 static DEVICE_ATTR(tl_retry_count,  S_IRUGO, show_tl_retry_count,  NULL);
 static DEVICE_ATTR(cmd_sg_entries,  S_IRUGO, show_cmd_sg_entries,  NULL);
@@ -3483,6 +3567,8 @@ static struct device_attribute *srp_host_attrs[] = {
 	&dev_attr_local_ib_port,
 	&dev_attr_local_ib_device,
 	&dev_attr_ch_count,
+	&dev_attr_poll_ch_count,
+	&dev_attr_lat_hist,
 	&dev_attr_comp_vector,
 	&dev_attr_tl_retry_count,
 	&dev_attr_cmd_sg_entries,
@@ -3490,6 +3576,52 @@ static struct device_attribute *srp_host_attrs[] = {
 	NULL
 };
 
+#ifdef HAVE_SRP_POLL_QUEUES
+/*
+ * Interrupt-driven channels back HCTX_TYPE_DEFAULT and HCTX_TYPE_READ, the
+ * trailing target->poll_ch_count channels back HCTX_TYPE_POLL.
+ */
+#ifdef HAVE_SCSI_HOST_TEMPLATE_MAP_QUEUES_RET_VOID
+static void srp_map_queues(struct Scsi_Host *shost)
+#else
+static int srp_map_queues(struct Scsi_Host *shost)
+#endif
+{
+	struct srp_target_port *target = host_to_target(shost);
+	struct blk_mq_queue_map *map;
+	int i;
+
+	for (i = 0; i < shost->nr_maps; i++) {
+		map = &shost->tag_set.map[i];
+		if (i == HCTX_TYPE_POLL) {
+			map->nr_queues = target->poll_ch_count;
+			map->queue_offset = target->ch_count -
+					    target->poll_ch_count;
+		} else {
+			map->nr_queues = target->ch_count -
+					 target->poll_ch_count;
+			map->queue_offset = 0;
+		}
+		if (map->nr_queues)
+			blk_mq_map_queues(map);
+	}
+#ifndef HAVE_SCSI_HOST_TEMPLATE_MAP_QUEUES_RET_VOID
+	return 0;
+#endif
+}
+
+static int srp_mq_poll(struct Scsi_Host *shost, unsigned int queue_num)
+{
+	struct srp_target_port *target = host_to_target(shost);
+	struct srp_rdma_ch *ch = &target->ch[queue_num];
+
+	if (unlikely(!ch->connected))
+		return 0;
+
+	return ib_process_cq_direct(ch->recv_cq, -1);
+}
+#endif /* HAVE_SRP_POLL_QUEUES */
+
 static struct scsi_host_template srp_template = {
 	.module				= THIS_MODULE,
 	.name				= "InfiniBand SRP initiator",
@@ -3504,6 +3636,10 @@ static struct scsi_host_template srp_template = {
 	.lockless                       = true,
 #endif
 	.queuecommand			= srp_queuecommand,
+#ifdef HAVE_SRP_POLL_QUEUES
+	.map_queues			= srp_map_queues,
+	.mq_poll			= srp_mq_poll,
+#endif
 	.change_queue_depth             = srp_change_queue_depth,
 #ifdef HAVE_SCSI_HOST_TEMPLATE_CHANGE_QUEUE_TYPE
 	.change_queue_type		= srp_change_queue_type,
@@ -3683,6 +3819,7 @@ enum {
 	SRP_OPT_IP_SRC		= 1 << 15,
 	SRP_OPT_IP_DEST		= 1 << 16,
 	SRP_OPT_TARGET_CAN_QUEUE= 1 << 17,
+	SRP_OPT_POLL_CH_COUNT	= 1 << 18,
 };
 
 static unsigned int srp_opt_mandatory[] = {
@@ -3715,6 +3852,7 @@ static const match_table_t srp_opt_tokens = {
 	{ SRP_OPT_QUEUE_SIZE,		"queue_size=%d"		},
 	{ SRP_OPT_IP_SRC,		"src=%s"		},
 	{ SRP_OPT_IP_DEST,		"dest=%s"		},
+	{ SRP_OPT_POLL_CH_COUNT,	"poll_ch_count=%u"	},
 	{ SRP_OPT_ERR,			NULL 			}
 };
 
@@ -4045,6 +4183,20 @@ static int srp_parse_options(struct net *net, const char *buf,
 			target->comp_vector = token;
 			break;
 
+		case SRP_OPT_POLL_CH_COUNT:
+			if (match_int(args, &token) || token < 0) {
+				pr_warn("bad poll_ch_count parameter '%s'\n", p);
+				goto out;
+			}
+#ifdef HAVE_SRP_POLL_QUEUES
+			target->poll_ch_count = min_t(unsigned int, token,
+						      num_online_cpus());
+#else
+			if (token)
+				pr_warn("poll_ch_count is not supported by this kernel, ignoring\n");
+#endif
+			break;
+
 		case SRP_OPT_TL_RETRY_COUNT:
 			if (match_int(args, &token) || token < 2 || token > 7) {
 				pr_warn("bad tl_retry_count parameter '%s' (must be a number between 2 and 7)\n",
@@ -4249,8 +4401,8 @@ static ssize_t srp_create_target(struct device *dev,
 				     min(4 * num_online_nodes(),
 					 ibdev->num_comp_vectors),
 				     num_online_cpus()));
-	target->ch = kcalloc(target->ch_count, sizeof(*target->ch),
-			     GFP_KERNEL);
+	target->ch = kcalloc(target->ch_count + target->poll_ch_count,
+			     sizeof(*target->ch), GFP_KERNEL);
 	if (!target->ch)
 		goto out;
 
@@ -4333,6 +4485,46 @@ static ssize_t srp_create_target(struct device *dev,
 	}
 
 connected:
+#ifdef HAVE_SRP_POLL_QUEUES
+	/*
+	 * Polled channels live behind the interrupt-driven ones so that the
+	 * HCTX_TYPE_DEFAULT map stays contiguous, see srp_map_queues().
+	 */
+	for (i = 0; i < target->poll_ch_count; i++) {
+		ch = &target->ch[target->ch_count++];
+		ch->target = target;
+		ch->polled = true;
+		ch->comp_vector = ibdev->num_comp_vectors ?
+			(target->comp_vector + i) % ibdev->num_comp_vectors : 0;
+		spin_lock_init(&ch->lock);
+		INIT_LIST_HEAD(&ch->free_tx);
+		ret = srp_new_cm_id(ch);
+		if (ret)
+			goto err_disconnect;
+
+		ret = srp_create_ch_ib(ch);
+		if (ret)
+			goto err_disconnect;
+
+		ret = srp_alloc_req_data(ch);
+		if (ret)
+			goto err_disconnect;
+
+		ret = srp_connect_ch(ch, max_iu_len, true);
+		if (ret) {
+			shost_printk(KERN_ERR, target->scsi_host,
+				     PFX "Connection of poll channel %d failed; using %d poll channels\n",
+				     i, i);
+			srp_free_ch_ib(target, ch);
+			srp_free_req_data(target, ch);
+			target->ch_count--;
+			break;
+		}
+	}
+	target->poll_ch_count = i;
+	if (target->poll_ch_count)
+		target->scsi_host->nr_maps = HCTX_TYPE_POLL + 1;
+#endif
 #ifdef HAVE_SCSI_HOST_NR_HW_QUEUES
 	target->scsi_host->nr_hw_queues = target->ch_count;
 #endif
@@ -78,6 +78,13 @@ enum {
 	SRP_IMM_DATA_OFFSET	= sizeof(struct srp_cmd) +
 				  SRP_MAX_ADD_CDB_LEN +
 				  sizeof(struct srp_imm_buf),
+
+	/*
+	 * Submit-to-completion latency buckets: bucket 0 counts commands
+	 * that completed in less than 1 us, bucket i > 0 counts commands
+	 * that took [2^(i-1), 2^i) us and the last bucket is open-ended.
+	 */
+	SRP_LAT_BUCKETS		= 16,
 };
 
 enum srp_target_state {
@@ -109,6 +116,11 @@ enum srp_iu_type {
 #define HAVE_VIRT_BOUNDARY 1
 #endif
 
+#if defined(HAVE_BLK_TAGS) && defined(HAVE_SCSI_HOST_TEMPLATE_MQ_POLL) &&      \
+	defined(HAVE_BLK_MQ_HCTX_TYPE)
+#define HAVE_SRP_POLL_QUEUES 1
+#endif
+
 #ifndef HAVE_BLK_TAGS
 static inline u32 build_srp_tag(u16 ch, u16 req_idx)
 {
@@ -175,6 +187,7 @@ struct srp_request {
 #ifndef HAVE_BLK_TAGS
 	uint32_t		tag;
 #endif
+	u64			start_ns;
 	struct ib_cqe		reg_cqe;
 };
 
@@ -183,6 +196,9 @@ struct srp_request {
  * @comp_vector: Completion vector used by this RDMA channel.
  * @max_it_iu_len: Maximum initiator-to-target information unit length.
  * @max_ti_iu_len: Maximum target-to-initiator information unit length.
+ * @polled: Whether the receive CQ of this channel is reaped by blk-mq
+ *   polling (HCTX_TYPE_POLL) instead of from softirq context.
+ * @lat_hist: Submit-to-completion latency histogram, see SRP_LAT_BUCKETS.
  */
 struct srp_rdma_ch {
 	/* These are RW in the hot path, and commonly used together */
@@ -205,6 +221,7 @@ struct srp_rdma_ch {
 	uint32_t		max_it_iu_len;
 	uint32_t		max_ti_iu_len;
 	bool			use_imm_data;
+	bool			polled;
 
 	/* Everything above this point is used in the hot path of
 	 * command processing. Try to keep them packed into cachelines.
@@ -234,12 +251,16 @@ struct srp_rdma_ch {
 	struct completion	tsk_mgmt_done;
 	u8			tsk_mgmt_status;
 	bool			connected;
+
+	atomic_long_t		lat_hist[SRP_LAT_BUCKETS];
 };
 
 /**
  * struct srp_target_port
  * @comp_vector: Completion vector used by the first RDMA channel created for
  *   this target port.
+ * @poll_ch_count: Number of channels at the end of @ch that are polled and
+ *   mapped to HCTX_TYPE_POLL hardware queues. Included in @ch_count.
  */
 struct srp_target_port {
 	/* read and written in the hot path */
@@ -253,6 +274,7 @@ struct srp_target_port {
 	int 			*mq_map;
 #endif
 	u32			ch_count;
+	u32			poll_ch_count;
 	u32			lkey;
 	enum srp_target_state	state;
 	unsigned int		cmd_sg_cnt;